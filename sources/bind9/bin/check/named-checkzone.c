@@ -433,6 +433,8 @@ main(int argc, char **argv) {
 			inputformat = dns_masterformat_raw;
 			fprintf(stderr,
 				"WARNING: input format raw, version ignored\n");
+		} else if (strcasecmp(inputformatstr, "map") == 0) {
+			inputformat = dns_masterformat_map;
 		} else {
 			fprintf(stderr, "unknown file format: %s\n",
 			    inputformatstr);
@@ -456,6 +458,8 @@ main(int argc, char **argv) {
 					"unknown raw format version\n");
 				exit(1);
 			}
+		} else if (strcasecmp(outputformatstr, "map") == 0) {
+			outputformat = dns_masterformat_map;
 		} else {
 			fprintf(stderr, "unknown file format: %s\n",
 				outputformatstr);
@@ -487,6 +491,12 @@ main(int argc, char **argv) {
 	     strcmp(output_filename, "/dev/stdout") == 0)) {
 		errout = stderr;
 		logdump = ISC_FALSE;
+		if (outputformat == dns_masterformat_map) {
+			fprintf(stderr,
+				"map format cannot be written to "
+				"standard output\n");
+			exit(1);
+		}
 	}
 
 	if (isc_commandline_index + 2 != argc)
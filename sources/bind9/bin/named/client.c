@@ -43,6 +43,7 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/view.h>
@@ -234,7 +235,8 @@ static void client_start(isc_task_t *task, isc_event_t *event);
 static void client_request(isc_task_t *task, isc_event_t *event);
 static void ns_client_dumpmessage(ns_client_t *client, const char *reason);
 static isc_result_t get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
-			       dns_dispatch_t *disp, isc_boolean_t tcp);
+			       dns_dispatch_t *disp, isc_socket_t *listener,
+			       isc_boolean_t tcp);
 static inline isc_boolean_t
 allowed(isc_netaddr_t *addr, dns_name_t *signer, dns_acl_t *acl);
 
@@ -686,6 +688,8 @@ ns_client_endrequest(ns_client_t *client) {
 	client->udpsize = 512;
 	client->extflags = 0;
 	client->ednsversion = -1;
+	isc_stats_add(ns_g_server->nsstats, dns_nsstatscounter_arenasaved,
+		      dns_message_arenasaved(client->message));
 	dns_message_reset(client->message, DNS_MESSAGE_INTENTPARSE);
 
 	if (client->recursionquota != NULL)
@@ -922,6 +926,112 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+/*
+ * Count a response sent from the response cache as query_send() and
+ * ns_client_send() would have counted it.
+ */
+static void
+client_countcached(ns_client_t *client, unsigned int flags,
+		   unsigned int ancount)
+{
+	dns_rcode_t rcode = flags & 0x000f;	/* RCODE */
+	isc_statscounter_t counters[5];
+	isc_stats_t *zonestats = NULL;
+	unsigned int i, n = 0;
+
+	if ((flags & DNS_MESSAGEFLAG_AA) != 0)
+		counters[n++] = dns_nsstatscounter_authans;
+	else
+		counters[n++] = dns_nsstatscounter_nonauthans;
+	if (rcode == dns_rcode_noerror) {
+		if (ancount != 0)
+			counters[n++] = dns_nsstatscounter_success;
+		else if ((flags & DNS_MESSAGEFLAG_AA) == 0)
+			counters[n++] = dns_nsstatscounter_referral;
+		else
+			counters[n++] = dns_nsstatscounter_nxrrset;
+	} else if (rcode == dns_rcode_nxdomain)
+		counters[n++] = dns_nsstatscounter_nxdomain;
+	else
+		counters[n++] = dns_nsstatscounter_failure;
+
+	if (client->query.authzone != NULL)
+		zonestats = dns_zone_getrequeststats(client->query.authzone);
+	for (i = 0; i < n; i++) {
+		isc_stats_increment(ns_g_server->nsstats, counters[i]);
+		if (zonestats != NULL)
+			isc_stats_increment(zonestats, counters[i]);
+	}
+
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	isc_stats_increment(ns_g_server->nsstats,
+			    dns_nsstatscounter_respcachehit);
+	if ((client->query.respkey.flags & NS_RESPKEY_EDNS) != 0)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+	if ((flags & DNS_MESSAGEFLAG_TC) != 0)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_truncatedresp);
+}
+
+isc_boolean_t
+ns_client_sendcached(ns_client_t *client, isc_uint32_t generation) {
+	isc_result_t result;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+	unsigned int flags;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(!TCP_CLIENT(client));
+	REQUIRE(client->view != NULL && client->view->respcache != NULL);
+
+	CTRACE("sendcached");
+
+	if (client->udpsize < SEND_BUFFER_SIZE)
+		client->query.respkey.size = client->udpsize;
+	else
+		client->query.respkey.size = SEND_BUFFER_SIZE;
+
+	isc_buffer_init(&buffer, sendbuf, sizeof(sendbuf));
+	result = dns_respcache_find(client->view->respcache,
+				    &client->query.respkey, generation,
+				    &buffer);
+	if (result != ISC_R_SUCCESS) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_respcachemiss);
+		return (ISC_FALSE);
+	}
+
+	/*
+	 * Give the response this query's id, and the RD and CD bits
+	 * it asked with.  RA depends on the client.
+	 */
+	isc_buffer_usedregion(&buffer, &r);
+	INSIST(r.length >= DNS_MESSAGE_HEADERLEN);
+	flags = (r.base[2] << 8) | r.base[3];
+	flags &= ~(DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD |
+		   DNS_MESSAGEFLAG_RA);
+	flags |= client->message->flags &
+		 (DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD);
+	if ((client->attributes & NS_CLIENTATTR_RA) != 0)
+		flags |= DNS_MESSAGEFLAG_RA;
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	r.base[2] = (flags >> 8) & 0xff;
+	r.base[3] = flags & 0xff;
+
+	/*
+	 * Count the response first; sending it may reset the client.
+	 */
+	client_countcached(client, flags, (r.base[6] << 8) | r.base[7]);
+
+	result = client_sendpkg(client, &buffer);
+	if (result != ISC_R_SUCCESS)
+		ns_client_next(client, result);
+	return (ISC_TRUE);
+}
+
 void
 ns_client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1062,6 +1172,17 @@ ns_client_send(ns_client_t *client) {
 		cleanup_cctx = ISC_FALSE;
 	}
 
+	if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0 &&
+	    !TCP_CLIENT(client) && client->message->tsigkey == NULL &&
+	    client->message->sig0key == NULL)
+	{
+		client->query.respkey.size = isc_buffer_length(&buffer);
+		isc_buffer_usedregion(&buffer, &r);
+		(void)dns_respcache_add(client->view->respcache,
+					&client->query.respkey,
+					client->query.respgen, &r);
+	}
+
 	if (TCP_CLIENT(client)) {
 		isc_buffer_usedregion(&buffer, &r);
 		isc_buffer_putuint16(&tcpbuffer, (isc_uint16_t) r.length);
@@ -1654,7 +1775,8 @@ client_request(isc_task_t *task, isc_event_t *event) {
 	/*
 	 * It's a request.  Parse it.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parse(client->message, buffer,
+				   DNS_MESSAGEPARSE_LAZY);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -2118,6 +2240,7 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 				    &client->message);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_timer;
+	dns_message_setarena(client->message, ISC_TRUE);
 
 	/* XXXRTH  Hardwired constants */
 
@@ -2477,7 +2600,8 @@ ns_client_replace(ns_client_t *client) {
 	REQUIRE(client->manager != NULL);
 
 	result = get_client(client->manager, client->interface,
-			    client->dispatch, TCP_CLIENT(client));
+			    client->dispatch, client->tcplistener,
+			    TCP_CLIENT(client));
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
@@ -2621,7 +2745,7 @@ ns_clientmgr_destroy(ns_clientmgr_t **managerp) {
 
 static isc_result_t
 get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
-	   dns_dispatch_t *disp, isc_boolean_t tcp)
+	   dns_dispatch_t *disp, isc_socket_t *listener, isc_boolean_t tcp)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_event_t *ev;
@@ -2664,8 +2788,7 @@ get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
 
 	if (tcp) {
 		client->attributes |= NS_CLIENTATTR_TCP;
-		isc_socket_attach(ifp->tcpsocket,
-				  &client->tcplistener);
+		isc_socket_attach(listener, &client->tcplistener);
 	} else {
 		isc_socket_t *sock;
 
@@ -2695,7 +2818,15 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 	MTRACE("createclients");
 
 	for (disp = 0; disp < n; disp++) {
-		result = get_client(manager, ifp, ifp->udpdispatch[disp], tcp);
+		if (tcp)
+			result = get_client(manager, ifp, NULL,
+					    ifp->tcpsocket[disp %
+							   ifp->ntcpsocket],
+					    ISC_TRUE);
+		else
+			result = get_client(manager, ifp,
+					    ifp->udpdispatch[disp], NULL,
+					    ISC_FALSE);
 		if (result != ISC_R_SUCCESS)
 			break;
 	}
@@ -104,12 +104,17 @@ options {\n\
 	transfers-in 10;\n\
 	transfers-out 10;\n\
 	treat-cr-as-space true;\n\
+	udp-batch-size 0;\n\
+	cache-shards 1;\n\
+	cache-node-locks 0;\n\
 	use-id-pool true;\n\
 	use-ixfr true;\n\
+	watcher-threads 1;\n\
 	edns-udp-size 4096;\n\
 	max-udp-size 4096;\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
+	reuseport no;\n\
 \n\
 	/* DLV */\n\
 	dnssec-lookaside . trust-anchor dlv.isc.org;\n\
@@ -141,7 +146,13 @@ options {\n\
 	min-roots 2;\n\
 	lame-ttl 600;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
+	prefetch 0;\n\
 	max-cache-ttl 604800; /* 1 week */\n\
+	stale-answer-enable no;\n\
+	max-stale-ttl 604800; /* 1 week */\n\
+	stale-answer-ttl 1;\n\
+	stale-answer-client-timeout 1800;\n\
+	synth-from-dnssec yes;\n\
 	transfer-format many-answers;\n\
 	max-cache-size 0;\n\
 	check-names master fail;\n\
@@ -153,9 +164,11 @@ options {\n\
 	acache-enable no;\n\
 	acache-cleaning-interval 60;\n\
 	max-acache-size 16M;\n\
+	response-cache-size 0;\n\
 	dnssec-enable yes;\n\
 	dnssec-validation yes; \n\
 	dnssec-accept-expired no;\n\
+	dnssec-verify-cache-size 512K;\n\
 	clients-per-query 10;\n\
 	max-clients-per-query 100;\n\
 	max-recursion-depth 7;\n\
@@ -200,10 +213,13 @@ options {\n\
 	sig-validity-interval 30; /* days */\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
+	sig-signing-threads 1;\n\
 	sig-signing-type 65534;\n\
 	inline-signing no;\n\
 	zone-statistics terse;\n\
 	max-journal-size unlimited;\n\
+	load-threads 1;\n\
+	dump-threads 1;\n\
 	ixfr-from-differences false;\n\
 	check-wildcard yes;\n\
 	check-sibling yes;\n\
@@ -207,6 +207,16 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_boolean_t
+ns_client_sendcached(ns_client_t *client, isc_uint32_t generation);
+/*%
+ * Finish processing the current client request by sending the
+ * response stored in the view's response cache under
+ * client->query.respkey, if there is one made from database
+ * generation 'generation'.  Returns ISC_FALSE, having done nothing,
+ * if there is not.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
@@ -274,7 +284,8 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 /*%
  * Create up to 'n' clients listening on interface 'ifp'.
  * If 'tcp' is ISC_TRUE, the clients will listen for TCP connections,
- * otherwise for UDP requests.
+ * spread round-robin over the interface's TCP sockets, otherwise for
+ * UDP requests, one client per UDP dispatcher.
  */
 
 isc_sockaddr_t *
@@ -67,6 +67,8 @@
 #define NS_INTERFACEFLAG_ANYADDR	0x01U	/*%< bound to "any" address */
 #define MAX_UDP_DISPATCH 128		/*%< Maximum number of UDP dispatchers
 						     to start per interface */
+#define MAX_TCP_LISTENER MAX_UDP_DISPATCH /*%< Maximum number of TCP
+						     listeners per interface */
 /*% The nameserver interface structure */
 struct ns_interface {
 	unsigned int		magic;		/*%< Magic number. */
@@ -79,7 +81,9 @@ struct ns_interface {
 	char 			name[32];	/*%< Null terminated. */
 	dns_dispatch_t *	udpdispatch[MAX_UDP_DISPATCH];
 						/*%< UDP dispatchers. */
-	isc_socket_t *		tcpsocket;	/*%< TCP socket. */
+	isc_socket_t *		tcpsocket[MAX_TCP_LISTENER];
+						/*%< TCP listening sockets. */
+	int			ntcpsocket;	/*%< Number of TCP sockets */
 	int			ntcptarget;	/*%< Desired number of concurrent
 						     TCP accepts */
 	int			ntcpcurrent;	/*%< Current ditto, locked */
@@ -154,6 +158,18 @@ ns_interfacemgr_setlistenon6(ns_interfacemgr_t *mgr, ns_listenlist_t *value);
  * The previous IPv6 listen-on list is freed.
  */
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, isc_boolean_t value);
+/*%
+ * If 'value' is ISC_TRUE, interfaces created from now on listen with one
+ * SO_REUSEPORT UDP socket and one SO_REUSEPORT TCP socket per worker
+ * thread instead of sharing a single socket per address.  Interfaces
+ * that are already listening are not affected.
+ *
+ * If the operating system does not support SO_REUSEPORT a warning is
+ * logged and the setting reverts to ISC_FALSE.
+ */
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr);
 
@@ -23,8 +23,10 @@
 #include <isc/types.h>
 #include <isc/buffer.h>
 #include <isc/netaddr.h>
+#include <isc/time.h>
 
 #include <dns/rdataset.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/types.h>
 
@@ -34,6 +36,7 @@
 typedef struct ns_dbversion {
 	dns_db_t			*db;
 	dns_dbversion_t			*version;
+	isc_uint32_t			generation;
 	isc_boolean_t			acl_checked;
 	isc_boolean_t			queryok;
 	ISC_LINK(struct ns_dbversion)	link;
@@ -55,6 +58,11 @@ struct ns_query {
 	isc_boolean_t			isreferral;
 	isc_mutex_t			fetchlock;
 	dns_fetch_t *			fetch;
+	dns_fetch_t *			prefetch;
+	isc_time_t			prefetchtime;
+	isc_timer_t *			staletimer;
+	dns_fetch_t *			stalefetch;
+	dns_rdatatype_t			staletype;
 	dns_rpz_st_t *			rpz_st;
 	isc_bufferlist_t		namebufs;
 	ISC_LIST(ns_dbversion_t)	activeversions;
@@ -65,6 +73,8 @@ struct ns_query {
 	unsigned int			dns64_aaaaoklen;
 	unsigned int			dns64_options;
 	unsigned int			dns64_ttl;
+	dns_respkey_t			respkey;
+	isc_uint32_t			respgen;
 };
 
 #define NS_QUERYATTR_RECURSIONOK	0x0001
@@ -87,6 +97,19 @@ struct ns_query {
 #ifdef USE_RRL
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #endif /* USE_RRL */
+#define NS_QUERYATTR_RESPCACHE		0x20000
+
+/*%
+ * Bits of respkey.flags: how the query asked to be answered.
+ */
+#define NS_RESPKEY_DNSSEC		0x0001
+#define NS_RESPKEY_AD			0x0002
+#define NS_RESPKEY_EDNS			0x0004
+#define NS_RESPKEY_CD			0x0008
+#define NS_RESPKEY_RECURSIONOK		0x0010
+#define NS_RESPKEY_CACHEOK		0x0020
+#define NS_RESPKEY_NOAUTHORITY		0x0040
+#define NS_RESPKEY_NOADDITIONAL		0x0080
 
 
 isc_result_t
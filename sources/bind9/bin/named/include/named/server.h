@@ -100,6 +100,7 @@ struct ns_server {
 	isc_stats_t *		zonestats;	/*% Zone management stats */
 	isc_stats_t  *		resolverstats;	/*% Resolver stats */
 	isc_stats_t *		sockstats;	/*%< Socket stats */
+	isc_stats_t *		taskstats;	/*%< Task manager stats */
 
 	ns_controls_t *		controls;	/*%< Control channels */
 	unsigned int		dispatchgen;
@@ -167,13 +168,24 @@ enum {
 
 	dns_nsstatscounter_rpz_rewrites = 36,
 
+	dns_nsstatscounter_arenasaved = 37,
+
+	dns_nsstatscounter_updatecommit = 38,
+	dns_nsstatscounter_updatecoalesced = 39,
+
+	dns_nsstatscounter_respcachehit = 40,
+	dns_nsstatscounter_respcachemiss = 41,
+
+	dns_nsstatscounter_prefetch = 42,
+	dns_nsstatscounter_prefetchsaved = 43,
+
 #ifdef USE_RRL
-	dns_nsstatscounter_ratedropped = 37,
-	dns_nsstatscounter_rateslipped = 38,
+	dns_nsstatscounter_ratedropped = 44,
+	dns_nsstatscounter_rateslipped = 45,
 
-	dns_nsstatscounter_max = 39
+	dns_nsstatscounter_max = 46
 #else /* USE_RRL */
-	dns_nsstatscounter_max = 37
+	dns_nsstatscounter_max = 44
 #endif /* USE_RRL */
 };
 
@@ -52,6 +52,7 @@ struct ns_interfacemgr {
 	unsigned int		generation;	/*%< Current generation no. */
 	ns_listenlist_t *	listenon4;
 	ns_listenlist_t *	listenon6;
+	isc_boolean_t		reuseport;	/*%< Per-worker sockets */
 	dns_aclenv_t		aclenv;		/*%< Localhost/localnets ACLs */
 	ISC_LIST(ns_interface_t) interfaces;	/*%< List of interfaces. */
 	ISC_LIST(isc_sockaddr_t) listenon;
@@ -93,6 +94,7 @@ ns_interfacemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	mgr->generation = 1;
 	mgr->listenon4 = NULL;
 	mgr->listenon6 = NULL;
+	mgr->reuseport = ISC_FALSE;
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
@@ -219,7 +221,9 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 	for (disp = 0; disp < MAX_UDP_DISPATCH; disp++)
 		ifp->udpdispatch[disp] = NULL;
 
-	ifp->tcpsocket = NULL;
+	for (disp = 0; disp < MAX_TCP_LISTENER; disp++)
+		ifp->tcpsocket[disp] = NULL;
+	ifp->ntcpsocket = 0;
 
 	/*
 	 * Create a single TCP client object.  It will replace itself
@@ -257,6 +261,7 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	isc_result_t result;
 	unsigned int attrs;
 	unsigned int attrmask;
+	isc_boolean_t reuseport;
 	int disp, i;
 
 	attrs = 0;
@@ -270,24 +275,50 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
-	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
-	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
+	/*
+	 * With SO_REUSEPORT every worker thread gets a socket of its own,
+	 * so the kernel spreads queries over independent receive queues
+	 * and each client pipeline receives and sends on its own socket.
+	 * Otherwise the dispatchers share dup()ed copies of one socket.
+	 */
+	reuseport = ifp->mgr->reuseport;
+	if (reuseport)
+		ifp->nudpdispatch = ISC_MIN(ns_g_cpus, MAX_UDP_DISPATCH);
+	else
+		ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
+	disp = 0;
+	while (disp < ifp->nudpdispatch) {
 		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
 						 ns_g_socketmgr,
 						 ns_g_taskmgr, &ifp->addr,
 						 4096, 1000, 32768, 8219, 8237,
-						 attrs, attrmask,
+						 reuseport
+						    ? attrs |
+						      DNS_DISPATCHATTR_REUSEPORT
+						    : attrs,
+						 attrmask,
 						 &ifp->udpdispatch[disp],
-						 disp == 0
+						 (disp == 0 || reuseport)
 						    ? NULL
 						    : ifp->udpdispatch[0]);
+		if (result == ISC_R_NOTIMPLEMENTED && reuseport) {
+			INSIST(disp == 0);
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported on this "
+				      "system; using shared sockets");
+			ifp->mgr->reuseport = ISC_FALSE;
+			reuseport = ISC_FALSE;
+			ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp,
+						    MAX_UDP_DISPATCH);
+			continue;
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
 				      isc_result_totext(result));
 			goto udp_dispatch_failure;
 		}
-
+		disp++;
 	}
 
 	result = ns_clientmgr_createclients(ifp->clientmgr, ifp->nudpdispatch,
@@ -302,7 +333,7 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	return (ISC_R_SUCCESS);
 
  addtodispatch_failure:
-	for (i = disp - 1; i <= 0; i--) {
+	for (i = disp - 1; i >= 0; i--) {
 		dns_dispatch_changeattributes(ifp->udpdispatch[i], 0,
 					      DNS_DISPATCHATTR_NOLISTEN);
 		dns_dispatch_detach(&(ifp->udpdispatch[i]));
@@ -314,8 +345,11 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 }
 
 static isc_result_t
-ns_interface_accepttcp(ns_interface_t *ifp) {
+ns_interface_listentcp(ns_interface_t *ifp, unsigned int options,
+		       isc_socket_t **sockp)
+{
 	isc_result_t result;
+	isc_socket_t *sock = NULL;
 
 	/*
 	 * Open a TCP socket.
@@ -323,26 +357,25 @@ ns_interface_accepttcp(ns_interface_t *ifp) {
 	result = isc_socket_create(ifp->mgr->socketmgr,
 				   isc_sockaddr_pf(&ifp->addr),
 				   isc_sockettype_tcp,
-				   &ifp->tcpsocket);
+				   &sock);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				 "creating TCP socket: %s",
 				 isc_result_totext(result));
 		goto tcp_socket_failure;
 	}
-	isc_socket_setname(ifp->tcpsocket, "dispatcher", NULL);
+	isc_socket_setname(sock, "dispatcher", NULL);
 #ifndef ISC_ALLOW_MAPPED
-	isc_socket_ipv6only(ifp->tcpsocket, ISC_TRUE);
+	isc_socket_ipv6only(sock, ISC_TRUE);
 #endif
-	result = isc_socket_bind(ifp->tcpsocket, &ifp->addr,
-				 ISC_SOCKET_REUSEADDRESS);
+	result = isc_socket_bind(sock, &ifp->addr, options);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				 "binding TCP socket: %s",
 				 isc_result_totext(result));
 		goto tcp_bind_failure;
 	}
-	result = isc_socket_listen(ifp->tcpsocket, ns_g_listen);
+	result = isc_socket_listen(sock, ns_g_listen);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				 "listening on TCP socket: %s",
@@ -354,8 +387,51 @@ ns_interface_accepttcp(ns_interface_t *ifp) {
 	 * If/when there a multiple filters listen to the
 	 * result.
 	 */
-	(void)isc_socket_filter(ifp->tcpsocket, "dataready");
+	(void)isc_socket_filter(sock, "dataready");
 
+	*sockp = sock;
+	return (ISC_R_SUCCESS);
+
+ tcp_listen_failure:
+ tcp_bind_failure:
+	isc_socket_detach(&sock);
+ tcp_socket_failure:
+	return (result);
+}
+
+static isc_result_t
+ns_interface_accepttcp(ns_interface_t *ifp) {
+	isc_result_t result;
+	unsigned int options;
+	int n, i;
+
+	/*
+	 * In SO_REUSEPORT mode there is one listening socket per UDP
+	 * dispatcher, i.e., per worker thread.
+	 */
+	options = ISC_SOCKET_REUSEADDRESS;
+	n = 1;
+	if (ifp->mgr->reuseport) {
+		options |= ISC_SOCKET_REUSEPORT;
+		n = ISC_MIN(ifp->nudpdispatch, MAX_TCP_LISTENER);
+	}
+
+	for (i = 0; i < n; i++) {
+		result = ns_interface_listentcp(ifp, options,
+						&ifp->tcpsocket[i]);
+		if (result != ISC_R_SUCCESS)
+			break;
+		ifp->ntcpsocket++;
+	}
+	if (ifp->ntcpsocket == 0)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * Create one TCP client object per listening socket.  Each will
+	 * replace itself with a new one as soon as it gets a connection,
+	 * so the actual connections will be handled in parallel.
+	 */
+	ifp->ntcptarget = ifp->ntcpsocket;
 	result = ns_clientmgr_createclients(ifp->clientmgr,
 					    ifp->ntcptarget, ifp,
 					    ISC_TRUE);
@@ -368,10 +444,9 @@ ns_interface_accepttcp(ns_interface_t *ifp) {
 	return (ISC_R_SUCCESS);
 
  accepttcp_failure:
- tcp_listen_failure:
- tcp_bind_failure:
-	isc_socket_detach(&ifp->tcpsocket);
- tcp_socket_failure:
+	for (i = 0; i < ifp->ntcpsocket; i++)
+		isc_socket_detach(&ifp->tcpsocket[i]);
+	ifp->ntcpsocket = 0;
 	return (ISC_R_SUCCESS);
 }
 
@@ -435,8 +510,9 @@ ns_interface_destroy(ns_interface_t *ifp) {
 			dns_dispatch_detach(&(ifp->udpdispatch[disp]));
 		}
 
-	if (ifp->tcpsocket != NULL)
-		isc_socket_detach(&ifp->tcpsocket);
+	for (disp = 0; disp < ifp->ntcpsocket; disp++)
+		if (ifp->tcpsocket[disp] != NULL)
+			isc_socket_detach(&ifp->tcpsocket[disp]);
 
 	DESTROYLOCK(&ifp->lock);
 
@@ -983,6 +1059,15 @@ ns_interfacemgr_setlistenon6(ns_interfacemgr_t *mgr, ns_listenlist_t *value) {
 	UNLOCK(&mgr->lock);
 }
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, isc_boolean_t value) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+
+	LOCK(&mgr->lock);
+	mgr->reuseport = value;
+	UNLOCK(&mgr->lock);
+}
+
 void
 ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr) {
 	ns_interface_t *interface;
@@ -576,6 +576,12 @@ parse_command_line(int argc, char *argv[]) {
 					ns_main_earlyfatal("bad mkeytimer");
 			} else if (!strcmp(isc_commandline_argument, "notcp"))
 				ns_g_notcp = ISC_TRUE;
+			else if (!strcmp(isc_commandline_argument,
+					 "taskqueues"))
+				ns_g_taskqueues = ISC_TRUE;
+			else if (!strcmp(isc_commandline_argument,
+					 "timerwheel"))
+				ns_g_timerwheel = ISC_TRUE;
 			else
 				fprintf(stderr, "unknown -T flag '%s\n",
 					isc_commandline_argument);
@@ -698,23 +704,30 @@ create_managers(void) {
 		      ISC_LOG_INFO, "using %u UDP listener%s per interface",
 		      ns_g_udpdisp, ns_g_udpdisp == 1 ? "" : "s");
 
-	result = isc_taskmgr_create(ns_g_mctx, ns_g_cpus, 0, &ns_g_taskmgr);
+	result = isc_taskmgr_create2(ns_g_mctx, ns_g_cpus, 0,
+				     ns_g_taskqueues ?
+				     ISC_TASKMGR_PERWORKER : 0,
+				     &ns_g_taskmgr);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_taskmgr_create() failed: %s",
+				 "isc_taskmgr_create2() failed: %s",
 				 isc_result_totext(result));
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_timermgr_create(ns_g_mctx, &ns_g_timermgr);
+	result = isc_timermgr_create2(ns_g_mctx,
+				      ns_g_timerwheel ?
+				      ISC_TIMERMGR_WHEEL : 0,
+				      &ns_g_timermgr);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_timermgr_create() failed: %s",
+				 "isc_timermgr_create2() failed: %s",
 				 isc_result_totext(result));
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr,
+				       maxsocks, 1);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
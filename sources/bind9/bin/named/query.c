@@ -27,6 +27,7 @@
 #include <isc/mem.h>
 #include <isc/serial.h>
 #include <isc/stats.h>
+#include <isc/timer.h>
 #include <isc/util.h>
 
 #include <dns/adb.h>
@@ -38,6 +39,7 @@
 #include <dns/events.h>
 #include <dns/message.h>
 #include <dns/ncache.h>
+#include <dns/nsec.h>
 #include <dns/nsec3.h>
 #include <dns/order.h>
 #include <dns/rdata.h>
@@ -146,6 +148,32 @@ typedef struct client_additionalctx {
 	dns_rdataset_t *rdataset;
 } client_additionalctx_t;
 
+/*%
+ * The most NSEC3 hash iterations that a negative answer is synthesized
+ * with; each lookup for it hashes a name again.
+ */
+#define NS_SYNTH_MAXITERATIONS 150
+
+/*%
+ * A validated record from the cache that a synthesized negative answer
+ * is made of.
+ */
+typedef struct query_synthproof {
+	dns_fixedname_t name;
+	dns_rdataset_t *rdataset;
+	dns_rdataset_t *sigrdataset;
+} query_synthproof_t;
+
+/*%
+ * The NSEC3 parameters of a zone, as seen in the cache.
+ */
+typedef struct query_nsec3param {
+	dns_hash_t hash;
+	unsigned int iterations;
+	unsigned char salt[DNS_NSEC3_SALTSIZE];
+	size_t salt_length;
+} query_nsec3param_t;
+
 static isc_result_t
 query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype);
 
@@ -166,6 +194,9 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level);
 static void
 rpz_st_clear(ns_client_t *client);
 
+static void
+query_staletimeout(isc_task_t *task, isc_event_t *event);
+
 /*%
  * Increment query statistics counters.
  */
@@ -255,6 +286,7 @@ query_error(ns_client_t *client, isc_result_t result, int line) {
 
 	log_queryerror(client, result, line, loglevel);
 
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
 	ns_client_error(client, result);
 }
 
@@ -387,6 +419,10 @@ query_reset(ns_client_t *client, isc_boolean_t everything) {
 				    NS_QUERYATTR_SECURE);
 	client->query.restarts = 0;
 	client->query.timerset = ISC_FALSE;
+	if (client->query.staletimer != NULL)
+		(void)isc_timer_reset(client->query.staletimer,
+				      isc_timertype_inactive, NULL, NULL,
+				      ISC_TRUE);
 	if (client->query.rpz_st != NULL) {
 		rpz_st_clear(client);
 		if (everything) {
@@ -403,6 +439,8 @@ query_reset(ns_client_t *client, isc_boolean_t everything) {
 	client->query.isreferral = ISC_FALSE;
 	client->query.dns64_options = 0;
 	client->query.dns64_ttl = ISC_UINT32_MAX;
+	client->query.respkey.name = NULL;
+	client->query.respgen = 0;
 }
 
 static void
@@ -413,6 +451,8 @@ query_next_callback(ns_client_t *client) {
 void
 ns_query_free(ns_client_t *client) {
 	query_reset(client, ISC_TRUE);
+	if (client->query.staletimer != NULL)
+		isc_timer_detach(&client->query.staletimer);
 }
 
 static inline isc_result_t
@@ -622,6 +662,10 @@ ns_query_init(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	client->query.fetch = NULL;
+	client->query.prefetch = NULL;
+	client->query.staletimer = NULL;
+	client->query.stalefetch = NULL;
+	client->query.staletype = 0;
 	client->query.authdb = NULL;
 	client->query.authzone = NULL;
 	client->query.authdbset = ISC_FALSE;
@@ -630,15 +674,24 @@ ns_query_init(ns_client_t *client) {
 	client->query.dns64_sigaaaa = NULL;
 	client->query.dns64_aaaaok = NULL;
 	client->query.dns64_aaaaoklen = 0;
+	result = isc_timer_create(ns_g_timermgr, isc_timertype_inactive,
+				  NULL, NULL, client->task, query_staletimeout,
+				  client, &client->query.staletimer);
+	if (result != ISC_R_SUCCESS) {
+		DESTROYLOCK(&client->query.fetchlock);
+		return (result);
+	}
 	query_reset(client, ISC_FALSE);
 	result = query_newdbversion(client, 3);
 	if (result != ISC_R_SUCCESS) {
+		isc_timer_detach(&client->query.staletimer);
 		DESTROYLOCK(&client->query.fetchlock);
 		return (result);
 	}
 	result = query_newnamebuf(client);
 	if (result != ISC_R_SUCCESS) {
 		query_freefreeversions(client, ISC_TRUE);
+		isc_timer_detach(&client->query.staletimer);
 		DESTROYLOCK(&client->query.fetchlock);
 	}
 
@@ -671,6 +724,7 @@ query_findversion(ns_client_t *client, dns_db_t *db)
 		if (dbversion == NULL)
 			return (NULL);
 		dns_db_attach(db, &dbversion->db);
+		dbversion->generation = dns_db_getgeneration(db);
 		dns_db_currentversion(db, &dbversion->version);
 		dbversion->acl_checked = ISC_FALSE;
 		dbversion->queryok = ISC_FALSE;
@@ -694,6 +748,13 @@ query_validatezonedb(ns_client_t *client, dns_name_t *name,
 	REQUIRE(zone != NULL);
 	REQUIRE(db != NULL);
 
+	/*
+	 * Whether other zones are used depends on the client, so the
+	 * response must not be cached.
+	 */
+	if (client->query.authdbset && db != client->query.authdb)
+		client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	/*
 	 * This limits our searching to the zone where the first name
 	 * (the query target) was looked for.  This prevents following
@@ -991,6 +1052,8 @@ query_getcachedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 	 * is not allowed to use the cache.
 	 */
 
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	if (!USECACHE(client))
 		return (DNS_R_REFUSED);
 	dns_db_attach(client->view->cachedb, &db);
@@ -2550,6 +2613,14 @@ query_addrrset(ns_client_t *client, dns_name_t **namep,
 	    (section == DNS_SECTION_ANSWER ||
 	     section == DNS_SECTION_AUTHORITY))
 		client->query.attributes &= ~NS_QUERYATTR_SECURE;
+	/*
+	 * Stale data from the cache goes out with stale-answer-ttl.
+	 */
+	if ((rdataset->attributes & DNS_RDATASETATTR_STALE) != 0) {
+		rdataset->ttl = client->view->staleanswerttl;
+		if (sigrdataset != NULL)
+			sigrdataset->ttl = client->view->staleanswerttl;
+	}
 	/*
 	 * Note: we only add SIGs if we've added the type they cover, so
 	 * we do not need to check if the SIG rdataset is already in the
@@ -3692,11 +3763,571 @@ query_addnxrrsetnsec(ns_client_t *client, dns_db_t *db,
 		       dbuf, DNS_SECTION_AUTHORITY);
 }
 
+/*
+ * Negative answers synthesized from the cache (RFC 8198).
+ */
+
+static void
+query_synthlog(void *arg, int level, const char *fmt, ...) {
+	ns_client_t *client = arg;
+	va_list ap;
+
+	if (!isc_log_wouldlog(ns_g_lctx, level))
+		return;
+	va_start(ap, fmt);
+	ns_client_logv(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_QUERY,
+		       level, fmt, ap);
+	va_end(ap);
+}
+
+static void
+query_synthrelease(ns_client_t *client, query_synthproof_t *proof) {
+	query_putrdataset(client, &proof->rdataset);
+	query_putrdataset(client, &proof->sigrdataset);
+}
+
+/*
+ * Look up 'name'/'type' in the cache for a synthesized answer and keep
+ * it in 'proof' if it was validated.  With DNS_DBFIND_COVERINGNSEC in
+ * 'options' the record that may cover 'name' is found if 'name' itself
+ * has none.  Returns ISC_R_SUCCESS, DNS_R_COVERINGNSEC or
+ * ISC_R_NOTFOUND.
+ */
+static isc_result_t
+query_synthfind(ns_client_t *client, dns_name_t *name, dns_rdatatype_t type,
+		unsigned int options, query_synthproof_t *proof)
+{
+	isc_result_t result;
+
+	query_synthrelease(client, proof);
+	dns_fixedname_init(&proof->name);
+	proof->rdataset = query_newrdataset(client);
+	proof->sigrdataset = query_newrdataset(client);
+	if (proof->rdataset == NULL || proof->sigrdataset == NULL) {
+		query_synthrelease(client, proof);
+		return (ISC_R_NOTFOUND);
+	}
+
+	result = dns_db_find(client->view->cachedb, name, NULL, type,
+			     options, client->now, NULL,
+			     dns_fixedname_name(&proof->name),
+			     proof->rdataset, proof->sigrdataset);
+	if ((result != ISC_R_SUCCESS && result != DNS_R_COVERINGNSEC) ||
+	    proof->rdataset->type != type ||
+	    proof->rdataset->trust != dns_trust_secure ||
+	    !dns_rdataset_isassociated(proof->sigrdataset) ||
+	    proof->sigrdataset->trust != dns_trust_secure)
+	{
+		query_synthrelease(client, proof);
+		return (ISC_R_NOTFOUND);
+	}
+	return (result);
+}
+
+/*
+ * Whether 'proof' was signed by 'zone'.  An empty 'zone' is set to the
+ * signer.
+ */
+static isc_boolean_t
+query_synthsigner(query_synthproof_t *proof, dns_name_t *zone) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_rrsig_t sig;
+	isc_boolean_t match;
+
+	if (dns_rdataset_first(proof->sigrdataset) != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	dns_rdataset_current(proof->sigrdataset, &rdata);
+	if (dns_rdata_tostruct(&rdata, &sig, NULL) != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	if (dns_name_countlabels(zone) == 0)
+		dns_name_copy(&sig.signer, zone, NULL);
+	match = dns_name_equal(&sig.signer, zone);
+	dns_rdata_freestruct(&sig);
+	return (match);
+}
+
+/*
+ * Find NSEC records in the cache that prove that the current qname, or
+ * 'qtype' at it, does not exist.  The NSEC for the qname or the range
+ * it falls in goes to 'proofs[0]', the one for the wildcard that could
+ * have matched to 'proofs[1]' and the zone that signed them to 'zone'.
+ */
+static isc_result_t
+query_synthnsec(ns_client_t *client, dns_rdatatype_t qtype,
+		query_synthproof_t *proofs, dns_name_t *zone,
+		isc_boolean_t *nxdomain)
+{
+	dns_name_t *qname = client->query.qname;
+	dns_fixedname_t fwild;
+	dns_name_t *wild;
+	isc_boolean_t exists, data;
+	isc_result_t result;
+
+	result = query_synthfind(client, qname, dns_rdatatype_nsec,
+				 DNS_DBFIND_COVERINGNSEC, &proofs[0]);
+	if (result == ISC_R_NOTFOUND ||
+	    !query_synthsigner(&proofs[0], zone) ||
+	    !dns_name_issubdomain(qname, zone))
+		return (ISC_R_NOTFOUND);
+
+	dns_fixedname_init(&fwild);
+	wild = dns_fixedname_name(&fwild);
+	result = dns_nsec_noexistnodata(qtype, qname,
+					dns_fixedname_name(&proofs[0].name),
+					proofs[0].rdataset, &exists, &data,
+					wild, query_synthlog, client);
+	if (result != ISC_R_SUCCESS || (exists && data))
+		return (ISC_R_NOTFOUND);
+	if (exists) {
+		*nxdomain = ISC_FALSE;
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * The qname does not exist.  The wildcard at its closest encloser
+	 * must not exist either, or must have no data of 'qtype'.
+	 */
+	result = query_synthfind(client, wild, dns_rdatatype_nsec,
+				 DNS_DBFIND_COVERINGNSEC, &proofs[1]);
+	if (result == ISC_R_NOTFOUND || !query_synthsigner(&proofs[1], zone))
+		return (ISC_R_NOTFOUND);
+	result = dns_nsec_noexistnodata(qtype, wild,
+					dns_fixedname_name(&proofs[1].name),
+					proofs[1].rdataset, &exists, &data,
+					NULL, query_synthlog, client);
+	if (result != ISC_R_SUCCESS || (exists && data))
+		return (ISC_R_NOTFOUND);
+	*nxdomain = ISC_TF(!exists);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Look up the NSEC3 record for 'name' in 'zone', as query_synthfind()
+ * does.
+ */
+static isc_result_t
+query_synthfind3(ns_client_t *client, dns_name_t *name, dns_name_t *zone,
+		 query_nsec3param_t *param, unsigned int options,
+		 query_synthproof_t *proof)
+{
+	dns_fixedname_t fhashed;
+	isc_result_t result;
+
+	result = dns_nsec3_hashname(&fhashed, NULL, NULL, name, zone,
+				    param->hash, param->iterations,
+				    param->salt, param->salt_length);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	result = query_synthfind(client, dns_fixedname_name(&fhashed),
+				 dns_rdatatype_nsec3, options, proof);
+	if (result != ISC_R_NOTFOUND && !query_synthsigner(proof, zone)) {
+		query_synthrelease(client, proof);
+		result = ISC_R_NOTFOUND;
+	}
+	return (result);
+}
+
+/*
+ * Whether the NSEC3 in 'proof' proves that 'name' does not exist and
+ * is not in an opt-out range.
+ */
+static isc_boolean_t
+query_synthcovers3(ns_client_t *client, dns_name_t *name, dns_name_t *zone,
+		   dns_rdatatype_t qtype, query_synthproof_t *proof)
+{
+	dns_fixedname_t fzone, fclosest, fnearest;
+	isc_boolean_t exists, data, optout = ISC_FALSE, unknown = ISC_FALSE;
+	isc_boolean_t setclosest = ISC_FALSE, setnearest = ISC_FALSE;
+	isc_result_t result;
+
+	dns_fixedname_init(&fzone);
+	dns_name_copy(zone, dns_fixedname_name(&fzone), NULL);
+	dns_fixedname_init(&fclosest);
+	dns_fixedname_init(&fnearest);
+	result = dns_nsec3_noexistnodata(qtype, name,
+					 dns_fixedname_name(&proof->name),
+					 proof->rdataset,
+					 dns_fixedname_name(&fzone),
+					 &exists, &data, &optout, &unknown,
+					 &setclosest, &setnearest,
+					 dns_fixedname_name(&fclosest),
+					 dns_fixedname_name(&fnearest),
+					 query_synthlog, client);
+	return (ISC_TF(result == ISC_R_SUCCESS && !exists && !optout &&
+		       setnearest &&
+		       dns_name_equal(dns_fixedname_name(&fnearest), name)));
+}
+
+/*
+ * Find NSEC3 records of 'zone', the closest zone cut in the cache, that
+ * prove that the current qname, or 'qtype' at it, does not exist.  For
+ * NODATA the NSEC3 matching the qname goes to 'proofs[0]'.  For
+ * NXDOMAIN the ones covering the next closer name, matching the closest
+ * encloser and covering its wildcard go to 'proofs[0]', 'proofs[1]' and
+ * 'proofs[2]'.
+ */
+static isc_result_t
+query_synthnsec3(ns_client_t *client, dns_rdatatype_t qtype,
+		 query_synthproof_t *proofs, dns_name_t *zone,
+		 isc_boolean_t *nxdomain)
+{
+	dns_name_t *qname = client->query.qname;
+	dns_fixedname_t fname, fclosest, fnearest, fzone;
+	dns_name_t *name, *closest;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	query_nsec3param_t param;
+	isc_boolean_t exists, data;
+	isc_boolean_t setclosest = ISC_FALSE, setnearest = ISC_FALSE;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned int labels, zlabels;
+
+	zlabels = dns_name_countlabels(zone);
+	if (zlabels == 0 || !dns_name_issubdomain(qname, zone) ||
+	    dns_name_equal(qname, zone))
+		return (ISC_R_NOTFOUND);
+
+	/*
+	 * Every hashed name of the zone sorts before this one, so the
+	 * record that covers it is the last NSEC3 of the zone in the
+	 * cache.  It tells how the zone hashes its names.
+	 */
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+	isc_buffer_constinit(&b, "vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv", 32);
+	isc_buffer_add(&b, 32);
+	if (dns_name_fromtext(name, &b, zone, 0, NULL) != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	result = query_synthfind(client, name, dns_rdatatype_nsec3,
+				 DNS_DBFIND_COVERINGNSEC, &proofs[0]);
+	if (result == ISC_R_NOTFOUND)
+		return (ISC_R_NOTFOUND);
+	if (dns_rdataset_first(proofs[0].rdataset) != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	dns_rdataset_current(proofs[0].rdataset, &rdata);
+	if (dns_rdata_tostruct(&rdata, &nsec3, NULL) != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	param.hash = nsec3.hash;
+	param.iterations = nsec3.iterations;
+	param.salt_length = nsec3.salt_length;
+	memmove(param.salt, nsec3.salt, nsec3.salt_length);
+	dns_rdata_freestruct(&nsec3);
+	if (!dns_nsec3_supportedhash(param.hash) ||
+	    param.iterations > NS_SYNTH_MAXITERATIONS)
+		return (ISC_R_NOTFOUND);
+
+	/*
+	 * An NSEC3 matching the qname can prove NODATA.  Otherwise the
+	 * record covering it is needed if the qname is the next closer
+	 * name.
+	 */
+	result = query_synthfind3(client, qname, zone, &param,
+				  DNS_DBFIND_COVERINGNSEC, &proofs[0]);
+	if (result == ISC_R_NOTFOUND)
+		return (ISC_R_NOTFOUND);
+	if (result == ISC_R_SUCCESS) {
+		dns_fixedname_init(&fzone);
+		dns_name_copy(zone, dns_fixedname_name(&fzone), NULL);
+		result = dns_nsec3_noexistnodata(qtype, qname,
+					dns_fixedname_name(&proofs[0].name),
+					proofs[0].rdataset,
+					dns_fixedname_name(&fzone),
+					&exists, &data, NULL, NULL,
+					NULL, NULL, NULL, NULL,
+					query_synthlog, client);
+		if (result != ISC_R_SUCCESS || !exists || data)
+			return (ISC_R_NOTFOUND);
+		*nxdomain = ISC_FALSE;
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Find the closest encloser: the longest ancestor of the qname
+	 * with a matching NSEC3 that is not at a delegation.
+	 */
+	dns_fixedname_init(&fclosest);
+	closest = dns_fixedname_name(&fclosest);
+	for (labels = dns_name_countlabels(qname) - 1;
+	     labels >= zlabels;
+	     labels--)
+	{
+		dns_name_split(qname, labels, NULL, name);
+		result = query_synthfind3(client, name, zone, &param, 0,
+					  &proofs[1]);
+		if (result == ISC_R_SUCCESS)
+			break;
+	}
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	dns_fixedname_init(&fzone);
+	dns_name_copy(zone, dns_fixedname_name(&fzone), NULL);
+	dns_fixedname_init(&fnearest);
+	(void)dns_nsec3_noexistnodata(qtype, qname,
+				      dns_fixedname_name(&proofs[1].name),
+				      proofs[1].rdataset,
+				      dns_fixedname_name(&fzone),
+				      &exists, &data, NULL, NULL,
+				      &setclosest, &setnearest, closest,
+				      dns_fixedname_name(&fnearest),
+				      query_synthlog, client);
+	if (!setclosest || !dns_name_equal(closest, name))
+		return (ISC_R_NOTFOUND);
+
+	/*
+	 * The next closer name must be covered.  proofs[0] already
+	 * covers the qname.
+	 */
+	dns_name_split(qname, labels + 1, NULL, name);
+	if (!dns_name_equal(name, qname)) {
+		result = query_synthfind3(client, name, zone, &param,
+					  DNS_DBFIND_COVERINGNSEC,
+					  &proofs[0]);
+		if (result != DNS_R_COVERINGNSEC)
+			return (ISC_R_NOTFOUND);
+	}
+	if (!query_synthcovers3(client, name, zone, qtype, &proofs[0]))
+		return (ISC_R_NOTFOUND);
+
+	/*
+	 * And so must the wildcard at the closest encloser.
+	 */
+	result = dns_name_concatenate(dns_wildcardname, closest, name, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+	result = query_synthfind3(client, name, zone, &param,
+				  DNS_DBFIND_COVERINGNSEC, &proofs[2]);
+	if (result != DNS_R_COVERINGNSEC ||
+	    !query_synthcovers3(client, name, zone, qtype, &proofs[2]))
+		return (ISC_R_NOTFOUND);
+
+	*nxdomain = ISC_TRUE;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Add 'proof' to the authority section with a TTL of no more than 'ttl'.
+ */
+static void
+query_synthadd(ns_client_t *client, query_synthproof_t *proof,
+	       dns_ttl_t ttl)
+{
+	isc_buffer_t *dbuf, b;
+	dns_name_t *name;
+	dns_rdataset_t **sigrdatasetp = NULL;
+
+	if (proof->rdataset == NULL)
+		return;
+	dbuf = query_getnamebuf(client);
+	if (dbuf == NULL)
+		return;
+	name = query_newname(client, dbuf, &b);
+	if (name == NULL)
+		return;
+	dns_name_copy(dns_fixedname_name(&proof->name), name, NULL);
+	if (proof->rdataset->ttl > ttl)
+		proof->rdataset->ttl = ttl;
+	if (proof->sigrdataset->ttl > ttl)
+		proof->sigrdataset->ttl = ttl;
+	if (WANTDNSSEC(client))
+		sigrdatasetp = &proof->sigrdataset;
+	query_addrrset(client, &name, &proof->rdataset, sigrdatasetp, dbuf,
+		       DNS_SECTION_AUTHORITY);
+}
+
+/*
+ * Before recursing for 'qtype' at the current qname, see whether
+ * validated NSEC or NSEC3 records in the cache already prove that it
+ * does not exist.  If they do, make the NXDOMAIN or NODATA answer from
+ * them and the SOA of their zone, and return ISC_TRUE.  'cut' is the
+ * deepest zone cut for the qname in the cache.
+ */
+static isc_boolean_t
+query_synthnegative(ns_client_t *client, dns_rdatatype_t qtype,
+		    dns_name_t *cut)
+{
+	query_synthproof_t proofs[3], soa;
+	dns_fixedname_t fzone;
+	dns_name_t *zone;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_soa_t soardata;
+	dns_ttl_t ttl;
+	isc_boolean_t nxdomain = ISC_FALSE, answered = ISC_FALSE;
+	isc_result_t result;
+	unsigned int i;
+
+	if (!client->view->synthfromdnssec ||
+	    !client->view->enablevalidation ||
+	    client->view->cachedb == NULL ||
+	    dns_rdatatype_ismeta(qtype) ||
+	    qtype == dns_rdatatype_rrsig || qtype == dns_rdatatype_sig ||
+	    qtype == dns_rdatatype_nsec || qtype == dns_rdatatype_nsec3)
+		return (ISC_FALSE);
+
+	memset(proofs, 0, sizeof(proofs));
+	memset(&soa, 0, sizeof(soa));
+
+	dns_fixedname_init(&fzone);
+	zone = dns_fixedname_name(&fzone);
+	result = query_synthnsec(client, qtype, proofs, zone, &nxdomain);
+	if (result == ISC_R_SUCCESS && !dns_name_issubdomain(zone, cut))
+		result = ISC_R_NOTFOUND;
+	if (result != ISC_R_SUCCESS) {
+		for (i = 0; i < 3; i++)
+			query_synthrelease(client, &proofs[i]);
+		dns_name_copy(cut, zone, NULL);
+		result = query_synthnsec3(client, qtype, proofs, zone,
+					  &nxdomain);
+	}
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	/*
+	 * The answer needs the SOA of the zone.  Its TTL, and those of
+	 * the proofs, are capped by the SOA MINIMUM as for any negative
+	 * answer.
+	 */
+	result = query_synthfind(client, zone, dns_rdatatype_soa, 0, &soa);
+	if (result != ISC_R_SUCCESS || !query_synthsigner(&soa, zone))
+		goto cleanup;
+	result = dns_rdataset_first(soa.rdataset);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	dns_rdataset_current(soa.rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &soardata, NULL);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	ttl = ISC_MIN(soa.rdataset->ttl, soardata.minimum);
+	dns_rdata_freestruct(&soardata);
+
+	query_synthadd(client, &soa, ttl);
+	if (WANTDNSSEC(client)) {
+		for (i = 0; i < 3; i++)
+			query_synthadd(client, &proofs[i], ttl);
+	}
+	if (nxdomain)
+		client->message->rcode = dns_rcode_nxdomain;
+	if (client->view->resstats != NULL)
+		isc_stats_increment(client->view->resstats,
+				    nxdomain ?
+				    dns_resstatscounter_synthnxdomain :
+				    dns_resstatscounter_synthnodata);
+	answered = ISC_TRUE;
+
+ cleanup:
+	for (i = 0; i < 3; i++)
+		query_synthrelease(client, &proofs[i]);
+	query_synthrelease(client, &soa);
+	return (answered);
+}
+
+/*
+ * Whether 'client' can be sent a stale answer instead of waiting for, or
+ * failing with, its recursion for 'qtype' at its current qname.  That
+ * needs serve-stale in the view, a recursion for the answer itself and
+ * not for DNS64, filter-aaaa or RPZ, and expired data for it in the
+ * cache.
+ */
+static isc_boolean_t
+query_canservestale(ns_client_t *client, dns_rdatatype_t qtype) {
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	if (!client->view->staleanswersok || client->view->cachedb == NULL ||
+	    (client->query.dboptions & DNS_DBFIND_STALEOK) != 0 ||
+	    DNS64(client) || DNS64EXCLUDE(client) ||
+	    (client->query.rpz_st != NULL &&
+	     (client->query.rpz_st->state & DNS_RPZ_RECURSING) != 0))
+		return (ISC_FALSE);
+#ifdef ALLOW_FILTER_AAAA_ON_V4
+	if ((client->attributes & NS_CLIENTATTR_FILTER_AAAA_RC) != 0)
+		return (ISC_FALSE);
+#endif
+
+	if (qtype == dns_rdatatype_rrsig || qtype == dns_rdatatype_sig)
+		qtype = dns_rdatatype_any;
+	dns_fixedname_init(&fixed);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(client->view->cachedb, client->query.qname, NULL,
+			     qtype, DNS_DBFIND_STALEOK, client->now, NULL,
+			     dns_fixedname_name(&fixed), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_CNAME:
+	case DNS_R_DNAME:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+		return (ISC_TRUE);
+	default:
+		return (ISC_FALSE);
+	}
+}
+
+/*
+ * Answer 'client' from the cache again, this time accepting stale data.
+ */
+static void
+query_servestale(ns_client_t *client, dns_rdatatype_t qtype,
+		 isc_statscounter_t counter)
+{
+	client->query.dboptions |= DNS_DBFIND_STALEOK;
+	if (client->view->resstats != NULL)
+		isc_stats_increment(client->view->resstats, counter);
+	(void)query_find(client, NULL, qtype);
+}
+
+/*
+ * The client has waited stale-answer-client-timeout for its recursion.
+ * If the cache has stale data for it, send that now and leave the fetch
+ * running in the background to refresh the cache; query_resume() will
+ * then only clean up after it.  The client is held until then.
+ */
+static void
+query_staletimeout(isc_task_t *task, isc_event_t *event) {
+	ns_client_t *client;
+	ns_client_t *dummy = NULL;
+	isc_boolean_t handoff = ISC_FALSE;
+
+	UNUSED(task);
+
+	client = event->ev_arg;
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(task == client->task);
+	isc_event_free(&event);
+
+	if (!RECURSING(client) || client->query.stalefetch != NULL ||
+	    ns_client_shuttingdown(client))
+		return;
+	isc_stdtime_get(&client->now);
+	if (!query_canservestale(client, client->query.staletype))
+		return;
+
+	LOCK(&client->query.fetchlock);
+	if (client->query.fetch != NULL) {
+		client->query.stalefetch = client->query.fetch;
+		client->query.fetch = NULL;
+		handoff = ISC_TRUE;
+	}
+	UNLOCK(&client->query.fetchlock);
+	if (!handoff)
+		return;
+
+	ns_client_attach(client, &dummy);
+	client->query.attributes &= ~NS_QUERYATTR_RECURSING;
+	query_servestale(client, client->query.staletype,
+			 dns_resstatscounter_staletimeout);
+}
+
 static void
 query_resume(isc_task_t *task, isc_event_t *event) {
 	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
 	dns_fetch_t *fetch;
 	ns_client_t *client;
+	dns_rdatatype_t qtype;
 	isc_boolean_t fetch_canceled, client_shuttingdown;
 	isc_result_t result;
 	isc_logcategory_t *logcategory = NS_LOGCATEGORY_QUERY_EERRORS;
@@ -3712,9 +4343,32 @@ query_resume(isc_task_t *task, isc_event_t *event) {
 	client = devent->ev_arg;
 	REQUIRE(NS_CLIENT_VALID(client));
 	REQUIRE(task == client->task);
-	REQUIRE(RECURSING(client));
 
 	LOCK(&client->query.fetchlock);
+	if (client->query.stalefetch != NULL &&
+	    devent->fetch == client->query.stalefetch) {
+		/*
+		 * The client has been sent a stale answer, and this fetch
+		 * was only left running to refresh the cache.
+		 */
+		client->query.stalefetch = NULL;
+		UNLOCK(&client->query.fetchlock);
+		if (devent->node != NULL)
+			dns_db_detachnode(devent->db, &devent->node);
+		if (devent->db != NULL)
+			dns_db_detach(&devent->db);
+		query_putrdataset(client, &devent->rdataset);
+		if (devent->sigrdataset != NULL)
+			query_putrdataset(client, &devent->sigrdataset);
+		dns_resolver_destroyfetch(&devent->fetch);
+		isc_event_free(&event);
+		/*
+		 * This may let the client go on to its next request.
+		 */
+		ns_client_detach(&client);
+		return;
+	}
+	REQUIRE(RECURSING(client));
 	if (client->query.fetch != NULL) {
 		/*
 		 * This is the fetch we've been waiting for.
@@ -3762,6 +4416,24 @@ query_resume(isc_task_t *task, isc_event_t *event) {
 		 * This may destroy the client.
 		 */
 		ns_client_detach(&client);
+	} else if ((devent->result == ISC_R_TIMEDOUT ||
+		    devent->result == ISC_R_FAILURE ||
+		    devent->result == DNS_R_SERVFAIL) &&
+		   query_canservestale(client, devent->qtype)) {
+		/*
+		 * Rather than fail, answer with what the cache had.
+		 */
+		qtype = devent->qtype;
+		if (devent->node != NULL)
+			dns_db_detachnode(devent->db, &devent->node);
+		if (devent->db != NULL)
+			dns_db_detach(&devent->db);
+		query_putrdataset(client, &devent->rdataset);
+		if (devent->sigrdataset != NULL)
+			query_putrdataset(client, &devent->sigrdataset);
+		isc_event_free(&event);
+		query_servestale(client, qtype,
+				 dns_resstatscounter_stalefailure);
 	} else {
 		result = query_find(client, devent, 0);
 		if (result != ISC_R_SUCCESS) {
@@ -3781,6 +4453,129 @@ query_resume(isc_task_t *task, isc_event_t *event) {
 	dns_resolver_destroyfetch(&fetch);
 }
 
+static void
+prefetch_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
+	ns_client_t *client;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	REQUIRE(event->ev_type == DNS_EVENT_FETCHDONE);
+	client = devent->ev_arg;
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(task == client->task);
+
+	LOCK(&client->query.fetchlock);
+	INSIST(devent->fetch == client->query.prefetch);
+	client->query.prefetch = NULL;
+	UNLOCK(&client->query.fetchlock);
+
+	/*
+	 * Had the answer been allowed to expire, the next client to ask
+	 * for it would have waited this long.
+	 */
+	if (devent->rdataset != NULL &&
+	    dns_rdataset_isassociated(devent->rdataset)) {
+		TIME_NOW(&now);
+		isc_stats_add(ns_g_server->nsstats,
+			      dns_nsstatscounter_prefetchsaved,
+			      (isc_uint32_t)(isc_time_microdiff(&now,
+					     &client->query.prefetchtime) /
+					     1000));
+	}
+
+	if (devent->node != NULL)
+		dns_db_detachnode(devent->db, &devent->node);
+	if (devent->db != NULL)
+		dns_db_detach(&devent->db);
+	query_putrdataset(client, &devent->rdataset);
+	dns_resolver_destroyfetch(&devent->fetch);
+	isc_event_free(&event);
+	/*
+	 * This may let the client go on to its next request.
+	 */
+	ns_client_detach(&client);
+}
+
+/*
+ * 'rdataset' is an answer to 'qname' from the cache.  If it will soon
+ * expire and has been asked for often enough, refresh it in the
+ * background so that clients keep getting it from the cache.  The
+ * client is held until the refresh is done.
+ */
+static void
+query_prefetch(ns_client_t *client, dns_name_t *qname,
+	       dns_rdataset_t *rdataset)
+{
+	isc_result_t result;
+	isc_sockaddr_t *peeraddr;
+	dns_rdataset_t *tmprdataset;
+	ns_client_t *dummy = NULL;
+
+	if (client->query.prefetch != NULL ||
+	    (rdataset->attributes & DNS_RDATASETATTR_STALE) != 0 ||
+	    client->view->prefetch_trigger == 0U ||
+	    rdataset->ttl > client->view->prefetch_trigger ||
+	    !dns_rdataset_prefetch(rdataset, client->view->prefetch_hits))
+		return;
+
+	if (client->recursionquota == NULL) {
+		result = isc_quota_attach(&ns_g_server->recursionquota,
+					  &client->recursionquota);
+		if (result == ISC_R_SOFTQUOTA) {
+			isc_quota_detach(&client->recursionquota);
+			result = ISC_R_QUOTA;
+		}
+		if (result == ISC_R_SUCCESS && !client->mortal &&
+		    (client->attributes & NS_CLIENTATTR_TCP) == 0) {
+			result = ns_client_replace(client);
+			if (result != ISC_R_SUCCESS)
+				isc_quota_detach(&client->recursionquota);
+		}
+		if (result != ISC_R_SUCCESS)
+			return;
+	}
+
+	tmprdataset = query_newrdataset(client);
+	if (tmprdataset == NULL)
+		return;
+	if ((client->attributes & NS_CLIENTATTR_TCP) == 0)
+		peeraddr = &client->peeraddr;
+	else
+		peeraddr = NULL;
+	ns_client_attach(client, &dummy);
+	TIME_NOW(&client->query.prefetchtime);
+	result = dns_resolver_createfetch3(client->view->resolver,
+					   qname, rdataset->type, NULL, NULL,
+					   NULL, peeraddr, client->message->id,
+					   client->query.fetchoptions |
+					   DNS_FETCHOPT_PREFETCH, 0, NULL,
+					   client->task, prefetch_done, client,
+					   tmprdataset, NULL,
+					   &client->query.prefetch);
+	if (result != ISC_R_SUCCESS) {
+		query_putrdataset(client, &tmprdataset);
+		ns_client_detach(&dummy);
+		return;
+	}
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_prefetch);
+}
+
+/*
+ * Give the client stale-answer-client-timeout to wait for its recursion,
+ * counted from the first recursion for the request.
+ */
+static void
+query_setstaletimer(ns_client_t *client) {
+	isc_interval_t interval;
+	unsigned int msec = client->view->staleanswerclienttimeout;
+
+	isc_interval_set(&interval, msec / 1000, (msec % 1000) * 1000000);
+	(void)isc_timer_reset(client->query.staletimer, isc_timertype_once,
+			      NULL, &interval, ISC_TRUE);
+}
+
 static isc_result_t
 query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	      dns_name_t *qdomain, dns_rdataset_t *nameservers,
@@ -3790,6 +4585,8 @@ query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	dns_rdataset_t *rdataset, *sigrdataset;
 	isc_sockaddr_t *peeraddr;
 
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	if (!resuming)
 		inc_stats(client, dns_nsstatscounter_recursion);
 
@@ -3897,6 +4694,12 @@ query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		 * is shutting down will not be destroyed until all the
 		 * events have been received.
 		 */
+		if (qname == client->query.qname) {
+			client->query.staletype = qtype;
+			if (!resuming && client->view->staleanswersok &&
+			    client->view->staleanswerclienttimeout != 0)
+				query_setstaletimer(client);
+		}
 	} else {
 		query_putrdataset(client, &rdataset);
 		if (sigrdataset != NULL)
@@ -5483,6 +6286,11 @@ redirect(ns_client_t *client, dns_name_t *name, dns_rdataset_t *rdataset,
 	if (client->view->redirect == NULL)
 		return (ISC_R_NOTFOUND);
 
+	/*
+	 * The redirect zone has its own access list and generation.
+	 */
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	dns_fixedname_init(&fixed);
 	found = dns_fixedname_name(&fixed);
 	dns_rdataset_init(&trdataset);
@@ -5576,6 +6384,91 @@ redirect(ns_client_t *client, dns_name_t *name, dns_rdataset_t *rdataset,
 	return (result);
 }
 
+/*
+ * Can the response to this query be taken from, or stored in, the
+ * response cache?  Only UDP queries without a signature whose answers
+ * do not depend on who is asking qualify.
+ */
+static isc_boolean_t
+respcacheok(ns_client_t *client) {
+	dns_view_t *view = client->view;
+
+	if (view->respcache == NULL)
+		return (ISC_FALSE);
+	if ((client->attributes &
+	     (NS_CLIENTATTR_TCP | NS_CLIENTATTR_WANTNSID)) != 0)
+		return (ISC_FALSE);
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL)
+		return (ISC_FALSE);
+	if (view->acache != NULL || view->sortlist != NULL ||
+	    view->nocasecompress != NULL || view->dns64cnt != 0 ||
+	    !ISC_LIST_EMPTY(view->rpz_zones))
+		return (ISC_FALSE);
+#ifdef USE_RRL
+	if (view->rrl != NULL)
+		return (ISC_FALSE);
+#endif /* USE_RRL */
+#ifdef ALLOW_FILTER_AAAA_ON_V4
+	if (view->v4_aaaa != dns_v4_aaaa_ok)
+		return (ISC_FALSE);
+#endif
+	return (ISC_TRUE);
+}
+
+/*
+ * Answer the query from the response cache if a response made from
+ * the current generation of 'db' is there, returning ISC_TRUE once it
+ * has been sent.  Otherwise mark the query so that the response it
+ * gets is stored.
+ */
+static isc_boolean_t
+query_respcache(ns_client_t *client, dns_db_t *db) {
+	ns_dbversion_t *dbversion;
+	dns_rdataset_t *rdataset;
+	dns_respkey_t *key = &client->query.respkey;
+	unsigned int flags = 0;
+
+	if (!respcacheok(client))
+		return (ISC_FALSE);
+
+	dbversion = query_findversion(client, db);
+	if (dbversion == NULL || dbversion->generation == 0)
+		return (ISC_FALSE);
+
+	if (WANTDNSSEC(client))
+		flags |= NS_RESPKEY_DNSSEC;
+	if (WANTAD(client))
+		flags |= NS_RESPKEY_AD;
+	if (client->opt != NULL)
+		flags |= NS_RESPKEY_EDNS;
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0)
+		flags |= NS_RESPKEY_CD;
+	if (RECURSIONOK(client))
+		flags |= NS_RESPKEY_RECURSIONOK;
+	if (USECACHE(client))
+		flags |= NS_RESPKEY_CACHEOK;
+	if (NOAUTHORITY(client))
+		flags |= NS_RESPKEY_NOAUTHORITY;
+	if (NOADDITIONAL(client))
+		flags |= NS_RESPKEY_NOADDITIONAL;
+
+	rdataset = ISC_LIST_HEAD(client->query.origqname->list);
+	INSIST(rdataset != NULL);
+
+	key->name = client->query.origqname;
+	key->type = rdataset->type;
+	key->rdclass = client->message->rdclass;
+	key->flags = flags;
+
+	if (ns_client_sendcached(client, dbversion->generation))
+		return (ISC_TRUE);
+
+	client->query.respgen = dbversion->generation;
+	client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+	return (ISC_FALSE);
+}
+
 /*
  * Do the bulk of query processing for the current query of 'client'.
  * If 'event' is non-NULL, we are returning from recursion and 'qtype'
@@ -5859,6 +6752,15 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 			dns_db_attach(db, &client->query.authdb);
 		}
 		client->query.authdbset = ISC_TRUE;
+
+		if (is_zone && zone != NULL && !is_staticstub_zone &&
+		    query_respcache(client, db))
+		{
+			dns_db_detach(&db);
+			dns_zone_detach(&zone);
+			ns_client_detach(&client);
+			return (ISC_R_SUCCESS);
+		}
 	}
 
  db_find:
@@ -6357,6 +7259,19 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 				goto db_find;
 			}
 		} else {
+			if (RECURSIONOK(client) && zfname == NULL && !dns64 &&
+			    client->view->synthfromdnssec)
+			{
+				/*
+				 * Validated NSEC or NSEC3 records in the
+				 * cache may already prove that there is
+				 * nothing to recurse for.
+				 */
+				query_keepname(client, fname, dbuf);
+				dbuf = NULL;
+				if (query_synthnegative(client, qtype, fname))
+					goto cleanup;
+			}
 			if (zfname != NULL &&
 			    (!dns_name_issubdomain(fname, zfname) ||
 			     (is_staticstub_zone &&
@@ -6872,6 +7787,8 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 		goto cleanup;
 
 	case DNS_R_CNAME:
+		if (!is_zone && RECURSIONOK(client))
+			query_prefetch(client, fname, rdataset);
 		/*
 		 * Keep a copy of the rdataset.  We have to do this because
 		 * query_addrrset may clear 'rdataset' (to prevent the
@@ -7084,6 +8001,9 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 
 #endif
 
+	if (!is_zone && RECURSIONOK(client) && type != dns_rdatatype_any)
+		query_prefetch(client, fname, rdataset);
+
 	if (type == dns_rdatatype_any) {
 #ifdef ALLOW_FILTER_AAAA_ON_V4
 		isc_boolean_t have_aaaa, have_a, have_sig;
@@ -7570,6 +8490,12 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 		     client->message->rcode != dns_rcode_noerror))
 			eresult = ISC_R_FAILURE;
 
+		/*
+		 * A partial answer left by a failure is not cached.
+		 */
+		if (eresult != ISC_R_SUCCESS)
+			client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 		query_send(client);
 		ns_client_detach(&client);
 	}
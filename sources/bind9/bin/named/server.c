@@ -79,8 +79,10 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/secalg.h>
+#include <dns/sigcache.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -2092,7 +2094,11 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	isc_result_t result;
 	unsigned int cleaning_interval;
 	size_t max_cache_size;
+	dns_ttl_t max_stale_ttl;
 	size_t max_acache_size;
+	isc_uint64_t respcache_size;
+	isc_uint64_t sigcache_size;
+	isc_uint32_t verifytasks;
 	size_t max_adb_size;
 	isc_uint32_t lame_ttl;
 	dns_tsig_keyring_t *ring = NULL;
@@ -2105,6 +2111,8 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	int i = 0, j = 0, k = 0;
 	const char *str;
 	const char *cachename = NULL;
+	char nodelocks[sizeof("4294967295")], shards[sizeof("4294967295")];
+	char *db_argv[2];
 	dns_order_t *order = NULL;
 	isc_uint32_t udpsize;
 	isc_uint32_t maxbits;
@@ -2205,6 +2213,52 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		dns_acache_setcachesize(view->acache, max_acache_size);
 	}
 
+	/*
+	 * Create the response cache if it has been given a size.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "response-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	respcache_size = cfg_obj_asuint64(obj);
+	if (respcache_size > SIZE_MAX) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "'response-cache-size "
+			    "%" ISC_PRINT_QUADFORMAT "u' "
+			    "is too large for this "
+			    "system; reducing to %lu",
+			    respcache_size, (unsigned long)SIZE_MAX);
+		respcache_size = SIZE_MAX;
+	}
+	if (respcache_size != 0) {
+		cmctx = NULL;
+		CHECK(isc_mem_create(0, 0, &cmctx));
+		isc_mem_setname(cmctx, "respcache", NULL);
+		result = dns_respcache_create(cmctx, (size_t)respcache_size,
+					      &view->respcache);
+		isc_mem_detach(&cmctx);
+		CHECK(result);
+	}
+
+	/*
+	 * Create the cache of signature verification results.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "dnssec-verify-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	sigcache_size = cfg_obj_asuint64(obj);
+	if (sigcache_size > SIZE_MAX) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "'dnssec-verify-cache-size "
+			    "%" ISC_PRINT_QUADFORMAT "u' "
+			    "is too large for this "
+			    "system; reducing to %lu",
+			    sigcache_size, (unsigned long)SIZE_MAX);
+		sigcache_size = SIZE_MAX;
+	}
+	if (sigcache_size != 0)
+		CHECK(dns_sigcache_create(mctx, (size_t)sigcache_size,
+					  &view->sigcache));
+
 	CHECK(configure_view_acl(vconfig, config, "allow-query", NULL, actx,
 				 ns_g_mctx, &view->queryacl));
 	if (view->queryacl == NULL) {
@@ -2553,6 +2607,54 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	if (view->maxncachettl > 7 * 24 * 3600)
 		view->maxncachettl = 7 * 24 * 3600;
 
+	obj = NULL;
+	result = ns_config_get(maps, "prefetch", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	{
+		const cfg_obj_t *trigger, *hits;
+
+		trigger = cfg_tuple_get(obj, "trigger");
+		view->prefetch_trigger = cfg_obj_asuint32(trigger);
+		if (view->prefetch_trigger > 10)
+			view->prefetch_trigger = 10;
+		hits = cfg_tuple_get(obj, "hits");
+		if (cfg_obj_isvoid(hits))
+			view->prefetch_hits = 5;
+		else
+			view->prefetch_hits = cfg_obj_asuint32(hits);
+	}
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-enable", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswersok = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswerttl = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-client-timeout", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswerclienttimeout = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "synth-from-dnssec", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->synthfromdnssec = cfg_obj_asboolean(obj);
+
+	/*
+	 * Expired data is only kept in the cache if it can be served.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "max-stale-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (view->staleanswersok)
+		max_stale_ttl = cfg_obj_asuint32(obj);
+	else
+		max_stale_ttl = 0;
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -2648,9 +2750,15 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 			isc_mem_setname(cmctx, "cache", NULL);
 			CHECK(isc_mem_create(0, 0, &hmctx));
 			isc_mem_setname(hmctx, "cache_heap", NULL);
+			snprintf(nodelocks, sizeof(nodelocks), "%u",
+				 ns_g_cachenodelocks);
+			snprintf(shards, sizeof(shards), "%u",
+				 ns_g_cacheshards);
+			db_argv[0] = nodelocks;
+			db_argv[1] = shards;
 			CHECK(dns_cache_create3(cmctx, hmctx, ns_g_taskmgr,
 						ns_g_timermgr, view->rdclass,
-						cachename, "rbt", 0, NULL,
+						cachename, "rbt", 2, db_argv,
 						&cache));
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
@@ -2684,6 +2792,7 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 
 	dns_cache_setcleaninginterval(cache, cleaning_interval);
 	dns_cache_setcachesize(cache, max_cache_size);
+	dns_cache_setservestalettl(cache, max_stale_ttl);
 
 	dns_cache_detach(&cache);
 
@@ -2712,6 +2821,18 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 				      resopts, ns_g_dispatchmgr,
 				      dispatch4, dispatch6));
 
+	/*
+	 * Verify signatures on a pool of tasks, by default one for each
+	 * CPU, rather than on the tasks of the fetches being validated.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "dnssec-verify-tasks", &obj);
+	if (result == ISC_R_SUCCESS)
+		verifytasks = cfg_obj_asuint32(obj);
+	else
+		verifytasks = ns_g_cpus;
+	CHECK(dns_resolver_setverifytasks(view->resolver, verifytasks));
+
 	if (resstats == NULL) {
 		CHECK(isc_stats_create(mctx, &resstats,
 				       dns_resstatscounter_max));
@@ -4913,10 +5034,14 @@ load_configuration(const char *filename, ns_server_t *server,
 	isc_portset_t *v6portset = NULL;
 	isc_resourcevalue_t nfiles;
 	isc_result_t result;
+	isc_uint32_t cachenodelocks;
+	isc_uint32_t cacheshards;
 	isc_uint32_t heartbeat_interval;
 	isc_uint32_t interface_interval;
 	isc_uint32_t reserved;
+	isc_uint32_t udpbatch;
 	isc_uint32_t udpsize;
+	isc_uint32_t watchers;
 	ns_cache_t *nsc;
 	ns_cachelist_t cachelist, tmpcachelist;
 	struct cfg_context *nzctx;
@@ -5075,6 +5200,101 @@ load_configuration(const char *filename, ns_server_t *server,
 	}
 	isc__socketmgr_setreserved(ns_g_socketmgr, reserved);
 
+	/*
+	 * Set the number of UDP datagrams moved per batched system call.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "udp-batch-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	udpbatch = cfg_obj_asuint32(obj);
+	if (udpbatch > ISC_SOCKET_MAXBATCH) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "udp-batch-size %u is too large, using %u",
+			    udpbatch, ISC_SOCKET_MAXBATCH);
+		udpbatch = ISC_SOCKET_MAXBATCH;
+	}
+	result = isc__socketmgr_setudpbatch(ns_g_socketmgr, udpbatch);
+	if (result == ISC_R_NOTIMPLEMENTED)
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "udp-batch-size: batched UDP I/O is not "
+			    "supported on this system");
+
+	/*
+	 * Set the number of socket watcher threads.  This can only be
+	 * done before any socket has been opened, i.e., at startup.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "watcher-threads", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	watchers = cfg_obj_asuint32(obj);
+	if (watchers == 0)
+		watchers = 1;
+	result = isc__socketmgr_setnthreads(ns_g_socketmgr, (int)watchers);
+	if (result == ISC_R_NOTIMPLEMENTED)
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "watcher-threads: multiple socket watchers are "
+			    "not supported on this system");
+	else if (result == ISC_R_EXISTS)
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "watcher-threads: change requires a restart");
+	else if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	else if (first_time && watchers > 1)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "using %u socket watcher threads", watchers);
+
+	/*
+	 * Set the number of shards and node locks of the view caches.
+	 * Caches that are reused across a reload keep their layout, so
+	 * these only take effect at startup.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "cache-shards", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cacheshards = cfg_obj_asuint32(obj);
+	if (cacheshards == 0)
+		cacheshards = 1;
+	if (cacheshards > (1U << DNS_RBT_TAGLENGTH)) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "cache-shards %u is too large, using %u",
+			    cacheshards, 1U << DNS_RBT_TAGLENGTH);
+		cacheshards = 1U << DNS_RBT_TAGLENGTH;
+	}
+	if (first_time)
+		ns_g_cacheshards = cacheshards;
+	else if (cacheshards != ns_g_cacheshards)
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "cache-shards: change requires a restart");
+
+	obj = NULL;
+	result = ns_config_get(maps, "cache-node-locks", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cachenodelocks = cfg_obj_asuint32(obj);
+	if (cachenodelocks == 0) {
+		/*
+		 * Scale with the number of worker threads.
+		 */
+		cachenodelocks = ISC_MAX(16, 4 * ns_g_cpus);
+	} else if (cachenodelocks < 2) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "cache-node-locks %u is too small, using 2",
+			    cachenodelocks);
+		cachenodelocks = 2;
+	}
+	if (cachenodelocks >= (1U << DNS_RBT_LOCKLENGTH))
+		cachenodelocks = (1U << DNS_RBT_LOCKLENGTH) - 1;
+	if (first_time)
+		ns_g_cachenodelocks = cachenodelocks;
+	else if (cachenodelocks != ns_g_cachenodelocks)
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "cache-node-locks: change requires a restart");
+	if (first_time && ns_g_cacheshards > 1)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "using %u cache shards with %u node locks each",
+			      ns_g_cacheshards, ns_g_cachenodelocks);
+
 	/*
 	 * Configure various server options.
 	 */
@@ -5279,6 +5499,12 @@ load_configuration(const char *filename, ns_server_t *server,
 		}
 	}
 
+	obj = NULL;
+	result = ns_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setreuseport(server->interfacemgr,
+				     cfg_obj_asboolean(obj));
+
 	/*
 	 * Rescan the interface list to pick up changes in the
 	 * listen-on option.  It's important that we do this before we try
@@ -6193,6 +6419,12 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
+	server->taskstats = NULL;
+	CHECKFATAL(isc_stats_create(server->mctx, &server->taskstats,
+				    isc_taskstatscounter_max),
+		   "isc_stats_create");
+	isc_taskmgr_setstats(ns_g_taskmgr, server->taskstats);
+
 	server->bindkeysfile = isc_mem_strdup(server->mctx, "bind.keys");
 	CHECKFATAL(server->bindkeysfile == NULL ? ISC_R_NOMEMORY :
 						  ISC_R_SUCCESS,
@@ -6273,6 +6505,7 @@ ns_server_destroy(ns_server_t **serverp) {
 	isc_stats_detach(&server->zonestats);
 	isc_stats_detach(&server->resolverstats);
 	isc_stats_detach(&server->sockstats);
+	isc_stats_detach(&server->taskstats);
 
 	isc_mem_free(server->mctx, server->statsfile);
 	isc_mem_free(server->mctx, server->bindkeysfile);
@@ -90,18 +90,21 @@ static const char *nsstats_desc[dns_nsstatscounter_max];
 static const char *resstats_desc[dns_resstatscounter_max];
 static const char *zonestats_desc[dns_zonestatscounter_max];
 static const char *sockstats_desc[isc_sockstatscounter_max];
+static const char *taskstats_desc[isc_taskstatscounter_max];
 static const char *dnssecstats_desc[dns_dnssecstats_max];
 #ifdef HAVE_LIBXML2
 static const char *nsstats_xmldesc[dns_nsstatscounter_max];
 static const char *resstats_xmldesc[dns_resstatscounter_max];
 static const char *zonestats_xmldesc[dns_zonestatscounter_max];
 static const char *sockstats_xmldesc[isc_sockstatscounter_max];
+static const char *taskstats_xmldesc[isc_taskstatscounter_max];
 static const char *dnssecstats_xmldesc[dns_dnssecstats_max];
 #else
 #define nsstats_xmldesc NULL
 #define resstats_xmldesc NULL
 #define zonestats_xmldesc NULL
 #define sockstats_xmldesc NULL
+#define taskstats_xmldesc NULL
 #define dnssecstats_xmldesc NULL
 #endif	/* HAVE_LIBXML2 */
 
@@ -116,6 +119,7 @@ static int nsstats_index[dns_nsstatscounter_max];
 static int resstats_index[dns_resstatscounter_max];
 static int zonestats_index[dns_zonestatscounter_max];
 static int sockstats_index[isc_sockstatscounter_max];
+static int taskstats_index[isc_taskstatscounter_max];
 static int dnssecstats_index[dns_dnssecstats_max];
 
 static inline void
@@ -209,6 +213,23 @@ init_desc(void) {
 		       "UpdateBadPrereq");
 	SET_NSSTATDESC(rpz_rewrites, "response policy zone rewrites",
 		       "RPZRewrites");
+	SET_NSSTATDESC(arenasaved, "message allocations avoided by arenas",
+		       "MsgArenaSaved");
+	SET_NSSTATDESC(updatecommit, "update transactions committed",
+		       "UpdateCommit");
+	SET_NSSTATDESC(updatecoalesced,
+		       "updates coalesced into a shared transaction",
+		       "UpdateCoalesced");
+	SET_NSSTATDESC(respcachehit, "responses sent from the response cache",
+		       "RespCacheHit");
+	SET_NSSTATDESC(respcachemiss,
+		       "responses not found in the response cache",
+		       "RespCacheMiss");
+	SET_NSSTATDESC(prefetch, "queries sent to refresh cached answers",
+		       "Prefetch");
+	SET_NSSTATDESC(prefetchsaved,
+		       "milliseconds of recursion saved by prefetch",
+		       "PrefetchSavedMsec");
 #ifdef USE_RRL
 	SET_NSSTATDESC(ratedropped, "responses dropped for rate limits",
 		       "RateDropped");
@@ -285,6 +306,18 @@ init_desc(void) {
 	SET_RESSTATDESC(queryrtt5, "queries with RTT > "
 			DNS_RESOLVER_QRYRTTCLASS4STR "ms",
 			"QryRTT" DNS_RESOLVER_QRYRTTCLASS4STR "+");
+	SET_RESSTATDESC(staletimeout, "stale answers served on client timeout",
+			"StaleTimeout");
+	SET_RESSTATDESC(stalefailure, "stale answers served on failure",
+			"StaleFailure");
+	SET_RESSTATDESC(synthnxdomain, "NXDOMAIN answers synthesized "
+			"from NSEC/NSEC3", "SynthNXDOMAIN");
+	SET_RESSTATDESC(synthnodata, "NODATA answers synthesized "
+			"from NSEC/NSEC3", "SynthNODATA");
+	SET_RESSTATDESC(valsigverify, "DNSSEC signatures verified",
+			"ValSigVerify");
+	SET_RESSTATDESC(valsigcachehit, "DNSSEC signature results from cache",
+			"ValSigCacheHit");
 	INSIST(i == dns_resstatscounter_max);
 
 	/* Initialize zone statistics */
@@ -318,6 +351,10 @@ init_desc(void) {
 	SET_ZONESTATDESC(xfrsuccess, "transfer requests succeeded",
 			 "XfrSuccess");
 	SET_ZONESTATDESC(xfrfail, "transfer requests failed", "XfrFail");
+	SET_ZONESTATDESC(sigsgenerated, "signatures generated",
+			 "SigsGenerated");
+	SET_ZONESTATDESC(signingmsec, "milliseconds spent generating signatures",
+			 "SigningMsec");
 	INSIST(i == dns_zonestatscounter_max);
 
 	/* Initialize socket statistics */
@@ -425,8 +462,56 @@ init_desc(void) {
 			 "UnixRecvErr");
 	SET_SOCKSTATDESC(fdwatchrecvfail, "FDwatch recv errors",
 			 "FDwatchRecvErr");
+	SET_SOCKSTATDESC(udp4recvbatch, "UDP/IPv4 batched recv calls",
+			 "UDP4RecvBatch");
+	SET_SOCKSTATDESC(udp6recvbatch, "UDP/IPv6 batched recv calls",
+			 "UDP6RecvBatch");
+	SET_SOCKSTATDESC(udp4recvbatchpkts,
+			 "UDP/IPv4 datagrams received in batches",
+			 "UDP4RecvBatchPkts");
+	SET_SOCKSTATDESC(udp6recvbatchpkts,
+			 "UDP/IPv6 datagrams received in batches",
+			 "UDP6RecvBatchPkts");
+	SET_SOCKSTATDESC(udp4sendbatch, "UDP/IPv4 batched send calls",
+			 "UDP4SendBatch");
+	SET_SOCKSTATDESC(udp6sendbatch, "UDP/IPv6 batched send calls",
+			 "UDP6SendBatch");
+	SET_SOCKSTATDESC(udp4sendbatchpkts,
+			 "UDP/IPv4 datagrams sent in batches",
+			 "UDP4SendBatchPkts");
+	SET_SOCKSTATDESC(udp6sendbatchpkts,
+			 "UDP/IPv6 datagrams sent in batches",
+			 "UDP6SendBatchPkts");
 	INSIST(i == isc_sockstatscounter_max);
 
+	/* Initialize task manager statistics */
+	for (i = 0; i < isc_taskstatscounter_max; i++)
+		taskstats_desc[i] = NULL;
+#ifdef  HAVE_LIBXML2
+	for (i = 0; i < isc_taskstatscounter_max; i++)
+		taskstats_xmldesc[i] = NULL;
+#endif
+
+#define SET_TASKSTATDESC(counterid, desc, xmldesc) \
+	do { \
+		set_desc(isc_taskstatscounter_ ## counterid, \
+			 isc_taskstatscounter_max, \
+			 desc, taskstats_desc, xmldesc, taskstats_xmldesc); \
+		taskstats_index[i++] = isc_taskstatscounter_ ## counterid; \
+	} while (0)
+
+	i = 0;
+	SET_TASKSTATDESC(tasklockwait, "task lock contentions",
+			 "TaskLockWait");
+	SET_TASKSTATDESC(queuelockwait, "ready queue lock contentions",
+			 "QueueLockWait");
+	SET_TASKSTATDESC(inboxfull, "events sent with the task inbox full",
+			 "InboxFull");
+	SET_TASKSTATDESC(sendbatch, "event batches sent", "SendBatch");
+	SET_TASKSTATDESC(sendbatchevents, "events sent in batches",
+			 "SendBatchEvents");
+	INSIST(i == isc_taskstatscounter_max);
+
 	/* Initialize DNSSEC statistics */
 	for (i = 0; i < dns_dnssecstats_max; i++)
 		dnssecstats_desc[i] = NULL;
@@ -463,6 +548,8 @@ init_desc(void) {
 		INSIST(zonestats_desc[i] != NULL);
 	for (i = 0; i < isc_sockstatscounter_max; i++)
 		INSIST(sockstats_desc[i] != NULL);
+	for (i = 0; i < isc_taskstatscounter_max; i++)
+		INSIST(taskstats_desc[i] != NULL);
 	for (i = 0; i < dns_dnssecstats_max; i++)
 		INSIST(dnssecstats_desc[i] != NULL);
 #ifdef  HAVE_LIBXML2
@@ -474,6 +561,8 @@ init_desc(void) {
 		INSIST(zonestats_xmldesc[i] != NULL);
 	for (i = 0; i < isc_sockstatscounter_max; i++)
 		INSIST(sockstats_xmldesc[i] != NULL);
+	for (i = 0; i < isc_taskstatscounter_max; i++)
+		INSIST(taskstats_xmldesc[i] != NULL);
 	for (i = 0; i < dns_dnssecstats_max; i++)
 		INSIST(dnssecstats_xmldesc[i] != NULL);
 #endif
@@ -1044,6 +1133,7 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	isc_uint64_t resstat_values[dns_resstatscounter_max];
 	isc_uint64_t zonestat_values[dns_zonestatscounter_max];
 	isc_uint64_t sockstat_values[isc_sockstatscounter_max];
+	isc_uint64_t taskstat_values[isc_taskstatscounter_max];
 	isc_result_t result;
 
 	isc_time_now(&now);
@@ -1231,6 +1321,19 @@ else fprintf(stderr, "WTF WHERE'S RESQUERYRSTATS\n");
 
 	TRY0(xmlTextWriterEndElement(writer)); /* counters type=sockstat */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+					 ISC_XMLCHAR "taskstat"));
+
+	result = dump_counters(server->taskstats, statsformat_xml,
+			       writer, NULL, taskstats_xmldesc,
+			       isc_taskstatscounter_max, taskstats_index,
+			       taskstat_values, ISC_STATSDUMP_VERBOSE);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+
+	TRY0(xmlTextWriterEndElement(writer)); /* counters type=taskstat */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* server */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
@@ -1274,6 +1377,7 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	isc_uint64_t resstat_values[dns_resstatscounter_max];
 	isc_uint64_t zonestat_values[dns_zonestatscounter_max];
 	isc_uint64_t sockstat_values[isc_sockstatscounter_max];
+	isc_uint64_t taskstat_values[isc_taskstatscounter_max];
 	isc_result_t result;
 
 	isc_time_now(&now);
@@ -1425,6 +1529,13 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	if (result != ISC_R_SUCCESS)
 		goto error;
 
+	result = dump_counters(server->taskstats, statsformat_xml, writer,
+			       "taskstat", taskstats_xmldesc,
+			       isc_taskstatscounter_max, taskstats_index,
+			       taskstat_values, ISC_STATSDUMP_VERBOSE);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+
 	TRY0(xmlTextWriterEndElement(writer)); /* server */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
@@ -1909,6 +2020,7 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 	isc_uint64_t resstat_values[dns_resstatscounter_max];
 	isc_uint64_t zonestat_values[dns_zonestatscounter_max];
 	isc_uint64_t sockstat_values[isc_sockstatscounter_max];
+	isc_uint64_t taskstat_values[isc_taskstatscounter_max];
 
 	RUNTIME_CHECK(isc_once_do(&once, init_desc) == ISC_R_SUCCESS);
 
@@ -1949,6 +2061,11 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 	(void) dump_counters(server->zonestats, statsformat_file, fp, NULL,
 			     zonestats_desc, dns_zonestatscounter_max,
 			     zonestats_index, zonestat_values, 0);
+	if (zonestat_values[dns_zonestatscounter_signingmsec] != 0)
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+			zonestat_values[dns_zonestatscounter_sigsgenerated] *
+			1000 / zonestat_values[dns_zonestatscounter_signingmsec],
+			"signatures generated per second of signing");
 
 	fprintf(fp, "++ Resolver Statistics ++\n");
 	fprintf(fp, "[Common]\n");
@@ -1999,6 +2116,11 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 			     sockstats_desc, isc_sockstatscounter_max,
 			     sockstats_index, sockstat_values, 0);
 
+	fprintf(fp, "++ Task Manager Statistics ++\n");
+	(void) dump_counters(server->taskstats, statsformat_file, fp, NULL,
+			     taskstats_desc, isc_taskstatscounter_max,
+			     taskstats_index, taskstat_values, 0);
+
 	fprintf(fp, "++ Per Zone Query Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
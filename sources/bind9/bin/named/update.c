@@ -1472,6 +1472,7 @@ send_update_event(ns_client_t *client, dns_zone_t *zone) {
 		FAIL(ISC_R_NOMEMORY);
 	event->zone = zone;
 	event->result = ISC_R_SUCCESS;
+	event->ev_tag = zone;
 
 	evclient = NULL;
 	ns_client_attach(client, &evclient);
@@ -2429,19 +2430,82 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(isc_task_t *task, isc_event_t *event) {
-	update_event_t *uev = (update_event_t *) event;
-	dns_zone_t *zone = uev->zone;
-	ns_client_t *client = (ns_client_t *)event->ev_arg;
+/*%
+ * Return ISC_TRUE if 'db' has no DNSKEY records and is not being signed,
+ * so that updates to it never need new signatures or NSEC/NSEC3 chains.
+ */
+static isc_boolean_t
+zone_batchable(dns_db_t *db, dns_rdatatype_t privatetype) {
+	isc_result_t result;
+	dns_dbversion_t *ver = NULL;
+	isc_boolean_t flag = ISC_TRUE;
+
+	dns_db_currentversion(db, &ver);
+	result = rrset_exists(db, ver, dns_db_origin(db),
+			      dns_rdatatype_dnskey, 0, &flag);
+	if (result == ISC_R_SUCCESS && !flag)
+		flag = isdnssec(db, ver, privatetype);
+	dns_db_closeversion(db, &ver, ISC_FALSE);
+	return (ISC_TF(result == ISC_R_SUCCESS && !flag));
+}
 
+/*%
+ * Return ISC_TRUE if the update section of 'request' leaves the SOA and
+ * the DNSSEC records of the zone alone, so that it can share a database
+ * version and a journal transaction with other updates.
+ */
+static isc_boolean_t
+request_batchable(dns_message_t *request, dns_name_t *zonename,
+		  dns_rdatatype_t privatetype)
+{
+	isc_result_t result;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+
+	for (result = dns_message_firstname(request, DNS_SECTION_UPDATE);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(request, DNS_SECTION_UPDATE))
+	{
+		name = NULL;
+		dns_message_currentname(request, DNS_SECTION_UPDATE, &name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+		{
+			if (rdataset->type == dns_rdatatype_soa ||
+			    rdataset->type == dns_rdatatype_dnskey ||
+			    rdataset->type == dns_rdatatype_nsec3param ||
+			    rdataset->type == dns_rdatatype_rrsig ||
+			    rdataset->type == dns_rdatatype_nsec ||
+			    rdataset->type == dns_rdatatype_nsec3 ||
+			    (privatetype != 0 &&
+			     rdataset->type == privatetype))
+				return (ISC_FALSE);
+			if (rdataset->type == dns_rdatatype_any &&
+			    dns_name_equal(name, zonename))
+				return (ISC_FALSE);
+		}
+	}
+	return (ISC_TRUE);
+}
+
+/*%
+ * Check the prerequisites and permissions of the update request in
+ * 'client' and apply its update section to the new version '*verp' of
+ * 'db', opening '*oldverp' and '*verp' first if they are NULL.  The
+ * changes made are recorded in 'diff'.  '*modified' is set once the
+ * update section is being applied; a failure before that point leaves
+ * '*verp' untouched.
+ */
+static isc_result_t
+update_apply(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	     dns_dbversion_t **oldverp, dns_dbversion_t **verp,
+	     dns_diff_t *diff, isc_boolean_t *soa_serial_changed,
+	     isc_boolean_t *modified)
+{
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
 	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff;	/* Pending updates. */
 	dns_diff_t temp;	/* Pending RR existence assertions. */
-	isc_boolean_t soa_serial_changed = ISC_FALSE;
 	isc_mem_t *mctx = client->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
@@ -2451,17 +2515,10 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
 	unsigned int options;
-	dns_difftuple_t *tuple;
-	dns_rdata_dnskey_t dnskey;
-	isc_boolean_t had_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 
-	INSIST(event->ev_type == DNS_EVENT_UPDATE);
-
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
 
-	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
 	zoneclass = dns_db_class(db);
 	dns_zone_getssutable(zone, &ssutable);
@@ -2476,9 +2533,13 @@ update_action(isc_task_t *task, isc_event_t *event) {
 
 	/*
 	 * Get old and new versions now that queryacl has been checked.
+	 * Requests applied in one batch share them.
 	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
+	if (*oldverp == NULL)
+		dns_db_currentversion(db, oldverp);
+	if (*verp == NULL)
+		CHECK(dns_db_newversion(db, verp));
+	ver = *verp;
 
 	/*
 	 * Check prerequisites.
@@ -2726,8 +2787,10 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		   "update section prescan OK");
 
 	/*
-	 * Process the Update Section.
+	 * Process the Update Section.  From here on a failure has to
+	 * back changes out of 'ver'.
 	 */
+	*modified = ISC_TRUE;
 
 	options = dns_zone_getoptions(zone);
 	for (result = dns_message_firstname(request, DNS_SECTION_UPDATE);
@@ -2819,7 +2882,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 						   "ignoring it");
 					continue;
 				}
-				soa_serial_changed = ISC_TRUE;
+				*soa_serial_changed = ISC_TRUE;
 			}
 
 			if (rdata.type == privatetype) {
@@ -2872,7 +2935,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.update_rr = &rdata;
 				ctx.update_rr_ttl = ttl;
@@ -2888,18 +2951,18 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
 						dns_diff_clear(&ctx.add_diff);
 						goto failure;
 					}
-					CHECK(update_one_rr(db, ver, &diff,
+					CHECK(update_one_rr(db, ver, diff,
 							    DNS_DIFFOP_ADD,
 							    name, ttl, &rdata));
 				}
@@ -2921,12 +2984,12 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -2953,7 +3016,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -2992,7 +3055,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE)
@@ -3003,10 +3066,10 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
 	 * records.
 	 */
-	if (! ISC_LIST_EMPTY(diff.tuples))
-		CHECK(check_dnssec(client, zone, db, ver, &diff));
+	if (! ISC_LIST_EMPTY(diff->tuples))
+		CHECK(check_dnssec(client, zone, db, ver, diff));
 
-	if (! ISC_LIST_EMPTY(diff.tuples)) {
+	if (! ISC_LIST_EMPTY(diff->tuples)) {
 		unsigned int errors = 0;
 		CHECK(dns_zone_nscheck(zone, db, ver, &errors));
 		if (errors != 0) {
@@ -3018,12 +3081,45 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		}
 	}
 
+	if (! ISC_LIST_EMPTY(diff->tuples))
+		CHECK(check_mx(client, zone, db, ver, diff));
+
+	result = ISC_R_SUCCESS;
+
+ failure:
+	dns_diff_clear(&temp);
+
+	if (ssutable != NULL)
+		dns_ssutable_detach(&ssutable);
+
+	return (result);
+}
+
+/*%
+ * Finish the changes in 'diff', made by one or more update requests,
+ * and commit '*verp' to 'db'.  Messages are logged against 'client'.
+ * '*verp' is closed on both success and failure.
+ */
+static isc_result_t
+update_commit(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	      dns_dbversion_t *oldver, dns_dbversion_t **verp,
+	      dns_diff_t *diff, isc_boolean_t soa_serial_changed)
+{
+	isc_result_t result;
+	dns_dbversion_t *ver = *verp;
+	isc_mem_t *mctx = client->mctx;
+	dns_name_t *zonename = dns_db_origin(db);
+	dns_difftuple_t *tuple;
+	dns_rdata_dnskey_t dnskey;
+	isc_boolean_t had_dnskey;
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+
 	/*
 	 * If any changes were made, increment the SOA serial number,
 	 * update RRSIGs and NSECs (if zone is secure), and write the update
 	 * to the journal.
 	 */
-	if (! ISC_LIST_EMPTY(diff.tuples)) {
+	if (! ISC_LIST_EMPTY(diff->tuples)) {
 		char *journalfile;
 		dns_journal_t *journal;
 		isc_boolean_t has_dnskey;
@@ -3033,13 +3129,11 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 * changed as a result of an update operation.
 		 */
 		if (! soa_serial_changed) {
-			CHECK(update_soa_serial(db, ver, &diff, mctx,
+			CHECK(update_soa_serial(db, ver, diff, mctx,
 				       dns_zone_getserialupdatemethod(zone)));
 		}
 
-		CHECK(check_mx(client, zone, db, ver, &diff));
-
-		CHECK(remove_orphaned_ds(db, ver, &diff));
+		CHECK(remove_orphaned_ds(db, ver, diff));
 
 		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey,
 				   0, &has_dnskey));
@@ -3061,11 +3155,11 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			}
 		}
 
-		CHECK(rollback_private(db, privatetype, ver, &diff));
+		CHECK(rollback_private(db, privatetype, ver, diff));
 
-		CHECK(add_signing_records(db, privatetype, ver, &diff));
+		CHECK(add_signing_records(db, privatetype, ver, diff));
 
-		CHECK(add_nsec3param_records(client, zone, db, ver, &diff));
+		CHECK(add_nsec3param_records(client, zone, db, ver, diff));
 
 		if (had_dnskey && !has_dnskey) {
 			/*
@@ -3075,7 +3169,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			 * remove any NSEC chain present will also be removed.
 			 */
 			 CHECK(dns_nsec3param_deletechains(db, ver, zone,
-							   ISC_TRUE, &diff));
+							   ISC_TRUE, diff));
 		} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
 			isc_uint32_t interval;
 			dns_update_log_t log;
@@ -3084,7 +3178,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			log.func = update_log_cb;
 			log.arg = client;
 			result = dns_update_signatures(&log, zone, db, oldver,
-						       ver, &diff, interval);
+						       ver, diff, interval);
 
 			if (result != ISC_R_SUCCESS) {
 				update_log(client, zone,
@@ -3106,7 +3200,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			if (result != ISC_R_SUCCESS)
 				FAILS(result, "journal open failed");
 
-			result = dns_journal_write_transaction(journal, &diff);
+			result = dns_journal_write_transaction(journal, diff);
 			if (result != ISC_R_SUCCESS) {
 				dns_journal_destroy(&journal);
 				FAILS(result, "journal write failed");
@@ -3123,7 +3217,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		update_log(client, zone, LOGLEVEL_DEBUG,
 			   "committing update transaction");
 
-		dns_db_closeversion(db, &ver, ISC_TRUE);
+		dns_db_closeversion(db, verp, ISC_TRUE);
 
 		/*
 		 * Mark the zone as dirty so that it will be written to disk.
@@ -3142,7 +3236,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 *
 		 * Note: we are already committed to this course of action.
 		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples);
+		for (tuple = ISC_LIST_HEAD(diff->tuples);
 		     tuple != NULL;
 		     tuple = ISC_LIST_NEXT(tuple, link)) {
 			isc_region_t r;
@@ -3177,7 +3271,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		 *
 		 * Note: we are already committed to this course of action.
 		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples);
+		for (tuple = ISC_LIST_HEAD(diff->tuples);
 		     tuple != NULL;
 		     tuple = ISC_LIST_NEXT(tuple, link)) {
 			unsigned char buf[DNS_NSEC3PARAM_BUFFERSIZE];
@@ -3204,23 +3298,130 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		}
 	} else {
 		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
-		dns_db_closeversion(db, &ver, ISC_TRUE);
+		dns_db_closeversion(db, verp, ISC_TRUE);
 	}
-	result = ISC_R_SUCCESS;
-	goto common;
+	return (ISC_R_SUCCESS);
 
  failure:
 	/*
 	 * The reason for failure should have been logged at this point.
 	 */
-	if (ver != NULL) {
+	if (*verp != NULL) {
 		update_log(client, zone, LOGLEVEL_DEBUG,
 			   "rolling back");
-		dns_db_closeversion(db, &ver, ISC_FALSE);
+		dns_db_closeversion(db, verp, ISC_FALSE);
 	}
+	return (result);
+}
 
- common:
-	dns_diff_clear(&temp);
+/*%
+ * Apply the update requests at the head of 'events' to 'zone'.
+ *
+ * When the zone is not signed, consecutive requests that leave the SOA
+ * and DNSSEC records alone are applied to one new database version in
+ * turn, so each sees the changes of those before it, and committed as
+ * one journal transaction with one serial number increment.  A request
+ * that fails is backed out of the shared version by starting it again
+ * and replaying the changes of the requests before it.  Any other
+ * request is applied on its own.
+ *
+ * The requests that were applied are removed from 'events', and the
+ * result of each is sent back to its client.
+ */
+static void
+update_batch(dns_zone_t *zone, isc_eventlist_t *events) {
+	isc_result_t result, bresult = ISC_R_SUCCESS;
+	isc_eventlist_t batch;
+	isc_event_t *event;
+	update_event_t *uev;
+	ns_client_t *client, *leader = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff;	/* Pending updates of the whole batch. */
+	dns_diff_t rdiff;	/* Pending updates of one request. */
+	dns_difftuple_t *tuple;
+	isc_boolean_t soa_serial_changed = ISC_FALSE;
+	isc_boolean_t batchable, modified, changed;
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	unsigned int nchanged = 0;
+
+	ISC_LIST_INIT(batch);
+	event = ISC_LIST_HEAD(*events);
+	client = (ns_client_t *)event->ev_arg;
+	dns_diff_init(client->mctx, &diff);
+
+	result = dns_zone_getdb(zone, &db);
+	if (result != ISC_R_SUCCESS) {
+		ISC_LIST_UNLINK(*events, event, ev_link);
+		ISC_LIST_APPEND(batch, event, ev_link);
+		((update_event_t *)event)->result = result;
+		goto done;
+	}
+	batchable = zone_batchable(db, privatetype);
+
+	while ((event = ISC_LIST_HEAD(*events)) != NULL) {
+		uev = (update_event_t *)event;
+		client = (ns_client_t *)event->ev_arg;
+
+		if (batchable)
+			batchable = request_batchable(client->message,
+						      dns_db_origin(db),
+						      privatetype);
+		if (!batchable && !ISC_LIST_EMPTY(batch))
+			break;
+		ISC_LIST_UNLINK(*events, event, ev_link);
+		ISC_LIST_APPEND(batch, event, ev_link);
+
+		dns_diff_init(client->mctx, &rdiff);
+		modified = ISC_FALSE;
+		result = update_apply(client, zone, db, &oldver, &ver,
+				      &rdiff, &soa_serial_changed, &modified);
+		uev->result = result;
+		if (result == ISC_R_SUCCESS) {
+			if (leader == NULL)
+				leader = client;
+			if (! ISC_LIST_EMPTY(rdiff.tuples))
+				nchanged++;
+			while ((tuple = ISC_LIST_HEAD(rdiff.tuples)) != NULL) {
+				ISC_LIST_UNLINK(rdiff.tuples, tuple, link);
+				dns_diff_appendminimal(&diff, &tuple);
+			}
+		} else if (modified && ver != NULL) {
+			/*
+			 * The reason for failure should have been logged at
+			 * this point.
+			 */
+			update_log(client, zone, LOGLEVEL_DEBUG,
+				   "rolling back");
+			dns_db_closeversion(db, &ver, ISC_FALSE);
+			if (! ISC_LIST_EMPTY(diff.tuples)) {
+				bresult = dns_db_newversion(db, &ver);
+				if (bresult == ISC_R_SUCCESS)
+					bresult = dns_diff_apply(&diff, db,
+								 ver);
+			}
+		}
+		dns_diff_clear(&rdiff);
+		if (bresult != ISC_R_SUCCESS || !batchable)
+			break;
+	}
+
+	if (bresult == ISC_R_SUCCESS && leader != NULL && ver != NULL) {
+		changed = ISC_TF(! ISC_LIST_EMPTY(diff.tuples));
+		bresult = update_commit(leader, zone, db, oldver, &ver, &diff,
+					soa_serial_changed);
+		if (bresult == ISC_R_SUCCESS && changed) {
+			inc_stats(zone, dns_nsstatscounter_updatecommit);
+			while (nchanged-- > 1)
+				inc_stats(zone,
+					  dns_nsstatscounter_updatecoalesced);
+		}
+	}
+	if (ver != NULL)
+		dns_db_closeversion(db, &ver, ISC_FALSE);
+
+ done:
 	dns_diff_clear(&diff);
 
 	if (oldver != NULL)
@@ -3229,19 +3430,49 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	if (db != NULL)
 		dns_db_detach(&db);
 
-	if (ssutable != NULL)
-		dns_ssutable_detach(&ssutable);
-
-	isc_task_detach(&task);
-	uev->result = result;
-	if (zone != NULL)
+	while ((event = ISC_LIST_HEAD(batch)) != NULL) {
+		ISC_LIST_UNLINK(batch, event, ev_link);
+		uev = (update_event_t *)event;
+		client = (ns_client_t *)event->ev_arg;
+		if (uev->result == ISC_R_SUCCESS)
+			uev->result = bresult;
 		INSIST(uev->zone == zone); /* we use this later */
-	uev->ev_type = DNS_EVENT_UPDATEDONE;
-	uev->ev_action = updatedone_action;
-	isc_task_send(client->task, &event);
+		uev->ev_type = DNS_EVENT_UPDATEDONE;
+		uev->ev_action = updatedone_action;
+		isc_task_send(client->task, &event);
+		INSIST(event == NULL);
+	}
+}
+
+static void
+update_action(isc_task_t *task, isc_event_t *event) {
+	update_event_t *uev = (update_event_t *) event;
+	dns_zone_t *zone = uev->zone;
+	isc_eventlist_t events;
+	unsigned int count;
+	isc_task_t *ref;
+
+	INSIST(event->ev_type == DNS_EVENT_UPDATE);
 
-	INSIST(ver == NULL);
-	INSIST(event == NULL);
+	/*
+	 * Take the updates for this zone that have queued up behind this
+	 * one so that they can be applied together.
+	 */
+	ISC_LIST_INIT(events);
+	ISC_LIST_APPEND(events, event, ev_link);
+	count = 1 + isc_task_unsend(task, NULL, DNS_EVENT_UPDATE, zone,
+				    &events);
+
+	while (! ISC_LIST_EMPTY(events))
+		update_batch(zone, &events);
+
+	/*
+	 * Each event holds a reference to the zone task.
+	 */
+	while (count-- > 0) {
+		ref = task;
+		isc_task_detach(&ref);
+	}
 }
 
 static void
@@ -931,6 +931,8 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			masterformat = dns_masterformat_text;
 		else if (strcasecmp(masterformatstr, "raw") == 0)
 			masterformat = dns_masterformat_raw;
+		else if (strcasecmp(masterformatstr, "map") == 0)
+			masterformat = dns_masterformat_map;
 		else
 			INSIST(0);
 	}
@@ -954,6 +956,30 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	} else
 		RETERR(dns_zone_setfile2(zone, filename, masterformat));
 
+	obj = NULL;
+	result = ns_config_get(maps, "load-threads", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	if (cfg_obj_asuint32(obj) == 0) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_ERROR,
+			    "'load-threads' must be greater than zero");
+		return (ISC_R_RANGE);
+	}
+	dns_zone_setloadthreads(zone, cfg_obj_asuint32(obj));
+	if (raw != NULL)
+		dns_zone_setloadthreads(raw, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = ns_config_get(maps, "dump-threads", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	if (cfg_obj_asuint32(obj) == 0) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_ERROR,
+			    "'dump-threads' must be greater than zero");
+		return (ISC_R_RANGE);
+	}
+	dns_zone_setdumpthreads(zone, cfg_obj_asuint32(obj));
+	if (raw != NULL)
+		dns_zone_setdumpthreads(raw, cfg_obj_asuint32(obj));
+
 	obj = NULL;
 	result = cfg_map_get(zoptions, "journal", &obj);
 	if (result == ISC_R_SUCCESS)
@@ -1350,6 +1376,17 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setnodes(zone, cfg_obj_asuint32(obj));
 
+		obj = NULL;
+		result = ns_config_get(maps, "sig-signing-threads", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		if (cfg_obj_asuint32(obj) == 0) {
+			cfg_obj_log(obj, ns_g_lctx, ISC_LOG_ERROR,
+				    "'sig-signing-threads' must be greater "
+				    "than zero");
+			return (ISC_R_RANGE);
+		}
+		dns_zone_setsigningthreads(zone, cfg_obj_asuint32(obj));
+
 		obj = NULL;
 		result = ns_config_get(maps, "sig-signing-type", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
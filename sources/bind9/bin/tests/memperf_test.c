@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Measure isc_mem_get()/isc_mem_put() and isc_mempool_get()/
+ * isc_mempool_put() throughput with 1 to 64 threads sharing one memory
+ * context and one locked memory pool, with the per-thread caches
+ * turned off (ISC_MEMFLAG_NOCACHE) and on.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+#define MAXTHREADS	64
+#define MAXDEPTH	64
+
+static isc_mem_t *mctx = NULL;
+static isc_mempool_t *mpool = NULL;
+static unsigned int iterations = 100000;
+static unsigned int depth = 8;
+
+/*
+ * Each thread holds up to 'depth' blocks of a few different sizes at a
+ * time, the way a query holds its names and rdatasets.
+ */
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+mem_thread(isc_threadarg_t arg) {
+	void *held[MAXDEPTH];
+	unsigned int i, j;
+
+	UNUSED(arg);
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < depth; j++)
+			held[j] = isc_mem_get(mctx, 16 + (j % 4) * 40);
+		for (j = 0; j < depth; j++)
+			isc_mem_put(mctx, held[j], 16 + (j % 4) * 40);
+	}
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+pool_thread(isc_threadarg_t arg) {
+	void *held[MAXDEPTH];
+	unsigned int i, j;
+
+	UNUSED(arg);
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < depth; j++)
+			held[j] = isc_mempool_get(mpool);
+		for (j = 0; j < depth; j++)
+			isc_mempool_put(mpool, held[j]);
+	}
+	return ((isc_threadresult_t)0);
+}
+
+static double
+run(isc_threadfunc_t func, unsigned int nthreads, unsigned int flags) {
+	isc_thread_t threads[MAXTHREADS];
+	isc_mutex_t lock;
+	isc_time_t start, end;
+	isc_uint64_t usecs;
+	unsigned int i;
+
+	RUNTIME_CHECK(isc_mem_create2(0, 0, &mctx, flags) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mempool_create(mctx, 64, &mpool) == ISC_R_SUCCESS);
+	isc_mempool_associatelock(mpool, &lock);
+	isc_mempool_setfreemax(mpool, 1024);
+	isc_mempool_setfillcount(mpool, 64);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(func, NULL, &threads[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_join(threads[i], NULL) ==
+			      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+
+	usecs = isc_time_microdiff(&end, &start);
+	if (usecs == 0)
+		usecs = 1;
+
+	isc_mempool_destroy(&mpool);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&mctx);
+
+	return ((double)nthreads * iterations * depth * 1000000.0 /
+		(double)usecs);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: memperf_test [-d depth] [-i iterations] "
+		"[-t maxthreads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int nthreads, maxthreads = MAXTHREADS;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "d:i:t:")) != -1) {
+		switch (ch) {
+		case 'd':
+			depth = atoi(isc_commandline_argument);
+			break;
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 't':
+			maxthreads = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (depth < 1 || depth > MAXDEPTH || iterations < 1 ||
+	    maxthreads < 1 || maxthreads > MAXTHREADS)
+		usage();
+
+	printf("%u iterations of %u gets and puts per thread\n",
+	       iterations, depth);
+	printf("%8s %14s %14s %14s %14s\n", "threads",
+	       "mem/sec", "mem+cache/sec", "pool/sec", "pool+cache/sec");
+
+	for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2)
+		printf("%8u %14.0f %14.0f %14.0f %14.0f\n", nthreads,
+		       run(mem_thread, nthreads, ISC_MEMFLAG_DEFAULT |
+						 ISC_MEMFLAG_NOCACHE),
+		       run(mem_thread, nthreads, ISC_MEMFLAG_DEFAULT),
+		       run(pool_thread, nthreads, ISC_MEMFLAG_DEFAULT |
+						  ISC_MEMFLAG_NOCACHE),
+		       run(pool_thread, nthreads, ISC_MEMFLAG_DEFAULT));
+
+	return (0);
+}
+
+#else
+
+int
+main(int argc, char *argv[]) {
+	UNUSED(argc);
+	UNUSED(argv);
+	fprintf(stderr, "This test requires threads.\n");
+	return(1);
+}
+
+#endif
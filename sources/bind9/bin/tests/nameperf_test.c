@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Measure the case insensitive name operations: dns_name_fromwire()
+ * with and without DNS_NAME_DOWNCASE, dns_name_equal(),
+ * dns_name_fullcompare(), dns_name_rdatacompare(), dns_name_hash() and
+ * dns_name_downcase(), on names of typical lengths.  The names compared
+ * are equal but for case, which is the slowest case.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/result.h>
+
+static const char *names[] = {
+	"com.",
+	"www.example.com.",
+	"mail.Sales-Department.Example.co.uk.",
+	"_ldap._tcp.DC._msdcs.Corporate-Headquarters.Example.com.",
+	"a-rather-long-hostname-for-a-cdn-edge-node-0123456789."
+	"Content-Delivery-Network-Provider-With-A-Long-Name.net.",
+	"abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0."
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ0."
+	"abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0."
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789ABCDEFGHIJKLMNOPQRSTUVWXY.",
+	NULL
+};
+
+enum {
+	op_fromwire,
+	op_fromwiredown,
+	op_equal,
+	op_fullcompare,
+	op_rdatacompare,
+	op_hash,
+	op_downcase,
+	op_max
+};
+
+static const char *opnames[op_max] = {
+	"fromwire", "fromwire-down", "equal", "fullcompare", "rdatacompare",
+	"hash", "downcase"
+};
+
+static unsigned int iterations = 1000000;
+
+static inline void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", msg, dns_result_totext(result));
+		exit(1);
+	}
+}
+
+/*
+ * Run operation 'op' on 'name1' and 'name2' (which differ only in case)
+ * 'iterations' times and return the number of operations per second.
+ */
+static double
+run(int op, dns_name_t *name1, dns_name_t *name2) {
+	unsigned char data[DNS_NAME_MAXWIRE];
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_decompress_t dctx;
+	isc_buffer_t source, target;
+	isc_time_t start, end;
+	isc_uint64_t usecs;
+	unsigned int i, nlabels, sum = 0;
+	int order;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < iterations; i++) {
+		switch (op) {
+		case op_fromwire:
+		case op_fromwiredown:
+			isc_buffer_init(&source, name1->ndata, name1->length);
+			isc_buffer_add(&source, name1->length);
+			isc_buffer_setactive(&source, name1->length);
+			isc_buffer_init(&target, data, sizeof(data));
+			CHECKRESULT(dns_name_fromwire(name, &source, &dctx,
+						      (op == op_fromwire) ? 0 :
+						      DNS_NAME_DOWNCASE,
+						      &target),
+				    "dns_name_fromwire");
+			sum += name->length;
+			break;
+		case op_equal:
+			sum += dns_name_equal(name1, name2);
+			break;
+		case op_fullcompare:
+			(void)dns_name_fullcompare(name1, name2, &order,
+						   &nlabels);
+			sum += nlabels;
+			break;
+		case op_rdatacompare:
+			sum += dns_name_rdatacompare(name1, name2);
+			break;
+		case op_hash:
+			sum += dns_name_hash(name1, ISC_FALSE);
+			break;
+		case op_downcase:
+			CHECKRESULT(dns_name_downcase(name1, name, NULL),
+				    "dns_name_downcase");
+			sum += name->length;
+			break;
+		}
+	}
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+
+	dns_decompress_invalidate(&dctx);
+
+	/*
+	 * Use 'sum' so that the work cannot be optimized away.
+	 */
+	if (sum == 1)
+		printf(" ");
+
+	usecs = isc_time_microdiff(&end, &start);
+	if (usecs == 0)
+		usecs = 1;
+	return ((double)iterations * 1000000.0 / (double)usecs);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: nameperf_test [-i iterations]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	dns_fixedname_t fixed1, fixed2;
+	dns_name_t *name1, *name2;
+	char upper[DNS_NAME_FORMATSIZE];
+	unsigned int i, j;
+	int ch, op;
+
+	while ((ch = isc_commandline_parse(argc, argv, "i:")) != -1) {
+		switch (ch) {
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (iterations < 1)
+		usage();
+
+	dns_result_register();
+
+	printf("%u operations each, in millions per second\n", iterations);
+	printf("%-6s", "length");
+	for (op = 0; op < op_max; op++)
+		printf(" %13s", opnames[op]);
+	printf("\n");
+
+	dns_fixedname_init(&fixed1);
+	name1 = dns_fixedname_name(&fixed1);
+	dns_fixedname_init(&fixed2);
+	name2 = dns_fixedname_name(&fixed2);
+	for (i = 0; names[i] != NULL; i++) {
+		for (j = 0; names[i][j] != '\0'; j++)
+			upper[j] = toupper((unsigned char)names[i][j]);
+		upper[j] = '\0';
+		CHECKRESULT(dns_name_fromstring(name1, names[i], 0, NULL),
+			    names[i]);
+		CHECKRESULT(dns_name_fromstring(name2, upper, 0, NULL),
+			    upper);
+
+		printf("%-6u", name1->length);
+		for (op = 0; op < op_max; op++)
+			printf(" %13.2f", run(op, name1, name2) / 1000000.0);
+		printf("\n");
+	}
+
+	return (0);
+}
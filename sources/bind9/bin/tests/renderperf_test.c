@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Measure how fast parsed messages can be rendered, which is mostly a
+ * measure of name compression.  The messages are read from files in the
+ * format used by wire_test (hex, '#' starts a comment), one message per
+ * file.
+ * With no files, a large referral and a large answer are made up.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/result.h>
+
+static isc_mem_t *mctx = NULL;
+static unsigned int iterations = 100000;
+
+static inline void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", msg, dns_result_totext(result));
+		exit(1);
+	}
+}
+
+static int
+fromhex(char c) {
+	if (c >= '0' && c <= '9')
+		return (c - '0');
+	else if (c >= 'a' && c <= 'f')
+		return (c - 'a' + 10);
+	else if (c >= 'A' && c <= 'F')
+		return (c - 'A' + 10);
+
+	fprintf(stderr, "bad input format: %02x\n", c);
+	exit(3);
+	/* NOTREACHED */
+}
+
+static void
+readmessage(const char *filename, isc_buffer_t *target) {
+	char s[4000], *rp;
+	FILE *f;
+	int n;
+
+	f = fopen(filename, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: fopen failed\n", filename);
+		exit(1);
+	}
+	while (fgets(s, sizeof(s), f) != NULL) {
+		for (rp = s; *rp != '\0' && *rp != '#'; rp++) {
+			if (*rp == ' ' || *rp == '\t' ||
+			    *rp == '\r' || *rp == '\n')
+				continue;
+			if (rp[1] == '\0' || rp[1] == '#') {
+				fprintf(stderr, "%s: bad input format\n",
+					filename);
+				exit(1);
+			}
+			if (isc_buffer_availablelength(target) == 0) {
+				fprintf(stderr, "%s: input too long\n",
+					filename);
+				exit(2);
+			}
+			n = fromhex(rp[0]) * 16 + fromhex(rp[1]);
+			isc_buffer_putuint8(target, n);
+			rp++;
+		}
+	}
+	fclose(f);
+}
+
+/*
+ * Helpers for making up messages.  Names are written uncompressed.
+ */
+static void
+putname(isc_buffer_t *target, const char *text) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	CHECKRESULT(dns_name_fromstring(name, text, 0, NULL),
+		    "dns_name_fromstring");
+	isc_buffer_putmem(target, name->ndata, name->length);
+}
+
+static unsigned char *
+putrr(isc_buffer_t *target, const char *owner, dns_rdatatype_t type) {
+	unsigned char *rdlength;
+
+	putname(target, owner);
+	isc_buffer_putuint16(target, type);
+	isc_buffer_putuint16(target, dns_rdataclass_in);
+	isc_buffer_putuint32(target, 86400);
+	rdlength = isc_buffer_used(target);
+	isc_buffer_putuint16(target, 0);
+	return (rdlength);
+}
+
+static void
+endrr(isc_buffer_t *target, unsigned char *rdlength) {
+	unsigned int length;
+
+	length = (unsigned char *)isc_buffer_used(target) - rdlength - 2;
+	rdlength[0] = length >> 8;
+	rdlength[1] = length & 0xff;
+}
+
+static void
+header(isc_buffer_t *target, unsigned int an, unsigned int ns,
+       unsigned int ar)
+{
+	isc_buffer_putuint16(target, 0x1234);
+	isc_buffer_putuint16(target, 0x8400);
+	isc_buffer_putuint16(target, 1);
+	isc_buffer_putuint16(target, an);
+	isc_buffer_putuint16(target, ns);
+	isc_buffer_putuint16(target, ar);
+}
+
+/*
+ * A referral from a TLD server: 13 name servers spread over a few
+ * provider domains, each with A and AAAA glue.
+ */
+static void
+makereferral(isc_buffer_t *target) {
+	unsigned char *rdlength;
+	char text[100];
+	unsigned int i;
+
+	header(target, 0, 13, 26);
+	putname(target, "www.example.com.");
+	isc_buffer_putuint16(target, dns_rdatatype_a);
+	isc_buffer_putuint16(target, dns_rdataclass_in);
+	for (i = 0; i < 13; i++) {
+		rdlength = putrr(target, "example.com.", dns_rdatatype_ns);
+		snprintf(text, sizeof(text), "ns%u.dns-provider%u.net.",
+			 i, i % 3);
+		putname(target, text);
+		endrr(target, rdlength);
+	}
+	for (i = 0; i < 13; i++) {
+		snprintf(text, sizeof(text), "ns%u.dns-provider%u.net.",
+			 i, i % 3);
+		rdlength = putrr(target, text, dns_rdatatype_a);
+		isc_buffer_putuint32(target, 0xc0000200 + i);
+		endrr(target, rdlength);
+		rdlength = putrr(target, text, dns_rdatatype_aaaa);
+		isc_buffer_putuint32(target, 0x20010db8);
+		isc_buffer_putuint32(target, 0);
+		isc_buffer_putuint32(target, 0);
+		isc_buffer_putuint32(target, i);
+		endrr(target, rdlength);
+	}
+}
+
+/*
+ * A large answer: many MX and SRV records whose targets share suffixes.
+ */
+static void
+makeanswer(isc_buffer_t *target) {
+	unsigned char *rdlength;
+	char text[100];
+	unsigned int i;
+
+	header(target, 120, 0, 0);
+	putname(target, "example.com.");
+	isc_buffer_putuint16(target, dns_rdatatype_any);
+	isc_buffer_putuint16(target, dns_rdataclass_in);
+	for (i = 0; i < 60; i++) {
+		rdlength = putrr(target, "example.com.", dns_rdatatype_mx);
+		isc_buffer_putuint16(target, i);
+		snprintf(text, sizeof(text), "mx%u.mail%u.example.com.",
+			 i, i % 5);
+		putname(target, text);
+		endrr(target, rdlength);
+	}
+	for (i = 0; i < 60; i++) {
+		snprintf(text, sizeof(text), "_sip%u._tcp.example.com.",
+			 i % 10);
+		rdlength = putrr(target, text, dns_rdatatype_srv);
+		isc_buffer_putuint16(target, 10);
+		isc_buffer_putuint16(target, i);
+		isc_buffer_putuint16(target, 5060);
+		snprintf(text, sizeof(text), "sip%u.voice%u.example.com.",
+			 i, i % 4);
+		putname(target, text);
+		endrr(target, rdlength);
+	}
+}
+
+/*
+ * Render 'message' 'iterations' times and return the number of
+ * renders per second.  The size of the rendered message is stored in
+ * '*sizep'.
+ */
+static double
+render(dns_message_t *message, unsigned int *sizep) {
+	unsigned char data[64 * 1024];
+	isc_buffer_t buffer;
+	dns_compress_t cctx;
+	isc_time_t start, end;
+	isc_uint64_t usecs;
+	isc_result_t result;
+	dns_section_t section;
+	unsigned int i;
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < iterations; i++) {
+		isc_buffer_init(&buffer, data, sizeof(data));
+		result = dns_compress_init(&cctx, -1, mctx);
+		CHECKRESULT(result, "dns_compress_init");
+		result = dns_message_renderbegin(message, &cctx, &buffer);
+		CHECKRESULT(result, "dns_message_renderbegin");
+		for (section = DNS_SECTION_QUESTION;
+		     section < DNS_SECTION_MAX;
+		     section++)
+		{
+			result = dns_message_rendersection(message, section, 0);
+			CHECKRESULT(result, "dns_message_rendersection");
+		}
+		result = dns_message_renderend(message);
+		CHECKRESULT(result, "dns_message_renderend");
+		dns_compress_invalidate(&cctx);
+		dns_message_renderreset(message);
+	}
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+
+	*sizep = isc_buffer_usedlength(&buffer);
+	usecs = isc_time_microdiff(&end, &start);
+	if (usecs == 0)
+		usecs = 1;
+	return ((double)iterations * 1000000.0 / (double)usecs);
+}
+
+static void
+run(const char *label, isc_buffer_t *source) {
+	dns_message_t *message = NULL;
+	isc_result_t result;
+	unsigned int i, size, rendered;
+	double rate;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &message);
+	CHECKRESULT(result, "dns_message_create");
+	size = isc_buffer_usedlength(source);
+	result = dns_message_parse(message, source, 0);
+	if (result == DNS_R_RECOVERABLE)
+		result = ISC_R_SUCCESS;
+	CHECKRESULT(result, label);
+
+	/*
+	 * Render the parsed message, as wire_test -r does.
+	 */
+	message->from_to_wire = DNS_MESSAGE_INTENTRENDER;
+	for (i = 0; i < DNS_SECTION_MAX; i++)
+		message->counts[i] = 0;
+
+	rate = render(message, &rendered);
+	printf("%-20.20s %8u %8u %14.0f\n", label, size, rendered, rate);
+
+	message->from_to_wire = DNS_MESSAGE_INTENTPARSE;
+	dns_message_destroy(&message);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: renderperf_test [-i iterations] [file ...]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	static unsigned char data[64 * 1024];
+	isc_buffer_t source;
+	const char *label;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "i:")) != -1) {
+		switch (ch) {
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (iterations < 1)
+		usage();
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	dns_result_register();
+
+	printf("%u renders of each message\n", iterations);
+	printf("%-20s %8s %8s %14s\n", "message", "size", "rendered",
+	       "renders/sec");
+
+	if (argc == 0) {
+		isc_buffer_init(&source, data, sizeof(data));
+		makereferral(&source);
+		run("referral", &source);
+		isc_buffer_init(&source, data, sizeof(data));
+		makeanswer(&source);
+		run("answer", &source);
+	}
+	for (; argc > 0; argc--, argv++) {
+		isc_buffer_init(&source, data, sizeof(data));
+		readmessage(argv[0], &source);
+		label = strrchr(argv[0], '/');
+		run(label != NULL ? label + 1 : argv[0], &source);
+	}
+
+	isc_mem_destroy(&mctx);
+	return (0);
+}
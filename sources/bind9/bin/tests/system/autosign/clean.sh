@@ -49,6 +49,9 @@ rm -f ns3/secure-to-insecure2.example.db
 rm -f ns3/nozsk.example.db ns3/inaczsk.example.db
 rm -f ns3/reconf.example.db
 rm -f ns3/ttl*.db
+rm -f ns3/sigthreads1.example.db ns3/sigthreads4.example.db
+rm -f ns3/named.stats
 rm -f signing.out.*
 rm -f ns3/*.nzf
 rm -f digcomp.out.test*
+rm -f sigthreads.out.*
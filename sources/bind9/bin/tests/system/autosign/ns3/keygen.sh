@@ -224,6 +224,17 @@ $KEYGEN -3 -q -r $RANDFILE -L 30 -fk $zone > kg.out 2>&1 || dumpit kg.out
 cat ${infile} K${zone}.+*.key > $zonefile
 $KEYGEN -3 -q -r $RANDFILE -L 180 $zone > kg.out 2>&1 || dumpit kg.out
 
+#
+# The same zone signed with one and with four signing tasks.
+#
+for zone in sigthreads1.example sigthreads4.example
+do
+	setup $zone
+	$KEYGEN -3 -q -r $RANDFILE -fk $zone > kg.out 2>&1 || dumpit kg.out
+	$KEYGEN -3 -q -r $RANDFILE $zone > kg.out 2>&1 || dumpit kg.out
+	cp sigthreads.example.db.in $zonefile
+done
+
 #
 # A zone with a DNSKEY RRset that is published before it's activated
 #
@@ -1170,5 +1170,57 @@ if [ "$lret" != 0 ]; then ret=$lret; fi
 if [ $ret != 0 ]; then echo "I:failed"; fi
 status=`expr $status + $ret`
 
+echo "I:checking zones signed with 1 and 4 signing tasks match ($n)"
+ret=0
+# list each RRSIG by owner, type covered, algorithm and key, without
+# the zone name so the two zones can be compared
+sigs () {
+	$DIG $DIGOPTS axfr $1 @10.53.0.3 |
+	awk -v zone="$1." '$4 == "RRSIG" {
+		name = $1
+		if (name == zone)
+			name = "@"
+		else
+			sub("\\." zone "$", "", name)
+		print name, $5, $6, $11
+	}' > sigthreads.out.$1.$n
+	awk '{ print $1, $2, $3 }' sigthreads.out.$1.$n | sort
+}
+for i in 0 1 2 3 4 5 6 7 8 9
+do
+	lret=0
+	sigs sigthreads1.example > sigthreads.out.1.$n
+	sigs sigthreads4.example > sigthreads.out.4.$n
+	grep "^a30 TXT" sigthreads.out.1.$n > /dev/null || lret=1
+	grep "^a30 TXT" sigthreads.out.4.$n > /dev/null || lret=1
+	grep "^@ NSEC" sigthreads.out.1.$n > /dev/null || lret=1
+	grep "^@ NSEC" sigthreads.out.4.$n > /dev/null || lret=1
+	cmp -s sigthreads.out.1.$n sigthreads.out.4.$n || lret=1
+	[ $lret = 0 ] && break
+	echo "I:waiting ... ($i)"
+	sleep 2
+done
+[ $lret = 0 ] || ret=1
+# one signature per RRset and key, however many tasks signed it
+for zone in sigthreads1.example sigthreads4.example
+do
+	dups=`sort sigthreads.out.$zone.$n | uniq -d | wc -l`
+	[ $dups -eq 0 ] || { echo "I:$zone has duplicate RRSIGs"; ret=1; }
+done
+n=`expr $n + 1`
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:checking signing statistics ($n)"
+ret=0
+rm -f ns3/named.stats
+$RNDC -c ../common/rndc.conf -s 10.53.0.3 -p 9953 stats 2>&1 | sed 's/^/I:ns3 /'
+sigsgenerated=`awk '/signatures generated$/ { print $1 }' ns3/named.stats`
+[ "${sigsgenerated:-0}" -gt 0 ] || ret=1
+grep "milliseconds spent generating signatures$" ns3/named.stats > /dev/null || ret=1
+n=`expr $n + 1`
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
 echo "I:exit status: $status"
 exit $status
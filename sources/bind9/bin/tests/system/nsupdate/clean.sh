@@ -23,7 +23,8 @@ rm -f ns1/*.jnl ns2/*.jnl
 rm -f ns1/example.db ns1/unixtime.db ns1/update.db ns1/other.db ns1/keytests.db
 rm -f ns1/md5.key ns1/sha1.key ns1/sha224.key ns1/sha256.key ns1/sha384.key
 rm -f ns1/sha512.key ns1/ddns.key
-rm -f nsupdate.out
+rm -f nsupdate.out nsupdate.out.batch* nsupdate.out.coalesce*
+rm -f ns1/named.stats
 rm -f ns2/example.bk
 rm -f ns2/update.bk ns2/update.alt.bk
 rm -f */named.memstats
@@ -532,5 +532,102 @@ if [ $ret -ne 0 ]; then
     status=1
 fi
 
+n=`expr $n + 1`
+ret=0
+echo "I:check concurrent updates are applied and answered separately ($n)"
+for i in 1 2 3 4 5 6 7 8
+do
+    $NSUPDATE <<END > nsupdate.out.batch$i 2>&1 &
+server 10.53.0.1 5300
+update add batch$i.update.nil. 600 A 10.10.10.$i
+send
+END
+done
+$NSUPDATE <<END > nsupdate.out.batchfail 2>&1 &
+server 10.53.0.1 5300
+prereq yxdomain batch-missing.update.nil.
+update add batchfail.update.nil. 600 A 10.10.10.99
+send
+END
+wait
+for i in 1 2 3 4 5 6 7 8
+do
+    $DIG +short @10.53.0.1 -p 5300 batch$i.update.nil A > dig.out.batch$i
+    grep "^10.10.10.$i$" dig.out.batch$i > /dev/null || ret=1
+done
+grep NXDOMAIN nsupdate.out.batchfail > /dev/null || ret=1
+$DIG +short @10.53.0.1 -p 5300 batchfail.update.nil A > dig.out.batchfail
+test -s dig.out.batchfail && ret=1
+if [ $ret -ne 0 ]; then
+    echo "I:failed"
+    status=1
+fi
+
+n=`expr $n + 1`
+ret=0
+echo "I:check failed updates are backed out of coalesced updates ($n)"
+# Each round queues updates to one zone from many clients at once, one
+# of which fails a prerequisite, and one of which is only refused after
+# its change has been made (an MX pointing at an address, with check-mx
+# fail), so that the changes of the others have to be replayed into a
+# new version.  Repeat until the server reports that updates were
+# coalesced.
+round=0
+coalesced=0
+while [ $round -lt 5 -a $coalesced -eq 0 ]
+do
+    round=`expr $round + 1`
+    for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16
+    do
+	$NSUPDATE <<END > nsupdate.out.coalesce$round.$i 2>&1 &
+server 10.53.0.1 5300
+update add coalesce$round-$i.update.nil. 600 A 10.10.$round.$i
+send
+END
+	if [ $i -eq 6 ]; then
+	    $NSUPDATE <<END > nsupdate.out.coalesce$round.prereq 2>&1 &
+server 10.53.0.1 5300
+prereq yxdomain coalesce-missing.update.nil.
+update add coalesce$round-prereq.update.nil. 600 A 10.10.$round.99
+send
+END
+	fi
+	if [ $i -eq 10 ]; then
+	    $NSUPDATE <<END > nsupdate.out.coalesce$round.mx 2>&1 &
+server 10.53.0.1 5300
+update add coalesce$round-mx.update.nil. 600 A 10.10.$round.98
+update add coalesce$round-mx.update.nil. 600 MX 10 10.53.0.1.
+send
+END
+	fi
+    done
+    wait
+    for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16
+    do
+	$DIG +short @10.53.0.1 -p 5300 coalesce$round-$i.update.nil A \
+		> dig.out.coalesce$round.$i
+	grep "^10.10.$round.$i$" dig.out.coalesce$round.$i > /dev/null || ret=1
+    done
+    grep NXDOMAIN nsupdate.out.coalesce$round.prereq > /dev/null || ret=1
+    grep REFUSED nsupdate.out.coalesce$round.mx > /dev/null || ret=1
+    for f in prereq mx
+    do
+	$DIG +short @10.53.0.1 -p 5300 coalesce$round-$f.update.nil ANY \
+		> dig.out.coalesce$round.$f
+	test -s dig.out.coalesce$round.$f && ret=1
+    done
+    rm -f ns1/named.stats
+    $RNDC -c $SYSTEMTESTTOP/common/rndc.conf -p 9953 -s 10.53.0.1 stats
+    coalesced=`sed -n -e "s/[	 ]*\([0-9]*\) updates coalesced into a shared transaction.*/\1/p" \
+	    ns1/named.stats | head -1`
+    coalesced=`expr 0$coalesced + 0`
+done
+echo "I:UpdateCoalesced $coalesced after $round round(s)"
+[ $coalesced -gt 0 ] || ret=1
+if [ $ret -ne 0 ]; then
+    echo "I:failed"
+    status=1
+fi
+
 echo "I:exit status: $status"
 exit $status
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Measure task manager event throughput for an increasing number of
+ * worker threads, with the shared ready queue and with a ready queue
+ * per worker (ISC_TASKMGR_PERWORKER).
+ *
+ * Every task starts a chain of events; each event passes the chain on
+ * to the next task, so events constantly cross from one queue to another.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/commandline.h>
+#include <isc/condition.h>
+#include <isc/event.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/task.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+#define MAXTASKS	1024
+
+isc_mem_t *mctx = NULL;
+
+static isc_task_t *tasks[MAXTASKS];
+static unsigned int ntasks = 64;
+static unsigned int nevents = 10000;
+static unsigned int work = 100;
+
+static isc_mutex_t lock;
+static isc_condition_t done;
+static unsigned int finished;
+
+typedef struct chain {
+	unsigned int next;
+	unsigned int remaining;
+} chain_t;
+
+static void
+hop(isc_task_t *task, isc_event_t *event) {
+	chain_t *chain = event->ev_arg;
+	volatile unsigned int i, j = 0;
+
+	UNUSED(task);
+
+	for (i = 0; i < work; i++)
+		j += i;
+
+	if (--chain->remaining == 0) {
+		isc_event_free(&event);
+		LOCK(&lock);
+		if (++finished == ntasks)
+			SIGNAL(&done);
+		UNLOCK(&lock);
+		return;
+	}
+
+	chain->next = (chain->next + 1) % ntasks;
+	isc_task_send(tasks[chain->next], &event);
+}
+
+static double
+run(unsigned int workers, unsigned int options) {
+	isc_taskmgr_t *manager = NULL;
+	isc_event_t *event;
+	chain_t *chains;
+	isc_time_t start, end;
+	isc_uint64_t usecs;
+	unsigned int i;
+
+	RUNTIME_CHECK(isc_taskmgr_create2(mctx, workers, 0, options,
+					  &manager) == ISC_R_SUCCESS);
+
+	chains = isc_mem_get(mctx, ntasks * sizeof(*chains));
+	RUNTIME_CHECK(chains != NULL);
+
+	for (i = 0; i < ntasks; i++) {
+		tasks[i] = NULL;
+		RUNTIME_CHECK(isc_task_create(manager, 0, &tasks[i]) ==
+			      ISC_R_SUCCESS);
+	}
+
+	finished = 0;
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+
+	for (i = 0; i < ntasks; i++) {
+		chains[i].next = i;
+		chains[i].remaining = nevents;
+		event = isc_event_allocate(mctx, (void *)1, 1, hop,
+					   &chains[i], sizeof(*event));
+		RUNTIME_CHECK(event != NULL);
+		isc_task_send(tasks[i], &event);
+	}
+
+	LOCK(&lock);
+	while (finished < ntasks)
+		WAIT(&done, &lock);
+	UNLOCK(&lock);
+
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+	usecs = isc_time_microdiff(&end, &start);
+	if (usecs == 0)
+		usecs = 1;
+
+	for (i = 0; i < ntasks; i++)
+		isc_task_detach(&tasks[i]);
+	isc_taskmgr_destroy(&manager);
+	isc_mem_put(mctx, chains, ntasks * sizeof(*chains));
+
+	return ((double)ntasks * nevents * 1000000.0 / (double)usecs);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: taskperf_test [-t tasks] [-e events] "
+		"[-l loop] [-w maxworkers]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int workers, maxworkers = 16;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "e:l:t:w:")) != -1) {
+		switch (ch) {
+		case 'e':
+			nevents = atoi(isc_commandline_argument);
+			break;
+		case 'l':
+			work = atoi(isc_commandline_argument);
+			break;
+		case 't':
+			ntasks = atoi(isc_commandline_argument);
+			break;
+		case 'w':
+			maxworkers = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (ntasks < 1 || ntasks > MAXTASKS || nevents < 1 || maxworkers < 1)
+		usage();
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_condition_init(&done) == ISC_R_SUCCESS);
+
+	printf("%u tasks, %u events per task, %u loops per event\n",
+	       ntasks, nevents, work);
+	printf("%8s %16s %16s\n", "workers", "shared/sec", "perworker/sec");
+
+	for (workers = 1; workers <= maxworkers; workers *= 2)
+		printf("%8u %16.0f %16.0f\n", workers, run(workers, 0),
+		       run(workers, ISC_TASKMGR_PERWORKER));
+
+	(void)isc_condition_destroy(&done);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
+
+#else
+
+int
+main(int argc, char *argv[]) {
+	UNUSED(argc);
+	UNUSED(argv);
+	fprintf(stderr, "This test requires threads.\n");
+	return(1);
+}
+
+#endif
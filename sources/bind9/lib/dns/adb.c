@@ -28,8 +28,10 @@
 
 #include <limits.h>
 
+#include <isc/atomic.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
+#include <isc/platform.h>
 #include <isc/random.h>
 #include <isc/stats.h>
 #include <isc/string.h>         /* Required for HP/UX (and others?) */
@@ -89,6 +91,37 @@
 
 #define DNS_ADB_MINADBSIZE      (1024U*1024U)     /*%< 1 Megabyte */
 
+/*%
+ * Where the platform has atomic add and compare-and-exchange, the
+ * reference count, RTT, flags and expiry time of an address entry are
+ * only ever changed atomically.  That allows the paths that read an
+ * entry or feed back on it, as opposed to linking or unlinking it, to
+ * do so without taking the entry's bucket lock:
+ *
+ *\li	copying a well known name's addresses out to a find, as long
+ *	as the entry has no lameness information to check;
+ *\li	releasing a reference which is not the last one;
+ *\li	RTT and EDNS/flag updates from the resolver.
+ *
+ * The entry cannot go away underneath any of these, as each holds a
+ * reference to it (directly, or through a namehook of a name whose
+ * bucket is locked), and an entry is only freed once its reference
+ * count has dropped to zero with the bucket locked.
+ */
+#if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
+#define ADB_USEATOMIC 1
+#endif
+
+#ifdef ADB_USEATOMIC
+#define ENTRY_INCREF(e) \
+	((void)isc_atomic_xadd((isc_int32_t *)&(e)->refcnt, 1))
+#define ENTRY_DECREF(e) \
+	((unsigned int)(isc_atomic_xadd((isc_int32_t *)&(e)->refcnt, -1) - 1))
+#else
+#define ENTRY_INCREF(e)	((void)(e)->refcnt++)
+#define ENTRY_DECREF(e)	(--(e)->refcnt)
+#endif
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -293,6 +326,10 @@ static void print_fetch_list(FILE *, dns_adbname_t *);
 static inline isc_boolean_t dec_adb_irefcnt(dns_adb_t *);
 static inline void inc_adb_irefcnt(dns_adb_t *);
 static inline void inc_adb_erefcnt(dns_adb_t *);
+static inline void entry_setflags(dns_adbentry_t *, unsigned int,
+				  unsigned int);
+static inline void entry_setexpire(dns_adbentry_t *, isc_stdtime_t);
+static inline isc_boolean_t release_entry(dns_adbentry_t *);
 static inline void inc_entry_refcnt(dns_adb_t *, dns_adbentry_t *,
 				    isc_boolean_t);
 static inline isc_boolean_t dec_entry_refcnt(dns_adb_t *, isc_boolean_t,
@@ -898,7 +935,7 @@ import_rdataset(dns_adbname_t *adbname, dns_rdataset_t *rdataset,
 				if (anh->entry == foundentry)
 					break;
 			if (anh == NULL) {
-				foundentry->refcnt++;
+				ENTRY_INCREF(foundentry);
 				nh->entry = foundentry;
 			} else
 				free_adbnamehook(adb, &nh);
@@ -1116,7 +1153,7 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 				continue;
 			}
 			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
+			entry_setflags(e, ENTRY_IS_DEAD, ENTRY_IS_DEAD);
 			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
 			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
 		}
@@ -1553,6 +1590,79 @@ inc_adb_erefcnt(dns_adb_t *adb) {
 	UNLOCK(&adb->reflock);
 }
 
+/*
+ * Set '*p' to 'val' if it is still 'old'.  Unless ADB_USEATOMIC is
+ * defined the entry's bucket must be locked.
+ */
+static inline isc_boolean_t
+entry_cmpxchg(unsigned int *p, unsigned int old, unsigned int val) {
+#ifdef ADB_USEATOMIC
+	return (ISC_TF((unsigned int)isc_atomic_cmpxchg((isc_int32_t *)p,
+							(isc_int32_t)old,
+							(isc_int32_t)val)
+		       == old));
+#else
+	if (*p != old)
+		return (ISC_FALSE);
+	*p = val;
+	return (ISC_TRUE);
+#endif
+}
+
+/*
+ * Replace the bits of the entry's flags in 'mask' with those in 'bits'.
+ * Unless ADB_USEATOMIC is defined the entry's bucket must be locked.
+ */
+static inline void
+entry_setflags(dns_adbentry_t *entry, unsigned int bits, unsigned int mask) {
+	unsigned int flags;
+
+	do {
+		flags = entry->flags;
+	} while (!entry_cmpxchg(&entry->flags, flags,
+				(flags & ~mask) | (bits & mask)));
+}
+
+/*
+ * Have the entry persist for ADB_ENTRY_WINDOW seconds from 'now', if it
+ * was not already given an expiry time.  Unless ADB_USEATOMIC is
+ * defined the entry's bucket must be locked.
+ */
+static inline void
+entry_setexpire(dns_adbentry_t *entry, isc_stdtime_t now) {
+	if (entry->expires == 0)
+		(void)entry_cmpxchg(&entry->expires, 0,
+				    now + ADB_ENTRY_WINDOW);
+}
+
+/*
+ * Drop a reference to the entry without locking its bucket.  This is
+ * only done when ADB_USEATOMIC is defined, the reference is not the
+ * last one and the entry already has an expiry time, as otherwise
+ * dec_entry_refcnt() may have work to do; ISC_FALSE is returned then
+ * and the caller has to use that instead.
+ */
+static inline isc_boolean_t
+release_entry(dns_adbentry_t *entry) {
+#ifdef ADB_USEATOMIC
+	unsigned int refcnt;
+
+	if (entry->expires == 0)
+		return (ISC_FALSE);
+	do {
+		refcnt = entry->refcnt;
+		if (refcnt <= 1)
+			return (ISC_FALSE);
+	} while (!entry_cmpxchg(&entry->refcnt, refcnt, refcnt - 1));
+
+	return (ISC_TRUE);
+#else
+	UNUSED(entry);
+
+	return (ISC_FALSE);
+#endif
+}
+
 static inline void
 inc_entry_refcnt(dns_adb_t *adb, dns_adbentry_t *entry, isc_boolean_t lock) {
 	int bucket;
@@ -1562,7 +1672,7 @@ inc_entry_refcnt(dns_adb_t *adb, dns_adbentry_t *entry, isc_boolean_t lock) {
 	if (lock)
 		LOCK(&adb->entrylocks[bucket]);
 
-	entry->refcnt++;
+	ENTRY_INCREF(entry);
 
 	if (lock)
 		UNLOCK(&adb->entrylocks[bucket]);
@@ -1576,16 +1686,18 @@ dec_entry_refcnt(dns_adb_t *adb, isc_boolean_t overmem, dns_adbentry_t *entry,
 	isc_boolean_t destroy_entry;
 	isc_boolean_t result = ISC_FALSE;
 
+	if (lock && release_entry(entry))
+		return (ISC_FALSE);
+
 	bucket = entry->lock_bucket;
 
 	if (lock)
 		LOCK(&adb->entrylocks[bucket]);
 
 	INSIST(entry->refcnt > 0);
-	entry->refcnt--;
 
 	destroy_entry = ISC_FALSE;
-	if (entry->refcnt == 0 &&
+	if (ENTRY_DECREF(entry) == 0 &&
 	    (adb->entry_sd[bucket] || entry->expires == 0 || overmem ||
 	     (entry->flags & ENTRY_IS_DEAD) != 0)) {
 		destroy_entry = ISC_TRUE;
@@ -2072,45 +2184,75 @@ entry_is_lame(dns_adb_t *adb, dns_adbentry_t *entry, dns_name_t *qname,
 	return (is_bad);
 }
 
+/*
+ * Add the address of 'entry' to the find, unless it is lame for
+ * 'qname'/'qtype' and the find does not want lame addresses.
+ */
+static isc_result_t
+copy_entry(dns_adb_t *adb, dns_adbfind_t *find, dns_name_t *qname,
+	   dns_rdatatype_t qtype, dns_adbentry_t *entry, isc_stdtime_t now)
+{
+	dns_adbaddrinfo_t *addrinfo;
+	isc_boolean_t locked;
+	isc_result_t result = ISC_R_SUCCESS;
+	int bucket = DNS_ADB_INVALIDBUCKET;
+
+#ifdef ADB_USEATOMIC
+	/*
+	 * The bucket only needs locking if there is lameness information
+	 * to check (and clean up).  The name's bucket is locked, so the
+	 * namehook's reference keeps the entry alive meanwhile.
+	 */
+	locked = ISC_TF(!FIND_RETURNLAME(find) &&
+			!ISC_LIST_EMPTY(entry->lameinfo));
+#else
+	locked = ISC_TRUE;
+#endif
+	if (locked) {
+		bucket = entry->lock_bucket;
+		INSIST(bucket != DNS_ADB_INVALIDBUCKET);
+		LOCK(&adb->entrylocks[bucket]);
+
+		if (!FIND_RETURNLAME(find)
+		    && entry_is_lame(adb, entry, qname, qtype, now)) {
+			find->options |= DNS_ADBFIND_LAMEPRUNED;
+			goto unlock;
+		}
+	}
+
+	addrinfo = new_adbaddrinfo(adb, entry, find->port);
+	if (addrinfo == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto unlock;
+	}
+	/*
+	 * Found a valid entry.  Add it to the find's list.
+	 */
+	ENTRY_INCREF(entry);
+	ISC_LIST_APPEND(find->list, addrinfo, publink);
+
+ unlock:
+	if (locked)
+		UNLOCK(&adb->entrylocks[bucket]);
+
+	return (result);
+}
+
 static void
 copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find, dns_name_t *qname,
 		    dns_rdatatype_t qtype, dns_adbname_t *name,
 		    isc_stdtime_t now)
 {
 	dns_adbnamehook_t *namehook;
-	dns_adbaddrinfo_t *addrinfo;
-	dns_adbentry_t *entry;
-	int bucket;
-
-	bucket = DNS_ADB_INVALIDBUCKET;
 
 	if (find->options & DNS_ADBFIND_INET) {
 		namehook = ISC_LIST_HEAD(name->v4);
 		while (namehook != NULL) {
-			entry = namehook->entry;
-			bucket = entry->lock_bucket;
-			INSIST(bucket != DNS_ADB_INVALIDBUCKET);
-			LOCK(&adb->entrylocks[bucket]);
-
-			if (!FIND_RETURNLAME(find)
-			    && entry_is_lame(adb, entry, qname, qtype, now)) {
-				find->options |= DNS_ADBFIND_LAMEPRUNED;
-				goto nextv4;
-			}
-			addrinfo = new_adbaddrinfo(adb, entry, find->port);
-			if (addrinfo == NULL) {
+			if (copy_entry(adb, find, qname, qtype,
+				       namehook->entry, now) != ISC_R_SUCCESS) {
 				find->partial_result |= DNS_ADBFIND_INET;
-				goto out;
+				return;
 			}
-			/*
-			 * Found a valid entry.  Add it to the find's list.
-			 */
-			inc_entry_refcnt(adb, entry, ISC_FALSE);
-			ISC_LIST_APPEND(find->list, addrinfo, publink);
-			addrinfo = NULL;
-		nextv4:
-			UNLOCK(&adb->entrylocks[bucket]);
-			bucket = DNS_ADB_INVALIDBUCKET;
 			namehook = ISC_LIST_NEXT(namehook, plink);
 		}
 	}
@@ -2118,37 +2260,14 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find, dns_name_t *qname,
 	if (find->options & DNS_ADBFIND_INET6) {
 		namehook = ISC_LIST_HEAD(name->v6);
 		while (namehook != NULL) {
-			entry = namehook->entry;
-			bucket = entry->lock_bucket;
-			INSIST(bucket != DNS_ADB_INVALIDBUCKET);
-			LOCK(&adb->entrylocks[bucket]);
-
-			if (!FIND_RETURNLAME(find)
-			    && entry_is_lame(adb, entry, qname, qtype, now)) {
-				find->options |= DNS_ADBFIND_LAMEPRUNED;
-				goto nextv6;
-			}
-			addrinfo = new_adbaddrinfo(adb, entry, find->port);
-			if (addrinfo == NULL) {
+			if (copy_entry(adb, find, qname, qtype,
+				       namehook->entry, now) != ISC_R_SUCCESS) {
 				find->partial_result |= DNS_ADBFIND_INET6;
-				goto out;
+				return;
 			}
-			/*
-			 * Found a valid entry.  Add it to the find's list.
-			 */
-			inc_entry_refcnt(adb, entry, ISC_FALSE);
-			ISC_LIST_APPEND(find->list, addrinfo, publink);
-			addrinfo = NULL;
-		nextv6:
-			UNLOCK(&adb->entrylocks[bucket]);
-			bucket = DNS_ADB_INVALIDBUCKET;
 			namehook = ISC_LIST_NEXT(namehook, plink);
 		}
 	}
-
- out:
-	if (bucket != DNS_ADB_INVALIDBUCKET)
-		UNLOCK(&adb->entrylocks[bucket]);
 }
 
 static void
@@ -2918,7 +3037,7 @@ dns_adb_createfind2(dns_adb_t *adb, isc_task_t *task, isc_taskaction_t action,
 			adbname->flags |= NAME_GLUE_OK;
 		if (FIND_STARTATZONE(find))
 			adbname->flags |= NAME_STARTATZONE;
-	} else {
+	} else if (ISC_LIST_HEAD(adb->names[bucket]) != adbname) {
 		/* Move this name forward in the LRU list */
 		ISC_LIST_UNLINK(adb->names[bucket], adbname, plink);
 		ISC_LIST_PREPEND(adb->names[bucket], adbname, plink);
@@ -3961,70 +4080,100 @@ void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		   unsigned int rtt, unsigned int factor)
 {
+#ifndef ADB_USEATOMIC
 	int bucket;
+#endif
 	isc_stdtime_t now = 0;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(factor <= 10);
 
+#ifndef ADB_USEATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
 	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE)
 		isc_stdtime_get(&now);
 	adjustsrtt(addr, rtt, factor, now);
 
+#ifndef ADB_USEATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 }
 
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
+#ifndef ADB_USEATOMIC
 	int bucket;
+#endif
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
+#ifndef ADB_USEATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
 
+#ifndef ADB_USEATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 }
 
+/*
+ * Unless ADB_USEATOMIC is defined the entry's bucket must be locked.
+ */
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now)
 {
+	dns_adbentry_t *entry = addr->entry;
+	isc_boolean_t age = ISC_FALSE;
 	isc_uint64_t new_srtt;
+	unsigned int srtt, lastage;
 
+	/*
+	 * Only whoever moves 'lastage' on to 'now' ages the entry, so it
+	 * is aged at most once a second however many callers there are.
+	 */
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
-			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
-			new_srtt >>= 9;
-			addr->entry->lastage = now;
+		lastage = entry->lastage;
+		age = ISC_TF(lastage != now &&
+			     entry_cmpxchg(&entry->lastage, lastage, now));
+	}
+
+	do {
+		srtt = entry->srtt;
+		if (factor == DNS_ADB_RTTADJAGE) {
+			new_srtt = srtt;
+			if (age) {
+				new_srtt <<= 9;
+				new_srtt -= srtt;
+				new_srtt >>= 9;
+			}
 		} else
-			new_srtt = addr->entry->srtt;
-	} else
-		new_srtt = (addr->entry->srtt / 10 * factor)
-			+ (rtt / 10 * (10 - factor));
+			new_srtt = (srtt / 10 * factor)
+				+ (rtt / 10 * (10 - factor));
 
-	new_srtt &= 0xffffffff;
-	addr->entry->srtt = (unsigned int) new_srtt;
+		new_srtt &= 0xffffffff;
+	} while (!entry_cmpxchg(&entry->srtt, srtt,
+				(unsigned int) new_srtt));
 	addr->srtt = (unsigned int) new_srtt;
 
-	if (addr->entry->expires == 0)
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+	entry_setexpire(entry, now);
 }
 
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		    unsigned int bits, unsigned int mask)
 {
+#ifndef ADB_USEATOMIC
 	int bucket;
+#endif
 	isc_stdtime_t now;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -4033,13 +4182,15 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	REQUIRE((bits & ENTRY_IS_DEAD) == 0);
 	REQUIRE((mask & ENTRY_IS_DEAD) == 0);
 
+#ifndef ADB_USEATOMIC
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
+#endif
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
+	entry_setflags(addr->entry, bits, mask);
 	if (addr->entry->expires == 0) {
 		isc_stdtime_get(&now);
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+		entry_setexpire(addr->entry, now);
 	}
 
 	/*
@@ -4048,7 +4199,9 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	 */
 	addr->flags = (addr->flags & ~mask) | (bits & mask);
 
+#ifndef ADB_USEATOMIC
 	UNLOCK(&adb->entrylocks[bucket]);
+#endif
 }
 
 isc_result_t
@@ -4121,19 +4274,23 @@ dns_adb_freeaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **addrp) {
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
 
 	*addrp = NULL;
-	overmem = isc_mem_isovermem(adb->mctx);
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	if (!release_entry(entry)) {
+		overmem = isc_mem_isovermem(adb->mctx);
 
-	if (entry->expires == 0) {
-		isc_stdtime_get(&now);
-		entry->expires = now + ADB_ENTRY_WINDOW;
-	}
+		bucket = addr->entry->lock_bucket;
+		LOCK(&adb->entrylocks[bucket]);
 
-	want_check_exit = dec_entry_refcnt(adb, overmem, entry, ISC_FALSE);
+		if (entry->expires == 0) {
+			isc_stdtime_get(&now);
+			entry_setexpire(entry, now);
+		}
 
-	UNLOCK(&adb->entrylocks[bucket]);
+		want_check_exit = dec_entry_refcnt(adb, overmem, entry,
+						   ISC_FALSE);
+
+		UNLOCK(&adb->entrylocks[bucket]);
+	}
 
 	addr->entry = NULL;
 	free_adbaddrinfo(adb, &addr);
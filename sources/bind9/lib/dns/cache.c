@@ -137,6 +137,7 @@ struct dns_cache {
 	int			db_argc;
 	char			**db_argv;
 	size_t			size;
+	dns_ttl_t		serve_stale_ttl;
 
 	/* Locked by 'filelock'. */
 	char			*filename;
@@ -236,6 +237,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->references = 1;
 	cache->live_tasks = 0;
 	cache->rdclass = rdclass;
+	cache->serve_stale_ttl = 0;
 
 	cache->db_type = isc_mem_strdup(cmctx, db_type);
 	if (cache->db_type == NULL) {
@@ -1080,6 +1082,29 @@ dns_cache_getcachesize(dns_cache_t *cache) {
 	return (size);
 }
 
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->serve_stale_ttl = ttl;
+	(void)dns_db_setservestalettl(cache->db, ttl);
+	UNLOCK(&cache->lock);
+}
+
+dns_ttl_t
+dns_cache_getservestalettl(dns_cache_t *cache) {
+	dns_ttl_t ttl;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	ttl = cache->serve_stale_ttl;
+	UNLOCK(&cache->lock);
+
+	return (ttl);
+}
+
 /*
  * The cleaner task is shutting down; do the necessary cleanup.
  */
@@ -1146,6 +1171,7 @@ dns_cache_flush(dns_cache_t *cache) {
 	}
 	dns_db_detach(&cache->db);
 	cache->db = db;
+	(void)dns_db_setservestalettl(cache->db, cache->serve_stale_ttl);
 	UNLOCK(&cache->cleaner.lock);
 	UNLOCK(&cache->lock);
 
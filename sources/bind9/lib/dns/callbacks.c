@@ -90,9 +90,12 @@ dns_rdatacallbacks_initcommon(dns_rdatacallbacks_t *callbacks) {
 	callbacks->add = NULL;
 	callbacks->rawdata = NULL;
 	callbacks->zone = NULL;
+	callbacks->deserialize = NULL;
 	callbacks->add_private = NULL;
+	callbacks->deserialize_private = NULL;
 	callbacks->error_private = NULL;
 	callbacks->warn_private = NULL;
+	callbacks->records = 0;
 }
 
 /*
@@ -42,17 +42,153 @@
  ***	Compression
  ***/
 
+/*
+ * The global compression table maps each suffix of the names added so
+ * far to its offset in the message.  It uses linear probing.  Nodes are
+ * kept in the order they were added, which is also the order of their
+ * offsets, so rollback removes nodes from the end; removing the most
+ * recently added key from a linear probing table only needs its slot
+ * emptied.
+ *
+ * Suffix hashes are computed from the root towards the owner, one label
+ * at a time, so hashing every suffix of a name is one pass over it.
+ */
+
+#define HASHINIT	2166136261U
+#define HASHSTEP(h, c)	(((h) ^ (c)) * 16777619U)
+#define HASHSLOT(h, t)	(((h) ^ ((h) >> 16)) & ((t) - 1))
+
+#define TOLOWER(c)	(((c) >= 'A' && (c) <= 'Z') ? (c) + 'a' - 'A' : (c))
+
+/*
+ * Find the offset of each label of the absolute name 'name', and the hash
+ * of each suffix of it.  Return the number of labels.
+ */
+static unsigned int
+suffixes(const dns_name_t *name, unsigned char *offsets,
+	 isc_uint32_t *hashes)
+{
+	const unsigned char *ndata = name->ndata;
+	unsigned int labels, n, i, len;
+	isc_uint32_t h;
+
+	labels = dns_name_countlabels(name);
+	INSIST(labels > 0 && labels <= 128);
+
+	if (name->offsets != NULL)
+		memmove(offsets, name->offsets, labels);
+	else {
+		for (i = 0, n = 0; n < labels; n++) {
+			offsets[n] = i;
+			i += ndata[i] + 1;
+		}
+	}
+
+	h = HASHINIT;
+	hashes[labels - 1] = h;
+	for (n = labels - 1; n > 0; n--) {
+		i = offsets[n - 1];
+		len = ndata[i++];
+		h = HASHSTEP(h, len);
+		while (len-- > 0) {
+			h = HASHSTEP(h, TOLOWER(ndata[i]));
+			i++;
+		}
+		hashes[n - 1] = h;
+	}
+	return (labels);
+}
+
+/*
+ * Return the node for the suffix 'data' of length 'length' and hash
+ * 'hash', or NULL.
+ */
+static inline dns_compressnode_t *
+lookup(dns_compress_t *cctx, const unsigned char *data, unsigned int length,
+       isc_uint32_t hash)
+{
+	dns_compressnode_t *node;
+	unsigned int slot, i;
+
+	slot = HASHSLOT(hash, cctx->tablesize);
+	while (cctx->table[slot] != 0) {
+		node = &cctx->nodes[cctx->table[slot] - 1];
+		if (node->hash == hash && node->length == length) {
+			if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0) {
+				if (memcmp(node->data, data, length) == 0)
+					return (node);
+			} else {
+				for (i = 0; i < length; i++)
+					if (TOLOWER(node->data[i]) !=
+					    TOLOWER(data[i]))
+						break;
+				if (i == length)
+					return (node);
+			}
+		}
+		slot = (slot + 1) & (cctx->tablesize - 1);
+	}
+	return (NULL);
+}
+
+static inline void
+insert(dns_compress_t *cctx, unsigned int index) {
+	unsigned int slot;
+
+	slot = HASHSLOT(cctx->nodes[index].hash, cctx->tablesize);
+	while (cctx->table[slot] != 0)
+		slot = (slot + 1) & (cctx->tablesize - 1);
+	cctx->table[slot] = (isc_uint16_t)(index + 1);
+}
+
+/*
+ * Double the size of the table and node array.
+ */
+static isc_result_t
+grow(dns_compress_t *cctx) {
+	isc_uint16_t *table;
+	dns_compressnode_t *nodes;
+	unsigned int tablesize, i;
+
+	tablesize = cctx->tablesize * 2;
+	if (tablesize / 2 > 0x4000)
+		return (ISC_R_NOSPACE);
+	table = isc_mem_get(cctx->mctx, tablesize * sizeof(*table));
+	if (table == NULL)
+		return (ISC_R_NOMEMORY);
+	nodes = isc_mem_get(cctx->mctx, tablesize / 2 * sizeof(*nodes));
+	if (nodes == NULL) {
+		isc_mem_put(cctx->mctx, table, tablesize * sizeof(*table));
+		return (ISC_R_NOMEMORY);
+	}
+	memmove(nodes, cctx->nodes, cctx->count * sizeof(*nodes));
+	memset(table, 0, tablesize * sizeof(*table));
+
+	if (cctx->table != cctx->initialtable) {
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*table));
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->tablesize / 2 * sizeof(*nodes));
+	}
+	cctx->table = table;
+	cctx->nodes = nodes;
+	cctx->tablesize = tablesize;
+	for (i = 0; i < cctx->count; i++)
+		insert(cctx, i);
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
-	unsigned int i;
-
 	REQUIRE(cctx != NULL);
 	REQUIRE(mctx != NULL);	/* See: rdataset.c:towiresorted(). */
 
 	cctx->allowed = 0;
 	cctx->edns = edns;
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++)
-		cctx->table[i] = NULL;
+	memset(cctx->initialtable, 0, sizeof(cctx->initialtable));
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_TABLESIZE;
+	cctx->nodes = cctx->initialnodes;
 	cctx->mctx = mctx;
 	cctx->count = 0;
 	cctx->magic = CCTX_MAGIC;
@@ -61,21 +197,18 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
 	cctx->magic = 0;
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
+	if (cctx->table != cctx->initialtable) {
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*cctx->table));
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->tablesize / 2 * sizeof(*cctx->nodes));
+		cctx->table = cctx->initialtable;
+		cctx->nodes = cctx->initialnodes;
 	}
+	cctx->count = 0;
 	cctx->allowed = 0;
 	cctx->edns = -1;
 }
@@ -117,14 +250,6 @@ dns_compress_getedns(dns_compress_t *cctx) {
 	return (cctx->edns);
 }
 
-#define NODENAME(node, name) \
-do { \
-	(name)->length = (node)->r.length; \
-	(name)->labels = (node)->labels; \
-	(name)->ndata = (node)->r.base; \
-	(name)->attributes = DNS_NAMEATTR_ABSOLUTE; \
-} while (0)
-
 /*
  * Find the longest match of name in the table.
  * If match is found return ISC_TRUE. prefix, suffix and offset are updated.
@@ -134,9 +259,10 @@ isc_boolean_t
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, isc_uint16_t *offset)
 {
-	dns_name_t tname, nname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, hash, n;
+	unsigned char offsets[128];
+	isc_uint32_t hashes[128];
+	unsigned int labels, n;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
@@ -145,27 +271,11 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	if (cctx->count == 0)
 		return (ISC_FALSE);
 
-	labels = dns_name_countlabels(name);
-	INSIST(labels > 0);
-
-	dns_name_init(&tname, NULL);
-	dns_name_init(&nname, NULL);
+	labels = suffixes(name, offsets, hashes);
 
 	for (n = 0; n < labels - 1; n++) {
-		dns_name_getlabelsequence(name, n, labels - n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		for (node = cctx->table[hash]; node != NULL; node = node->next)
-		{
-			NODENAME(node, &nname);
-			if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0) {
-				if (dns_name_caseequal(&nname, &tname))
-					break;
-			} else {
-				if (dns_name_equal(&nname, &tname))
-					break;
-			}
-		}
+		node = lookup(cctx, name->ndata + offsets[n],
+			      name->length - offsets[n], hashes[n]);
 		if (node != NULL)
 			break;
 	}
@@ -185,91 +295,62 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	return (ISC_TRUE);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, isc_uint16_t offset)
 {
-	dns_name_t tname;
+	dns_compressnode_t *node;
+	unsigned char offsets[128];
+	isc_uint32_t hashes[128];
 	unsigned int start;
-	unsigned int n;
 	unsigned int count;
-	unsigned int hash;
-	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	isc_uint16_t toffset;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
 
-	dns_name_init(&tname, NULL);
-
-	n = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
-	start = 0;
-	length = name_length(name);
-	while (count > 0) {
-		if (offset >= 0x4000)
+	if (count == 0)
+		return;
+
+	(void)suffixes(name, offsets, hashes);
+
+	for (start = 0; start < count; start++) {
+		if (offset + offsets[start] >= 0x4000)
 			break;
-		dns_name_getlabelsequence(name, start, n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		tlength = name_length(&tname);
-		toffset = (isc_uint16_t)(offset + (length - tlength));
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				return;
-		}
-		node->count = cctx->count++;
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		node->labels = (isc_uint8_t)dns_name_countlabels(&tname);
-		node->next = cctx->table[hash];
-		cctx->table[hash] = node;
-		start++;
-		n--;
-		count--;
+		if (cctx->count >= cctx->tablesize / 2 &&
+		    grow(cctx) != ISC_R_SUCCESS)
+			return;
+		node = &cctx->nodes[cctx->count];
+		node->data = name->ndata + offsets[start];
+		node->length = (isc_uint16_t)(name->length - offsets[start]);
+		node->hash = hashes[start];
+		node->offset = (isc_uint16_t)(offset + offsets[start]);
+		insert(cctx, cctx->count++);
 	}
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
+	unsigned int slot;
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end 
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && node->offset >= offset) {
-			cctx->table[i] = node->next;
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	/*
+	 * This relies on the nodes with the greatest offsets being at
+	 * the end of the nodes[] array.
+	 */
+	while (cctx->count > 0) {
+		node = &cctx->nodes[cctx->count - 1];
+		if (node->offset < offset)
+			break;
+		slot = HASHSLOT(node->hash, cctx->tablesize);
+		while (cctx->table[slot] != cctx->count)
+			slot = (slot + 1) & (cctx->tablesize - 1);
+		cctx->table[slot] = 0;
+		cctx->count--;
 	}
 }
 
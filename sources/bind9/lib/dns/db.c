@@ -25,9 +25,12 @@
 
 #include <config.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/platform.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -72,6 +75,18 @@ static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
 
+/*%
+ * The last database generation handed out.  A database's generation
+ * is read on every query, so where the platform allows it is read and
+ * written atomically; otherwise 'genlock' covers it too.
+ */
+static isc_mutex_t genlock;
+static isc_uint32_t lastgeneration = 0;
+
+#if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVEATOMICSTORE)
+#define DB_USEATOMIC 1
+#endif
+
 static dns_dbimplementation_t rbtimp;
 #ifdef BIND9
 static dns_dbimplementation_t rbt64imp;
@@ -80,6 +95,7 @@ static dns_dbimplementation_t rbt64imp;
 static void
 initialize(void) {
 	RUNTIME_CHECK(isc_rwlock_init(&implock, 0, 0) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&genlock) == ISC_R_SUCCESS);
 
 	rbtimp.name = "rbt";
 	rbtimp.create = dns_rbtdb_create;
@@ -102,6 +118,23 @@ initialize(void) {
 #endif
 }
 
+/*
+ * Give 'db' a generation that no other database has had.
+ */
+static void
+newgeneration(dns_db_t *db) {
+	LOCK(&genlock);
+	if (++lastgeneration == 0)
+		lastgeneration++;
+#ifdef DB_USEATOMIC
+	isc_atomic_store((isc_int32_t *)&db->generation,
+			 (isc_int32_t)lastgeneration);
+#else
+	db->generation = lastgeneration;
+#endif
+	UNLOCK(&genlock);
+}
+
 static inline dns_dbimplementation_t *
 impfind(const char *name) {
 	dns_dbimplementation_t *imp;
@@ -143,6 +176,16 @@ dns_db_create(isc_mem_t *mctx, const char *db_type, dns_name_t *origin,
 					    rdclass, argc, argv,
 					    impinfo->driverarg, dbp));
 		RWUNLOCK(&implock, isc_rwlocktype_read);
+		if (result == ISC_R_SUCCESS) {
+#ifdef BIND9
+			if (impinfo == &rbtimp || impinfo == &rbt64imp)
+#else
+			if (impinfo == &rbtimp)
+#endif
+				newgeneration(*dbp);
+			else
+				(*dbp)->generation = 0;
+		}
 		return (result);
 	}
 
@@ -316,6 +359,34 @@ dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
 	return ((db->methods->beginload)(db, addp, dbloadp));
 }
 
+static isc_result_t
+db_deserialize(void *arg, FILE *file, off_t offset) {
+	dns_db_t *db = arg;
+
+	return ((db->methods->deserialize)(db, file, offset));
+}
+
+isc_result_t
+dns_db_beginload2(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	isc_result_t result;
+
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(callbacks != NULL);
+	REQUIRE(callbacks->add == NULL && callbacks->add_private == NULL);
+
+	result = (db->methods->beginload)(db, &callbacks->add,
+					  &callbacks->add_private);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (db->methods->deserialize != NULL) {
+		callbacks->deserialize = db_deserialize;
+		callbacks->deserialize_private = db;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_db_endload(dns_db_t *db, dns_dbload_t **dbloadp) {
 	/*
@@ -355,7 +426,7 @@ dns_db_load3(dns_db_t *db, const char *filename, dns_masterformat_t format,
 
 	dns_rdatacallbacks_init(&callbacks);
 
-	result = dns_db_beginload(db, &callbacks.add, &callbacks.add_private);
+	result = dns_db_beginload2(db, &callbacks);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	result = dns_master_loadfile2(filename, &db->origin, &db->origin,
@@ -374,6 +445,18 @@ dns_db_load3(dns_db_t *db, const char *filename, dns_masterformat_t format,
 	return (result);
 }
 
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iszone(db));
+	REQUIRE(file != NULL);
+
+	if (db->methods->serialize == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	return ((db->methods->serialize)(db, version, file));
+}
+
 isc_result_t
 dns_db_dump(dns_db_t *db, dns_dbversion_t *version, const char *filename) {
 	return ((db->methods->dump)(db, version, filename,
@@ -460,6 +543,14 @@ dns_db_closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 
 	(db->methods->closeversion)(db, versionp, commit);
 
+	/*
+	 * Change the generation only once the new version is current, so
+	 * that nothing made from the old version is tagged with the new
+	 * generation.
+	 */
+	if (commit && dns_db_getgeneration(db) != 0)
+		newgeneration(db);
+
 	ENSURE(*versionp == NULL);
 }
 
@@ -820,6 +911,45 @@ dns_db_deleterdataset(dns_db_t *db, dns_dbnode_t *node,
 					      type, covers));
 }
 
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+
+	if (db->methods->setservestalettl != NULL)
+		return ((db->methods->setservestalettl)(db, ttl));
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(ttl != NULL);
+
+	if (db->methods->getservestalettl != NULL)
+		return ((db->methods->getservestalettl)(db, ttl));
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_uint32_t
+dns_db_getgeneration(dns_db_t *db) {
+	isc_uint32_t generation;
+
+	REQUIRE(DNS_DB_VALID(db));
+
+#ifdef DB_USEATOMIC
+	generation = (isc_uint32_t)isc_atomic_xadd((isc_int32_t *)
+						   &db->generation, 0);
+#else
+	LOCK(&genlock);
+	generation = db->generation;
+	UNLOCK(&genlock);
+#endif
+
+	return (generation);
+}
+
 void
 dns_db_overmem(dns_db_t *db, isc_boolean_t overmem) {
 
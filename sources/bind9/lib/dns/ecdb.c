@@ -113,7 +113,8 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	NULL,			/* setadditional */
 	NULL,			/* putadditional */
 	rdataset_settrust,	/* settrust */
-	NULL			/* expire */
+	NULL,			/* expire */
+	NULL			/* prefetch */
 };
 
 typedef struct ecdb_rdatasetiter {
@@ -583,7 +584,11 @@ static dns_dbmethods_t ecdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	NULL,			/* findnodeext */
-	NULL			/* findext */
+	NULL,			/* findext */
+	NULL,			/* serialize */
+	NULL,			/* deserialize */
+	NULL,			/* setservestalettl */
+	NULL			/* getservestalettl */
 };
 
 static isc_result_t
@@ -634,6 +639,7 @@ dns_ecdb_create(isc_mem_t *mctx, dns_name_t *origin, dns_dbtype_t type,
 	ecdb->common.mctx = NULL;
 	isc_mem_attach(mctx, &ecdb->common.mctx);
 	ecdb->common.impmagic = ECDB_MAGIC;
+	ecdb->common.generation = 0;
 	ecdb->common.magic = DNS_DB_MAGIC;
 
 	*dbp = (dns_db_t *)ecdb;
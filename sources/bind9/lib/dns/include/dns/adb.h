@@ -59,6 +59,11 @@
  *
  *\li	The ADB takes care of all necessary locking.
  *
+ *\li	Where the platform has atomic operations, copying a known name's
+ *	addresses into a find, freeing an address and the RTT and flag
+ *	updates do not lock the address's hash bucket; the smoothed RTT
+ *	and flags of an address are updated atomically instead.
+ *
  *\li	Only the task which initiated the name lookup can cancel the lookup.
  *
  *
@@ -263,6 +263,20 @@ dns_cache_getcachesize(dns_cache_t *cache);
  * Get the maximum cache size.
  */
 
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl);
+/*%<
+ * Set how long expired data is kept in the cache so that it can be
+ * served stale.  0, the default, means that expired data is removed.
+ * The setting survives dns_cache_flush().
+ */
+
+dns_ttl_t
+dns_cache_getservestalettl(dns_cache_t *cache);
+/*%<
+ * Get the time set with dns_cache_setservestalettl().
+ */
+
 isc_result_t
 dns_cache_flush(dns_cache_t *cache);
 /*%<
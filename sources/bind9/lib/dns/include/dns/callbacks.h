@@ -26,6 +26,8 @@
  ***	Imports
  ***/
 
+#include <stdio.h>
+
 #include <isc/lang.h>
 
 #include <dns/types.h>
@@ -36,6 +38,9 @@ ISC_LANG_BEGINDECLS
  ***	Types
  ***/
 
+typedef isc_result_t
+(*dns_deserializefunc_t)(void *, FILE *, off_t);
+
 struct dns_rdatacallbacks {
 	/*%
 	 * dns_load_master calls this when it has rdatasets to commit.
@@ -49,6 +54,13 @@ struct dns_rdatacallbacks {
 	dns_rawdatafunc_t rawdata;
 	dns_zone_t *zone;
 
+	/*%
+	 * dns_master_load*() call this when loading a map zonefile,
+	 * to have the database take over the image that follows the
+	 * file header.
+	 */
+	dns_deserializefunc_t deserialize;
+
 	/*%
 	 * dns_load_master / dns_rdata_fromtext call this to issue a error.
 	 */
@@ -57,10 +69,15 @@ struct dns_rdatacallbacks {
 	 * dns_load_master / dns_rdata_fromtext call this to issue a warning.
 	 */
 	void	(*warn)(struct dns_rdatacallbacks *, const char *, ...);
+	/*%
+	 * dns_master_load*() add the number of records they commit here.
+	 */
+	isc_uint64_t	records;
 	/*%
 	 * Private data handles for use by the above callback functions.
 	 */
 	void	*add_private;
+	void	*deserialize_private;
 	void	*error_private;
 	void	*warn_private;
 };
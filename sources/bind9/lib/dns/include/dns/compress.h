@@ -36,29 +36,41 @@ ISC_LANG_BEGINDECLS
  *	Direct manipulation of the structures is strongly discouraged.
  */
 
+/*%
+ * The global compression table is an open addressing hash table of
+ * suffixes.  It starts out in the dns_compress_t itself, with room for
+ * DNS_COMPRESS_INITIALNODES suffixes, and is doubled in size from the
+ * memory context whenever it becomes half full.
+ */
 #define DNS_COMPRESS_TABLESIZE 64
-#define DNS_COMPRESS_INITIALNODES 16
+#define DNS_COMPRESS_INITIALNODES (DNS_COMPRESS_TABLESIZE / 2)
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
-	isc_region_t		r;
-	isc_uint16_t		offset;
-	isc_uint16_t		count;
-	isc_uint8_t		labels;
-	dns_compressnode_t	*next;
+	const unsigned char	*data;		/*%< Suffix, in wire format. */
+	isc_uint32_t		hash;		/*%< Hash of the suffix. */
+	isc_uint16_t		length;		/*%< Length of the suffix. */
+	isc_uint16_t		offset;		/*%< Offset in the message. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	/*%
+	 * Global compression table: slots hold an index into 'nodes'
+	 * plus one, or zero if empty.
+	 */
+	isc_uint16_t		*table;
+	unsigned int		tablesize;	/*%< Slots, a power of 2. */
+	/*% Nodes in the order they were added. */
+	dns_compressnode_t	*nodes;
 	isc_uint16_t		count;		/*%< Number of nodes. */
 	isc_mem_t		*mctx;		/*%< Memory context. */
+	/*% Preallocated table and nodes. */
+	isc_uint16_t		initialtable[DNS_COMPRESS_TABLESIZE];
+	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
 };
 
 typedef enum {
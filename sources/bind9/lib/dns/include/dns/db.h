@@ -194,6 +194,12 @@ typedef struct dns_dbmethods {
 				   dns_clientinfo_t *clientinfo,
 				   dns_rdataset_t *rdataset,
 				   dns_rdataset_t *sigrdataset);
+	isc_result_t	(*serialize)(dns_db_t *db, dns_dbversion_t *version,
+				     FILE *file);
+	isc_result_t	(*deserialize)(dns_db_t *db, FILE *file,
+				       off_t offset);
+	isc_result_t	(*setservestalettl)(dns_db_t *db, dns_ttl_t ttl);
+	isc_result_t	(*getservestalettl)(dns_db_t *db, dns_ttl_t *ttl);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -223,6 +229,7 @@ struct dns_db {
 	dns_name_t			origin;
 	isc_ondestroy_t			ondest;
 	isc_mem_t *			mctx;
+	isc_uint32_t			generation;
 };
 
 #define DNS_DBATTR_CACHE		0x01
@@ -241,6 +248,7 @@ struct dns_db {
 #define DNS_DBFIND_COVERINGNSEC		0x0040
 #define DNS_DBFIND_FORCENSEC3		0x0080
 #define DNS_DBFIND_ADDITIONALOK		0x0100
+#define DNS_DBFIND_STALEOK		0x0200
 /*@}*/
 
 /*@{*/
@@ -251,6 +259,7 @@ struct dns_db {
 #define DNS_DBADD_FORCE			0x02
 #define DNS_DBADD_EXACT			0x04
 #define DNS_DBADD_EXACTTTL		0x08
+#define DNS_DBADD_PREFETCH		0x10
 /*@}*/
 
 /*%
@@ -489,6 +498,28 @@ dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
  *	implementation used, syntax errors in the master file, etc.
  */
 
+isc_result_t
+dns_db_beginload2(dns_db_t *db, dns_rdatacallbacks_t *callbacks);
+/*%<
+ * Like dns_db_beginload(), but set up 'callbacks': 'add' and
+ * 'add_private' as dns_db_beginload() sets '*addp' and '*dbloadp', and
+ * 'deserialize' and 'deserialize_private' so that map files can be
+ * loaded if the database implementation supports them.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * \li	This is the first attempt to load 'db'.
+ *
+ * \li	'callbacks' is a valid dns_rdatacallbacks_t with no 'add' or
+ *	'add_private' set.
+ *
+ * Returns:
+ *
+ * \li	As for dns_db_beginload().
+ */
+
 isc_result_t
 dns_db_endload(dns_db_t *db, dns_dbload_t **dbloadp);
 /*%<
@@ -549,6 +580,33 @@ dns_db_load3(dns_db_t *db, const char *filename, dns_masterformat_t format,
  *	implementation used, syntax errors in the master file, etc.
  */
 
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file);
+/*%<
+ * Write version 'version' of 'db' to 'file', at its current position,
+ * as an image that dns_db_load*() can map back into memory when the
+ * file is loaded in the #dns_masterformat_map format.  If 'version' is
+ * NULL, the current version is written.
+ *
+ * The image is only good for the same build of the library on a machine
+ * of the same architecture.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid zone database.
+ *
+ * \li	'file' is open for writing, and can seek.
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED	the database implementation cannot write
+ *				images.
+ *
+ * \li	Other results are possible, depending upon the database
+ *	implementation used and I/O errors.
+ */
+
 isc_result_t
 dns_db_dump(dns_db_t *db, dns_dbversion_t *version, const char *filename);
 
@@ -768,12 +826,21 @@ dns_db_findext(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
  *	NSEC record that potentially covers 'name' if a answer cannot
  *	be found.  Note the returned NSEC needs to be checked to ensure
  *	that it is correct.  This only affects answers returned from the
- *	cache.
+ *	cache.  If 'type' is NSEC3, an NSEC3 record at a hashed name one
+ *	label below the parent of 'name' is looked for instead, so 'name'
+ *	should be the hashed name to be covered.
  *
  * \li	In the #DNS_DBFIND_FORCENSEC3 option is set, then we are looking
  *	in the NSEC3 tree and not the main tree.  Without this option being
  *	set NSEC3 records will not be found.
  *
+ * \li	If the #DNS_DBFIND_STALEOK option is set, then a cache database
+ *	that keeps expired data (see dns_db_setservestalettl()) may return
+ *	an rdataset that expired before 'now' but is still within the
+ *	serve-stale window.  Such an rdataset has a TTL of zero and the
+ *	#DNS_RDATASETATTR_STALE attribute.  The option only applies to the
+ *	data at 'name' itself.
+ *
  * \li	To respond to a query for SIG records, the caller should create a
  *	rdataset iterator and extract the signatures from each rdataset.
  *
@@ -896,7 +963,8 @@ dns_db_findext(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
  *						no data at the name.
  *
  *	\li	#DNS_R_COVERINGNSEC		The returned data is a NSEC
- *						that potentially covers 'name'.
+ *						(or NSEC3) that potentially
+ *						covers 'name'.
  *
  *	\li	#DNS_R_EMPTYWILD		The name is a wildcard without
  *						resource records.
@@ -1193,6 +1261,10 @@ dns_db_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
  *	If #DNS_DBADD_EXACT is set then there must be no rdata in common between
  *	the old and new rdata sets.  If #DNS_DBADD_EXACTTTL is set then both
  *	the old and new rdata sets must have the same ttl.
+ *	If #DNS_DBADD_PREFETCH is set then an A, AAAA or DS rdataset in a
+ *	cache database replaces an existing one with the same data, rather
+ *	than only lowering its TTL, so that a refreshed answer gets a new
+ *	TTL.
  *
  * \li	The 'now' field is ignored if 'db' is a zone database.  If 'db' is
  *	a cache database, then the added rdataset will expire no later than
@@ -1322,6 +1394,52 @@ dns_db_getsoaserial(dns_db_t *db, dns_dbversion_t *ver, isc_uint32_t *serialp);
  * \li	'ver' is a valid version.
  */
 
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl);
+/*%<
+ * Set how long a cache database keeps data after it has expired so that
+ * it can still be served stale.  Zero, the default, means that expired
+ * data is not kept.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_getservestalettl(dns_db_t *db, dns_ttl_t *ttl);
+/*%<
+ * Get the time set with dns_db_setservestalettl().
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'ttl' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_uint32_t
+dns_db_getgeneration(dns_db_t *db);
+/*%<
+ * Get the generation of a zone database: a number that no other
+ * database has had and that changes whenever a new version of 'db' is
+ * committed.  A response made from the current version of 'db' stays
+ * correct for as long as the generation does not change.
+ *
+ * Only databases of the built in "rbt" and "rbt64" types created with
+ * dns_db_create() have a generation; for others zero is returned.
+ *
+ * Get the generation before opening the version that it is to describe.
+ *
+ * Requires:
+ * \li	'db' is a valid database.
+ */
+
 void
 dns_db_overmem(dns_db_t *db, isc_boolean_t overmem);
 /*%<
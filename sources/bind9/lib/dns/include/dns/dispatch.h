@@ -134,6 +134,11 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	A new socket is always created and bound with SO_REUSEPORT, so
+ *	that several dispatchers can listen on the same address and port
+ *	each with its own kernel receive queue.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -145,6 +150,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
@@ -273,7 +279,10 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 		    dns_dispatch_t **dispp, dns_dispatch_t *dup);
 /*%<
  * Attach to existing dns_dispatch_t if one is found with dns_dispatchmgr_find,
- * otherwise create a new UDP dispatch.
+ * otherwise create a new UDP dispatch.  If 'dup' is not NULL the new
+ * dispatch shares a dup()ed socket with it; if 'attributes' includes
+ * #DNS_DISPATCHATTR_REUSEPORT a new dispatch with its own SO_REUSEPORT
+ * socket is always created.
  *
  * Requires:
  *\li	All pointer parameters be valid for their respective types.
@@ -293,6 +302,9 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
  * Returns:
  *\li	ISC_R_SUCCESS	-- success.
  *
+ *\li	ISC_R_NOTIMPLEMENTED	-- SO_REUSEPORT was requested but is not
+ *				   supported.
+ *
  *\li	Anything else	-- failure.
  */
 
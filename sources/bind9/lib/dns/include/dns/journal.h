@@ -108,12 +108,18 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * A journal opened for writing also maintains a dense serial index in
+ * a companion file (the journal name with ".jnl" replaced by ".jix"),
+ * creating or rebuilding it as needed.  The dense index is only a hint;
+ * if it is missing or stale, lookups fall back to scanning the journal.
  */
 
 void
 dns_journal_destroy(dns_journal_t **journalp);
 /*%<
  * Destroy a dns_journal_t, closing any open files and freeing its memory.
+ * Any transactions committed in group commit mode are synced first.
  */
 
 /**************************************************************************/
@@ -157,6 +163,32 @@ dns_journal_commit(dns_journal_t *j);
  *      sequence.
  */
 
+void
+dns_journal_setgroupcommit(dns_journal_t *j, isc_boolean_t group);
+/*%<
+ * Enable or disable group commit mode on journal 'j'.
+ *
+ * In group commit mode, dns_journal_commit() appends the transaction
+ * but defers updating the journal header and flushing the journal to
+ * stable storage.  Transactions committed this way are not durable, and
+ * are not visible to other readers of the journal file, until
+ * dns_journal_sync() is called or the journal is destroyed.  This lets
+ * callers that commit a batch of transactions pay for one sync.
+ *
+ * Requires:
+ *\li      'j' is open for writing.
+ */
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Make all transactions committed to 'j' durable, writing the journal
+ * header and flushing the journal to stable storage if any are pending.
+ *
+ * Requires:
+ *\li      'j' is a valid journal with no transaction in progress.
+ */
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
 /*%
@@ -69,6 +69,13 @@ ISC_LANG_BEGINDECLS
  */
 #define DNS_RAWFORMAT_VERSION 1
 
+/*
+ * A "map" file starts with the header of a version 1 raw file, with
+ * 'format' set to dns_masterformat_map.  The header is followed by an
+ * image of the database written by dns_db_serialize().
+ */
+#define DNS_MAPFORMAT_VERSION 1
+
 /*
  * Flags to indicate the status of the data in the raw file header
  */
@@ -79,7 +86,8 @@ ISC_LANG_BEGINDECLS
 /* Common header */
 struct dns_masterrawheader {
 	isc_uint32_t		format;		/* must be
-						 * dns_masterformat_raw */
+						 * dns_masterformat_raw
+						 * or dns_masterformat_map */
 	isc_uint32_t		version;	/* compatibility for future
 						 * extensions */
 	isc_uint32_t		dumptime;	/* timestamp on creation
@@ -138,6 +146,18 @@ dns_master_loadfile3(const char *master_file,
 		     isc_mem_t *mctx,
 		     dns_masterformat_t format);
 
+isc_result_t
+dns_master_loadfile4(const char *master_file,
+		     dns_name_t *top,
+		     dns_name_t *origin,
+		     dns_rdataclass_t zclass,
+		     unsigned int options,
+		     isc_uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks,
+		     isc_mem_t *mctx,
+		     dns_masterformat_t format,
+		     unsigned int threads);
+
 isc_result_t
 dns_master_loadstream(FILE *stream,
 		      dns_name_t *top,
@@ -201,6 +221,20 @@ dns_master_loadfileinc3(const char *master_file,
 			dns_loadctx_t **ctxp, isc_mem_t *mctx,
 			dns_masterformat_t format);
 
+isc_result_t
+dns_master_loadfileinc4(const char *master_file,
+			dns_name_t *top,
+			dns_name_t *origin,
+			dns_rdataclass_t zclass,
+			unsigned int options,
+			isc_uint32_t resign,
+			dns_rdatacallbacks_t *callbacks,
+			isc_task_t *task,
+			dns_loaddonefunc_t done, void *done_arg,
+			dns_loadctx_t **ctxp, isc_mem_t *mctx,
+			dns_masterformat_t format,
+			unsigned int threads);
+
 isc_result_t
 dns_master_loadstreaminc(FILE *stream,
 			 dns_name_t *top,
@@ -254,6 +288,15 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  * 'resign' the number of seconds before a RRSIG expires that it should
  * be re-signed.  0 is used if not provided.
  *
+ * 'threads' is the number of threads that may parse a text file.  If it
+ * is greater than one and the file is large and uses no directives
+ * other than $ORIGIN and $TTL, the file is cut into chunks at owner
+ * names and the chunks are parsed concurrently; the rdatasets are still
+ * committed in file order by the calling thread (or task).  1 is used
+ * if not provided.
+ *
+ * The number of records committed is added to 'callbacks->records'.
+ *
  * Requires:
  *\li	'master_file' points to a valid string.
  *\li	'lexer' points to a valid lexer.
@@ -266,6 +309,7 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  *\li	'task' and 'done' to be valid.
  *\li	'lmgr' to be valid.
  *\li	'ctxp != NULL && ctxp == NULL'.
+ *\li	'threads > 0'.
  *
  * Returns:
  *\li	ISC_R_SUCCESS upon successfully loading the master file.
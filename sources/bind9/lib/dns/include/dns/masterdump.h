@@ -37,6 +37,21 @@
  ***/
 
 typedef struct dns_master_style dns_master_style_t;
+typedef struct dns_dumpsink dns_dumpsink_t;
+
+typedef isc_result_t
+(*dns_dumpwritefunc_t)(void *arg, const unsigned char *base,
+		       unsigned int length);
+
+/*%
+ * Where dumped output goes: 'write' is called with 'arg' for each piece
+ * of output, in order, and returns ISC_R_SUCCESS or an error which
+ * aborts the dump.
+ */
+struct dns_dumpsink {
+	dns_dumpwritefunc_t	write;
+	void			*arg;
+};
 
 /***
  *** Definitions
@@ -261,6 +276,45 @@ dns_master_dumptostream3(isc_mem_t *mctx, dns_db_t *db,
  */
 /*@}*/
 
+void
+dns_dumpsink_initstream(dns_dumpsink_t *sink, FILE *f);
+
+void
+dns_dumpsink_initbuffer(dns_dumpsink_t *sink, isc_buffer_t *target);
+/*%<
+ * Initialize 'sink' to write to the stream 'f', or to append to
+ * 'target'.  A buffer sink fails with ISC_R_NOSPACE when 'target'
+ * is full.
+ *
+ * Require:
+ *\li	'sink' to be non NULL.
+ *\li	'f' to be a valid stream, or 'target' to be a valid buffer.
+ */
+
+isc_result_t
+dns_master_dumptosink(isc_mem_t *mctx, dns_db_t *db,
+		      dns_dbversion_t *version,
+		      const dns_master_style_t *style,
+		      dns_masterformat_t format,
+		      dns_masterrawheader_t *header, unsigned int threads,
+		      dns_dumpsink_t *sink);
+/*%<
+ * Like dns_master_dumptostream3(), but the output is passed to 'sink'.
+ * The map format can only be dumped to a stream.
+ *
+ * See dns_master_dump4() for 'threads'.
+ *
+ * Require:
+ *\li	'sink' to be non NULL, with a write function.
+ *\li	'threads' to be greater than zero.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTIMPLEMENTED	'format' is dns_masterformat_map.
+ *\li	Any error returned by the sink.
+ *\li	The errors of dns_master_dumptostream3().
+ */
+
 /*@{*/
 isc_result_t
 dns_master_dumpinc(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
@@ -280,6 +334,14 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		    *done_arg, dns_dumpctx_t **dctxp,
 		    dns_masterformat_t format, dns_masterrawheader_t *header);
 
+isc_result_t
+dns_master_dumpinc4(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
+		    const dns_master_style_t *style, const char *filename,
+		    isc_task_t *task, dns_dumpdonefunc_t done, void
+		    *done_arg, dns_dumpctx_t **dctxp,
+		    dns_masterformat_t format, dns_masterrawheader_t *header,
+		    unsigned int threads);
+
 isc_result_t
 dns_master_dump(isc_mem_t *mctx, dns_db_t *db,
 		dns_dbversion_t *version,
@@ -297,6 +359,13 @@ dns_master_dump3(isc_mem_t *mctx, dns_db_t *db,
 		 const dns_master_style_t *style, const char *filename,
 		 dns_masterformat_t format, dns_masterrawheader_t *header);
 
+isc_result_t
+dns_master_dump4(isc_mem_t *mctx, dns_db_t *db,
+		 dns_dbversion_t *version,
+		 const dns_master_style_t *style, const char *filename,
+		 dns_masterformat_t format, dns_masterrawheader_t *header,
+		 unsigned int threads);
+
 /*%<
  * Dump the database 'db' to the file 'filename' in the specified format by
  * 'format'.  If the format is dns_masterformat_text (the RFC1035 format),
@@ -305,13 +374,22 @@ dns_master_dump3(isc_mem_t *mctx, dns_db_t *db,
  * dns_master_dumpinc() and dns_master_dump() are old forms of _dumpinc3()
  * and _dump3(), respectively, which always specify the dns_masterformat_text
  * format.  dns_master_dumpinc2() and dns_master_dump2() are old forms which
- * always specify a NULL header.
+ * always specify a NULL header.  dns_master_dumpinc3() and
+ * dns_master_dump3() always use one thread.
  *
  * If 'format' is dns_masterformat_raw, then 'header' can contain
  * information to be written to the file header.
  *
+ * If 'threads' is greater than one, a large zone database in the text
+ * or raw format is formatted by up to 'threads' threads, each working
+ * on a range of names; the output is the same as with one thread.
+ * Caches are always dumped by one thread.
+ *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
+ * Require:
+ *\li	'threads' to be greater than zero.
+ *
  * Returns:
  *\li	ISC_R_SUCCESS
  *\li	ISC_R_CONTINUE	dns_master_dumpinc() only.
@@ -169,6 +169,8 @@ typedef int dns_messagetextflag_t;
 						   source buffer */
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION 0x0008 /*%< truncation errors are
 						  * not fatal. */
+#define DNS_MESSAGEPARSE_LAZY		0x0010	/*%< parse the records of a
+						   query on demand */
 
 /*
  * Control behavior of rendering
@@ -215,6 +217,7 @@ struct dns_message {
 	unsigned int			verify_attempted : 1;
 	unsigned int			free_query : 1;
 	unsigned int			free_saved : 1;
+	unsigned int			arena : 1;
 
 	unsigned int			opt_reserved;
 	unsigned int			sig_reserved;
@@ -237,6 +240,13 @@ struct dns_message {
 	ISC_LIST(dns_rdata_t)		freerdata;
 	ISC_LIST(dns_rdatalist_t)	freerdatalist;
 
+	ISC_LIST(dns_msgblock_t)	names;		/* arena only */
+	ISC_LIST(dns_msgblock_t)	rdatasets;	/* arena only */
+	ISC_LIST(dns_name_t)		freename;
+	ISC_LIST(dns_rdataset_t)	freerdataset;
+	unsigned int			arenainuse;
+	unsigned int			arenasaved;
+
 	dns_rcode_t			tsigstatus;
 	dns_rcode_t			querytsigstatus;
 	dns_name_t		       *tsigname; /* Owner name of TSIG, if any */
@@ -254,6 +264,11 @@ struct dns_message {
 
 	dns_rdatasetorderfunc_t		order;
 	const void *			order_arg;
+
+	unsigned int			lazy;	/* sections not yet parsed */
+	unsigned int			lazyoptions;
+	unsigned int			lazystart[DNS_SECTION_MAX];
+	isc_result_t			lazyresult;
 };
 
 struct dns_ednsopt {
@@ -327,6 +342,33 @@ dns_message_destroy(dns_message_t **msgp);
  *\li	'*msgp' == NULL
  */
 
+void
+dns_message_setarena(dns_message_t *msg, isc_boolean_t arena);
+/*%<
+ * Turn arena allocation on or off for 'msg'.  In arena mode the names
+ * and rdatasets of the message, including those obtained with
+ * dns_message_gettempname() and dns_message_gettemprdataset(), are
+ * carved out of blocks owned by the message rather than taken from its
+ * memory pools.  The blocks are reclaimed as a whole, and the first
+ * one of each kind kept, by dns_message_reset(); this suits a message
+ * that is reset and reused for one query after another.
+ *
+ * Requires:
+ *
+ *\li	'msg' be valid, with no names or rdatasets in use.
+ */
+
+unsigned int
+dns_message_arenasaved(dns_message_t *msg);
+/*%<
+ * Return the number of names and rdatasets handed out from the arena
+ * of 'msg' since it was last reset without allocating memory.
+ *
+ * Requires:
+ *
+ *\li	'msg' be valid.
+ */
+
 isc_result_t
 dns_message_sectiontotext(dns_message_t *msg, dns_section_t section,
 			  const dns_master_style_t *style,
@@ -439,6 +481,19 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_LAZY is set and the message is a query with a
+ * question, only the header, the question section and any OPT, TSIG and
+ * SIG(0) records are parsed; the other records are only checked to be
+ * complete.  They are parsed when one of their sections is first looked at
+ * with dns_message_firstname(), dns_message_findname() or
+ * dns_message_sectiontotext(), which then return any error found, and
+ * never if the message is turned into a reply first.  Names in the
+ * question section refer to 'source' where possible.  Unless
+ * #DNS_MESSAGEPARSE_CLONEBUFFER is also set, 'source' must not be
+ * changed or freed until 'msg' has been reset or destroyed.
+ * #DNS_MESSAGEPARSE_LAZY is ignored if #DNS_MESSAGEPARSE_IGNORETRUNCATION
+ * is set.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -638,6 +693,8 @@ dns_message_firstname(dns_message_t *msg, dns_section_t section);
  * Returns:
  *\li	#ISC_R_SUCCESS		-- All is well.
  *\li	#ISC_R_NOMORE		-- No names on given section.
+ *\li	Any error found parsing the records of a message that was parsed
+ *	with #DNS_MESSAGEPARSE_LAZY.
  */
 
 isc_result_t
@@ -717,6 +774,8 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
  *\li	#DNS_R_NXDOMAIN		-- name does not exist in that section.
  *\li	#DNS_R_NXRRSET		-- The name does exist, but the desired
  *				   type does not.
+ *\li	Any error found parsing the records of a message that was parsed
+ *	with #DNS_MESSAGEPARSE_LAZY.
  */
 
 isc_result_t
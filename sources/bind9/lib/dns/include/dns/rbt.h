@@ -22,6 +22,8 @@
 
 /*! \file dns/rbt.h */
 
+#include <stdio.h>
+
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/refcount.h>
@@ -32,6 +34,16 @@ ISC_LANG_BEGINDECLS
 
 #define DNS_RBT_USEHASH 1
 
+/*%
+ * Counters of the exact match index; see dns_rbt_setindex().
+ */
+enum {
+	dns_rbtindexstats_hit = 0,
+	dns_rbtindexstats_miss = 1,
+
+	dns_rbtindexstats_max = 2
+};
+
 /*@{*/
 /*%
  * Option values for dns_rbt_findnode() and dns_rbt_findname().
@@ -55,6 +67,8 @@ ISC_LANG_BEGINDECLS
 #define DNS_RBT_LOCKLENGTH                      10
 #define DNS_RBT_REFLENGTH                       20
 
+#define DNS_RBT_TAGLENGTH                       8
+
 #define DNS_RBTNODE_MAGIC               ISC_MAGIC('R','B','N','O')
 #if DNS_RBT_USEMAGIC
 #define DNS_RBTNODE_VALID(n)            ISC_MAGIC_VALID(n, DNS_RBTNODE_MAGIC)
@@ -117,6 +131,10 @@ struct dns_rbtnode {
 
 	/* node needs to be cleaned from rpz */
 	unsigned int rpz : 1;
+	/* copied from the tree's tag when the node is created */
+	unsigned int tag : DNS_RBT_TAGLENGTH;
+	/* node lives in a mapped image; see dns_rbt_deserialize() */
+	unsigned int is_mmapped : 1;
 
 #ifdef DNS_RBT_USEHASH
 	unsigned int hashval;
@@ -143,6 +161,23 @@ typedef isc_result_t (*dns_rbtfindcallback_t)(dns_rbtnode_t *node,
 					      dns_name_t *name,
 					      void *callback_arg);
 
+/*%
+ * Write the data of a node for dns_rbt_serialize().  The data must be
+ * written to 'file' at image offset '*offsetp', which is a multiple of
+ * 8, and '*offsetp' advanced by the number of bytes written.  Pointers
+ * inside the data must be written as image offsets.
+ */
+typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file, void *data,
+					    void *writer_arg, off_t *offsetp);
+
+/*%
+ * Fix the data of a node loaded by dns_rbt_deserialize().  On entry
+ * 'node' and DATA(node) are valid pointers into the image at 'base' of
+ * 'size' bytes; pointers inside the data are still image offsets.
+ */
+typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *node, void *base,
+					   size_t size, void *fixer_arg);
+
 /*****
  *****  Chain Info
  *****/
@@ -635,6 +670,119 @@ dns_rbt_nodecount(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+void
+dns_rbt_settag(dns_rbt_t *rbt, unsigned int tag);
+/*%<
+ * Set the value stored in the 'tag' field of every node subsequently
+ * created in 'rbt', including the nodes made when an existing node is
+ * split.  The tree itself does not use it; the RBT database uses it to
+ * tell which shard of a sharded cache a node belongs to.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ *\li   tag < (1 << DNS_RBT_TAGLENGTH)
+ */
+
+isc_result_t
+dns_rbt_setindex(dns_rbt_t *rbt, isc_boolean_t enable);
+/*%<
+ * Enable or disable the exact match index of 'rbt'.
+ *
+ * The index is an open addressing hash table from the full name of every
+ * node to the node.  While it is enabled, dns_rbt_findnode() and
+ * dns_rbt_findname() first look the whole name up in the index and only
+ * walk down the tree when that does not give an exact match: when the
+ * name is not in the tree, when #DNS_RBTFIND_NOEXACT is set, when the
+ * node has no data and #DNS_RBTFIND_EMPTYDATA is not set, or when a find
+ * callback has to be called for a node above it.
+ *
+ * The index costs two words per slot and is kept at most half full.  If
+ * it cannot be grown as nodes are added, it is disabled.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_NOTIMPLEMENTED	the tree is built without DNS_RBT_USEHASH.
+ */
+
+isc_stats_t *
+dns_rbt_getindexstats(dns_rbt_t *rbt);
+/*%<
+ * Get the counters of the exact match index of 'rbt', indexed by
+ * dns_rbtindexstats_hit (lookups answered by the index) and
+ * dns_rbtindexstats_miss (lookups that had to walk the tree).  The
+ * returned object is owned by 'rbt'; it is created the first time the
+ * index is enabled and kept while it is disabled.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ * Returns:
+ *\li	The counters, or NULL if the index has never been enabled.
+ */
+
+isc_result_t
+dns_rbt_serialize(dns_rbt_t *rbt, FILE *file, dns_rbtdatawriter_t datawriter,
+		  void *writer_arg, off_t *offsetp, off_t *rootp);
+/*%<
+ * Write the nodes of 'rbt' to 'file' as part of an image that
+ * dns_rbt_deserialize() can use in place.  '*offsetp' is the offset of
+ * the current position of 'file' from the start of the image; it is
+ * advanced past the nodes written.
+ *
+ * Every subtree is written before the node that points to it, and the
+ * data of a node, written by 'datawriter', comes just before the node.
+ * Child and data pointers are written as image offsets, which are
+ * therefore always smaller than the offset of the node holding them.
+ *
+ * Requires:
+ *\li	'rbt' is a valid rbt, which must not change during the call.
+ *\li	'datawriter' is not NULL.
+ *\li	offsetp != NULL && rootp != NULL
+ *
+ * Ensures:
+ *\li	On success, '*rootp' is the image offset of the top level root
+ *	node, or 0 if 'rbt' is empty.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	Any error from writing 'file' or from 'datawriter'.
+ */
+
+isc_result_t
+dns_rbt_deserialize(dns_rbt_t *rbt, void *base, size_t size, off_t root,
+		    dns_rbtdatafixer_t datafixer, void *fixer_arg);
+/*%<
+ * Make the nodes of an image written by dns_rbt_serialize(), and
+ * mapped at 'base' with a length of 'size' bytes, the nodes of 'rbt'.
+ * 'root' is the offset of the top level root node.
+ *
+ * The nodes are used where they are: their pointers are fixed, they
+ * are hashed, and 'datafixer' is called for each node with data.  The
+ * memory of these nodes is never freed by 'rbt', and must stay mapped
+ * until 'rbt' is destroyed.
+ *
+ * Offsets are checked to lie inside the image, and child offsets to be
+ * smaller than the offset of their parent, but the image is otherwise
+ * trusted.
+ *
+ * Requires:
+ *\li	'rbt' is a valid, empty rbt.
+ *\li	'base' is aligned for a dns_rbtnode_t.
+ *
+ * Ensures:
+ *\li	On failure, 'rbt' is empty.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_INVALIDFILE	the image is malformed.
+ *\li	Any error from 'datafixer'.
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
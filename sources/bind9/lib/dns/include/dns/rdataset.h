@@ -114,6 +114,8 @@ typedef struct dns_rdatasetmethods {
 	void			(*settrust)(dns_rdataset_t *rdataset,
 					    dns_trust_t trust);
 	void			(*expire)(dns_rdataset_t *rdataset);
+	isc_boolean_t		(*prefetch)(dns_rdataset_t *rdataset,
+					    unsigned int hits);
 } dns_rdatasetmethods_t;
 
 #define DNS_RDATASET_MAGIC	       ISC_MAGIC('D','N','S','R')
@@ -206,6 +208,7 @@ struct dns_rdataset {
 #define DNS_RDATASETATTR_CLOSEST	0x00080000
 #define DNS_RDATASETATTR_OPTOUT		0x00100000	/*%< OPTOUT proof */
 #define DNS_RDATASETATTR_NEGATIVE	0x00200000
+#define DNS_RDATASETATTR_STALE		0x00400000
 
 /*%
  * _OMITDNSSEC:
@@ -653,6 +656,22 @@ dns_rdataset_expire(dns_rdataset_t *rdataset);
  * Mark the rdataset to be expired in the backing database.
  */
 
+isc_boolean_t
+dns_rdataset_prefetch(dns_rdataset_t *rdataset, unsigned int hits);
+/*%<
+ * Decide whether the caller should refresh 'rdataset' before it expires.
+ * This is so if the rdataset comes from a cache database, has been
+ * looked up at least 'hits' times and no earlier caller has been told
+ * to refresh it.  The backing database remembers the decision until
+ * the rdataset is replaced.
+ *
+ * Requires:
+ *\li	'rdataset' is a valid, associated rdataset.
+ *
+ * Returns:
+ *\li	#ISC_TRUE if the caller should start a refresh.
+ */
+
 void
 dns_rdataset_trimttl(dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
 		     dns_rdata_rrsig_t *rrsig, isc_stdtime_t now,
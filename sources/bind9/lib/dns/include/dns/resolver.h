@@ -96,6 +96,8 @@ typedef struct dns_fetchevent {
 #define DNS_FETCHOPT_EDNS512		0x40	     /*%< Advertise a 512 byte
 							  UDP buffer. */
 #define DNS_FETCHOPT_WANTNSID           0x80         /*%< Request NSID */
+#define DNS_FETCHOPT_PREFETCH		0x100	     /*%< Refresh a cached
+							  answer. */
 
 /* Reserved in use by adb.c		0x00400000 */
 #define	DNS_FETCHOPT_EDNSVERSIONSET	0x00800000
@@ -612,6 +614,33 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver);
  * \li	resolver to be valid.
  */
 
+isc_result_t
+dns_resolver_setverifytasks(dns_resolver_t *resolver, unsigned int ntasks);
+/*%<
+ * Create a pool of 'ntasks' tasks on which validators started for this
+ * resolver verify signatures, instead of on the task of the fetch they
+ * were started for.  A value of zero removes the pool.
+ *
+ * Requires:
+ * \li	resolver to be valid and not frozen.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	Any error from isc_taskpool_create().
+ */
+
+void
+dns_resolver_getverifytask(dns_resolver_t *resolver, isc_task_t **taskp);
+/*%<
+ * Attach '*taskp' to a task of the pool created by
+ * dns_resolver_setverifytasks().  '*taskp' is left NULL if there is no
+ * such pool.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ * \li	'taskp' to be non NULL and '*taskp' to be NULL.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* DNS_RESOLVER_H */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * A cache of rendered responses.
+ *
+ * Each response is stored under the question it answers and the
+ * properties of the query that changed how it was made, and is tagged
+ * with the generation (see dns_db_getgeneration()) of the database it
+ * was made from.  A response is only returned while the generation
+ * asked for is the one it was stored with; once the database changes,
+ * the next lookup drops it.
+ *
+ * The cache is split into shards, each with its own lock, hash table
+ * and least recently used list, and each allowed an equal part of the
+ * size of the cache.
+ *
+ * MP:
+ *\li	The module is thread safe.
+ */
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+/*%
+ * What a response is stored under.  'name' is compared exactly, case
+ * included, because the question is returned as it was asked.  The
+ * meaning of 'flags' is up to the caller; 'size' is the largest
+ * response the client would take.
+ */
+typedef struct dns_respkey {
+	dns_name_t *		name;
+	dns_rdatatype_t		type;
+	dns_rdataclass_t	rdclass;
+	unsigned int		flags;
+	unsigned int		size;
+} dns_respkey_t;
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t size, dns_respcache_t **cachep);
+/*%<
+ * Create a response cache which holds at most 'size' octets of
+ * responses and their keys.
+ *
+ * Requires:
+ *\li	'mctx' to be valid.
+ *\li	'size' to be non zero.
+ *\li	'cachep' to be non NULL and '*cachep == NULL'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp);
+/*%<
+ * Attach to the 'source' cache.
+ *
+ * Requires:
+ *\li	'source' to be valid.
+ *\li	'targetp' to be non NULL and '*targetp == NULL'.
+ */
+
+void
+dns_respcache_detach(dns_respcache_t **cachep);
+/*%<
+ * Detach from the cache, freeing it and all of its responses if this
+ * was the last reference.
+ *
+ * Requires:
+ *\li	'*cachep' to be valid.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_respkey_t *key,
+		   isc_uint32_t generation, isc_buffer_t *target);
+/*%<
+ * Look for a response to 'key' made from database generation
+ * 'generation' and append it to 'target'.  A response to 'key' made
+ * from another generation is removed.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'key->name' to be a valid absolute name.
+ *\li	'target' to be a valid buffer.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ *\li	#ISC_R_NOSPACE		-- the response does not fit in 'target'.
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, const dns_respkey_t *key,
+		  isc_uint32_t generation, isc_region_t *response);
+/*%<
+ * Store a copy of 'response' under 'key', replacing any response
+ * already stored under it.  The least recently used responses of the
+ * shard are removed to make room.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'key->name' to be a valid absolute name.
+ *\li	'response' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_NOSPACE		-- 'response' is too large to be cached.
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *cache);
+/*%<
+ * Remove all responses from the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+unsigned int
+dns_respcache_count(dns_respcache_t *cache);
+/*%<
+ * Return the number of responses in the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_SIGCACHE_H
+#define DNS_SIGCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * A cache of the results of RRSIG verifications.
+ *
+ * A result is stored under a SHA-256 digest of everything the
+ * verification depended on: the owner name, type, class and sorted
+ * rdata of the RRset, the RRSIG and the DNSKEY that was tried.  The
+ * same RRset received again, from the same server or another one, is
+ * then found without doing the public key operation again.
+ *
+ * Each result is stored with the time it may be used until.  The
+ * cache holds a fixed number of results; when it is full the least
+ * recently used one is replaced.
+ *
+ * MP:
+ *\li	The module is thread safe.
+ */
+
+#include <isc/lang.h>
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+/*%
+ * What a verification result is stored under.
+ */
+typedef struct dns_sigcachekey {
+	unsigned char		digest[ISC_SHA256_DIGESTLENGTH];
+} dns_sigcachekey_t;
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, size_t size, dns_sigcache_t **cachep);
+/*%<
+ * Create a signature cache which holds as many results as fit in
+ * 'size' octets.
+ *
+ * Requires:
+ *\li	'mctx' to be valid.
+ *\li	'size' to be non zero.
+ *\li	'cachep' to be non NULL and '*cachep == NULL'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp);
+/*%<
+ * Attach to the 'source' cache.
+ *
+ * Requires:
+ *\li	'source' to be valid.
+ *\li	'targetp' to be non NULL and '*targetp == NULL'.
+ */
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep);
+/*%<
+ * Detach from the cache, freeing it if this was the last reference.
+ *
+ * Requires:
+ *\li	'*cachep' to be valid.
+ */
+
+isc_result_t
+dns_sigcache_makekey(dns_name_t *name, dns_rdataset_t *rdataset,
+		     dst_key_t *key, dns_rdata_t *sigrdata, isc_mem_t *mctx,
+		     dns_sigcachekey_t *cachekey);
+/*%<
+ * Compute the key for the verification of 'sigrdata', which covers
+ * 'rdataset' owned by 'name', with 'key'.  The case of 'name' does not
+ * matter and neither does the order of the rdata in 'rdataset'.
+ * 'mctx' is used for temporary memory.
+ *
+ * Requires:
+ *\li	'name' to be a valid absolute name.
+ *\li	'rdataset' to be a valid, associated rdataset.
+ *\li	'key', 'sigrdata' and 'cachekey' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	Other results from dst_key_todns().
+ */
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_sigcachekey_t *cachekey,
+		  isc_stdtime_t now, isc_result_t *resultp);
+/*%<
+ * Look for the result stored under 'cachekey' and set '*resultp' to
+ * it.  A result which could only be used until 'now' or earlier is
+ * removed instead.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'cachekey' and 'resultp' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const dns_sigcachekey_t *cachekey,
+		 isc_result_t result, isc_stdtime_t expire);
+/*%<
+ * Store 'result' under 'cachekey' until 'expire', replacing any result
+ * already stored under it.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'cachekey' to be non NULL.
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache);
+/*%<
+ * Remove all results from the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+unsigned int
+dns_sigcache_count(dns_sigcache_t *cache);
+/*%<
+ * Return the number of results in the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SIGCACHE_H */
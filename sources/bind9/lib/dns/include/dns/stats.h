@@ -61,8 +61,14 @@ enum {
 	dns_resstatscounter_queryrtt3 = 27,
 	dns_resstatscounter_queryrtt4 = 28,
 	dns_resstatscounter_queryrtt5 = 29,
+	dns_resstatscounter_staletimeout = 30,
+	dns_resstatscounter_stalefailure = 31,
+	dns_resstatscounter_synthnxdomain = 32,
+	dns_resstatscounter_synthnodata = 33,
+	dns_resstatscounter_valsigverify = 34,
+	dns_resstatscounter_valsigcachehit = 35,
 
-	dns_resstatscounter_max = 30,
+	dns_resstatscounter_max = 36,
 
 	/*
 	 * DNSSEC stats.
@@ -90,8 +96,10 @@ enum {
 	dns_zonestatscounter_ixfrreqv6 = 10,
 	dns_zonestatscounter_xfrsuccess = 11,
 	dns_zonestatscounter_xfrfail = 12,
+	dns_zonestatscounter_sigsgenerated = 13,
+	dns_zonestatscounter_signingmsec = 14,
 
-	dns_zonestatscounter_max = 13,
+	dns_zonestatscounter_max = 15,
 
 	/*%
 	* Query statistics counters (obsolete).
@@ -165,6 +165,7 @@ struct dns_validator {
 	unsigned int			depth;
 	unsigned int			authcount;
 	unsigned int			authfail;
+	isc_result_t			verifyresult;
 };
 
 /*%
@@ -93,6 +93,8 @@ struct dns_view {
 	dns_adb_t *			adb;
 	dns_requestmgr_t *		requestmgr;
 	dns_acache_t *			acache;
+	dns_respcache_t *		respcache;
+	dns_sigcache_t *		sigcache;
 	dns_cache_t *			cache;
 	dns_db_t *			cachedb;
 	dns_db_t *			hints;
@@ -149,6 +151,12 @@ struct dns_view {
 	isc_boolean_t			requestnsid;
 	dns_ttl_t			maxcachettl;
 	dns_ttl_t			maxncachettl;
+	dns_ttl_t			prefetch_trigger;
+	unsigned int			prefetch_hits;
+	isc_boolean_t			staleanswersok;
+	dns_ttl_t			staleanswerttl;
+	unsigned int			staleanswerclienttimeout;
+	isc_boolean_t			synthfromdnssec;
 	in_port_t			dstport;
 	dns_aclenv_t			aclenv;
 	dns_rdatatype_t			preferred_glue;
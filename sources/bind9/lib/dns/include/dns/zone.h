@@ -125,6 +125,10 @@ typedef enum {
 						   exponential backoff */
 #endif
 
+#ifndef DNS_ZONE_MAXSIGNINGTHREADS
+#define DNS_ZONE_MAXSIGNINGTHREADS	     64
+#endif
+
 #define DNS_ZONESTATE_XFERRUNNING	1
 #define DNS_ZONESTATE_XFERDEFERRED	2
 #define DNS_ZONESTATE_SOAQUERY		3
@@ -1082,6 +1086,72 @@ dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
  *\li	DNS_R_SUCCESS
  */
 
+void
+dns_zone_setloadthreads(dns_zone_t *zone, unsigned int threads);
+/*%<
+ * Set the number of threads that may be used to parse the zone's
+ * master file when it is loaded.  See dns_master_loadfile4().
+ *
+ * Requires:
+ * \li	'zone' to be valid initialised zone.
+ * \li	'threads' to be greater than zero.
+ */
+
+unsigned int
+dns_zone_getloadthreads(dns_zone_t *zone);
+/*%<
+ * Returns the number of threads used to parse the zone's master file.
+ * The default is 1.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_setdumpthreads(dns_zone_t *zone, unsigned int threads);
+/*%<
+ * Set the number of threads that may be used to format the zone's
+ * contents when its master file is written.  See dns_master_dump4().
+ *
+ * Requires:
+ * \li	'zone' to be valid initialised zone.
+ * \li	'threads' to be greater than zero.
+ */
+
+unsigned int
+dns_zone_getdumpthreads(dns_zone_t *zone);
+/*%<
+ * Returns the number of threads used to write the zone's master file.
+ * The default is 1.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, unsigned int threads);
+/*%<
+ * Set the number of the zone manager's signing tasks that may be used
+ * to make the signatures of each quantum of incremental signing; with
+ * 1 they are made on the zone's own task.  The signatures are added
+ * to the zone in the order the zone's task would have made them.
+ * 'threads' is limited to DNS_ZONE_MAXSIGNINGTHREADS.
+ *
+ * Requires:
+ * \li	'zone' to be valid initialised zone.
+ * \li	'threads' to be greater than zero.
+ */
+
+unsigned int
+dns_zone_getsigningthreads(dns_zone_t *zone);
+/*%<
+ * Returns the number of tasks used to make signatures when signing
+ * the zone.  The default is 1.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 void
 dns_zone_setmaxxfrin(dns_zone_t *zone, isc_uint32_t maxxfrin);
 /*%<
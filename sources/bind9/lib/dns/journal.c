@@ -77,6 +77,16 @@
  *     appended to the journal but never committed by updating
  *     the "end" position in the header.  The latter will
  *     be overwritten when new transactions are added.
+ *
+ * Next to the journal file there may be a dense index file, named
+ * like the journal with ".jix" in place of ".jnl".  It consists of a
+ * 16-byte format string followed by a journal_rawpos_t for every
+ * committed transaction, in file order.  Unlike the index in the
+ * journal it is never decimated, so a transaction can be located
+ * with a binary search instead of a scan.  It is only used as a
+ * hint: entries are checked against the journal before they are
+ * used, and a writer that finds the file out of step with the
+ * journal brings it up to date.
  */
 /*%
  * When true, accept IXFR difference sequences where the
@@ -114,6 +124,8 @@ static isc_boolean_t bind8_compat = ISC_TRUE; /* XXX config */
 #define JOURNAL_SERIALSET	0x01U
 
 static isc_result_t index_to_disk(dns_journal_t *);
+static void dense_open(dns_journal_t *);
+static void dense_close(dns_journal_t *);
 
 static inline isc_uint32_t
 decode_uint32(unsigned char *p) {
@@ -295,6 +307,12 @@ initial_journal_header = { ";BIND LOG V9\n", { 0, 0 }, { 0, 0 }, 0, 0, 0 };
 
 #define JOURNAL_EMPTY(h) ((h)->begin.offset == (h)->end.offset)
 
+/*%
+ * Format string at the start of a dense index file.
+ */
+static const unsigned char
+dense_format[16] = ";BIND JIX V9\n";
+
 typedef enum {
 	JOURNAL_STATE_INVALID,
 	JOURNAL_STATE_READ,
@@ -313,6 +331,23 @@ struct dns_journal {
 	journal_header_t 	header;		/*%< In-core journal header */
 	unsigned char		*rawindex;	/*%< In-core buffer for journal index in on-disk format */
 	journal_pos_t		*index;		/*%< In-core journal index */
+	unsigned char		*map;		/*%< Mapped journal (reading) */
+	size_t			maplen;		/*%< Length of the mapping */
+	isc_boolean_t		group;		/*%< Group commit */
+	isc_boolean_t		dirty;		/*%< Header not yet on disk */
+
+	/*% Dense index state. */
+	struct {
+		char		*filename;	/*%< Dense index file name */
+		FILE		*fp;		/*%< Open for appending */
+		unsigned char	*map;		/*%< Mapped file (reading) */
+		size_t		maplen;		/*%< Length of the mapping */
+		unsigned int	count;		/*%< Entries in the mapping */
+		isc_boolean_t	mapped;		/*%< Mapping was attempted */
+		journal_pos_t	*pending;	/*%< Entries not yet written */
+		unsigned int	npending;
+		unsigned int	maxpending;
+	} dense;
 
 	/*% Current transaction state (when writing). */
 	struct {
@@ -387,6 +422,18 @@ journal_header_encode(journal_header_t *cooked, journal_rawheader_t *raw) {
 static isc_result_t
 journal_seek(dns_journal_t *j, isc_uint32_t offset) {
 	isc_result_t result;
+
+	if (j->map != NULL) {
+		if (offset > j->maplen) {
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: seek: offset %u beyond end",
+				      j->filename, offset);
+			return (ISC_R_UNEXPECTED);
+		}
+		j->offset = offset;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_seek(j->fp, (long)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
@@ -402,6 +449,14 @@ static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		if (nbytes > j->maplen - (size_t)j->offset)
+			return (ISC_R_NOMORE);
+		memmove(mem, j->map + j->offset, nbytes);
+		j->offset += (isc_offset_t)nbytes;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF)
@@ -575,6 +630,11 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	j->filename = isc_mem_strdup(mctx, filename);
 	j->index = NULL;
 	j->rawindex = NULL;
+	j->map = NULL;
+	j->maplen = 0;
+	j->group = ISC_FALSE;
+	j->dirty = ISC_FALSE;
+	memset(&j->dense, 0, sizeof(j->dense));
 
 	if (j->filename == NULL)
 		FAIL(ISC_R_NOMEMORY);
@@ -668,6 +728,13 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	isc_buffer_init(&j->it.target, NULL, 0);
 	dns_decompress_init(&j->it.dctx, -1, DNS_DECOMPRESS_NONE);
 
+	/*
+	 * Writers keep the dense index up to date; readers map it
+	 * when they first need it.
+	 */
+	if (write)
+		dense_open(j);
+
 	j->state =
 		write ? JOURNAL_STATE_WRITE : JOURNAL_STATE_READ;
 
@@ -676,6 +743,7 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 
  failure:
 	j->magic = 0;
+	dense_close(j);
 	if (j->index != NULL) {
 		isc_mem_put(j->mctx, j->index, j->header.index_size *
 			    sizeof(journal_rawpos_t));
@@ -917,6 +985,301 @@ index_invalidate(dns_journal_t *j, isc_uint32_t serial) {
 	}
 }
 
+/*
+ * Dense index support.  Failures here are never fatal: without the
+ * dense index, transactions are found as before.
+ */
+
+static void
+dense_close(dns_journal_t *j) {
+	if (j->dense.fp != NULL)
+		(void)isc_stdio_close(j->dense.fp);
+	j->dense.fp = NULL;
+	if (j->dense.map != NULL)
+		(void)isc_file_munmap(j->dense.map, j->dense.maplen);
+	j->dense.map = NULL;
+	j->dense.count = 0;
+	if (j->dense.pending != NULL)
+		isc_mem_put(j->mctx, j->dense.pending,
+			    j->dense.maxpending * sizeof(journal_pos_t));
+	j->dense.pending = NULL;
+	j->dense.npending = 0;
+	j->dense.maxpending = 0;
+	if (j->dense.filename != NULL)
+		isc_mem_free(j->mctx, j->dense.filename);
+	j->dense.filename = NULL;
+}
+
+/*
+ * Set '*namep' to the name of the dense index of the journal
+ * 'filename'.
+ */
+static isc_result_t
+dense_filename(isc_mem_t *mctx, const char *filename, char **namep) {
+	char name[1024];
+	size_t namelen;
+	isc_result_t result;
+
+	namelen = strlen(filename);
+	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0)
+		namelen -= 4;
+	result = isc_string_printf(name, sizeof(name), "%.*s.jix",
+				   (int)namelen, filename);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	*namep = isc_mem_strdup(mctx, name);
+	if (*namep == NULL)
+		return (ISC_R_NOMEMORY);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * (Re)create the dense index of 'j' with no entries.
+ */
+static isc_result_t
+dense_create(dns_journal_t *j) {
+	isc_result_t result;
+
+	if (j->dense.fp != NULL)
+		(void)isc_stdio_close(j->dense.fp);
+	j->dense.fp = NULL;
+	result = isc_stdio_open(j->dense.filename, "wb+", &j->dense.fp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	return (isc_stdio_write(dense_format, 1, sizeof(dense_format),
+				j->dense.fp, NULL));
+}
+
+static isc_result_t
+dense_write(dns_journal_t *j, journal_pos_t *pos) {
+	journal_rawpos_t raw;
+
+	journal_pos_encode(&raw, pos);
+	return (isc_stdio_write(&raw, 1, sizeof(raw), j->dense.fp, NULL));
+}
+
+/*
+ * Bring the open dense index of writable journal 'j' up to date:
+ * keep its entries if the last one is a transaction of the journal,
+ * otherwise start again, and add any transactions it lacks.
+ */
+static isc_result_t
+dense_catchup(dns_journal_t *j) {
+	journal_rawpos_t raw;
+	journal_pos_t pos;
+	journal_xhdr_t xhdr;
+	off_t size;
+	isc_boolean_t valid = ISC_FALSE;
+	isc_result_t result;
+
+	CHECK(isc_file_getsizefd(fileno(j->dense.fp), &size));
+	if (size >= (off_t)(sizeof(dense_format) + sizeof(raw)) &&
+	    (size - sizeof(dense_format)) % sizeof(raw) == 0)
+	{
+		CHECK(isc_stdio_seek(j->dense.fp, size - sizeof(raw),
+				     SEEK_SET));
+		CHECK(isc_stdio_read(&raw, 1, sizeof(raw), j->dense.fp, NULL));
+		journal_pos_decode(&raw, &pos);
+		if (!JOURNAL_EMPTY(&j->header) &&
+		    pos.offset >= j->header.begin.offset &&
+		    pos.offset < j->header.end.offset &&
+		    journal_seek(j, pos.offset) == ISC_R_SUCCESS &&
+		    journal_read_xhdr(j, &xhdr) == ISC_R_SUCCESS &&
+		    xhdr.serial0 == pos.serial)
+			valid = ISC_TRUE;
+	}
+
+	if (valid) {
+		/*
+		 * Step over the transaction we already have.
+		 */
+		CHECK(journal_next(j, &pos));
+	} else {
+		if (size != (off_t)sizeof(dense_format)) {
+			/*
+			 * Start again with an empty file.
+			 */
+			isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+				      "%s: rebuilding", j->dense.filename);
+			CHECK(dense_create(j));
+		}
+		pos = j->header.begin;
+	}
+
+	CHECK(isc_stdio_seek(j->dense.fp, 0, SEEK_END));
+	if (!JOURNAL_EMPTY(&j->header)) {
+		while (pos.serial != j->header.end.serial) {
+			CHECK(dense_write(j, &pos));
+			CHECK(journal_next(j, &pos));
+		}
+	}
+	CHECK(isc_stdio_flush(j->dense.fp));
+
+ failure:
+	return (result);
+}
+
+/*
+ * Open the dense index of writable journal 'j', creating it if
+ * necessary.
+ */
+static void
+dense_open(dns_journal_t *j) {
+	isc_result_t result;
+
+	CHECK(dense_filename(j->mctx, j->filename, &j->dense.filename));
+	result = isc_stdio_open(j->dense.filename, "rb+", &j->dense.fp);
+	if (result == ISC_R_FILENOTFOUND)
+		CHECK(dense_create(j));
+	else if (result == ISC_R_SUCCESS) {
+		unsigned char format[sizeof(dense_format)];
+
+		/*
+		 * Start again if the file is not ours, or is damaged.
+		 */
+		result = isc_stdio_read(format, 1, sizeof(format),
+					j->dense.fp, NULL);
+		if (result != ISC_R_SUCCESS ||
+		    memcmp(format, dense_format, sizeof(format)) != 0)
+			CHECK(dense_create(j));
+	} else
+		goto failure;
+	CHECK(dense_catchup(j));
+	return;
+
+ failure:
+	isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+		      "%s: dense index not available: %s",
+		      j->filename, isc_result_totext(result));
+	dense_close(j);
+}
+
+/*
+ * Map the dense index of 'j' for lookups.  Entries added after this
+ * are not seen; lookups of them scan from the last mapped entry.
+ */
+static void
+dense_map(dns_journal_t *j) {
+	unsigned char format[sizeof(dense_format)];
+	FILE *fp = NULL;
+	off_t size;
+	isc_result_t result;
+
+	j->dense.mapped = ISC_TRUE;
+
+	if (j->dense.filename == NULL)
+		CHECK(dense_filename(j->mctx, j->filename,
+				     &j->dense.filename));
+	if (j->dense.fp != NULL)
+		CHECK(isc_stdio_flush(j->dense.fp));
+	result = isc_stdio_open(j->dense.filename, "rb", &fp);
+	if (result == ISC_R_FILENOTFOUND)
+		return;
+	CHECK(result);
+	CHECK(isc_file_getsizefd(fileno(fp), &size));
+	if (size < (off_t)(sizeof(dense_format) + sizeof(journal_rawpos_t)))
+		goto failure;
+	CHECK(isc_stdio_read(format, 1, sizeof(format), fp, NULL));
+	if (memcmp(format, dense_format, sizeof(format)) != 0)
+		goto failure;
+	CHECK(isc_file_mmap(fileno(fp), (size_t)size,
+			    (void **)&j->dense.map));
+	j->dense.maplen = (size_t)size;
+	j->dense.count = (unsigned int)((size - sizeof(dense_format)) /
+					sizeof(journal_rawpos_t));
+
+ failure:
+	if (fp != NULL)
+		(void)isc_stdio_close(fp);
+}
+
+static inline void
+dense_entry(dns_journal_t *j, unsigned int i, journal_pos_t *pos) {
+	journal_rawpos_t *raw;
+
+	raw = (journal_rawpos_t *)(j->dense.map + sizeof(dense_format));
+	journal_pos_decode(&raw[i], pos);
+}
+
+/*
+ * If the dense index of 'j' has an entry for 'serial', or failing
+ * that for the closest transaction before it, which is "better" than
+ * '*best_guess' (see index_find()), replace '*best_guess' with it.
+ */
+static void
+dense_find(dns_journal_t *j, isc_uint32_t serial, journal_pos_t *best_guess)
+{
+	journal_pos_t pos;
+	journal_xhdr_t xhdr;
+	unsigned int lo, hi, mid;
+
+	if (!j->dense.mapped)
+		dense_map(j);
+	if (j->dense.map == NULL)
+		return;
+
+	/*
+	 * Skip the entries before the first addressable transaction;
+	 * their serial numbers need not be comparable.
+	 */
+	lo = 0;
+	hi = j->dense.count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		dense_entry(j, mid, &pos);
+		if (pos.offset < j->header.begin.offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/*
+	 * Find the first entry with a serial number not less than
+	 * 'serial'.
+	 */
+	hi = j->dense.count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		dense_entry(j, mid, &pos);
+		if (pos.offset < j->header.end.offset &&
+		    DNS_SERIAL_GT(serial, pos.serial))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < j->dense.count) {
+		dense_entry(j, lo, &pos);
+		if (pos.serial != serial || pos.offset >= j->header.end.offset)
+			pos.offset = 0;
+	} else
+		pos.offset = 0;
+	if (pos.offset == 0) {
+		if (lo == 0)
+			return;
+		dense_entry(j, lo - 1, &pos);
+	}
+
+	if (pos.offset < j->header.begin.offset ||
+	    pos.offset >= j->header.end.offset ||
+	    !DNS_SERIAL_GT(pos.serial, best_guess->serial) ||
+	    DNS_SERIAL_GT(pos.serial, serial))
+		return;
+
+	/*
+	 * Check that the entry is right before relying on it.
+	 */
+	if (journal_seek(j, pos.offset) != ISC_R_SUCCESS ||
+	    journal_read_xhdr(j, &xhdr) != ISC_R_SUCCESS ||
+	    xhdr.serial0 != pos.serial)
+	{
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+			      "%s: ignoring stale dense index",
+			      j->filename);
+		return;
+	}
+	*best_guess = pos;
+}
+
 /*
  * Try to find a transaction with initial serial number 'serial'
  * in the journal 'j'.
@@ -953,6 +1316,7 @@ journal_find(dns_journal_t *j, isc_uint32_t serial, journal_pos_t *pos) {
 
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
+	dense_find(j, serial, &current_pos);
 
 	while (current_pos.serial != serial) {
 		if (DNS_SERIAL_GT(current_pos.serial, serial))
@@ -1090,10 +1454,85 @@ dns_journal_writediff(dns_journal_t *j, dns_diff_t *diff) {
 
 }
 
+/*
+ * Make the transactions committed so far durable: commit their data
+ * to stable storage, then write out the header and the index and
+ * commit those, and finally record the transactions in the dense
+ * index.
+ */
+static isc_result_t
+journal_flush(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+	unsigned int i;
+
+	CHECK(journal_fsync(j));
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+	CHECK(index_to_disk(j));
+	CHECK(journal_fsync(j));
+	j->dirty = ISC_FALSE;
+
+	if (j->dense.fp != NULL) {
+		for (i = 0; i < j->dense.npending; i++) {
+			result = dense_write(j, &j->dense.pending[i]);
+			if (result != ISC_R_SUCCESS)
+				break;
+		}
+		if (result == ISC_R_SUCCESS)
+			result = isc_stdio_flush(j->dense.fp);
+		if (result != ISC_R_SUCCESS) {
+			/*
+			 * The next writer will catch up.
+			 */
+			isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+				      "%s: write: %s", j->dense.filename,
+				      isc_result_totext(result));
+			(void)isc_stdio_close(j->dense.fp);
+			j->dense.fp = NULL;
+			result = ISC_R_SUCCESS;
+		}
+	}
+
+ failure:
+	j->dense.npending = 0;
+	return (result);
+}
+
+/*
+ * Remember the transaction at 'pos' for the dense index.
+ */
+static isc_result_t
+dense_add(dns_journal_t *j, journal_pos_t *pos) {
+	journal_pos_t *pending;
+	unsigned int max;
+
+	if (j->dense.fp == NULL)
+		return (ISC_R_SUCCESS);
+	if (j->dense.npending == j->dense.maxpending) {
+		max = j->dense.maxpending * 2 + 8;
+		pending = isc_mem_get(j->mctx, max * sizeof(journal_pos_t));
+		if (pending == NULL)
+			return (ISC_R_NOMEMORY);
+		if (j->dense.pending != NULL) {
+			memmove(pending, j->dense.pending,
+				j->dense.npending * sizeof(journal_pos_t));
+			isc_mem_put(j->mctx, j->dense.pending,
+				    j->dense.maxpending *
+				    sizeof(journal_pos_t));
+		}
+		j->dense.pending = pending;
+		j->dense.maxpending = max;
+	}
+	j->dense.pending[j->dense.npending++] = *pos;
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_journal_commit(dns_journal_t *j) {
 	isc_result_t result;
-	journal_rawheader_t rawheader;
 
 	REQUIRE(DNS_JOURNAL_VALID(j));
 	REQUIRE(j->state == JOURNAL_STATE_TRANSACTION ||
@@ -1103,11 +1542,7 @@ dns_journal_commit(dns_journal_t *j) {
 	 * Just write out a updated header.
 	 */
 	if (j->state == JOURNAL_STATE_INLINE) {
-		CHECK(journal_fsync(j));
-		journal_header_encode(&j->header, &rawheader);
-		CHECK(journal_seek(j, 0));
-		CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
-		CHECK(journal_fsync(j));
+		CHECK(journal_flush(j));
 		j->state = JOURNAL_STATE_WRITE;
 		return (ISC_R_SUCCESS);
 	}
@@ -1162,11 +1597,6 @@ dns_journal_commit(dns_journal_t *j) {
 	}
 #endif
 
-	/*
-	 * Commit the transaction data to stable storage.
-	 */
-	CHECK(journal_fsync(j));
-
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		isc_offset_t offset;
 		offset = (j->x.pos[1].offset - j->x.pos[0].offset) -
@@ -1180,35 +1610,27 @@ dns_journal_commit(dns_journal_t *j) {
 	}
 
 	/*
-	 * Update the journal header.
+	 * Update the in-core journal header and the indexes.
 	 */
 	if (JOURNAL_EMPTY(&j->header))
 		j->header.begin = j->x.pos[0];
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
-
-	/*
-	 * Update the index.
-	 */
 	index_add(j, &j->x.pos[0]);
+	CHECK(dense_add(j, &j->x.pos[0]));
 
 	/*
-	 * Convert the index into on-disk format and write
-	 * it to disk.
-	 */
-	CHECK(index_to_disk(j));
-
-	/*
-	 * Commit the header to stable storage.
+	 * We no longer have a transaction open.
 	 */
-	CHECK(journal_fsync(j));
+	j->state = JOURNAL_STATE_WRITE;
 
 	/*
-	 * We no longer have a transaction open.
+	 * Write the headers and commit everything to stable storage,
+	 * unless that is being left to dns_journal_sync().
 	 */
-	j->state = JOURNAL_STATE_WRITE;
+	if (j->group)
+		j->dirty = ISC_TRUE;
+	else
+		CHECK(journal_flush(j));
 
 	result = ISC_R_SUCCESS;
 
@@ -1228,11 +1650,40 @@ dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff) {
 	return (result);
 }
 
+void
+dns_journal_setgroupcommit(dns_journal_t *j, isc_boolean_t group) {
+	REQUIRE(DNS_JOURNAL_VALID(j));
+
+	j->group = group;
+}
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->state == JOURNAL_STATE_WRITE ||
+		j->state == JOURNAL_STATE_INLINE ||
+		j->state == JOURNAL_STATE_READ);
+
+	if (!j->dirty)
+		return (ISC_R_SUCCESS);
+	return (journal_flush(j));
+}
+
 void
 dns_journal_destroy(dns_journal_t **journalp) {
 	dns_journal_t *j = *journalp;
+	isc_result_t result;
+
 	REQUIRE(DNS_JOURNAL_VALID(j));
 
+	if (j->dirty) {
+		result = journal_flush(j);
+		if (result != ISC_R_SUCCESS)
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: sync: %s", j->filename,
+				      isc_result_totext(result));
+	}
+
 	j->it.result = ISC_R_FAILURE;
 	dns_name_invalidate(&j->it.name);
 	dns_decompress_invalidate(&j->it.dctx);
@@ -1246,6 +1697,9 @@ dns_journal_destroy(dns_journal_t **journalp) {
 		isc_mem_put(j->mctx, j->it.target.base, j->it.target.length);
 	if (j->it.source.base != NULL)
 		isc_mem_put(j->mctx, j->it.source.base, j->it.source.length);
+	if (j->map != NULL)
+		(void)isc_file_munmap(j->map, j->maplen);
+	dense_close(j);
 	if (j->filename != NULL)
 		isc_mem_free(j->mctx, j->filename);
 	if (j->fp != NULL)
@@ -1618,12 +2072,48 @@ size_buffer(isc_mem_t *mctx, isc_buffer_t *b, unsigned size) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map the committed part of journal 'j', which is open for reading,
+ * so that the transactions can be read without copying them.  If it
+ * cannot be mapped it is read as usual.
+ */
+static void
+journal_map(dns_journal_t *j) {
+	off_t size;
+	isc_result_t result;
+
+	if (j->map != NULL || JOURNAL_EMPTY(&j->header))
+		return;
+
+	/*
+	 * Reading a mapping past the end of the file is fatal.
+	 */
+	result = isc_file_getsizefd(fileno(j->fp), &size);
+	if (result == ISC_R_SUCCESS &&
+	    size < (off_t)j->header.end.offset)
+		result = ISC_R_UNEXPECTEDEND;
+	if (result == ISC_R_SUCCESS)
+		result = isc_file_mmap(fileno(j->fp), j->header.end.offset,
+				       (void **)&j->map);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(1),
+			      "%s: not mapped: %s", j->filename,
+			      isc_result_totext(result));
+		return;
+	}
+	j->maplen = j->header.end.offset;
+	j->offset = -1; /* Invalid, must seek explicitly. */
+}
+
 isc_result_t
 dns_journal_iter_init(dns_journal_t *j,
 		      isc_uint32_t begin_serial, isc_uint32_t end_serial)
 {
 	isc_result_t result;
 
+	if (j->state == JOURNAL_STATE_READ)
+		journal_map(j);
+
 	CHECK(journal_find(j, begin_serial, &j->it.bpos));
 	INSIST(j->it.bpos.serial == begin_serial);
 
@@ -1660,6 +2150,7 @@ dns_journal_first_rr(dns_journal_t *j) {
 static isc_result_t
 read_one_rr(dns_journal_t *j) {
 	isc_result_t result;
+	isc_buffer_t mapped, *source;
 
 	dns_rdatatype_t rdtype;
 	dns_rdataclass_t rdclass;
@@ -1712,9 +2203,22 @@ read_one_rr(dns_journal_t *j) {
 		FAIL(ISC_R_UNEXPECTED);
 	}
 
-	CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
-	CHECK(journal_read(j, j->it.source.base, rrhdr.size));
-	isc_buffer_add(&j->it.source, rrhdr.size);
+	/*
+	 * Parse a mapped RR where it is.
+	 */
+	if (j->map != NULL) {
+		if (rrhdr.size > j->maplen - (size_t)j->offset)
+			FAIL(ISC_R_UNEXPECTEDEND);
+		source = &mapped;
+		isc_buffer_init(source, j->map + j->offset, rrhdr.size);
+		isc_buffer_add(source, rrhdr.size);
+		j->offset += rrhdr.size;
+	} else {
+		source = &j->it.source;
+		CHECK(size_buffer(j->mctx, source, rrhdr.size));
+		CHECK(journal_read(j, source->base, rrhdr.size));
+		isc_buffer_add(source, rrhdr.size);
+	}
 
 	/*
 	 * The target buffer is made the same size
@@ -1729,31 +2233,30 @@ read_one_rr(dns_journal_t *j) {
 	 * ends yet, so we make the entire "remaining"
 	 * part of the buffer "active".
 	 */
-	isc_buffer_setactive(&j->it.source,
-			     j->it.source.used - j->it.source.current);
-	CHECK(dns_name_fromwire(&j->it.name, &j->it.source,
+	isc_buffer_setactive(source, source->used - source->current);
+	CHECK(dns_name_fromwire(&j->it.name, source,
 				&j->it.dctx, 0, &j->it.target));
 
 	/*
 	 * Check that the RR header is there, and parse it.
 	 */
-	if (isc_buffer_remaininglength(&j->it.source) < 10)
+	if (isc_buffer_remaininglength(source) < 10)
 		FAIL(DNS_R_FORMERR);
 
-	rdtype = isc_buffer_getuint16(&j->it.source);
-	rdclass = isc_buffer_getuint16(&j->it.source);
-	ttl = isc_buffer_getuint32(&j->it.source);
-	rdlen = isc_buffer_getuint16(&j->it.source);
+	rdtype = isc_buffer_getuint16(source);
+	rdclass = isc_buffer_getuint16(source);
+	ttl = isc_buffer_getuint32(source);
+	rdlen = isc_buffer_getuint16(source);
 
 	/*
 	 * Parse the rdata.
 	 */
-	if (isc_buffer_remaininglength(&j->it.source) != rdlen)
+	if (isc_buffer_remaininglength(source) != rdlen)
 		FAIL(DNS_R_FORMERR);
-	isc_buffer_setactive(&j->it.source, rdlen);
+	isc_buffer_setactive(source, rdlen);
 	dns_rdata_reset(&j->it.rdata);
 	CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass,
-				 rdtype, &j->it.source, &j->it.dctx,
+				 rdtype, source, &j->it.dctx,
 				 0, &j->it.target));
 	j->it.ttl = ttl;
 
@@ -2108,6 +2611,7 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 	unsigned int indexend;
 	char newname[1024];
 	char backup[1024];
+	char *dense = NULL, *newdense = NULL;
 	isc_boolean_t is_backup = ISC_FALSE;
 
 	namelen = strlen(filename);
@@ -2249,11 +2753,17 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 		CHECK(journal_fsync(new));
 
 		/*
-		 * Build new index.
+		 * Build new indexes.
 		 */
 		current_pos = new->header.begin;
 		while (current_pos.serial != new->header.end.serial) {
 			index_add(new, &current_pos);
+			if (new->dense.fp != NULL &&
+			    dense_write(new, &current_pos) != ISC_R_SUCCESS)
+			{
+				(void)isc_stdio_close(new->dense.fp);
+				new->dense.fp = NULL;
+			}
 			CHECK(journal_next(new, &current_pos));
 		}
 
@@ -2273,6 +2783,8 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 	 */
 	dns_journal_destroy(&j);
 	dns_journal_destroy(&new);
+	CHECK(dense_filename(mctx, filename, &dense));
+	CHECK(dense_filename(mctx, newname, &newdense));
 
 	/*
 	 * With a UFS file system this should just succeed and be atomic.
@@ -2303,10 +2815,26 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, isc_uint32_t serial,
 		}
 	}
 
+	/*
+	 * Move the new dense index into place.  If that fails, the old
+	 * one no longer matches the journal; remove it so that the next
+	 * writer rebuilds it.
+	 */
+	if (rename(newdense, dense) == -1) {
+		(void)isc_file_remove(dense);
+		(void)rename(newdense, dense);
+	}
+
 	result = ISC_R_SUCCESS;
 
  failure:
 	(void)isc_file_remove(newname);
+	if (newdense != NULL) {
+		(void)isc_file_remove(newdense);
+		isc_mem_free(mctx, newdense);
+	}
+	if (dense != NULL)
+		isc_mem_free(mctx, dense);
 	if (buf != NULL)
 		isc_mem_put(mctx, buf, size);
 	if (j != NULL)
@@ -21,7 +21,9 @@
 
 #include <config.h>
 
+#include <isc/condition.h>
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -31,6 +33,7 @@
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
@@ -93,9 +96,39 @@
 
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
+/*%
+ * Text files of at least PARALLEL_MINSIZE bytes can be parsed by several
+ * threads.  The file is cut before lines that start with an owner name
+ * into chunks of at least PARALLEL_MINCHUNK bytes, PARALLEL_CHUNKS per
+ * thread.  Each worker copies the rdatasets it parses into batches of
+ * PARALLEL_BATCHSIZE bytes; at most PARALLEL_MAXPENDING of them per
+ * chunk wait to be committed.
+ */
+#define PARALLEL_MINSIZE (256*1024)
+#define PARALLEL_MINCHUNK (64*1024)
+#define PARALLEL_CHUNKS 4
+#define PARALLEL_BATCHSIZE (64*1024)
+#define PARALLEL_MAXPENDING 16
+
+/*%
+ * Warnings given at most once per load.
+ */
+#define WARN_1035	0
+#define WARN_TCR	1
+#define WARN_SIGEXPIRED	2
+#define WARN_MAX	3
+
+static const char *warn_once_text[WARN_MAX] = {
+	"using RFC1035 TTL semantics",
+	"old style DNSSEC  zone detected",
+	"signature has expired"
+};
+
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct loadpar loadpar_t;
+typedef struct loadchunk loadchunk_t;
 
 /*%
  * Master file load state.
@@ -137,6 +170,11 @@ struct dns_loadctx {
 	isc_boolean_t		first;
 	dns_masterrawheader_t	header;
 
+	/* Members specific to parallel text loading: */
+	unsigned int		threads;
+	loadpar_t		*par;		/*%< Parallel load state. */
+	loadchunk_t		*chunk;		/*%< Set in worker contexts. */
+
 	/* Which fixed buffers we are using? */
 	unsigned int		loop_cnt;		/*% records per quantum,
 							 * 0 => all. */
@@ -168,6 +206,80 @@ struct dns_incctx {
 #define DNS_LCTX_MAGIC ISC_MAGIC('L','c','t','x')
 #define DNS_LCTX_VALID(lctx) ISC_MAGIC_VALID(lctx, DNS_LCTX_MAGIC)
 
+#ifdef ISC_PLATFORM_USETHREADS
+/*%
+ * An rdataset parsed by a worker, copied into a batch.  The rdata
+ * structures, the owner name and the rdata follow.
+ */
+typedef struct loadentry {
+	size_t			size;
+	unsigned long		line;
+	dns_name_t		owner;
+	dns_rdatalist_t		rdatalist;
+} loadentry_t;
+
+typedef struct loadbatch loadbatch_t;
+
+struct loadbatch {
+	unsigned char		*base;
+	size_t			size;
+	size_t			used;
+	unsigned int		count;
+	ISC_LINK(loadbatch_t)	link;
+};
+
+struct loadchunk {
+	loadpar_t		*par;
+	const char		*base;
+	size_t			length;
+	unsigned long		line;
+	dns_fixedname_t		origin;		/*%< $ORIGIN at the start. */
+	isc_uint32_t		ttl;		/*%< $TTL at the start. */
+	loadbatch_t		*batch;		/*%< Being filled. */
+	unsigned int		warned;		/*%< WARN_* bits seen. */
+	unsigned long		warnline[WARN_MAX];
+	/* Locked by par->lock. */
+	ISC_LIST(loadbatch_t)	batches;
+	unsigned int		pending;
+	isc_boolean_t		done;
+	isc_result_t		result;
+};
+
+struct loadpar {
+	dns_loadctx_t		*lctx;
+	char			*filename;
+	void			*base;
+	size_t			size;
+	loadchunk_t		*chunks;
+	unsigned int		nchunks;
+	unsigned int		merging;	/*%< Chunk being committed. */
+	isc_thread_t		*threads;
+	unsigned int		nthreads;
+	unsigned int		running;
+	isc_mutex_t		lock;
+	isc_condition_t		ready;		/*%< A batch is ready. */
+	isc_condition_t		space;		/*%< A batch was taken. */
+	unsigned int		warned;		/*%< WARN_* bits given. */
+	/* Locked by lock. */
+	unsigned int		next;		/*%< Next chunk to parse. */
+	isc_boolean_t		canceled;
+};
+
+static isc_result_t
+parallel_create(dns_loadctx_t *lctx, const char *master_file,
+		isc_boolean_t *usedp);
+
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx);
+
+static void
+parallel_destroy(loadpar_t *par);
+
+static isc_result_t
+batch_add(loadchunk_t *chunk, dns_rdatalist_t *rdatalist, dns_name_t *owner,
+	  unsigned long line);
+#endif /* ISC_PLATFORM_USETHREADS */
+
 #define DNS_AS_STR(t) ((t).value.as_textregion.base)
 
 static isc_result_t
@@ -176,12 +288,18 @@ openfile_text(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 openfile_raw(dns_loadctx_t *lctx, const char *master_file);
 
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file);
+
 static isc_result_t
 load_text(dns_loadctx_t *lctx);
 
 static isc_result_t
 load_raw(dns_loadctx_t *lctx);
 
+static isc_result_t
+load_map(dns_loadctx_t *lctx);
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx);
 
@@ -459,6 +577,10 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 	REQUIRE(DNS_LCTX_VALID(lctx));
 
 	lctx->magic = 0;
+#ifdef ISC_PLATFORM_USETHREADS
+	if (lctx->par != NULL)
+		parallel_destroy(lctx->par);
+#endif
 	if (lctx->inc != NULL)
 		incctx_destroy(lctx->mctx, lctx->inc);
 
@@ -570,6 +692,10 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 		lctx->openfile = openfile_raw;
 		lctx->load = load_raw;
 		break;
+	case dns_masterformat_map:
+		lctx->openfile = openfile_map;
+		lctx->load = load_map;
+		break;
 	}
 
 	if (lex != NULL) {
@@ -612,6 +738,10 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	lctx->first = ISC_TRUE;
 	dns_master_initrawheader(&lctx->header);
 
+	lctx->threads = 1;
+	lctx->par = NULL;
+	lctx->chunk = NULL;
+
 	lctx->loop_cnt = (done != NULL) ? 100 : 0;
 	lctx->callbacks = callbacks;
 	lctx->task = NULL;
@@ -779,6 +909,16 @@ genname(char *name, int it, char *buffer, size_t length) {
 
 static isc_result_t
 openfile_text(dns_loadctx_t *lctx, const char *master_file) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_boolean_t used = ISC_FALSE;
+	isc_result_t result;
+
+	if (lctx->threads > 1) {
+		result = parallel_create(lctx, master_file, &used);
+		if (result != ISC_R_SUCCESS || used)
+			return (result);
+	}
+#endif
 	return (isc_lex_openfile(lctx->lex, master_file));
 }
 
@@ -796,6 +936,11 @@ openfile_raw(dns_loadctx_t *lctx, const char *master_file) {
 	return (result);
 }
 
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file) {
+	return (openfile_raw(lctx, master_file));
+}
+
 static isc_result_t
 generate(dns_loadctx_t *lctx, char *range, char *lhs, char *gtype, char *rhs,
 	 const char *source, unsigned int line)
@@ -963,6 +1108,30 @@ limit_ttl(dns_rdatacallbacks_t *callbacks, const char *source, unsigned int line
 	}
 }
 
+/*
+ * Give a once-only warning.  A parallel load worker only notes the first
+ * line of its chunk that calls for it; load_parallel() gives the warning
+ * for the first chunk, in file order, that noted it.
+ */
+static void
+warn_once(dns_loadctx_t *lctx, unsigned int which, const char *source,
+	  unsigned long line)
+{
+#ifdef ISC_PLATFORM_USETHREADS
+	loadchunk_t *chunk = lctx->chunk;
+
+	if (chunk != NULL) {
+		if ((chunk->warned & (1U << which)) == 0) {
+			chunk->warned |= (1U << which);
+			chunk->warnline[which] = line;
+		}
+		return;
+	}
+#endif
+	(*lctx->callbacks->warn)(lctx->callbacks, "%s:%lu: %s",
+				 source, line, warn_once_text[which]);
+}
+
 static isc_result_t
 check_ns(dns_loadctx_t *lctx, isc_token_t *token, const char *source,
 	 unsigned long line)
@@ -1878,10 +2047,7 @@ load_text(dns_loadctx_t *lctx) {
 		} else if (!explicit_ttl && lctx->default_ttl_known) {
 			lctx->ttl = lctx->default_ttl;
 		} else if (!explicit_ttl && lctx->warn_1035) {
-			(*callbacks->warn)(callbacks,
-					   "%s:%lu: "
-					   "using RFC1035 TTL semantics",
-					   source, line);
+			warn_once(lctx, WARN_1035, source, line);
 			lctx->warn_1035 = ISC_FALSE;
 		}
 
@@ -1891,10 +2057,7 @@ load_text(dns_loadctx_t *lctx) {
 						    NULL);
 			RUNTIME_CHECK(result == ISC_R_SUCCESS);
 			if (isc_serial_lt(sig.timeexpire, now)) {
-				(*callbacks->warn)(callbacks,
-						   "%s:%lu: "
-						   "signature has expired",
-						   source, line);
+				warn_once(lctx, WARN_SIGEXPIRED, source, line);
 				lctx->warn_sigexpired = ISC_FALSE;
 			}
 		}
@@ -1902,8 +2065,7 @@ load_text(dns_loadctx_t *lctx) {
 		if ((type == dns_rdatatype_sig || type == dns_rdatatype_nxt) &&
 		    lctx->warn_tcr && (lctx->options & DNS_MASTER_ZONE) != 0 &&
 		    (lctx->options & DNS_MASTER_SLAVE) == 0) {
-			(*callbacks->warn)(callbacks, "%s:%lu: old style DNSSEC "
-					   " zone detected", source, line);
+			warn_once(lctx, WARN_TCR, source, line);
 			lctx->warn_tcr = ISC_FALSE;
 		}
 
@@ -2446,6 +2608,724 @@ load_raw(dns_loadctx_t *lctx) {
 	return (result);
 }
 
+static isc_result_t
+load_map(dns_loadctx_t *lctx) {
+	isc_result_t result;
+	dns_rdatacallbacks_t *callbacks;
+	dns_masterrawheader_t header;
+	unsigned char data[sizeof(header)];
+	isc_buffer_t target;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+	callbacks = lctx->callbacks;
+
+	/*
+	 * The file header has the layout of a version 1 raw file header.
+	 */
+	INSIST(sizeof(data) == 6 * sizeof(isc_uint32_t));
+	dns_master_initrawheader(&header);
+	isc_buffer_init(&target, data, sizeof(data));
+	result = isc_stdio_read(data, 1, sizeof(data), lctx->f, NULL);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_stdio_read failed: %s",
+				 isc_result_totext(result));
+		return (result);
+	}
+	isc_buffer_add(&target, sizeof(data));
+
+	header.format = isc_buffer_getuint32(&target);
+	if (header.format != dns_masterformat_map) {
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "file format mismatch");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	header.version = isc_buffer_getuint32(&target);
+	if (header.version != DNS_MAPFORMAT_VERSION) {
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "unsupported file format version");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	header.dumptime = isc_buffer_getuint32(&target);
+	header.flags = isc_buffer_getuint32(&target);
+	header.sourceserial = isc_buffer_getuint32(&target);
+	header.lastxfrin = isc_buffer_getuint32(&target);
+	lctx->first = ISC_FALSE;
+	lctx->header = header;
+
+	if (callbacks->deserialize == NULL) {
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "database cannot load map files");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	/*
+	 * The database takes over the rest of the file in one step.
+	 */
+	result = (*callbacks->deserialize)(callbacks->deserialize_private,
+					   lctx->f, sizeof(data));
+	if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL)
+		(*callbacks->rawdata)(callbacks->zone, &header);
+
+	if (result != ISC_R_SUCCESS)
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    dns_result_totext(result));
+
+	return (result);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static void
+batch_destroy(isc_mem_t *mctx, loadbatch_t **batchp) {
+	loadbatch_t *batch = *batchp;
+
+	*batchp = NULL;
+	isc_mem_put(mctx, batch->base, batch->size);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+}
+
+static isc_result_t
+batch_create(isc_mem_t *mctx, size_t size, loadbatch_t **batchp) {
+	loadbatch_t *batch;
+
+	batch = isc_mem_get(mctx, sizeof(*batch));
+	if (batch == NULL)
+		return (ISC_R_NOMEMORY);
+	batch->base = isc_mem_get(mctx, size);
+	if (batch->base == NULL) {
+		isc_mem_put(mctx, batch, sizeof(*batch));
+		return (ISC_R_NOMEMORY);
+	}
+	batch->size = size;
+	batch->used = 0;
+	batch->count = 0;
+	ISC_LINK_INIT(batch, link);
+	*batchp = batch;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Hand the batch being filled to the loading thread, waiting while
+ * too many batches of the chunk are pending.
+ */
+static isc_result_t
+batch_push(loadchunk_t *chunk) {
+	loadpar_t *par = chunk->par;
+	loadbatch_t *batch = chunk->batch;
+	isc_boolean_t canceled;
+
+	chunk->batch = NULL;
+	LOCK(&par->lock);
+	while (chunk->pending >= PARALLEL_MAXPENDING && !par->canceled)
+		WAIT(&par->space, &par->lock);
+	canceled = par->canceled;
+	if (!canceled) {
+		ISC_LIST_APPEND(chunk->batches, batch, link);
+		chunk->pending++;
+		SIGNAL(&par->ready);
+	}
+	UNLOCK(&par->lock);
+
+	if (canceled) {
+		batch_destroy(par->lctx->mctx, &batch);
+		return (ISC_R_CANCELED);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Copy an rdataset parsed by a worker into the chunk's batch.
+ */
+static isc_result_t
+batch_add(loadchunk_t *chunk, dns_rdatalist_t *rdatalist, dns_name_t *owner,
+	  unsigned long line)
+{
+	loadbatch_t *batch;
+	loadentry_t *entry;
+	dns_rdata_t *rdata, *copy;
+	unsigned char *p;
+	unsigned int count = 0;
+	size_t size, length = 0;
+	isc_region_t r;
+	isc_result_t result;
+
+	for (rdata = ISC_LIST_HEAD(rdatalist->rdata);
+	     rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link)) {
+		count++;
+		length += rdata->length;
+	}
+	size = sizeof(*entry) + count * sizeof(*copy) + owner->length +
+	       length;
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+	if (chunk->batch != NULL &&
+	    chunk->batch->size - chunk->batch->used < size) {
+		result = batch_push(chunk);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	if (chunk->batch == NULL) {
+		result = batch_create(chunk->par->lctx->mctx,
+				      ISC_MAX(size, PARALLEL_BATCHSIZE),
+				      &chunk->batch);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	batch = chunk->batch;
+
+	entry = (loadentry_t *)(batch->base + batch->used);
+	copy = (dns_rdata_t *)(entry + 1);
+	p = (unsigned char *)(copy + count);
+
+	entry->size = size;
+	entry->line = line;
+	memmove(p, owner->ndata, owner->length);
+	r.base = p;
+	r.length = owner->length;
+	dns_name_init(&entry->owner, NULL);
+	dns_name_fromregion(&entry->owner, &r);
+	p += owner->length;
+
+	dns_rdatalist_init(&entry->rdatalist);
+	entry->rdatalist.rdclass = rdatalist->rdclass;
+	entry->rdatalist.type = rdatalist->type;
+	entry->rdatalist.covers = rdatalist->covers;
+	entry->rdatalist.ttl = rdatalist->ttl;
+	for (rdata = ISC_LIST_HEAD(rdatalist->rdata);
+	     rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link)) {
+		dns_rdata_init(copy);
+		memmove(p, rdata->data, rdata->length);
+		copy->data = p;
+		copy->length = rdata->length;
+		copy->rdclass = rdata->rdclass;
+		copy->type = rdata->type;
+		copy->flags = rdata->flags;
+		ISC_LIST_APPEND(entry->rdatalist.rdata, copy, link);
+		p += rdata->length;
+		copy++;
+	}
+
+	batch->used += size;
+	batch->count++;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Parse one chunk with a load context of its own, whose commits go
+ * to the chunk's batches.
+ */
+static isc_result_t
+parse_chunk(loadpar_t *par, loadchunk_t *chunk) {
+	dns_loadctx_t *lctx = par->lctx;
+	dns_loadctx_t *wctx = NULL;
+	isc_buffer_t buffer;
+	isc_result_t result, tresult;
+	char *base;
+
+	result = loadctx_create(dns_masterformat_text, lctx->mctx,
+				lctx->options, lctx->resign, lctx->top,
+				lctx->zclass, dns_fixedname_name(&chunk->origin),
+				lctx->callbacks, NULL, NULL, NULL, NULL, &wctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	wctx->chunk = chunk;
+	if (chunk != &par->chunks[0]) {
+		wctx->ttl = chunk->ttl;
+		wctx->ttl_known = ISC_TRUE;
+		wctx->default_ttl = chunk->ttl;
+		wctx->default_ttl_known = ISC_TRUE;
+	}
+
+	DE_CONST(chunk->base, base);
+	isc_buffer_init(&buffer, base, chunk->length);
+	isc_buffer_add(&buffer, chunk->length);
+	result = isc_lex_openbuffer(wctx->lex, &buffer);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourcename(wctx->lex, par->filename);
+	if (result == ISC_R_SUCCESS)
+		result = isc_lex_setsourceline(wctx->lex, chunk->line);
+	if (result == ISC_R_SUCCESS)
+		result = load_text(wctx);
+
+	/*
+	 * What was parsed before an error still gets committed.
+	 */
+	if (chunk->batch != NULL) {
+		tresult = batch_push(chunk);
+		if (result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+
+	dns_loadctx_detach(&wctx);
+	return (result);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+parallel_worker(isc_threadarg_t arg) {
+	loadpar_t *par = arg;
+	loadchunk_t *chunk;
+	isc_result_t result;
+
+	for (;;) {
+		LOCK(&par->lock);
+		if (par->canceled || par->next == par->nchunks) {
+			UNLOCK(&par->lock);
+			break;
+		}
+		chunk = &par->chunks[par->next++];
+		UNLOCK(&par->lock);
+
+		result = parse_chunk(par, chunk);
+
+		LOCK(&par->lock);
+		chunk->result = result;
+		chunk->done = ISC_TRUE;
+		SIGNAL(&par->ready);
+		UNLOCK(&par->lock);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Return the end of the word starting at 'p'.
+ */
+static const char *
+scan_word(const char *p, const char *end) {
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' &&
+	       *p != '\n' && *p != ';' && *p != '(' && *p != ')' &&
+	       *p != '"')
+	{
+		if (*p == '\\' && p + 1 < end)
+			p++;
+		p++;
+	}
+	return (p);
+}
+
+static const char *
+scan_blanks(const char *p, const char *end) {
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return (p);
+}
+
+/*
+ * Interpret the directive at 'p' for parallel_scan().  Only $ORIGIN and
+ * $TTL can be tracked; files with other directives are loaded serially.
+ */
+static isc_boolean_t
+scan_directive(const char *p, const char *end, dns_name_t *origin,
+	       isc_uint32_t *ttlp, isc_boolean_t *ttl_knownp)
+{
+	const char *word, *arg;
+	isc_textregion_t tr;
+	isc_buffer_t buffer;
+	dns_fixedname_t fixed;
+	isc_result_t result;
+	char *base;
+
+	word = scan_word(p, end);
+	arg = scan_blanks(word, end);
+	DE_CONST(arg, base);
+	tr.base = base;
+	tr.length = scan_word(arg, end) - arg;
+	if (tr.length == 0)
+		return (ISC_FALSE);
+
+	if (word - p == 7 && strncasecmp(p, "$ORIGIN", 7) == 0) {
+		dns_fixedname_init(&fixed);
+		isc_buffer_init(&buffer, tr.base, tr.length);
+		isc_buffer_add(&buffer, tr.length);
+		result = dns_name_fromtext(dns_fixedname_name(&fixed),
+					   &buffer, origin, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (ISC_FALSE);
+		dns_name_copy(dns_fixedname_name(&fixed), origin, NULL);
+		return (ISC_TRUE);
+	}
+	if (word - p == 4 && strncasecmp(p, "$TTL", 4) == 0) {
+		if (dns_ttl_fromtext(&tr, ttlp) != ISC_R_SUCCESS)
+			return (ISC_FALSE);
+		if (*ttlp > 0x7fffffffUL)
+			*ttlp = 0;		/* See limit_ttl(). */
+		*ttl_knownp = ISC_TRUE;
+		return (ISC_TRUE);
+	}
+	return (ISC_FALSE);
+}
+
+/*
+ * Cut the file into chunks.  A chunk may only start on a line that
+ * begins with an owner name different from the previous one, outside
+ * parentheses, once the default TTL is known, so that a worker only
+ * needs the $ORIGIN and $TTL in effect to parse it.
+ */
+static isc_boolean_t
+parallel_scan(loadpar_t *par, unsigned int maxchunks) {
+	dns_loadctx_t *lctx = par->lctx;
+	const char *p, *end, *start, *owner = NULL;
+	size_t ownerlen = 0, chunksize;
+	unsigned long line = 1;
+	unsigned int depth = 0;
+	isc_boolean_t quote, comment;
+	isc_boolean_t ttl_known = lctx->default_ttl_known;
+	isc_uint32_t ttl = lctx->default_ttl;
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	loadchunk_t *chunk;
+
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	dns_name_copy(lctx->inc->origin, origin, NULL);
+
+	chunksize = ISC_MAX(par->size / maxchunks, PARALLEL_MINCHUNK);
+	start = p = par->base;
+	end = p + par->size;
+	par->nchunks = 0;
+
+	while (p < end) {
+		/*
+		 * At the start of a line.
+		 */
+		if (*p == '$') {
+			if (!scan_directive(p, end, origin, &ttl, &ttl_known))
+				return (ISC_FALSE);
+		} else if (*p != ' ' && *p != '\t' && *p != '\r' &&
+			   *p != '\n' && *p != ';') {
+			const char *word = scan_word(p, end);
+
+			if (ttl_known && (size_t)(p - start) >= chunksize &&
+			    par->nchunks + 1 < maxchunks &&
+			    ((size_t)(word - p) != ownerlen ||
+			     memcmp(p, owner, ownerlen) != 0))
+			{
+				chunk = &par->chunks[par->nchunks++];
+				chunk->length = p - start;
+				chunk = &par->chunks[par->nchunks];
+				chunk->base = start = p;
+				chunk->line = line;
+				chunk->ttl = ttl;
+				dns_name_copy(origin,
+					      dns_fixedname_name(&chunk->origin),
+					      NULL);
+			}
+			owner = p;
+			ownerlen = word - p;
+		}
+
+		/*
+		 * Find the end of the line, which may be continued by
+		 * parentheses.
+		 */
+		quote = comment = ISC_FALSE;
+		for (; p < end; p++) {
+			if (*p == '\n') {
+				line++;
+				quote = comment = ISC_FALSE;
+				if (depth == 0) {
+					p++;
+					break;
+				}
+			} else if (comment) {
+				continue;
+			} else if (*p == '\\') {
+				if (p + 1 < end && p[1] == '\n')
+					line++;
+				p++;
+			} else if (quote) {
+				if (*p == '"')
+					quote = ISC_FALSE;
+			} else if (*p == '"') {
+				quote = ISC_TRUE;
+			} else if (*p == ';') {
+				comment = ISC_TRUE;
+			} else if (*p == '(') {
+				depth++;
+			} else if (*p == ')' && depth > 0) {
+				depth--;
+			}
+		}
+	}
+	par->chunks[par->nchunks++].length = end - start;
+
+	return (ISC_TF(par->nchunks > 1));
+}
+
+/*
+ * Stop the workers, canceling the parse if 'cancel' is set, and wait
+ * for them to exit.
+ */
+static void
+parallel_stop(loadpar_t *par, isc_boolean_t cancel) {
+	unsigned int i;
+
+	if (par->running == 0)
+		return;
+
+	LOCK(&par->lock);
+	if (cancel)
+		par->canceled = ISC_TRUE;
+	BROADCAST(&par->space);
+	UNLOCK(&par->lock);
+
+	for (i = 0; i < par->running; i++)
+		(void)isc_thread_join(par->threads[i], NULL);
+	par->running = 0;
+}
+
+static void
+parallel_destroy(loadpar_t *par) {
+	isc_mem_t *mctx = par->lctx->mctx;
+	loadbatch_t *batch;
+	unsigned int i;
+
+	parallel_stop(par, ISC_TRUE);
+
+	if (par->chunks != NULL) {
+		for (i = 0; i < par->nchunks; i++) {
+			loadchunk_t *chunk = &par->chunks[i];
+
+			if (chunk->batch != NULL)
+				batch_destroy(mctx, &chunk->batch);
+			while ((batch = ISC_LIST_HEAD(chunk->batches)) != NULL) {
+				ISC_LIST_UNLINK(chunk->batches, batch, link);
+				batch_destroy(mctx, &batch);
+			}
+		}
+		isc_mem_put(mctx, par->chunks,
+			    par->nthreads * PARALLEL_CHUNKS *
+			    sizeof(*par->chunks));
+	}
+	if (par->threads != NULL)
+		isc_mem_put(mctx, par->threads,
+			    par->nthreads * sizeof(*par->threads));
+	if (par->base != NULL)
+		(void)isc_file_munmap(par->base, par->size);
+	if (par->filename != NULL)
+		isc_mem_free(mctx, par->filename);
+	(void)isc_condition_destroy(&par->space);
+	(void)isc_condition_destroy(&par->ready);
+	DESTROYLOCK(&par->lock);
+	isc_mem_put(mctx, par, sizeof(*par));
+}
+
+/*
+ * Set up a parallel load of 'master_file' if it is large enough and
+ * can be cut into chunks; '*usedp' tells whether it was.
+ */
+static isc_result_t
+parallel_create(dns_loadctx_t *lctx, const char *master_file,
+		isc_boolean_t *usedp)
+{
+	loadpar_t *par;
+	isc_result_t result;
+	unsigned int i, maxchunks;
+	FILE *f = NULL;
+	off_t size;
+
+	*usedp = ISC_FALSE;
+
+	/*
+	 * Leave errors opening the file to the serial loader.
+	 */
+	if (isc_stdio_open(master_file, "rb", &f) != ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+	result = isc_file_getsizefd(fileno(f), &size);
+	if (result != ISC_R_SUCCESS || size < PARALLEL_MINSIZE) {
+		(void)isc_stdio_close(f);
+		return (ISC_R_SUCCESS);
+	}
+
+	par = isc_mem_get(lctx->mctx, sizeof(*par));
+	if (par == NULL) {
+		(void)isc_stdio_close(f);
+		return (ISC_R_NOMEMORY);
+	}
+	memset(par, 0, sizeof(*par));
+	par->lctx = lctx;
+	par->nthreads = lctx->threads;
+	maxchunks = par->nthreads * PARALLEL_CHUNKS;
+	result = isc_mutex_init(&par->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(lctx->mctx, par, sizeof(*par));
+		(void)isc_stdio_close(f);
+		return (result);
+	}
+	(void)isc_condition_init(&par->ready);
+	(void)isc_condition_init(&par->space);
+
+	par->filename = isc_mem_strdup(lctx->mctx, master_file);
+	par->chunks = isc_mem_get(lctx->mctx,
+				  maxchunks * sizeof(*par->chunks));
+	par->threads = isc_mem_get(lctx->mctx,
+				   par->nthreads * sizeof(*par->threads));
+	if (par->filename == NULL || par->chunks == NULL ||
+	    par->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	for (i = 0; i < maxchunks; i++) {
+		loadchunk_t *chunk = &par->chunks[i];
+
+		chunk->par = par;
+		chunk->base = NULL;
+		chunk->length = 0;
+		chunk->line = 1;
+		dns_fixedname_init(&chunk->origin);
+		chunk->ttl = 0;
+		chunk->batch = NULL;
+		chunk->warned = 0;
+		ISC_LIST_INIT(chunk->batches);
+		chunk->pending = 0;
+		chunk->done = ISC_FALSE;
+		chunk->result = ISC_R_SUCCESS;
+	}
+
+	par->size = (size_t)size;
+	result = isc_file_mmap(fileno(f), par->size, &par->base);
+	if (result != ISC_R_SUCCESS) {
+		par->base = NULL;
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
+	par->chunks[0].base = par->base;
+	dns_name_copy(lctx->inc->origin,
+		      dns_fixedname_name(&par->chunks[0].origin), NULL);
+	if (!parallel_scan(par, maxchunks))
+		goto cleanup;
+
+	(void)isc_stdio_close(f);
+	lctx->par = par;
+	lctx->load = load_parallel;
+	*usedp = ISC_TRUE;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	(void)isc_stdio_close(f);
+	parallel_destroy(par);
+	return (result);
+}
+
+static isc_result_t
+commit_batch(dns_loadctx_t *lctx, loadbatch_t *batch) {
+	loadentry_t *entry;
+	rdatalist_head_t head;
+	unsigned char *p;
+	isc_result_t result;
+
+	for (p = batch->base; p < batch->base + batch->used; p += entry->size)
+	{
+		entry = (loadentry_t *)p;
+		ISC_LIST_INIT(head);
+		ISC_LIST_APPEND(head, &entry->rdatalist, link);
+		result = commit(lctx->callbacks, lctx, &head, &entry->owner,
+				lctx->par->filename,
+				(unsigned int)entry->line);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Give the once-only warnings noted by the worker of 'chunk' which no
+ * earlier chunk has given.
+ */
+static void
+warn_chunk(dns_loadctx_t *lctx, loadchunk_t *chunk) {
+	loadpar_t *par = lctx->par;
+	unsigned int which;
+
+	for (which = 0; which < WARN_MAX; which++) {
+		if ((chunk->warned & ~par->warned & (1U << which)) == 0)
+			continue;
+		par->warned |= (1U << which);
+		(*lctx->callbacks->warn)(lctx->callbacks, "%s:%lu: %s",
+					 par->filename,
+					 chunk->warnline[which],
+					 warn_once_text[which]);
+	}
+}
+
+/*
+ * Commit the batches of the workers in file order.
+ */
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	loadpar_t *par = lctx->par;
+	loadchunk_t *chunk;
+	loadbatch_t *batch;
+	unsigned int i, count = 0;
+	isc_result_t result;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	if (par->merging == 0 && par->running == 0) {
+		result = ISC_R_SUCCESS;
+		for (i = 0; i < par->nthreads && i < par->nchunks; i++) {
+			result = isc_thread_create(parallel_worker, par,
+						   &par->threads[i]);
+			if (result != ISC_R_SUCCESS)
+				break;
+			par->running++;
+		}
+		if (par->running == 0)
+			return (result);
+	}
+
+	while (par->merging < par->nchunks) {
+		chunk = &par->chunks[par->merging];
+
+		LOCK(&par->lock);
+		while (ISC_LIST_EMPTY(chunk->batches) && !chunk->done)
+			WAIT(&par->ready, &par->lock);
+		batch = ISC_LIST_HEAD(chunk->batches);
+		if (batch != NULL) {
+			ISC_LIST_UNLINK(chunk->batches, batch, link);
+			chunk->pending--;
+			BROADCAST(&par->space);
+		}
+		UNLOCK(&par->lock);
+
+		if (batch == NULL) {
+			warn_chunk(lctx, chunk);
+			result = chunk->result;
+			if (MANYERRS(lctx, result)) {
+				SETRESULT(lctx, result);
+			} else if (result != ISC_R_SUCCESS)
+				goto cancel;
+			par->merging++;
+			continue;
+		}
+
+		result = commit_batch(lctx, batch);
+		count += batch->count;
+		batch_destroy(lctx->mctx, &batch);
+		if (result != ISC_R_SUCCESS)
+			goto cancel;
+		if (lctx->loop_cnt != 0 && count >= lctx->loop_cnt)
+			return (DNS_R_CONTINUE);
+	}
+
+	parallel_stop(par, ISC_FALSE);
+	return (lctx->result);
+
+ cancel:
+	parallel_stop(par, ISC_TRUE);
+	return (result);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 isc_result_t
 dns_master_loadfile(const char *master_file, dns_name_t *top,
 		    dns_name_t *origin,
@@ -2473,15 +3353,30 @@ dns_master_loadfile3(const char *master_file, dns_name_t *top,
 		     unsigned int options, isc_uint32_t resign,
 		     dns_rdatacallbacks_t *callbacks, isc_mem_t *mctx,
 		     dns_masterformat_t format)
+{
+	return (dns_master_loadfile4(master_file, top, origin, zclass,
+				     options, resign, callbacks, mctx,
+				     format, 1));
+}
+
+isc_result_t
+dns_master_loadfile4(const char *master_file, dns_name_t *top,
+		     dns_name_t *origin, dns_rdataclass_t zclass,
+		     unsigned int options, isc_uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks, isc_mem_t *mctx,
+		     dns_masterformat_t format, unsigned int threads)
 {
 	dns_loadctx_t *lctx = NULL;
 	isc_result_t result;
 
+	REQUIRE(threads > 0);
+
 	result = loadctx_create(format, mctx, options, resign, top, zclass,
 				origin, callbacks, NULL, NULL, NULL, NULL,
 				&lctx);
 	if (result != ISC_R_SUCCESS)
 		return (result);
+	lctx->threads = threads;
 
 	result = (lctx->openfile)(lctx, master_file);
 	if (result != ISC_R_SUCCESS)
@@ -2529,18 +3424,35 @@ dns_master_loadfileinc3(const char *master_file, dns_name_t *top,
 			dns_loaddonefunc_t done, void *done_arg,
 			dns_loadctx_t **lctxp, isc_mem_t *mctx,
 			dns_masterformat_t format)
+{
+	return (dns_master_loadfileinc4(master_file, top, origin, zclass,
+					options, resign, callbacks, task,
+					done, done_arg, lctxp, mctx,
+					format, 1));
+}
+
+isc_result_t
+dns_master_loadfileinc4(const char *master_file, dns_name_t *top,
+			dns_name_t *origin, dns_rdataclass_t zclass,
+			unsigned int options, isc_uint32_t resign,
+			dns_rdatacallbacks_t *callbacks, isc_task_t *task,
+			dns_loaddonefunc_t done, void *done_arg,
+			dns_loadctx_t **lctxp, isc_mem_t *mctx,
+			dns_masterformat_t format, unsigned int threads)
 {
 	dns_loadctx_t *lctx = NULL;
 	isc_result_t result;
 
 	REQUIRE(task != NULL);
 	REQUIRE(done != NULL);
+	REQUIRE(threads > 0);
 
 	result = loadctx_create(format, mctx, options, resign, top, zclass,
 				origin, callbacks, task, done, done_arg, NULL,
 				&lctx);
 	if (result != ISC_R_SUCCESS)
 		return (result);
+	lctx->threads = threads;
 
 	result = (lctx->openfile)(lctx, master_file);
 	if (result != ISC_R_SUCCESS)
@@ -2899,6 +3811,21 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 
 	if (this == NULL)
 		return (ISC_R_SUCCESS);
+#ifdef ISC_PLATFORM_USETHREADS
+	if (lctx->chunk != NULL) {
+		/*
+		 * Parallel load worker: the loading thread commits.
+		 */
+		do {
+			result = batch_add(lctx->chunk, this, owner, line);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+			ISC_LIST_UNLINK(*head, this, link);
+			this = ISC_LIST_HEAD(*head);
+		} while (this != NULL);
+		return (ISC_R_SUCCESS);
+	}
+#endif
 	do {
 		dns_rdataset_init(&dataset);
 		RUNTIME_CHECK(dns_rdatalist_tordataset(this, &dataset)
@@ -2934,6 +3861,8 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 			SETRESULT(lctx, result);
 		else if (result != ISC_R_SUCCESS)
 			return (result);
+		if (result == ISC_R_SUCCESS)
+			callbacks->records += dns_rdataset_count(&dataset);
 		ISC_LIST_UNLINK(*head, this, link);
 		this = ISC_LIST_HEAD(*head);
 	} while (this != NULL);
@@ -21,8 +21,11 @@
 
 #include <config.h>
 
+#include <stdarg.h>
 #include <stdlib.h>
 
+#include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/event.h>
 #include <isc/file.h>
 #include <isc/magic.h>
@@ -31,6 +34,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -181,6 +185,10 @@ static char spaces[N_SPACES+1] = "          ";
 static char tabs[N_TABS+1] = "\t\t\t\t\t\t\t\t\t\t";
 
 #ifdef BIND9
+#ifdef ISC_PLATFORM_USETHREADS
+typedef struct dumppar dumppar_t;
+#endif
+
 struct dns_dumpctx {
 	unsigned int		magic;
 	isc_mem_t		*mctx;
@@ -191,6 +199,7 @@ struct dns_dumpctx {
 	isc_boolean_t		do_date;
 	isc_stdtime_t		now;
 	FILE			*f;
+	dns_dumpsink_t		sink;
 	dns_db_t		*db;
 	dns_dbversion_t		*version;
 	dns_dbiterator_t	*dbiter;
@@ -207,7 +216,13 @@ struct dns_dumpctx {
 	isc_result_t		(*dumpsets)(isc_mem_t *mctx, dns_name_t *name,
 					    dns_rdatasetiter_t *rdsiter,
 					    dns_totext_ctx_t *ctx,
-					    isc_buffer_t *buffer, FILE *f);
+					    isc_buffer_t *buffer,
+					    dns_dumpsink_t *sink);
+	/* Parallel dumping */
+	unsigned int		threads;
+#ifdef ISC_PLATFORM_USETHREADS
+	dumppar_t		*par;
+#endif
 };
 #endif /* BIND9 */
 
@@ -731,6 +746,70 @@ dns_master_questiontotext(dns_name_t *owner_name,
 }
 
 #ifdef BIND9
+/*
+ * Output sinks.
+ */
+static isc_result_t
+stream_write(void *arg, const unsigned char *base, unsigned int length) {
+	FILE *f = arg;
+
+	return (isc_stdio_write(base, 1, (size_t)length, f, NULL));
+}
+
+static isc_result_t
+buffer_write(void *arg, const unsigned char *base, unsigned int length) {
+	isc_buffer_t *target = arg;
+
+	if (isc_buffer_availablelength(target) < length)
+		return (ISC_R_NOSPACE);
+	isc_buffer_putmem(target, base, length);
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_dumpsink_initstream(dns_dumpsink_t *sink, FILE *f) {
+	REQUIRE(sink != NULL);
+	REQUIRE(f != NULL);
+
+	sink->write = stream_write;
+	sink->arg = f;
+}
+
+void
+dns_dumpsink_initbuffer(dns_dumpsink_t *sink, isc_buffer_t *target) {
+	REQUIRE(sink != NULL);
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	sink->write = buffer_write;
+	sink->arg = target;
+}
+
+static inline isc_result_t
+sink_write(dns_dumpsink_t *sink, const void *base, unsigned int length) {
+	return ((sink->write)(sink->arg, base, length));
+}
+
+/*
+ * Write a short formatted line, such as a directive or a comment.
+ */
+static isc_result_t
+sink_printf(dns_dumpsink_t *sink, const char *format, ...)
+     ISC_FORMAT_PRINTF(2, 3);
+
+static isc_result_t
+sink_printf(dns_dumpsink_t *sink, const char *format, ...) {
+	char buf[256];
+	va_list args;
+	int n;
+
+	va_start(args, format);
+	n = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	if (n < 0 || (unsigned int)n >= sizeof(buf))
+		return (ISC_R_NOSPACE);
+	return (sink_write(sink, buf, (unsigned int)n));
+}
+
 /*
  * Print an rdataset.  'buffer' is a scratch buffer, which must have been
  * dynamically allocated by the caller.  It must be large enough to
@@ -741,7 +820,7 @@ dns_master_questiontotext(dns_name_t *owner_name,
 static isc_result_t
 dump_rdataset(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 	      dns_totext_ctx_t *ctx,
-	      isc_buffer_t *buffer, FILE *f)
+	      isc_buffer_t *buffer, dns_dumpsink_t *sink)
 {
 	isc_region_t r;
 	isc_result_t result;
@@ -763,11 +842,16 @@ dump_rdataset(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 							ISC_TRUE, buffer);
 				INSIST(result == ISC_R_SUCCESS);
 				isc_buffer_usedregion(buffer, &r);
-				fprintf(f, "$TTL %u\t; %.*s\n", rdataset->ttl,
-					(int) r.length, (char *) r.base);
+				result = sink_printf(sink, "$TTL %u\t; %.*s\n",
+						     rdataset->ttl,
+						     (int) r.length,
+						     (char *) r.base);
 			} else {
-				fprintf(f, "$TTL %u\n", rdataset->ttl);
+				result = sink_printf(sink, "$TTL %u\n",
+						     rdataset->ttl);
 			}
+			if (result != ISC_R_SUCCESS)
+				return (result);
 			ctx->current_ttl = rdataset->ttl;
 			ctx->current_ttl_valid = ISC_TRUE;
 		}
@@ -801,7 +885,7 @@ dump_rdataset(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 	 * Write the buffer contents to the master file.
 	 */
 	isc_buffer_usedregion(buffer, &r);
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = sink_write(sink, r.base, r.length);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -868,7 +952,7 @@ dump_order_compare(const void *a, const void *b) {
 static isc_result_t
 dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
 		    dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
-		    isc_buffer_t *buffer, FILE *f)
+		    isc_buffer_t *buffer, dns_dumpsink_t *sink)
 {
 	isc_result_t itresult, dumpresult;
 	isc_region_t r;
@@ -884,7 +968,13 @@ dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
 		itresult = dns_name_totext(ctx->neworigin, ISC_FALSE, buffer);
 		RUNTIME_CHECK(itresult == ISC_R_SUCCESS);
 		isc_buffer_usedregion(buffer, &r);
-		fprintf(f, "$ORIGIN %.*s\n", (int) r.length, (char *) r.base);
+		dumpresult = sink_write(sink, "$ORIGIN ", 8);
+		if (dumpresult == ISC_R_SUCCESS)
+			dumpresult = sink_write(sink, r.base, r.length);
+		if (dumpresult == ISC_R_SUCCESS)
+			dumpresult = sink_write(sink, "\n", 1);
+		if (dumpresult != ISC_R_SUCCESS)
+			return (dumpresult);
 		ctx->neworigin = NULL;
 	}
 
@@ -903,15 +993,20 @@ dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
 
 	for (i = 0; i < n; i++) {
 		dns_rdataset_t *rds = sorted[i];
-		if (ctx->style.flags & DNS_STYLEFLAG_TRUST)
-			fprintf(f, "; %s\n", dns_trust_totext(rds->trust));
+		isc_result_t result;
+
+		if (ctx->style.flags & DNS_STYLEFLAG_TRUST) {
+			result = sink_printf(sink, "; %s\n",
+					     dns_trust_totext(rds->trust));
+			if (result != ISC_R_SUCCESS)
+				dumpresult = result;
+		}
 		if (((rds->attributes & DNS_RDATASETATTR_NEGATIVE) != 0) &&
 		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0) {
 			/* Omit negative cache entries */
 		} else {
-			isc_result_t result =
-				dump_rdataset(mctx, name, rds, ctx,
-					       buffer, f);
+			result = dump_rdataset(mctx, name, rds, ctx,
+					       buffer, sink);
 			if (result != ISC_R_SUCCESS)
 				dumpresult = result;
 			if ((ctx->style.flags & DNS_STYLEFLAG_OMIT_OWNER) != 0)
@@ -924,7 +1019,9 @@ dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
 			memset(buf, 0, sizeof(buf));
 			isc_buffer_init(&b, buf, sizeof(buf) - 1);
 			dns_time64_totext((isc_uint64_t)rds->resign, &b);
-			fprintf(f, "; resign=%s\n", buf);
+			result = sink_printf(sink, "; resign=%s\n", buf);
+			if (result != ISC_R_SUCCESS)
+				dumpresult = result;
 		}
 		dns_rdataset_disassociate(rds);
 	}
@@ -950,7 +1047,7 @@ dump_rdatasets_text(isc_mem_t *mctx, dns_name_t *name,
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
-		  isc_buffer_t *buffer, FILE *f)
+		  isc_buffer_t *buffer, dns_dumpsink_t *sink)
 {
 	isc_result_t result;
 	isc_uint32_t totallen;
@@ -1043,7 +1140,7 @@ dump_rdataset_raw(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 	/*
 	 * Write the buffer contents to the raw master file.
 	 */
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = sink_write(sink, r.base, r.length);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1058,7 +1155,7 @@ dump_rdataset_raw(isc_mem_t *mctx, dns_name_t *name, dns_rdataset_t *rdataset,
 static isc_result_t
 dump_rdatasets_raw(isc_mem_t *mctx, dns_name_t *name,
 		   dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
-		   isc_buffer_t *buffer, FILE *f)
+		   isc_buffer_t *buffer, dns_dumpsink_t *sink)
 {
 	isc_result_t result;
 	dns_rdataset_t rdataset;
@@ -1075,7 +1172,7 @@ dump_rdatasets_raw(isc_mem_t *mctx, dns_name_t *name,
 			/* Omit negative cache entries */
 		} else {
 			result = dump_rdataset_raw(mctx, name, &rdataset,
-						   buffer, f);
+						   buffer, sink);
 		}
 		dns_rdataset_disassociate(&rdataset);
 		if (result != ISC_R_SUCCESS)
@@ -1103,10 +1200,48 @@ static const int initial_buffer_length = 1200;
 static isc_result_t
 dumptostreaminc(dns_dumpctx_t *dctx);
 
+#ifdef ISC_PLATFORM_USETHREADS
+/*%
+ * Parallel dumping.  A zone database with at least PARALLEL_MINNODES
+ * nodes is cut at node boundaries into up to 'threads' *
+ * PARALLEL_CHUNKS ranges.  Worker threads format the ranges into
+ * blocks of PARALLEL_BLOCKSIZE bytes, and the dumping thread (or task)
+ * writes the blocks to the sink in name order.  A worker waits while
+ * PARALLEL_MAXPENDING blocks of its range are waiting to be written.
+ *
+ * The text format carries state from one node to the next: the last
+ * TTL, whether the class has been printed, and a pending $ORIGIN.  A
+ * worker does not know that state at the start of its range, but it
+ * no longer matters once a node has printed a record.  The worker
+ * therefore hands the nodes up to and including that one back to the
+ * dumping thread, which dumps them with the real state, and keeps its
+ * own output only from there on.  The result is identical to a serial
+ * dump.
+ */
+#define PARALLEL_MINNODES	4096
+#define PARALLEL_CHUNKS		4
+#define PARALLEL_BLOCKSIZE	(64 * 1024)
+#define PARALLEL_MAXPENDING	16
+
+static isc_result_t
+parallel_create(dns_dumpctx_t *dctx);
+
+static isc_result_t
+dump_parallel(dns_dumpctx_t *dctx, isc_buffer_t *buffer,
+	      unsigned int nodes);
+
+static void
+parallel_destroy(dumppar_t *par);
+#endif
+
 static void
 dumpctx_destroy(dns_dumpctx_t *dctx) {
 
 	dctx->magic = 0;
+#ifdef ISC_PLATFORM_USETHREADS
+	if (dctx->par != NULL)
+		parallel_destroy(dctx->par);
+#endif
 	DESTROYLOCK(&dctx->lock);
 	dns_dbiterator_destroy(&dctx->dbiter);
 	if (dctx->version != NULL)
@@ -1272,7 +1407,7 @@ dump_quantum(isc_task_t *task, isc_event_t *event) {
 					 dctx->tmpfile, dctx->file);
 		if (tresult != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
 			result = tresult;
-	} else
+	} else if (dctx->f != NULL)
 		result = flushandsync(dctx->f, result, NULL);
 	(dctx->done)(dctx->done_arg, result);
 	isc_event_free(&event);
@@ -1293,19 +1428,31 @@ task_send(dns_dumpctx_t *dctx) {
 
 static isc_result_t
 dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
-	       const dns_master_style_t *style, FILE *f, dns_dumpctx_t **dctxp,
-	       dns_masterformat_t format, dns_masterrawheader_t *header)
+	       const dns_master_style_t *style, FILE *f, dns_dumpsink_t *sink,
+	       dns_dumpctx_t **dctxp, dns_masterformat_t format,
+	       dns_masterrawheader_t *header, unsigned int threads)
 {
 	dns_dumpctx_t *dctx;
 	isc_result_t result;
 	unsigned int options;
 
+	REQUIRE(f != NULL || sink != NULL);
+	REQUIRE(threads > 0);
+
 	dctx = isc_mem_get(mctx, sizeof(*dctx));
 	if (dctx == NULL)
 		return (ISC_R_NOMEMORY);
 
 	dctx->mctx = NULL;
 	dctx->f = f;
+	if (sink != NULL)
+		dctx->sink = *sink;
+	else
+		dns_dumpsink_initstream(&dctx->sink, f);
+	dctx->threads = threads;
+#ifdef ISC_PLATFORM_USETHREADS
+	dctx->par = NULL;
+#endif
 	dctx->dbiter = NULL;
 	dctx->db = NULL;
 	dctx->version = NULL;
@@ -1330,6 +1477,10 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	case dns_masterformat_raw:
 		dctx->dumpsets = dump_rdatasets_raw;
 		break;
+	case dns_masterformat_map:
+		/* The database writes itself: see dumptostreaminc(). */
+		dctx->dumpsets = NULL;
+		break;
 	default:
 		INSIST(0);
 		break;
@@ -1379,6 +1530,752 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	return (result);
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+typedef struct dumpchunk dumpchunk_t;
+typedef struct dumpblock dumpblock_t;
+typedef struct dumplead dumplead_t;
+
+/*%
+ * A block of formatted output.
+ */
+struct dumpblock {
+	unsigned char		*base;
+	unsigned int		used;
+	unsigned int		nodes;
+	ISC_LINK(dumpblock_t)	link;
+};
+
+/*%
+ * A node at the start of a range that the dumping thread dumps itself.
+ */
+struct dumplead {
+	dns_dbnode_t		*node;
+	dns_fixedname_t		name;
+	dns_fixedname_t		origin;
+	isc_boolean_t		neworigin;
+	ISC_LINK(dumplead_t)	link;
+};
+
+struct dumpchunk {
+	/* The range runs from 'start' up to 'end' (NULL: to the end). */
+	dns_dbnode_t		*start;
+	dns_dbiterator_t	*dbiter;
+	isc_boolean_t		neworigin;
+	dns_dbnode_t		*end;
+	/* Filled in by the worker. */
+	dumppar_t		*par;
+	ISC_LIST(dumplead_t)	leads;
+	isc_boolean_t		leadsready;
+	isc_boolean_t		anchored;
+	dumpblock_t		*block;
+	unsigned int		nodes;
+	isc_boolean_t		pushed;
+	ISC_LIST(dumpblock_t)	blocks;
+	unsigned int		pending;
+	isc_boolean_t		done;
+	isc_result_t		result;
+	/* The text state at the end of the range, if 'anchored'. */
+	isc_uint32_t		ttl;
+	isc_boolean_t		ttl_valid;
+	dns_fixedname_t		origin;
+	isc_boolean_t		origin_pending;
+};
+
+struct dumppar {
+	dns_dumpctx_t		*dctx;
+	dumpchunk_t		*chunks;
+	unsigned int		nchunks;
+	unsigned int		maxchunks;
+	unsigned int		merging;
+	isc_thread_t		*threads;
+	unsigned int		nthreads;
+	unsigned int		running;
+	unsigned int		next;
+	isc_boolean_t		canceled;
+	isc_mutex_t		lock;
+	isc_condition_t		ready;
+	isc_condition_t		space;
+};
+
+static void
+block_destroy(isc_mem_t *mctx, dumpblock_t **blockp) {
+	dumpblock_t *block = *blockp;
+
+	*blockp = NULL;
+	isc_mem_put(mctx, block->base, PARALLEL_BLOCKSIZE);
+	isc_mem_put(mctx, block, sizeof(*block));
+}
+
+static isc_result_t
+block_create(isc_mem_t *mctx, dumpblock_t **blockp) {
+	dumpblock_t *block;
+
+	block = isc_mem_get(mctx, sizeof(*block));
+	if (block == NULL)
+		return (ISC_R_NOMEMORY);
+	block->base = isc_mem_get(mctx, PARALLEL_BLOCKSIZE);
+	if (block->base == NULL) {
+		isc_mem_put(mctx, block, sizeof(*block));
+		return (ISC_R_NOMEMORY);
+	}
+	block->used = 0;
+	block->nodes = 0;
+	ISC_LINK_INIT(block, link);
+	*blockp = block;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Hand the current block of 'chunk' to the dumping thread.
+ */
+static void
+block_push(dumpchunk_t *chunk) {
+	dumppar_t *par = chunk->par;
+
+	LOCK(&par->lock);
+	chunk->block->nodes = chunk->nodes;
+	chunk->nodes = 0;
+	ISC_LIST_APPEND(chunk->blocks, chunk->block, link);
+	chunk->pending++;
+	chunk->pushed = ISC_TRUE;
+	SIGNAL(&par->ready);
+	UNLOCK(&par->lock);
+	chunk->block = NULL;
+}
+
+static isc_result_t
+chunk_write(void *arg, const unsigned char *base, unsigned int length) {
+	dumpchunk_t *chunk = arg;
+	isc_mem_t *mctx = chunk->par->dctx->mctx;
+	isc_result_t result;
+	unsigned int n;
+
+	while (length > 0) {
+		if (chunk->block == NULL) {
+			result = block_create(mctx, &chunk->block);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
+		n = ISC_MIN(length, PARALLEL_BLOCKSIZE - chunk->block->used);
+		memmove(chunk->block->base + chunk->block->used, base, n);
+		chunk->block->used += n;
+		base += n;
+		length -= n;
+		if (chunk->block->used == PARALLEL_BLOCKSIZE)
+			block_push(chunk);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+discard_write(void *arg, const unsigned char *base, unsigned int length) {
+	UNUSED(arg);
+	UNUSED(base);
+	UNUSED(length);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Called by the worker between nodes: release the tree lock if output
+ * was handed over, and wait while too much of it is pending.
+ */
+static isc_result_t
+chunk_wait(dumpchunk_t *chunk, dns_dbiterator_t *dbiter) {
+	dumppar_t *par = chunk->par;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (!chunk->pushed)
+		return (ISC_R_SUCCESS);
+	chunk->pushed = ISC_FALSE;
+
+	RUNTIME_CHECK(dns_dbiterator_pause(dbiter) == ISC_R_SUCCESS);
+	LOCK(&par->lock);
+	while (chunk->pending >= PARALLEL_MAXPENDING && !par->canceled)
+		WAIT(&par->space, &par->lock);
+	if (par->canceled)
+		result = ISC_R_CANCELED;
+	UNLOCK(&par->lock);
+	return (result);
+}
+
+static void
+lead_destroy(dns_dumpctx_t *dctx, dumplead_t **leadp) {
+	dumplead_t *lead = *leadp;
+
+	*leadp = NULL;
+	dns_db_detachnode(dctx->db, &lead->node);
+	isc_mem_put(dctx->mctx, lead, sizeof(*lead));
+}
+
+static isc_result_t
+lead_create(dns_dumpctx_t *dctx, dns_dbnode_t *node, dns_name_t *name,
+	    dns_name_t *origin, isc_boolean_t neworigin, dumplead_t **leadp)
+{
+	dumplead_t *lead;
+
+	lead = isc_mem_get(dctx->mctx, sizeof(*lead));
+	if (lead == NULL)
+		return (ISC_R_NOMEMORY);
+	lead->node = NULL;
+	dns_db_attachnode(dctx->db, node, &lead->node);
+	dns_fixedname_init(&lead->name);
+	RUNTIME_CHECK(dns_name_copy(name, dns_fixedname_name(&lead->name),
+				    NULL) == ISC_R_SUCCESS);
+	dns_fixedname_init(&lead->origin);
+	RUNTIME_CHECK(dns_name_copy(origin, dns_fixedname_name(&lead->origin),
+				    NULL) == ISC_R_SUCCESS);
+	lead->neworigin = neworigin;
+	ISC_LINK_INIT(lead, link);
+	*leadp = lead;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Dump a lead node with the state of the serial dump.
+ */
+static isc_result_t
+dump_lead(dns_dumpctx_t *dctx, dumplead_t *lead, isc_buffer_t *buffer) {
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_name_t *origin;
+	isc_result_t result;
+
+	if (lead->neworigin) {
+		origin = dns_fixedname_name(&dctx->tctx.origin_fixname);
+		RUNTIME_CHECK(dns_name_copy(dns_fixedname_name(&lead->origin),
+					    origin, NULL) == ISC_R_SUCCESS);
+		if ((dctx->tctx.style.flags & DNS_STYLEFLAG_REL_DATA) != 0)
+			dctx->tctx.origin = origin;
+		dctx->tctx.neworigin = origin;
+	}
+	result = dns_db_allrdatasets(dctx->db, lead->node, dctx->version,
+				     dctx->now, &rdsiter);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = (dctx->dumpsets)(dctx->mctx, dns_fixedname_name(&lead->name),
+				  rdsiter, &dctx->tctx, buffer, &dctx->sink);
+	dns_rdatasetiter_destroy(&rdsiter);
+	return (result);
+}
+
+/*
+ * Format the range of 'chunk'.
+ */
+static isc_result_t
+dump_chunk(dumppar_t *par, dumpchunk_t *chunk) {
+	dns_dumpctx_t *dctx = par->dctx;
+	dns_dbiterator_t *dbiter = chunk->dbiter;
+	dns_totext_ctx_t tctx;
+	dns_dumpsink_t sink, discard;
+	dns_fixedname_t fixname;
+	dns_name_t *name, *origin;
+	dumplead_t *lead = NULL;
+	isc_buffer_t buffer;
+	char *bufmem;
+	isc_boolean_t first = ISC_TRUE, leading, neworigin;
+	isc_result_t result;
+
+	result = totext_ctx_init(&dctx->tctx.style, &tctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	bufmem = isc_mem_get(dctx->mctx, initial_buffer_length);
+	if (bufmem == NULL)
+		return (ISC_R_NOMEMORY);
+	isc_buffer_init(&buffer, bufmem, initial_buffer_length);
+
+	sink.write = chunk_write;
+	sink.arg = chunk;
+	discard.write = discard_write;
+	discard.arg = NULL;
+
+	dns_fixedname_init(&fixname);
+	name = dns_fixedname_name(&fixname);
+	origin = dns_fixedname_name(&tctx.origin_fixname);
+
+	/*
+	 * Only the text format carries state between nodes.
+	 */
+	leading = ISC_TF(dctx->format == dns_masterformat_text);
+	if (!leading) {
+		LOCK(&par->lock);
+		chunk->leadsready = ISC_TRUE;
+		UNLOCK(&par->lock);
+	}
+
+	/*
+	 * Names are only relative to an origin if the owner names are.
+	 */
+	if (dbiter->relative_names) {
+		result = dns_dbiterator_origin(dbiter, origin);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		if ((tctx.style.flags & DNS_STYLEFLAG_REL_DATA) != 0)
+			tctx.origin = origin;
+	}
+
+	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN)
+			break;
+		if (node == chunk->end) {
+			dns_db_detachnode(dctx->db, &node);
+			result = ISC_R_NOMORE;
+			break;
+		}
+
+		/*
+		 * A seek always reports a new origin; the serial
+		 * iterator's view of the first node was recorded.
+		 */
+		if (first)
+			neworigin = chunk->neworigin;
+		else
+			neworigin = ISC_TF(result == DNS_R_NEWORIGIN);
+		first = ISC_FALSE;
+		if (neworigin) {
+			result = dns_dbiterator_origin(dbiter, origin);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			tctx.neworigin = origin;
+		}
+
+		if (leading) {
+			result = lead_create(dctx, node, name, origin,
+					     neworigin, &lead);
+			if (result != ISC_R_SUCCESS) {
+				dns_db_detachnode(dctx->db, &node);
+				break;
+			}
+			ISC_LIST_APPEND(chunk->leads, lead, link);
+		}
+
+		result = dns_db_allrdatasets(dctx->db, node, dctx->version,
+					     dctx->now, &rdsiter);
+		if (result == ISC_R_SUCCESS) {
+			result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
+						  &tctx, &buffer,
+						  leading ? &discard : &sink);
+			dns_rdatasetiter_destroy(&rdsiter);
+		}
+		dns_db_detachnode(dctx->db, &node);
+		if (result != ISC_R_SUCCESS)
+			break;
+		chunk->nodes++;
+
+		/*
+		 * Once a record has been printed the state no longer
+		 * depends on what came before this range.
+		 */
+		if (leading && tctx.class_printed) {
+			leading = ISC_FALSE;
+			LOCK(&par->lock);
+			chunk->anchored = ISC_TRUE;
+			chunk->leadsready = ISC_TRUE;
+			SIGNAL(&par->ready);
+			UNLOCK(&par->lock);
+		}
+
+		result = chunk_wait(chunk, dbiter);
+		if (result == ISC_R_SUCCESS)
+			result = dns_dbiterator_next(dbiter);
+	}
+	if (result == ISC_R_NOMORE)
+		result = ISC_R_SUCCESS;
+
+	if (result == ISC_R_SUCCESS) {
+		chunk->ttl = tctx.current_ttl;
+		chunk->ttl_valid = tctx.current_ttl_valid;
+		RUNTIME_CHECK(dns_name_copy(origin,
+					    dns_fixedname_name(&chunk->origin),
+					    NULL) == ISC_R_SUCCESS);
+		chunk->origin_pending = ISC_TF(tctx.neworigin != NULL);
+		if (chunk->block != NULL)
+			block_push(chunk);
+	}
+
+ cleanup:
+	(void)dns_dbiterator_pause(dbiter);
+	if (chunk->block != NULL)
+		block_destroy(dctx->mctx, &chunk->block);
+	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
+	return (result);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+parallel_worker(isc_threadarg_t arg) {
+	dumppar_t *par = arg;
+	dumpchunk_t *chunk;
+	isc_result_t result;
+
+	for (;;) {
+		LOCK(&par->lock);
+		if (par->canceled || par->next == par->nchunks) {
+			UNLOCK(&par->lock);
+			break;
+		}
+		chunk = &par->chunks[par->next++];
+		UNLOCK(&par->lock);
+
+		result = dump_chunk(par, chunk);
+
+		LOCK(&par->lock);
+		chunk->result = result;
+		chunk->leadsready = ISC_TRUE;
+		chunk->done = ISC_TRUE;
+		SIGNAL(&par->ready);
+		UNLOCK(&par->lock);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+parallel_stop(dumppar_t *par, isc_boolean_t cancel) {
+	unsigned int i;
+
+	LOCK(&par->lock);
+	if (cancel)
+		par->canceled = ISC_TRUE;
+	BROADCAST(&par->space);
+	UNLOCK(&par->lock);
+
+	for (i = 0; i < par->running; i++)
+		(void)isc_thread_join(par->threads[i], NULL);
+	par->running = 0;
+}
+
+static void
+parallel_destroy(dumppar_t *par) {
+	dns_dumpctx_t *dctx = par->dctx;
+	isc_mem_t *mctx = dctx->mctx;
+	dumpchunk_t *chunk;
+	dumpblock_t *block;
+	dumplead_t *lead;
+	unsigned int i;
+
+	parallel_stop(par, ISC_TRUE);
+
+	for (i = 0; i < par->nchunks; i++) {
+		chunk = &par->chunks[i];
+		while ((block = ISC_LIST_HEAD(chunk->blocks)) != NULL) {
+			ISC_LIST_UNLINK(chunk->blocks, block, link);
+			block_destroy(mctx, &block);
+		}
+		while ((lead = ISC_LIST_HEAD(chunk->leads)) != NULL) {
+			ISC_LIST_UNLINK(chunk->leads, lead, link);
+			lead_destroy(dctx, &lead);
+		}
+		if (chunk->dbiter != NULL)
+			dns_dbiterator_destroy(&chunk->dbiter);
+		dns_db_detachnode(dctx->db, &chunk->start);
+	}
+	isc_mem_put(mctx, par->chunks, par->maxchunks * sizeof(dumpchunk_t));
+	isc_mem_put(mctx, par->threads, par->nthreads * sizeof(isc_thread_t));
+	(void)isc_condition_destroy(&par->space);
+	(void)isc_condition_destroy(&par->ready);
+	DESTROYLOCK(&par->lock);
+	isc_mem_put(mctx, par, sizeof(*par));
+}
+
+/*
+ * Choose the ranges with a walk over the names, and set up the
+ * workers if there is enough to share.  The start of each range is
+ * kept referenced, so it stays in the tree until the dump is over.
+ *
+ * Each range gets an iterator positioned here: seeking hashes the
+ * name, which is only done by the thread that set up the dump.
+ */
+static isc_result_t
+parallel_create(dns_dumpctx_t *dctx) {
+	dumppar_t *par;
+	dumpchunk_t *chunk;
+	dns_dbnode_t *node, *cnode;
+	dns_fixedname_t fixname, fixorigin, fixstart;
+	dns_name_t *name, *origin, *start;
+	unsigned int i, nodes, per, count, options = 0;
+	isc_boolean_t neworigin;
+	isc_result_t result;
+
+	if (dns_db_iscache(dctx->db))
+		return (ISC_R_SUCCESS);
+	nodes = dns_db_nodecount(dctx->db);
+	if (nodes < PARALLEL_MINNODES)
+		return (ISC_R_SUCCESS);
+
+	par = isc_mem_get(dctx->mctx, sizeof(*par));
+	if (par == NULL)
+		return (ISC_R_NOMEMORY);
+	par->dctx = dctx;
+	par->nchunks = 0;
+	par->maxchunks = dctx->threads * PARALLEL_CHUNKS;
+	par->merging = 0;
+	par->nthreads = dctx->threads;
+	par->running = 0;
+	par->next = 0;
+	par->canceled = ISC_FALSE;
+	par->chunks = NULL;
+	par->threads = NULL;
+
+	result = isc_mutex_init(&par->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(dctx->mctx, par, sizeof(*par));
+		return (result);
+	}
+	result = isc_condition_init(&par->ready);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+	result = isc_condition_init(&par->space);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_ready;
+
+	par->chunks = isc_mem_get(dctx->mctx,
+				  par->maxchunks * sizeof(dumpchunk_t));
+	par->threads = isc_mem_get(dctx->mctx,
+				   par->nthreads * sizeof(isc_thread_t));
+	if (par->chunks == NULL || par->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_mem;
+	}
+	for (i = 0; i < par->maxchunks; i++) {
+		chunk = &par->chunks[i];
+		chunk->start = NULL;
+		chunk->dbiter = NULL;
+		chunk->neworigin = ISC_FALSE;
+		chunk->end = NULL;
+		chunk->par = par;
+		ISC_LIST_INIT(chunk->leads);
+		chunk->leadsready = ISC_FALSE;
+		chunk->anchored = ISC_FALSE;
+		chunk->block = NULL;
+		chunk->nodes = 0;
+		chunk->pushed = ISC_FALSE;
+		ISC_LIST_INIT(chunk->blocks);
+		chunk->pending = 0;
+		chunk->done = ISC_FALSE;
+		chunk->result = ISC_R_SUCCESS;
+		chunk->ttl = 0;
+		chunk->ttl_valid = ISC_FALSE;
+		dns_fixedname_init(&chunk->origin);
+		chunk->origin_pending = ISC_FALSE;
+	}
+
+	if (dctx->dbiter->relative_names)
+		options |= DNS_DB_RELATIVENAMES;
+	dns_fixedname_init(&fixname);
+	name = dns_fixedname_name(&fixname);
+	dns_fixedname_init(&fixorigin);
+	origin = dns_fixedname_name(&fixorigin);
+	dns_fixedname_init(&fixstart);
+	start = dns_fixedname_name(&fixstart);
+
+	per = ISC_MAX(nodes / par->maxchunks,
+		      PARALLEL_MINNODES / PARALLEL_CHUNKS);
+	count = 0;
+	result = dns_dbiterator_first(dctx->dbiter);
+	while (result == ISC_R_SUCCESS) {
+		if (par->nchunks < par->maxchunks &&
+		    count >= par->nchunks * per)
+		{
+			node = NULL;
+			result = dns_dbiterator_current(dctx->dbiter, &node,
+							name);
+			if (result != ISC_R_SUCCESS &&
+			    result != DNS_R_NEWORIGIN)
+				break;
+			neworigin = ISC_TF(result == DNS_R_NEWORIGIN);
+
+			chunk = &par->chunks[par->nchunks];
+			if (dns_name_isabsolute(name))
+				result = dns_name_copy(name, start, NULL);
+			else {
+				result = dns_dbiterator_origin(dctx->dbiter,
+							       origin);
+				if (result == ISC_R_SUCCESS)
+					result = dns_name_concatenate(name,
+								      origin,
+								      start,
+								      NULL);
+			}
+
+			/*
+			 * Only use names that seek back to this node.
+			 */
+			cnode = NULL;
+			if (result == ISC_R_SUCCESS)
+				result = dns_db_createiterator(dctx->db,
+							       options,
+							       &chunk->dbiter);
+			if (result == ISC_R_SUCCESS)
+				result = dns_dbiterator_seek(chunk->dbiter,
+							     start);
+			if (result == ISC_R_SUCCESS)
+				result = dns_dbiterator_current(chunk->dbiter,
+								&cnode, NULL);
+			if (chunk->dbiter != NULL)
+				(void)dns_dbiterator_pause(chunk->dbiter);
+			if (result == ISC_R_SUCCESS && cnode == node) {
+				chunk->start = node;
+				chunk->neworigin = neworigin;
+				if (par->nchunks > 0)
+					par->chunks[par->nchunks - 1].end =
+						node;
+				par->nchunks++;
+			} else {
+				dns_db_detachnode(dctx->db, &node);
+				if (chunk->dbiter != NULL)
+					dns_dbiterator_destroy(&chunk->dbiter);
+			}
+			if (cnode != NULL)
+				dns_db_detachnode(dctx->db, &cnode);
+			result = ISC_R_SUCCESS;
+		}
+		if (++count % 1024 == 0)
+			RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) ==
+				      ISC_R_SUCCESS);
+		result = dns_dbiterator_next(dctx->dbiter);
+	}
+	(void)dns_dbiterator_pause(dctx->dbiter);
+	if (result != ISC_R_NOMORE)
+		goto cleanup;
+
+	if (par->nchunks < 2) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+	dctx->par = par;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	/* parallel_destroy() releases the chunks and the rest. */
+	parallel_destroy(par);
+	return (result);
+
+ cleanup_mem:
+	if (par->chunks != NULL)
+		isc_mem_put(dctx->mctx, par->chunks,
+			    par->maxchunks * sizeof(dumpchunk_t));
+	if (par->threads != NULL)
+		isc_mem_put(dctx->mctx, par->threads,
+			    par->nthreads * sizeof(isc_thread_t));
+	(void)isc_condition_destroy(&par->space);
+ cleanup_ready:
+	(void)isc_condition_destroy(&par->ready);
+ cleanup_lock:
+	DESTROYLOCK(&par->lock);
+	isc_mem_put(dctx->mctx, par, sizeof(*par));
+	return (result);
+}
+
+/*
+ * Write the workers' output to the sink in name order, dumping the
+ * lead nodes of each range first.  Returns ISC_R_SUCCESS when 'nodes'
+ * (if not zero) nodes have been written and there is more to do, and
+ * ISC_R_NOMORE when the dump is complete.
+ */
+static isc_result_t
+dump_parallel(dns_dumpctx_t *dctx, isc_buffer_t *buffer,
+	      unsigned int nodes)
+{
+	dumppar_t *par = dctx->par;
+	dumpchunk_t *chunk;
+	dumpblock_t *block;
+	dumplead_t *lead;
+	dns_name_t *origin;
+	unsigned int i, count = 0;
+	isc_result_t result;
+
+	if (par->merging == 0 && par->running == 0 && par->next == 0) {
+		result = ISC_R_SUCCESS;
+		for (i = 0; i < par->nthreads && i < par->nchunks; i++) {
+			result = isc_thread_create(parallel_worker, par,
+						   &par->threads[i]);
+			if (result != ISC_R_SUCCESS)
+				break;
+			par->running++;
+		}
+		if (par->running == 0)
+			return (result);
+	}
+
+	while (par->merging < par->nchunks) {
+		if (nodes != 0 && count >= nodes)
+			return (ISC_R_SUCCESS);
+		chunk = &par->chunks[par->merging];
+
+		LOCK(&par->lock);
+		while (!chunk->leadsready)
+			WAIT(&par->ready, &par->lock);
+		UNLOCK(&par->lock);
+
+		lead = ISC_LIST_HEAD(chunk->leads);
+		if (lead != NULL) {
+			ISC_LIST_UNLINK(chunk->leads, lead, link);
+			result = dump_lead(dctx, lead, buffer);
+			lead_destroy(dctx, &lead);
+			if (result != ISC_R_SUCCESS)
+				goto cancel;
+			count++;
+			continue;
+		}
+
+		LOCK(&par->lock);
+		while (ISC_LIST_EMPTY(chunk->blocks) && !chunk->done)
+			WAIT(&par->ready, &par->lock);
+		block = ISC_LIST_HEAD(chunk->blocks);
+		if (block != NULL) {
+			ISC_LIST_UNLINK(chunk->blocks, block, link);
+			chunk->pending--;
+			BROADCAST(&par->space);
+		}
+		UNLOCK(&par->lock);
+
+		if (block == NULL) {
+			result = chunk->result;
+			if (result != ISC_R_SUCCESS)
+				goto cancel;
+			if (chunk->anchored) {
+				origin = dns_fixedname_name(
+						&dctx->tctx.origin_fixname);
+				RUNTIME_CHECK(dns_name_copy(
+					dns_fixedname_name(&chunk->origin),
+					origin, NULL) == ISC_R_SUCCESS);
+				dctx->tctx.class_printed = ISC_TRUE;
+				dctx->tctx.current_ttl = chunk->ttl;
+				dctx->tctx.current_ttl_valid = chunk->ttl_valid;
+				dctx->tctx.neworigin =
+					chunk->origin_pending ? origin : NULL;
+			}
+			if (chunk->dbiter != NULL)
+				dns_dbiterator_destroy(&chunk->dbiter);
+			par->merging++;
+			continue;
+		}
+
+		result = sink_write(&dctx->sink, block->base, block->used);
+		count += block->nodes;
+		block_destroy(dctx->mctx, &block);
+		if (result != ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "master file write failed: %s",
+					 isc_result_totext(result));
+			goto cancel;
+		}
+	}
+
+	parallel_stop(par, ISC_FALSE);
+	return (ISC_R_NOMORE);
+
+ cancel:
+	parallel_stop(par, ISC_TRUE);
+	return (result);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 static isc_result_t
 dumptostreaminc(dns_dumpctx_t *dctx) {
 	isc_result_t result;
@@ -1416,11 +2313,17 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 				result = dns_time32_totext(dctx->now, &buffer);
 				RUNTIME_CHECK(result == ISC_R_SUCCESS);
 				isc_buffer_usedregion(&buffer, &r);
-				fprintf(dctx->f, "$DATE %.*s\n",
-					(int) r.length, (char *) r.base);
+				result = sink_printf(&dctx->sink,
+						     "$DATE %.*s\n",
+						     (int) r.length,
+						     (char *) r.base);
+				if (result != ISC_R_SUCCESS)
+					goto fail;
+				isc_buffer_clear(&buffer);
 			}
 			break;
 		case dns_masterformat_raw:
+		case dns_masterformat_map:
 			r.base = (unsigned char *)&rawheader;
 			r.length = sizeof(rawheader);
 			isc_buffer_region(&buffer, &r);
@@ -1443,9 +2346,10 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			now32 = dctx->now;
 #endif
 			rawversion = 1;
-			if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
+			if (dctx->format == dns_masterformat_raw &&
+			    (dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
 				rawversion = 0;
-			isc_buffer_putuint32(&buffer, dns_masterformat_raw);
+			isc_buffer_putuint32(&buffer, dctx->format);
 			isc_buffer_putuint32(&buffer, rawversion);
 			isc_buffer_putuint32(&buffer, now32);
 
@@ -1460,24 +2364,50 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 
 			INSIST(isc_buffer_usedlength(&buffer) <=
 			       sizeof(rawheader));
-			result = isc_stdio_write(buffer.base, 1,
-						 isc_buffer_usedlength(&buffer),
-						 dctx->f, NULL);
+			result = sink_write(&dctx->sink, buffer.base,
+					    isc_buffer_usedlength(&buffer));
 			if (result != ISC_R_SUCCESS)
-				return (result);
+				goto fail;
 			isc_buffer_clear(&buffer);
 			break;
 		default:
 			INSIST(0);
 		}
 
-		result = dns_dbiterator_first(dctx->dbiter);
 		dctx->first = ISC_FALSE;
+
+		/*
+		 * A map file is written in a single step after the header.
+		 */
+		if (dctx->format == dns_masterformat_map) {
+			if (dctx->f == NULL) {
+				result = ISC_R_NOTIMPLEMENTED;
+				goto fail;
+			}
+			result = dns_db_serialize(dctx->db, dctx->version,
+						  dctx->f);
+			goto fail;
+		}
+
+#ifdef ISC_PLATFORM_USETHREADS
+		if (dctx->threads > 1) {
+			result = parallel_create(dctx);
+			if (result != ISC_R_SUCCESS)
+				goto fail;
+		}
+		if (dctx->par == NULL)
+#endif
+			result = dns_dbiterator_first(dctx->dbiter);
 	} else
 		result = ISC_R_SUCCESS;
 
 	nodes = dctx->nodes;
 	isc_time_now(&start);
+#ifdef ISC_PLATFORM_USETHREADS
+	if (dctx->par != NULL)
+		result = dump_parallel(dctx, &buffer, nodes);
+	else
+#endif
 	while (result == ISC_R_SUCCESS && (dctx->nodes == 0 || nodes--)) {
 		dns_rdatasetiter_t *rdsiter = NULL;
 		dns_dbnode_t *node = NULL;
@@ -1501,7 +2431,7 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			goto fail;
 		}
 		result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
-					  &dctx->tctx, &buffer, dctx->f);
+					  &dctx->tctx, &buffer, &dctx->sink);
 		dns_rdatasetiter_destroy(&rdsiter);
 		if (result != ISC_R_SUCCESS) {
 			dns_db_detachnode(dctx->db, &node);
@@ -1575,8 +2505,8 @@ dns_master_dumptostreaminc(isc_mem_t *mctx, dns_db_t *db,
 	REQUIRE(f != NULL);
 	REQUIRE(done != NULL);
 
-	result = dumpctx_create(mctx, db, version, style, f, &dctx,
-				dns_masterformat_text, NULL);
+	result = dumpctx_create(mctx, db, version, style, f, NULL, &dctx,
+				dns_masterformat_text, NULL, 1);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	isc_task_attach(task, &dctx->task);
@@ -1627,8 +2557,8 @@ dns_master_dumptostream3(isc_mem_t *mctx, dns_db_t *db,
 	dns_dumpctx_t *dctx = NULL;
 	isc_result_t result;
 
-	result = dumpctx_create(mctx, db, version, style, f, &dctx,
-				format, header);
+	result = dumpctx_create(mctx, db, version, style, f, NULL, &dctx,
+				format, header, 1);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
@@ -1640,6 +2570,31 @@ dns_master_dumptostream3(isc_mem_t *mctx, dns_db_t *db,
 	return (result);
 }
 
+isc_result_t
+dns_master_dumptosink(isc_mem_t *mctx, dns_db_t *db,
+		      dns_dbversion_t *version,
+		      const dns_master_style_t *style,
+		      dns_masterformat_t format,
+		      dns_masterrawheader_t *header, unsigned int threads,
+		      dns_dumpsink_t *sink)
+{
+	dns_dumpctx_t *dctx = NULL;
+	isc_result_t result;
+
+	REQUIRE(sink != NULL && sink->write != NULL);
+
+	result = dumpctx_create(mctx, db, version, style, NULL, sink, &dctx,
+				format, header, threads);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dumptostreaminc(dctx);
+	INSIST(result != DNS_R_CONTINUE);
+	dns_dumpctx_detach(&dctx);
+
+	return (result);
+}
+
 static isc_result_t
 opentmp(isc_mem_t *mctx, dns_masterformat_t format, const char *file,
 	char **tempp, FILE **fp) {
@@ -1704,6 +2659,18 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		    isc_task_t *task, dns_dumpdonefunc_t done, void *done_arg,
 		    dns_dumpctx_t **dctxp, dns_masterformat_t format,
 		    dns_masterrawheader_t *header)
+{
+	return (dns_master_dumpinc4(mctx, db, version, style, filename, task,
+				    done, done_arg, dctxp, format, header,
+				    1));
+}
+
+isc_result_t
+dns_master_dumpinc4(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
+		    const dns_master_style_t *style, const char *filename,
+		    isc_task_t *task, dns_dumpdonefunc_t done, void *done_arg,
+		    dns_dumpctx_t **dctxp, dns_masterformat_t format,
+		    dns_masterrawheader_t *header, unsigned int threads)
 {
 	FILE *f = NULL;
 	isc_result_t result;
@@ -1719,8 +2686,8 @@ dns_master_dumpinc3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
-	result = dumpctx_create(mctx, db, version, style, f, &dctx,
-				format, header);
+	result = dumpctx_create(mctx, db, version, style, f, NULL, &dctx,
+				format, header, threads);
 	if (result != ISC_R_SUCCESS) {
 		(void)isc_stdio_close(f);
 		(void)isc_file_remove(tempname);
@@ -1773,6 +2740,16 @@ isc_result_t
 dns_master_dump3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		 const dns_master_style_t *style, const char *filename,
 		 dns_masterformat_t format, dns_masterrawheader_t *header)
+{
+	return (dns_master_dump4(mctx, db, version, style, filename,
+				 format, header, 1));
+}
+
+isc_result_t
+dns_master_dump4(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
+		 const dns_master_style_t *style, const char *filename,
+		 dns_masterformat_t format, dns_masterrawheader_t *header,
+		 unsigned int threads)
 {
 	FILE *f = NULL;
 	isc_result_t result;
@@ -1783,8 +2760,8 @@ dns_master_dump3(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
-	result = dumpctx_create(mctx, db, version, style, f, &dctx,
-				format, header);
+	result = dumpctx_create(mctx, db, version, style, f, NULL, &dctx,
+				format, header, threads);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
@@ -1816,6 +2793,7 @@ dns_master_dumpnodetostream(isc_mem_t *mctx, dns_db_t *db,
 	isc_stdtime_t now;
 	dns_totext_ctx_t ctx;
 	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_dumpsink_t sink;
 
 	result = totext_ctx_init(style, &ctx);
 	if (result != ISC_R_SUCCESS) {
@@ -1835,7 +2813,9 @@ dns_master_dumpnodetostream(isc_mem_t *mctx, dns_db_t *db,
 	result = dns_db_allrdatasets(db, node, version, now, &rdsiter);
 	if (result != ISC_R_SUCCESS)
 		goto failure;
-	result = dump_rdatasets_text(mctx, name, rdsiter, &ctx, &buffer, f);
+	dns_dumpsink_initstream(&sink, f);
+	result = dump_rdatasets_text(mctx, name, rdsiter, &ctx, &buffer,
+				     &sink);
 	if (result != ISC_R_SUCCESS)
 		goto failure;
 	dns_rdatasetiter_destroy(&rdsiter);
@@ -105,6 +105,8 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define OFFSET_COUNT		  4
 #define RDATA_COUNT		  8
 #define RDATALIST_COUNT		  8
+#define ARENA_NAME_COUNT	 16
+#define ARENA_RDATASET_COUNT	 16
 #define RDATASET_COUNT		 RDATALIST_COUNT
 
 /*%
@@ -371,6 +373,107 @@ newoffsets(dns_message_t *msg) {
 	return (offsets);
 }
 
+/*
+ * In arena mode names and rdatasets are carved out of message blocks
+ * instead of being taken from the memory pools.  Released ones go on a
+ * free list for reuse, and everything is reclaimed at once when the
+ * message is reset.  The first block of each kind survives the reset,
+ * so a reused message normally needs no allocations at all.
+ */
+static inline dns_name_t *
+newname(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_name_t *name;
+
+	if (!msg->arena)
+		return (isc_mempool_get(msg->namepool));
+
+	name = ISC_LIST_HEAD(msg->freename);
+	if (name != NULL) {
+		ISC_LIST_UNLINK(msg->freename, name, link);
+		msg->arenasaved++;
+	} else {
+		msgblock = ISC_LIST_TAIL(msg->names);
+		name = msgblock_get(msgblock, dns_name_t);
+		if (name != NULL)
+			msg->arenasaved++;
+		else {
+			msgblock = msgblock_allocate(msg->mctx,
+						     sizeof(dns_name_t),
+						     ARENA_NAME_COUNT);
+			if (msgblock == NULL)
+				return (NULL);
+
+			ISC_LIST_APPEND(msg->names, msgblock, link);
+
+			name = msgblock_get(msgblock, dns_name_t);
+		}
+	}
+
+	msg->arenainuse++;
+	return (name);
+}
+
+static inline void
+releasename(dns_message_t *msg, dns_name_t *name) {
+	if (!msg->arena) {
+		isc_mempool_put(msg->namepool, name);
+		return;
+	}
+
+	INSIST(msg->arenainuse > 0);
+	msg->arenainuse--;
+	ISC_LINK_INIT(name, link);
+	ISC_LIST_PREPEND(msg->freename, name, link);
+}
+
+static inline dns_rdataset_t *
+newrdataset(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_rdataset_t *rdataset;
+
+	if (!msg->arena)
+		return (isc_mempool_get(msg->rdspool));
+
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	if (rdataset != NULL) {
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+		msg->arenasaved++;
+	} else {
+		msgblock = ISC_LIST_TAIL(msg->rdatasets);
+		rdataset = msgblock_get(msgblock, dns_rdataset_t);
+		if (rdataset != NULL)
+			msg->arenasaved++;
+		else {
+			msgblock = msgblock_allocate(msg->mctx,
+						     sizeof(dns_rdataset_t),
+						     ARENA_RDATASET_COUNT);
+			if (msgblock == NULL)
+				return (NULL);
+
+			ISC_LIST_APPEND(msg->rdatasets, msgblock, link);
+
+			rdataset = msgblock_get(msgblock, dns_rdataset_t);
+		}
+	}
+
+	msg->arenainuse++;
+	return (rdataset);
+}
+
+static inline void
+releaserdataset(dns_message_t *msg, dns_rdataset_t *rdataset) {
+	if (!msg->arena) {
+		isc_mempool_put(msg->rdspool, rdataset);
+		return;
+	}
+
+	INSIST(msg->arenainuse > 0);
+	msg->arenainuse--;
+	ISC_LINK_INIT(rdataset, link);
+	ISC_LIST_PREPEND(msg->freerdataset, rdataset, link);
+}
+
 static inline void
 msginitheader(dns_message_t *m) {
 	m->id = 0;
@@ -398,6 +501,8 @@ msginitprivate(dns_message_t *m) {
 	m->sig_reserved = 0;
 	m->reserved = 0;
 	m->buffer = NULL;
+	m->lazy = 0;
+	m->lazyresult = ISC_R_SUCCESS;
 }
 
 static inline void
@@ -459,12 +564,12 @@ msgresetnames(dns_message_t *msg, unsigned int first_section) {
 
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				releaserdataset(msg, rds);
 				rds = next_rds;
 			}
 			if (dns_name_dynamic(name))
 				dns_name_free(name, msg->mctx);
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = next_name;
 		}
 	}
@@ -480,7 +585,7 @@ msgresetopt(dns_message_t *msg)
 		}
 		INSIST(dns_rdataset_isassociated(msg->opt));
 		dns_rdataset_disassociate(msg->opt);
-		isc_mempool_put(msg->rdspool, msg->opt);
+		releaserdataset(msg, msg->opt);
 		msg->opt = NULL;
 	}
 }
@@ -499,30 +604,30 @@ msgresetsigs(dns_message_t *msg, isc_boolean_t replying) {
 			msg->querytsig = msg->tsig;
 		} else {
 			dns_rdataset_disassociate(msg->tsig);
-			isc_mempool_put(msg->rdspool, msg->tsig);
+			releaserdataset(msg, msg->tsig);
 			if (msg->querytsig != NULL) {
 				dns_rdataset_disassociate(msg->querytsig);
-				isc_mempool_put(msg->rdspool, msg->querytsig);
+				releaserdataset(msg, msg->querytsig);
 			}
 		}
 		if (dns_name_dynamic(msg->tsigname))
 			dns_name_free(msg->tsigname, msg->mctx);
-		isc_mempool_put(msg->namepool, msg->tsigname);
+		releasename(msg, msg->tsigname);
 		msg->tsig = NULL;
 		msg->tsigname = NULL;
 	} else if (msg->querytsig != NULL && !replying) {
 		dns_rdataset_disassociate(msg->querytsig);
-		isc_mempool_put(msg->rdspool, msg->querytsig);
+		releaserdataset(msg, msg->querytsig);
 		msg->querytsig = NULL;
 	}
 	if (msg->sig0 != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->sig0));
 		dns_rdataset_disassociate(msg->sig0);
-		isc_mempool_put(msg->rdspool, msg->sig0);
+		releaserdataset(msg, msg->sig0);
 		if (msg->sig0name != NULL) {
 			if (dns_name_dynamic(msg->sig0name))
 				dns_name_free(msg->sig0name, msg->mctx);
-			isc_mempool_put(msg->namepool, msg->sig0name);
+			releasename(msg, msg->sig0name);
 		}
 		msg->sig0 = NULL;
 		msg->sig0name = NULL;
@@ -563,6 +668,8 @@ msgreset(dns_message_t *msg, isc_boolean_t everything) {
 		ISC_LIST_UNLINK(msg->freerdatalist, rdatalist, link);
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
+	ISC_LIST_INIT(msg->freename);
+	ISC_LIST_INIT(msg->freerdataset);
 
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
@@ -617,6 +724,30 @@ msgreset(dns_message_t *msg, isc_boolean_t everything) {
 		msgblock = next_msgblock;
 	}
 
+	msgblock = ISC_LIST_HEAD(msg->names);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->names, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_name_t));
+		msgblock = next_msgblock;
+	}
+
+	msgblock = ISC_LIST_HEAD(msg->rdatasets);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->rdatasets, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdataset_t));
+		msgblock = next_msgblock;
+	}
+
 	if (msg->tsigkey != NULL) {
 		dns_tsigkey_detach(&msg->tsigkey);
 		msg->tsigkey = NULL;
@@ -660,6 +791,8 @@ msgreset(dns_message_t *msg, isc_boolean_t everything) {
 
 	ENSURE(isc_mempool_getallocated(msg->namepool) == 0);
 	ENSURE(isc_mempool_getallocated(msg->rdspool) == 0);
+	ENSURE(msg->arenainuse == 0);
+	msg->arenasaved = 0;
 }
 
 static unsigned int
@@ -743,6 +876,13 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 	ISC_LIST_INIT(m->offsets);
 	ISC_LIST_INIT(m->freerdata);
 	ISC_LIST_INIT(m->freerdatalist);
+	m->arena = 0;
+	ISC_LIST_INIT(m->names);
+	ISC_LIST_INIT(m->rdatasets);
+	ISC_LIST_INIT(m->freename);
+	ISC_LIST_INIT(m->freerdataset);
+	m->arenainuse = 0;
+	m->arenasaved = 0;
 
 	/*
 	 * Ok, it is safe to allocate (and then "goto cleanup" if failure)
@@ -818,6 +958,23 @@ dns_message_destroy(dns_message_t **msgp) {
 	isc_mem_putanddetach(&msg->mctx, msg, sizeof(dns_message_t));
 }
 
+void
+dns_message_setarena(dns_message_t *msg, isc_boolean_t arena) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(isc_mempool_getallocated(msg->namepool) == 0);
+	REQUIRE(isc_mempool_getallocated(msg->rdspool) == 0);
+	REQUIRE(msg->arenainuse == 0);
+
+	msg->arena = arena ? 1 : 0;
+}
+
+unsigned int
+dns_message_arenasaved(dns_message_t *msg) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+
+	return (msg->arenasaved);
+}
+
 static isc_result_t
 findname(dns_name_t **foundname, dns_name_t *target,
 	 dns_namelist_t *section)
@@ -926,6 +1083,80 @@ getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
 	return (ISC_R_UNEXPECTED);
 }
 
+/*
+ * Make 'name' refer to the name at the current position of 'source'
+ * rather than copying it.  If the name is compressed or not valid,
+ * return ISC_R_NOTFOUND and leave it to getname().
+ */
+static isc_result_t
+refname(dns_name_t *name, isc_buffer_t *source) {
+	isc_region_t r;
+	unsigned int length, c;
+
+	isc_buffer_remainingregion(source, &r);
+	length = 0;
+	do {
+		if (length >= r.length)
+			return (ISC_R_NOTFOUND);
+		c = r.base[length];
+		if (c >= 64)
+			return (ISC_R_NOTFOUND);
+		length += c + 1;
+	} while (c != 0);
+	if (length > DNS_NAME_MAXWIRE)
+		return (ISC_R_NOTFOUND);
+
+	r.length = length;
+	dns_name_fromregion(name, &r);
+	isc_buffer_forward(source, length);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Skip the record at the current position of 'source', checking only
+ * that it is complete, and set '*metap' if it is an OPT, TSIG or SIG(0)
+ * record.
+ */
+static isc_result_t
+skiprecord(isc_buffer_t *source, isc_boolean_t *metap) {
+	isc_region_t r;
+	unsigned int c, used, type, covers, rdatalen;
+
+	isc_buffer_remainingregion(source, &r);
+	used = 0;
+	for (;;) {
+		if (used >= r.length)
+			return (ISC_R_UNEXPECTEDEND);
+		c = r.base[used];
+		if (c >= 192) {
+			used += 2;
+			break;
+		}
+		if (c >= 64)
+			return (DNS_R_BADLABELTYPE);
+		used += c + 1;
+		if (c == 0)
+			break;
+	}
+	if (used + 2 + 2 + 4 + 2 > r.length)
+		return (ISC_R_UNEXPECTEDEND);
+	type = (r.base[used] << 8) | r.base[used + 1];
+	rdatalen = (r.base[used + 8] << 8) | r.base[used + 9];
+	used += 2 + 2 + 4 + 2;
+	if (used + rdatalen > r.length)
+		return (ISC_R_UNEXPECTEDEND);
+
+	covers = 0;
+	if (rdatalen >= 2)
+		covers = (r.base[used] << 8) | r.base[used + 1];
+	*metap = ISC_TF(type == dns_rdatatype_opt ||
+			type == dns_rdatatype_tsig ||
+			(type == dns_rdatatype_sig && covers == 0));
+
+	isc_buffer_forward(source, used + rdatalen);
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 getrdata(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	 dns_rdataclass_t rdclass, dns_rdatatype_t rdtype,
@@ -1018,7 +1249,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	rdatalist = NULL;
 
 	for (count = 0; count < msg->counts[DNS_SECTION_QUESTION]; count++) {
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = ISC_TRUE;
@@ -1035,7 +1266,12 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
+		result = ISC_R_NOTFOUND;
+		if ((options & DNS_MESSAGEPARSE_LAZY) != 0 &&
+		    (options & DNS_MESSAGEPARSE_CLONEBUFFER) == 0)
+			result = refname(name, source);
+		if (result == ISC_R_NOTFOUND)
+			result = getname(name, source, msg, dctx);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 
@@ -1063,7 +1299,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			ISC_LIST_APPEND(*section, name, link);
 			free_name = ISC_FALSE;
 		} else {
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = name2;
 			name2 = NULL;
 			free_name = ISC_FALSE;
@@ -1105,7 +1341,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
 		}
-		rdataset =  isc_mempool_get(msg->rdspool);
+		rdataset =  newrdataset(msg);
 		if (rdataset == NULL) {
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
@@ -1139,14 +1375,14 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
  cleanup:
 	if (rdataset != NULL) {
 		INSIST(!dns_rdataset_isassociated(rdataset));
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 	}
 #if 0
 	if (rdatalist != NULL)
 		isc_mempool_put(msg->rdlpool, rdatalist);
 #endif
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 
 	return (result);
 }
@@ -1161,9 +1397,16 @@ update(dns_section_t section, dns_rdataclass_t rdclass) {
 	return (ISC_FALSE);
 }
 
+/*
+ * Which records getsection() parses.  The others are skipped.
+ */
+#define GETSECTION_ALL		0
+#define GETSECTION_META		1	/* OPT, TSIG and SIG(0) */
+#define GETSECTION_DATA		2	/* everything else */
+
 static isc_result_t
 getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
-	   dns_section_t sectionid, unsigned int options)
+	   dns_section_t sectionid, unsigned int options, int which)
 {
 	isc_region_t r;
 	unsigned int count, rdatalen;
@@ -1180,7 +1423,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	dns_namelist_t *section;
 	isc_boolean_t free_name, free_rdataset;
 	isc_boolean_t preserve_order, best_effort, seen_problem;
-	isc_boolean_t issigzero;
+	isc_boolean_t issigzero, meta;
 
 	preserve_order = ISC_TF(options & DNS_MESSAGEPARSE_PRESERVEORDER);
 	best_effort = ISC_TF(options & DNS_MESSAGEPARSE_BESTEFFORT);
@@ -1192,11 +1435,26 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
 		section = &msg->sections[sectionid];
 
+		if (which != GETSECTION_ALL) {
+			result = skiprecord(source, &meta);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+			if (meta != ISC_TF(which == GETSECTION_META)) {
+				/*
+				 * Leave the record for later.
+				 */
+				if (which == GETSECTION_META)
+					msg->lazy |= 1 << sectionid;
+				continue;
+			}
+			source->current = recstart;
+		}
+
 		skip_name_search = ISC_FALSE;
 		skip_type_search = ISC_FALSE;
 		free_rdataset = ISC_FALSE;
 
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = ISC_TRUE;
@@ -1411,7 +1669,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			 * If it is a new name, append to the section.
 			 */
 			if (result == ISC_R_SUCCESS) {
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 				name = name2;
 			} else {
 				ISC_LIST_APPEND(*section, name, link);
@@ -1463,7 +1721,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		}
 
 		if (result == ISC_R_NOTFOUND) {
-			rdataset = isc_mempool_get(msg->rdspool);
+			rdataset = newrdataset(msg);
 			if (rdataset == NULL) {
 				result = ISC_R_NOMEMORY;
 				goto cleanup;
@@ -1529,7 +1787,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 				((msg->opt->ttl & DNS_MESSAGE_EDNSRCODE_MASK)
 				 >> 20);
 			msg->rcode |= ercode;
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			free_name = ISC_FALSE;
 		}
 
@@ -1556,9 +1814,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
 		if (seen_problem) {
 			if (free_name)
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 			if (free_rdataset)
-				isc_mempool_put(msg->rdspool, rdataset);
+				releaserdataset(msg, rdataset);
 			free_name = free_rdataset = ISC_FALSE;
 		}
 		INSIST(free_name == ISC_FALSE);
@@ -1571,10 +1829,49 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
  cleanup:
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 	if (free_rdataset)
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
+
+	return (result);
+}
 
+/*
+ * Parse the records that a lazy dns_message_parse() left for later.
+ * Once this has been done, or has failed, it is not done again.
+ */
+static isc_result_t
+lazyparse(dns_message_t *msg) {
+	isc_buffer_t source;
+	dns_decompress_t dctx;
+	isc_result_t result;
+	dns_section_t section;
+
+	if (msg->lazy == 0)
+		return (msg->lazyresult);
+
+	isc_buffer_init(&source, msg->saved.base, msg->saved.length);
+	isc_buffer_add(&source, msg->saved.length);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	result = ISC_R_SUCCESS;
+	for (section = DNS_SECTION_ANSWER;
+	     section < DNS_SECTION_MAX && result == ISC_R_SUCCESS;
+	     section++)
+	{
+		if ((msg->lazy & (1 << section)) == 0)
+			continue;
+		source.current = msg->lazystart[section];
+		result = getsection(&source, msg, &dctx, section,
+				    msg->lazyoptions, GETSECTION_DATA);
+		if (result == DNS_R_RECOVERABLE)
+			result = ISC_R_SUCCESS;
+	}
+
+	dns_decompress_invalidate(&dctx);
+	msg->lazy = 0;
+	msg->lazyresult = result;
 	return (result);
 }
 
@@ -1589,6 +1886,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	isc_buffer_t origsource;
 	isc_boolean_t seen_problem;
 	isc_boolean_t ignore_tc;
+	int which;
 
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(source != NULL);
@@ -1619,6 +1917,19 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 
 	msg->header_ok = 1;
 
+	/*
+	 * A lazy parse only parses the records of a query that have to be
+	 * looked at before it can be answered; the rest are left in
+	 * 'source' until they are asked for.
+	 */
+	if (msg->opcode != dns_opcode_query ||
+	    msg->counts[DNS_SECTION_QUESTION] == 0 || ignore_tc)
+		options &= ~DNS_MESSAGEPARSE_LAZY;
+	if ((options & DNS_MESSAGEPARSE_LAZY) != 0)
+		which = GETSECTION_META;
+	else
+		which = GETSECTION_ALL;
+
 	/*
 	 * -1 means no EDNS.
 	 */
@@ -1637,35 +1948,47 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return (ret);
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_ANSWER, options);
+	msg->lazystart[DNS_SECTION_ANSWER] = source->current;
+	ret = getsection(source, msg, &dctx, DNS_SECTION_ANSWER, options,
+			 which);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
 		seen_problem = ISC_TRUE;
 		ret = ISC_R_SUCCESS;
 	}
-	if (ret != ISC_R_SUCCESS)
+	if (ret != ISC_R_SUCCESS) {
+		msg->lazy = 0;
 		return (ret);
+	}
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_AUTHORITY, options);
+	msg->lazystart[DNS_SECTION_AUTHORITY] = source->current;
+	ret = getsection(source, msg, &dctx, DNS_SECTION_AUTHORITY, options,
+			 which);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
 		seen_problem = ISC_TRUE;
 		ret = ISC_R_SUCCESS;
 	}
-	if (ret != ISC_R_SUCCESS)
+	if (ret != ISC_R_SUCCESS) {
+		msg->lazy = 0;
 		return (ret);
+	}
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_ADDITIONAL, options);
+	msg->lazystart[DNS_SECTION_ADDITIONAL] = source->current;
+	ret = getsection(source, msg, &dctx, DNS_SECTION_ADDITIONAL, options,
+			 which);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
 		seen_problem = ISC_TRUE;
 		ret = ISC_R_SUCCESS;
 	}
-	if (ret != ISC_R_SUCCESS)
+	if (ret != ISC_R_SUCCESS) {
+		msg->lazy = 0;
 		return (ret);
+	}
 
 	isc_buffer_remainingregion(source, &r);
 	if (r.length != 0) {
@@ -1681,12 +2004,15 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	else {
 		msg->saved.length = isc_buffer_usedlength(&origsource);
 		msg->saved.base = isc_mem_get(msg->mctx, msg->saved.length);
-		if (msg->saved.base == NULL)
+		if (msg->saved.base == NULL) {
+			msg->lazy = 0;
 			return (ISC_R_NOMEMORY);
+		}
 		memmove(msg->saved.base, isc_buffer_base(&origsource),
 			msg->saved.length);
 		msg->free_saved = 1;
 	}
+	msg->lazyoptions = options;
 
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		return (DNS_R_RECOVERABLE);
@@ -2269,9 +2595,17 @@ dns_message_renderreset(dns_message_t *msg) {
 
 isc_result_t
 dns_message_firstname(dns_message_t *msg, dns_section_t section) {
+	isc_result_t result;
+
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(VALID_NAMED_SECTION(section));
 
+	if (section != DNS_SECTION_QUESTION) {
+		result = lazyparse(msg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
 	msg->cursors[section] = ISC_LIST_HEAD(msg->sections[section]);
 
 	if (msg->cursors[section] == NULL)
@@ -2333,6 +2667,12 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
 			REQUIRE(*rdataset == NULL);
 	}
 
+	if (section != DNS_SECTION_QUESTION) {
+		result = lazyparse(msg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
 	result = findname(&foundname, target,
 			  &msg->sections[section]);
 
@@ -2404,7 +2744,7 @@ dns_message_gettempname(dns_message_t *msg, dns_name_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->namepool);
+	*item = newname(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 	dns_name_init(*item, NULL);
@@ -2441,7 +2781,7 @@ dns_message_gettemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->rdspool);
+	*item = newrdataset(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 
@@ -2469,7 +2809,7 @@ dns_message_puttempname(dns_message_t *msg, dns_name_t **item) {
 
 	if (dns_name_dynamic(*item))
 		dns_name_free(*item, msg->mctx);
-	isc_mempool_put(msg->namepool, *item);
+	releasename(msg, *item);
 	*item = NULL;
 }
 
@@ -2488,7 +2828,7 @@ dns_message_puttemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(item != NULL && *item != NULL);
 
 	REQUIRE(!dns_rdataset_isassociated(*item));
-	isc_mempool_put(msg->rdspool, *item);
+	releaserdataset(msg, *item);
 	*item = NULL;
 }
 
@@ -3141,6 +3481,12 @@ dns_message_sectiontotext(dns_message_t *msg, dns_section_t section,
 	REQUIRE(target != NULL);
 	REQUIRE(VALID_SECTION(section));
 
+	if (section != DNS_SECTION_QUESTION) {
+		result = lazyparse(msg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
 	if (ISC_LIST_EMPTY(msg->sections[section]))
 		return (ISC_R_SUCCESS);
 
@@ -24,6 +24,10 @@
 #include <ctype.h>
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/mem.h>
@@ -52,7 +56,6 @@ typedef enum {
 
 typedef enum {
 	fw_start = 0,
-	fw_ordinary,
 	fw_newcurrent
 } fw_state;
 
@@ -147,6 +150,121 @@ do { \
 	((name->attributes & (DNS_NAMEATTR_READONLY|DNS_NAMEATTR_DYNAMIC)) \
 	 == 0)
 
+/*
+ * Case folding a block of bytes at a time.  Only 'A' to 'Z' are folded,
+ * exactly as maptolower[] does.  Blocks are 16 bytes with SSE2 (which
+ * every x86_64 CPU has) and 8 bytes elsewhere; the bytes left over are
+ * done with maptolower[].  Nothing past the 'length' bytes given is read
+ * or written.
+ */
+#ifdef __SSE2__
+#define FOLD_SIZE	16
+
+typedef __m128i fold_t;
+
+static inline fold_t
+fold_load(const unsigned char *s) {
+	return (_mm_loadu_si128((const __m128i *)s));
+}
+
+static inline void
+fold_store(unsigned char *d, fold_t v) {
+	_mm_storeu_si128((__m128i *)d, v);
+}
+
+static inline fold_t
+fold_lower(fold_t v) {
+	fold_t upper;
+
+	/*
+	 * The comparisons are signed, so bytes >= 0x80 are never upper case.
+	 */
+	upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+			      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+	return (_mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+
+static inline isc_boolean_t
+fold_equal(fold_t a, fold_t b) {
+	return (ISC_TF(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff));
+}
+#else
+#define FOLD_SIZE	8
+
+typedef isc_uint64_t fold_t;
+
+#define FOLD_ONES	((fold_t)~0 / 0xff)	/* 0x0101010101010101 */
+
+static inline fold_t
+fold_load(const unsigned char *s) {
+	fold_t v;
+
+	memmove(&v, s, sizeof(v));
+	return (v);
+}
+
+static inline void
+fold_store(unsigned char *d, fold_t v) {
+	memmove(d, &v, sizeof(v));
+}
+
+static inline fold_t
+fold_lower(fold_t v) {
+	fold_t low, upper;
+
+	/*
+	 * Add to the low seven bits of each byte so that the top bit is
+	 * set iff the byte is >= 'A', and iff it is > 'Z'.  Neither sum
+	 * carries into the next byte.  Bytes >= 0x80 are never upper case.
+	 */
+	low = v & (FOLD_ONES * 0x7f);
+	upper = (low + FOLD_ONES * (0x80 - 'A')) &
+		~(low + FOLD_ONES * (0x80 - 'Z' - 1)) &
+		~v & (FOLD_ONES * 0x80);
+	return (v | (upper >> 2));
+}
+
+static inline isc_boolean_t
+fold_equal(fold_t a, fold_t b) {
+	return (ISC_TF(a == b));
+}
+#endif
+
+/*
+ * Copy 'length' bytes from 's' to 'd', downcasing them.
+ */
+static inline void
+downcopy(unsigned char *d, const unsigned char *s, unsigned int length) {
+	while (length >= FOLD_SIZE) {
+		fold_store(d, fold_lower(fold_load(s)));
+		d += FOLD_SIZE;
+		s += FOLD_SIZE;
+		length -= FOLD_SIZE;
+	}
+	while (length > 0) {
+		*d++ = maptolower[*s++];
+		length--;
+	}
+}
+
+/*
+ * Return the index of the first of the 'length' bytes at 'a' and 'b'
+ * that differ when downcased, or 'length' if there is none.
+ */
+static inline unsigned int
+casediff(const unsigned char *a, const unsigned char *b, unsigned int length)
+{
+	unsigned int i = 0;
+
+	while (length - i >= FOLD_SIZE &&
+	       fold_equal(fold_lower(fold_load(a + i)),
+			  fold_lower(fold_load(b + i))))
+		i += FOLD_SIZE;
+	while (i < length && maptolower[a[i]] == maptolower[b[i]])
+		i++;
+	return (i);
+}
+
 /*%
  * Note that the name data must be a char array, not a string
  * literal, to avoid compiler warnings about discarding
@@ -442,6 +560,7 @@ static inline unsigned int
 name_hash(dns_name_t *name, isc_boolean_t case_sensitive) {
 	unsigned int length;
 	const unsigned char *s;
+	unsigned char lower[16];
 	unsigned int h = 0;
 	unsigned char c;
 
@@ -449,11 +568,20 @@ name_hash(dns_name_t *name, isc_boolean_t case_sensitive) {
 	if (length > 16)
 		length = 16;
 
+	s = name->ndata;
+	if (!case_sensitive && length == sizeof(lower)) {
+		/*
+		 * Most names are this long; downcase them in one go.
+		 */
+		downcopy(lower, s, length);
+		s = lower;
+		case_sensitive = ISC_TRUE;
+	}
+
 	/*
 	 * This hash function is similar to the one Ousterhout
 	 * uses in Tcl.
 	 */
-	s = name->ndata;
 	if (case_sensitive) {
 		while (length > 0) {
 			h += ( h << 3 ) + *s;
@@ -549,7 +677,7 @@ dns_namereln_t
 dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		     int *orderp, unsigned int *nlabelsp)
 {
-	unsigned int l1, l2, l, count1, count2, count, nlabels;
+	unsigned int l1, l2, l, count1, count2, count, nlabels, i;
 	int cdiff, ldiff, chdiff;
 	unsigned char *label1, *label2;
 	unsigned char *offsets1, *offsets2;
@@ -618,16 +746,12 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		else
 			count = count2;
 
-		while (count > 0) {
-			chdiff = (int)maptolower[*label1] -
-			    (int)maptolower[*label2];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			count--;
-			label1++;
-			label2++;
+		i = casediff(label1, label2, count);
+		if (i < count) {
+			chdiff = (int)maptolower[label1[i]] -
+			    (int)maptolower[label2[i]];
+			*orderp = chdiff;
+			goto done;
 		}
 		if (cdiff != 0) {
 			*orderp = cdiff;
@@ -675,9 +799,7 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 isc_boolean_t
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
+	unsigned int l;
 
 	/*
 	 * Are 'name1' and 'name2' equal?
@@ -707,23 +829,13 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (l != name2->labels)
 		return (ISC_FALSE);
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (l > 0) {
-		l--;
-		count = *label1++;
-		if (count != *label2++)
-			return (ISC_FALSE);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		while (count > 0) {
-			count--;
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (ISC_FALSE);
-		}
-	}
+	/*
+	 * Label lengths are never changed by downcasing, so the names
+	 * are equal iff their downcased wire forms are.
+	 */
+	if (casediff(name1->ndata, name2->ndata, name1->length) !=
+	    name1->length)
+		return (ISC_FALSE);
 
 	return (ISC_TRUE);
 }
@@ -791,16 +903,14 @@ dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
 
 		if (count1 != count2)
 			return ((count1 < count2) ? -1 : 1);
-		count = count1;
-		while (count > 0) {
-			count--;
-			c1 = maptolower[*label1++];
-			c2 = maptolower[*label2++];
-			if (c1 < c2)
-				return (-1);
-			else if (c1 > c2)
-				return (1);
+		count = casediff(label1, label2, count1);
+		if (count < count1) {
+			c1 = maptolower[label1[count]];
+			c2 = maptolower[label2[count]];
+			return ((c1 < c2) ? -1 : 1);
 		}
+		label1 += count1;
+		label2 += count1;
 	}
 
 	/*
@@ -1632,8 +1742,8 @@ dns_name_tofilenametext(dns_name_t *name, isc_boolean_t omit_final_dot,
 
 isc_result_t
 dns_name_downcase(dns_name_t *source, dns_name_t *name, isc_buffer_t *target) {
-	unsigned char *sndata, *ndata;
-	unsigned int nlen, count, labels;
+	unsigned char *ndata;
+	unsigned int nlen;
 	isc_buffer_t buffer;
 
 	/*
@@ -1659,33 +1769,18 @@ dns_name_downcase(dns_name_t *source, dns_name_t *name, isc_buffer_t *target) {
 		name->ndata = ndata;
 	}
 
-	sndata = source->ndata;
 	nlen = source->length;
-	labels = source->labels;
 
 	if (nlen > (target->length - target->used)) {
 		MAKE_EMPTY(name);
 		return (ISC_R_NOSPACE);
 	}
 
-	while (labels > 0 && nlen > 0) {
-		labels--;
-		count = *sndata++;
-		*ndata++ = count;
-		nlen--;
-		if (count < 64) {
-			INSIST(nlen >= count);
-			while (count > 0) {
-				*ndata++ = maptolower[(*sndata++)];
-				nlen--;
-				count--;
-			}
-		} else {
-			FATAL_ERROR(__FILE__, __LINE__,
-				    "Unexpected label type %02x", count);
-			/* Does not return. */
-		}
-	}
+	/*
+	 * Label lengths are never changed by downcasing, so the whole
+	 * name can be downcased at once.
+	 */
+	downcopy(ndata, source->ndata, nlen);
 
 	if (source != name) {
 		name->labels = source->labels;
@@ -1751,7 +1846,7 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 {
 	unsigned char *cdata, *ndata;
 	unsigned int cused; /* Bytes of compressed name data used */
-	unsigned int nused, labels, n, nmax;
+	unsigned int nused, labels, nmax;
 	unsigned int current, new_current, biggest_pointer;
 	isc_boolean_t done;
 	fw_state state = fw_start;
@@ -1791,7 +1886,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 	/*
 	 * Initialize things to make the compiler happy; they're not required.
 	 */
-	n = 0;
 	new_current = 0;
 
 	/*
@@ -1821,8 +1915,8 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 	biggest_pointer = current;
 
 	/*
-	 * Note:  The following code is not optimized for speed, but
-	 * rather for correctness.  Speed will be addressed in the future.
+	 * Label data is copied a whole label at a time; only the label
+	 * types and compression pointers go through the state machine.
 	 */
 
 	while (current < source->active && !done) {
@@ -1840,10 +1934,24 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 					goto full;
 				nused += c + 1;
 				*ndata++ = c;
-				if (c == 0)
+				if (c == 0) {
 					done = ISC_TRUE;
-				n = c;
-				state = fw_ordinary;
+					break;
+				}
+				/*
+				 * Copy the whole label at once.
+				 */
+				if (current + c > source->active)
+					return (ISC_R_UNEXPECTEDEND);
+				if (downcase)
+					downcopy(ndata, cdata, c);
+				else
+					memmove(ndata, cdata, c);
+				ndata += c;
+				cdata += c;
+				current += c;
+				if (!seen_pointer)
+					cused += c;
 			} else if (c >= 128 && c < 192) {
 				/*
 				 * 14 bit local compression pointer.
@@ -1863,14 +1971,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 			} else
 				return (DNS_R_BADLABELTYPE);
 			break;
-		case fw_ordinary:
-			if (downcase)
-				c = maptolower[c];
-			*ndata++ = c;
-			n--;
-			if (n == 0)
-				state = fw_start;
-			break;
 		case fw_newcurrent:
 			new_current *= 256;
 			new_current += c;
@@ -503,6 +503,7 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	NULL,
 	NULL,
 	rdataset_settrust,
+	NULL,
 	NULL
 };
 
@@ -575,6 +576,7 @@ dns_ncache_getrdataset(dns_rdataset_t *ncacherdataset, dns_name_t *name,
     rdataset_methods.putadditional = NULL;
     rdataset_methods.settrust      = rdataset_settrust;
     rdataset_methods.expire        = NULL;
+    rdataset_methods.prefetch      = NULL;
     //
 	rdataset->methods = &rdataset_methods;
 	rdataset->rdclass = ncacherdataset->rdclass;
@@ -690,6 +692,7 @@ dns_ncache_getsigrdataset(dns_rdataset_t *ncacherdataset, dns_name_t *name,
     rdataset_methods.putadditional = NULL;
     rdataset_methods.settrust      = rdataset_settrust;
     rdataset_methods.expire        = NULL;
+    rdataset_methods.prefetch      = NULL;
     //
 	rdataset->methods = &rdataset_methods;
 	rdataset->rdclass = ncacherdataset->rdclass;
@@ -764,6 +767,7 @@ dns_ncache_current(dns_rdataset_t *ncacherdataset, dns_name_t *found,
     rdataset_methods.putadditional = NULL;
     rdataset_methods.settrust      = rdataset_settrust;
     rdataset_methods.expire        = NULL;
+    rdataset_methods.prefetch      = NULL;
     //
 	rdataset->methods = &rdataset_methods;
 	rdataset->rdclass = ncacherdataset->rdclass;
@@ -25,6 +25,8 @@
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
+#include <isc/stats.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -57,6 +59,17 @@
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
 #endif
 
+/*%
+ * A slot of the exact match index.  An empty slot has a NULL node.
+ */
+typedef struct rbtindex {
+	unsigned int            hashval;
+	dns_rbtnode_t *         node;
+} rbtindex_t;
+
+/*% Initial and smallest number of exact match index slots. */
+#define RBT_INDEX_SIZE 64
+
 struct dns_rbt {
 	unsigned int            magic;
 	isc_mem_t *             mctx;
@@ -66,6 +79,11 @@ struct dns_rbt {
 	unsigned int            nodecount;
 	unsigned int            hashsize;
 	dns_rbtnode_t **        hashtable;
+	unsigned int            tag;
+	unsigned int            indexsize;	/* a power of 2, or 0 */
+	unsigned int            indexcount;
+	rbtindex_t *            index;
+	isc_stats_t *           indexstats;
 };
 
 #define RED 0
@@ -116,6 +134,12 @@ struct dns_rbt {
 #define NODE_SIZE(node) (sizeof(*node) + \
 			 OLDNAMELEN(node) + OLDOFFSETLEN(node) + 1)
 
+/*%
+ * Nodes and their data in images written by dns_rbt_serialize() start
+ * at offsets that are a multiple of this.
+ */
+#define RBT_IMAGE_ALIGN 8
+
 /*%
  * Color management.
  */
@@ -197,13 +221,22 @@ find_up(dns_rbtnode_t *node) {
  * Forward declarations.
  */
 static isc_result_t
-create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep);
+create_node(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep);
 
 #ifdef DNS_RBT_USEHASH
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name);
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node);
+static inline void
+index_add(dns_rbt_t *rbt, dns_rbtnode_t *node);
+static isc_result_t
+index_resize(dns_rbt_t *rbt, unsigned int size);
+static void
+index_free(dns_rbt_t *rbt);
+static dns_rbtnode_t *
+index_lookup(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **levels,
+	     unsigned int *nlevelsp);
 #else
 #define hash_node(rbt, node, name) (ISC_R_SUCCESS)
 #define unhash_node(rbt, node)
@@ -257,6 +290,11 @@ dns_rbt_create(isc_mem_t *mctx, void (*deleter)(void *, void *),
 	rbt->nodecount = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	rbt->tag = 0;
+	rbt->indexsize = 0;
+	rbt->indexcount = 0;
+	rbt->index = NULL;
+	rbt->indexstats = NULL;
 
 #ifdef DNS_RBT_USEHASH
 	result = inithash(rbt);
@@ -298,6 +336,11 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+#ifdef DNS_RBT_USEHASH
+	index_free(rbt);
+#endif
+	if (rbt->indexstats != NULL)
+		isc_stats_detach(&rbt->indexstats);
 
 	rbt->magic = 0;
 
@@ -312,6 +355,301 @@ dns_rbt_nodecount(dns_rbt_t *rbt) {
 	return (rbt->nodecount);
 }
 
+isc_result_t
+dns_rbt_setindex(dns_rbt_t *rbt, isc_boolean_t enable) {
+#ifdef DNS_RBT_USEHASH
+	isc_result_t result;
+	dns_rbtnode_t *node;
+	unsigned int i, size;
+
+	REQUIRE(VALID_RBT(rbt));
+
+	if (!enable) {
+		index_free(rbt);
+		return (ISC_R_SUCCESS);
+	}
+	if (rbt->index != NULL)
+		return (ISC_R_SUCCESS);
+
+	if (rbt->indexstats == NULL) {
+		result = isc_stats_create(rbt->mctx, &rbt->indexstats,
+					  dns_rbtindexstats_max);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	for (size = RBT_INDEX_SIZE; size < rbt->nodecount * 2; size *= 2)
+		; /* Nothing. */
+	result = index_resize(rbt, size);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * Every node is on a chain of the level hash table.
+	 */
+	for (i = 0; i < rbt->hashsize; i++)
+		for (node = rbt->hashtable[i];
+		     node != NULL;
+		     node = HASHNEXT(node))
+			index_add(rbt, node);
+	INSIST(rbt->indexcount == rbt->nodecount);
+
+	return (ISC_R_SUCCESS);
+#else
+	REQUIRE(VALID_RBT(rbt));
+	UNUSED(enable);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+isc_stats_t *
+dns_rbt_getindexstats(dns_rbt_t *rbt) {
+	REQUIRE(VALID_RBT(rbt));
+
+	return (rbt->indexstats);
+}
+
+void
+dns_rbt_settag(dns_rbt_t *rbt, unsigned int tag) {
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(tag < (1U << DNS_RBT_TAGLENGTH));
+	rbt->tag = tag;
+}
+
+static isc_result_t
+serialize_pad(FILE *file, off_t *offsetp) {
+	static const unsigned char zeros[RBT_IMAGE_ALIGN];
+	size_t len;
+	isc_result_t result;
+
+	len = (size_t)((RBT_IMAGE_ALIGN - *offsetp % RBT_IMAGE_ALIGN) %
+		       RBT_IMAGE_ALIGN);
+	if (len == 0)
+		return (ISC_R_SUCCESS);
+	result = isc_stdio_write(zeros, 1, len, file, NULL);
+	if (result == ISC_R_SUCCESS)
+		*offsetp += len;
+	return (result);
+}
+
+/*
+ * Write the subtree at 'node' in post-order, so that the offsets of
+ * the children are known when the node itself is written.
+ */
+static isc_result_t
+serialize_node(FILE *file, dns_rbtnode_t *node,
+	       dns_rbtdatawriter_t datawriter, void *writer_arg,
+	       off_t *offsetp, off_t *nodeoffsetp)
+{
+	dns_rbtnode_t temp;
+	off_t left, right, down, data = 0;
+	isc_result_t result;
+
+	if (node == NULL) {
+		*nodeoffsetp = 0;
+		return (ISC_R_SUCCESS);
+	}
+
+	result = serialize_node(file, LEFT(node), datawriter, writer_arg,
+				offsetp, &left);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = serialize_node(file, RIGHT(node), datawriter, writer_arg,
+				offsetp, &right);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = serialize_node(file, DOWN(node), datawriter, writer_arg,
+				offsetp, &down);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (DATA(node) != NULL) {
+		result = serialize_pad(file, offsetp);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		data = *offsetp;
+		result = (datawriter)(file, DATA(node), writer_arg, offsetp);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (*offsetp == data)
+			data = 0;	/* Nothing visible was written. */
+	}
+
+	result = serialize_pad(file, offsetp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	memmove(&temp, node, sizeof(temp));
+	PARENT(&temp) = NULL;
+	LEFT(&temp) = (dns_rbtnode_t *)(size_t)left;
+	RIGHT(&temp) = (dns_rbtnode_t *)(size_t)right;
+	DOWN(&temp) = (dns_rbtnode_t *)(size_t)down;
+	DATA(&temp) = (void *)(size_t)data;
+#ifdef DNS_RBT_USEHASH
+	HASHNEXT(&temp) = NULL;
+#endif
+	ISC_LINK_INIT(&temp, deadlink);
+	temp.rpz = 0;
+	temp.is_mmapped = 0;
+	DIRTY(&temp) = 0;
+	LOCKNUM(&temp) = 0;
+
+	result = isc_stdio_write(&temp, sizeof(temp), 1, file, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_stdio_write(NAME(node), 1, NODE_SIZE(node) - sizeof(temp),
+				 file, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	*nodeoffsetp = *offsetp;
+	*offsetp += NODE_SIZE(node);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_rbt_serialize(dns_rbt_t *rbt, FILE *file, dns_rbtdatawriter_t datawriter,
+		  void *writer_arg, off_t *offsetp, off_t *rootp)
+{
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(file != NULL && datawriter != NULL);
+	REQUIRE(offsetp != NULL && rootp != NULL);
+
+	return (serialize_node(file, rbt->root, datawriter, writer_arg,
+			       offsetp, rootp));
+}
+
+#ifdef DNS_RBT_USEHASH
+static isc_result_t
+deserialize_hash(dns_rbt_t *rbt, dns_rbtnode_t *node) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	if (dns_rbt_fullnamefromnode(node, name) != ISC_R_SUCCESS)
+		return (ISC_R_INVALIDFILE);
+	hash_node(rbt, node, name);
+	return (ISC_R_SUCCESS);
+}
+#endif
+
+/*
+ * Fix the subtree of the image at 'offset' in pre-order, so that the
+ * levels above a node are linked when its full name is needed.  The
+ * offsets of the children must be smaller than that of the node, so a
+ * broken image cannot make this loop.
+ */
+static isc_result_t
+deserialize_node(dns_rbt_t *rbt, unsigned char *base, size_t size,
+		 off_t offset, dns_rbtnode_t *parent,
+		 dns_rbtdatafixer_t datafixer, void *fixer_arg,
+		 dns_rbtnode_t **nodep)
+{
+	dns_rbtnode_t *node;
+	size_t left, right, down, data;
+	isc_result_t result;
+
+	if (offset == 0) {
+		*nodep = NULL;
+		return (ISC_R_SUCCESS);
+	}
+
+	if (offset < 0 || offset % RBT_IMAGE_ALIGN != 0 ||
+	    (size_t)offset + sizeof(*node) > size)
+		return (ISC_R_INVALIDFILE);
+	node = (dns_rbtnode_t *)(base + offset);
+	if ((size_t)offset + NODE_SIZE(node) > size ||
+	    NAMELEN(node) == 0 || NAMELEN(node) > OLDNAMELEN(node) ||
+	    OFFSETLEN(node) == 0 || OFFSETLEN(node) > OLDOFFSETLEN(node))
+		return (ISC_R_INVALIDFILE);
+#if DNS_RBT_USEMAGIC
+	if (node->magic != DNS_RBTNODE_MAGIC)
+		return (ISC_R_INVALIDFILE);
+#endif
+
+	left = (size_t)LEFT(node);
+	right = (size_t)RIGHT(node);
+	down = (size_t)DOWN(node);
+	data = (size_t)DATA(node);
+	if (left >= (size_t)offset || right >= (size_t)offset ||
+	    down >= (size_t)offset || data >= (size_t)offset)
+		return (ISC_R_INVALIDFILE);
+
+	PARENT(node) = parent;
+	LEFT(node) = NULL;
+	RIGHT(node) = NULL;
+	DOWN(node) = NULL;
+	DATA(node) = (data != 0) ? base + data : NULL;
+#ifdef DNS_RBT_USEHASH
+	HASHNEXT(node) = NULL;
+#endif
+	ISC_LINK_INIT(node, deadlink);
+	node->is_mmapped = 1;
+	node->rpz = 0;
+	node->tag = rbt->tag;
+	DIRTY(node) = 0;
+	LOCKNUM(node) = 0;
+	dns_rbtnode_refinit(node, 0);
+
+	rbt->nodecount++;
+#ifdef DNS_RBT_USEHASH
+	result = deserialize_hash(rbt, node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#endif
+
+	if (DATA(node) != NULL && datafixer != NULL) {
+		result = (datafixer)(node, base, size, fixer_arg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	*nodep = node;
+
+	result = deserialize_node(rbt, base, size, (off_t)left, node,
+				  datafixer, fixer_arg, &LEFT(node));
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = deserialize_node(rbt, base, size, (off_t)right, node,
+				  datafixer, fixer_arg, &RIGHT(node));
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	return (deserialize_node(rbt, base, size, (off_t)down, node,
+				 datafixer, fixer_arg, &DOWN(node)));
+}
+
+isc_result_t
+dns_rbt_deserialize(dns_rbt_t *rbt, void *base, size_t size, off_t root,
+		    dns_rbtdatafixer_t datafixer, void *fixer_arg)
+{
+	isc_result_t result;
+
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(rbt->root == NULL && rbt->nodecount == 0);
+	REQUIRE(base != NULL);
+
+	result = deserialize_node(rbt, base, size, root, NULL,
+				  datafixer, fixer_arg, &rbt->root);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * Forget the nodes: they belong to the image.
+		 */
+		rbt->root = NULL;
+		rbt->nodecount = 0;
+		memset(rbt->hashtable, 0,
+		       rbt->hashsize * sizeof(dns_rbtnode_t *));
+		if (rbt->index != NULL) {
+			memset(rbt->index, 0,
+			       rbt->indexsize * sizeof(rbtindex_t));
+			rbt->indexcount = 0;
+		}
+	}
+
+	return (result);
+}
+
 static inline isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   isc_boolean_t include_chain_end)
@@ -395,7 +733,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_name_clone(name, add_name);
 
 	if (rbt->root == NULL) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 		if (result == ISC_R_SUCCESS) {
 			rbt->nodecount++;
 			new_current->is_root = 1;
@@ -528,7 +866,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 				 */
 				dns_name_split(&current_name, common_labels,
 					       prefix, suffix);
-				result = create_node(rbt->mctx, suffix,
+				result = create_node(rbt, suffix,
 						     &new_current);
 
 				if (result != ISC_R_SUCCESS)
@@ -632,7 +970,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 	} while (child != NULL);
 
 	if (result == ISC_R_SUCCESS)
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 
 	if (result == ISC_R_SUCCESS) {
 		dns_rbt_addonlevel(new_current, current, order, root);
@@ -723,6 +1061,46 @@ dns_rbt_findnode(dns_rbt_t *rbt, dns_name_t *name, dns_name_t *foundname,
 		order = 0;
 	}
 
+#ifdef DNS_RBT_USEHASH
+	/*
+	 * Try the exact match index before walking down the tree.  Its
+	 * answer is only used when the walk would end at the same node
+	 * without calling back; the chain is rebuilt from the node's
+	 * ancestors.
+	 */
+	if (rbt->index != NULL && (options & DNS_RBTFIND_NOEXACT) == 0) {
+		dns_rbtnode_t *levels[DNS_RBT_LEVELBLOCK];
+		unsigned int nlevels = 0, i;
+
+		current = index_lookup(rbt, name, levels, &nlevels);
+		if (current != NULL && DATA(current) == NULL &&
+		    (options & DNS_RBTFIND_EMPTYDATA) == 0)
+			current = NULL;
+		for (i = 0; current != NULL && callback != NULL &&
+			    i < nlevels; i++)
+			if (FINDCALLBACK(levels[i]))
+				current = NULL;
+
+		if (current != NULL) {
+			isc_stats_increment(rbt->indexstats,
+					    dns_rbtindexstats_hit);
+			while (nlevels > 0)
+				ADD_LEVEL(chain, levels[--nlevels]);
+			chain->end = current;
+			chain->level_matches = chain->level_count;
+			if (foundname != NULL) {
+				result = chain_name(chain, foundname,
+						    ISC_TRUE);
+				if (result != ISC_R_SUCCESS)
+					return (result);
+			}
+			*node = current;
+			return (ISC_R_SUCCESS);
+		}
+		isc_stats_increment(rbt->indexstats, dns_rbtindexstats_miss);
+	}
+#endif
+
 	dns_fixedname_init(&fixedcallbackname);
 	callback_name = dns_fixedname_name(&fixedcallbackname);
 
@@ -1328,7 +1706,8 @@ dns_rbt_deletenode(dns_rbt_t *rbt, dns_rbtnode_t *node, isc_boolean_t recurse)
 	node->magic = 0;
 #endif
 	dns_rbtnode_refdestroy(node);
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!node->is_mmapped)
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 
 	/*
@@ -1420,7 +1799,7 @@ dns_rbt_formatnodename(dns_rbtnode_t *node, char *printname, unsigned int size)
 }
 
 static isc_result_t
-create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
+create_node(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node;
 	isc_region_t region;
 	unsigned int labels;
@@ -1434,7 +1813,7 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 	/*
 	 * Allocate space for the node structure, the name, and the offsets.
 	 */
-	node = (dns_rbtnode_t *)isc_mem_get(mctx, sizeof(*node) +
+	node = (dns_rbtnode_t *)isc_mem_get(rbt->mctx, sizeof(*node) +
 					    region.length + labels + 1);
 
 	if (node == NULL)
@@ -1447,6 +1826,8 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 	node->rpz = 0;
+	node->tag = rbt->tag;
+	node->is_mmapped = 0;
 
 #ifdef DNS_RBT_USEHASH
 	HASHNEXT(node) = NULL;
@@ -1560,6 +1941,145 @@ rehash(dns_rbt_t *rbt) {
 	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
 }
 
+static inline void
+index_add(dns_rbt_t *rbt, dns_rbtnode_t *node) {
+	unsigned int i, mask;
+
+	mask = rbt->indexsize - 1;
+	for (i = HASHVAL(node) & mask;
+	     rbt->index[i].node != NULL;
+	     i = (i + 1) & mask)
+		; /* Nothing. */
+
+	rbt->index[i].hashval = HASHVAL(node);
+	rbt->index[i].node = node;
+	rbt->indexcount++;
+}
+
+static inline void
+index_remove(dns_rbt_t *rbt, dns_rbtnode_t *node) {
+	unsigned int i, j, k, mask;
+
+	mask = rbt->indexsize - 1;
+	for (i = HASHVAL(node) & mask;
+	     rbt->index[i].node != node;
+	     i = (i + 1) & mask)
+		INSIST(rbt->index[i].node != NULL);
+
+	/*
+	 * Move back any later entry of the probe sequence whose home slot
+	 * does not lie between the hole and the entry, so that lookups
+	 * never stop early at the hole.
+	 */
+	for (j = (i + 1) & mask;
+	     rbt->index[j].node != NULL;
+	     j = (j + 1) & mask)
+	{
+		k = rbt->index[j].hashval & mask;
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		rbt->index[i] = rbt->index[j];
+		i = j;
+	}
+
+	rbt->index[i].node = NULL;
+	rbt->indexcount--;
+}
+
+static isc_result_t
+index_resize(dns_rbt_t *rbt, unsigned int size) {
+	rbtindex_t *oldindex;
+	unsigned int oldsize, i;
+
+	INSIST(size >= rbt->indexcount * 2 && (size & (size - 1)) == 0);
+
+	oldindex = rbt->index;
+	oldsize = rbt->indexsize;
+	rbt->index = isc_mem_get(rbt->mctx, size * sizeof(rbtindex_t));
+	if (rbt->index == NULL) {
+		rbt->index = oldindex;
+		return (ISC_R_NOMEMORY);
+	}
+	memset(rbt->index, 0, size * sizeof(rbtindex_t));
+	rbt->indexsize = size;
+	rbt->indexcount = 0;
+
+	for (i = 0; i < oldsize; i++)
+		if (oldindex[i].node != NULL)
+			index_add(rbt, oldindex[i].node);
+
+	if (oldindex != NULL)
+		isc_mem_put(rbt->mctx, oldindex, oldsize * sizeof(rbtindex_t));
+	return (ISC_R_SUCCESS);
+}
+
+static void
+index_free(dns_rbt_t *rbt) {
+	if (rbt->index != NULL)
+		isc_mem_put(rbt->mctx, rbt->index,
+			    rbt->indexsize * sizeof(rbtindex_t));
+	rbt->index = NULL;
+	rbt->indexsize = 0;
+	rbt->indexcount = 0;
+}
+
+/*
+ * Find the node whose full name is 'name' in the exact match index.
+ * The nodes of the levels above it are stored in 'levels', lowest first.
+ */
+static dns_rbtnode_t *
+index_lookup(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **levels,
+	     unsigned int *nlevelsp)
+{
+	dns_rbtnode_t *hnode, *up, *next;
+	dns_name_t hnode_name, label_name;
+	unsigned int hash, i, mask, nlabels, offset, nlevels;
+
+	hash = dns_name_fullhash(name, ISC_FALSE);
+	nlabels = dns_name_countlabels(name);
+	mask = rbt->indexsize - 1;
+	dns_name_init(&hnode_name, NULL);
+	dns_name_init(&label_name, NULL);
+
+	for (i = hash & mask;
+	     (hnode = rbt->index[i].node) != NULL;
+	     i = (i + 1) & mask)
+	{
+		if (rbt->index[i].hashval != hash)
+			continue;
+
+		/*
+		 * Match the labels of 'name' against the node and its
+		 * ancestors, from the left.  Only a top level node may
+		 * hold the root label.
+		 */
+		offset = 0;
+		nlevels = 0;
+		for (up = hnode; up != NULL; up = next) {
+			NODENAME(up, &hnode_name);
+			next = find_up(up);
+			if (offset + hnode_name.labels > nlabels ||
+			    ISC_TF(next == NULL) !=
+			    ISC_TF(offset + hnode_name.labels == nlabels))
+				break;
+			dns_name_getlabelsequence(name, offset,
+						  hnode_name.labels,
+						  &label_name);
+			if (!dns_name_equal(&label_name, &hnode_name))
+				break;
+			offset += hnode_name.labels;
+			if (next != NULL)
+				levels[nlevels++] = next;
+		}
+		if (up == NULL) {
+			*nlevelsp = nlevels;
+			return (hnode);
+		}
+	}
+
+	return (NULL);
+}
+
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 
@@ -1569,6 +2089,18 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 		rehash(rbt);
 
 	hash_add_node(rbt, node, name);
+
+	if (rbt->index != NULL) {
+		/*
+		 * Keep the index at most half full.  If it cannot grow,
+		 * give it up rather than let the probes get long.
+		 */
+		if ((rbt->indexcount + 1) * 2 > rbt->indexsize &&
+		    index_resize(rbt, rbt->indexsize * 2) != ISC_R_SUCCESS)
+			index_free(rbt);
+		else
+			index_add(rbt, node);
+	}
 }
 
 static inline void
@@ -1592,6 +2124,9 @@ unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 			HASHNEXT(bucket_node) = HASHNEXT(node);
 		}
 	}
+
+	if (rbt->index != NULL)
+		index_remove(rbt, node);
 }
 #endif /* DNS_RBT_USEHASH */
 
@@ -2059,7 +2594,8 @@ dns_rbt_deletetree(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 	node->magic = 0;
 #endif
 
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!node->is_mmapped)
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 	return (result);
 }
@@ -2109,7 +2645,8 @@ dns_rbt_deletetreeflat(dns_rbt_t *rbt, unsigned int quantum,
 	} else
 		parent = RIGHT(node);
 
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!node->is_mmapped)
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 	node = parent;
 	if (quantum != 0 && --quantum == 0) {
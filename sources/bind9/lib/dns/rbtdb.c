@@ -26,15 +26,19 @@
 /* #define inline */
 
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/heap.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/parseint.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
 #include <isc/serial.h>
+#include <isc/sha1.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/time.h>
@@ -68,6 +72,7 @@
 #else
 #include "rbtdb.h"
 #endif
+#include "shardcache.h"
 
 #ifdef DNS_RBTDB_VERSION64
 #define RBTDB_MAGIC                     ISC_MAGIC('R', 'B', 'D', '8')
@@ -122,6 +127,8 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define cleanup_dead_nodes cleanup_dead_nodes64
 #define cleanup_dead_nodes_callback cleanup_dead_nodes_callback64
 #define closeversion closeversion64
+#define create_rbtdb create_rbtdb64
+#define create_shard create_shard64
 #define createiterator createiterator64
 #define currentversion currentversion64
 #define dbiterator_current dbiterator_current64
@@ -158,6 +165,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define getnsec3parameters getnsec3parameters64
 #define getoriginnode getoriginnode64
 #define getrrsetstats getrrsetstats64
+#define getservestalettl getservestalettl64
 #define getsigningtime getsigningtime64
 #define isdnssec isdnssec64
 #define ispersistent ispersistent64
@@ -200,6 +208,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define rpz_findips rpz_findips64
 #define set_index set_index64
 #define set_ttl set_ttl64
+#define setservestalettl setservestalettl64
 #define setsigningtime setsigningtime64
 #define settask settask64
 #define setup_delegation setup_delegation64
@@ -327,6 +336,12 @@ typedef isc_mutex_t nodelock_t;
  */
 #define RBTDB_VIRTUAL 300
 
+/*
+ * How many names that cannot hold an NSEC3 record of the zone are passed
+ * over when looking back for a covering NSEC3 record.
+ */
+#define RBTDB_NSEC3_MAXSKIP 64
+
 struct noqname {
 	dns_name_t 	name;
 	void *     	neg;
@@ -375,6 +390,12 @@ typedef struct rdatasetheader {
 	 * performance reasons.
 	 */
 
+	isc_uint32_t                    hits;
+	/*%<
+	 * The number of times this rdataset has been bound, for deciding
+	 * whether it is worth prefetching.  Not locked, like 'count'.
+	 */
+
 	acachectl_t                     *additional_auth;
 	acachectl_t                     *additional_glue;
 
@@ -401,6 +422,7 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define RDATASET_ATTR_STATCOUNT         0x0040
 #define RDATASET_ATTR_OPTOUT		0x0080
 #define RDATASET_ATTR_NEGATIVE          0x0100
+#define RDATASET_ATTR_PREFETCH          0x0200
 
 typedef struct acache_cbarg {
 	dns_rdatasetadditional_t        type;
@@ -441,6 +463,16 @@ struct acachectl {
 	(((header)->attributes & RDATASET_ATTR_OPTOUT) != 0)
 #define NEGATIVE(header) \
 	(((header)->attributes & RDATASET_ATTR_NEGATIVE) != 0)
+#define PREFETCH(header) \
+	(((header)->attributes & RDATASET_ATTR_PREFETCH) != 0)
+
+/*%
+ * When an rdataset in a cache can no longer be served even as stale
+ * data.  Until then an expired rdataset is kept, but only a search with
+ * DNS_DBFIND_STALEOK will find it.
+ */
+#define STALE_TTL(header, rbtdb) \
+	((header)->rdh_ttl + (rbtdb)->serve_stale_ttl)
 
 #define DEFAULT_NODE_LOCK_COUNT         7       /*%< Should be prime. */
 
@@ -576,11 +608,50 @@ struct dns_rbtdb {
 
 	/* Unlocked */
 	unsigned int                    quantum;
+	dns_ttl_t			serve_stale_ttl; /* cache DB only */
+
+	/* Image loaded by deserialize(), or NULL. */
+	void *				mmap_location;
+	size_t				mmap_size;
 };
 
 #define RBTDB_ATTR_LOADED               0x01
 #define RBTDB_ATTR_LOADING              0x02
 
+/*%
+ * Header of the image of a zone database written by serialize().  An
+ * image can only be used by the same build on the same kind of machine,
+ * so the header records what the layout depends on.  The digest covers
+ * the header with 'digest' zeroed.
+ */
+#define RBTDB_IMAGE_MAGIC		"BIND9 rbtdb map"
+#define RBTDB_IMAGE_VERSION		1
+#define RBTDB_IMAGE_BYTEORDER		0x01020304U
+#define RBTDB_IMAGE_ALIGN		8
+
+typedef struct rbtdb_image_header {
+	char				magic[16];
+	isc_uint32_t			version;
+	isc_uint32_t			byteorder;
+	isc_uint32_t			ptrsize;
+	isc_uint32_t			nodesize;
+	isc_uint32_t			headersize;
+	isc_uint32_t			serialsize;
+	isc_uint64_t			length;	/*%< Of the image. */
+	isc_uint64_t			tree;	/*%< Offsets of the roots. */
+	isc_uint64_t			nsec;
+	isc_uint64_t			nsec3;
+	unsigned char			digest[ISC_SHA1_DIGESTLENGTH];
+} rbtdb_image_header_t;
+
+/*%
+ * Serialization Context
+ */
+typedef struct {
+	dns_rbtdb_t *           rbtdb;
+	rbtdb_serial_t          serial;
+} rbtdb_serialize_t;
+
 /*%
  * Search Context
  */
@@ -661,6 +732,8 @@ static void resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 static void prune_tree(isc_task_t *task, isc_event_t *event);
 static void rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
 static void rdataset_expire(dns_rdataset_t *rdataset);
+static isc_boolean_t rdataset_prefetch(dns_rdataset_t *rdataset,
+				       unsigned int hits);
 
 static dns_rdatasetmethods_t rdataset_methods = {
 	rdataset_disassociate,
@@ -677,7 +750,8 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	rdataset_setadditional,
 	rdataset_putadditional,
 	rdataset_settrust,
-	rdataset_expire
+	rdataset_expire,
+	rdataset_prefetch
 };
 
 static void rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp);
@@ -1097,6 +1171,9 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 		dns_rpz_cidr_free(&rbtdb->rpz_cidr);
 #endif
 
+	if (rbtdb->mmap_location != NULL)
+		(void)isc_file_munmap(rbtdb->mmap_location, rbtdb->mmap_size);
+
 	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
 	isc_rwlock_destroy(&rbtdb->tree_lock);
@@ -1416,6 +1493,16 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset)
 	free_acachearray(mctx, rdataset, rdataset->additional_auth);
 	free_acachearray(mctx, rdataset, rdataset->additional_glue);
 
+	/*
+	 * Headers loaded from an image go away with it.
+	 */
+	if (rbtdb->mmap_location != NULL &&
+	    (unsigned char *)rdataset >=
+	    (unsigned char *)rbtdb->mmap_location &&
+	    (unsigned char *)rdataset <
+	    (unsigned char *)rbtdb->mmap_location + rbtdb->mmap_size)
+		return;
+
 	if ((rdataset->attributes & RDATASET_ATTR_NONEXISTENT) != 0)
 		size = sizeof(*rdataset);
 	else
@@ -2918,12 +3005,20 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
     rdataset_methods.putadditional = rdataset_putadditional;
     rdataset_methods.settrust      = rdataset_settrust;
     rdataset_methods.expire        = rdataset_expire;
+    rdataset_methods.prefetch      = rdataset_prefetch;
     //
 	rdataset->methods = &rdataset_methods;
 	rdataset->rdclass = rbtdb->common.rdclass;
 	rdataset->type = RBTDB_RDATATYPE_BASE(header->type);
 	rdataset->covers = RBTDB_RDATATYPE_EXT(header->type);
-	rdataset->ttl = header->rdh_ttl - now;
+	if (IS_CACHE(rbtdb) && header->rdh_ttl < now) {
+		/*
+		 * Expired data kept to be served stale; see cache_find().
+		 */
+		rdataset->ttl = 0;
+		rdataset->attributes |= DNS_RDATASETATTR_STALE;
+	} else
+		rdataset->ttl = header->rdh_ttl - now;
 	rdataset->trust = header->trust;
 	if (NEGATIVE(header))
 		rdataset->attributes |= DNS_RDATASETATTR_NEGATIVE;
@@ -2938,6 +3033,8 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	rdataset->count = header->count++;
 	if (rdataset->count == ISC_UINT32_MAX)
 		rdataset->count = 0;
+	if (header->hits != ISC_UINT32_MAX)
+		header->hits++;
 
 	/*
 	 * Reset iterator state.
@@ -4322,7 +4419,8 @@ cache_zonecut_callback(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
 			 * the node as dirty, so it will get cleaned
 			 * up later.
 			 */
-			if ((header->rdh_ttl <  search->now - RBTDB_VIRTUAL) &&
+			if ((STALE_TTL(header, search->rbtdb) <
+			     search->now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -4446,8 +4544,8 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 				 * the node as dirty, so it will get cleaned
 				 * up later.
 				 */
-				if ((header->rdh_ttl <  search->now -
-						    RBTDB_VIRTUAL) &&
+				if ((STALE_TTL(header, search->rbtdb) <
+				     search->now - RBTDB_VIRTUAL) &&
 				    (locktype == isc_rwlocktype_write ||
 				     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 					/*
@@ -4574,8 +4672,16 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 	return (result);
 }
 
+/*
+ * Look back from where the search for 'qname' stopped for the NSEC, or
+ * with 'type' NSEC3 the NSEC3, record that may cover it.  An NSEC must
+ * be at the first name before 'qname' that has data.  An NSEC3 has a
+ * hashed owner name one label below the parent of 'qname', so names of
+ * any other shape are passed over, up to RBTDB_NSEC3_MAXSKIP of them.
+ */
 static isc_result_t
-find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
+find_coveringnsec(rbtdb_search_t *search, dns_name_t *qname,
+		  dns_rdatatype_t type, dns_dbnode_t **nodep,
 		  isc_stdtime_t now, dns_name_t *foundname,
 		  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
 {
@@ -4584,15 +4690,23 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 	rdatasetheader_t *found, *foundsig;
 	isc_boolean_t empty_node;
 	isc_result_t result;
-	dns_fixedname_t fname, forigin;
-	dns_name_t *name, *origin;
+	dns_fixedname_t fname, forigin, fnodename;
+	dns_name_t *name, *origin, *nodename, zone;
 	rbtdb_rdatatype_t matchtype, sigmatchtype;
 	nodelock_t *lock;
 	isc_rwlocktype_t locktype;
+	unsigned int labels, skipped = 0;
 
-	matchtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_nsec, 0);
-	sigmatchtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig,
-					     dns_rdatatype_nsec);
+	if (type != dns_rdatatype_nsec3)
+		type = dns_rdatatype_nsec;
+	matchtype = RBTDB_RDATATYPE_VALUE(type, 0);
+	sigmatchtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+
+	labels = dns_name_countlabels(qname);
+	if (type == dns_rdatatype_nsec3 && labels < 2)
+		return (ISC_R_NOTFOUND);
+	dns_name_init(&zone, NULL);
+	dns_name_getlabelsequence(qname, 1, labels - 1, &zone);
 
 	do {
 		node = NULL;
@@ -4604,6 +4718,24 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 						  origin, &node);
 		if (result != ISC_R_SUCCESS)
 			return (result);
+		if (type == dns_rdatatype_nsec3) {
+			dns_fixedname_init(&fnodename);
+			nodename = dns_fixedname_name(&fnodename);
+			result = dns_name_concatenate(name, origin, nodename,
+						      NULL);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+			if (!dns_name_issubdomain(nodename, &zone) ||
+			    dns_name_equal(nodename, &zone) ||
+			    skipped++ > RBTDB_NSEC3_MAXSKIP)
+				return (ISC_R_NOTFOUND);
+			if (dns_name_countlabels(nodename) != labels) {
+				result = dns_rbtnodechain_prev(&search->chain,
+							       NULL, NULL);
+				empty_node = ISC_TRUE;
+				continue;
+			}
+		}
 		locktype = isc_rwlocktype_read;
 		lock = &(search->rbtdb->node_locks[node->locknum].lock);
 		NODE_LOCK(lock, locktype);
@@ -4623,7 +4755,8 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 				 * node as dirty, so it will get cleaned up
 				 * later.
 				 */
-				if ((header->rdh_ttl <  now - RBTDB_VIRTUAL) &&
+				if ((STALE_TTL(header, search->rbtdb) <
+				     now - RBTDB_VIRTUAL) &&
 				    (locktype == isc_rwlocktype_write ||
 				     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 					/*
@@ -4679,14 +4812,18 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 			if (foundsig != NULL)
 				bind_rdataset(search->rbtdb, node, foundsig,
 					      now, sigrdataset);
-			new_reference(search->rbtdb, node);
-			*nodep = node;
+			if (nodep != NULL) {
+				new_reference(search->rbtdb, node);
+				*nodep = node;
+			}
 			result = DNS_R_COVERINGNSEC;
-		} else if (!empty_node) {
+		} else if (!empty_node && type == dns_rdatatype_nsec) {
 			result = ISC_R_NOTFOUND;
-		} else
+		} else {
+			empty_node = ISC_TRUE;
 			result = dns_rbtnodechain_prev(&search->chain, NULL,
 						       NULL);
+		}
  unlock_node:
 		NODE_UNLOCK(lock, locktype);
 	} while (empty_node && result == ISC_R_SUCCESS);
@@ -4973,8 +5110,8 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 
 	if (result == DNS_R_PARTIALMATCH) {
 		if ((search.options & DNS_DBFIND_COVERINGNSEC) != 0) {
-			result = find_coveringnsec(&search, nodep, now,
-						   foundname, rdataset,
+			result = find_coveringnsec(&search, name, type, nodep,
+						   now, foundname, rdataset,
 						   sigrdataset);
 			if (result == DNS_R_COVERINGNSEC)
 				goto tree_exit;
@@ -5022,14 +5159,22 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	header_prev = NULL;
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (header->rdh_ttl <  now) {
+		/*
+		 * An expired rdataset that is kept to be served stale is
+		 * treated as active if the caller asked for stale data.
+		 */
+		if (header->rdh_ttl <  now &&
+		    ((options & DNS_DBFIND_STALEOK) == 0 ||
+		     STALE_TTL(header, search.rbtdb) < now ||
+		     (header->attributes & RDATASET_ATTR_STALE) != 0)) {
 			/*
 			 * This rdataset is stale.  If no one else is using the
 			 * node, we can clean it up right now, otherwise we
 			 * mark it as stale, and the node as dirty, so it will
 			 * get cleaned up later.
 			 */
-			if ((header->rdh_ttl <  now - RBTDB_VIRTUAL) &&
+			if ((STALE_TTL(header, search.rbtdb) <
+			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -5336,7 +5481,8 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 			 * mark it as stale, and the node as dirty, so it will
 			 * get cleaned up later.
 			 */
-			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
+			if ((STALE_TTL(header, search.rbtdb) <
+			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -5562,7 +5708,7 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 		  isc_rwlocktype_write);
 
 	for (header = rbtnode->data; header != NULL; header = header->next)
-		if (header->rdh_ttl <= now - RBTDB_VIRTUAL) {
+		if (STALE_TTL(header, rbtdb) <= now - RBTDB_VIRTUAL) {
 			/*
 			 * We don't check if refcurrent(rbtnode) == 0 and try
 			 * to free like we do in cache_find(), because
@@ -5819,7 +5965,7 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	for (header = rbtnode->data; header != NULL; header = header_next) {
 		header_next = header->next;
 		if (header->rdh_ttl < now) {
-			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
+			if ((STALE_TTL(header, rbtdb) < now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -6329,6 +6475,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 		     header->type == dns_rdatatype_ds ||
 		     header->type == RBTDB_RDATATYPE_SIGDDS) &&
 		    !header_nx && !newheader_nx &&
+		    (options & DNS_DBADD_PREFETCH) == 0 &&
 		    header->trust >= newheader->trust &&
 		    dns_rdataslab_equal((unsigned char *)header,
 					(unsigned char *)newheader,
@@ -6658,6 +6805,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
+	newheader->hits = 0;
 	newheader->trust = rdataset->trust;
 	newheader->additional_auth = NULL;
 	newheader->additional_glue = NULL;
@@ -6747,7 +6895,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 
 		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL)
+		if (header && STALE_TTL(header, rbtdb) < now - RBTDB_VIRTUAL)
 			expire_header(rbtdb, header, tree_locked);
 
 		/*
@@ -6844,6 +6992,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
+	newheader->hits = 0;
 	newheader->additional_auth = NULL;
 	newheader->additional_glue = NULL;
 	newheader->last_used = 0;
@@ -6935,6 +7084,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->noqname = NULL;
 			newheader->closest = NULL;
 			newheader->count = 0;
+			newheader->hits = 0;
 			newheader->additional_auth = NULL;
 			newheader->additional_glue = NULL;
 			newheader->node = rbtnode;
@@ -7023,6 +7173,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		newheader->serial = 0;
 	newheader->count = 0;
+	newheader->hits = 0;
 	newheader->last_used = 0;
 	newheader->node = rbtnode;
 
@@ -7215,6 +7366,7 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
+	newheader->hits = 0;
 	newheader->additional_auth = NULL;
 	newheader->additional_glue = NULL;
 	newheader->last_used = 0;
@@ -7327,6 +7479,377 @@ dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
 #endif /* BIND9 */
 }
 
+static isc_result_t
+serialize_rdataset(FILE *file, rdatasetheader_t *header, isc_boolean_t last,
+		   off_t *offsetp)
+{
+	static const unsigned char zeros[RBTDB_IMAGE_ALIGN];
+	rdatasetheader_t temp;
+	size_t size, pad;
+	isc_result_t result;
+
+	size = dns_rdataslab_size((unsigned char *)header, sizeof(*header));
+	pad = (RBTDB_IMAGE_ALIGN - size % RBTDB_IMAGE_ALIGN) %
+		RBTDB_IMAGE_ALIGN;
+
+	/*
+	 * The header of the next rdataset follows this one.
+	 */
+	memmove(&temp, header, sizeof(temp));
+	temp.serial = 0;
+	temp.noqname = NULL;
+	temp.closest = NULL;
+	temp.next = last ? NULL :
+		(rdatasetheader_t *)(size_t)(*offsetp + size + pad);
+	temp.down = NULL;
+	temp.additional_auth = NULL;
+	temp.additional_glue = NULL;
+	temp.node = NULL;
+	temp.last_used = 0;
+	ISC_LINK_INIT(&temp, link);
+	temp.heap_index = 0;
+
+	result = isc_stdio_write(&temp, sizeof(temp), 1, file, NULL);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_write(header + 1, 1,
+					 size - sizeof(temp), file, NULL);
+	if (result == ISC_R_SUCCESS && pad != 0)
+		result = isc_stdio_write(zeros, 1, pad, file, NULL);
+	if (result == ISC_R_SUCCESS)
+		*offsetp += size + pad;
+	return (result);
+}
+
+/*
+ * dns_rbtdatawriter_t: write the rdatasets of a node that exist in
+ * the version being serialized.
+ */
+static isc_result_t
+serialize_rdatasets(FILE *file, void *data, void *arg, off_t *offsetp) {
+	rbtdb_serialize_t *sctx = arg;
+	dns_rbtdb_t *rbtdb = sctx->rbtdb;
+	rdatasetheader_t *top, *header, *pending = NULL;
+	nodelock_t *lock;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	lock = &rbtdb->node_locks[((rdatasetheader_t *)data)->node->locknum].lock;
+	NODE_LOCK(lock, isc_rwlocktype_read);
+
+	for (top = data; top != NULL; top = top->next) {
+		header = top;
+		do {
+			if (header->serial <= sctx->serial &&
+			    !IGNORE(header)) {
+				if (NONEXISTENT(header))
+					header = NULL;
+				break;
+			}
+			header = header->down;
+		} while (header != NULL);
+		if (header == NULL)
+			continue;
+		INSIST(header->noqname == NULL && header->closest == NULL);
+		if (pending != NULL) {
+			result = serialize_rdataset(file, pending, ISC_FALSE,
+						    offsetp);
+			if (result != ISC_R_SUCCESS)
+				break;
+		}
+		pending = header;
+	}
+	if (result == ISC_R_SUCCESS && pending != NULL)
+		result = serialize_rdataset(file, pending, ISC_TRUE, offsetp);
+
+	NODE_UNLOCK(lock, isc_rwlocktype_read);
+
+	return (result);
+}
+
+static void
+image_digest(rbtdb_image_header_t *header, unsigned char *digest) {
+	rbtdb_image_header_t temp;
+	isc_sha1_t sha1;
+
+	temp = *header;
+	memset(temp.digest, 0, sizeof(temp.digest));
+	isc_sha1_init(&sha1);
+	isc_sha1_update(&sha1, (unsigned char *)&temp, sizeof(temp));
+	isc_sha1_final(&sha1, digest);
+}
+
+/*
+ * Write an image of the zone to 'file': a header, then the three trees
+ * with the rdatasets of 'version' next to their nodes, laid out so that
+ * deserialize() can use them where they are mapped.
+ */
+static isc_result_t
+serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	dns_dbversion_t *current = NULL;
+	rbtdb_serialize_t sctx;
+	rbtdb_image_header_t header;
+	off_t start, offset, tree = 0, nsec = 0, nsec3 = 0;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+	INSIST(version == NULL ||
+	       ((rbtdb_version_t *)version)->rbtdb == rbtdb);
+
+	if (version == NULL) {
+		currentversion(db, &current);
+		version = current;
+	}
+
+	sctx.rbtdb = rbtdb;
+	sctx.serial = ((rbtdb_version_t *)version)->serial;
+
+	/*
+	 * The header is written last, when the roots are known.
+	 */
+	memset(&header, 0, sizeof(header));
+	result = isc_stdio_tell(file, &start);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_write(&header, sizeof(header), 1,
+					 file, NULL);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	offset = sizeof(header);
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	result = dns_rbt_serialize(rbtdb->tree, file, serialize_rdatasets,
+				   &sctx, &offset, &tree);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_serialize(rbtdb->nsec, file,
+					   serialize_rdatasets, &sctx,
+					   &offset, &nsec);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_serialize(rbtdb->nsec3, file,
+					   serialize_rdatasets, &sctx,
+					   &offset, &nsec3);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	memmove(header.magic, RBTDB_IMAGE_MAGIC, sizeof(RBTDB_IMAGE_MAGIC));
+	header.version = RBTDB_IMAGE_VERSION;
+	header.byteorder = RBTDB_IMAGE_BYTEORDER;
+	header.ptrsize = sizeof(void *);
+	header.nodesize = sizeof(dns_rbtnode_t);
+	header.headersize = sizeof(rdatasetheader_t);
+	header.serialsize = sizeof(rbtdb_serial_t);
+	header.length = offset;
+	header.tree = tree;
+	header.nsec = nsec;
+	header.nsec3 = nsec3;
+	image_digest(&header, header.digest);
+
+	result = isc_stdio_seek(file, start, SEEK_SET);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_write(&header, sizeof(header), 1,
+					 file, NULL);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_seek(file, start + offset, SEEK_SET);
+
+ cleanup:
+	if (current != NULL)
+		closeversion(db, &current, ISC_FALSE);
+	return (result);
+}
+
+/*
+ * dns_rbtdatafixer_t: make the rdatasets of a node loaded from an image
+ * part of the database's current version.  Their headers precede the
+ * node in the image.
+ */
+static isc_result_t
+deserialize_rdatasets(dns_rbtnode_t *node, void *base, size_t size,
+		      void *arg)
+{
+	dns_rbtdb_t *rbtdb = arg;
+	rdatasetheader_t *header;
+	size_t offset, next, limit;
+	isc_result_t result;
+
+	UNUSED(size);
+
+#ifdef DNS_RBT_USEHASH
+	node->locknum = node->hashval % rbtdb->node_lock_count;
+#else
+	{
+		dns_name_t name;
+
+		dns_name_init(&name, NULL);
+		dns_rbt_namefromnode(node, &name);
+		node->locknum = dns_name_hash(&name, ISC_TRUE) %
+			rbtdb->node_lock_count;
+	}
+#endif
+
+	limit = (unsigned char *)node - (unsigned char *)base;
+	for (header = node->data; header != NULL; header = header->next) {
+		offset = (unsigned char *)header - (unsigned char *)base;
+		if (offset % RBTDB_IMAGE_ALIGN != 0 ||
+		    offset + sizeof(*header) + 2 > limit ||
+		    NONEXISTENT(header) ||
+		    dns_rdataslab_size((unsigned char *)header,
+				       sizeof(*header)) > limit - offset)
+			return (ISC_R_INVALIDFILE);
+		next = (size_t)header->next;
+		if (next != 0 && (next <= offset || next >= limit))
+			return (ISC_R_INVALIDFILE);
+
+		header->next = (next != 0) ?
+			(rdatasetheader_t *)((unsigned char *)base + next) :
+			NULL;
+		header->serial = rbtdb->current_serial;
+		header->noqname = NULL;
+		header->closest = NULL;
+		header->down = NULL;
+		header->additional_auth = NULL;
+		header->additional_glue = NULL;
+		header->node = node;
+		header->last_used = 0;
+		init_rdataset(rbtdb, header);
+		if (RESIGN(header)) {
+			result = resign_insert(rbtdb, node->locknum, header);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+check_image(dns_rbtdb_t *rbtdb, rbtdb_image_header_t *header, size_t size) {
+	unsigned char digest[ISC_SHA1_DIGESTLENGTH];
+	const char *problem = NULL;
+	isc_result_t result = ISC_R_INVALIDFILE;
+	char buf[DNS_NAME_FORMATSIZE];
+
+	if (size < sizeof(*header) ||
+	    memcmp(header->magic, RBTDB_IMAGE_MAGIC,
+		   sizeof(RBTDB_IMAGE_MAGIC)) != 0)
+		problem = "no database image";
+	else {
+		image_digest(header, digest);
+		if (memcmp(digest, header->digest, sizeof(digest)) != 0)
+			problem = "image header checksum mismatch";
+		else if (header->version != RBTDB_IMAGE_VERSION ||
+			 header->byteorder != RBTDB_IMAGE_BYTEORDER ||
+			 header->ptrsize != sizeof(void *) ||
+			 header->nodesize != sizeof(dns_rbtnode_t) ||
+			 header->headersize != sizeof(rdatasetheader_t) ||
+			 header->serialsize != sizeof(rbtdb_serial_t)) {
+			problem = "image written by a different build "
+				  "or architecture";
+			result = ISC_R_NOTIMPLEMENTED;
+		} else if (header->length != size)
+			problem = "image is truncated or has trailing data";
+	}
+	if (problem == NULL)
+		return (ISC_R_SUCCESS);
+
+	dns_name_format(&rbtdb->common.origin, buf, sizeof(buf));
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+		      DNS_LOGMODULE_RBTDB, ISC_LOG_ERROR,
+		      "%s: cannot load map file: %s", buf, problem);
+	return (result);
+}
+
+/*
+ * Load the image that starts at 'offset' in 'file'.  The file is mapped
+ * privately and the image used in place: loading costs one pass that
+ * fixes the pointers of the nodes and rdataset headers and hashes the
+ * nodes, with no parsing and no allocation per record.
+ */
+static isc_result_t
+deserialize(dns_db_t *db, FILE *file, off_t offset) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_image_header_t *header;
+	dns_rbtnode_t *node = NULL;
+	unsigned char *base;
+	off_t filesize;
+	size_t size;
+	void *map = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+	REQUIRE((rbtdb->attributes & RBTDB_ATTR_LOADING) != 0);
+	REQUIRE(rbtdb->mmap_location == NULL);
+
+	/*
+	 * Policy zones index their addresses as records are added.
+	 */
+	if (rbtdb->rpz_cidr != NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	result = isc_file_getsizefd(fileno(file), &filesize);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	if (offset % RBTDB_IMAGE_ALIGN != 0 ||
+	    filesize < offset + (off_t)sizeof(*header))
+		return (ISC_R_INVALIDFILE);
+
+	size = (size_t)filesize;
+	result = isc_file_mmap(fileno(file), size, &map);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	rbtdb->mmap_location = map;
+	rbtdb->mmap_size = size;
+
+	base = (unsigned char *)map + offset;
+	size -= (size_t)offset;
+	header = (rbtdb_image_header_t *)base;
+	result = check_image(rbtdb, header, size);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+
+	/*
+	 * The image has its own origin nodes.
+	 */
+	result = dns_rbt_deletenode(rbtdb->tree, rbtdb->origin_node,
+				    ISC_FALSE);
+	INSIST(result == ISC_R_SUCCESS);
+	rbtdb->origin_node = NULL;
+	result = dns_rbt_findnode(rbtdb->nsec3, &rbtdb->common.origin, NULL,
+				  &node, NULL, DNS_RBTFIND_EMPTYDATA,
+				  NULL, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	result = dns_rbt_deletenode(rbtdb->nsec3, node, ISC_FALSE);
+	INSIST(result == ISC_R_SUCCESS);
+	node = NULL;
+
+	result = dns_rbt_deserialize(rbtdb->tree, base, size,
+				     (off_t)header->tree,
+				     deserialize_rdatasets, rbtdb);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_deserialize(rbtdb->nsec, base, size,
+					     (off_t)header->nsec,
+					     deserialize_rdatasets, rbtdb);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_deserialize(rbtdb->nsec3, base, size,
+					     (off_t)header->nsec3,
+					     deserialize_rdatasets, rbtdb);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rbt_findnode(rbtdb->tree, &rbtdb->common.origin,
+					  NULL, &node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+		if (result == ISC_R_SUCCESS)
+			rbtdb->origin_node = node;
+		else
+			result = ISC_R_INVALIDFILE;
+	}
+
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
 static void
 delete_callback(void *data, void *arg) {
 	dns_rbtdb_t *rbtdb = arg;
@@ -7620,6 +8143,28 @@ getrrsetstats(dns_db_t *db) {
 	return (rbtdb->rrsetstats);
 }
 
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	rbtdb->serve_stale_ttl = ttl;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	*ttl = rbtdb->serve_stale_ttl;
+	return (ISC_R_SUCCESS);
+}
+
 static dns_dbmethods_t zone_methods = {
 	attach,
 	detach,
@@ -7664,6 +8209,10 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 	NULL,
 #endif
+	NULL,
+	NULL,
+	serialize,
+	deserialize,
 	NULL,
 	NULL
 };
@@ -7708,39 +8257,35 @@ static dns_dbmethods_t cache_methods = {
 	NULL,
 	NULL,
 	NULL,
-	NULL
+	NULL,
+	NULL,
+	NULL,
+	setservestalettl,
+	getservestalettl
 };
 
-isc_result_t
-#ifdef DNS_RBTDB_VERSION64
-dns_rbtdb64_create
-#else
-dns_rbtdb_create
-#endif
-		(isc_mem_t *mctx, dns_name_t *origin, dns_dbtype_t type,
-		 dns_rdataclass_t rdclass, unsigned int argc, char *argv[],
-		 void *driverarg, dns_db_t **dbp)
+/*
+ * Create an RBT database.  'nodelocks' is the number of node locks, or
+ * 0 for the default.  Every node of the database's trees is tagged with
+ * 'tag'.  If 'rrsetstats' is not NULL, a cache database counts its
+ * RRsets there instead of in statistics of its own.
+ */
+static isc_result_t
+create_rbtdb(isc_mem_t *mctx, isc_mem_t *hmctx, dns_name_t *origin,
+	     dns_dbtype_t type, dns_rdataclass_t rdclass,
+	     unsigned int nodelocks, unsigned int tag,
+	     dns_stats_t *rrsetstats, dns_db_t **dbp)
 {
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
 	int i;
 	dns_name_t name;
 	isc_boolean_t (*sooner)(void *, void *);
-	isc_mem_t *hmctx = mctx;
-
-	/* Keep the compiler happy. */
-	UNUSED(driverarg);
 
 	rbtdb = isc_mem_get(mctx, sizeof(*rbtdb));
 	if (rbtdb == NULL)
 		return (ISC_R_NOMEMORY);
 
-	/*
-	 * If argv[0] exists, it points to a memory context to use for heap
-	 */
-	if (argc != 0)
-		hmctx = (isc_mem_t *) argv[0];
-
 	memset(rbtdb, '\0', sizeof(*rbtdb));
 	dns_name_init(&rbtdb->common.origin, NULL);
 	rbtdb->common.attributes = 0;
@@ -7764,11 +8309,11 @@ dns_rbtdb_create
 		goto cleanup_lock;
 
 	/*
-	 * Initialize node_lock_count in a generic way to support future
-	 * extension which allows the user to specify this value on creation.
-	 * Note that when specified for a cache DB it must be larger than 1
-	 * as commented with the definition of DEFAULT_CACHE_NODE_LOCK_COUNT.
+	 * Note that when node_lock_count is specified for a cache DB it
+	 * must be larger than 1 as commented with the definition of
+	 * DEFAULT_CACHE_NODE_LOCK_COUNT.
 	 */
+	rbtdb->node_lock_count = nodelocks;
 	if (rbtdb->node_lock_count == 0) {
 		if (IS_CACHE(rbtdb))
 			rbtdb->node_lock_count = DEFAULT_CACHE_NODE_LOCK_COUNT;
@@ -7788,9 +8333,14 @@ dns_rbtdb_create
 
 	rbtdb->rrsetstats = NULL;
 	if (IS_CACHE(rbtdb)) {
-		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
-		if (result != ISC_R_SUCCESS)
-			goto cleanup_node_locks;
+		if (rrsetstats != NULL)
+			dns_stats_attach(rrsetstats, &rbtdb->rrsetstats);
+		else {
+			result = dns_rdatasetstats_create(mctx,
+							  &rbtdb->rrsetstats);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup_node_locks;
+		}
 		rbtdb->rdatasets = isc_mem_get(mctx, rbtdb->node_lock_count *
 					       sizeof(rdatasetheaderlist_t));
 		if (rbtdb->rdatasets == NULL) {
@@ -7896,6 +8446,22 @@ dns_rbtdb_create
 		return (result);
 	}
 
+	dns_rbt_settag(rbtdb->tree, tag);
+	dns_rbt_settag(rbtdb->nsec, tag);
+	dns_rbt_settag(rbtdb->nsec3, tag);
+
+	/*
+	 * Most lookups in a zone are for names that exist, so the main
+	 * tree of a zone gets an exact match index.
+	 */
+	if (!IS_CACHE(rbtdb)) {
+		result = dns_rbt_setindex(rbtdb->tree, ISC_TRUE);
+		if (result != ISC_R_SUCCESS) {
+			free_rbtdb(rbtdb, ISC_FALSE, NULL);
+			return (result);
+		}
+	}
+
 	/*
 	 * In order to set the node callback bit correctly in zone databases,
 	 * we need to know if the node has the origin name of the zone.
@@ -8004,6 +8570,7 @@ dns_rbtdb_create
 	 */
 	PREPEND(rbtdb->open_versions, rbtdb->current_version, link);
 
+	rbtdb->common.generation = 0;
 	rbtdb->common.magic = DNS_DB_MAGIC;
 	rbtdb->common.impmagic = RBTDB_MAGIC;
 
@@ -8047,6 +8614,63 @@ dns_rbtdb_create
 	return (result);
 }
 
+static isc_result_t
+create_shard(isc_mem_t *mctx, isc_mem_t *hmctx, dns_name_t *origin,
+	     dns_rdataclass_t rdclass, unsigned int nodelocks,
+	     unsigned int shard, dns_stats_t *rrsetstats, dns_db_t **dbp)
+{
+	return (create_rbtdb(mctx, hmctx, origin, dns_dbtype_cache, rdclass,
+			     nodelocks, shard, rrsetstats, dbp));
+}
+
+isc_result_t
+#ifdef DNS_RBTDB_VERSION64
+dns_rbtdb64_create
+#else
+dns_rbtdb_create
+#endif
+		(isc_mem_t *mctx, dns_name_t *origin, dns_dbtype_t type,
+		 dns_rdataclass_t rdclass, unsigned int argc, char *argv[],
+		 void *driverarg, dns_db_t **dbp)
+{
+	isc_result_t result;
+	isc_mem_t *hmctx = mctx;
+	isc_uint32_t nodelocks = 0, shards = 1;
+
+	/* Keep the compiler happy. */
+	UNUSED(driverarg);
+
+	/*
+	 * If argv[0] exists, it points to a memory context to use for heap.
+	 * A cache database also takes the number of node locks (0 for the
+	 * default) and the number of shards from argv[1] and argv[2].
+	 */
+	if (argc != 0)
+		hmctx = (isc_mem_t *) argv[0];
+	if (type == dns_dbtype_cache && argc > 1) {
+		result = isc_parse_uint32(&nodelocks, argv[1], 10);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (nodelocks >= (1 << DNS_RBT_LOCKLENGTH))
+			return (ISC_R_RANGE);
+	}
+	if (type == dns_dbtype_cache && argc > 2) {
+		result = isc_parse_uint32(&shards, argv[2], 10);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (shards == 0 || shards > DNS_SHARDCACHE_MAXSHARDS)
+			return (ISC_R_RANGE);
+	}
+
+	if (shards > 1)
+		return (dns_shardcache_create(mctx, hmctx, origin, rdclass,
+					      shards, nodelocks, create_shard,
+					      dbp));
+
+	return (create_rbtdb(mctx, hmctx, origin, type, rdclass, nodelocks, 0,
+			     NULL, dbp));
+}
+
 
 /*
  * Slabbed Rdataset Methods
@@ -8315,6 +8939,29 @@ rdataset_expire(dns_rdataset_t *rdataset) {
 		  isc_rwlocktype_write);
 }
 
+static isc_boolean_t
+rdataset_prefetch(dns_rdataset_t *rdataset, unsigned int hits) {
+	dns_rbtdb_t *rbtdb = rdataset->private1;
+	dns_rbtnode_t *rbtnode = rdataset->private2;
+	rdatasetheader_t *header = rdataset->private3;
+	isc_boolean_t prefetch = ISC_FALSE;
+
+	if (!IS_CACHE(rbtdb))
+		return (ISC_FALSE);
+
+	header--;
+	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+		  isc_rwlocktype_write);
+	if (!PREFETCH(header) && header->hits >= hits &&
+	    (header->attributes & RDATASET_ATTR_STALE) == 0) {
+		header->attributes |= RDATASET_ATTR_PREFETCH;
+		prefetch = ISC_TRUE;
+	}
+	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+		  isc_rwlocktype_write);
+	return (prefetch);
+}
+
 /*
  * Rdataset Iterator Methods
  */
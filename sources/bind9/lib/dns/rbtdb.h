@@ -47,9 +47,22 @@ dns_rbtdb_create(isc_mem_t *mctx, dns_name_t *base, dns_dbtype_t type,
  * allocation of heap memory.  Generally this is used for cache databases
  * only.
  *
+ * A cache database takes two further optional arguments, given as decimal
+ * strings: argv[1] is the number of node locks (0 selects the default),
+ * and argv[2] is the number of shards.  With more than one shard the
+ * cache is split into that many independent RBT databases, each with its
+ * own tree lock; see shardcache.h.
+ *
  * Requires:
  *
  * \li argc == 0 or argv[0] is a valid memory context.
+ *
+ * Returns:
+ *
+ * \li #ISC_R_SUCCESS
+ * \li #ISC_R_RANGE if the node lock count or the shard count is out of
+ *     range.
+ * \li Other results from isc_parse_uint32() or on memory exhaustion.
  */
 
 ISC_LANG_ENDDECLS
@@ -48,6 +48,7 @@ static dns_rdatasetmethods_t methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
@@ -96,6 +97,7 @@ dns_rdatalist_tordataset(dns_rdatalist_t *rdatalist,
     methods.putadditional = NULL;
     methods.settrust      = NULL;
     methods.expire        = NULL;
+    methods.prefetch      = NULL;
     //
 	rdataset->methods = &methods;
 	rdataset->rdclass = rdatalist->rdclass;
@@ -206,6 +206,7 @@ static dns_rdatasetmethods_t question_methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
@@ -237,6 +238,7 @@ dns_rdataset_makequestion(dns_rdataset_t *rdataset, dns_rdataclass_t rdclass,
     question_methods.putadditional = NULL;
     question_methods.settrust      = NULL;
     question_methods.expire        = NULL;
+    question_methods.prefetch      = NULL;
     //
 	rdataset->methods = &question_methods;
 	rdataset->rdclass = rdclass;
@@ -790,6 +792,16 @@ dns_rdataset_expire(dns_rdataset_t *rdataset) {
 		(rdataset->methods->expire)(rdataset);
 }
 
+isc_boolean_t
+dns_rdataset_prefetch(dns_rdataset_t *rdataset, unsigned int hits) {
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->methods != NULL);
+
+	if (rdataset->methods->prefetch != NULL)
+		return ((rdataset->methods->prefetch)(rdataset, hits));
+	return (ISC_FALSE);
+}
+
 void
 dns_rdataset_trimttl(dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
 		     dns_rdata_rrsig_t *rrsig, isc_stdtime_t now,
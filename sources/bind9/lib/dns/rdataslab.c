@@ -466,6 +466,7 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
@@ -493,6 +494,7 @@ dns_rdataslab_tordataset(unsigned char *slab, unsigned int reservelen,
     rdataset_methods.putadditional = NULL;
     rdataset_methods.settrust      = NULL;
     rdataset_methods.expire        = NULL;
+    rdataset_methods.prefetch      = NULL;
     //
 	rdataset->methods = &rdataset_methods;
 	rdataset->rdclass = rdclass;
@@ -30,6 +30,7 @@
 #include <isc/socket.h>
 #include <isc/stats.h>
 #include <isc/task.h>
+#include <isc/taskpool.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -434,6 +435,7 @@ struct dns_resolver {
 	unsigned int			query_timeout;
 	unsigned int			maxdepth;
 	unsigned int			maxqueries;
+	isc_taskpool_t *		verifytasks;
 
 	/* Locked by lock. */
 	unsigned int			references;
@@ -4045,6 +4047,18 @@ clone_results(fetchctx_t *fctx) {
 #define CHASE(r)        (((r)->attributes & DNS_RDATASETATTR_CHASE) != 0)
 #define CHECKNAMES(r)   (((r)->attributes & DNS_RDATASETATTR_CHECKNAMES) != 0)
 
+/*
+ * The dns_db_addrdataset() options 'rdataset' is cached with.  The
+ * answer to a prefetch replaces the cached answer even when the data
+ * is the same, so that its TTL is refreshed.
+ */
+static inline unsigned int
+cache_options(fetchctx_t *fctx, dns_rdataset_t *rdataset) {
+	if ((fctx->options & DNS_FETCHOPT_PREFETCH) != 0 &&
+	    (ANSWER(rdataset) || ANSWERSIG(rdataset)))
+		return (DNS_DBADD_PREFETCH);
+	return (0);
+}
 
 /*
  * Destroy '*fctx' if it is ready to be destroyed (i.e., if it has
@@ -4090,6 +4104,74 @@ maybe_destroy(fetchctx_t *fctx, isc_boolean_t locked) {
 	return (bucket_empty);
 }
 
+/*
+ * Cache the SOA, NSEC and NSEC3 records that the validator proved secure
+ * while validating a negative response.  The negative cache entry only
+ * answers for the name and type that was asked; cached on their own
+ * these records let query processing prove the nonexistence of other
+ * names in the same ranges.  They are kept no longer than negative
+ * answers are.
+ */
+static void
+cache_negproofs(fetchctx_t *fctx, isc_stdtime_t now) {
+	dns_name_t *name;
+	dns_rdataset_t *rdataset, *sigrdataset;
+	dns_dbnode_t *node;
+	isc_result_t result;
+	dns_ttl_t maxttl = fctx->res->view->maxncachettl;
+
+	for (result = dns_message_firstname(fctx->rmessage,
+					    DNS_SECTION_AUTHORITY);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(fctx->rmessage,
+					   DNS_SECTION_AUTHORITY))
+	{
+		name = NULL;
+		dns_message_currentname(fctx->rmessage, DNS_SECTION_AUTHORITY,
+					&name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+		{
+			if ((rdataset->type != dns_rdatatype_soa &&
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_nsec3) ||
+			    rdataset->trust != dns_trust_secure)
+				continue;
+			for (sigrdataset = ISC_LIST_HEAD(name->list);
+			     sigrdataset != NULL;
+			     sigrdataset = ISC_LIST_NEXT(sigrdataset, link))
+			{
+				if (sigrdataset->type == dns_rdatatype_rrsig &&
+				    sigrdataset->covers == rdataset->type)
+					break;
+			}
+			if (sigrdataset == NULL ||
+			    sigrdataset->trust != dns_trust_secure)
+				continue;
+
+			if (rdataset->ttl > maxttl)
+				rdataset->ttl = maxttl;
+			if (sigrdataset->ttl > rdataset->ttl)
+				sigrdataset->ttl = rdataset->ttl;
+
+			node = NULL;
+			result = dns_db_findnode(fctx->cache, name, ISC_TRUE,
+						 &node);
+			if (result != ISC_R_SUCCESS)
+				continue;
+			result = dns_db_addrdataset(fctx->cache, node, NULL,
+						    now, rdataset, 0, NULL);
+			if (result == ISC_R_SUCCESS ||
+			    result == DNS_R_UNCHANGED)
+				(void)dns_db_addrdataset(fctx->cache, node,
+							 NULL, now,
+							 sigrdataset, 0, NULL);
+			dns_db_detachnode(fctx->cache, &node);
+		}
+	}
+}
+
 /*
  * The validator has finished.
  */
@@ -4320,6 +4402,8 @@ validated(isc_task_t *task, isc_event_t *event) {
 					   vevent->secure, ardataset, &eresult);
 		if (result != ISC_R_SUCCESS)
 			goto noanswer_response;
+		if (vevent->secure && res->view->synthfromdnssec)
+			cache_negproofs(fctx, now);
 		goto answer_response;
 	} else
 		inc_stats(res, dns_resstatscounter_valsuccess);
@@ -4362,7 +4446,9 @@ validated(isc_task_t *task, isc_event_t *event) {
 		goto noanswer_response;
 
 	result = dns_db_addrdataset(fctx->cache, node, NULL, now,
-				    vevent->rdataset, 0, ardataset);
+				    vevent->rdataset,
+				    cache_options(fctx, vevent->rdataset),
+				    ardataset);
 	if (result != ISC_R_SUCCESS &&
 	    result != DNS_R_UNCHANGED)
 		goto noanswer_response;
@@ -4373,7 +4459,9 @@ validated(isc_task_t *task, isc_event_t *event) {
 			eresult = DNS_R_NCACHENXRRSET;
 	} else if (vevent->sigrdataset != NULL) {
 		result = dns_db_addrdataset(fctx->cache, node, NULL, now,
-					    vevent->sigrdataset, 0,
+					    vevent->sigrdataset,
+					    cache_options(fctx,
+							  vevent->sigrdataset),
 					    asigrdataset);
 		if (result != ISC_R_SUCCESS &&
 		    result != DNS_R_UNCHANGED)
@@ -4856,7 +4944,9 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 				addedrdataset = ardataset;
 				result = dns_db_addrdataset(fctx->cache, node,
 							    NULL, now, rdataset,
-							    0, addedrdataset);
+							    cache_options(fctx,
+								     rdataset),
+							    addedrdataset);
 				if (result == DNS_R_UNCHANGED) {
 					result = ISC_R_SUCCESS;
 					if (!need_validation &&
@@ -4890,7 +4980,9 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 					addedrdataset = asigrdataset;
 					result = dns_db_addrdataset(fctx->cache,
 								node, NULL, now,
-								sigrdataset, 0,
+								sigrdataset,
+								cache_options(fctx,
+								   sigrdataset),
 								addedrdataset);
 					if (result == DNS_R_UNCHANGED)
 						result = ISC_R_SUCCESS;
@@ -4980,6 +5072,7 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 				options = DNS_DBADD_FORCE;
 			} else
 				options = 0;
+			options |= cache_options(fctx, rdataset);
 
 			if (ANSWER(rdataset) &&
 			   rdataset->type != dns_rdatatype_rrsig) {
@@ -7733,6 +7826,8 @@ destroy(dns_resolver_t *res) {
 	}
 	isc_mem_put(res->mctx, res->buckets,
 		    res->nbuckets * sizeof(fctxbucket_t));
+	if (res->verifytasks != NULL)
+		isc_taskpool_destroy(&res->verifytasks);
 	if (res->dispatches4 != NULL)
 		dns_dispatchset_destroy(&res->dispatches4);
 	if (res->dispatches6 != NULL)
@@ -7882,6 +7977,7 @@ dns_resolver_create(dns_view_t *view,
 	res->query_timeout = DEFAULT_QUERY_TIMEOUT;
 	res->maxdepth = DEFAULT_RECURSION_DEPTH;
 	res->maxqueries = DEFAULT_MAX_QUERIES;
+	res->verifytasks = NULL;
 	res->nbuckets = ntasks;
 	res->activebuckets = ntasks;
 	res->buckets = isc_mem_get(view->mctx,
@@ -9253,3 +9349,32 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver) {
 	REQUIRE(VALID_RESOLVER(resolver));
 	return (resolver->maxqueries);
 }
+
+isc_result_t
+dns_resolver_setverifytasks(dns_resolver_t *resolver, unsigned int ntasks) {
+	isc_taskpool_t *pool = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(!resolver->frozen);
+
+	if (ntasks != 0) {
+		result = isc_taskpool_create(resolver->taskmgr,
+					     resolver->mctx, ntasks, 1, &pool);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	if (resolver->verifytasks != NULL)
+		isc_taskpool_destroy(&resolver->verifytasks);
+	resolver->verifytasks = pool;
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_resolver_getverifytask(dns_resolver_t *resolver, isc_task_t **taskp) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(taskp != NULL && *taskp == NULL);
+
+	if (resolver->verifytasks != NULL)
+		isc_taskpool_gettask(resolver->verifytasks, taskp);
+}
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#define RESPCACHE_MAGIC		ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(c)	ISC_MAGIC_VALID(c, RESPCACHE_MAGIC)
+
+#define RESPCACHE_SHARDS	16
+
+/*%
+ * The hash table of each shard starts with MIN_BUCKETS buckets and is
+ * doubled whenever it holds more than MAX_CHAIN entries a bucket.
+ */
+#define MAX_CHAIN		2
+#define MIN_BUCKETS		64
+#define MAX_BUCKETS		(1U << 20)
+
+typedef struct respentry respentry_t;
+
+/*%
+ * The owner name of the key and then the response follow the entry.
+ */
+struct respentry {
+	ISC_LINK(respentry_t)	hlink;
+	ISC_LINK(respentry_t)	lrulink;
+	isc_uint32_t		hashval;
+	isc_uint32_t		generation;
+	dns_rdatatype_t		type;
+	dns_rdataclass_t	rdclass;
+	unsigned int		flags;
+	unsigned int		size;
+	unsigned int		namelen;
+	unsigned int		length;
+};
+
+typedef ISC_LIST(respentry_t) resplist_t;
+
+#define ENTRY_NAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_RESPONSE(e)	(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)		(sizeof(respentry_t) + (e)->namelen + \
+				 (e)->length)
+
+typedef struct {
+	isc_mutex_t		lock;
+	resplist_t *		table;
+	unsigned int		nbuckets;	/* a power of two */
+	ISC_LIST(respentry_t)	lru;		/* most recent first */
+	size_t			used;
+	size_t			limit;
+	unsigned int		count;
+} respshard_t;
+
+struct dns_respcache {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	isc_refcount_t		references;
+	respshard_t		shards[RESPCACHE_SHARDS];
+};
+
+/*
+ * FNV-1a over the name and the rest of the key.
+ */
+static isc_uint32_t
+hashkey(const dns_respkey_t *key) {
+	isc_uint32_t h = 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < key->name->length; i++) {
+		h ^= key->name->ndata[i];
+		h *= 16777619U;
+	}
+	h ^= key->type;
+	h *= 16777619U;
+	h ^= key->rdclass ^ (key->flags << 16);
+	h *= 16777619U;
+	h ^= key->size;
+	h *= 16777619U;
+	return (h);
+}
+
+static inline isc_boolean_t
+matches(respentry_t *entry, const dns_respkey_t *key, isc_uint32_t hashval) {
+	return (ISC_TF(entry->hashval == hashval &&
+		       entry->type == key->type &&
+		       entry->rdclass == key->rdclass &&
+		       entry->flags == key->flags &&
+		       entry->size == key->size &&
+		       entry->namelen == key->name->length &&
+		       memcmp(ENTRY_NAME(entry), key->name->ndata,
+			      entry->namelen) == 0));
+}
+
+static inline respshard_t *
+getshard(dns_respcache_t *cache, isc_uint32_t hashval) {
+	return (&cache->shards[hashval % RESPCACHE_SHARDS]);
+}
+
+static inline unsigned int
+hashbucket(unsigned int nbuckets, isc_uint32_t hashval) {
+	return ((hashval / RESPCACHE_SHARDS) & (nbuckets - 1));
+}
+
+static inline unsigned int
+bucket(respshard_t *shard, isc_uint32_t hashval) {
+	return (hashbucket(shard->nbuckets, hashval));
+}
+
+/*
+ * Unlink 'entry' from 'shard' and free it.  The shard must be locked.
+ */
+static void
+unlinkentry(dns_respcache_t *cache, respshard_t *shard, respentry_t *entry) {
+	ISC_LIST_UNLINK(shard->table[bucket(shard, entry->hashval)],
+			entry, hlink);
+	ISC_LIST_UNLINK(shard->lru, entry, lrulink);
+	INSIST(shard->used >= ENTRY_SIZE(entry) && shard->count > 0);
+	shard->used -= ENTRY_SIZE(entry);
+	shard->count--;
+	isc_mem_put(cache->mctx, entry, ENTRY_SIZE(entry));
+}
+
+static respentry_t *
+findentry(respshard_t *shard, const dns_respkey_t *key, isc_uint32_t hashval)
+{
+	respentry_t *entry;
+
+	for (entry = ISC_LIST_HEAD(shard->table[bucket(shard, hashval)]);
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, hlink))
+	{
+		if (matches(entry, key, hashval))
+			return (entry);
+	}
+	return (NULL);
+}
+
+/*
+ * Double the hash table of 'shard' if it has become too full.  If the
+ * memory for that cannot be had the chains just get longer.  The shard
+ * must be locked.
+ */
+static void
+growshard(dns_respcache_t *cache, respshard_t *shard) {
+	resplist_t *table;
+	respentry_t *entry;
+	unsigned int i, nbuckets;
+
+	if (shard->count <= shard->nbuckets * MAX_CHAIN ||
+	    shard->nbuckets >= MAX_BUCKETS)
+		return;
+
+	nbuckets = shard->nbuckets * 2;
+	table = isc_mem_get(cache->mctx, nbuckets * sizeof(*table));
+	if (table == NULL)
+		return;
+	for (i = 0; i < nbuckets; i++)
+		ISC_LIST_INIT(table[i]);
+
+	/*
+	 * Every entry is on the LRU list; walking it from the most
+	 * recently used end keeps each new chain in that order.
+	 */
+	for (entry = ISC_LIST_HEAD(shard->lru);
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, lrulink))
+	{
+		ISC_LIST_UNLINK(shard->table[bucket(shard, entry->hashval)],
+				entry, hlink);
+		ISC_LIST_APPEND(table[hashbucket(nbuckets, entry->hashval)],
+				entry, hlink);
+	}
+
+	isc_mem_put(cache->mctx, shard->table,
+		    shard->nbuckets * sizeof(*shard->table));
+	shard->table = table;
+	shard->nbuckets = nbuckets;
+}
+
+static void
+flushshard(dns_respcache_t *cache, respshard_t *shard) {
+	respentry_t *entry;
+
+	while ((entry = ISC_LIST_HEAD(shard->lru)) != NULL)
+		unlinkentry(cache, shard, entry);
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t size, dns_respcache_t **cachep)
+{
+	dns_respcache_t *cache;
+	respshard_t *shard;
+	isc_result_t result;
+	unsigned int i, j;
+	size_t limit;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size != 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_cache;
+
+	limit = size / RESPCACHE_SHARDS;
+	if (limit == 0)
+		limit = 1;
+
+	for (i = 0; i < RESPCACHE_SHARDS; i++) {
+		shard = &cache->shards[i];
+		shard->table = isc_mem_get(mctx,
+					   MIN_BUCKETS * sizeof(*shard->table));
+		if (shard->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_shards;
+		}
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, shard->table,
+				    MIN_BUCKETS * sizeof(*shard->table));
+			goto cleanup_shards;
+		}
+		for (j = 0; j < MIN_BUCKETS; j++)
+			ISC_LIST_INIT(shard->table[j]);
+		shard->nbuckets = MIN_BUCKETS;
+		ISC_LIST_INIT(shard->lru);
+		shard->used = 0;
+		shard->limit = limit;
+		shard->count = 0;
+	}
+
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = RESPCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_shards:
+	while (i-- > 0) {
+		shard = &cache->shards[i];
+		DESTROYLOCK(&shard->lock);
+		isc_mem_put(mctx, shard->table,
+			    shard->nbuckets * sizeof(*shard->table));
+	}
+	isc_refcount_destroy(&cache->references);
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp) {
+	REQUIRE(VALID_RESPCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_respcache_detach(dns_respcache_t **cachep) {
+	dns_respcache_t *cache;
+	respshard_t *shard;
+	unsigned int i, references;
+
+	REQUIRE(cachep != NULL);
+	cache = *cachep;
+	REQUIRE(VALID_RESPCACHE(cache));
+
+	*cachep = NULL;
+	isc_refcount_decrement(&cache->references, &references);
+	if (references != 0)
+		return;
+
+	cache->magic = 0;
+	for (i = 0; i < RESPCACHE_SHARDS; i++) {
+		shard = &cache->shards[i];
+		flushshard(cache, shard);
+		DESTROYLOCK(&shard->lock);
+		isc_mem_put(cache->mctx, shard->table,
+			    shard->nbuckets * sizeof(*shard->table));
+	}
+	isc_refcount_destroy(&cache->references);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_respkey_t *key,
+		   isc_uint32_t generation, isc_buffer_t *target)
+{
+	respshard_t *shard;
+	respentry_t *entry;
+	isc_uint32_t hashval;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->name));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	hashval = hashkey(key);
+	shard = getshard(cache, hashval);
+
+	LOCK(&shard->lock);
+	entry = findentry(shard, key, hashval);
+	if (entry == NULL) {
+		result = ISC_R_NOTFOUND;
+	} else if (entry->generation != generation) {
+		unlinkentry(cache, shard, entry);
+		result = ISC_R_NOTFOUND;
+	} else if (entry->length > isc_buffer_availablelength(target)) {
+		result = ISC_R_NOSPACE;
+	} else {
+		isc_buffer_putmem(target, ENTRY_RESPONSE(entry),
+				  entry->length);
+		if (entry != ISC_LIST_HEAD(shard->lru)) {
+			ISC_LIST_UNLINK(shard->lru, entry, lrulink);
+			ISC_LIST_PREPEND(shard->lru, entry, lrulink);
+		}
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK(&shard->lock);
+
+	return (result);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, const dns_respkey_t *key,
+		  isc_uint32_t generation, isc_region_t *response)
+{
+	respshard_t *shard;
+	respentry_t *entry, *old;
+	isc_uint32_t hashval;
+	size_t size;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->name));
+	REQUIRE(response != NULL);
+
+	hashval = hashkey(key);
+	shard = getshard(cache, hashval);
+
+	size = sizeof(*entry) + key->name->length + response->length;
+	if (size > shard->limit)
+		return (ISC_R_NOSPACE);
+
+	entry = isc_mem_get(cache->mctx, size);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+	ISC_LINK_INIT(entry, hlink);
+	ISC_LINK_INIT(entry, lrulink);
+	entry->hashval = hashval;
+	entry->generation = generation;
+	entry->type = key->type;
+	entry->rdclass = key->rdclass;
+	entry->flags = key->flags;
+	entry->size = key->size;
+	entry->namelen = key->name->length;
+	entry->length = response->length;
+	memmove(ENTRY_NAME(entry), key->name->ndata, entry->namelen);
+	memmove(ENTRY_RESPONSE(entry), response->base, entry->length);
+
+	LOCK(&shard->lock);
+	old = findentry(shard, key, hashval);
+	if (old != NULL)
+		unlinkentry(cache, shard, old);
+	while (shard->used + size > shard->limit)
+		unlinkentry(cache, shard, ISC_LIST_TAIL(shard->lru));
+	ISC_LIST_PREPEND(shard->table[bucket(shard, hashval)], entry, hlink);
+	ISC_LIST_PREPEND(shard->lru, entry, lrulink);
+	shard->used += size;
+	shard->count++;
+	growshard(cache, shard);
+	UNLOCK(&shard->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *cache) {
+	respshard_t *shard;
+	unsigned int i;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+
+	for (i = 0; i < RESPCACHE_SHARDS; i++) {
+		shard = &cache->shards[i];
+		LOCK(&shard->lock);
+		flushshard(cache, shard);
+		UNLOCK(&shard->lock);
+	}
+}
+
+unsigned int
+dns_respcache_count(dns_respcache_t *cache) {
+	respshard_t *shard;
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+
+	for (i = 0; i < RESPCACHE_SHARDS; i++) {
+		shard = &cache->shards[i];
+		LOCK(&shard->lock);
+		count += shard->count;
+		UNLOCK(&shard->lock);
+	}
+	return (count);
+}
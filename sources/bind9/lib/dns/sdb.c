@@ -1298,7 +1298,11 @@ static dns_dbmethods_t sdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	findnodeext,
-	findext
+	findext,
+	NULL,			/* serialize */
+	NULL,			/* deserialize */
+	NULL,			/* setservestalettl */
+	NULL			/* getservestalettl */
 };
 
 static isc_result_t
@@ -1365,6 +1369,7 @@ dns_sdb_create(isc_mem_t *mctx, dns_name_t *origin, dns_dbtype_t type,
 
 	sdb->references = 1;
 
+	sdb->common.generation = 0;
 	sdb->common.magic = DNS_DB_MAGIC;
 	sdb->common.impmagic = SDB_MAGIC;
 
@@ -1427,6 +1432,7 @@ static dns_rdatasetmethods_t methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
@@ -1462,6 +1468,7 @@ list_tordataset(dns_rdatalist_t *rdatalist,
     methods.putadditional = NULL;
     methods.settrust      = NULL;
     methods.expire        = NULL;
+    methods.prefetch      = NULL;
     //
 	rdataset->methods = &methods;
 	dns_db_attachnode(db, node, &rdataset->private5);
@@ -1263,7 +1263,11 @@ static dns_dbmethods_t sdlzdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	findnodeext,
-	findext
+	findext,
+	NULL,			/* serialize */
+	NULL,			/* deserialize */
+	NULL,			/* setservestalettl */
+	NULL			/* getservestalettl */
 };
 
 /*
@@ -1412,6 +1416,7 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
@@ -1447,6 +1452,7 @@ list_tordataset(dns_rdatalist_t *rdatalist,
     rdataset_methods.putadditional = NULL;
     rdataset_methods.settrust      = NULL;
     rdataset_methods.expire        = NULL;
+    rdataset_methods.prefetch      = NULL;
     //
     rdataset->methods = &rdataset_methods;
 	dns_db_attachnode(db, node, &rdataset->private5);
@@ -1507,6 +1513,7 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	isc_mem_attach(mctx, &sdlzdb->common.mctx);
 
 	/* mark structure as valid */
+	sdlzdb->common.generation = 0;
 	sdlzdb->common.magic = DNS_DB_MAGIC;
 	sdlzdb->common.impmagic = SDLZDB_MAGIC;
 	*dbp = (dns_db_t *) sdlzdb;
@@ -0,0 +1,1145 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+#include <dns/stats.h>
+
+#include "shardcache.h"
+
+#define SHARDCACHE_MAGIC	ISC_MAGIC('S', 'H', 'C', 'D')
+#define VALID_SHARDCACHE(db)	((db) != NULL && \
+				 (db)->common.impmagic == SHARDCACHE_MAGIC)
+
+typedef struct {
+	/* Unlocked. */
+	dns_db_t			common;
+	isc_refcount_t			references;
+	unsigned int			nshards;
+	dns_db_t **			shards;
+	dns_stats_t *			rrsetstats;
+	/*
+	 * The shards have versions of their own; callers are handed the
+	 * address of this as the only version of the whole cache.
+	 */
+	int				version;
+} shardcache_t;
+
+typedef struct {
+	shardcache_t *			sdb;
+	dns_addrdatasetfunc_t *		adds;
+	dns_dbload_t **			loads;
+} shardload_t;
+
+/*%
+ * Where one shard's iterator stands.
+ */
+typedef struct {
+	dns_dbiterator_t *		iter;
+	isc_result_t			result;
+	dns_fixedname_t			name;
+} shardpos_t;
+
+typedef struct {
+	dns_dbiterator_t		common;
+	unsigned int			options;
+	isc_result_t			result;
+	isc_boolean_t			forward;
+	unsigned int			current;
+	shardpos_t *			pos;
+} shard_dbiterator_t;
+
+static void		dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t	dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_seek(dns_dbiterator_t *iterator,
+					dns_name_t *name);
+static isc_result_t	dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_current(dns_dbiterator_t *iterator,
+					   dns_dbnode_t **nodep,
+					   dns_name_t *name);
+static isc_result_t	dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_origin(dns_dbiterator_t *iterator,
+					  dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy,
+	dbiterator_first,
+	dbiterator_last,
+	dbiterator_seek,
+	dbiterator_prev,
+	dbiterator_next,
+	dbiterator_current,
+	dbiterator_pause,
+	dbiterator_origin
+};
+
+/*
+ * Shard selection.
+ */
+
+static inline unsigned int
+nameindex(shardcache_t *sdb, dns_name_t *name) {
+	dns_name_t key;
+	unsigned int labels;
+
+	labels = dns_name_countlabels(name);
+	if (labels > DNS_SHARDCACHE_KEYLABELS) {
+		dns_name_init(&key, NULL);
+		dns_name_getlabelsequence(name,
+					  labels - DNS_SHARDCACHE_KEYLABELS,
+					  DNS_SHARDCACHE_KEYLABELS, &key);
+		name = &key;
+	}
+	return (dns_name_hash(name, ISC_FALSE) % sdb->nshards);
+}
+
+static inline dns_db_t *
+nameshard(shardcache_t *sdb, dns_name_t *name) {
+	return (sdb->shards[nameindex(sdb, name)]);
+}
+
+static inline dns_db_t *
+nodeshard(shardcache_t *sdb, dns_dbnode_t *node) {
+	unsigned int tag = ((dns_rbtnode_t *)node)->tag;
+
+	INSIST(tag < sdb->nshards);
+	return (sdb->shards[tag]);
+}
+
+/*
+ * DB methods.
+ */
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)source;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	isc_refcount_increment(&sdb->references, NULL);
+	*targetp = source;
+}
+
+static void
+free_shardcache(shardcache_t *sdb) {
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++)
+		if (sdb->shards[i] != NULL)
+			dns_db_detach(&sdb->shards[i]);
+	isc_mem_put(sdb->common.mctx, sdb->shards,
+		    sdb->nshards * sizeof(dns_db_t *));
+	if (sdb->rrsetstats != NULL)
+		dns_stats_detach(&sdb->rrsetstats);
+	if (dns_name_dynamic(&sdb->common.origin))
+		dns_name_free(&sdb->common.origin, sdb->common.mctx);
+	isc_refcount_destroy(&sdb->references);
+	sdb->common.impmagic = 0;
+	sdb->common.magic = 0;
+	isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+}
+
+static void
+detach(dns_db_t **dbp) {
+	shardcache_t *sdb = (shardcache_t *)(*dbp);
+	unsigned int refs;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	isc_refcount_decrement(&sdb->references, &refs);
+	if (refs == 0)
+		free_shardcache(sdb);
+	*dbp = NULL;
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
+	shardload_t *load = arg;
+	unsigned int i = nameindex(load->sdb, name);
+
+	return ((load->adds[i])(load->loads[i], name, rdataset));
+}
+
+static void
+free_load(shardload_t *load) {
+	isc_mem_t *mctx = load->sdb->common.mctx;
+	unsigned int nshards = load->sdb->nshards;
+
+	isc_mem_put(mctx, load->adds, nshards * sizeof(*load->adds));
+	isc_mem_put(mctx, load->loads, nshards * sizeof(*load->loads));
+	isc_mem_put(mctx, load, sizeof(*load));
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp, dns_dbload_t **dbloadp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	shardload_t *load;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	load = isc_mem_get(sdb->common.mctx, sizeof(*load));
+	if (load == NULL)
+		return (ISC_R_NOMEMORY);
+	load->sdb = sdb;
+	load->adds = isc_mem_get(sdb->common.mctx,
+				 sdb->nshards * sizeof(*load->adds));
+	load->loads = isc_mem_get(sdb->common.mctx,
+				  sdb->nshards * sizeof(*load->loads));
+	if (load->adds == NULL || load->loads == NULL) {
+		if (load->adds != NULL)
+			isc_mem_put(sdb->common.mctx, load->adds,
+				    sdb->nshards * sizeof(*load->adds));
+		if (load->loads != NULL)
+			isc_mem_put(sdb->common.mctx, load->loads,
+				    sdb->nshards * sizeof(*load->loads));
+		isc_mem_put(sdb->common.mctx, load, sizeof(*load));
+		return (ISC_R_NOMEMORY);
+	}
+
+	for (i = 0; i < sdb->nshards; i++) {
+		load->adds[i] = NULL;
+		load->loads[i] = NULL;
+		result = dns_db_beginload(sdb->shards[i], &load->adds[i],
+					  &load->loads[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				(void)dns_db_endload(sdb->shards[i],
+						     &load->loads[i]);
+			free_load(load);
+			return (result);
+		}
+	}
+
+	*addp = loading_addrdataset;
+	*dbloadp = load;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_dbload_t **dbloadp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	shardload_t *load = *dbloadp;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+	REQUIRE(load != NULL && load->sdb == sdb);
+
+	for (i = 0; i < sdb->nshards; i++) {
+		tresult = dns_db_endload(sdb->shards[i], &load->loads[i]);
+		if (result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+	free_load(load);
+	*dbloadp = NULL;
+
+	return (result);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+     dns_masterformat_t masterformat)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+#ifdef BIND9
+	return (dns_master_dump2(sdb->common.mctx, db, version,
+				 &dns_master_style_default,
+				 filename, masterformat));
+#else
+	UNUSED(version);
+	UNUSED(filename);
+	UNUSED(masterformat);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* BIND9 */
+}
+
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	*versionp = (dns_dbversion_t *)&sdb->version;
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	UNUSED(db);
+	UNUSED(versionp);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+	REQUIRE(source == (dns_dbversion_t *)&sdb->version);
+
+	*targetp = source;
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+	REQUIRE(*versionp == (dns_dbversion_t *)&sdb->version);
+
+	UNUSED(commit);
+
+	*versionp = NULL;
+}
+
+static isc_result_t
+findnode(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
+	 dns_dbnode_t **nodep)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_findnode(nameshard(sdb, name), name, create, nodep));
+}
+
+static void
+release(dns_db_t *db, dns_dbnode_t **nodep, dns_rdataset_t *rdataset,
+	dns_rdataset_t *sigrdataset)
+{
+	if (nodep != NULL && *nodep != NULL)
+		dns_db_detachnode(db, nodep);
+	if (rdataset != NULL && dns_rdataset_isassociated(rdataset))
+		dns_rdataset_disassociate(rdataset);
+	if (sigrdataset != NULL && dns_rdataset_isassociated(sigrdataset))
+		dns_rdataset_disassociate(sigrdataset);
+}
+
+/*
+ * The shard of 'name' returned 'result' after looking for the deepest
+ * zone cut above it.  The names above the shard key live in other
+ * shards, so unless the cut found is at the key or below, look there
+ * for the deepest one, starting at the key's parent.  A cut the shard
+ * found above the key is found again by that search.
+ */
+static isc_result_t
+findcut(shardcache_t *sdb, dns_db_t *db, dns_name_t *name,
+	isc_result_t result, isc_stdtime_t now, dns_dbnode_t **nodep,
+	dns_name_t *foundname, dns_rdataset_t *rdataset,
+	dns_rdataset_t *sigrdataset)
+{
+	dns_name_t ancestor;
+	unsigned int labels, keylabels, depth;
+
+	labels = dns_name_countlabels(name);
+	keylabels = ISC_MIN(labels, DNS_SHARDCACHE_KEYLABELS);
+
+	if (result == ISC_R_SUCCESS) {
+		depth = dns_name_countlabels(foundname);
+		if (depth >= keylabels)
+			return (ISC_R_SUCCESS);
+		release(db, nodep, rdataset, sigrdataset);
+		depth--;
+	} else if (result == ISC_R_NOTFOUND)
+		depth = 0;
+	else
+		return (result);
+
+	dns_name_init(&ancestor, NULL);
+	while (--keylabels > depth) {
+		dns_name_getlabelsequence(name, labels - keylabels, keylabels,
+					  &ancestor);
+		db = nameshard(sdb, &ancestor);
+		result = dns_db_findzonecut(db, &ancestor, 0, now, nodep,
+					    foundname, rdataset, sigrdataset);
+		if (result == ISC_R_SUCCESS &&
+		    dns_name_countlabels(foundname) == keylabels)
+			return (ISC_R_SUCCESS);
+		release(db, nodep, rdataset, sigrdataset);
+		if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND)
+			return (result);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+static isc_result_t
+find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
+     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+     dns_dbnode_t **nodep, dns_name_t *foundname,
+     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	dns_db_t *shard;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	shard = nameshard(sdb, name);
+	result = dns_db_find(shard, name, NULL, type, options, now, nodep,
+			     foundname, rdataset, sigrdataset);
+	if (result == DNS_R_DELEGATION)
+		result = ISC_R_SUCCESS;
+	else if (result != ISC_R_NOTFOUND)
+		return (result);
+
+	result = findcut(sdb, shard, name, result, now, nodep, foundname,
+			 rdataset, sigrdataset);
+	if (result == ISC_R_SUCCESS)
+		result = DNS_R_DELEGATION;
+
+	return (result);
+}
+
+static isc_result_t
+findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
+	    isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+	    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	dns_db_t *shard;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	shard = nameshard(sdb, name);
+	result = dns_db_findzonecut(shard, name, options, now, nodep,
+				    foundname, rdataset, sigrdataset);
+
+	return (findcut(sdb, shard, name, result, now, nodep, foundname,
+			rdataset, sigrdataset));
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_attachnode(nodeshard(sdb, source), source, targetp);
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_detachnode(nodeshard(sdb, *targetp), targetp);
+}
+
+static isc_result_t
+expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_expirenode(nodeshard(sdb, node), node, now));
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_printnode(nodeshard(sdb, node), node, out);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	shard_dbiterator_t *it;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	it = isc_mem_get(sdb->common.mctx, sizeof(*it));
+	if (it == NULL)
+		return (ISC_R_NOMEMORY);
+	it->pos = isc_mem_get(sdb->common.mctx,
+			      sdb->nshards * sizeof(*it->pos));
+	if (it->pos == NULL) {
+		isc_mem_put(sdb->common.mctx, it, sizeof(*it));
+		return (ISC_R_NOMEMORY);
+	}
+
+	/*
+	 * The shards are merged by comparing absolute names, so relative
+	 * names are never returned.
+	 */
+	it->options = options & ~DNS_DB_RELATIVENAMES;
+	for (i = 0; i < sdb->nshards; i++) {
+		it->pos[i].iter = NULL;
+		it->pos[i].result = ISC_R_NOMORE;
+		dns_fixedname_init(&it->pos[i].name);
+		if (result == ISC_R_SUCCESS)
+			result = dns_db_createiterator(sdb->shards[i],
+						       it->options,
+						       &it->pos[i].iter);
+	}
+	if (result != ISC_R_SUCCESS) {
+		for (i = 0; i < sdb->nshards; i++)
+			if (it->pos[i].iter != NULL)
+				dns_dbiterator_destroy(&it->pos[i].iter);
+		isc_mem_put(sdb->common.mctx, it->pos,
+			    sdb->nshards * sizeof(*it->pos));
+		isc_mem_put(sdb->common.mctx, it, sizeof(*it));
+		return (result);
+	}
+
+	it->common.methods = &dbiterator_methods;
+	it->common.db = NULL;
+	dns_db_attach(db, &it->common.db);
+	it->common.relative_names = ISC_FALSE;
+	it->common.cleaning = ISC_FALSE;
+	it->common.magic = DNS_DBITERATOR_MAGIC;
+	it->result = ISC_R_NOMORE;
+	it->forward = ISC_TRUE;
+	it->current = 0;
+
+	*iteratorp = (dns_dbiterator_t *)it;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     dns_rdatatype_t type, dns_rdatatype_t covers,
+	     isc_stdtime_t now, dns_rdataset_t *rdataset,
+	     dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_findrdataset(nodeshard(sdb, node), node, NULL, type,
+				    covers, now, rdataset, sigrdataset));
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     isc_stdtime_t now, dns_rdatasetiter_t **iteratorp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_allrdatasets(nodeshard(sdb, node), node, NULL, now,
+				    iteratorp));
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_addrdataset(nodeshard(sdb, node), node, NULL, now,
+				   rdataset, options, addedrdataset));
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_subtractrdataset(nodeshard(sdb, node), node, NULL,
+					rdataset, options, newrdataset));
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_deleterdataset(nodeshard(sdb, node), node, NULL,
+				      type, covers));
+}
+
+static isc_boolean_t
+issecure(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_issecure(sdb->shards[0]));
+}
+
+static unsigned int
+nodecount(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		count += dns_db_nodecount(sdb->shards[i]);
+
+	return (count);
+}
+
+static isc_boolean_t
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+	return (ISC_FALSE);
+}
+
+static void
+overmem(dns_db_t *db, isc_boolean_t over) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_db_overmem(sdb->shards[i], over);
+}
+
+static void
+settask(dns_db_t *db, isc_task_t *task) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_db_settask(sdb->shards[i], task);
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_getoriginnode(nameshard(sdb, &sdb->common.origin),
+				     nodep));
+}
+
+static isc_boolean_t
+isdnssec(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_isdnssec(sdb->shards[0]));
+}
+
+static dns_stats_t *
+getrrsetstats(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (sdb->rrsetstats);
+}
+
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (i = 0; i < sdb->nshards; i++) {
+		result = dns_db_setservestalettl(sdb->shards[i], ttl);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_getservestalettl(sdb->shards[0], ttl));
+}
+
+static dns_dbmethods_t shardcache_methods = {
+	attach,
+	detach,
+	beginload,
+	endload,
+	dump,
+	currentversion,
+	newversion,
+	attachversion,
+	closeversion,
+	findnode,
+	find,
+	findzonecut,
+	attachnode,
+	detachnode,
+	expirenode,
+	printnode,
+	createiterator,
+	findrdataset,
+	allrdatasets,
+	addrdataset,
+	subtractrdataset,
+	deleterdataset,
+	issecure,
+	nodecount,
+	ispersistent,
+	overmem,
+	settask,
+	getoriginnode,
+	NULL,			/* transfernode */
+	NULL,			/* getnsec3parameters */
+	NULL,			/* findnsec3node */
+	NULL,			/* setsigningtime */
+	NULL,			/* getsigningtime */
+	NULL,			/* resigned */
+	isdnssec,
+	getrrsetstats,
+	NULL,			/* rpz_enabled */
+	NULL,			/* rpz_findips */
+	NULL,			/* findnodeext */
+	NULL,			/* findext */
+	NULL,			/* serialize */
+	NULL,			/* deserialize */
+	setservestalettl,
+	getservestalettl
+};
+
+isc_result_t
+dns_shardcache_create(isc_mem_t *mctx, isc_mem_t *hmctx, dns_name_t *origin,
+		      dns_rdataclass_t rdclass, unsigned int nshards,
+		      unsigned int nodelocks,
+		      dns_shardcache_createfunc_t createfunc, dns_db_t **dbp)
+{
+	shardcache_t *sdb;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(nshards > 1 && nshards <= DNS_SHARDCACHE_MAXSHARDS);
+	REQUIRE(dbp != NULL && *dbp == NULL);
+
+	sdb = isc_mem_get(mctx, sizeof(*sdb));
+	if (sdb == NULL)
+		return (ISC_R_NOMEMORY);
+
+	sdb->common.attributes = DNS_DBATTR_CACHE;
+	sdb->common.rdclass = rdclass;
+	sdb->common.methods = &shardcache_methods;
+	sdb->common.mctx = NULL;
+	isc_mem_attach(mctx, &sdb->common.mctx);
+	dns_name_init(&sdb->common.origin, NULL);
+	isc_ondestroy_init(&sdb->common.ondest);
+	sdb->nshards = nshards;
+	sdb->rrsetstats = NULL;
+	sdb->version = 0;
+
+	sdb->shards = isc_mem_get(mctx, nshards * sizeof(dns_db_t *));
+	if (sdb->shards == NULL) {
+		isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < nshards; i++)
+		sdb->shards[i] = NULL;
+
+	result = isc_refcount_init(&sdb->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, sdb->shards, nshards * sizeof(dns_db_t *));
+		isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+		return (result);
+	}
+
+	result = dns_name_dupwithoffsets(origin, mctx, &sdb->common.origin);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	result = dns_rdatasetstats_create(mctx, &sdb->rrsetstats);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	for (i = 0; i < nshards; i++) {
+		result = (createfunc)(mctx, hmctx, origin, rdclass, nodelocks,
+				      i, sdb->rrsetstats, &sdb->shards[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+
+	sdb->common.impmagic = SHARDCACHE_MAGIC;
+	sdb->common.generation = 0;
+	sdb->common.magic = DNS_DB_MAGIC;
+
+	*dbp = (dns_db_t *)sdb;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	isc_refcount_decrement(&sdb->references, NULL);
+	free_shardcache(sdb);
+	return (result);
+}
+
+/*
+ * DB iterator methods.
+ *
+ * Each shard's iterator is kept paused at its next candidate, whose name
+ * is remembered in its shardpos_t; the merged iterator stands on the
+ * smallest candidate when moving forward and on the largest when moving
+ * backward.
+ */
+
+/*
+ * Record where 'pos' stands after an iterator operation returned
+ * 'result'.
+ */
+static isc_result_t
+setpos(shardpos_t *pos, isc_result_t result) {
+	dns_dbnode_t *node = NULL;
+	isc_result_t tresult;
+
+	if (result == ISC_R_SUCCESS) {
+		result = dns_dbiterator_current(pos->iter, &node,
+						dns_fixedname_name(&pos->name));
+		if (node != NULL)
+			dns_db_detachnode(pos->iter->db, &node);
+	}
+	tresult = dns_dbiterator_pause(pos->iter);
+	if (result == ISC_R_SUCCESS)
+		result = tresult;
+	pos->result = result;
+
+	return (result);
+}
+
+/*
+ * Move 'pos' to the first name of its shard that sorts at or after
+ * 'name'.  A shard iterator can only seek to a name that exists, so
+ * start from the closest enclosing name the shard has, or from its
+ * first name, and step forward.
+ */
+static isc_result_t
+seekpos(shard_dbiterator_t *it, shardpos_t *pos, dns_name_t *name) {
+	dns_db_t *db = pos->iter->db;
+	dns_dbnode_t *node = NULL;
+	dns_name_t ancestor;
+	isc_result_t result = ISC_R_NOTFOUND;
+	unsigned int labels, n;
+
+	labels = dns_name_countlabels(name);
+	dns_name_init(&ancestor, NULL);
+	for (n = labels; n > 0; n--) {
+		dns_name_getlabelsequence(name, labels - n, n, &ancestor);
+		if (dns_db_findnode(db, &ancestor, ISC_FALSE,
+				    &node) == ISC_R_SUCCESS) {
+			dns_db_detachnode(db, &node);
+			result = dns_dbiterator_seek(pos->iter, &ancestor);
+			break;
+		}
+	}
+	if (result == ISC_R_NOTFOUND) {
+		/*
+		 * Either the shard has no enclosing name, or it was
+		 * removed before we got to it.  A failed seek leaves the
+		 * iterator unusable, so start over with a new one.
+		 */
+		if (n > 0) {
+			dns_dbiterator_destroy(&pos->iter);
+			result = dns_db_createiterator(db, it->options,
+						       &pos->iter);
+			if (result != ISC_R_SUCCESS) {
+				pos->result = result;
+				return (result);
+			}
+		}
+		result = dns_dbiterator_first(pos->iter);
+	}
+
+	result = setpos(pos, result);
+	while (result == ISC_R_SUCCESS &&
+	       dns_name_compare(dns_fixedname_name(&pos->name), name) < 0)
+		result = setpos(pos, dns_dbiterator_next(pos->iter));
+
+	return (result);
+}
+
+/*
+ * Move 'pos' to the first name after 'name', or when 'forward' is false,
+ * to the last name before it.
+ */
+static isc_result_t
+turnpos(shard_dbiterator_t *it, shardpos_t *pos, dns_name_t *name,
+	isc_boolean_t forward)
+{
+	isc_result_t result;
+
+	result = seekpos(it, pos, name);
+	if (forward) {
+		while (result == ISC_R_SUCCESS &&
+		       dns_name_equal(dns_fixedname_name(&pos->name), name))
+			result = setpos(pos, dns_dbiterator_next(pos->iter));
+	} else if (result == ISC_R_NOMORE)
+		result = setpos(pos, dns_dbiterator_last(pos->iter));
+	else if (result == ISC_R_SUCCESS)
+		result = setpos(pos, dns_dbiterator_prev(pos->iter));
+
+	return (result);
+}
+
+/*
+ * Stand on the best candidate of all the shards.
+ */
+static isc_result_t
+pick(shard_dbiterator_t *it) {
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	dns_name_t *best = NULL, *name;
+	unsigned int i;
+	int order;
+
+	it->result = ISC_R_NOMORE;
+	for (i = 0; i < sdb->nshards; i++) {
+		if (it->pos[i].result == ISC_R_NOMORE)
+			continue;
+		if (it->pos[i].result != ISC_R_SUCCESS) {
+			it->result = it->pos[i].result;
+			return (it->result);
+		}
+		name = dns_fixedname_name(&it->pos[i].name);
+		if (best != NULL) {
+			order = dns_name_compare(name, best);
+			if (it->forward ? order >= 0 : order <= 0)
+				continue;
+		}
+		best = name;
+		it->current = i;
+		it->result = ISC_R_SUCCESS;
+	}
+
+	return (it->result);
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	shard_dbiterator_t *it = (shard_dbiterator_t *)(*iteratorp);
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	dns_db_t *db = NULL;
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_dbiterator_destroy(&it->pos[i].iter);
+	isc_mem_put(sdb->common.mctx, it->pos,
+		    sdb->nshards * sizeof(*it->pos));
+
+	dns_db_attach(it->common.db, &db);
+	dns_db_detach(&it->common.db);
+	it->common.magic = 0;
+	isc_mem_put(db->mctx, it, sizeof(*it));
+	dns_db_detach(&db);
+
+	*iteratorp = NULL;
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	shard_dbiterator_t *it = (shard_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++)
+		(void)setpos(&it->pos[i], dns_dbiterator_first(it->pos[i].iter));
+	it->forward = ISC_TRUE;
+
+	return (pick(it));
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	shard_dbiterator_t *it = (shard_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++)
+		(void)setpos(&it->pos[i], dns_dbiterator_last(it->pos[i].iter));
+	it->forward = ISC_FALSE;
+
+	return (pick(it));
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, dns_name_t *name) {
+	shard_dbiterator_t *it = (shard_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	dns_dbnode_t *node = NULL;
+	isc_boolean_t found = ISC_FALSE;
+	unsigned int i;
+
+	/*
+	 * Do not disturb the shards unless one of them has 'name'.
+	 */
+	for (i = 0; i < sdb->nshards && !found; i++) {
+		if (dns_db_findnode(sdb->shards[i], name, ISC_FALSE,
+				    &node) == ISC_R_SUCCESS) {
+			dns_db_detachnode(sdb->shards[i], &node);
+			found = ISC_TRUE;
+		}
+	}
+	if (!found) {
+		it->result = ISC_R_NOTFOUND;
+		return (it->result);
+	}
+
+	for (i = 0; i < sdb->nshards; i++)
+		(void)seekpos(it, &it->pos[i], name);
+	it->forward = ISC_TRUE;
+
+	if (pick(it) == ISC_R_SUCCESS &&
+	    !dns_name_equal(dns_fixedname_name(&it->pos[it->current].name),
+			    name))
+		it->result = ISC_R_NOTFOUND;
+
+	return (it->result);
+}
+
+static isc_result_t
+step(shard_dbiterator_t *it, isc_boolean_t forward) {
+	shardcache_t *sdb = (shardcache_t *)it->common.db;
+	shardpos_t *cur;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	unsigned int i;
+
+	if (it->result != ISC_R_SUCCESS)
+		return (it->result);
+
+	cur = &it->pos[it->current];
+	if (it->forward != forward) {
+		/*
+		 * Changing direction: bring the other shards to the
+		 * other side of the current name.
+		 */
+		dns_fixedname_init(&fname);
+		name = dns_fixedname_name(&fname);
+		RUNTIME_CHECK(dns_name_copy(dns_fixedname_name(&cur->name),
+					    name, NULL) == ISC_R_SUCCESS);
+		for (i = 0; i < sdb->nshards; i++)
+			if (&it->pos[i] != cur)
+				(void)turnpos(it, &it->pos[i], name, forward);
+		it->forward = forward;
+	}
+
+	if (forward)
+		(void)setpos(cur, dns_dbiterator_next(cur->iter));
+	else
+		(void)setpos(cur, dns_dbiterator_prev(cur->iter));
+
+	return (pick(it));
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	return (step((shard_dbiterator_t *)iterator, ISC_FALSE));
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	return (step((shard_dbiterator_t *)iterator, ISC_TRUE));
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name)
+{
+	shard_dbiterator_t *it = (shard_dbiterator_t *)iterator;
+	shardpos_t *cur;
+	isc_result_t result;
+
+	REQUIRE(it->result == ISC_R_SUCCESS);
+
+	cur = &it->pos[it->current];
+	result = dns_dbiterator_current(cur->iter, nodep, name);
+	(void)dns_dbiterator_pause(cur->iter);
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	shard_dbiterator_t *it = (shard_dbiterator_t *)iterator;
+
+	/*
+	 * The shard iterators are paused after every move.
+	 */
+	if (it->result != ISC_R_SUCCESS && it->result != ISC_R_NOMORE)
+		return (it->result);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	UNUSED(iterator);
+
+	return (dns_name_copy(dns_rootname, name, NULL));
+}
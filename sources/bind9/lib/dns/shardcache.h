@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_SHARDCACHE_H
+#define DNS_SHARDCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file
+ * \brief
+ * A cache database split into several independent RBT databases.
+ *
+ * Every name is stored in the shard selected by a hash of its last
+ * #DNS_SHARDCACHE_KEYLABELS labels (counting the root label), so that a
+ * domain and everything below it, e.g. "www.example.com" and
+ * "example.com", share a shard while unrelated domains are spread over
+ * the others.  Each shard has its own tree lock, so adding names to
+ * different shards does not serialize.
+ *
+ * Lookups go to the shard of the name.  If that shard knows no zone cut
+ * at or below the shard key, the shards holding the shorter ancestors
+ * (the top level domain and the root) are searched for one.  A DNAME at
+ * such an ancestor is not seen by lookups of names in other shards.
+ *
+ * Database iterators merge the shards into a single sorted sequence.  An
+ * empty node may appear once for every shard that contains it.
+ */
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+#include <dns/rbt.h>
+
+/*%
+ * Number of trailing labels, including the root label, that select a
+ * name's shard.
+ */
+#define DNS_SHARDCACHE_KEYLABELS	3
+
+/*% Largest number of shards. */
+#define DNS_SHARDCACHE_MAXSHARDS	(1U << DNS_RBT_TAGLENGTH)
+
+/*%
+ * Create shard number 'shard' of a cache for 'rdclass'.  Every node of
+ * the new database must carry 'shard' in its rbt 'tag' field, and the
+ * database must count its RRsets in 'rrsetstats'.
+ */
+typedef isc_result_t
+(*dns_shardcache_createfunc_t)(isc_mem_t *mctx, isc_mem_t *hmctx,
+			       dns_name_t *origin, dns_rdataclass_t rdclass,
+			       unsigned int nodelocks, unsigned int shard,
+			       dns_stats_t *rrsetstats, dns_db_t **dbp);
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_shardcache_create(isc_mem_t *mctx, isc_mem_t *hmctx, dns_name_t *origin,
+		      dns_rdataclass_t rdclass, unsigned int nshards,
+		      unsigned int nodelocks,
+		      dns_shardcache_createfunc_t createfunc, dns_db_t **dbp);
+/*%<
+ * Create a cache database made of 'nshards' shards, each created by
+ * 'createfunc' with 'nodelocks' node locks.
+ *
+ * Requires:
+ *
+ *\li	1 < nshards <= #DNS_SHARDCACHE_MAXSHARDS
+ *
+ *\li	dbp != NULL && *dbp == NULL
+ *
+ * Returns:
+ *
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	Any result from 'createfunc'.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SHARDCACHE_H */
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/sha2.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#define SIGCACHE_MAGIC		ISC_MAGIC('S', 'i', 'g', 'C')
+#define VALID_SIGCACHE(c)	ISC_MAGIC_VALID(c, SIGCACHE_MAGIC)
+
+#define MIN_BUCKETS		16
+#define MAX_BUCKETS		(1U << 20)
+
+typedef struct sigentry sigentry_t;
+
+struct sigentry {
+	ISC_LINK(sigentry_t)	hlink;
+	ISC_LINK(sigentry_t)	lrulink;	/* or the free list */
+	dns_sigcachekey_t	key;
+	isc_result_t		result;
+	isc_stdtime_t		expire;
+};
+
+struct dns_sigcache {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	isc_refcount_t		references;
+	isc_mutex_t		lock;
+	sigentry_t *		entries;
+	unsigned int		nentries;
+	ISC_LIST(sigentry_t) *	table;
+	unsigned int		nbuckets;	/* a power of two */
+	ISC_LIST(sigentry_t)	lru;		/* most recent first */
+	ISC_LIST(sigentry_t)	free;
+	unsigned int		count;
+};
+
+/*
+ * The key is already a digest, so any part of it will do as a hash.
+ */
+static inline unsigned int
+bucket(dns_sigcache_t *cache, const dns_sigcachekey_t *key) {
+	isc_uint32_t h;
+
+	h = (key->digest[0] << 24) | (key->digest[1] << 16) |
+	    (key->digest[2] << 8) | key->digest[3];
+	return (h & (cache->nbuckets - 1));
+}
+
+/*
+ * Unlink 'entry' and put it on the free list.  The cache must be locked.
+ */
+static void
+unlinkentry(dns_sigcache_t *cache, sigentry_t *entry) {
+	ISC_LIST_UNLINK(cache->table[bucket(cache, &entry->key)],
+			entry, hlink);
+	ISC_LIST_UNLINK(cache->lru, entry, lrulink);
+	ISC_LIST_APPEND(cache->free, entry, lrulink);
+	INSIST(cache->count > 0);
+	cache->count--;
+}
+
+static sigentry_t *
+findentry(dns_sigcache_t *cache, const dns_sigcachekey_t *key) {
+	sigentry_t *entry;
+
+	for (entry = ISC_LIST_HEAD(cache->table[bucket(cache, key)]);
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, hlink))
+	{
+		if (memcmp(entry->key.digest, key->digest,
+			   sizeof(key->digest)) == 0)
+			return (entry);
+	}
+	return (NULL);
+}
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, size_t size, dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache;
+	isc_result_t result;
+	unsigned int i, nentries, nbuckets;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size != 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	if (size / sizeof(sigentry_t) > MAX_BUCKETS * 2)
+		nentries = MAX_BUCKETS * 2;
+	else if (size < sizeof(sigentry_t))
+		nentries = 1;
+	else
+		nentries = size / sizeof(sigentry_t);
+	nbuckets = MIN_BUCKETS;
+	while (nbuckets < MAX_BUCKETS && nbuckets * 2 < nentries)
+		nbuckets <<= 1;
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+
+	cache->entries = isc_mem_get(mctx, nentries * sizeof(sigentry_t));
+	if (cache->entries == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_cache;
+	}
+	cache->table = isc_mem_get(mctx, nbuckets * sizeof(*cache->table));
+	if (cache->table == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_entries;
+	}
+	result = isc_mutex_init(&cache->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_table;
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+
+	for (i = 0; i < nbuckets; i++)
+		ISC_LIST_INIT(cache->table[i]);
+	cache->nbuckets = nbuckets;
+	ISC_LIST_INIT(cache->lru);
+	ISC_LIST_INIT(cache->free);
+	for (i = 0; i < nentries; i++) {
+		ISC_LINK_INIT(&cache->entries[i], hlink);
+		ISC_LINK_INIT(&cache->entries[i], lrulink);
+		ISC_LIST_APPEND(cache->free, &cache->entries[i], lrulink);
+	}
+	cache->nentries = nentries;
+	cache->count = 0;
+
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = SIGCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_lock:
+	DESTROYLOCK(&cache->lock);
+ cleanup_table:
+	isc_mem_put(mctx, cache->table, nbuckets * sizeof(*cache->table));
+ cleanup_entries:
+	isc_mem_put(mctx, cache->entries, nentries * sizeof(sigentry_t));
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp) {
+	REQUIRE(VALID_SIGCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache;
+	unsigned int references;
+
+	REQUIRE(cachep != NULL);
+	cache = *cachep;
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	*cachep = NULL;
+	isc_refcount_decrement(&cache->references, &references);
+	if (references != 0)
+		return;
+
+	cache->magic = 0;
+	DESTROYLOCK(&cache->lock);
+	isc_mem_put(cache->mctx, cache->table,
+		    cache->nbuckets * sizeof(*cache->table));
+	isc_mem_put(cache->mctx, cache->entries,
+		    cache->nentries * sizeof(sigentry_t));
+	isc_refcount_destroy(&cache->references);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+/*
+ * Make qsort happy.
+ */
+static int
+rdata_compare_wrapper(const void *rdata1, const void *rdata2) {
+	return (dns_rdata_compare((const dns_rdata_t *)rdata1,
+				  (const dns_rdata_t *)rdata2));
+}
+
+/*
+ * Add the length of 'r' and then 'r' itself to the digest, so that no
+ * two sequences of regions give the same input.
+ */
+static void
+digestregion(isc_sha256_t *ctx, isc_region_t *r) {
+	unsigned char len[2];
+
+	len[0] = (r->length >> 8) & 0xff;
+	len[1] = r->length & 0xff;
+	isc_sha256_update(ctx, len, sizeof(len));
+	isc_sha256_update(ctx, r->base, r->length);
+}
+
+isc_result_t
+dns_sigcache_makekey(dns_name_t *name, dns_rdataset_t *rdataset,
+		     dst_key_t *key, dns_rdata_t *sigrdata, isc_mem_t *mctx,
+		     dns_sigcachekey_t *cachekey)
+{
+	isc_sha256_t ctx;
+	dns_fixedname_t fixed;
+	dns_name_t *lower;
+	dns_rdataset_t clone;
+	dns_rdata_t *rdatas;
+	unsigned char header[4];
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned int i, n;
+
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(DNS_RDATASET_VALID(rdataset) &&
+		dns_rdataset_isassociated(rdataset));
+	REQUIRE(key != NULL);
+	REQUIRE(sigrdata != NULL);
+	REQUIRE(cachekey != NULL);
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &b);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	n = dns_rdataset_count(rdataset);
+	rdatas = isc_mem_get(mctx, n * sizeof(dns_rdata_t));
+	if (rdatas == NULL)
+		return (ISC_R_NOMEMORY);
+
+	dns_rdataset_init(&clone);
+	dns_rdataset_clone(rdataset, &clone);
+	i = 0;
+	for (result = dns_rdataset_first(&clone);
+	     result == ISC_R_SUCCESS && i < n;
+	     result = dns_rdataset_next(&clone))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&clone, &rdatas[i++]);
+	}
+	dns_rdataset_disassociate(&clone);
+	qsort(rdatas, i, sizeof(dns_rdata_t), rdata_compare_wrapper);
+
+	isc_sha256_init(&ctx);
+
+	dns_fixedname_init(&fixed);
+	lower = dns_fixedname_name(&fixed);
+	RUNTIME_CHECK(dns_name_downcase(name, lower, NULL) == ISC_R_SUCCESS);
+	dns_name_toregion(lower, &r);
+	digestregion(&ctx, &r);
+
+	header[0] = (rdataset->type >> 8) & 0xff;
+	header[1] = rdataset->type & 0xff;
+	header[2] = (rdataset->rdclass >> 8) & 0xff;
+	header[3] = rdataset->rdclass & 0xff;
+	isc_sha256_update(&ctx, header, sizeof(header));
+
+	header[0] = (i >> 8) & 0xff;
+	header[1] = i & 0xff;
+	isc_sha256_update(&ctx, header, 2);
+	while (i-- > 0) {
+		dns_rdata_toregion(&rdatas[i], &r);
+		digestregion(&ctx, &r);
+	}
+	isc_mem_put(mctx, rdatas, n * sizeof(dns_rdata_t));
+
+	dns_rdata_toregion(sigrdata, &r);
+	digestregion(&ctx, &r);
+
+	dns_name_toregion(dst_key_name(key), &r);
+	digestregion(&ctx, &r);
+	isc_buffer_usedregion(&b, &r);
+	digestregion(&ctx, &r);
+
+	isc_sha256_final(cachekey->digest, &ctx);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_sigcachekey_t *cachekey,
+		  isc_stdtime_t now, isc_result_t *resultp)
+{
+	sigentry_t *entry;
+	isc_result_t result;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(cachekey != NULL);
+	REQUIRE(resultp != NULL);
+
+	LOCK(&cache->lock);
+	entry = findentry(cache, cachekey);
+	if (entry == NULL) {
+		result = ISC_R_NOTFOUND;
+	} else if (entry->expire <= now) {
+		unlinkentry(cache, entry);
+		result = ISC_R_NOTFOUND;
+	} else {
+		*resultp = entry->result;
+		if (entry != ISC_LIST_HEAD(cache->lru)) {
+			ISC_LIST_UNLINK(cache->lru, entry, lrulink);
+			ISC_LIST_PREPEND(cache->lru, entry, lrulink);
+		}
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK(&cache->lock);
+
+	return (result);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const dns_sigcachekey_t *cachekey,
+		 isc_result_t result, isc_stdtime_t expire)
+{
+	sigentry_t *entry;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(cachekey != NULL);
+
+	LOCK(&cache->lock);
+	entry = findentry(cache, cachekey);
+	if (entry != NULL)
+		unlinkentry(cache, entry);
+	if (ISC_LIST_EMPTY(cache->free))
+		unlinkentry(cache, ISC_LIST_TAIL(cache->lru));
+	entry = ISC_LIST_HEAD(cache->free);
+	ISC_LIST_UNLINK(cache->free, entry, lrulink);
+	entry->key = *cachekey;
+	entry->result = result;
+	entry->expire = expire;
+	ISC_LIST_PREPEND(cache->table[bucket(cache, cachekey)], entry, hlink);
+	ISC_LIST_PREPEND(cache->lru, entry, lrulink);
+	cache->count++;
+	UNLOCK(&cache->lock);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache) {
+	sigentry_t *entry;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	LOCK(&cache->lock);
+	while ((entry = ISC_LIST_HEAD(cache->lru)) != NULL)
+		unlinkentry(cache, entry);
+	UNLOCK(&cache->lock);
+}
+
+unsigned int
+dns_sigcache_count(dns_sigcache_t *cache) {
+	unsigned int count;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	LOCK(&cache->lock);
+	count = cache->count;
+	UNLOCK(&cache->lock);
+	return (count);
+}
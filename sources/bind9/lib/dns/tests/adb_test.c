@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <isc/event.h>
+#include <isc/net.h>
+#include <isc/sockaddr.h>
+#include <isc/task.h>
+#include <isc/thread.h>
+
+#include <dns/adb.h>
+#include <dns/events.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define NTHREADS	4
+#define NLOOPS		10000
+
+/*
+ * Helper functions
+ */
+
+static isc_boolean_t shutdown_done;
+
+static void
+adb_shutdown(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	shutdown_done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+setup(dns_view_t **viewp, dns_adb_t **adbp) {
+	isc_result_t result;
+
+	result = dns_view_create(mctx, dns_rdataclass_in, "test", viewp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_adb_create(mctx, *viewp, timermgr, taskmgr, adbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Shut the ADB down and wait until it is done with.
+ */
+static void
+teardown(dns_view_t **viewp, dns_adb_t **adbp) {
+	isc_event_t *event;
+
+	event = isc_event_allocate(mctx, NULL, DNS_EVENT_VIEWADBSHUTDOWN,
+				   adb_shutdown, NULL, sizeof(isc_event_t));
+	ATF_REQUIRE(event != NULL);
+
+	shutdown_done = ISC_FALSE;
+	dns_adb_whenshutdown(*adbp, maintask, &event);
+	dns_adb_shutdown(*adbp);
+	dns_adb_detach(adbp);
+	while (!shutdown_done)
+		dns_test_nap(1000);
+
+	dns_view_detach(viewp);
+}
+
+static void
+findaddr(dns_adb_t *adb, const char *text, dns_adbaddrinfo_t **addrp) {
+	isc_result_t result;
+	isc_sockaddr_t sa;
+	struct in_addr ina;
+
+	ATF_REQUIRE(inet_pton(AF_INET, text, &ina) == 1);
+	isc_sockaddr_fromin(&sa, &ina, 53);
+	result = dns_adb_findaddrinfo(adb, &sa, addrp, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+typedef struct {
+	dns_adb_t		*adb;
+	dns_adbaddrinfo_t	*addr;
+	unsigned int		bit;
+} flagarg_t;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+toggle(isc_threadarg_t arg) {
+	flagarg_t *fa = arg;
+	int i;
+
+	for (i = 0; i < NLOOPS; i++) {
+		dns_adb_changeflags(fa->adb, fa->addr, fa->bit, fa->bit);
+		dns_adb_changeflags(fa->adb, fa->addr, 0, fa->bit);
+		dns_adb_adjustsrtt(fa->adb, fa->addr, 1000,
+				   DNS_ADB_RTTADJDEFAULT);
+	}
+	dns_adb_changeflags(fa->adb, fa->addr, fa->bit, fa->bit);
+
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(srtt);
+ATF_TC_HEAD(srtt, tc) {
+	atf_tc_set_md_var(tc, "descr", "RTT updates are shared by all "
+					"users of an address");
+}
+ATF_TC_BODY(srtt, tc) {
+	isc_result_t result;
+	dns_view_t *view = NULL;
+	dns_adb_t *adb = NULL;
+	dns_adbaddrinfo_t *a = NULL, *b = NULL, *c = NULL;
+	isc_stdtime_t now;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	setup(&view, &adb);
+
+	findaddr(adb, "192.0.2.1", &a);
+	findaddr(adb, "192.0.2.1", &b);
+
+	dns_adb_adjustsrtt(adb, a, 1000, DNS_ADB_RTTADJREPLACE);
+	ATF_CHECK_EQ(a->srtt, 1000);
+	dns_adb_adjustsrtt(adb, b, 2000, DNS_ADB_RTTADJDEFAULT);
+	ATF_CHECK_EQ(b->srtt, 1300);
+
+	findaddr(adb, "192.0.2.1", &c);
+	ATF_CHECK_EQ(c->srtt, 1300);
+
+	/* Ageing happens at most once a second. */
+	isc_stdtime_get(&now);
+	dns_adb_agesrtt(adb, c, now);
+	ATF_CHECK_EQ(c->srtt, 1297);
+	dns_adb_agesrtt(adb, a, now);
+	ATF_CHECK_EQ(a->srtt, 1297);
+	dns_adb_agesrtt(adb, a, now + 1);
+	ATF_CHECK_EQ(a->srtt, 1294);
+
+	dns_adb_freeaddrinfo(adb, &a);
+	dns_adb_freeaddrinfo(adb, &b);
+	dns_adb_freeaddrinfo(adb, &c);
+
+	/* The last reference went, but the entry persists for a while. */
+	findaddr(adb, "192.0.2.1", &a);
+	ATF_CHECK_EQ(a->srtt, 1294);
+	dns_adb_freeaddrinfo(adb, &a);
+
+	teardown(&view, &adb);
+	dns_test_end();
+}
+
+ATF_TC(flags);
+ATF_TC_HEAD(flags, tc) {
+	atf_tc_set_md_var(tc, "descr", "flag changes are shared by all "
+					"users of an address");
+}
+ATF_TC_BODY(flags, tc) {
+	isc_result_t result;
+	dns_view_t *view = NULL;
+	dns_adb_t *adb = NULL;
+	dns_adbaddrinfo_t *a = NULL, *b = NULL;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	setup(&view, &adb);
+
+	findaddr(adb, "192.0.2.2", &a);
+	dns_adb_changeflags(adb, a, 0x3, 0x3);
+	ATF_CHECK_EQ(a->flags & 0x3, 0x3);
+	dns_adb_changeflags(adb, a, 0, 0x1);
+	ATF_CHECK_EQ(a->flags & 0x3, 0x2);
+
+	findaddr(adb, "192.0.2.2", &b);
+	ATF_CHECK_EQ(b->flags & 0x3, 0x2);
+
+	dns_adb_freeaddrinfo(adb, &a);
+	dns_adb_freeaddrinfo(adb, &b);
+
+	teardown(&view, &adb);
+	dns_test_end();
+}
+
+ATF_TC(concurrent);
+ATF_TC_HEAD(concurrent, tc) {
+	atf_tc_set_md_var(tc, "descr", "concurrent flag changes to an "
+					"address are not lost");
+}
+ATF_TC_BODY(concurrent, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	dns_view_t *view = NULL;
+	dns_adb_t *adb = NULL;
+	dns_adbaddrinfo_t *addr = NULL;
+	flagarg_t args[NTHREADS];
+	isc_thread_t threads[NTHREADS];
+	unsigned int i, all = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	setup(&view, &adb);
+
+	for (i = 0; i < NTHREADS; i++) {
+		args[i].adb = adb;
+		args[i].addr = NULL;
+		args[i].bit = 1 << i;
+		all |= args[i].bit;
+		findaddr(adb, "192.0.2.3", &args[i].addr);
+		result = isc_thread_create(toggle, &args[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		(void)isc_thread_join(threads[i], NULL);
+
+	findaddr(adb, "192.0.2.3", &addr);
+	ATF_CHECK_EQ(addr->flags & all, all);
+	dns_adb_freeaddrinfo(adb, &addr);
+
+	for (i = 0; i < NTHREADS; i++)
+		dns_adb_freeaddrinfo(adb, &args[i].addr);
+
+	teardown(&view, &adb);
+	dns_test_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, srtt);
+	ATF_TP_ADD_TC(tp, flags);
+	ATF_TP_ADD_TC(tp, concurrent);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include "dnstest.h"
+
+#define NAMES		600
+
+/*
+ * Helper functions
+ */
+
+static dns_fixedname_t fixed[NAMES];
+
+/*
+ * Make name 'i', spread over a few zones so that suffixes are shared.
+ */
+static dns_name_t *
+makename(unsigned int i, const char *fmt) {
+	isc_result_t result;
+	char text[100];
+	dns_name_t *name;
+
+	snprintf(text, sizeof(text), fmt, i, i % 7);
+	dns_fixedname_init(&fixed[i]);
+	name = dns_fixedname_name(&fixed[i]);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (name);
+}
+
+/*
+ * Decompress 'count' names from 'source' and check them against fixed[].
+ */
+static void
+checknames(isc_buffer_t *source, unsigned int count) {
+	isc_result_t result;
+	dns_decompress_t dctx;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	unsigned int i;
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_ALL);
+	isc_buffer_setactive(source, isc_buffer_usedlength(source));
+	for (i = 0; i < count; i++) {
+		dns_fixedname_init(&fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_name_fromwire(name, source, &dctx, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(name,
+					 dns_fixedname_name(&fixed[i])));
+	}
+	ATF_CHECK_EQ(isc_buffer_remaininglength(source), 0);
+	dns_decompress_invalidate(&dctx);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr", "compression table growth");
+}
+ATF_TC_BODY(grow, tc) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t b;
+	static unsigned char data[65535];
+	unsigned int i, plain = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&b, data, sizeof(data));
+	for (i = 0; i < NAMES; i++) {
+		dns_name_t *name = makename(i, "host%u.sub%u.example.com.");
+		plain += name->length;
+		result = dns_name_towire(name, &cctx, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK(cctx.count > DNS_COMPRESS_INITIALNODES);
+	ATF_CHECK(cctx.table != cctx.initialtable);
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * All but the first name end in a pointer to a known suffix.
+	 */
+	ATF_CHECK(isc_buffer_usedlength(&b) < plain / 2);
+	checknames(&b, NAMES);
+
+	dns_test_end();
+}
+
+ATF_TC(rollback);
+ATF_TC_HEAD(rollback, tc) {
+	atf_tc_set_md_var(tc, "descr", "compression table rollback");
+}
+ATF_TC_BODY(rollback, tc) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t b;
+	static unsigned char data[65535];
+	unsigned int i, used = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Render all of the names, then roll back to half way and render
+	 * the second half again as different names.  None of the new
+	 * names may point into what was rolled back.
+	 */
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&b, data, sizeof(data));
+	for (i = 0; i < NAMES; i++) {
+		if (i == NAMES / 2)
+			used = isc_buffer_usedlength(&b);
+		result = dns_name_towire(makename(i, "a%u.b%u.example.net."),
+					 &cctx, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_compress_rollback(&cctx, (isc_uint16_t)used);
+	isc_buffer_clear(&b);
+	isc_buffer_add(&b, used);
+	for (i = NAMES / 2; i < NAMES; i++) {
+		result = dns_name_towire(makename(i, "x%u.b%u.example.net."),
+					 &cctx, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_compress_invalidate(&cctx);
+	checknames(&b, NAMES);
+
+	dns_test_end();
+}
+
+ATF_TC(sensitive);
+ATF_TC_HEAD(sensitive, tc) {
+	atf_tc_set_md_var(tc, "descr", "case sensitive compression");
+}
+ATF_TC_BODY(sensitive, tc) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t b;
+	unsigned char data[512];
+	unsigned int used;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Case insensitive: the second name is a single pointer.
+	 */
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_name_towire(makename(0, "www.example.com."), &cctx, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	used = isc_buffer_usedlength(&b);
+	result = dns_name_towire(makename(1, "WWW.Example.COM."), &cctx, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), used + 2);
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * Case sensitive: only "com" can be shared.
+	 */
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, ISC_TRUE);
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_name_towire(makename(0, "www.example.com."), &cctx, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	used = isc_buffer_usedlength(&b);
+	result = dns_name_towire(makename(1, "WWW.Example.com."), &cctx, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), used + 4 + 8 + 2);
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, rollback);
+	ATF_TP_ADD_TC(tp, sensitive);
+	return (atf_no_error());
+}
@@ -27,8 +27,12 @@
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/journal.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 
 #include "dnstest.h"
 
@@ -40,6 +44,144 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+/*
+ * Look up 'name'/A in 'db' and bind it to 'rdataset'.
+ */
+static void
+find_a(dns_db_t *db, dns_name_t *name, dns_rdataset_t *rdataset) {
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t found;
+
+	dns_fixedname_init(&found);
+	if (dns_rdataset_isassociated(rdataset))
+		dns_rdataset_disassociate(rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0, &node,
+			     dns_fixedname_name(&found), rdataset, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+}
+
+/*
+ * Look up 'name'/A in 'db' at 'now' with 'options'.
+ */
+static isc_result_t
+find_at(dns_db_t *db, dns_name_t *name, isc_stdtime_t now,
+	unsigned int options, dns_rdataset_t *rdataset)
+{
+	dns_fixedname_t found;
+
+	dns_fixedname_init(&found);
+	if (dns_rdataset_isassociated(rdataset))
+		dns_rdataset_disassociate(rdataset);
+	return (dns_db_find(db, name, NULL, dns_rdatatype_a, options, now,
+			    NULL, dns_fixedname_name(&found), rdataset,
+			    NULL));
+}
+
+/*
+ * Add 'rdataset' to the node it came from with 'options'.
+ */
+static void
+readd(dns_db_t *db, dns_name_t *name, dns_rdataset_t *rdataset,
+      unsigned int options)
+{
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+	result = dns_db_findnode(db, name, ISC_FALSE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, rdataset, options,
+				    NULL);
+	ATF_CHECK(result == ISC_R_SUCCESS || result == DNS_R_UNCHANGED);
+	dns_db_detachnode(db, &node);
+}
+
+/*
+ * Add a record of 'type' with wire data 'data' at 'owner' to cache
+ * 'db', as the resolver does.
+ */
+static void
+addrr(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+      unsigned char *data, unsigned int length, isc_stdtime_t now)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_region_t r;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), owner, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	r.base = data;
+	r.length = length;
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, type, &r);
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_TRUE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Look for the record of 'type' covering 'name' in 'db' and check that
+ * it is at 'expect', or that there is none if 'expect' is NULL.
+ */
+static void
+checkcovering(dns_db_t *db, const char *name, dns_rdatatype_t type,
+	      const char *expect)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed, found, fexpect;
+	dns_rdataset_t rdataset, sigrdataset;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), name, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	dns_rdataset_init(&sigrdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL, type,
+			     DNS_DBFIND_COVERINGNSEC, 0, NULL,
+			     dns_fixedname_name(&found), &rdataset,
+			     &sigrdataset);
+	if (expect == NULL) {
+		ATF_CHECK(result != DNS_R_COVERINGNSEC);
+	} else {
+		ATF_REQUIRE_EQ(result, DNS_R_COVERINGNSEC);
+		ATF_CHECK_EQ(rdataset.type, type);
+		dns_fixedname_init(&fexpect);
+		result = dns_name_fromstring(dns_fixedname_name(&fexpect),
+					     expect, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&found),
+					 dns_fixedname_name(&fexpect)));
+	}
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (dns_rdataset_isassociated(&sigrdataset))
+		dns_rdataset_disassociate(&sigrdataset);
+}
+
 /*
  * Individual unit tests
  */
@@ -77,10 +219,199 @@ ATF_TC_BODY(getoriginnode, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+ATF_TC(prefetch);
+ATF_TC_HEAD(prefetch, tc) {
+	atf_tc_set_md_var(tc, "descr", "a cached rdataset is prefetched "
+			  "once it has been used often enough");
+}
+ATF_TC_BODY(prefetch, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	char *argv[1];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mctx;
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 1, argv, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, "testdata/db/cache.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "www.example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+
+	/* Not used often enough yet. */
+	find_a(db, name, &rdataset);
+	find_a(db, name, &rdataset);
+	ATF_CHECK(!dns_rdataset_prefetch(&rdataset, 3));
+
+	/* Only the first caller is told to prefetch. */
+	find_a(db, name, &rdataset);
+	ATF_CHECK(dns_rdataset_prefetch(&rdataset, 3));
+	ATF_CHECK(!dns_rdataset_prefetch(&rdataset, 3));
+
+	/* The same data without DNS_DBADD_PREFETCH keeps the old rdataset. */
+	readd(db, name, &rdataset, 0);
+	find_a(db, name, &rdataset);
+	ATF_CHECK(!dns_rdataset_prefetch(&rdataset, 0));
+
+	/* The answer to a prefetch replaces it. */
+	readd(db, name, &rdataset, DNS_DBADD_PREFETCH);
+	find_a(db, name, &rdataset);
+	ATF_CHECK(dns_rdataset_prefetch(&rdataset, 1));
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(servestale);
+ATF_TC_HEAD(servestale, tc) {
+	atf_tc_set_md_var(tc, "descr", "expired cache data is kept for the "
+			  "serve-stale window and found only when asked for");
+}
+ATF_TC_BODY(servestale, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_ttl_t ttl;
+	isc_stdtime_t now;
+	char *argv[1];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mctx;
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 1, argv, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+	result = dns_db_load(db, "testdata/db/cache.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "www.example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+
+	/* Fresh data is found either way. */
+	result = find_at(db, name, now, DNS_DBFIND_STALEOK, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_STALE) == 0);
+	ATF_CHECK(rdataset.ttl > 0);
+
+	result = dns_db_setservestalettl(db, 86400);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_getservestalettl(db, &ttl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(ttl, 86400);
+
+	/* Within it, only a search that asks for it finds it. */
+	result = find_at(db, name, now + 7200, 0, &rdataset);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	result = find_at(db, name, now + 7200, DNS_DBFIND_STALEOK, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_STALE) != 0);
+	ATF_CHECK_EQ(rdataset.ttl, 0);
+
+	/* Past the window it is gone for good. */
+	result = find_at(db, name, now + 3600 + 86400 + 3600,
+			 DNS_DBFIND_STALEOK, &rdataset);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(coveringnsec3);
+ATF_TC_HEAD(coveringnsec3, tc) {
+	atf_tc_set_md_var(tc, "descr", "the NSEC3 record covering a hashed "
+			  "name is found in the cache");
+}
+ATF_TC_BODY(coveringnsec3, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now;
+	char *argv[1];
+	unsigned char a[4] = { 192, 0, 2, 1 };
+	/* 1 0 0 - <20 zero octets> A */
+	unsigned char nsec3[29];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mctx;
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 1, argv, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	memset(nsec3, 0, sizeof(nsec3));
+	nsec3[0] = 1;
+	nsec3[5] = 20;
+	nsec3[27] = 1;
+	nsec3[28] = 0x40;
+
+	/*
+	 * Two NSEC3 records of example., with names of other shapes
+	 * between them: a child zone, a name in it and a plain name.
+	 */
+	addrr(db, "example.", dns_rdatatype_a, a, sizeof(a), now);
+	addrr(db, "2t7b4g4vsa5smi47k61mv5bv1a22bojr.example.",
+	      dns_rdatatype_nsec3, nsec3, sizeof(nsec3), now);
+	addrr(db, "b.example.", dns_rdatatype_a, a, sizeof(a), now);
+	addrr(db, "kcd3juae64f9c5csl1kif1htaui7un0g.b.example.",
+	      dns_rdatatype_nsec3, nsec3, sizeof(nsec3), now);
+	addrr(db, "mail.example.", dns_rdatatype_a, a, sizeof(a), now);
+	addrr(db, "q04jkcevqvmu85r014c7dkba38o0ji5r.example.",
+	      dns_rdatatype_nsec3, nsec3, sizeof(nsec3), now);
+
+	checkcovering(db, "n0000000000000000000000000000000.example.",
+		      dns_rdatatype_nsec3,
+		      "2t7b4g4vsa5smi47k61mv5bv1a22bojr.example.");
+	checkcovering(db, "vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv.example.",
+		      dns_rdatatype_nsec3,
+		      "q04jkcevqvmu85r014c7dkba38o0ji5r.example.");
+	checkcovering(db, "00000000000000000000000000000000.example.",
+		      dns_rdatatype_nsec3, NULL);
+	checkcovering(db, "z0000000000000000000000000000000.b.example.",
+		      dns_rdatatype_nsec3,
+		      "kcd3juae64f9c5csl1kif1htaui7un0g.b.example.");
+
+	/* An NSEC must be at the first name with data before the name. */
+	checkcovering(db, "n0000000000000000000000000000000.example.",
+		      dns_rdatatype_nsec, NULL);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
+	ATF_TP_ADD_TC(tp, prefetch);
+	ATF_TP_ADD_TC(tp, servestale);
+	ATF_TP_ADD_TC(tp, coveringnsec3);
 	return (atf_no_error());
 }
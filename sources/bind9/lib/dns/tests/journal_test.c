@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <isc/file.h>
+#include <isc/stdio.h>
+
+#include <dns/diff.h>
+#include <dns/journal.h>
+#include <dns/rdata.h>
+#include <dns/rdatastruct.h>
+
+#include "dnstest.h"
+
+#define JOURNAL		"journal.jnl"
+#define DENSE		"journal.jix"
+#define COUNT		500
+
+/*
+ * Helper functions
+ */
+
+static void
+cleanup(void) {
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(DENSE);
+}
+
+static off_t
+densesize(void) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	off_t size;
+
+	result = isc_stdio_open(DENSE, "rb", &fp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_file_getsizefd(fileno(fp), &size);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_stdio_close(fp);
+	return (size);
+}
+
+static void
+maketuple(dns_diff_t *diff, dns_diffop_t op, dns_rdatatype_t type,
+	  void *source)
+{
+	isc_result_t result;
+	unsigned char data[512];
+	isc_buffer_t b;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_difftuple_t *tuple = NULL;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_rdata_fromstruct(&rdata, dns_rdataclass_in, type,
+				      source, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_difftuple_create(mctx, op, dns_rootname, 300, &rdata,
+				      &tuple);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_append(diff, &tuple);
+}
+
+/*
+ * Write a transaction taking the root zone from 'serial' to 'serial + 1'
+ * and adding one A record.
+ */
+static void
+writeserial(dns_journal_t *j, isc_uint32_t serial) {
+	isc_result_t result;
+	dns_diff_t diff;
+	dns_rdata_soa_t soa;
+	dns_rdata_in_a_t a;
+
+	dns_diff_init(mctx, &diff);
+
+	soa.common.rdclass = dns_rdataclass_in;
+	soa.common.rdtype = dns_rdatatype_soa;
+	ISC_LINK_INIT(&soa.common, link);
+	soa.mctx = NULL;
+	dns_name_init(&soa.origin, NULL);
+	dns_name_clone(dns_rootname, &soa.origin);
+	dns_name_init(&soa.contact, NULL);
+	dns_name_clone(dns_rootname, &soa.contact);
+	soa.refresh = soa.retry = soa.expire = soa.minimum = 300;
+	soa.serial = serial;
+	maketuple(&diff, DNS_DIFFOP_DEL, dns_rdatatype_soa, &soa);
+	soa.serial = serial + 1;
+	maketuple(&diff, DNS_DIFFOP_ADD, dns_rdatatype_soa, &soa);
+
+	a.common.rdclass = dns_rdataclass_in;
+	a.common.rdtype = dns_rdatatype_a;
+	ISC_LINK_INIT(&a.common, link);
+	a.in_addr.s_addr = htonl(0x0a000000 + serial);
+	maketuple(&diff, DNS_DIFFOP_ADD, dns_rdatatype_a, &a);
+
+	result = dns_journal_write_transaction(j, &diff);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_clear(&diff);
+}
+
+/*
+ * Write transactions from 'first' to 'last' to the journal.
+ */
+static void
+writejournal(isc_uint32_t first, isc_uint32_t last) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	isc_uint32_t serial;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (serial = first; serial < last; serial++)
+		writeserial(j, serial);
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Return the last serial of the journal as seen by a new reader.
+ */
+static isc_uint32_t
+lastserial(void) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	isc_uint32_t serial;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	serial = dns_journal_last_serial(j);
+	dns_journal_destroy(&j);
+	return (serial);
+}
+
+/*
+ * Iterate over the journal from 'begin' to 'end', checking that the
+ * expected number of SOA and A records are seen.
+ */
+static void
+checkrange(isc_uint32_t begin, isc_uint32_t end) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	dns_name_t *name;
+	isc_uint32_t ttl;
+	dns_rdata_t *rdata;
+	unsigned int soas = 0, as = 0;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_journal_iter_init(j, begin, end);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (result = dns_journal_first_rr(j);
+	     result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j)) {
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		ATF_CHECK(dns_name_equal(name, dns_rootname));
+		ATF_CHECK_EQ(ttl, 300);
+		if (rdata->type == dns_rdatatype_soa)
+			soas++;
+		else if (rdata->type == dns_rdatatype_a)
+			as++;
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK_EQ(soas, 2 * (end - begin));
+	ATF_CHECK_EQ(as, end - begin);
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(dense);
+ATF_TC_HEAD(dense, tc) {
+	atf_tc_set_md_var(tc, "descr", "dense journal index");
+}
+ATF_TC_BODY(dense, tc) {
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, COUNT / 2);
+	writejournal(COUNT / 2, COUNT);
+	ATF_CHECK_EQ(lastserial(), COUNT);
+
+	/*
+	 * One format string plus one entry per transaction.
+	 */
+	ATF_CHECK_EQ(densesize(), 16 + 8 * (COUNT - 1));
+
+	checkrange(1, COUNT);
+	checkrange(7, 8);
+	checkrange(COUNT / 2 - 1, COUNT / 2 + 1);
+	checkrange(COUNT - 3, COUNT);
+	checkrange(COUNT, COUNT);
+
+	cleanup();
+	dns_test_end();
+}
+
+ATF_TC(stale);
+ATF_TC_HEAD(stale, tc) {
+	atf_tc_set_md_var(tc, "descr", "missing or stale dense index");
+}
+ATF_TC_BODY(stale, tc) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	unsigned char junk[8 * 16];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, COUNT);
+
+	/*
+	 * Missing: lookups scan the journal; a writer rebuilds it.
+	 */
+	ATF_REQUIRE_EQ(isc_file_remove(DENSE), ISC_R_SUCCESS);
+	checkrange(COUNT / 3, COUNT / 2);
+	writejournal(COUNT, COUNT + 1);
+	ATF_CHECK_EQ(densesize(), 16 + 8 * COUNT);
+
+	/*
+	 * Garbage entries: lookups verify each candidate and ignore them.
+	 */
+	memset(junk, 0x5a, sizeof(junk));
+	result = isc_stdio_open(DENSE, "rb+", &fp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_seek(fp, 16 + 8 * (COUNT / 2), SEEK_SET);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(junk, sizeof(junk), 1, fp, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_stdio_close(fp);
+	checkrange(COUNT / 2 + 3, COUNT / 2 + 5);
+	checkrange(COUNT / 2 + 20, COUNT + 1);
+	writejournal(COUNT + 1, COUNT + 2);
+	checkrange(COUNT / 2 + 3, COUNT + 2);
+
+	/*
+	 * Truncated: lookups scan the journal; a writer rebuilds it.
+	 */
+	result = isc_stdio_open(DENSE, "wb", &fp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_stdio_close(fp);
+	checkrange(2, COUNT);
+	writejournal(COUNT + 2, COUNT + 3);
+	ATF_CHECK_EQ(densesize(), 16 + 8 * (COUNT + 2));
+
+	cleanup();
+	dns_test_end();
+}
+
+ATF_TC(groupcommit);
+ATF_TC_HEAD(groupcommit, tc) {
+	atf_tc_set_md_var(tc, "descr", "group commit");
+}
+ATF_TC_BODY(groupcommit, tc) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	isc_uint32_t serial;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, 10);
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_WRITE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_journal_setgroupcommit(j, ISC_TRUE);
+	for (serial = 10; serial < 20; serial++)
+		writeserial(j, serial);
+	ATF_CHECK_EQ(dns_journal_last_serial(j), 20);
+	ATF_CHECK_EQ(lastserial(), 10);
+	result = dns_journal_sync(j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lastserial(), 20);
+	checkrange(5, 20);
+
+	/*
+	 * Destroying the journal syncs any remaining transactions.
+	 */
+	for (serial = 20; serial < 30; serial++)
+		writeserial(j, serial);
+	ATF_CHECK_EQ(lastserial(), 20);
+	dns_journal_destroy(&j);
+	ATF_CHECK_EQ(lastserial(), 30);
+	checkrange(1, 30);
+
+	cleanup();
+	dns_test_end();
+}
+
+ATF_TC(compact);
+ATF_TC_HEAD(compact, tc) {
+	atf_tc_set_md_var(tc, "descr", "compaction keeps the dense index");
+}
+ATF_TC_BODY(compact, tc) {
+	isc_result_t result;
+	char journal[] = JOURNAL;
+	dns_journal_t *j = NULL;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cleanup();
+
+	writejournal(1, COUNT);
+	result = dns_journal_compact(mctx, journal, COUNT / 2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_journal_first_serial(j), COUNT / 2);
+	ATF_CHECK_EQ(dns_journal_last_serial(j), COUNT);
+	dns_journal_destroy(&j);
+
+	ATF_CHECK_EQ(densesize(), 16 + 8 * (COUNT - COUNT / 2));
+	ATF_CHECK(!isc_file_exists("journal.jnw.jix"));
+
+	checkrange(COUNT / 2, COUNT);
+	checkrange(COUNT - 10, COUNT - 5);
+	writejournal(COUNT, COUNT + 1);
+	checkrange(COUNT / 2 + 1, COUNT + 1);
+
+	cleanup();
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, dense);
+	ATF_TP_ADD_TC(tp, stale);
+	ATF_TP_ADD_TC(tp, groupcommit);
+	ATF_TP_ADD_TC(tp, compact);
+	return (atf_no_error());
+}
@@ -29,6 +29,7 @@
 #include <dns/cache.h>
 #include <dns/callbacks.h>
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/name.h>
@@ -564,6 +565,119 @@ ATF_TC_BODY(dumpraw, tc) {
 	dns_test_end();
 }
 
+static isc_boolean_t
+same_contents(const char *file1, const char *file2) {
+	FILE *f1, *f2;
+	int c1, c2;
+
+	f1 = fopen(file1, "r");
+	f2 = fopen(file2, "r");
+	if (f1 == NULL || f2 == NULL) {
+		if (f1 != NULL)
+			fclose(f1);
+		if (f2 != NULL)
+			fclose(f2);
+		return (ISC_FALSE);
+	}
+	do {
+		c1 = getc(f1);
+		c2 = getc(f2);
+	} while (c1 == c2 && c1 != EOF);
+	fclose(f1);
+	fclose(f2);
+	return (ISC_TF(c1 == c2));
+}
+
+/* Map dump and load */
+ATF_TC(dumpmap);
+ATF_TC_HEAD(dumpmap, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_dump*() functions "
+				       "dump map files that load back to "
+				       "the same zone");
+}
+ATF_TC_BODY(dumpmap, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *mapdb = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	unsigned char byte;
+	FILE *f;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "testdata/master/master1.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_master_dump2(mctx, db, NULL, &dns_master_style_default,
+				  "test.dump", dns_masterformat_map);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_default,
+				 "test.text");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &mapdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load3(mapdb, "test.dump", dns_masterformat_map, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_master_dump(mctx, mapdb, NULL,
+				 &dns_master_style_default, "test.map.text");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(same_contents("test.text", "test.map.text"));
+
+	/*
+	 * Records loaded from the map can be changed.
+	 */
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "b." TEST_ORIGIN, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(mapdb, name, ISC_FALSE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_newversion(mapdb, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(mapdb, node, version,
+				       dns_rdatatype_a, 0);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(mapdb, &version, ISC_TRUE);
+	dns_db_detachnode(mapdb, &node);
+	dns_db_detach(&mapdb);
+
+	/*
+	 * A damaged image header is refused.
+	 */
+	f = fopen("test.dump", "r+b");
+	ATF_REQUIRE(f != NULL);
+	ATF_REQUIRE_EQ(fseek(f, 24 + 20, SEEK_SET), 0);
+	ATF_REQUIRE_EQ(fread(&byte, 1, 1, f), 1);
+	byte ^= 0xff;
+	ATF_REQUIRE_EQ(fseek(f, 24 + 20, SEEK_SET), 0);
+	ATF_REQUIRE_EQ(fwrite(&byte, 1, 1, f), 1);
+	fclose(f);
+
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &mapdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load3(mapdb, "test.dump", dns_masterformat_map, 0);
+	ATF_CHECK_EQ(result, ISC_R_INVALIDFILE);
+	dns_db_detach(&mapdb);
+
+	unlink("test.dump");
+	unlink("test.text");
+	unlink("test.map.text");
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
 static const char *warn_expect_value;
 static isc_boolean_t warn_expect_result;
 
@@ -608,6 +722,353 @@ ATF_TC_BODY(neworigin, tc) {
 	dns_test_end();
 }
 
+static isc_result_t
+load_threads(const char *file, unsigned int threads, const char *dump,
+	     isc_uint64_t *records,
+	     void (*warn)(struct dns_rdatacallbacks *, const char *, ...))
+{
+	isc_result_t result, tresult;
+	dns_rdatacallbacks_t callbacks;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_db_t *db = NULL;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_rdatacallbacks_init_stdio(&callbacks);
+	if (warn != NULL)
+		callbacks.warn = warn;
+	result = dns_db_beginload2(db, &callbacks);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = dns_master_loadfile4(file, name, name, dns_rdataclass_in,
+				      0, 0, &callbacks, mctx,
+				      dns_masterformat_text, threads);
+	tresult = dns_db_endload(db, &callbacks.add_private);
+	if (result == ISC_R_SUCCESS)
+		result = tresult;
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	*records = callbacks.records;
+
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_default,
+				 dump);
+ cleanup:
+	dns_db_detach(&db);
+	return (result);
+}
+
+/* Parallel text load */
+ATF_TC(loadthreads);
+ATF_TC_HEAD(loadthreads, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_loadfile4() loads the "
+				       "same zone with one or more threads");
+}
+ATF_TC_BODY(loadthreads, tc) {
+	isc_result_t result;
+	isc_uint64_t serial = 0, parallel = 0;
+	FILE *f;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Large enough to be cut into chunks, with multi-line records,
+	 * comments, and $TTL and $ORIGIN changes part way through.
+	 */
+	f = fopen("test.zone", "w");
+	ATF_REQUIRE(f != NULL);
+	fprintf(f, "$TTL 1000\n"
+		   "@\tIN SOA ns hostmaster (\n"
+		   "\t\t1 ; serial\n"
+		   "\t\t3600 1800 604800 300 )\n"
+		   "\tNS ns\n"
+		   "ns\tA 10.53.0.1\n");
+	for (i = 0; i < 40000; i++) {
+		if (i == 15000)
+			fprintf(f, "$TTL 2000\n");
+		if (i == 25000)
+			fprintf(f, "$ORIGIN sub." TEST_ORIGIN "\n");
+		if (i % 97 == 0)
+			fprintf(f, "; host %d\n", i);
+		fprintf(f, "host%d\tA 10.%d.%d.%d\n", i, (i >> 16) & 0xff,
+			(i >> 8) & 0xff, i & 0xff);
+		if (i % 50 == 0)
+			fprintf(f, "\tTXT ( \"text (%d)\"\n"
+				   "\t\"; more\" )\n", i);
+		else
+			fprintf(f, "\t300 AAAA fd92::%x\n", i);
+	}
+	ATF_REQUIRE_EQ(fclose(f), 0);
+
+	result = load_threads("test.zone", 1, "test.text", &serial, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = load_threads("test.zone", 4, "test.parallel.text",
+			      &parallel, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(serial, 3 + 40000 * 2);
+	ATF_CHECK_EQ(serial, parallel);
+	ATF_CHECK(same_contents("test.text", "test.parallel.text"));
+
+	/*
+	 * An error in any chunk fails the load.
+	 */
+	f = fopen("test.zone", "a");
+	ATF_REQUIRE(f != NULL);
+	fprintf(f, "bad\tA 10.0.0.256\n");
+	ATF_REQUIRE_EQ(fclose(f), 0);
+	result = load_threads("test.zone", 4, "test.parallel.text",
+			      &parallel, NULL);
+	ATF_CHECK_EQ(result, DNS_R_BADDOTTEDQUAD);
+
+	unlink("test.zone");
+	unlink("test.text");
+	unlink("test.parallel.text");
+	dns_test_end();
+}
+
+static int warn_count;
+static char warn_first[4096];
+
+static void
+warn_record(struct dns_rdatacallbacks *mycallbacks, const char *fmt, ...) {
+	char buf[4096];
+	va_list ap;
+
+	UNUSED(mycallbacks);
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (strstr(buf, "signature has expired") == NULL)
+		return;
+	if (warn_count++ == 0)
+		strcpy(warn_first, buf);
+}
+
+/* Parallel text load warnings */
+ATF_TC(warnthreads);
+ATF_TC_HEAD(warnthreads, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_loadfile4() gives a "
+				       "once-only warning once per zone "
+				       "with one or more threads");
+}
+ATF_TC_BODY(warnthreads, tc) {
+	isc_result_t result;
+	isc_uint64_t serial = 0, parallel = 0;
+	char first[sizeof(warn_first)];
+	FILE *f;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Expired signatures throughout the file, so that every chunk
+	 * has some.
+	 */
+	f = fopen("test.zone", "w");
+	ATF_REQUIRE(f != NULL);
+	fprintf(f, "$TTL 1000\n"
+		   "@\tIN SOA ns hostmaster 1 3600 1800 604800 300\n"
+		   "\tNS ns\n"
+		   "ns\tA 10.53.0.1\n");
+	for (i = 0; i < 20000; i++) {
+		fprintf(f, "host%d\tA 10.%d.%d.%d\n", i, (i >> 16) & 0xff,
+			(i >> 8) & 0xff, i & 0xff);
+		if (i % 100 == 99)
+			fprintf(f, "\tRRSIG A 8 2 1000 20000101000000 "
+				   "19991201000000 12345 " TEST_ORIGIN " "
+				   "AwEAAQ==\n");
+	}
+	ATF_REQUIRE_EQ(fclose(f), 0);
+
+	warn_count = 0;
+	result = load_threads("test.zone", 1, "test.text", &serial,
+			      warn_record);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(warn_count, 1);
+	strcpy(first, warn_first);
+
+	warn_count = 0;
+	result = load_threads("test.zone", 4, "test.parallel.text",
+			      &parallel, warn_record);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(warn_count, 1);
+	ATF_CHECK_STREQ(warn_first, first);
+	ATF_CHECK_EQ(serial, parallel);
+
+	unlink("test.zone");
+	unlink("test.text");
+	unlink("test.parallel.text");
+	dns_test_end();
+}
+
+static isc_result_t
+file_write(void *arg, const unsigned char *base, unsigned int length) {
+	FILE *f = arg;
+
+	if (fwrite(base, 1, length, f) != length)
+		return (ISC_R_FAILURE);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_boolean_t
+same_buffer(const char *file, isc_buffer_t *buffer) {
+	FILE *f;
+	unsigned char *p = isc_buffer_base(buffer);
+	unsigned int i, n = isc_buffer_usedlength(buffer);
+	int c;
+
+	f = fopen(file, "r");
+	if (f == NULL)
+		return (ISC_FALSE);
+	for (i = 0; i < n; i++)
+		if ((c = getc(f)) != p[i])
+			break;
+	c = getc(f);
+	fclose(f);
+	return (ISC_TF(i == n && c == EOF));
+}
+
+/* Parallel dump */
+ATF_TC(dumpthreads);
+ATF_TC_HEAD(dumpthreads, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_dump4() writes the "
+				       "same file with one or more threads");
+}
+ATF_TC_BODY(dumpthreads, tc) {
+	const dns_master_style_t *styles[] = {
+		&dns_master_style_default,
+		&dns_master_style_full,
+		&dns_master_style_explicitttl
+	};
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dumpsink_t sink;
+	isc_buffer_t buffer;
+	unsigned char *base;
+	unsigned int size = 4 * 1024 * 1024;
+	FILE *f;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Enough names to be split into ranges, at several depths and
+	 * with empty non-terminals, and with the TTL changing often.
+	 */
+	f = fopen("test.zone", "w");
+	ATF_REQUIRE(f != NULL);
+	fprintf(f, "$TTL 1000\n"
+		   "@\tIN SOA ns hostmaster 1 3600 1800 604800 300\n"
+		   "\tNS ns\n"
+		   "ns\tA 10.53.0.1\n");
+	for (i = 0; i < 20000; i++) {
+		switch (i % 3) {
+		case 0:
+			fprintf(f, "host%d", i);
+			break;
+		case 1:
+			fprintf(f, "h%d.sub%d", i, i / 500);
+			break;
+		case 2:
+			fprintf(f, "a.b%d.ent%d", i, i / 700);
+			break;
+		}
+		fprintf(f, "\t%d A 10.%d.%d.%d\n", 300 + (i / 7 % 3) * 100,
+			(i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+		if (i % 5 == 0)
+			fprintf(f, "\tTXT \"text %d\"\n", i);
+	}
+	ATF_REQUIRE_EQ(fclose(f), 0);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "test.zone");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < (int)(sizeof(styles) / sizeof(styles[0])); i++) {
+		result = dns_master_dump4(mctx, db, NULL, styles[i],
+					  "test.text", dns_masterformat_text,
+					  NULL, 1);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_master_dump4(mctx, db, NULL, styles[i],
+					  "test.parallel.text",
+					  dns_masterformat_text, NULL, 4);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(same_contents("test.text", "test.parallel.text"));
+	}
+
+	result = dns_master_dump4(mctx, db, NULL, &dns_master_style_default,
+				  "test.dump", dns_masterformat_raw, NULL, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_master_dump4(mctx, db, NULL, &dns_master_style_default,
+				  "test.parallel.dump", dns_masterformat_raw,
+				  NULL, 3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(same_contents("test.dump", "test.parallel.dump"));
+
+	/*
+	 * Dumping to a sink gives the same output.
+	 */
+	f = fopen("test.parallel.text", "w");
+	ATF_REQUIRE(f != NULL);
+	sink.write = file_write;
+	sink.arg = f;
+	result = dns_master_dumptosink(mctx, db, NULL,
+				       &dns_master_style_explicitttl,
+				       dns_masterformat_text, NULL, 4, &sink);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(fclose(f), 0);
+	ATF_CHECK(same_contents("test.text", "test.parallel.text"));
+
+	base = isc_mem_get(mctx, size);
+	ATF_REQUIRE(base != NULL);
+	isc_buffer_init(&buffer, base, size);
+	dns_dumpsink_initbuffer(&sink, &buffer);
+	result = dns_master_dumptosink(mctx, db, NULL,
+				       &dns_master_style_explicitttl,
+				       dns_masterformat_text, NULL, 2, &sink);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(same_buffer("test.text", &buffer));
+
+	/*
+	 * A sink error stops the dump.
+	 */
+	isc_buffer_init(&buffer, base, 100000);
+	result = dns_master_dumptosink(mctx, db, NULL,
+				       &dns_master_style_explicitttl,
+				       dns_masterformat_text, NULL, 4, &sink);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	isc_mem_put(mctx, base, size);
+
+	unlink("test.zone");
+	unlink("test.text");
+	unlink("test.parallel.text");
+	unlink("test.dump");
+	unlink("test.parallel.dump");
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -626,6 +1087,10 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, totext);
 	ATF_TP_ADD_TC(tp, loadraw);
 	ATF_TP_ADD_TC(tp, dumpraw);
+	ATF_TP_ADD_TC(tp, dumpmap);
+	ATF_TP_ADD_TC(tp, loadthreads);
+	ATF_TP_ADD_TC(tp, warnthreads);
+	ATF_TP_ADD_TC(tp, dumpthreads);
 	ATF_TP_ADD_TC(tp, toobig);
 	ATF_TP_ADD_TC(tp, maxrdata);
 	ATF_TP_ADD_TC(tp, neworigin);
@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/string.h>
+
+#include <dns/compress.h>
+#include <dns/masterdump.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+
+#include "dnstest.h"
+
+#define NTEMP	40
+
+/*
+ * A query for www.example/A carrying a record in each of the other
+ * sections and an OPT record.
+ */
+static unsigned char query[] = {
+	0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x01, 0x00, 0x02,
+	/* www.example/A/IN */
+	0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e',
+	0x00, 0x00, 0x01, 0x00, 0x01,
+	/* www.example 300 A 10.0.0.1 */
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c,
+	0x00, 0x04, 0x0a, 0x00, 0x00, 0x01,
+	/* example 300 NS www.example */
+	0xc0, 0x10, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c,
+	0x00, 0x02, 0xc0, 0x0c,
+	/* www.example 300 A 10.0.0.2 */
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c,
+	0x00, 0x04, 0x0a, 0x00, 0x00, 0x02,
+	/* OPT */
+	0x00, 0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+#define ANSWER_RDLEN	39	/* offset of the answer's RDLENGTH */
+
+/*
+ * Render a query for 'qname' into 'buf'.
+ */
+static void
+render_query(const char *qname, isc_buffer_t *buf) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_compress_t cctx;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	msg->id = 1;
+	msg->opcode = dns_opcode_query;
+	msg->rdclass = dns_rdataclass_in;
+
+	result = dns_message_gettempname(msg, &name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(name, qname, 0, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_gettemprdataset(msg, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_makequestion(rdataset, dns_rdataclass_in,
+				  dns_rdatatype_a);
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, DNS_SECTION_QUESTION);
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_renderbegin(msg, &cctx, buf);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_renderend(msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+
+	dns_message_destroy(&msg);
+}
+
+/*
+ * Parse 'length' octets of query[] with 'options' into a new message.
+ */
+static isc_result_t
+parse_query(unsigned int length, unsigned int options,
+	    dns_message_t **msgp)
+{
+	isc_result_t result;
+	isc_buffer_t buf;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, msgp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&buf, query, length);
+	isc_buffer_add(&buf, length);
+	return (dns_message_parse(*msgp, &buf, options));
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(arena_temp);
+ATF_TC_HEAD(arena_temp, tc) {
+	atf_tc_set_md_var(tc, "descr", "temporary names and rdatasets come "
+			  "from the message arena and are reclaimed by "
+			  "dns_message_reset()");
+}
+ATF_TC_BODY(arena_temp, tc) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_name_t *names[NTEMP];
+	dns_rdataset_t *rdatasets[NTEMP];
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_message_setarena(msg, ISC_TRUE);
+	ATF_CHECK_EQ(dns_message_arenasaved(msg), 0);
+
+	for (i = 0; i < NTEMP; i++) {
+		names[i] = NULL;
+		rdatasets[i] = NULL;
+		result = dns_message_gettempname(msg, &names[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_gettemprdataset(msg, &rdatasets[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Blocks hold 16 of each, so 3 of each had to be allocated.
+	 */
+	ATF_CHECK_EQ(dns_message_arenasaved(msg), 2 * (NTEMP - 3));
+
+	/*
+	 * Released objects are reused without allocating.
+	 */
+	dns_message_puttempname(msg, &names[0]);
+	dns_message_puttemprdataset(msg, &rdatasets[0]);
+	result = dns_message_gettempname(msg, &names[0]);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_gettemprdataset(msg, &rdatasets[0]);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_message_arenasaved(msg), 2 * (NTEMP - 2));
+
+	for (i = 0; i < NTEMP; i++) {
+		dns_message_puttempname(msg, &names[i]);
+		dns_message_puttemprdataset(msg, &rdatasets[i]);
+	}
+
+	dns_message_reset(msg, DNS_MESSAGE_INTENTRENDER);
+	ATF_CHECK_EQ(dns_message_arenasaved(msg), 0);
+
+	/*
+	 * The first block of each kind is kept across the reset.
+	 */
+	for (i = 0; i < 16; i++) {
+		names[i] = NULL;
+		rdatasets[i] = NULL;
+		result = dns_message_gettempname(msg, &names[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_gettemprdataset(msg, &rdatasets[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(dns_message_arenasaved(msg), 32);
+	for (i = 0; i < 16; i++) {
+		dns_message_puttempname(msg, &names[i]);
+		dns_message_puttemprdataset(msg, &rdatasets[i]);
+	}
+
+	dns_message_destroy(&msg);
+	dns_test_end();
+}
+
+ATF_TC(arena_parse);
+ATF_TC_HEAD(arena_parse, tc) {
+	atf_tc_set_md_var(tc, "descr", "a reused message parses in arena "
+			  "mode");
+}
+ATF_TC_BODY(arena_parse, tc) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	unsigned char data[512];
+	isc_buffer_t buf;
+	dns_name_t *name;
+	dns_fixedname_t fixed;
+	unsigned int pass;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&buf, data, sizeof(data));
+	render_query("www.example.", &buf);
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "www.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_message_setarena(msg, ISC_TRUE);
+
+	for (pass = 0; pass < 3; pass++) {
+		isc_buffer_first(&buf);
+		result = dns_message_parse(msg, &buf, 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		name = NULL;
+		dns_message_currentname(msg, DNS_SECTION_QUESTION, &name);
+		ATF_CHECK(dns_name_equal(name,
+					 dns_fixedname_name(&fixed)));
+		ATF_CHECK(!ISC_LIST_EMPTY(name->list));
+
+		/*
+		 * After the first query the arena needs no allocations.
+		 */
+		if (pass > 0)
+			ATF_CHECK_EQ(dns_message_arenasaved(msg), 2);
+
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	}
+
+	dns_message_destroy(&msg);
+	dns_test_end();
+}
+
+ATF_TC(lazy_parse);
+ATF_TC_HEAD(lazy_parse, tc) {
+	atf_tc_set_md_var(tc, "descr", "a lazily parsed query has the same "
+			  "contents as an eagerly parsed one");
+}
+ATF_TC_BODY(lazy_parse, tc) {
+	isc_result_t result;
+	dns_message_t *eager = NULL, *lazy = NULL;
+	dns_name_t *name;
+	char text1[2048], text2[2048];
+	isc_buffer_t b1, b2;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = parse_query(sizeof(query), 0, &eager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = parse_query(sizeof(query), DNS_MESSAGEPARSE_LAZY, &lazy);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The OPT record is found at once, the rest is left for later,
+	 * and the question name refers to the query itself.
+	 */
+	ATF_CHECK(lazy->opt != NULL);
+	ATF_CHECK(lazy->lazy != 0);
+	ATF_CHECK(ISC_LIST_EMPTY(lazy->sections[DNS_SECTION_ANSWER]));
+	result = dns_message_firstname(lazy, DNS_SECTION_QUESTION);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	name = NULL;
+	dns_message_currentname(lazy, DNS_SECTION_QUESTION, &name);
+	ATF_CHECK(name->ndata == &query[12]);
+
+	isc_buffer_init(&b1, text1, sizeof(text1));
+	result = dns_message_totext(eager, &dns_master_style_debug, 0, &b1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b2, text2, sizeof(text2));
+	result = dns_message_totext(lazy, &dns_master_style_debug, 0, &b2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(lazy->lazy == 0);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&b1),
+		       isc_buffer_usedlength(&b2));
+	ATF_CHECK(memcmp(text1, text2, isc_buffer_usedlength(&b1)) == 0);
+
+	dns_message_destroy(&eager);
+	dns_message_destroy(&lazy);
+	dns_test_end();
+}
+
+ATF_TC(lazy_error);
+ATF_TC_HEAD(lazy_error, tc) {
+	atf_tc_set_md_var(tc, "descr", "errors in a lazily parsed query "
+			  "are found when the records are used, or at once "
+			  "if the query is truncated");
+}
+ATF_TC_BODY(lazy_error, tc) {
+	isc_result_t result, expect;
+	dns_message_t *msg = NULL;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Shorten the answer's A record to three octets, leaving a
+	 * stray octet that is taken as part of the next owner name.
+	 */
+	query[ANSWER_RDLEN] = 3;
+
+	result = parse_query(sizeof(query), 0, &msg);
+	ATF_REQUIRE(result != ISC_R_SUCCESS);
+	expect = result;
+	dns_message_destroy(&msg);
+
+	result = parse_query(sizeof(query), DNS_MESSAGEPARSE_LAZY, &msg);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+		ATF_CHECK_EQ(result, expect);
+		result = dns_message_firstname(msg, DNS_SECTION_ADDITIONAL);
+		ATF_CHECK_EQ(result, expect);
+	} else
+		ATF_CHECK_EQ(result, expect);
+	dns_message_destroy(&msg);
+
+	query[ANSWER_RDLEN] = 4;
+
+	/*
+	 * A truncated query fails the same way with or without lazy
+	 * parsing.
+	 */
+	result = parse_query(sizeof(query) - 3, 0, &msg);
+	ATF_REQUIRE(result != ISC_R_SUCCESS);
+	expect = result;
+	dns_message_destroy(&msg);
+	result = parse_query(sizeof(query) - 3, DNS_MESSAGEPARSE_LAZY, &msg);
+	ATF_CHECK_EQ(result, expect);
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, arena_temp);
+	ATF_TP_ADD_TC(tp, arena_parse);
+	ATF_TP_ADD_TC(tp, lazy_parse);
+	ATF_TP_ADD_TC(tp, lazy_error);
+	return (atf_no_error());
+}
@@ -24,6 +24,10 @@
 
 #include <unistd.h>
 
+#include <isc/buffer.h>
+#include <isc/string.h>
+
+#include <dns/compress.h>
 #include <dns/name.h>
 #include <dns/fixedname.h>
 #include "dnstest.h"
@@ -117,11 +121,118 @@ ATF_TC_BODY(fullcompare, tc) {
 	}
 }
 
+/*
+ * Make 'name' a two label absolute name whose first label is 'length'
+ * copies of 'fill' with 'c' at 'pos'.
+ */
+static void
+makelabel(dns_name_t *name, unsigned char *wire, unsigned int length,
+	  unsigned int pos, int fill, int c)
+{
+	isc_region_t r;
+
+	wire[0] = length;
+	memset(wire + 1, fill, length);
+	wire[1 + pos] = c;
+	memmove(wire + 1 + length, "\003com", 5);
+	r.base = wire;
+	r.length = length + 6;
+	dns_name_fromregion(name, &r);
+}
+
+#define LOWER(c)	(((c) >= 'A' && (c) <= 'Z') ? (c) + 'a' - 'A' : (c))
+
+/*
+ * Check a label of 'length' octets that has 'c' at 'pos'.
+ */
+static void
+checkfold(unsigned int length, unsigned int pos, int c) {
+	unsigned char wire1[70], wire2[70], wire3[70], data[DNS_NAME_MAXWIRE];
+	dns_name_t name1, name2, name3;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_decompress_t dctx;
+	isc_buffer_t source, target;
+	isc_result_t result;
+	unsigned int nlabels;
+	int order, expect;
+
+	dns_name_init(&name1, NULL);
+	dns_name_init(&name2, NULL);
+	dns_name_init(&name3, NULL);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+
+	/*
+	 * 'name2' is 'name1' downcased; 'name3' differs from it in one octet.
+	 */
+	makelabel(&name1, wire1, length, pos, 'A', c);
+	makelabel(&name2, wire2, length, pos, 'a', LOWER(c));
+	makelabel(&name3, wire3, length, pos, 'a', c ^ 1);
+	expect = LOWER(c) < LOWER(c ^ 1) ? -1 : 1;
+
+	ATF_REQUIRE(dns_name_equal(&name1, &name2));
+	ATF_REQUIRE(!dns_name_equal(&name1, &name3));
+	ATF_REQUIRE_EQ(dns_name_rdatacompare(&name1, &name2), 0);
+	ATF_REQUIRE_EQ(dns_name_rdatacompare(&name1, &name3), expect);
+	(void)dns_name_fullcompare(&name1, &name2, &order, &nlabels);
+	ATF_REQUIRE_EQ(order, 0);
+	(void)dns_name_fullcompare(&name1, &name3, &order, &nlabels);
+	ATF_REQUIRE_EQ(order, LOWER(c) - LOWER(c ^ 1));
+	ATF_REQUIRE_EQ(dns_name_hash(&name1, ISC_FALSE),
+		       dns_name_hash(&name2, ISC_FALSE));
+
+	result = dns_name_downcase(&name1, name, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(dns_name_caseequal(name, &name2));
+
+	isc_buffer_init(&source, wire1, name1.length);
+	isc_buffer_add(&source, name1.length);
+	isc_buffer_setactive(&source, name1.length);
+	isc_buffer_init(&target, data, sizeof(data));
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	result = dns_name_fromwire(name, &source, &dctx, DNS_NAME_DOWNCASE,
+				   &target);
+	dns_decompress_invalidate(&dctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(dns_name_caseequal(name, &name2));
+
+	/*
+	 * A label that runs off the end of the message.
+	 */
+	isc_buffer_init(&source, wire1, name1.length);
+	isc_buffer_add(&source, name1.length);
+	isc_buffer_setactive(&source, length);
+	isc_buffer_init(&target, data, sizeof(data));
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	result = dns_name_fromwire(name, &source, &dctx, 0, &target);
+	dns_decompress_invalidate(&dctx);
+	ATF_REQUIRE_EQ(result, ISC_R_UNEXPECTEDEND);
+}
+
+ATF_TC(casefold);
+ATF_TC_HEAD(casefold, tc) {
+	atf_tc_set_md_var(tc, "descr", "case insensitive comparison, "
+			  "hashing and downcasing of every octet");
+}
+ATF_TC_BODY(casefold, tc) {
+	unsigned int length, pos;
+	int c;
+
+	UNUSED(tc);
+
+	for (length = 1; length <= 63; length++)
+		for (pos = 0; pos < length; pos++)
+			for (c = 0; c < 256; c++)
+				checkfold(length, pos, c);
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
+	ATF_TP_ADD_TC(tp, casefold);
 
 	return (atf_no_error());
 }
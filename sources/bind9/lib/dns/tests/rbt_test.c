@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <isc/stats.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+
+#include "dnstest.h"
+
+#define NNAMES		600
+
+/*
+ * Helper functions
+ */
+
+static void
+makename(unsigned int i, isc_boolean_t upper, dns_name_t *name) {
+	isc_result_t result;
+	char text[100];
+
+	/*
+	 * Spread the names over several levels and make some of them
+	 * ancestors of others.
+	 */
+	switch (i % 4) {
+	case 0:
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		break;
+	case 1:
+		snprintf(text, sizeof(text), "n%u.sub%u.example.", i, i % 7);
+		break;
+	case 2:
+		snprintf(text, sizeof(text), "sub%u.example.", i % 11);
+		break;
+	default:
+		snprintf(text, sizeof(text), "a.b.n%u.deep%u.example.",
+			 i, i % 3);
+		break;
+	}
+	if (upper)
+		text[0] = 'N';
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+addnames(dns_rbt_t *rbt) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	unsigned int i;
+
+	for (i = 0; i < NNAMES; i++) {
+		dns_fixedname_init(&fname);
+		makename(i, ISC_FALSE, dns_fixedname_name(&fname));
+		result = dns_rbt_addname(rbt, dns_fixedname_name(&fname),
+					 (void *)(size_t)(i + 1));
+		ATF_REQUIRE(result == ISC_R_SUCCESS || result == ISC_R_EXISTS);
+	}
+}
+
+/*
+ * Look 'name' up in both trees and check that they agree on the result,
+ * the node data, the found name and the chain.
+ */
+static void
+compare(dns_rbt_t *indexed, dns_rbt_t *plain, dns_name_t *name,
+	unsigned int options)
+{
+	dns_rbtnodechain_t chain1, chain2;
+	dns_fixedname_t ffound1, ffound2, fcur1, fcur2;
+	dns_rbtnode_t *node1 = NULL, *node2 = NULL;
+	isc_result_t result1, result2;
+
+	dns_rbtnodechain_init(&chain1, mctx);
+	dns_rbtnodechain_init(&chain2, mctx);
+	dns_fixedname_init(&ffound1);
+	dns_fixedname_init(&ffound2);
+
+	result1 = dns_rbt_findnode(indexed, name, dns_fixedname_name(&ffound1),
+				   &node1, &chain1, options, NULL, NULL);
+	result2 = dns_rbt_findnode(plain, name, dns_fixedname_name(&ffound2),
+				   &node2, &chain2, options, NULL, NULL);
+	ATF_REQUIRE_EQ(result1, result2);
+	if (result1 == ISC_R_SUCCESS || result1 == DNS_R_PARTIALMATCH) {
+		ATF_CHECK_EQ(node1->data, node2->data);
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&ffound1),
+					 dns_fixedname_name(&ffound2)));
+	}
+
+	/*
+	 * The chains must lead to the same names.
+	 */
+	if (chain1.end != NULL || chain2.end != NULL) {
+		dns_fixedname_init(&fcur1);
+		dns_fixedname_init(&fcur2);
+		result1 = dns_rbtnodechain_next(&chain1, NULL,
+						dns_fixedname_name(&fcur1));
+		result2 = dns_rbtnodechain_next(&chain2, NULL,
+						dns_fixedname_name(&fcur2));
+		ATF_REQUIRE_EQ(result1, result2);
+		if (result1 == ISC_R_SUCCESS || result1 == DNS_R_NEWORIGIN)
+			ATF_CHECK(dns_name_equal(dns_fixedname_name(&fcur1),
+						 dns_fixedname_name(&fcur2)));
+	}
+
+	dns_rbtnodechain_invalidate(&chain1);
+	dns_rbtnodechain_invalidate(&chain2);
+}
+
+static void
+compareall(dns_rbt_t *indexed, dns_rbt_t *plain) {
+	dns_fixedname_t fname;
+	unsigned int i;
+
+	for (i = 0; i < NNAMES + 20; i++) {
+		dns_fixedname_init(&fname);
+		makename(i, ISC_FALSE, dns_fixedname_name(&fname));
+		compare(indexed, plain, dns_fixedname_name(&fname), 0);
+		compare(indexed, plain, dns_fixedname_name(&fname),
+			DNS_RBTFIND_EMPTYDATA);
+		compare(indexed, plain, dns_fixedname_name(&fname),
+			DNS_RBTFIND_NOEXACT);
+
+		dns_fixedname_init(&fname);
+		makename(i, ISC_TRUE, dns_fixedname_name(&fname));
+		compare(indexed, plain, dns_fixedname_name(&fname), 0);
+	}
+}
+
+static isc_uint64_t counters[dns_rbtindexstats_max];
+
+static void
+getcounter(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	UNUSED(arg);
+
+	counters[counter] = value;
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(index);
+ATF_TC_HEAD(index, tc) {
+	atf_tc_set_md_var(tc, "descr", "lookups through the exact match "
+			  "index give the same results as the tree walk");
+}
+ATF_TC_BODY(index, tc) {
+	isc_result_t result;
+	dns_rbt_t *indexed = NULL, *plain = NULL;
+	dns_fixedname_t fname;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, NULL, NULL, &indexed);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_create(mctx, NULL, NULL, &plain);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_rbt_getindexstats(indexed) == NULL);
+
+	/*
+	 * Enable the index on a populated tree, then let it grow.
+	 */
+	addnames(plain);
+	for (i = 0; i < NNAMES / 2; i++) {
+		dns_fixedname_init(&fname);
+		makename(i, ISC_FALSE, dns_fixedname_name(&fname));
+		(void)dns_rbt_addname(indexed, dns_fixedname_name(&fname),
+				      (void *)(size_t)(i + 1));
+	}
+	result = dns_rbt_setindex(indexed, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	addnames(indexed);
+	ATF_CHECK_EQ(dns_rbt_nodecount(indexed), dns_rbt_nodecount(plain));
+
+	compareall(indexed, plain);
+
+	/*
+	 * Remove some names, including ones with names below them.
+	 */
+	for (i = 0; i < NNAMES; i += 3) {
+		dns_fixedname_init(&fname);
+		makename(i, ISC_FALSE, dns_fixedname_name(&fname));
+		result = dns_rbt_deletename(indexed,
+					    dns_fixedname_name(&fname),
+					    ISC_FALSE);
+		ATF_CHECK(result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND);
+		result = dns_rbt_deletename(plain,
+					    dns_fixedname_name(&fname),
+					    ISC_FALSE);
+		ATF_CHECK(result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND);
+	}
+	compareall(indexed, plain);
+
+	isc_stats_dump(dns_rbt_getindexstats(indexed), getcounter, NULL,
+		       ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK(counters[dns_rbtindexstats_hit] > 0);
+	ATF_CHECK(counters[dns_rbtindexstats_miss] > 0);
+
+	/*
+	 * Disabling the index keeps the counters.
+	 */
+	result = dns_rbt_setindex(indexed, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_rbt_getindexstats(indexed) != NULL);
+	compareall(indexed, plain);
+
+	dns_rbt_destroy(&indexed);
+	dns_rbt_destroy(&plain);
+	dns_test_end();
+}
+
+ATF_TC(callback);
+ATF_TC_HEAD(callback, tc) {
+	atf_tc_set_md_var(tc, "descr", "the exact match index does not "
+			  "skip find callbacks");
+}
+
+static unsigned int callbacks;
+
+static isc_result_t
+stop(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
+	UNUSED(node);
+	UNUSED(name);
+	UNUSED(arg);
+
+	callbacks++;
+	return (DNS_R_PARTIALMATCH);
+}
+
+ATF_TC_BODY(callback, tc) {
+	isc_result_t result;
+	dns_rbt_t *rbt = NULL;
+	dns_rbtnode_t *node = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_setindex(rbt, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_name_fromstring(name, "cut.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_addnode(rbt, name, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	node->data = name;
+	node->find_callback = 1;
+
+	result = dns_name_fromstring(name, "www.cut.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	node = NULL;
+	result = dns_rbt_addnode(rbt, name, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	node->data = name;
+
+	node = NULL;
+	callbacks = 0;
+	result = dns_rbt_findnode(rbt, name, NULL, &node, NULL, 0, stop,
+				  NULL);
+	ATF_CHECK_EQ(result, DNS_R_PARTIALMATCH);
+	ATF_CHECK_EQ(callbacks, 1);
+
+	/*
+	 * Without a callback the index answers.
+	 */
+	node = NULL;
+	result = dns_rbt_findnode(rbt, name, NULL, &node, NULL, 0, NULL,
+				  NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	isc_stats_dump(dns_rbt_getindexstats(rbt), getcounter, NULL,
+		       ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK_EQ(counters[dns_rbtindexstats_hit], 1);
+	ATF_CHECK_EQ(counters[dns_rbtindexstats_miss], 1);
+
+	dns_rbt_destroy(&rbt);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, index);
+	ATF_TP_ADD_TC(tp, callback);
+	return (atf_no_error());
+}
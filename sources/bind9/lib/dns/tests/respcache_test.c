@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/string.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+/*
+ * Make a key for 'qname'/A in 'fixed'.
+ */
+static void
+makekey(const char *qname, dns_fixedname_t *fixed, dns_respkey_t *key) {
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	result = dns_name_fromstring(dns_fixedname_name(fixed), qname, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	key->name = dns_fixedname_name(fixed);
+	key->type = dns_rdatatype_a;
+	key->rdclass = dns_rdataclass_in;
+	key->flags = 0;
+	key->size = 512;
+}
+
+static void
+add(dns_respcache_t *cache, dns_respkey_t *key, isc_uint32_t generation,
+    const char *response)
+{
+	isc_result_t result;
+	isc_region_t r;
+
+	DE_CONST(response, r.base);
+	r.length = strlen(response);
+	result = dns_respcache_add(cache, key, generation, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Look up 'key' and, if 'expect' is not NULL, check that it was found
+ * and is 'expect'.
+ */
+static void
+check(dns_respcache_t *cache, dns_respkey_t *key, isc_uint32_t generation,
+      const char *expect)
+{
+	isc_result_t result;
+	isc_buffer_t b;
+	unsigned char data[512];
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(cache, key, generation, &b);
+	if (expect == NULL) {
+		ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+		return;
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), strlen(expect));
+	ATF_CHECK(memcmp(data, expect, strlen(expect)) == 0);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses are found under the "
+			  "whole key");
+}
+ATF_TC_BODY(find, tc) {
+	isc_result_t result;
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t f1, f2;
+	dns_respkey_t key, other;
+	isc_buffer_t b;
+	unsigned char data[4];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_create(mctx, 65536, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makekey("www.example.com", &f1, &key);
+	check(cache, &key, 1, NULL);
+	add(cache, &key, 1, "response one");
+	check(cache, &key, 1, "response one");
+	ATF_CHECK_EQ(dns_respcache_count(cache), 1);
+
+	/* Each part of the key counts, and case is not folded. */
+	other = key;
+	other.type = dns_rdatatype_aaaa;
+	check(cache, &other, 1, NULL);
+	other = key;
+	other.flags = 1;
+	check(cache, &other, 1, NULL);
+	other = key;
+	other.size = 4096;
+	check(cache, &other, 1, NULL);
+	makekey("WWW.example.com", &f2, &other);
+	check(cache, &other, 1, NULL);
+
+	/* A second response replaces the first. */
+	add(cache, &key, 1, "response two");
+	check(cache, &key, 1, "response two");
+	ATF_CHECK_EQ(dns_respcache_count(cache), 1);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(cache, &key, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	dns_respcache_flush(cache);
+	ATF_CHECK_EQ(dns_respcache_count(cache), 0);
+	check(cache, &key, 1, NULL);
+
+	dns_respcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(generation);
+ATF_TC_HEAD(generation, tc) {
+	atf_tc_set_md_var(tc, "descr", "a response from another generation "
+			  "is removed");
+}
+ATF_TC_BODY(generation, tc) {
+	isc_result_t result;
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t f;
+	dns_respkey_t key;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_create(mctx, 65536, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makekey("www.example.com", &f, &key);
+	add(cache, &key, 1, "old");
+	check(cache, &key, 2, NULL);
+	ATF_CHECK_EQ(dns_respcache_count(cache), 0);
+	check(cache, &key, 1, NULL);
+
+	add(cache, &key, 2, "new");
+	check(cache, &key, 2, "new");
+
+	dns_respcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "the least recently used responses "
+			  "are removed to stay within the size");
+}
+ATF_TC_BODY(evict, tc) {
+	isc_result_t result;
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t f;
+	dns_respkey_t key;
+	char name[64], response[256];
+	isc_region_t r;
+	unsigned int i, count;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_create(mctx, 16 * 1024, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Too large for any shard. */
+	makekey("big.example.com", &f, &key);
+	memset(response, 0, sizeof(response));
+	r.base = (unsigned char *)response;
+	r.length = 2048;
+	result = dns_respcache_add(cache, &key, 1, &r);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	memset(response, 'x', sizeof(response) - 1);
+	response[sizeof(response) - 1] = '\0';
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "n%u.example.com", i);
+		makekey(name, &f, &key);
+		add(cache, &key, 1, response);
+		/* Keep the first name in use. */
+		makekey("n0.example.com", &f, &key);
+		check(cache, &key, 1, response);
+	}
+
+	count = dns_respcache_count(cache);
+	ATF_CHECK(count > 0);
+	ATF_CHECK(count * (strlen(response) + 16) <= 16 * 1024);
+	makekey("n1.example.com", &f, &key);
+	check(cache, &key, 1, NULL);
+	makekey("n999.example.com", &f, &key);
+	check(cache, &key, 1, response);
+
+	dns_respcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses are still found after "
+			  "the hash tables have grown");
+}
+ATF_TC_BODY(grow, tc) {
+	isc_result_t result;
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t f;
+	dns_respkey_t key;
+	char name[64];
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_create(mctx, 64 * 1024 * 1024, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 20000; i++) {
+		snprintf(name, sizeof(name), "n%u.example.com", i);
+		makekey(name, &f, &key);
+		add(cache, &key, 1, name);
+	}
+	ATF_CHECK_EQ(dns_respcache_count(cache), 20000);
+
+	for (i = 0; i < 20000; i += 7) {
+		snprintf(name, sizeof(name), "n%u.example.com", i);
+		makekey(name, &f, &key);
+		check(cache, &key, 1, name);
+	}
+
+	dns_respcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(dbgeneration);
+ATF_TC_HEAD(dbgeneration, tc) {
+	atf_tc_set_md_var(tc, "descr", "a database gets a new generation "
+			  "when a version is committed");
+}
+ATF_TC_BODY(dbgeneration, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *db2 = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_uint32_t generation;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	generation = dns_db_getgeneration(db);
+	ATF_CHECK(generation != 0);
+	ATF_CHECK(generation != dns_db_getgeneration(db2));
+
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	ATF_CHECK_EQ(dns_db_getgeneration(db), generation);
+
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	ATF_CHECK(dns_db_getgeneration(db) != generation);
+	ATF_CHECK(dns_db_getgeneration(db) != 0);
+
+	dns_db_detach(&db2);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, generation);
+	ATF_TP_ADD_TC(tp, evict);
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, dbgeneration);
+	return (atf_no_error());
+}
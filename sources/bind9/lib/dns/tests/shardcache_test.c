@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdataset.h>
+
+#include "dnstest.h"
+
+#define TESTFILE	"testdata/shardcache/cache.data"
+#define NAMES		11
+
+/*
+ * Helper functions
+ */
+
+static const char *names[NAMES] = {
+	".", "a.root-servers.net.", "com.", "a.gtld-servers.net.",
+	"example.com.", "ns.example.com.", "www.example.com.",
+	"www.example.net.", "deep.sub.example.org.", "www.example.edu.",
+	"www.example.info."
+};
+
+/*
+ * Load the test data into a cache database with 'shards' shards.
+ */
+static void
+loadcache(const char *shards, dns_db_t **dbp) {
+	isc_result_t result;
+	char *argv[3];
+
+	argv[0] = (char *)mctx;
+	DE_CONST("0", argv[1]);
+	DE_CONST(shards, argv[2]);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 3, argv, dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load(*dbp, TESTFILE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Look up 'qname'/'type' and check the result and, for a delegation,
+ * the zone cut.
+ */
+static void
+check_find(dns_db_t *db, const char *qname, dns_rdatatype_t type,
+	   isc_result_t expect, const char *cut)
+{
+	isc_result_t result;
+	dns_fixedname_t fname, ffound, fcut;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+
+	dns_fixedname_init(&fname);
+	dns_fixedname_init(&ffound);
+	dns_fixedname_init(&fcut);
+	result = dns_name_fromstring(dns_fixedname_name(&fname), qname, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, type, 0, 0,
+			     &node, dns_fixedname_name(&ffound), &rdataset,
+			     NULL);
+	ATF_CHECK_EQ_MSG(result, expect, "%s: %s", qname,
+			 isc_result_totext(result));
+	if (result == DNS_R_DELEGATION) {
+		result = dns_name_fromstring(dns_fixedname_name(&fcut), cut,
+					     0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_MSG(dns_name_equal(dns_fixedname_name(&ffound),
+					     dns_fixedname_name(&fcut)),
+			      "%s: wrong zone cut", qname);
+		ATF_CHECK_EQ(rdataset.type, dns_rdatatype_ns);
+	}
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(args);
+ATF_TC_HEAD(args, tc) {
+	atf_tc_set_md_var(tc, "descr", "node lock and shard counts are "
+			  "checked");
+}
+ATF_TC_BODY(args, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	char *argv[3];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mctx;
+	DE_CONST("1", argv[1]);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	DE_CONST("0", argv[1]);
+	DE_CONST("0", argv[2]);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 3, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	DE_CONST("64", argv[1]);
+	DE_CONST("1", argv[2]);
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 3, argv, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+
+	dns_test_end();
+}
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr", "lookups in a sharded cache find "
+			  "zone cuts held by other shards");
+}
+ATF_TC_BODY(find, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	const char *shards[] = { "1", "4", "16" };
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The answers do not depend on the number of shards.
+	 */
+	for (i = 0; i < sizeof(shards) / sizeof(shards[0]); i++) {
+		loadcache(shards[i], &db);
+		ATF_CHECK(dns_db_iscache(db));
+
+		check_find(db, "www.example.com.", dns_rdatatype_a,
+			   ISC_R_SUCCESS, NULL);
+		check_find(db, "deep.sub.example.org.", dns_rdatatype_a,
+			   ISC_R_SUCCESS, NULL);
+		check_find(db, "other.example.com.", dns_rdatatype_a,
+			   DNS_R_DELEGATION, "example.com.");
+		check_find(db, "a.b.c.example.com.", dns_rdatatype_a,
+			   DNS_R_DELEGATION, "example.com.");
+		check_find(db, "www.other.com.", dns_rdatatype_a,
+			   DNS_R_DELEGATION, "com.");
+		check_find(db, "other.example.net.", dns_rdatatype_a,
+			   DNS_R_DELEGATION, ".");
+		check_find(db, "org.", dns_rdatatype_a,
+			   DNS_R_DELEGATION, ".");
+		check_find(db, "com.", dns_rdatatype_ns,
+			   ISC_R_SUCCESS, NULL);
+
+		dns_db_detach(&db);
+	}
+
+	dns_test_end();
+}
+
+ATF_TC(findzonecut);
+ATF_TC_HEAD(findzonecut, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_db_findzonecut() in a sharded "
+			  "cache");
+}
+ATF_TC_BODY(findzonecut, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname, ffound;
+	dns_rdataset_t rdataset;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	loadcache("8", &db);
+
+	dns_fixedname_init(&fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	/* The cut at example.com is in the name's own shard. */
+	result = dns_name_fromstring(dns_fixedname_name(&fname),
+				     "x.www.example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findzonecut(db, dns_fixedname_name(&fname), 0, 0,
+				    NULL, dns_fixedname_name(&ffound),
+				    &rdataset, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(dns_fixedname_name(&fname),
+				     "example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_name_equal(dns_fixedname_name(&ffound),
+				 dns_fixedname_name(&fname)));
+	dns_rdataset_disassociate(&rdataset);
+
+	/* Without the exact name, the cut above example.com is at com. */
+	result = dns_db_findzonecut(db, dns_fixedname_name(&fname),
+				    DNS_DBFIND_NOEXACT, 0, NULL,
+				    dns_fixedname_name(&ffound), &rdataset,
+				    NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(dns_fixedname_name(&fname), "com.", 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_name_equal(dns_fixedname_name(&ffound),
+				 dns_fixedname_name(&fname)));
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(iterate);
+ATF_TC_HEAD(iterate, tc) {
+	atf_tc_set_md_var(tc, "descr", "a sharded cache iterates in order "
+			  "over all its shards");
+}
+ATF_TC_BODY(iterate, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname, fprev;
+	dns_name_t *name, *prev;
+	isc_boolean_t seen[NAMES];
+	unsigned int i, count, tags = 0, nodes = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	loadcache("4", &db);
+
+	dns_fixedname_init(&fname);
+	dns_fixedname_init(&fprev);
+	name = dns_fixedname_name(&fname);
+	prev = dns_fixedname_name(&fprev);
+	for (i = 0; i < NAMES; i++)
+		seen[i] = ISC_FALSE;
+
+	result = dns_db_createiterator(db, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Forward: every name shows up, in order, and the nodes come
+	 * from more than one shard.
+	 */
+	count = 0;
+	for (result = dns_dbiterator_first(iter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter)) {
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		tags |= 1 << ((dns_rbtnode_t *)node)->tag;
+		dns_db_detachnode(db, &node);
+		if (count++ > 0)
+			ATF_CHECK(dns_name_compare(prev, name) <= 0);
+		for (i = 0; i < NAMES; i++) {
+			dns_fixedname_t fexpect;
+
+			dns_fixedname_init(&fexpect);
+			ATF_REQUIRE_EQ(dns_name_fromstring(
+					dns_fixedname_name(&fexpect),
+					names[i], 0, NULL), ISC_R_SUCCESS);
+			if (dns_name_equal(name,
+					   dns_fixedname_name(&fexpect)))
+				seen[i] = ISC_TRUE;
+		}
+		RUNTIME_CHECK(dns_name_copy(name, prev, NULL) ==
+			      ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	for (i = 0; i < NAMES; i++)
+		ATF_CHECK_MSG(seen[i], "%s not seen", names[i]);
+	ATF_CHECK(tags != 1 && tags != 2 && tags != 4 && tags != 8);
+	nodes = count;
+
+	/*
+	 * Backward: the same number of names in reverse order.
+	 */
+	count = 0;
+	for (result = dns_dbiterator_last(iter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_prev(iter)) {
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		if (count++ > 0)
+			ATF_CHECK(dns_name_compare(prev, name) >= 0);
+		RUNTIME_CHECK(dns_name_copy(name, prev, NULL) ==
+			      ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK_EQ(count, nodes);
+
+	/*
+	 * Seek to a name and walk its subdomains, then turn around.
+	 */
+	result = dns_name_fromstring(prev, "example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_seek(iter, prev);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	count = 0;
+	for (result = dns_dbiterator_next(iter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter)) {
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		if (!dns_name_issubdomain(name, prev))
+			break;
+		count++;
+	}
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 2);
+	result = dns_dbiterator_prev(iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	ATF_CHECK(dns_name_issubdomain(name, prev));
+
+	result = dns_name_fromstring(prev, "nonexistent.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_seek(iter, prev);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_dbiterator_destroy(&iter);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, args);
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, findzonecut);
+	ATF_TP_ADD_TC(tp, iterate);
+	return (atf_no_error());
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/string.h>
+
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+/*
+ * Make a key whose first octet is 'n'.
+ */
+static void
+makekey(unsigned int n, dns_sigcachekey_t *key) {
+	memset(key, 0, sizeof(*key));
+	key->digest[0] = n & 0xff;
+	key->digest[sizeof(key->digest) - 1] = (n >> 8) & 0xff;
+}
+
+static void
+check(dns_sigcache_t *cache, dns_sigcachekey_t *key, isc_stdtime_t now,
+      isc_result_t expect)
+{
+	isc_result_t result, found = ISC_R_UNEXPECTED;
+
+	result = dns_sigcache_find(cache, key, now, &found);
+	if (expect == ISC_R_NOTFOUND) {
+		ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+		return;
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(found, expect);
+}
+
+/*
+ * Make a DNSKEY for 'example.' with 'secret' as its key data.  An HMAC
+ * algorithm is used so that no crypto library is needed.
+ */
+static dst_key_t *
+dnskey(dns_name_t *name, unsigned char secret) {
+	isc_result_t result;
+	unsigned char data[20];
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r;
+	dst_key_t *key = NULL;
+
+	data[0] = 0x01;			/* flags */
+	data[1] = 0x00;
+	data[2] = 3;			/* protocol */
+	data[3] = DST_ALG_HMACMD5;
+	memset(data + 4, secret, 16);
+	r.base = data;
+	r.length = sizeof(data);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_dnskey,
+			     &r);
+	result = dns_dnssec_keyfromrdata(name, &rdata, mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (key);
+}
+
+/*
+ * Compute the key for 'sig' over the A RRset of 'owner' holding
+ * 'addrs', in that order.
+ */
+static void
+sigkey(const char *owner, const unsigned char *addrs, unsigned int naddrs,
+       dst_key_t *key, unsigned char sig, dns_sigcachekey_t *cachekey)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdatas[4], sigrdata = DNS_RDATA_INIT;
+	unsigned char addrdata[4][4], sigdata[32];
+	isc_region_t r;
+	unsigned int i;
+
+	ATF_REQUIRE(naddrs <= 4);
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), owner, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	for (i = 0; i < naddrs; i++) {
+		memset(addrdata[i], addrs[i], 4);
+		r.base = addrdata[i];
+		r.length = 4;
+		dns_rdata_init(&rdatas[i]);
+		dns_rdata_fromregion(&rdatas[i], dns_rdataclass_in,
+				     dns_rdatatype_a, &r);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdatas[i], link);
+	}
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(sigdata, sig, sizeof(sigdata));
+	r.base = sigdata;
+	r.length = sizeof(sigdata);
+	dns_rdata_fromregion(&sigrdata, dns_rdataclass_in,
+			     dns_rdatatype_rrsig, &r);
+
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      key, &sigrdata, mctx, cachekey);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_boolean_t
+samekey(dns_sigcachekey_t *key1, dns_sigcachekey_t *key2) {
+	return (ISC_TF(memcmp(key1->digest, key2->digest,
+			      sizeof(key1->digest)) == 0));
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr", "results are found until they "
+			  "expire");
+}
+ATF_TC_BODY(find, tc) {
+	isc_result_t result;
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t key1, key2;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_sigcache_create(mctx, 4096, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makekey(1, &key1);
+	makekey(2, &key2);
+	check(cache, &key1, 1000, ISC_R_NOTFOUND);
+	dns_sigcache_add(cache, &key1, ISC_R_SUCCESS, 2000);
+	dns_sigcache_add(cache, &key2, DNS_R_SIGINVALID, 3000);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 2);
+	check(cache, &key1, 1000, ISC_R_SUCCESS);
+	check(cache, &key2, 1000, DNS_R_SIGINVALID);
+
+	/* A second result replaces the first. */
+	dns_sigcache_add(cache, &key2, ISC_R_SUCCESS, 3000);
+	check(cache, &key2, 1000, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 2);
+
+	/* An expired result is removed. */
+	check(cache, &key1, 2000, ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 1);
+	check(cache, &key1, 1000, ISC_R_NOTFOUND);
+	check(cache, &key2, 2999, ISC_R_SUCCESS);
+
+	dns_sigcache_flush(cache);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 0);
+	check(cache, &key2, 1000, ISC_R_NOTFOUND);
+
+	dns_sigcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "the least recently used results "
+			  "are replaced when the cache is full");
+}
+ATF_TC_BODY(evict, tc) {
+	isc_result_t result;
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t key, first;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Too small for even one result still holds one. */
+	result = dns_sigcache_create(mctx, 1, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	makekey(1, &key);
+	dns_sigcache_add(cache, &key, ISC_R_SUCCESS, 2000);
+	check(cache, &key, 1000, ISC_R_SUCCESS);
+	makekey(2, &key);
+	dns_sigcache_add(cache, &key, ISC_R_SUCCESS, 2000);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 1);
+	check(cache, &key, 1000, ISC_R_SUCCESS);
+	dns_sigcache_detach(&cache);
+
+	result = dns_sigcache_create(mctx, 4096, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	makekey(0, &first);
+	for (i = 0; i < 1000; i++) {
+		makekey(i, &key);
+		dns_sigcache_add(cache, &key, ISC_R_SUCCESS, 2000);
+		/* Keep the first result in use. */
+		check(cache, &first, 1000, ISC_R_SUCCESS);
+	}
+	ATF_CHECK(dns_sigcache_count(cache) > 1);
+	ATF_CHECK(dns_sigcache_count(cache) < 1000);
+	makekey(1, &key);
+	check(cache, &key, 1000, ISC_R_NOTFOUND);
+	makekey(999, &key);
+	check(cache, &key, 1000, ISC_R_SUCCESS);
+
+	dns_sigcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(makekey);
+ATF_TC_HEAD(makekey, tc) {
+	atf_tc_set_md_var(tc, "descr", "the key covers the RRset, the "
+			  "RRSIG and the DNSKEY but not the order of the "
+			  "rdata or the case of the owner");
+}
+ATF_TC_BODY(makekey, tc) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dst_key_t *key1, *key2;
+	dns_sigcachekey_t base, other;
+	unsigned char addrs[] = { 1, 2, 3 };
+	unsigned char reordered[] = { 3, 1, 2 };
+	unsigned char changed[] = { 1, 2, 4 };
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	key1 = dnskey(name, 1);
+	key2 = dnskey(name, 2);
+
+	sigkey("www.example.", addrs, 3, key1, 1, &base);
+
+	sigkey("www.example.", addrs, 3, key1, 1, &other);
+	ATF_CHECK(samekey(&base, &other));
+	sigkey("www.example.", reordered, 3, key1, 1, &other);
+	ATF_CHECK(samekey(&base, &other));
+	sigkey("WWW.Example.", addrs, 3, key1, 1, &other);
+	ATF_CHECK(samekey(&base, &other));
+
+	sigkey("www.example.", changed, 3, key1, 1, &other);
+	ATF_CHECK(!samekey(&base, &other));
+	sigkey("www.example.", addrs, 2, key1, 1, &other);
+	ATF_CHECK(!samekey(&base, &other));
+	sigkey("ftp.example.", addrs, 3, key1, 1, &other);
+	ATF_CHECK(!samekey(&base, &other));
+	sigkey("www.example.", addrs, 3, key1, 2, &other);
+	ATF_CHECK(!samekey(&base, &other));
+	sigkey("www.example.", addrs, 3, key2, 1, &other);
+	ATF_CHECK(!samekey(&base, &other));
+
+	dst_key_free(&key1);
+	dst_key_free(&key2);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, evict);
+	ATF_TP_ADD_TC(tp, makekey);
+	return (atf_no_error());
+}
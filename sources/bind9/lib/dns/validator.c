@@ -22,7 +22,9 @@
 #include <isc/base32.h>
 #include <isc/mem.h>
 #include <isc/print.h>
+#include <isc/serial.h>
 #include <isc/sha2.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -43,6 +45,8 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/sigcache.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -94,6 +98,9 @@
 						 * have attempted a verify. */
 #define VALATTR_INSECURITY		0x0010	/*%< Attempting proveunsecure. */
 #define VALATTR_DLVTRIED		0x0020	/*%< Looked for a DLV record. */
+#define VALATTR_VERIFYING		0x0040	/*%< Waiting for a verify. */
+#define VALATTR_VERIFIED		0x0080	/*%< The verify has completed;
+						 * see val->verifyresult. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -128,9 +135,36 @@
 
 #define SHUTDOWN(v)		(((v)->attributes & VALATTR_SHUTDOWN) != 0)
 #define CANCELED(v)		(((v)->attributes & VALATTR_CANCELED) != 0)
+#define VERIFYING(v)		(((v)->attributes & VALATTR_VERIFYING) != 0)
+#define VERIFIED(v)		(((v)->attributes & VALATTR_VERIFIED) != 0)
 
 #define NEGATIVE(r)	(((r)->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
 
+/*%
+ * The longest time a result is used from the view's signature cache.
+ */
+#define SIGCACHE_LIFETIME	3600
+
+/*%
+ * A verification sent to one of the resolver's verification tasks,
+ * and its result on the way back.
+ */
+typedef struct verifyevent {
+	ISC_EVENT_COMMON(struct verifyevent);
+	dns_validator_t *		validator;
+	dns_name_t *			name;
+	dns_rdataset_t *		rdataset;
+	dst_key_t *			key;
+	dns_rdata_t			sigrdata;
+	isc_uint16_t			keyid;
+	isc_boolean_t			cacheable;
+	dns_sigcachekey_t		cachekey;
+	/* Results. */
+	isc_result_t			result;
+	isc_boolean_t			ignore;
+	dns_fixedname_t			wild;
+} verifyevent_t;
+
 static void
 destroy(dns_validator_t *val);
 
@@ -228,7 +262,7 @@ exit_check(dns_validator_t *val) {
 
 	INSIST(val->event == NULL);
 
-	if (val->fetch != NULL || val->subvalidator != NULL)
+	if (val->fetch != NULL || val->subvalidator != NULL || VERIFYING(val))
 		return (ISC_FALSE);
 
 	return (ISC_TRUE);
@@ -1490,36 +1524,73 @@ isselfsigned(dns_validator_t *val) {
 }
 
 /*%
- * Attempt to verify the rdataset using the given key and rdata (RRSIG).
- * The signature was good and from a wildcard record and the QNAME does
- * not match the wildcard we need to look for a NOQNAME proof.
+ * Store 'result', the result of verifying 'rdata' (an RRSIG), in the
+ * view's signature cache under 'cachekey'.  It is kept no longer than
+ * SIGCACHE_LIFETIME, nor beyond the expiry of the signature.
+ */
+static void
+cachesig(dns_view_t *view, dns_sigcachekey_t *cachekey, dns_rdata_t *rdata,
+	 isc_result_t result)
+{
+	dns_rdata_rrsig_t sig;
+	isc_stdtime_t now, expire;
+
+	if (dns_rdata_tostruct(rdata, &sig, NULL) != ISC_R_SUCCESS)
+		return;
+	isc_stdtime_get(&now);
+	expire = now + SIGCACHE_LIFETIME;
+	if (isc_serial_lt(sig.timeexpire, expire))
+		expire = sig.timeexpire;
+	dns_sigcache_add(view->sigcache, cachekey, result, expire);
+}
+
+/*%
+ * Verify 'rdata' (an RRSIG) over 'rdataset' with 'key'.  If the
+ * signature has expired or is not yet valid and the view accepts
+ * expired signatures, it is verified again ignoring time and
+ * '*ignorep' is set.
  *
- * Returns:
- * \li	ISC_R_SUCCESS if the verification succeeds.
- * \li	Others if the verification fails.
+ * This does not use the validator itself, so that it can be run on
+ * a verification task while the validator's own task does other work.
+ * If 'cachekey' is not NULL, results which do not depend on the
+ * current time are stored in the signature cache under it.
  */
 static isc_result_t
-verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
-       isc_uint16_t keyid)
+checksig(dns_view_t *view, dns_name_t *name, dns_rdataset_t *rdataset,
+	 dst_key_t *key, dns_rdata_t *rdata, dns_sigcachekey_t *cachekey,
+	 dns_name_t *wild, isc_boolean_t *ignorep)
 {
 	isc_result_t result;
-	dns_fixedname_t fixed;
 	isc_boolean_t ignore = ISC_FALSE;
-	dns_name_t *wild;
 
-	val->attributes |= VALATTR_TRIEDVERIFY;
-	dns_fixedname_init(&fixed);
-	wild = dns_fixedname_name(&fixed);
  again:
-	result = dns_dnssec_verify3(val->event->name, val->event->rdataset,
-				    key, ignore, val->view->maxbits,
-				    val->view->mctx, rdata, wild);
+	result = dns_dnssec_verify3(name, rdataset, key, ignore,
+				    view->maxbits, view->mctx, rdata, wild);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
-	    val->view->acceptexpired)
+	    view->acceptexpired)
 	{
 		ignore = ISC_TRUE;
 		goto again;
 	}
+	if (view->resstats != NULL)
+		isc_stats_increment(view->resstats,
+				    dns_resstatscounter_valsigverify);
+	if (cachekey != NULL && !ignore &&
+	    (result == ISC_R_SUCCESS || result == DNS_R_SIGINVALID))
+		cachesig(view, cachekey, rdata, result);
+	*ignorep = ignore;
+	return (result);
+}
+
+/*%
+ * Log the result of a verification and handle a signature that was
+ * good and from a wildcard record.  If the QNAME does not match the
+ * wildcard we need to look for a NOQNAME proof.
+ */
+static isc_result_t
+verify_done(dns_validator_t *val, isc_result_t result, isc_boolean_t ignore,
+	    dns_name_t *wild, isc_uint16_t keyid)
+{
 	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
 		validator_log(val, ISC_LOG_INFO,
 			      "accepted expired %sRRSIG (keyid=%u)",
@@ -1553,6 +1624,196 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	return (result);
 }
 
+/*%
+ * A verification has been done on a verification task.  Record the
+ * result and resume validate() where it left off.
+ */
+static void
+verified(isc_task_t *task, isc_event_t *event) {
+	verifyevent_t *vevent;
+	dns_validator_t *val;
+	isc_boolean_t want_destroy;
+	isc_result_t result;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_VALIDATORVERIFIED);
+	vevent = (verifyevent_t *)event;
+	val = vevent->validator;
+
+	validator_log(val, ISC_LOG_DEBUG(3), "in verified");
+	LOCK(&val->lock);
+	INSIST(VERIFYING(val));
+	val->attributes &= ~VALATTR_VERIFYING;
+	if (CANCELED(val)) {
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		val->verifyresult = verify_done(val, vevent->result,
+						vevent->ignore,
+						dns_fixedname_name(&vevent->wild),
+						vevent->keyid);
+		val->attributes |= VALATTR_VERIFIED;
+		result = validate(val, ISC_TRUE);
+		if (result != DNS_R_WAIT)
+			validator_done(val, result);
+	}
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+	isc_event_free(&event);
+	if (want_destroy)
+		destroy(val);
+}
+
+/*%
+ * Do a verification on a verification task and send the result back
+ * to the validator's task.
+ */
+static void
+verify_action(isc_task_t *task, isc_event_t *event) {
+	verifyevent_t *vevent;
+	dns_validator_t *val;
+	isc_boolean_t canceled;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_VALIDATORVERIFY);
+	vevent = (verifyevent_t *)event;
+	val = vevent->validator;
+
+	LOCK(&val->lock);
+	canceled = CANCELED(val);
+	UNLOCK(&val->lock);
+
+	if (canceled)
+		vevent->result = ISC_R_CANCELED;
+	else
+		vevent->result = checksig(val->view, vevent->name,
+					  vevent->rdataset, vevent->key,
+					  &vevent->sigrdata,
+					  vevent->cacheable ?
+					  &vevent->cachekey : NULL,
+					  dns_fixedname_name(&vevent->wild),
+					  &vevent->ignore);
+
+	event->ev_type = DNS_EVENT_VALIDATORVERIFIED;
+	event->ev_action = verified;
+	isc_task_send(val->task, &event);
+}
+
+/*%
+ * Hand the verification of the rdataset with 'key' and 'rdata' (an
+ * RRSIG) to one of the resolver's verification tasks.
+ *
+ * Returns:
+ * \li	DNS_R_WAIT if it was sent; verified() will be called with
+ *	the result.
+ * \li	ISC_R_NOTFOUND if the resolver has no verification tasks.
+ * \li	ISC_R_NOMEMORY
+ */
+static isc_result_t
+send_verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	    isc_uint16_t keyid, dns_sigcachekey_t *cachekey)
+{
+	verifyevent_t *vevent;
+	isc_task_t *task = NULL;
+
+	if (val->view->resolver == NULL)
+		return (ISC_R_NOTFOUND);
+	dns_resolver_getverifytask(val->view->resolver, &task);
+	if (task == NULL)
+		return (ISC_R_NOTFOUND);
+
+	vevent = (verifyevent_t *)
+		isc_event_allocate(val->view->mctx, val,
+				   DNS_EVENT_VALIDATORVERIFY,
+				   verify_action, val, sizeof(verifyevent_t));
+	if (vevent == NULL) {
+		isc_task_detach(&task);
+		return (ISC_R_NOMEMORY);
+	}
+	vevent->validator = val;
+	vevent->name = val->event->name;
+	vevent->rdataset = val->event->rdataset;
+	vevent->key = key;
+	dns_rdata_init(&vevent->sigrdata);
+	dns_rdata_clone(rdata, &vevent->sigrdata);
+	vevent->keyid = keyid;
+	vevent->cacheable = ISC_TF(cachekey != NULL);
+	if (cachekey != NULL)
+		vevent->cachekey = *cachekey;
+	vevent->ignore = ISC_FALSE;
+	vevent->result = ISC_R_FAILURE;
+	dns_fixedname_init(&vevent->wild);
+
+	validator_log(val, ISC_LOG_DEBUG(3),
+		      "sending verify (keyid=%u) to verification task",
+		      keyid);
+	val->attributes |= VALATTR_VERIFYING;
+	isc_task_sendanddetach(&task, ISC_EVENT_PTR(&vevent));
+	return (DNS_R_WAIT);
+}
+
+/*%
+ * Attempt to verify the rdataset using the given key and rdata (RRSIG).
+ * The signature was good and from a wildcard record and the QNAME does
+ * not match the wildcard we need to look for a NOQNAME proof.
+ *
+ * A result already in the view's signature cache is used if there is
+ * one.  Otherwise, if 'offload' is true and the resolver has
+ * verification tasks, the verification is done on one of them and
+ * DNS_R_WAIT is returned; the caller must be able to resume from
+ * verified().
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS if the verification succeeds.
+ * \li	DNS_R_WAIT if the verification has been sent to another task.
+ * \li	Others if the verification fails.
+ */
+static isc_result_t
+verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+       isc_uint16_t keyid, isc_boolean_t offload)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	isc_boolean_t ignore = ISC_FALSE;
+	dns_sigcachekey_t cachekey, *cachekeyp = NULL;
+	isc_stdtime_t now;
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+
+	if (val->view->sigcache != NULL &&
+	    dns_sigcache_makekey(val->event->name, val->event->rdataset,
+				 key, rdata, val->view->mctx,
+				 &cachekey) == ISC_R_SUCCESS)
+	{
+		cachekeyp = &cachekey;
+		isc_stdtime_get(&now);
+		if (dns_sigcache_find(val->view->sigcache, &cachekey, now,
+				      &result) == ISC_R_SUCCESS)
+		{
+			if (val->view->resstats != NULL)
+				isc_stats_increment(val->view->resstats,
+					    dns_resstatscounter_valsigcachehit);
+			validator_log(val, ISC_LOG_DEBUG(3),
+				      "verify rdataset (keyid=%u): %s "
+				      "(cached)", keyid,
+				      isc_result_totext(result));
+			return (result);
+		}
+	}
+
+	if (offload) {
+		result = send_verify(val, key, rdata, keyid, cachekeyp);
+		if (result == DNS_R_WAIT)
+			return (result);
+	}
+
+	dns_fixedname_init(&fixed);
+	result = checksig(val->view, val->event->name, val->event->rdataset,
+			  key, rdata, cachekeyp, dns_fixedname_name(&fixed),
+			  &ignore);
+	return (verify_done(val, result, ignore, dns_fixedname_name(&fixed),
+			    keyid));
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1629,8 +1890,15 @@ validate(dns_validator_t *val, isc_boolean_t resume) {
 		}
 
 		do {
-			result = verify(val, val->key, &rdata,
-					val->siginfo->keyid);
+			if (VERIFIED(val)) {
+				val->attributes &= ~VALATTR_VERIFIED;
+				result = val->verifyresult;
+			} else {
+				result = verify(val, val->key, &rdata,
+						val->siginfo->keyid, ISC_TRUE);
+				if (result == DNS_R_WAIT)
+					return (result);
+			}
 			if (result == ISC_R_SUCCESS)
 				break;
 			if (val->keynode != NULL) {
@@ -1747,7 +2015,7 @@ checkkey(dns_validator_t *val, dns_rdata_t *keyrdata, isc_uint16_t keyid,
 				 */
 				continue;
 		}
-		result = verify(val, dstkey, &rdata, sig.keyid);
+		result = verify(val, dstkey, &rdata, sig.keyid, ISC_FALSE);
 		if (result == ISC_R_SUCCESS)
 			break;
 	}
@@ -2023,7 +2291,7 @@ validatezonekey(dns_validator_t *val) {
 					break;
 				}
 				result = verify(val, dstkey, &sigrdata,
-						sig.keyid);
+						sig.keyid, ISC_FALSE);
 				if (result == ISC_R_SUCCESS) {
 					dns_keytable_detachkeynode(
 								val->keytable,
@@ -3780,6 +4048,7 @@ dns_validator_create(dns_view_t *view, dns_name_t *name, dns_rdatatype_t type,
 	val->depth = 0;
 	val->authcount = 0;
 	val->authfail = 0;
+	val->verifyresult = ISC_R_FAILURE;
 	val->mustbesecure = dns_resolver_getmustbesecure(view->resolver, name);
 	dns_rdataset_init(&val->frdataset);
 	dns_rdataset_init(&val->fsigrdataset);
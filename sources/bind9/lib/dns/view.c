@@ -54,6 +54,8 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
+#include <dns/sigcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/stats.h>
@@ -123,6 +125,8 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	}
 
 	view->acache = NULL;
+	view->respcache = NULL;
+	view->sigcache = NULL;
 	view->cache = NULL;
 	view->cachedb = NULL;
 	view->dlzdatabase = NULL;
@@ -190,6 +194,12 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->provideixfr = ISC_TRUE;
 	view->maxcachettl = 7 * 24 * 3600;
 	view->maxncachettl = 3 * 3600;
+	view->prefetch_trigger = 0;
+	view->prefetch_hits = 0;
+	view->staleanswersok = ISC_FALSE;
+	view->staleanswerttl = 1;
+	view->staleanswerclienttimeout = 0;
+	view->synthfromdnssec = ISC_FALSE;
 	view->dstport = 53;
 	view->preferred_glue = 0;
 	view->flush = ISC_FALSE;
@@ -331,6 +341,10 @@ destroy(dns_view_t *view) {
 		dns_adb_detach(&view->adb);
 	if (view->resolver != NULL)
 		dns_resolver_detach(&view->resolver);
+	if (view->respcache != NULL)
+		dns_respcache_detach(&view->respcache);
+	if (view->sigcache != NULL)
+		dns_sigcache_detach(&view->sigcache);
 #ifdef BIND9
 	if (view->acache != NULL) {
 		if (view->cachedb != NULL)
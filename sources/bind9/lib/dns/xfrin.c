@@ -362,9 +362,16 @@ ixfr_init(dns_xfrin_ctx_t *xfr) {
 	xfr->difflen = 0;
 
 	journalfile = dns_zone_getjournal(xfr->zone);
-	if (journalfile != NULL)
+	if (journalfile != NULL) {
 		CHECK(dns_journal_open(xfr->mctx, journalfile,
 				       DNS_JOURNAL_CREATE, &xfr->ixfr.journal));
+		/*
+		 * An IXFR response may carry many deltas; sync the
+		 * journal once when the transfer completes rather
+		 * than once per delta.
+		 */
+		dns_journal_setgroupcommit(xfr->ixfr.journal, ISC_TRUE);
+	}
 
 	result = ISC_R_SUCCESS;
  failure:
@@ -1348,10 +1355,12 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		/* FALLTHROUGH */
 	case XFRST_IXFR_END:
 		/*
-		 * Close the journal.
+		 * Sync and close the journal.
 		 */
-		if (xfr->ixfr.journal != NULL)
+		if (xfr->ixfr.journal != NULL) {
+			CHECK(dns_journal_sync(xfr->ixfr.journal));
 			dns_journal_destroy(&xfr->ixfr.journal);
+		}
 
 		/*
 		 * Inform the caller we succeeded.
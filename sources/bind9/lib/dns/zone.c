@@ -150,6 +150,7 @@ typedef struct dns_nsec3chain dns_nsec3chain_t;
 typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
+typedef struct signbatch signbatch_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -226,6 +227,10 @@ struct dns_zone {
 	isc_time_t		refreshtime;
 	isc_time_t		dumptime;
 	isc_time_t		loadtime;
+	unsigned int		loadthreads;
+	unsigned int		dumpthreads;
+	isc_uint64_t		loadrecords;
+	isc_uint64_t		loadusecs;
 	isc_time_t		notifytime;
 	isc_time_t		resigntime;
 	isc_time_t		keywarntime;
@@ -342,6 +347,9 @@ struct dns_zone {
 	 */
 	isc_uint32_t		signatures;
 	isc_uint32_t		nodes;
+	unsigned int		signingthreads;
+	signbatch_t		*signbatch;	/*%< Being signed. */
+	signbatch_t		*signdone;	/*%< Signed, to be added. */
 	dns_rdatatype_t		privatetype;
 
 	/*%
@@ -480,6 +488,7 @@ struct dns_zonemgr {
 	isc_socketmgr_t *	socketmgr;
 	isc_taskpool_t *	zonetasks;
 	isc_taskpool_t *	loadtasks;
+	isc_taskpool_t *	signtasks;	/* Locked by rwlock */
 	isc_task_t *		task;
 	isc_pool_t *		mctxpool;
 	isc_ratelimiter_t *	notifyrl;
@@ -557,6 +566,7 @@ struct dns_load {
 	dns_zone_t		*zone;
 	dns_db_t		*db;
 	isc_time_t		loadtime;
+	isc_time_t		start;
 	dns_rdatacallbacks_t	callbacks;
 };
 
@@ -882,6 +892,10 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	isc_time_settoepoch(&zone->refreshtime);
 	isc_time_settoepoch(&zone->dumptime);
 	isc_time_settoepoch(&zone->loadtime);
+	zone->loadthreads = 1;
+	zone->dumpthreads = 1;
+	zone->loadrecords = 0;
+	zone->loadusecs = 0;
 	zone->notifytime = now;
 	isc_time_settoepoch(&zone->resigntime);
 	isc_time_settoepoch(&zone->keywarntime);
@@ -960,6 +974,9 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	ISC_LIST_INIT(zone->nsec3chain);
 	zone->signatures = 10;
 	zone->nodes = 100;
+	zone->signingthreads = 1;
+	zone->signbatch = NULL;
+	zone->signdone = NULL;
 	zone->privatetype = (dns_rdatatype_t)0xffffU;
 	zone->added = ISC_FALSE;
 	zone->is_rpz = ISC_FALSE;
@@ -1022,6 +1039,8 @@ zone_free(dns_zone_t *zone) {
 	INSIST(zone->readio == NULL);
 	INSIST(zone->statelist == NULL);
 	INSIST(zone->writeio == NULL);
+	INSIST(zone->signbatch == NULL);
+	INSIST(zone->signdone == NULL);
 
 	if (zone->task != NULL)
 		isc_task_detach(&zone->task);
@@ -1933,14 +1952,16 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 
 	options = get_master_options(load->zone);
 
-	result = dns_master_loadfileinc3(load->zone->masterfile,
+	TIME_NOW(&load->start);
+	result = dns_master_loadfileinc4(load->zone->masterfile,
 					 dns_db_origin(load->db),
 					 dns_db_origin(load->db),
 					 load->zone->rdclass, options, 0,
 					 &load->callbacks, task,
 					 zone_loaddone, load,
 					 &load->zone->lctx, load->zone->mctx,
-					 load->zone->masterformat);
+					 load->zone->masterformat,
+					 load->zone->loadthreads);
 	if (result != ISC_R_SUCCESS && result != DNS_R_CONTINUE &&
 	    result != DNS_R_SEENINCLUDE)
 		goto fail;
@@ -1998,10 +2019,11 @@ zone_gotwritehandle(isc_task_t *task, isc_event_t *event) {
 			output_style = &dns_master_style_keyzone;
 		else
 			output_style = &dns_master_style_default;
-		result = dns_master_dumpinc3(zone->mctx, zone->db, version,
+		result = dns_master_dumpinc4(zone->mctx, zone->db, version,
 					     output_style, zone->masterfile,
-					     zone->task, dump_done, zone,						     &zone->dctx, zone->masterformat,
-					     &rawdata);
+					     zone->task, dump_done, zone,
+					     &zone->dctx, zone->masterformat,
+					     &rawdata, zone->dumpthreads);
 		dns_db_closeversion(zone->db, &version, ISC_FALSE);
 	} else
 		result = ISC_R_CANCELED;
@@ -2063,6 +2085,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		load->zone = NULL;
 		load->db = NULL;
 		load->loadtime = loadtime;
+		isc_time_settoepoch(&load->start);
 		load->magic = LOAD_MAGIC;
 
 		isc_mem_attach(zone->mctx, &load->mctx);
@@ -2071,8 +2094,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		dns_rdatacallbacks_init(&load->callbacks);
 		load->callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &load->callbacks.zone);
-		result = dns_db_beginload(db, &load->callbacks.add,
-					  &load->callbacks.add_private);
+		result = dns_db_beginload2(db, &load->callbacks);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 		result = zonemgr_getio(zone->zmgr, ISC_TRUE, zone->loadtask,
@@ -2090,21 +2112,26 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			result = DNS_R_CONTINUE;
 	} else {
 		dns_rdatacallbacks_t callbacks;
+		isc_time_t start, end;
 
 		dns_rdatacallbacks_init(&callbacks);
 		callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &callbacks.zone);
-		result = dns_db_beginload(db, &callbacks.add,
-					  &callbacks.add_private);
+		result = dns_db_beginload2(db, &callbacks);
 		if (result != ISC_R_SUCCESS) {
 			zone_idetach(&callbacks.zone);
 			return (result);
 		}
-		result = dns_master_loadfile3(zone->masterfile,
+		TIME_NOW(&start);
+		result = dns_master_loadfile4(zone->masterfile,
 					      &zone->origin, &zone->origin,
 					      zone->rdclass, options, 0,
 					      &callbacks, zone->mctx,
-					      zone->masterformat);
+					      zone->masterformat,
+					      zone->loadthreads);
+		TIME_NOW(&end);
+		zone->loadrecords = callbacks.records;
+		zone->loadusecs = isc_time_microdiff(&end, &start);
 		tresult = dns_db_endload(db, &callbacks.add_private);
 		if (result == ISC_R_SUCCESS)
 			result = tresult;
@@ -4315,9 +4342,23 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		zone_settimer(zone, &now);
 	}
 
-	if (! dns_db_ispersistent(db))
+	if (! dns_db_ispersistent(db) && zone->loadrecords != 0) {
+		isc_uint64_t usecs = ISC_MAX(zone->loadusecs, 1);
+
+		dns_zone_log(zone, ISC_LOG_INFO, "loaded serial %u%s: "
+			     "%" ISC_PRINT_QUADFORMAT "u records in "
+			     "%u.%03u seconds (%" ISC_PRINT_QUADFORMAT
+			     "u records/s)", serial,
+			     dns_db_issecure(db) ? " (DNSSEC signed)" : "",
+			     zone->loadrecords,
+			     (unsigned int)(zone->loadusecs / 1000000),
+			     (unsigned int)(zone->loadusecs / 1000 % 1000),
+			     zone->loadrecords * 1000000 / usecs);
+	} else if (! dns_db_ispersistent(db))
 		dns_zone_log(zone, ISC_LOG_INFO, "loaded serial %u%s", serial,
 			     dns_db_issecure(db) ? " (DNSSEC signed)" : "");
+	zone->loadrecords = 0;
+	zone->loadusecs = 0;
 
 	zone->loadtime = loadtime;
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
@@ -5983,21 +6024,412 @@ add_nsec(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
 	return (result);
 }
 
+/*%
+ * A signature zone_sign() needs.  While a quantum is being planned the
+ * RRset is copied, so that the signature can still be made on a signing
+ * task once the version it was found in has been thrown away.
+ */
+typedef struct signreq signreq_t;
+
+struct signreq {
+	signbatch_t		*batch;
+	size_t			size;		/*%< Of this and the copy. */
+	dns_name_t		name;
+	dns_rdatalist_t		rdatalist;
+	dns_rdataset_t		rdataset;	/*%< Of 'rdatalist'. */
+	dst_key_t		*key;
+	isc_result_t		result;
+	dns_rdata_t		rdata;
+	unsigned char		data[1024];
+	ISC_LINK(signreq_t)	link;
+};
+
+/*%
+ * The signatures of one zone_sign() quantum.
+ *
+ * When the zone may use several signing tasks, the quantum is first
+ * planned: its nodes are visited in a version that is then rolled back,
+ * and the signatures they need are collected.  Each is made by its own
+ * event on one of the zone manager's signing tasks, and when the last
+ * is done zone_signed() runs zone_sign() again on the zone task.  That
+ * pass makes the changes for real, taking the signatures made for it
+ * where the RRset is unchanged and making any others itself, so the
+ * changes are the same as if the quantum had been signed in one go.
+ * No version is held open while the signing tasks are busy.
+ */
+struct signbatch {
+	isc_mem_t		*mctx;
+	dns_zone_t		*zone;		/*%< While signing tasks work. */
+	isc_boolean_t		planning;
+	isc_stdtime_t		inception;
+	isc_stdtime_t		expire;
+	ISC_LIST(signreq_t)	reqs;
+	unsigned int		count;
+	isc_event_t		*done;		/*%< Sent to the zone task. */
+	isc_time_t		sent;
+	isc_uint64_t		usec;		/*%< Spent signing. */
+	isc_mutex_t		lock;
+	/* Locked by lock. */
+	unsigned int		pending;
+	unsigned int		made;
+};
+
+static void
+zone_signed(isc_task_t *task, isc_event_t *event);
+
+static isc_result_t
+signbatch_create(dns_zone_t *zone, signbatch_t **batchp) {
+	signbatch_t *batch;
+	isc_result_t result;
+
+	REQUIRE(batchp != NULL && *batchp == NULL);
+
+	batch = isc_mem_get(zone->mctx, sizeof(*batch));
+	if (batch == NULL)
+		return (ISC_R_NOMEMORY);
+	result = isc_mutex_init(&batch->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
+		return (result);
+	}
+	batch->done = isc_event_allocate(zone->mctx, zone,
+					 DNS_EVENT_ZONESIGNED, zone_signed,
+					 zone, sizeof(isc_event_t));
+	if (batch->done == NULL) {
+		DESTROYLOCK(&batch->lock);
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
+		return (ISC_R_NOMEMORY);
+	}
+	batch->mctx = NULL;
+	isc_mem_attach(zone->mctx, &batch->mctx);
+	batch->zone = NULL;
+	batch->planning = ISC_FALSE;
+	batch->inception = 0;
+	batch->expire = 0;
+	ISC_LIST_INIT(batch->reqs);
+	batch->count = 0;
+	batch->pending = 0;
+	batch->made = 0;
+	batch->usec = 0;
+	isc_time_settoepoch(&batch->sent);
+	*batchp = batch;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+signbatch_clear(signbatch_t *batch) {
+	signreq_t *req;
+
+	while ((req = ISC_LIST_HEAD(batch->reqs)) != NULL) {
+		ISC_LIST_UNLINK(batch->reqs, req, link);
+		dns_rdataset_disassociate(&req->rdataset);
+		dns_name_free(&req->name, batch->mctx);
+		dst_key_free(&req->key);
+		isc_mem_put(batch->mctx, req, req->size);
+	}
+	batch->count = 0;
+}
+
+static void
+signbatch_destroy(signbatch_t **batchp) {
+	signbatch_t *batch = *batchp;
+
+	*batchp = NULL;
+	INSIST(batch->zone == NULL);
+	signbatch_clear(batch);
+	if (batch->done != NULL)
+		isc_event_free(&batch->done);
+	DESTROYLOCK(&batch->lock);
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
+/*
+ * Does 'req' hold the signature of 'rdataset' at 'name' with 'key'?
+ */
+static isc_boolean_t
+signreq_match(signreq_t *req, dns_name_t *name, dns_rdataset_t *rdataset,
+	      dst_key_t *key)
+{
+	dns_rdata_t rdata1 = DNS_RDATA_INIT, rdata2 = DNS_RDATA_INIT;
+	isc_result_t result1, result2;
+
+	if (req->rdatalist.type != rdataset->type ||
+	    req->rdatalist.ttl != rdataset->ttl ||
+	    !dns_name_equal(&req->name, name) ||
+	    dst_key_alg(req->key) != dst_key_alg(key) ||
+	    dst_key_id(req->key) != dst_key_id(key) ||
+	    !dst_key_compare(req->key, key))
+		return (ISC_FALSE);
+
+	for (result1 = dns_rdataset_first(&req->rdataset),
+	     result2 = dns_rdataset_first(rdataset);
+	     result1 == ISC_R_SUCCESS && result2 == ISC_R_SUCCESS;
+	     result1 = dns_rdataset_next(&req->rdataset),
+	     result2 = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(&req->rdataset, &rdata1);
+		dns_rdataset_current(rdataset, &rdata2);
+		if (dns_rdata_compare(&rdata1, &rdata2) != 0)
+			return (ISC_FALSE);
+		dns_rdata_reset(&rdata1);
+		dns_rdata_reset(&rdata2);
+	}
+	return (ISC_TF(result1 == ISC_R_NOMORE && result2 == ISC_R_NOMORE));
+}
+
+/*
+ * Ask for 'rdataset' at 'name' to be signed with 'key' by a signing
+ * task.  Asking twice for the same signature, as happens when a node
+ * is visited for two signing keys of one algorithm, returns
+ * ISC_R_EXISTS.
+ */
+static isc_result_t
+signbatch_add(signbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	      dst_key_t *key)
+{
+	signreq_t *req;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_t *rdatas;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned char *p;
+	unsigned int i, count = 0;
+	size_t size, length = 0;
+
+	for (req = ISC_LIST_HEAD(batch->reqs);
+	     req != NULL;
+	     req = ISC_LIST_NEXT(req, link))
+		if (req->rdatalist.type == rdataset->type &&
+		    req->key == key && dns_name_equal(&req->name, name))
+			return (ISC_R_EXISTS);
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdataset_current(rdataset, &rdata);
+		count++;
+		length += rdata.length;
+		dns_rdata_reset(&rdata);
+	}
+	if (result != ISC_R_NOMORE)
+		return (result);
+
+	size = sizeof(*req) + count * sizeof(dns_rdata_t) + length;
+	req = isc_mem_get(batch->mctx, size);
+	if (req == NULL)
+		return (ISC_R_NOMEMORY);
+	req->size = size;
+	dns_name_init(&req->name, NULL);
+	result = dns_name_dup(name, batch->mctx, &req->name);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(batch->mctx, req, size);
+		return (result);
+	}
+
+	/*
+	 * Copy the RRset, in order, to the end of the request.
+	 */
+	dns_rdatalist_init(&req->rdatalist);
+	req->rdatalist.rdclass = rdataset->rdclass;
+	req->rdatalist.type = rdataset->type;
+	req->rdatalist.covers = rdataset->covers;
+	req->rdatalist.ttl = rdataset->ttl;
+	rdatas = (dns_rdata_t *)(req + 1);
+	p = (unsigned char *)(rdatas + count);
+	for (i = 0, result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     i++, result = dns_rdataset_next(rdataset)) {
+		dns_rdataset_current(rdataset, &rdata);
+		memmove(p, rdata.data, rdata.length);
+		r.base = p;
+		r.length = rdata.length;
+		dns_rdata_init(&rdatas[i]);
+		dns_rdata_fromregion(&rdatas[i], rdata.rdclass, rdata.type,
+				     &r);
+		ISC_LIST_APPEND(req->rdatalist.rdata, &rdatas[i], link);
+		p += rdata.length;
+		dns_rdata_reset(&rdata);
+	}
+	dns_rdataset_init(&req->rdataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(&req->rdatalist,
+					       &req->rdataset)
+		      == ISC_R_SUCCESS);
+
+	req->batch = batch;
+	req->key = NULL;
+	dst_key_attach(key, &req->key);
+	req->result = ISC_R_UNEXPECTED;
+	dns_rdata_init(&req->rdata);
+	ISC_LINK_INIT(req, link);
+	ISC_LIST_APPEND(batch->reqs, req, link);
+	batch->count++;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Sign 'rdataset' at 'name' with 'key' and add the signature to
+ * 'version', using a signature made by a signing task if there is
+ * one for the same RRset.  When planning, only ask for the signature.
+ */
+static isc_result_t
+signbatch_sign(signbatch_t *batch, dns_db_t *db, dns_dbversion_t *version,
+	       dns_diff_t *diff, dns_name_t *name, dns_rdataset_t *rdataset,
+	       dst_key_t *key)
+{
+	signreq_t *req;
+	dns_rdata_t sig_rdata = DNS_RDATA_INIT;
+	isc_buffer_t buffer;
+	isc_time_t start, end;
+	isc_result_t result;
+	unsigned char data[1024]; /* XXX */
+
+	if (batch->planning)
+		return (signbatch_add(batch, name, rdataset, key));
+
+	for (req = ISC_LIST_HEAD(batch->reqs);
+	     req != NULL;
+	     req = ISC_LIST_NEXT(req, link))
+		if (req->result == ISC_R_SUCCESS &&
+		    signreq_match(req, name, rdataset, key))
+			/* XXX inefficient - will cause dataset merging */
+			return (update_one_rr(db, version, diff,
+					      DNS_DIFFOP_ADDRESIGN, name,
+					      rdataset->ttl, &req->rdata));
+
+	TIME_NOW(&start);
+	isc_buffer_init(&buffer, data, sizeof(data));
+	result = dns_dnssec_sign(name, rdataset, key, &batch->inception,
+				 &batch->expire, batch->mctx, &buffer,
+				 &sig_rdata);
+	TIME_NOW(&end);
+	batch->usec += isc_time_microdiff(&end, &start);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	batch->made++;
+	/* XXX inefficient - will cause dataset merging */
+	return (update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
+			      name, rdataset->ttl, &sig_rdata));
+}
+
+/*
+ * Make one signature on a signing task.  The last one made sends the
+ * batch back to the zone task.
+ */
+static void
+signreq_action(isc_task_t *task, isc_event_t *event) {
+	signreq_t *req = event->ev_arg;
+	signbatch_t *batch = req->batch;
+	isc_buffer_t buffer;
+	isc_boolean_t last;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_ZONESIGN);
+	isc_event_free(&event);
+
+	isc_buffer_init(&buffer, req->data, sizeof(req->data));
+	req->result = dns_dnssec_sign(&req->name, &req->rdataset, req->key,
+				      &batch->inception, &batch->expire,
+				      batch->mctx, &buffer, &req->rdata);
+
+	LOCK(&batch->lock);
+	if (req->result == ISC_R_SUCCESS)
+		batch->made++;
+	INSIST(batch->pending > 0);
+	last = ISC_TF(--batch->pending == 0);
+	UNLOCK(&batch->lock);
+
+	if (last)
+		isc_task_send(batch->zone->task, &batch->done);
+}
+
+/*
+ * Send the signatures of a planned quantum to up to 'zone->signingthreads'
+ * of the zone manager's signing tasks, one event each.  Quanta with
+ * fewer than two signatures are not worth sending.
+ */
+static isc_result_t
+signbatch_send(dns_zone_t *zone, signbatch_t *batch) {
+	isc_task_t *tasks[DNS_ZONE_MAXSIGNINGTHREADS];
+	isc_eventlist_t events;
+	isc_event_t *event;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_taskpool_t *pool = NULL;
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	signreq_t *req;
+	unsigned int i, ntasks;
+
+	if (batch->count < 2 || zmgr == NULL)
+		return (ISC_R_NOMORE);
+
+	ISC_LIST_INIT(events);
+	for (req = ISC_LIST_HEAD(batch->reqs);
+	     req != NULL;
+	     req = ISC_LIST_NEXT(req, link))
+	{
+		event = isc_event_allocate(zone->mctx, zone,
+					   DNS_EVENT_ZONESIGN, signreq_action,
+					   req, sizeof(isc_event_t));
+		if (event == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		ISC_LIST_APPEND(events, event, ev_link);
+	}
+
+	/*
+	 * The pool grows to the largest number of tasks a zone asks for.
+	 */
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks == NULL)
+		result = ISC_R_SHUTTINGDOWN;
+	else {
+		result = isc_taskpool_expand(&zmgr->signtasks,
+					     zone->signingthreads, &pool);
+		if (result == ISC_R_SUCCESS)
+			zmgr->signtasks = pool;
+	}
+	ntasks = ISC_MIN(zone->signingthreads, batch->count);
+	if (result == ISC_R_SUCCESS)
+		for (i = 0; i < ntasks; i++) {
+			tasks[i] = NULL;
+			isc_taskpool_gettask(zmgr->signtasks, &tasks[i]);
+		}
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	LOCK_ZONE(zone);
+	zone_iattach(zone, &batch->zone);
+	UNLOCK_ZONE(zone);
+	batch->pending = batch->count;
+	TIME_NOW(&batch->sent);
+	i = 0;
+	while ((event = ISC_LIST_HEAD(events)) != NULL) {
+		ISC_LIST_UNLINK(events, event, ev_link);
+		isc_task_send(tasks[i++ % ntasks], &event);
+	}
+	for (i = 0; i < ntasks; i++)
+		isc_task_detach(&tasks[i]);
+
+ cleanup:
+	while ((event = ISC_LIST_HEAD(events)) != NULL) {
+		ISC_LIST_UNLINK(events, event, ev_link);
+		isc_event_free(&event);
+	}
+	return (result);
+}
+
 static isc_result_t
 sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	    dns_dbversion_t *version, isc_boolean_t build_nsec3,
 	    isc_boolean_t build_nsec, dst_key_t *key,
-	    isc_stdtime_t inception, isc_stdtime_t expire,
 	    unsigned int minimum, isc_boolean_t is_ksk,
 	    isc_boolean_t keyset_kskonly, isc_boolean_t *delegation,
-	    dns_diff_t *diff, isc_int32_t *signatures, isc_mem_t *mctx)
+	    dns_diff_t *diff, isc_int32_t *signatures, signbatch_t *batch)
 {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	isc_buffer_t buffer;
-	unsigned char data[1024];
 	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
 		      seen_nsec3, seen_ds;
 	isc_boolean_t bottom;
@@ -6010,7 +6442,6 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	}
 
 	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
 	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
 	seen_nsec3 = seen_ds = ISC_FALSE;
 	for (result = dns_rdatasetiter_first(iterator);
@@ -6081,15 +6512,11 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 			goto next_rdataset;
 		if (signed_with_key(db, node, version, rdataset.type, key))
 			goto next_rdataset;
-		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
-				      &expire, mctx, &buffer, &rdata));
-		/* Update the database and journal with the RRSIG. */
-		/* XXX inefficient - will cause dataset merging */
-		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
-				    name, rdataset.ttl, &rdata));
-		dns_rdata_reset(&rdata);
+		result = signbatch_sign(batch, db, version, diff, name,
+					&rdataset, key);
+		if (result == ISC_R_EXISTS)
+			goto next_rdataset;
+		CHECK(result);
 		(*signatures)--;
  next_rdataset:
 		dns_rdataset_disassociate(&rdataset);
@@ -7441,13 +7868,14 @@ del_sig(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
 }
 
 /*
- * Incrementally sign the zone using the keys requested.
+ * Sign one quantum of the zone using the keys requested, or when
+ * 'batch' is planning only find the signatures the quantum needs.
  * Builds the NSEC chain if required.
  */
-static void
-zone_sign(dns_zone_t *zone) {
-	const char *me = "zone_sign";
+static isc_result_t
+zone_signquantum(dns_zone_t *zone, signbatch_t *batch) {
 	dns_db_t *db = NULL;
+	dns_dbiterator_t *dbiterator = NULL;
 	dns_dbnode_t *node = NULL;
 	dns_dbversion_t *version = NULL;
 	dns_diff_t _sig_diff;
@@ -7474,8 +7902,6 @@ zone_sign(dns_zone_t *zone) {
 	unsigned int nkeys = 0;
 	isc_uint32_t nodes;
 
-	ENTER;
-
 	dns_rdataset_init(&rdataset);
 	dns_fixedname_init(&fixed);
 	name = dns_fixedname_name(&fixed);
@@ -7531,6 +7957,8 @@ zone_sign(dns_zone_t *zone) {
 	 */
 	isc_random_get(&jitter);
 	expire = soaexpire - jitter % 3600;
+	batch->inception = inception;
+	batch->expire = expire;
 
 	/*
 	 * We keep pulling nodes off each iterator in turn until
@@ -7563,6 +7991,11 @@ zone_sign(dns_zone_t *zone) {
 			 * created new signings as part of the reload
 			 * process so we can destroy this one.
 			 */
+			if (batch->planning) {
+				ZONEDB_UNLOCK(&zone->dblock,
+					      isc_rwlocktype_read);
+				goto next_signing;
+			}
 			ISC_LIST_UNLINK(zone->signing, signing, link);
 			ISC_LIST_APPEND(cleanup, signing, link);
 			ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
@@ -7573,6 +8006,20 @@ zone_sign(dns_zone_t *zone) {
 		if (signing->db != db)
 			goto next_signing;
 
+		/*
+		 * Planning must leave the signing where it is, so walk
+		 * a copy of its iterator.
+		 */
+		if (batch->planning) {
+			dns_dbiterator_current(signing->dbiterator,
+					       &node, name);
+			dns_db_detachnode(db, &node);
+			dns_dbiterator_pause(signing->dbiterator);
+			CHECK(dns_db_createiterator(db, 0, &dbiterator));
+			CHECK(dns_dbiterator_seek(dbiterator, name));
+		} else
+			dbiterator = signing->dbiterator;
+
 		delegation = ISC_FALSE;
 
 		if (first && signing->delete) {
@@ -7596,10 +8043,10 @@ zone_sign(dns_zone_t *zone) {
 			nkeys = j;
 		}
 
-		dns_dbiterator_current(signing->dbiterator, &node, name);
+		dns_dbiterator_current(dbiterator, &node, name);
 
 		if (signing->delete) {
-			dns_dbiterator_pause(signing->dbiterator);
+			dns_dbiterator_pause(dbiterator);
 			CHECK(del_sig(db, version, name, node, nkeys,
 				      signing->algorithm, signing->keyid,
 				      zonediff.diff));
@@ -7634,7 +8081,7 @@ zone_sign(dns_zone_t *zone) {
 		/*
 		 * Process one node.
 		 */
-		dns_dbiterator_pause(signing->dbiterator);
+		dns_dbiterator_pause(dbiterator);
 		for (i = 0; i < nkeys; i++) {
 			isc_boolean_t both = ISC_FALSE;
 
@@ -7694,11 +8141,11 @@ zone_sign(dns_zone_t *zone) {
 				is_ksk = ISC_FALSE;
 
 			CHECK(sign_a_node(db, name, node, version, build_nsec3,
-					  build_nsec, zone_keys[i], inception,
-					  expire, zone->minimum, is_ksk,
+					  build_nsec, zone_keys[i],
+					  zone->minimum, is_ksk,
 					  ISC_TF(both && keyset_kskonly),
 					  &delegation, zonediff.diff,
-					  &signatures, zone->mctx));
+					  &signatures, batch));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -7714,11 +8161,13 @@ zone_sign(dns_zone_t *zone) {
 		first = ISC_FALSE;
 		dns_db_detachnode(db, &node);
 		do {
-			result = dns_dbiterator_next(signing->dbiterator);
+			result = dns_dbiterator_next(dbiterator);
+			if (result == ISC_R_NOMORE && batch->planning)
+				goto next_signing;
 			if (result == ISC_R_NOMORE) {
 				ISC_LIST_UNLINK(zone->signing, signing, link);
 				ISC_LIST_APPEND(cleanup, signing, link);
-				dns_dbiterator_pause(signing->dbiterator);
+				dns_dbiterator_pause(dbiterator);
 				if (nkeys != 0 && build_nsec) {
 					/*
 					 * We have finished regenerating the
@@ -7760,7 +8209,7 @@ zone_sign(dns_zone_t *zone) {
 					     dns_result_totext(result));
 				goto failure;
 			} else if (delegation) {
-				dns_dbiterator_current(signing->dbiterator,
+				dns_dbiterator_current(dbiterator,
 						       &node, nextname);
 				dns_db_detachnode(db, &node);
 				if (!dns_name_issubdomain(nextname, name))
@@ -7771,11 +8220,23 @@ zone_sign(dns_zone_t *zone) {
 		continue;
 
  next_signing:
+		if (batch->planning && dbiterator != NULL)
+			dns_dbiterator_destroy(&dbiterator);
+		dbiterator = NULL;
 		dns_dbiterator_pause(signing->dbiterator);
 		signing = nextsigning;
 		first = ISC_TRUE;
 	}
 
+	/*
+	 * Planning is done once the signatures are known; throw the
+	 * changes away.
+	 */
+	if (batch->planning) {
+		result = ISC_R_SUCCESS;
+		goto failure;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = update_sigs(&post_diff, db, version, zone_keys,
 				     nkeys, zone, inception, expire, now,
@@ -7895,6 +8356,9 @@ zone_sign(dns_zone_t *zone) {
 	     signing = ISC_LIST_NEXT(signing, link))
 		dns_dbiterator_pause(signing->dbiterator);
 
+	if (batch->planning && dbiterator != NULL)
+		dns_dbiterator_destroy(&dbiterator);
+
 	dns_diff_clear(&_sig_diff);
 
 	for (i = 0; i < nkeys; i++)
@@ -7909,6 +8373,72 @@ zone_sign(dns_zone_t *zone) {
 	} else if (db != NULL)
 		dns_db_detach(&db);
 
+	INSIST(version == NULL);
+	return (result);
+}
+
+/*
+ * Incrementally sign the zone using the keys requested.
+ *
+ * With more than one signing task, each quantum is signed in two
+ * steps: the signatures it needs are sent to the signing tasks, and
+ * zone_signed() calls us again to add them once they have been made.
+ */
+static void
+zone_sign(dns_zone_t *zone) {
+	const char *me = "zone_sign";
+	signbatch_t *batch;
+	isc_result_t result;
+
+	ENTER;
+
+	/*
+	 * zone_signed() will call us when the signatures are made.
+	 */
+	if (zone->signbatch != NULL) {
+		isc_time_settoepoch(&zone->signingtime);
+		return;
+	}
+
+	batch = zone->signdone;
+	zone->signdone = NULL;
+	if (batch == NULL && zone->signingthreads > 1 &&
+	    zone->zmgr != NULL && !zone->update_disabled &&
+	    signbatch_create(zone, &batch) == ISC_R_SUCCESS)
+	{
+		batch->planning = ISC_TRUE;
+		result = zone_signquantum(zone, batch);
+		if (result == ISC_R_SUCCESS)
+			result = signbatch_send(zone, batch);
+		if (result == ISC_R_SUCCESS) {
+			zone->signbatch = batch;
+			isc_time_settoepoch(&zone->signingtime);
+			return;
+		}
+		/*
+		 * Sign it here instead.
+		 */
+		signbatch_clear(batch);
+		batch->planning = ISC_FALSE;
+	}
+
+	if (batch == NULL)
+		result = signbatch_create(zone, &batch);
+	else
+		result = ISC_R_SUCCESS;
+	if (result == ISC_R_SUCCESS) {
+		result = zone_signquantum(zone, batch);
+		if (zone->stats != NULL) {
+			isc_stats_add(zone->stats,
+				      dns_zonestatscounter_sigsgenerated,
+				      batch->made);
+			isc_stats_add(zone->stats,
+				      dns_zonestatscounter_signingmsec,
+				      (isc_uint32_t)(batch->usec / 1000));
+		}
+		signbatch_destroy(&batch);
+	}
+
 	if (ISC_LIST_HEAD(zone->signing) != NULL) {
 		isc_interval_t interval;
 		if (zone->update_disabled || result != ISC_R_SUCCESS)
@@ -7918,8 +8448,46 @@ zone_sign(dns_zone_t *zone) {
 		isc_time_nowplusinterval(&zone->signingtime, &interval);
 	} else
 		isc_time_settoepoch(&zone->signingtime);
+}
 
-	INSIST(version == NULL);
+/*
+ * The signing tasks have made the signatures of a quantum: add them.
+ */
+static void
+zone_signed(isc_task_t *task, isc_event_t *event) {
+	const char *me = "zone_signed";
+	dns_zone_t *zone = event->ev_arg;
+	signbatch_t *batch;
+	isc_time_t now;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_ZONESIGNED);
+	INSIST(DNS_ZONE_VALID(zone));
+	isc_event_free(&event);
+
+	ENTER;
+
+	batch = zone->signbatch;
+	zone->signbatch = NULL;
+	INSIST(batch != NULL && batch->zone == zone);
+	/*
+	 * 'zone' now holds the reference the batch took.
+	 */
+	batch->zone = NULL;
+	TIME_NOW(&now);
+	batch->usec = isc_time_microdiff(&now, &batch->sent);
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING))
+		signbatch_destroy(&batch);
+	else {
+		zone->signdone = batch;
+		zone_sign(zone);
+		INSIST(zone->signdone == NULL);
+		LOCK_ZONE(zone);
+		zone_settimer(zone, &now);
+		UNLOCK_ZONE(zone);
+	}
+	dns_zone_idetach(&zone);
 }
 
 static isc_result_t
@@ -9404,9 +9972,10 @@ zone_dump(dns_zone_t *zone, isc_boolean_t compact) {
 			output_style = &dns_master_style_keyzone;
 		else
 			output_style = &dns_master_style_default;
-		result = dns_master_dump3(zone->mctx, db, version,
+		result = dns_master_dump4(zone->mctx, db, version,
 					  output_style, masterfile,
-					  masterformat, &rawdata);
+					  masterformat, &rawdata,
+					  zone->dumpthreads);
 		dns_db_closeversion(db, &version, ISC_FALSE);
 	}
  fail:
@@ -12578,6 +13147,53 @@ message_count(dns_message_t *msg, dns_section_t section, dns_rdatatype_t type)
 	return (count);
 }
 
+void
+dns_zone_setloadthreads(dns_zone_t *zone, unsigned int threads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(threads > 0);
+
+	zone->loadthreads = threads;
+}
+
+unsigned int
+dns_zone_getloadthreads(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->loadthreads);
+}
+
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, unsigned int threads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(threads > 0);
+
+	if (threads > DNS_ZONE_MAXSIGNINGTHREADS)
+		threads = DNS_ZONE_MAXSIGNINGTHREADS;
+	zone->signingthreads = threads;
+}
+
+unsigned int
+dns_zone_getsigningthreads(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->signingthreads);
+}
+
+void
+dns_zone_setdumpthreads(dns_zone_t *zone, unsigned int threads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(threads > 0);
+
+	zone->dumpthreads = threads;
+}
+
+unsigned int
+dns_zone_getdumpthreads(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->dumpthreads);
+}
+
 void
 dns_zone_setmaxxfrin(dns_zone_t *zone, isc_uint32_t maxxfrin) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -14102,6 +14718,13 @@ zone_loaddone(void *arg, isc_result_t result) {
 			goto again;
 		}
 	}
+	if (!isc_time_isepoch(&load->start)) {
+		isc_time_t end;
+
+		TIME_NOW(&end);
+		zone->loadrecords = load->callbacks.records;
+		zone->loadusecs = isc_time_microdiff(&end, &load->start);
+	}
 	(void)zone_postload(zone, load->db, load->loadtime, result);
 	zonemgr_putio(&zone->readio);
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADING);
@@ -14658,6 +15281,7 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->socketmgr = socketmgr;
 	zmgr->zonetasks = NULL;
 	zmgr->loadtasks = NULL;
+	zmgr->signtasks = NULL;
 	zmgr->mctxpool = NULL;
 	zmgr->task = NULL;
 	zmgr->notifyrl = NULL;
@@ -14946,6 +15570,10 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 		isc_taskpool_destroy(&zmgr->zonetasks);
 	if (zmgr->loadtasks != NULL)
 		isc_taskpool_destroy(&zmgr->loadtasks);
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks != NULL)
+		isc_taskpool_destroy(&zmgr->signtasks);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	if (zmgr->mctxpool != NULL)
 		isc_pool_destroy(&zmgr->mctxpool);
 
@@ -15030,6 +15658,16 @@ dns_zonemgr_setsize(dns_zonemgr_t *zmgr, int num_zones) {
 	if (result == ISC_R_SUCCESS)
 		zmgr->loadtasks = pool;
 
+	/*
+	 * Zones that sign with more than one task grow the signing
+	 * task pool as needed.
+	 */
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks == NULL)
+		(void)isc_taskpool_create(zmgr->taskmgr, zmgr->mctx, 1, 1,
+					  &zmgr->signtasks);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+
 #ifdef BIND9
 	/*
 	 * We always set all tasks in the zone-load task pool to
@@ -336,6 +336,31 @@ isc_file_getsizefd(int fd, off_t *size);
  * - ISC_R_SUCCESS on success
  */
 
+isc_result_t
+isc_file_mmap(int fd, size_t len, void **addrp);
+/*%<
+ * Map the first 'len' bytes of the open file 'fd' into memory, and
+ * return the address in '*addrp'.  The mapping is private and
+ * writable: changes to the memory are never written back to the file.
+ * Where the system cannot map files, the data is read into allocated
+ * memory instead.
+ *
+ * Requires:
+ * - len > 0
+ * - addrp != NULL && *addrp == NULL
+ *
+ * Returns:
+ * - ISC_R_SUCCESS on success
+ * - ISC_R_NOMEMORY
+ * - Other errors are possible.
+ */
+
+isc_result_t
+isc_file_munmap(void *addr, size_t len);
+/*%<
+ * Release memory of length 'len' returned by isc_file_mmap().
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* ISC_FILE_H */
@@ -74,6 +74,18 @@ typedef void (*isc_memfree_t)(void *, void *);
 #define ISC_MEMPOOL_NAMES 1
 #endif
 
+/*%
+ * Define ISC_MEM_THREADCACHE=1 to give each thread a small cache
+ * ("magazine") of free blocks per size class in front of every locked
+ * memory context, and of free items in front of every memory pool with
+ * an associated lock.  Gets and puts that hit the calling thread's
+ * cache take no lock at all; only refilling or draining a magazine
+ * does.  Has no effect in builds without threads.
+ */
+#ifndef ISC_MEM_THREADCACHE
+#define ISC_MEM_THREADCACHE 1
+#endif
+
 LIBISC_EXTERNAL_DATA extern unsigned int isc_mem_debugging;
 /*@{*/
 #define ISC_MEM_DEBUGTRACE		0x00000001U
@@ -136,6 +148,7 @@ LIBISC_EXTERNAL_DATA extern unsigned int isc_mem_debugging;
  */
 #define ISC_MEMFLAG_NOLOCK	0x00000001	 /* no lock is necessary */
 #define ISC_MEMFLAG_INTERNAL	0x00000002	 /* use internal malloc */
+#define ISC_MEMFLAG_NOCACHE	0x00000004	 /* no per-thread caches */
 #if ISC_MEM_USE_INTERNAL_MALLOC
 #define ISC_MEMFLAG_DEFAULT 	ISC_MEMFLAG_INTERNAL
 #else
@@ -332,6 +345,15 @@ isc_mem_createx2(size_t max_size, size_t target_size,
  * inadvisable to use this flag unless the user is very sure about the race
  * condition and the access to the object is highly performance sensitive.
  *
+ * Unless ISC_MEMFLAG_NOLOCK or ISC_MEMFLAG_NOCACHE is set in 'flags', or
+ * memory tracing or recording is enabled in isc_mem_debugging when the
+ * context is created, small blocks are served from per-thread caches
+ * (see ISC_MEM_THREADCACHE).  Blocks held in those caches are counted
+ * as in use, by their rounded-up size, until they are returned to the
+ * context; this happens when a cache overflows, when its thread exits
+ * and when the context is destroyed.  ISC_MEMFLAG_NOCACHE also turns off
+ * the per-thread caches of memory pools created from the context.
+ *
  * Requires:
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
@@ -597,6 +619,11 @@ isc_mempool_associatelock(isc_mempool_t *mpctx, isc_mutex_t *lock);
  * by other than mempool routines once it is given to a pool, since that can
  * easily cause double locking.
  *
+ * A pool with an associated lock also gets per-thread caches of free
+ * items (see ISC_MEM_THREADCACHE), unless its memory context was
+ * created with ISC_MEMFLAG_NOCACHE.  Items are only put into a thread's
+ * cache while no isc_mempool_setmaxalloc() limit is in effect.
+ *
  * Requires:
  *
  *\li	mpctpx is a valid pool.
@@ -659,7 +686,9 @@ isc_mempool_setmaxalloc(isc_mempool_t *mpctx, unsigned int limit);
 unsigned int
 isc_mempool_getallocated(isc_mempool_t *mpctx);
 /*%<
- * Returns the number of items allocated from this pool.
+ * Returns the number of items allocated from this pool.  Free items
+ * held in per-thread caches (see isc_mempool_associatelock()) are
+ * counted as allocated.
  */
 
 unsigned int
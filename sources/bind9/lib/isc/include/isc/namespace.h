@@ -128,6 +128,8 @@
 #define isc_socketmgr_setstats isc__socketmgr_setstats
 #define isc_socketmgr_setreserved isc__socketmgr_setreserved
 #define isc__socketmgr_maxudp isc___socketmgr_maxudp
+#define isc__socketmgr_setudpbatch isc___socketmgr_setudpbatch
+#define isc__socketmgr_setnthreads isc___socketmgr_setnthreads
 #define isc_socket_fdwatchcreate isc__socket_fdwatchcreate
 #define isc_socket_fdwatchpoke isc__socket_fdwatchpoke
 
@@ -137,6 +139,7 @@
 /* #define isc_task_exiting isc__task_exiting XXXMPA */
 #define isc_task_send isc__task_send
 #define isc_task_sendanddetach isc__task_sendanddetach
+#define isc_task_sendbatch isc__task_sendbatch
 #define isc_task_purgerange isc__task_purgerange
 #define isc_task_purge isc__task_purge
 #define isc_task_purgeevent isc__task_purgeevent
@@ -150,8 +153,10 @@
 #define isc_task_gettag isc__task_gettag
 #define isc_task_getcurrenttime isc__task_getcurrenttime
 #define isc_taskmgr_create isc__taskmgr_create
+#define isc_taskmgr_create2 isc__taskmgr_create2
 #define isc_taskmgr_setmode isc__taskmgr_setmode
 #define isc_taskmgr_mode isc__taskmgr_mode
+#define isc_taskmgr_setstats isc__taskmgr_setstats
 #define isc_taskmgr_destroy isc__taskmgr_destroy
 #define isc_taskmgr_setexcltask isc__taskmgr_setexcltask
 #define isc_taskmgr_excltask isc__taskmgr_excltask
@@ -167,6 +172,7 @@
 #define isc_timer_attach isc__timer_attach
 #define isc_timer_detach isc__timer_detach
 #define isc_timermgr_create isc__timermgr_create
+#define isc_timermgr_create2 isc__timermgr_create2
 #define isc_timermgr_poke isc__timermgr_poke
 #define isc_timermgr_destroy isc__timermgr_destroy
 
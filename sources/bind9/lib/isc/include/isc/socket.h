@@ -78,12 +78,27 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_MAXSCATTERGATHER	8
 
+/*%
+ * Maximum number of datagrams moved by a single batched UDP receive or
+ * send.  See isc__socketmgr_setudpbatch().
+ */
+#define ISC_SOCKET_MAXBATCH		64
+
 /*%
  * In isc_socket_bind() set socket option SO_REUSEADDR prior to calling
  * bind() if a non zero port is specified (AF_INET and AF_INET6).
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind() if a non zero port is specified (AF_INET and AF_INET6), so that
+ * several sockets may be bound to the same address and port and have the
+ * kernel distribute incoming traffic among them.  Implies
+ * ISC_SOCKET_REUSEADDRESS.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -150,7 +165,17 @@ enum {
 	isc_sockstatscounter_unixrecvfail = 50,
 	isc_sockstatscounter_fdwatchrecvfail = 51,
 
-	isc_sockstatscounter_max = 52
+	isc_sockstatscounter_udp4recvbatch = 52,
+	isc_sockstatscounter_udp6recvbatch = 53,
+	isc_sockstatscounter_udp4recvbatchpkts = 54,
+	isc_sockstatscounter_udp6recvbatchpkts = 55,
+
+	isc_sockstatscounter_udp4sendbatch = 56,
+	isc_sockstatscounter_udp6sendbatch = 57,
+	isc_sockstatscounter_udp4sendbatchpkts = 58,
+	isc_sockstatscounter_udp6sendbatchpkts = 59,
+
+	isc_sockstatscounter_max = 60
 };
 
 /***
@@ -639,6 +664,7 @@ isc_socket_bind(isc_socket_t *sock, isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	(ISC_SOCKET_REUSEPORT is not supported)
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -959,12 +985,16 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		      unsigned int maxsocks);
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
+ * "nthreads" is the number of watcher threads; each watcher has its own
+ * event queue and wakeup pipe, and a socket is served by the watcher
+ * selected by hashing its descriptor.  Zero means one.  Builds without
+ * threads or using select() always run a single watcher.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero and "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -1141,6 +1171,50 @@ isc__socketmgr_maxudp(isc_socketmgr_t *mgr, int maxudp);
  * Test interface. Drop UDP packet > 'maxudp'.
  */
 
+isc_result_t
+isc__socketmgr_setnthreads(isc_socketmgr_t *mgr, int nthreads);
+/*%<
+ * Change the number of watcher threads of a socket manager that has no
+ * open sockets.  See isc_socketmgr_create2().
+ *
+ * Requires:
+ * \li	'mgr' is a valid socket manager.
+ * \li	'nthreads' > 0.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS		'mgr' has open sockets; the watchers are
+ *				left unchanged.
+ * \li	#ISC_R_NOTIMPLEMENTED	more than one watcher is not supported
+ *				on this system.
+ * \li	#ISC_R_NOMEMORY
+ * \li	#ISC_R_UNEXPECTED
+ */
+
+isc_result_t
+isc__socketmgr_setudpbatch(isc_socketmgr_t *mgr, unsigned int batch);
+/*%<
+ * Set the maximum number of datagrams that are received or sent with a
+ * single system call when several I/O requests are queued on the same
+ * UDP socket.  A value of 0 or 1 disables batching, which is the default.
+ *
+ * Batched receives drain up to 'batch' queued receive requests with one
+ * recvmmsg() call each time the socket becomes readable; batched sends
+ * flush up to 'batch' queued send requests with one sendmmsg() call.
+ * The number of batched calls and of datagrams moved by them are counted
+ * in the isc_sockstatscounter_udp[46]{recv,send}batch{,pkts} counters, so
+ * the average batch size is pkts / batch.
+ *
+ * Requires:
+ * \li	'mgr' is a valid socket manager.
+ * \li	'batch' <= #ISC_SOCKET_MAXBATCH.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED	batched I/O is not supported on this
+ *				system; 'batch' is ignored.
+ */
+
 #ifdef HAVE_LIBXML2
 
 int
@@ -103,6 +103,21 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter);
  *\li	'stats' is a valid isc_stats_t.
  */
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter,
+	      isc_uint32_t val);
+/*%<
+ * Add 'val' to the counter-th counter of stats.  This is equivalent to
+ * calling isc_stats_increment() 'val' times, but takes the counter lock
+ * only once.
+ *
+ * Requires:
+ *\li	'stats' is a valid isc_stats_t.
+ *
+ *\li	counter is less than the maximum available ID for the stats specified
+ *	on creation.
+ */
+
 void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	       unsigned int options);
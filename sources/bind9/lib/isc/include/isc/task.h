@@ -91,6 +91,24 @@
 #define ISC_TASKEVENT_TEST		(ISC_EVENTCLASS_TASK + 1)
 #define ISC_TASKEVENT_LASTEVENT		(ISC_EVENTCLASS_TASK + 65535)
 
+/*%
+ * Task manager options.  See isc_taskmgr_create2().
+ */
+#define ISC_TASKMGR_PERWORKER		0x0001U
+
+/*%
+ * Statistics counters.  Used as isc_statscounter_t values.
+ */
+enum {
+	isc_taskstatscounter_tasklockwait = 0,
+	isc_taskstatscounter_queuelockwait = 1,
+	isc_taskstatscounter_inboxfull = 2,
+	isc_taskstatscounter_sendbatch = 3,
+	isc_taskstatscounter_sendbatchevents = 4,
+
+	isc_taskstatscounter_max = 5
+};
+
 /*****
  ***** Tasks.
  *****/
@@ -253,6 +271,12 @@ isc_task_send(isc_task_t *task, isc_event_t **eventp);
 /*%<
  * Send '*event' to 'task'.
  *
+ * Notes:
+ *
+ *\li	With worker threads and atomic operations, the event is normally
+ *	posted to a small inbox of the task without taking the task lock.
+ *	Events from any one sender are run in the order they were sent.
+ *
  * Requires:
  *
  *\li	'task' is a valid task.
@@ -263,6 +287,23 @@ isc_task_send(isc_task_t *task, isc_event_t **eventp);
  *\li	*eventp == NULL.
  */
 
+void
+isc_task_sendbatch(isc_task_t *task, isc_eventlist_t *events);
+/*%<
+ * Send all the events on 'events' to 'task', in order.  Unlike calling
+ * isc_task_send() for each of them, the task lock is taken only once and
+ * the task is made ready at most once.
+ *
+ * Requires:
+ *
+ *\li	'task' is a valid task.
+ *\li	'events' is a valid list of events whose types are non-zero.
+ *
+ * Ensures:
+ *
+ *\li	'events' is empty.
+ */
+
 void
 isc_task_sendanddetach(isc_task_t **taskp, isc_event_t **eventp);
 /*%<
@@ -661,9 +702,25 @@ isc_taskmgr_createinctx(isc_mem_t *mctx, isc_appctx_t *actx,
 isc_result_t
 isc_taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		   unsigned int default_quantum, isc_taskmgr_t **managerp);
+isc_result_t
+isc_taskmgr_create2(isc_mem_t *mctx, unsigned int workers,
+		    unsigned int default_quantum, unsigned int options,
+		    isc_taskmgr_t **managerp);
 /*%<
  * Create a new task manager.  isc_taskmgr_createinctx() also associates
  * the new manager with the specified application context.
+ * isc_taskmgr_create() is equivalent to isc_taskmgr_create2() with
+ * 'options' being zero.
+ *
+ * By default all worker threads share a single queue of ready tasks.
+ * If 'options' includes #ISC_TASKMGR_PERWORKER, each worker has its own
+ * ready queue instead: every task is bound to one of the queues when it
+ * is created and runs on that queue's worker, except that a worker with
+ * nothing to do takes ready tasks from the queues of busy workers.  This
+ * removes the contention on the shared queue when many events are sent
+ * concurrently.  Privileged mode and exclusive access work the same way
+ * with either kind of queue.  'options' has no effect unless the manager
+ * has worker threads.
  *
  * Notes:
  *
@@ -727,6 +784,22 @@ isc_taskmgr_mode(isc_taskmgr_t *manager);
  *\li      'manager' is a valid task manager.
  */
 
+void
+isc_taskmgr_setstats(isc_taskmgr_t *manager, isc_stats_t *stats);
+/*%<
+ * Set a general task manager statistics counter set 'stats' for
+ * 'manager'.  The counters show how often the locks of tasks and of
+ * ready queues were found held by another thread, how often a task's
+ * inbox was full, and how many batches and events isc_task_sendbatch()
+ * sent.
+ *
+ * Requires:
+ *\li	'manager' is valid and doesn't have stats already set.
+ *
+ *\li	stats is a valid statistics supporting task manager statistics
+ *	counters (see above).
+ */
+
 void
 isc_taskmgr_destroy(isc_taskmgr_t **managerp);
 /*%<
@@ -97,6 +97,11 @@ typedef struct isc_timerevent {
 	isc_time_t		due;
 } isc_timerevent_t;
 
+/*%
+ * Timer manager options.  See isc_timermgr_create2().
+ */
+#define ISC_TIMERMGR_WHEEL		0x0001U
+
 #define ISC_TIMEREVENT_FIRSTEVENT	(ISC_EVENTCLASS_TIMER + 0)
 #define ISC_TIMEREVENT_TICK		(ISC_EVENTCLASS_TIMER + 1)
 #define ISC_TIMEREVENT_IDLE		(ISC_EVENTCLASS_TIMER + 2)
@@ -350,9 +355,27 @@ isc_timermgr_createinctx(isc_mem_t *mctx, isc_appctx_t *actx,
 
 isc_result_t
 isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		     isc_timermgr_t **managerp);
 /*%<
  * Create a timer manager.  isc_timermgr_createinctx() also associates
  * the new manager with the specified application context.
+ * isc_timermgr_create() is equivalent to isc_timermgr_create2() with
+ * 'options' being zero.
+ *
+ * By default the manager keeps its scheduled timers in a single heap
+ * protected by the manager lock, so scheduling or cancelling a timer
+ * takes O(log n) time.  If 'options' includes #ISC_TIMERMGR_WHEEL, the
+ * timers are kept in hierarchical timing wheels instead.  There are
+ * several wheels, each with its own lock, and a timer is placed on the
+ * wheel belonging to the thread that created it.  Scheduling and
+ * cancelling a timer take constant time.  Timers expire in batches at
+ * the wheel's granularity of 10 milliseconds and never fire early, but
+ * they may fire up to one granule late.
+ *
+ * If a shared manager already exists, 'options' is ignored.
  *
  * Notes:
  *
@@ -33,6 +33,7 @@
 #include <isc/string.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
@@ -55,6 +56,16 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_debugging = ISC_MEM_DEBUGGING;
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
 
+#if ISC_MEM_THREADCACHE && defined(ISC_PLATFORM_USETHREADS)
+#define USE_THREADCACHE
+#define CACHE_MAXTHREADS	128		/*%< threads with caches */
+#define CACHE_MAXSIZE		512		/*%< largest cached block */
+#define CACHE_NCLASSES		(CACHE_MAXSIZE / ALIGNMENT_SIZE)
+#define MAGAZINE_BYTES		4096		/*%< aim for this much */
+#define MAGAZINE_MIN		8
+#define MAGAZINE_MAX		64
+#endif
+
 /*
  * Types.
  */
@@ -84,6 +95,39 @@ struct element {
 	element *		next;
 };
 
+#ifdef USE_THREADCACHE
+/*
+ * A magazine is a stack of free blocks of a single size which belongs
+ * to one thread and is therefore used without locking.  A thread has a
+ * threadcache for each memory context (one magazine per size class) and
+ * each locked memory pool (a single magazine) it has used.  The owner
+ * keeps a table of its threadcaches indexed by the thread's slot.
+ */
+typedef struct magazine {
+	element *		rounds;
+	unsigned int		count;
+	unsigned int		capacity;
+	size_t			size;
+} magazine_t;
+
+typedef void (*cacheflush_t)(void *, magazine_t *, unsigned int);
+
+typedef struct threadcache threadcache_t;
+struct threadcache {
+	void *			owner;		/*%< NULL once orphaned */
+	threadcache_t **	table;		/*%< owner's table */
+	cacheflush_t		flush;		/*%< return rounds to owner */
+	threadcache_t *		next;		/*%< thread's caches */
+	unsigned int		nmags;
+	magazine_t		mags[1];
+};
+
+typedef struct cachethread {
+	int			slot;		/*%< -1: no caches */
+	threadcache_t *		caches;
+} cachethread_t;
+#endif
+
 typedef struct {
 	/*!
 	 * This structure must be ALIGNMENT_SIZE bytes.
@@ -122,6 +166,21 @@ static __thread isc_mutex_t 		createlock;
  */
 static __thread isc_uint64_t		totallost;
 
+#ifdef USE_THREADCACHE
+/*
+ * Per-thread cache bookkeeping.  Unlike the context list these are
+ * shared by all threads.  'cachelock' protects 'cacheslots', the
+ * threads' cache lists and the owners' tables; it is always taken
+ * before any memory context or memory pool lock.
+ */
+static isc_once_t			cacheonce = ISC_ONCE_INIT;
+static isc_mutex_t			cachelock;
+static isc_thread_key_t			cachekey;
+static cachethread_t *			cacheslots[CACHE_MAXTHREADS];
+static cachethread_t			nocache = { -1, NULL };
+static __thread cachethread_t *		cachethread;
+#endif
+
 struct isc__mem {
 	isc_mem_t		common;
 	isc_ondestroy_t		ondestroy;
@@ -166,6 +225,11 @@ struct isc__mem {
 
 	unsigned int		memalloc_failures;
 	ISC_LINK(isc__mem_t)	link;
+
+#ifdef USE_THREADCACHE
+	threadcache_t **	caches;		/*%< NULL: not cached */
+	size_t			cachemax;	/*%< largest cached size */
+#endif
 };
 
 #define MEMPOOL_MAGIC		ISC_MAGIC('M', 'E', 'M', 'p')
@@ -192,6 +256,9 @@ struct isc__mempool {
 #if ISC_MEMPOOL_NAMES
 	char		name[16];	/*%< printed name in stats reports */
 #endif
+#ifdef USE_THREADCACHE
+	threadcache_t **caches;		/*%< NULL: not cached */
+#endif
 };
 
 /*
@@ -860,6 +927,421 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	}
 }
 
+/*!
+ * Update the overmem state after 'inuse' has grown.  Returns ISC_TRUE if
+ * the water function must be called with ISC_MEM_HIWATER once the
+ * context is unlocked.  mctx must be locked.
+ */
+static inline isc_boolean_t
+mem_hiwater(isc__mem_t *ctx) {
+	isc_boolean_t call_water = ISC_FALSE;
+
+	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	    !ctx->is_overmem) {
+		ctx->is_overmem = ISC_TRUE;
+	}
+	if (ctx->hi_water != 0U && !ctx->hi_called &&
+	    ctx->inuse > ctx->hi_water) {
+		call_water = ISC_TRUE;
+	}
+	if (ctx->inuse > ctx->maxinuse) {
+		ctx->maxinuse = ctx->inuse;
+		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
+			fprintf(thread_stderr, "maxinuse = %lu\n",
+				(unsigned long)ctx->inuse);
+	}
+
+	return (call_water);
+}
+
+/*!
+ * Update the overmem state after 'inuse' has shrunk.  Returns ISC_TRUE if
+ * the water function must be called with ISC_MEM_LOWATER once the
+ * context is unlocked.  mctx must be locked.
+ */
+static inline isc_boolean_t
+mem_lowater(isc__mem_t *ctx) {
+	isc_boolean_t call_water = ISC_FALSE;
+
+	/*
+	 * The check against ctx->lo_water == 0 is for the condition
+	 * when the context was pushed over hi_water but then had
+	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
+	 */
+	if (ctx->is_overmem &&
+	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+		ctx->is_overmem = ISC_FALSE;
+	}
+	if (ctx->hi_called &&
+	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+		if (ctx->water != NULL)
+			call_water = ISC_TRUE;
+	}
+
+	return (call_water);
+}
+
+#ifdef USE_THREADCACHE
+/*
+ * Per-thread caches.
+ *
+ * Blocks of up to ctx->cachemax bytes are always handled here, never
+ * by mem_getunlocked()/mem_putunlocked().  They are accounted for in
+ * stats[] and 'inuse' by their quantized size when they move between
+ * the context and a magazine, not on each isc_mem_get()/isc_mem_put().
+ * Items of a locked memory pool keep counting as allocated while they
+ * sit in a magazine.
+ */
+
+static void
+threadcache_orphan(threadcache_t *cache, int slot);
+
+static void
+threadcache_exit(void *arg) {
+	cachethread_t *thread = arg;
+	threadcache_t *cache;
+
+	LOCK(&cachelock);
+	while ((cache = thread->caches) != NULL) {
+		thread->caches = cache->next;
+		if (cache->owner != NULL)
+			threadcache_orphan(cache, thread->slot);
+		free(cache);
+	}
+	cacheslots[thread->slot] = NULL;
+	UNLOCK(&cachelock);
+
+	free(thread);
+	cachethread = NULL;
+}
+
+static void
+threadcache_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&cachelock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&cachekey, threadcache_exit) == 0);
+}
+
+static inline unsigned int
+magazine_capacity(size_t size) {
+	size_t rounds = MAGAZINE_BYTES / size;
+
+	if (rounds < MAGAZINE_MIN)
+		return (MAGAZINE_MIN);
+	if (rounds > MAGAZINE_MAX)
+		return (MAGAZINE_MAX);
+	return ((unsigned int)rounds);
+}
+
+/*!
+ * Return everything in 'cache' to its owner and disconnect the two.
+ * The cache itself is freed later by its thread.  cachelock must be held.
+ */
+static void
+threadcache_orphan(threadcache_t *cache, int slot) {
+	magazine_t *mag;
+	unsigned int i;
+
+	for (i = 0; i < cache->nmags; i++) {
+		mag = &cache->mags[i];
+		if (mag->count > 0U)
+			(cache->flush)(cache->owner, mag, mag->count);
+	}
+	INSIST(cache->table[slot] == cache);
+	cache->table[slot] = NULL;
+	cache->owner = NULL;
+}
+
+/*!
+ * Create the calling thread's cache for 'owner', whose magazines hold
+ * blocks of 'size', 2 * 'size', ... 'nmags' * 'size' bytes.  Returns
+ * NULL if the thread cannot have caches.
+ */
+static threadcache_t *
+threadcache_create(threadcache_t **table, void *owner, cacheflush_t flush,
+		   size_t size, unsigned int nmags)
+{
+	cachethread_t *thread = cachethread;
+	threadcache_t *cache, **cachep;
+	unsigned int i;
+	int slot;
+
+	RUNTIME_CHECK(isc_once_do(&cacheonce, threadcache_initialize)
+		      == ISC_R_SUCCESS);
+
+	if (thread == NULL) {
+		thread = malloc(sizeof(*thread));
+		if (thread == NULL)
+			return (NULL);
+		thread->slot = -1;
+		thread->caches = NULL;
+
+		LOCK(&cachelock);
+		for (slot = 0; slot < CACHE_MAXTHREADS; slot++) {
+			if (cacheslots[slot] == NULL) {
+				cacheslots[slot] = thread;
+				thread->slot = slot;
+				break;
+			}
+		}
+		if (thread->slot != -1 &&
+		    isc_thread_key_setspecific(cachekey, thread) != 0) {
+			cacheslots[thread->slot] = NULL;
+			thread->slot = -1;
+		}
+		UNLOCK(&cachelock);
+
+		if (thread->slot == -1) {
+			free(thread);
+			thread = &nocache;
+		}
+		cachethread = thread;
+	}
+	if (thread->slot == -1)
+		return (NULL);
+
+	cache = malloc(sizeof(*cache) + (nmags - 1) * sizeof(magazine_t));
+	if (cache == NULL)
+		return (NULL);
+	cache->owner = owner;
+	cache->table = table;
+	cache->flush = flush;
+	cache->nmags = nmags;
+	for (i = 0; i < nmags; i++) {
+		cache->mags[i].rounds = NULL;
+		cache->mags[i].count = 0;
+		cache->mags[i].size = (i + 1) * size;
+		cache->mags[i].capacity =
+			magazine_capacity(cache->mags[i].size);
+	}
+
+	LOCK(&cachelock);
+	/*
+	 * Free caches whose owners have been destroyed in the meantime.
+	 */
+	cachep = &thread->caches;
+	while (*cachep != NULL) {
+		if ((*cachep)->owner == NULL) {
+			threadcache_t *dead = *cachep;
+			*cachep = dead->next;
+			free(dead);
+		} else
+			cachep = &(*cachep)->next;
+	}
+	cache->next = thread->caches;
+	thread->caches = cache;
+	table[thread->slot] = cache;
+	UNLOCK(&cachelock);
+
+	return (cache);
+}
+
+static inline threadcache_t *
+threadcache_get(threadcache_t **table, void *owner, cacheflush_t flush,
+		size_t size, unsigned int nmags)
+{
+	cachethread_t *thread = cachethread;
+
+	/*
+	 * Only the calling thread ever sets its own entry in 'table'.
+	 */
+	if (thread != NULL) {
+		if (thread->slot == -1)
+			return (NULL);
+		if (table[thread->slot] != NULL)
+			return (table[thread->slot]);
+	}
+	return (threadcache_create(table, owner, flush, size, nmags));
+}
+
+/*!
+ * Return every thread's cache in 'table' to its owner, which is being
+ * destroyed.
+ */
+static void
+threadcache_detachall(threadcache_t **table) {
+	int slot;
+
+	RUNTIME_CHECK(isc_once_do(&cacheonce, threadcache_initialize)
+		      == ISC_R_SUCCESS);
+
+	LOCK(&cachelock);
+	for (slot = 0; slot < CACHE_MAXTHREADS; slot++) {
+		if (table[slot] != NULL)
+			threadcache_orphan(table[slot], slot);
+	}
+	UNLOCK(&cachelock);
+}
+
+/*!
+ * Return 'n' blocks from 'mag' to the context.  Returns ISC_TRUE if the
+ * water function must be called with ISC_MEM_LOWATER.
+ */
+static isc_boolean_t
+mem_cacheflush(isc__mem_t *ctx, magazine_t *mag, unsigned int n) {
+	size_t size = mag->size;
+	element *list = NULL, *item;
+	isc_boolean_t call_water;
+	unsigned int i;
+
+	INSIST(n <= mag->count);
+	for (i = 0; i < n; i++) {
+		item = mag->rounds;
+		mag->rounds = item->next;
+		item->next = list;
+		list = item;
+	}
+	mag->count -= n;
+
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) == 0) {
+		while (list != NULL) {
+			item = list;
+			list = item->next;
+			mem_put(ctx, item, size);
+		}
+	}
+
+	MCTXLOCK(ctx, &ctx->lock);
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+		while (list != NULL) {
+			item = list;
+			list = item->next;
+			item->next = ctx->freelists[size];
+			ctx->freelists[size] = item;
+		}
+		ctx->stats[size].freefrags += n;
+	}
+	INSIST(ctx->stats[size].gets >= n);
+	ctx->stats[size].gets -= n;
+	INSIST(ctx->inuse >= n * size);
+	ctx->inuse -= n * size;
+	call_water = mem_lowater(ctx);
+	MCTXUNLOCK(ctx, &ctx->lock);
+
+	return (call_water);
+}
+
+/*
+ * Used when the magazine's thread exits or the context is destroyed;
+ * cachelock is held, so the water function cannot be called.
+ */
+static void
+mem_cacheflushcb(void *ctx, magazine_t *mag, unsigned int n) {
+	(void)mem_cacheflush(ctx, mag, n);
+}
+
+static void *
+mem_cacheget(isc__mem_t *ctx, size_t new_size) {
+	threadcache_t *cache;
+	magazine_t *mag = NULL;
+	element *list = NULL, *item;
+	isc_boolean_t call_water = ISC_FALSE;
+	unsigned int i, n = 1;
+
+	cache = threadcache_get(ctx->caches, ctx, mem_cacheflushcb,
+				ALIGNMENT_SIZE, CACHE_NCLASSES);
+	if (cache != NULL) {
+		mag = &cache->mags[new_size / ALIGNMENT_SIZE - 1];
+		if (mag->rounds != NULL) {
+			item = mag->rounds;
+			mag->rounds = item->next;
+			mag->count--;
+			goto done;
+		}
+		n = mag->capacity / 2;
+	}
+
+	/*
+	 * The magazine is empty: refill half of it from the context
+	 * under a single lock.
+	 */
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+		MCTXLOCK(ctx, &ctx->lock);
+		for (i = 0; i < n; i++) {
+			if (ctx->freelists[new_size] == NULL &&
+			    !more_frags(ctx, new_size))
+				break;
+			item = ctx->freelists[new_size];
+			ctx->freelists[new_size] = item->next;
+			item->next = list;
+			list = item;
+		}
+		ctx->stats[new_size].freefrags -= i;
+	} else {
+		item = mem_get(ctx, new_size);
+		if (item != NULL) {
+			item->next = NULL;
+			list = item;
+		}
+		i = (item != NULL) ? 1 : 0;
+		MCTXLOCK(ctx, &ctx->lock);
+		ctx->total += i * new_size;
+	}
+	ctx->stats[new_size].gets += i;
+	ctx->stats[new_size].totalgets += i;
+	ctx->inuse += i * new_size;
+	if (i != 0U)
+		call_water = mem_hiwater(ctx);
+	MCTXUNLOCK(ctx, &ctx->lock);
+
+	if (call_water)
+		(ctx->water)(ctx->water_arg, ISC_MEM_HIWATER);
+
+	if (list == NULL)
+		return (NULL);
+	item = list;
+	if (list->next != NULL) {
+		INSIST(mag != NULL);
+		mag->rounds = list->next;
+		mag->count = i - 1;
+	}
+
+ done:
+#if ISC_MEM_FILL
+	memset(item, 0xbe, new_size); /* Mnemonic for "beef". */
+#endif
+	return (item);
+}
+
+static void
+mem_cacheput(isc__mem_t *ctx, void *mem, size_t size, size_t new_size) {
+	threadcache_t *cache;
+	magazine_t *mag, single;
+	element *item = mem;
+	isc_boolean_t call_water = ISC_FALSE;
+
+#if ISC_MEM_FILL
+#if ISC_MEM_CHECKOVERRUN
+	check_overrun(mem, size, new_size);
+#endif
+	memset(mem, 0xde, new_size); /* Mnemonic for "dead". */
+#else
+	UNUSED(size);
+#endif
+
+	cache = threadcache_get(ctx->caches, ctx, mem_cacheflushcb,
+				ALIGNMENT_SIZE, CACHE_NCLASSES);
+	if (cache == NULL) {
+		single.rounds = item;
+		single.count = 1;
+		single.size = new_size;
+		item->next = NULL;
+		call_water = mem_cacheflush(ctx, &single, 1);
+	} else {
+		mag = &cache->mags[new_size / ALIGNMENT_SIZE - 1];
+		if (mag->count == mag->capacity)
+			call_water = mem_cacheflush(ctx, mag,
+						    mag->capacity / 2);
+		item->next = mag->rounds;
+		mag->rounds = item;
+		mag->count++;
+	}
+
+	if (call_water)
+		(ctx->water)(ctx->water_arg, ISC_MEM_LOWATER);
+}
+#endif /* USE_THREADCACHE */
+
 /*
  * Private.
  */
@@ -968,6 +1450,10 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#ifdef USE_THREADCACHE
+	ctx->caches = NULL;
+	ctx->cachemax = 0;
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -1007,6 +1493,29 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 	}
 #endif
 
+#ifdef USE_THREADCACHE
+	/*
+	 * Blocks in a thread's cache can't be traced or checked, and an
+	 * unlocked context has no lock to avoid.
+	 */
+	if ((flags & (ISC_MEMFLAG_NOLOCK|ISC_MEMFLAG_NOCACHE)) == 0 &&
+	    (isc_mem_debugging & ~ISC_MEM_DEBUGUSAGE) == 0 &&
+	    ctx->max_size > ALIGNMENT_SIZE)
+	{
+		ctx->cachemax = rmsize(ctx->max_size - 1);
+		if (ctx->cachemax > CACHE_MAXSIZE)
+			ctx->cachemax = CACHE_MAXSIZE;
+		ctx->caches = (memalloc)(arg, CACHE_MAXTHREADS *
+					      sizeof(threadcache_t *));
+		if (ctx->caches == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto error;
+		}
+		memset(ctx->caches, 0,
+		       CACHE_MAXTHREADS * sizeof(threadcache_t *));
+	}
+#endif
+
 	ctx->memalloc_failures = 0;
 
 	LOCK(&contextslock);
@@ -1022,6 +1531,10 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 			(memfree)(arg, ctx->stats);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
+#ifdef USE_THREADCACHE
+		if (ctx->caches != NULL)
+			(memfree)(arg, ctx->caches);
+#endif
 #if ISC_MEM_TRACKLINES
 		if (ctx->debuglist != NULL)
 			(ctx->memfree)(ctx->arg, ctx->debuglist);
@@ -1055,6 +1568,11 @@ destroy(isc__mem_t *ctx) {
 	unsigned int i;
 	isc_ondestroy_t ondest;
 
+#ifdef USE_THREADCACHE
+	if (ctx->caches != NULL)
+		threadcache_detachall(ctx->caches);
+#endif
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1101,6 +1619,10 @@ destroy(isc__mem_t *ctx) {
 	}
 
 	(ctx->memfree)(ctx->arg, ctx->stats);
+#ifdef USE_THREADCACHE
+	if (ctx->caches != NULL)
+		(ctx->memfree)(ctx->arg, ctx->caches);
+#endif
 
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		for (i = 0; i < ctx->basic_table_count; i++)
@@ -1204,6 +1726,12 @@ isc___mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef USE_THREADCACHE
+	if (ctx->caches != NULL && size <= ctx->cachemax) {
+		mem_cacheput(ctx, ptr, size, quantize(size));
+		MCTXLOCK(ctx, &ctx->lock);
+	} else
+#endif
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		mem_putunlocked(ctx, ptr, size);
@@ -1275,6 +1803,11 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	if ((isc_mem_debugging & (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0)
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+#ifdef USE_THREADCACHE
+	if (ctx->caches != NULL && size <= ctx->cachemax)
+		return (mem_cacheget(ctx, quantize(size)));
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1286,21 +1819,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	}
 
 	ADD_TRACE(ctx, ptr, size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-	    !ctx->is_overmem) {
-		ctx->is_overmem = ISC_TRUE;
-	}
-	if (ctx->hi_water != 0U && !ctx->hi_called &&
-	    ctx->inuse > ctx->hi_water) {
-		call_water = ISC_TRUE;
-	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
-			fprintf(thread_stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
-	}
+	call_water = mem_hiwater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water)
@@ -1331,6 +1850,13 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef USE_THREADCACHE
+	if (ctx->caches != NULL && size <= ctx->cachemax) {
+		mem_cacheput(ctx, ptr, size, quantize(size));
+		return;
+	}
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		mem_putunlocked(ctx, ptr, size);
@@ -1341,21 +1867,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	}
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
-
-	/*
-	 * The check against ctx->lo_water == 0 is for the condition
-	 * when the context was pushed over hi_water but then had
-	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
-	 */
-	if (ctx->is_overmem &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
-		ctx->is_overmem = ISC_FALSE;
-	}
-	if (ctx->hi_called &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
-		if (ctx->water != NULL)
-			call_water = ISC_TRUE;
-	}
+	call_water = mem_lowater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water)
@@ -1866,6 +2378,9 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->name[0] = 0;
 #endif
 	mpctx->items = NULL;
+#ifdef USE_THREADCACHE
+	mpctx->caches = NULL;
+#endif
 
 	*mpctxp = (isc_mempool_t *)mpctx;
 
@@ -1909,6 +2424,14 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	REQUIRE(mpctxp != NULL);
 	mpctx = (isc__mempool_t *)*mpctxp;
 	REQUIRE(VALID_MEMPOOL(mpctx));
+#ifdef USE_THREADCACHE
+	if (mpctx->caches != NULL) {
+		threadcache_detachall(mpctx->caches);
+		isc_mem_put((isc_mem_t *)mpctx->mctx, mpctx->caches,
+			    CACHE_MAXTHREADS * sizeof(threadcache_t *));
+		mpctx->caches = NULL;
+	}
+#endif
 #if ISC_MEMPOOL_NAMES
 	if (mpctx->allocated > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1972,19 +2495,112 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 	REQUIRE(lock != NULL);
 
 	mpctx->lock = lock;
+
+#ifdef USE_THREADCACHE
+	/*
+	 * Without the per-thread caches the pool still works, only slower.
+	 */
+	if ((mpctx->mctx->flags & ISC_MEMFLAG_NOCACHE) == 0) {
+		mpctx->caches = isc_mem_get((isc_mem_t *)mpctx->mctx,
+					    CACHE_MAXTHREADS *
+					    sizeof(threadcache_t *));
+		if (mpctx->caches != NULL)
+			memset(mpctx->caches, 0,
+			       CACHE_MAXTHREADS * sizeof(threadcache_t *));
+	}
+#endif
 }
 
+/*!
+ * Give 'mem' back to the pool, or to the memory context if the pool's
+ * free list is full.  The pool must be locked.
+ */
+static void
+mempool_putunlocked(isc__mempool_t *mpctx, void *mem) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+
+	INSIST(mpctx->allocated > 0);
+	mpctx->allocated--;
+
+	/*
+	 * If our free list is full, return this to the mctx directly.
+	 */
+	if (mpctx->freecount >= mpctx->freemax) {
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			MCTXLOCK(mctx, &mctx->lock);
+			mem_putunlocked(mctx, mem, mpctx->size);
+			MCTXUNLOCK(mctx, &mctx->lock);
+		} else {
+			mem_put(mctx, mem, mpctx->size);
+			MCTXLOCK(mctx, &mctx->lock);
+			mem_putstats(mctx, mem, mpctx->size);
+			MCTXUNLOCK(mctx, &mctx->lock);
+		}
+		return;
+	}
+
+	/*
+	 * Otherwise, attach it to our free list and bump the counter.
+	 */
+	mpctx->freecount++;
+	item = (element *)mem;
+	item->next = mpctx->items;
+	mpctx->items = item;
+}
+
+#ifdef USE_THREADCACHE
+/*!
+ * Return 'n' items from 'mag' to the pool.
+ */
+static void
+mempool_cacheflush(void *arg, magazine_t *mag, unsigned int n) {
+	isc__mempool_t *mpctx = arg;
+	element *item;
+	unsigned int i;
+
+	INSIST(n <= mag->count);
+	LOCK(mpctx->lock);
+	for (i = 0; i < n; i++) {
+		item = mag->rounds;
+		mag->rounds = item->next;
+		mempool_putunlocked(mpctx, item);
+	}
+	mag->count -= n;
+	UNLOCK(mpctx->lock);
+}
+#endif
+
 ISC_MEMFUNC_SCOPE void *
 isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	element *item;
 	isc__mem_t *mctx;
 	unsigned int i;
+#ifdef USE_THREADCACHE
+	threadcache_t *cache;
+#endif
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 	mctx = mpctx->mctx;
 
+#ifdef USE_THREADCACHE
+	if (mpctx->caches != NULL &&
+	    (isc_mem_debugging &
+	     (ISC_MEM_DEBUGTRACE|ISC_MEM_DEBUGRECORD)) == 0)
+	{
+		cache = threadcache_get(mpctx->caches, mpctx,
+					mempool_cacheflush, mpctx->size, 1);
+		if (cache != NULL && cache->mags[0].rounds != NULL) {
+			item = cache->mags[0].rounds;
+			cache->mags[0].rounds = item->next;
+			cache->mags[0].count--;
+			return (item);
+		}
+	}
+#endif
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2061,51 +2677,52 @@ ISC_MEMFUNC_SCOPE void
 isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	isc__mem_t *mctx;
+#ifdef USE_THREADCACHE
+	threadcache_t *cache;
+	magazine_t *mag;
 	element *item;
+#endif
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
 	mctx = mpctx->mctx;
 
+#ifdef USE_THREADCACHE
+	/*
+	 * Items in a thread's cache still count as allocated, so keep
+	 * them out of the caches while the pool has an allocation limit.
+	 */
+	if (mpctx->caches != NULL && mpctx->maxalloc == UINT_MAX &&
+	    (isc_mem_debugging &
+	     (ISC_MEM_DEBUGTRACE|ISC_MEM_DEBUGRECORD)) == 0)
+	{
+		cache = threadcache_get(mpctx->caches, mpctx,
+					mempool_cacheflush, mpctx->size, 1);
+		if (cache != NULL) {
+			mag = &cache->mags[0];
+			if (mag->count == mag->capacity)
+				mempool_cacheflush(mpctx, mag,
+						   mag->capacity / 2);
+			item = (element *)mem;
+			item->next = mag->rounds;
+			mag->rounds = item;
+			mag->count++;
+			return;
+		}
+	}
+#endif
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
-	INSIST(mpctx->allocated > 0);
-	mpctx->allocated--;
-
 #if ISC_MEM_TRACKLINES
 	MCTXLOCK(mctx, &mctx->lock);
 	DELETE_TRACE(mctx, mem, mpctx->size, file, line);
 	MCTXUNLOCK(mctx, &mctx->lock);
 #endif /* ISC_MEM_TRACKLINES */
 
-	/*
-	 * If our free list is full, return this to the mctx directly.
-	 */
-	if (mpctx->freecount >= mpctx->freemax) {
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			MCTXLOCK(mctx, &mctx->lock);
-			mem_putunlocked(mctx, mem, mpctx->size);
-			MCTXUNLOCK(mctx, &mctx->lock);
-		} else {
-			mem_put(mctx, mem, mpctx->size);
-			MCTXLOCK(mctx, &mctx->lock);
-			mem_putstats(mctx, mem, mpctx->size);
-			MCTXUNLOCK(mctx, &mctx->lock);
-		}
-		if (mpctx->lock != NULL)
-			UNLOCK(mpctx->lock);
-		return;
-	}
-
-	/*
-	 * Otherwise, attach it to our free list and bump the counter.
-	 */
-	mpctx->freecount++;
-	item = (element *)mem;
-	item->next = mpctx->items;
-	mpctx->items = item;
+	mempool_putunlocked(mpctx, mem);
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -255,6 +255,37 @@ decrementcounter(isc_stats_t *stats, int counter) {
 #endif
 }
 
+static inline void
+addcounter(isc_stats_t *stats, int counter, isc_uint32_t val) {
+	isc_int32_t prev;
+
+#ifdef ISC_RWLOCK_USEATOMIC
+	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_read);
+#endif
+
+#if ISC_STATS_USEMULTIFIELDS
+	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo,
+			       (isc_int32_t)val);
+	/*
+	 * Carry into the higher field if the lower one wrapped around;
+	 * see incrementcounter().
+	 */
+	if ((isc_uint32_t)prev > 0xffffffffU - val)
+		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+#elif defined(ISC_PLATFORM_HAVEXADDQ)
+	UNUSED(prev);
+	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter],
+			 (isc_int64_t)val);
+#else
+	UNUSED(prev);
+	stats->counters[counter] += val;
+#endif
+
+#ifdef ISC_RWLOCK_USEATOMIC
+	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_read);
+#endif
+}
+
 static void
 copy_counters(isc_stats_t *stats) {
 	int i;
@@ -307,6 +338,16 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	decrementcounter(stats, (int)counter);
 }
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter,
+	      isc_uint32_t val)
+{
+	REQUIRE(ISC_STATS_VALID(stats));
+	REQUIRE(counter < stats->ncounters);
+
+	addcounter(stats, (int)counter, val);
+}
+
 void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn,
 	       void *arg, unsigned int options)
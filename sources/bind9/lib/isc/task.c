@@ -28,12 +28,14 @@
 
 #include <config.h>
 
+#include <isc/atomic.h>
 #include <isc/condition.h>
 #include <isc/event.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/msgs.h>
 #include <isc/platform.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/thread.h>
@@ -64,6 +66,16 @@
 #endif	/* ISC_PLATFORM_USETHREADS */
 #endif	/* BIND9 */
 
+/*%
+ * With worker threads and atomic operations, isc_task_send() posts an
+ * event to an inbox of the task without taking the task lock; see
+ * inbox_post().
+ */
+#if defined(USE_WORKER_THREADS) && defined(ISC_PLATFORM_HAVEXADD) && \
+    defined(ISC_PLATFORM_HAVECMPXCHG)
+#define USE_TASK_INBOX
+#endif
+
 #include "task_p.h"
 
 #ifdef ISC_TASK_TRACE
@@ -100,6 +112,9 @@ static const char *statenames[] = {
 typedef struct isc__task isc__task_t;
 typedef struct isc__taskmgr isc__taskmgr_t;
 
+/*% Number of events a task can hold in its inbox.  Must be a power of 2. */
+#define TASK_INBOX_SIZE			16
+
 struct isc__task {
 	/* Not locked. */
 	isc_task_t			common;
@@ -117,8 +132,23 @@ struct isc__task {
 	void *				tag;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of the task's ready queue. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
+	/* Not locked; set at creation. */
+	unsigned int			queue;
+	/* Only used by the worker running the task. */
+	unsigned int			runqueue;
+#ifdef USE_TASK_INBOX
+	/*
+	 * Claimed by senders with atomic operations; 'inbox_head' is
+	 * only changed by the holder of the task lock.
+	 */
+	isc_int32_t			inbox_tail;
+	isc_int32_t			inbox_posted;
+	isc_int32_t			inbox_head;
+	isc_event_t * volatile		inbox[TASK_INBOX_SIZE];
+#endif /* USE_TASK_INBOX */
 };
 
 #define TASK_F_SHUTTINGDOWN		0x01
@@ -132,6 +162,30 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * A ready queue.  Normally all workers share a single queue.  With
+ * ISC_TASKMGR_PERWORKER each worker has a queue of its own: a task is
+ * bound to one of them when it is created and is always made ready
+ * there, and a worker whose queue is empty steals ready tasks from the
+ * queues of the others.
+ *
+ * 'tasks_running' counts the tasks taken from this queue that are
+ * being run, wherever they run.
+ */
+typedef struct isc__taskqueue {
+	isc__taskmgr_t *		manager;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_running;
+#ifdef USE_WORKER_THREADS
+	unsigned int			idle_workers;
+	isc_condition_t			work_available;
+	isc_condition_t			drained;
+#endif /* USE_WORKER_THREADS */
+} isc__taskqueue_t;
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -141,22 +195,24 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+	unsigned int			nqueues;
+	unsigned int			maxqueues;
+	isc__taskqueue_t *		queues;
+	isc_stats_t *			stats;
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			nextqueue;
+	isc__task_t			*excl;
+	/*
+	 * Locked by task manager lock and by every queue lock; holding
+	 * either is enough to read them.
+	 */
 	isc_taskmgrmode_t		mode;
-#ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
-	isc_condition_t			exclusive_granted;
-	isc_condition_t			paused;
-#endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
 	isc_boolean_t			exiting;
-	isc__task_t			*excl;
+	isc_boolean_t			finished;
 #ifdef USE_SHARED_MANAGER
 	unsigned int			refs;
 #endif /* ISC_PLATFORM_USETHREADS */
@@ -165,6 +221,8 @@ struct isc__taskmgr {
 #define DEFAULT_TASKMGR_QUANTUM		10
 #define DEFAULT_DEFAULT_QUANTUM		5
 #define FINISHED(m)			((m)->exiting && EMPTY((m)->tasks))
+#define BLOCKED(m)			((m)->pause_requested || \
+					 (m)->exclusive_requested)
 
 #ifdef USE_SHARED_MANAGER
 static isc__taskmgr_t *taskmgr = NULL;
@@ -191,6 +249,8 @@ ISC_TASKFUNC_SCOPE void
 isc__task_send(isc_task_t *task0, isc_event_t **eventp);
 ISC_TASKFUNC_SCOPE void
 isc__task_sendanddetach(isc_task_t **taskp, isc_event_t **eventp);
+ISC_TASKFUNC_SCOPE void
+isc__task_sendbatch(isc_task_t *task0, isc_eventlist_t *events);
 ISC_TASKFUNC_SCOPE unsigned int
 isc__task_purgerange(isc_task_t *task0, void *sender, isc_eventtype_t first,
 		     isc_eventtype_t last, void *tag);
@@ -224,6 +284,10 @@ isc__task_getcurrenttime(isc_task_t *task0, isc_stdtime_t *t);
 ISC_TASKFUNC_SCOPE isc_result_t
 isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		    unsigned int default_quantum, isc_taskmgr_t **managerp);
+ISC_TASKFUNC_SCOPE isc_result_t
+isc__taskmgr_create2(isc_mem_t *mctx, unsigned int workers,
+		     unsigned int default_quantum, unsigned int options,
+		     isc_taskmgr_t **managerp);
 ISC_TASKFUNC_SCOPE void
 isc__taskmgr_destroy(isc_taskmgr_t **managerp);
 ISC_TASKFUNC_SCOPE void
@@ -242,16 +306,29 @@ ISC_TASKFUNC_SCOPE void
 isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode);
 ISC_TASKFUNC_SCOPE isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
+ISC_TASKFUNC_SCOPE void
+isc__taskmgr_setstats(isc_taskmgr_t *manager0, isc_stats_t *stats);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
 
+static inline void
+lock_queues(isc__taskmgr_t *manager);
+
+static inline void
+unlock_queues(isc__taskmgr_t *manager);
+
+#ifdef USE_WORKER_THREADS
+static inline void
+broadcast_queues(isc__taskmgr_t *manager);
+#endif /* USE_WORKER_THREADS */
+
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
 
@@ -260,6 +337,7 @@ static struct isc__taskmethods {
 	 */
 #ifndef BIND9
 	void *purgeevent, *unsendrange, *getname, *gettag, *getcurrenttime;
+	void *sendbatch, *setstats;
 #endif
 } taskmethods = {
 	{
@@ -283,7 +361,8 @@ static struct isc__taskmethods {
 	,
 	(void *)isc__task_purgeevent, (void *)isc__task_unsendrange,
 	(void *)isc__task_getname, (void *)isc__task_gettag,
-	(void *)isc__task_getcurrenttime
+	(void *)isc__task_getcurrenttime,
+	(void *)isc__task_sendbatch, (void *)isc__taskmgr_setstats
 #endif
 };
 
@@ -296,15 +375,177 @@ static isc_taskmgrmethods_t taskmgrmethods = {
 	isc__taskmgr_excltask
 };
 
+static inline void
+inc_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
+	if (stats != NULL)
+		isc_stats_increment(stats, counterid);
+}
+
+/*
+ * Lock 'lp', counting in 'counterid' of the statistics of manager 'm'
+ * the times it was held by another thread.
+ */
+#define LOCK_COUNTED(lp, m, counterid) \
+	do { \
+		if (isc_mutex_trylock(lp) != ISC_R_SUCCESS) { \
+			inc_stats((m)->stats, counterid); \
+			LOCK(lp); \
+		} \
+	} while (0)
+
 /***
  *** Tasks.
  ***/
 
+#ifdef USE_TASK_INBOX
+/*
+ * Post '*eventp' to the inbox of 'task' without taking the task lock.
+ *
+ * The sender claims a slot by advancing 'inbox_tail', stores the event
+ * there, and then counts it in 'inbox_posted'.  The sender that finds
+ * 'inbox_posted' zero must make sure that the task will run, and has
+ * '*wakeupp' set: see isc__task_send().  Any other sender need not do
+ * anything, as the task does not become idle before inbox_drain() has
+ * taken every event counted.
+ *
+ * Returns ISC_FALSE, leaving '*eventp' alone, if the inbox is full.
+ */
+static inline isc_boolean_t
+inbox_post(isc__task_t *task, isc_event_t **eventp, isc_boolean_t *wakeupp) {
+	isc_int32_t tail;
+
+	do {
+		tail = task->inbox_tail;
+		if ((isc_uint32_t)tail - (isc_uint32_t)task->inbox_head >=
+		    TASK_INBOX_SIZE)
+			return (ISC_FALSE);
+	} while (isc_atomic_cmpxchg(&task->inbox_tail, tail,
+				    (isc_int32_t)((isc_uint32_t)tail + 1))
+		 != tail);
+
+	task->inbox[(isc_uint32_t)tail % TASK_INBOX_SIZE] = *eventp;
+	*eventp = NULL;
+	*wakeupp = ISC_TF(isc_atomic_xadd(&task->inbox_posted, 1) == 0);
+
+	return (ISC_TRUE);
+}
+#endif /* USE_TASK_INBOX */
+
+/*
+ * Move the events in the inbox of 'task' to the end of its event list,
+ * in the order their slots were claimed.  Events sent with the task lock
+ * held are queued after calling this, so that the events of any one
+ * sender are always run in the order they were sent.
+ *
+ * This stops at the first slot which a sender has claimed but not yet
+ * filled, rather than wait for it with the task lock held; the events
+ * after it are left for a later drain.  Callers which must see every
+ * event whose send has returned call inbox_settle() before taking the
+ * task lock, and the worker keeps the task ready while inbox_pending().
+ *
+ * If events were moved to the list of an idle task, the task is made
+ * ready and ISC_TRUE is returned; the caller must then call task_ready()
+ * once it has released the task lock.
+ *
+ * Caller must be holding the task lock.
+ */
+static inline isc_boolean_t
+inbox_drain(isc__task_t *task) {
+#ifdef USE_TASK_INBOX
+	isc_event_t *event;
+	isc_uint32_t head;
+	isc_int32_t n = 0;
+
+	head = (isc_uint32_t)task->inbox_head;
+	while (n < TASK_INBOX_SIZE &&
+	       (event = task->inbox[head % TASK_INBOX_SIZE]) != NULL) {
+		task->inbox[head % TASK_INBOX_SIZE] = NULL;
+		ENQUEUE(task->events, event, ev_link);
+		head++;
+		n++;
+	}
+	if (n == 0)
+		return (ISC_FALSE);
+
+	/*
+	 * A sender may have filled a slot taken here but not yet counted
+	 * it, which leaves 'inbox_posted' below zero until it does.
+	 */
+	(void)isc_atomic_xadd(&task->inbox_head, n);
+	(void)isc_atomic_xadd(&task->inbox_posted, -n);
+
+	if (task->state == task_state_idle) {
+		task->state = task_state_ready;
+		return (ISC_TRUE);
+	}
+#else
+	UNUSED(task);
+#endif /* USE_TASK_INBOX */
+
+	return (ISC_FALSE);
+}
+
+/*
+ * Wait until every inbox slot claimed so far has been filled, so that
+ * the next inbox_drain() takes every event whose isc_task_send() has
+ * returned.  A sender fills its slot a few instructions after claiming
+ * it, but may be preempted in between; waiting here, rather than in
+ * inbox_drain(), leaves the task lock free for everyone else meanwhile.
+ *
+ * Caller must not be holding the task lock.
+ */
+static inline void
+inbox_settle(isc__task_t *task) {
+#ifdef USE_TASK_INBOX
+	isc_uint32_t head, tail;
+
+	tail = (isc_uint32_t)task->inbox_tail;
+	for (;;) {
+		head = (isc_uint32_t)task->inbox_head;
+		while ((isc_int32_t)(tail - head) > 0 &&
+		       task->inbox[head % TASK_INBOX_SIZE] != NULL)
+			head++;
+		if ((isc_int32_t)(tail - head) <= 0)
+			return;
+		/*
+		 * Either a sender has yet to fill the slot, or the holder
+		 * of the task lock has just taken its event and not yet
+		 * moved 'inbox_head' on.
+		 */
+		isc_thread_yield();
+	}
+#else
+	UNUSED(task);
+#endif /* USE_TASK_INBOX */
+}
+
+/*
+ * Return ISC_TRUE if the inbox holds events counted by their senders
+ * which inbox_drain() could not take yet, because an earlier slot has
+ * not been filled.  The task must not become idle then: the sender of
+ * that slot will find the count non-zero and so will not wake it.
+ *
+ * Caller must be holding the task lock.
+ */
+static inline isc_boolean_t
+inbox_pending(isc__task_t *task) {
+#ifdef USE_TASK_INBOX
+	return (ISC_TF(isc_atomic_xadd(&task->inbox_posted, 0) > 0));
+#else
+	UNUSED(task);
+
+	return (ISC_FALSE);
+#endif /* USE_TASK_INBOX */
+}
+
 static void
 task_finished(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
 
 	REQUIRE(EMPTY(task->events));
+#ifdef USE_TASK_INBOX
+	REQUIRE(task->inbox_posted == 0);
+#endif /* USE_TASK_INBOX */
 	REQUIRE(EMPTY(task->on_shutdown));
 	REQUIRE(task->references == 0);
 	REQUIRE(task->state == task_state_done);
@@ -313,7 +554,6 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
-#ifdef USE_WORKER_THREADS
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
@@ -321,9 +561,13 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
-	}
+		lock_queues(manager);
+		manager->finished = ISC_TRUE;
+#ifdef USE_WORKER_THREADS
+		broadcast_queues(manager);
 #endif /* USE_WORKER_THREADS */
+		unlock_queues(manager);
+	}
 	UNLOCK(&manager->lock);
 
 	DESTROYLOCK(&task->lock);
@@ -340,6 +584,9 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	isc__task_t *task;
 	isc_boolean_t exiting;
 	isc_result_t result;
+#ifdef USE_TASK_INBOX
+	unsigned int i;
+#endif /* USE_TASK_INBOX */
 
 	REQUIRE(VALID_MANAGER(manager));
 	REQUIRE(taskp != NULL && *taskp == NULL);
@@ -366,12 +613,23 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
+	task->runqueue = 0;
+#ifdef USE_TASK_INBOX
+	task->inbox_tail = 0;
+	task->inbox_posted = 0;
+	task->inbox_head = 0;
+	for (i = 0; i < TASK_INBOX_SIZE; i++)
+		task->inbox[i] = NULL;
+#endif /* USE_TASK_INBOX */
 
 	exiting = ISC_FALSE;
 	LOCK(&manager->lock);
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		task->queue = manager->nextqueue;
+		manager->nextqueue = (manager->nextqueue + 1) %
+				     manager->nqueues;
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -426,6 +684,7 @@ task_shutdown(isc__task_t *task) {
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				      ISC_MSG_SHUTTINGDOWN, "shutting down"));
 		task->flags |= TASK_F_SHUTTINGDOWN;
+		was_idle = inbox_drain(task);
 		if (task->state == task_state_idle) {
 			INSIST(EMPTY(task->events));
 			task->state = task_state_ready;
@@ -449,6 +708,36 @@ task_shutdown(isc__task_t *task) {
 	return (was_idle);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * The workers of queue 'busy' are all running tasks; wake an idle
+ * worker elsewhere so that it can steal the task just made ready there.
+ * This is only a hint: if no worker is idle, the task will be run once
+ * a worker of 'busy' is done.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_idle_worker(isc__taskmgr_t *manager, unsigned int busy) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		queue = &manager->queues[(busy + i) % manager->nqueues];
+		/* Unlocked peek; rechecked below. */
+		if (queue->idle_workers == 0)
+			continue;
+		LOCK(&queue->lock);
+		if (queue->idle_workers > 0) {
+			SIGNAL(&queue->work_available);
+			UNLOCK(&queue->lock);
+			return;
+		}
+		UNLOCK(&queue->lock);
+	}
+}
+#endif /* USE_WORKER_THREADS */
+
 /*
  * Moves a task onto the appropriate run queue.
  *
@@ -457,8 +746,10 @@ task_shutdown(isc__task_t *task) {
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
 	isc_boolean_t has_privilege = isc__task_privilege((isc_task_t *) task);
+	isc_boolean_t steal = ISC_FALSE;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -466,13 +757,24 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
+	queue = &manager->queues[task->queue];
+	LOCK_COUNTED(&queue->lock, manager,
+		     isc_taskstatscounter_queuelockwait);
 	push_readyq(manager, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->idle_workers > 0 || manager->nqueues == 1)
+			SIGNAL(&queue->work_available);
+		else
+			steal = ISC_TRUE;
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
+#ifdef USE_WORKER_THREADS
+	if (steal)
+		wake_idle_worker(manager, task->queue);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline isc_boolean_t
@@ -546,6 +848,7 @@ task_send(isc__task_t *task, isc_event_t **eventp) {
 
 	XTRACE("task_send");
 
+	was_idle = inbox_drain(task);
 	if (task->state == task_state_idle) {
 		was_idle = ISC_TRUE;
 		INSIST(EMPTY(task->events));
@@ -563,6 +866,9 @@ ISC_TASKFUNC_SCOPE void
 isc__task_send(isc_task_t *task0, isc_event_t **eventp) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc_boolean_t was_idle;
+#ifdef USE_TASK_INBOX
+	isc_boolean_t wakeup;
+#endif /* USE_TASK_INBOX */
 
 	/*
 	 * Send '*event' to 'task'.
@@ -572,12 +878,40 @@ isc__task_send(isc_task_t *task0, isc_event_t **eventp) {
 
 	XTRACE("isc_task_send");
 
+#ifdef USE_TASK_INBOX
+	REQUIRE(eventp != NULL && *eventp != NULL);
+	REQUIRE((*eventp)->ev_type > 0);
+
+	if (inbox_post(task, eventp, &wakeup)) {
+		if (!wakeup)
+			return;
+		/*
+		 * The event will be taken from the inbox when the task
+		 * runs; make sure that it does.
+		 */
+		was_idle = ISC_FALSE;
+		LOCK_COUNTED(&task->lock, task->manager,
+			     isc_taskstatscounter_tasklockwait);
+		if (task->state == task_state_idle) {
+			task->state = task_state_ready;
+			was_idle = ISC_TRUE;
+		}
+		UNLOCK(&task->lock);
+		if (was_idle)
+			task_ready(task);
+		return;
+	}
+	inc_stats(task->manager->stats, isc_taskstatscounter_inboxfull);
+	inbox_settle(task);
+#endif /* USE_TASK_INBOX */
+
 	/*
 	 * We're trying hard to hold locks for as short a time as possible.
 	 * We're also trying to hold as few locks as possible.  This is why
 	 * some processing is deferred until after the lock is released.
 	 */
-	LOCK(&task->lock);
+	LOCK_COUNTED(&task->lock, task->manager,
+		     isc_taskstatscounter_tasklockwait);
 	was_idle = task_send(task, eventp);
 	UNLOCK(&task->lock);
 
@@ -617,7 +951,9 @@ isc__task_sendanddetach(isc_task_t **taskp, isc_event_t **eventp) {
 
 	XTRACE("isc_task_sendanddetach");
 
-	LOCK(&task->lock);
+	inbox_settle(task);
+	LOCK_COUNTED(&task->lock, task->manager,
+		     isc_taskstatscounter_tasklockwait);
 	idle1 = task_send(task, eventp);
 	idle2 = task_detach(task);
 	UNLOCK(&task->lock);
@@ -635,6 +971,48 @@ isc__task_sendanddetach(isc_task_t **taskp, isc_event_t **eventp) {
 	*taskp = NULL;
 }
 
+ISC_TASKFUNC_SCOPE void
+isc__task_sendbatch(isc_task_t *task0, isc_eventlist_t *events) {
+	isc__task_t *task = (isc__task_t *)task0;
+	isc_boolean_t was_idle = ISC_FALSE;
+	isc_event_t *event;
+	unsigned int count = 0;
+
+	/*
+	 * Send all the events on 'events' to 'task', taking the task lock
+	 * and making the task ready at most once.
+	 */
+
+	REQUIRE(VALID_TASK(task));
+	REQUIRE(events != NULL);
+
+	XTRACE("isc_task_sendbatch");
+
+	if (EMPTY(*events))
+		return;
+
+	inbox_settle(task);
+	LOCK_COUNTED(&task->lock, task->manager,
+		     isc_taskstatscounter_tasklockwait);
+	while ((event = HEAD(*events)) != NULL) {
+		DEQUEUE(*events, event, ev_link);
+		if (task_send(task, &event))
+			was_idle = ISC_TRUE;
+		count++;
+	}
+	UNLOCK(&task->lock);
+
+	if (task->manager->stats != NULL) {
+		isc_stats_increment(task->manager->stats,
+				    isc_taskstatscounter_sendbatch);
+		isc_stats_add(task->manager->stats,
+			      isc_taskstatscounter_sendbatchevents, count);
+	}
+
+	if (was_idle)
+		task_ready(task);
+}
+
 #define PURGE_OK(event)	(((event)->ev_attributes & ISC_EVENTATTR_NOPURGE) == 0)
 
 static unsigned int
@@ -643,6 +1021,7 @@ dequeue_events(isc__task_t *task, void *sender, isc_eventtype_t first,
 	       isc_eventlist_t *events, isc_boolean_t purging)
 {
 	isc_event_t *event, *next_event;
+	isc_boolean_t was_idle;
 	unsigned int count = 0;
 
 	REQUIRE(VALID_TASK(task));
@@ -658,8 +1037,10 @@ dequeue_events(isc__task_t *task, void *sender, isc_eventtype_t first,
 	 * sender == NULL means "any sender", and tag == NULL means "any tag".
 	 */
 
+	inbox_settle(task);
 	LOCK(&task->lock);
 
+	was_idle = inbox_drain(task);
 	for (event = HEAD(task->events); event != NULL; event = next_event) {
 		next_event = NEXT(event, ev_link);
 		if (event->ev_type >= first && event->ev_type <= last &&
@@ -674,6 +1055,13 @@ dequeue_events(isc__task_t *task, void *sender, isc_eventtype_t first,
 
 	UNLOCK(&task->lock);
 
+	/*
+	 * The events of the inbox were sent before this call, and the task
+	 * would have been made ready for them anyway.
+	 */
+	if (was_idle)
+		task_ready(task);
+
 	return (count);
 }
 
@@ -703,7 +1091,8 @@ isc__task_purgerange(isc_task_t *task0, void *sender, isc_eventtype_t first,
 	}
 
 	/*
-	 * Note that purging never changes the state of the task.
+	 * Note that purging never changes the state of the task, except
+	 * to make it ready for the events found in its inbox.
 	 */
 
 	return (count);
@@ -726,6 +1115,7 @@ ISC_TASKFUNC_SCOPE isc_boolean_t
 isc__task_purgeevent(isc_task_t *task0, isc_event_t *event) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc_event_t *curr_event, *next_event;
+	isc_boolean_t was_idle;
 
 	/*
 	 * Purge 'event' from a task's event queue.
@@ -745,7 +1135,9 @@ isc__task_purgeevent(isc_task_t *task0, isc_event_t *event) {
 	 * Purging never changes the state of the task.
 	 */
 
+	inbox_settle(task);
 	LOCK(&task->lock);
+	was_idle = inbox_drain(task);
 	for (curr_event = HEAD(task->events);
 	     curr_event != NULL;
 	     curr_event = next_event) {
@@ -757,6 +1149,9 @@ isc__task_purgeevent(isc_task_t *task0, isc_event_t *event) {
 	}
 	UNLOCK(&task->lock);
 
+	if (was_idle)
+		task_ready(task);
+
 	if (curr_event == NULL)
 		return (ISC_FALSE);
 
@@ -845,6 +1240,7 @@ isc__task_shutdown(isc_task_t *task0) {
 
 	REQUIRE(VALID_TASK(task));
 
+	inbox_settle(task);
 	LOCK(&task->lock);
 	was_idle = task_shutdown(task);
 	UNLOCK(&task->lock);
@@ -918,45 +1314,80 @@ isc__task_getcurrenttime(isc_task_t *task0, isc_stdtime_t *t) {
  ***/
 
 /*
- * Return ISC_TRUE if the current ready list for the manager, which is
+ * Lock/unlock every ready queue, in order.  The manager's scheduling
+ * state is only changed while holding all of them.
+ */
+static inline void
+lock_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		LOCK(&manager->queues[i].lock);
+}
+
+static inline void
+unlock_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = manager->nqueues; i > 0; i--)
+		UNLOCK(&manager->queues[i - 1].lock);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake up every idle worker.
+ *
+ * Caller must hold all queue locks.
+ */
+static inline void
+broadcast_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		BROADCAST(&manager->queues[i].work_available);
+}
+#endif /* USE_WORKER_THREADS */
+
+/*
+ * Return ISC_TRUE if the current ready list of 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(list)));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list of 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
 	}
 
@@ -964,27 +1395,318 @@ pop_readyq(isc__taskmgr_t *manager) {
 }
 
 /*
- * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
- * flag set, then also push it onto the ready_priority_tasks queue.
+ * Push 'task' onto the ready_tasks list of its queue.  If 'task' has the
+ * privilege flag set, then also push it onto the ready_priority_tasks
+ * list.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the lock of the task's queue.
  */
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+	isc__taskqueue_t *queue = &manager->queues[task->queue];
+
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 }
 
+/*
+ * In privileged mode, return to normal mode once no task is running and
+ * no privileged task is ready.
+ *
+ * Caller must not hold any queue lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
-	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
-	unsigned int total_dispatch_count = 0;
-	isc__tasklist_t new_ready_tasks;
-	isc__tasklist_t new_priority_tasks;
+check_privileged(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	lock_queues(manager);
+	if (manager->mode == isc_taskmgrmode_privileged) {
+		for (i = 0; i < manager->nqueues; i++) {
+			queue = &manager->queues[i];
+			if (queue->tasks_running != 0 ||
+			    !empty_readyq(manager, queue))
+				break;
+		}
+		if (i == manager->nqueues) {
+			manager->mode = isc_taskmgrmode_normal;
+#ifdef USE_WORKER_THREADS
+			broadcast_queues(manager);
 #endif /* USE_WORKER_THREADS */
+		}
+	}
+	unlock_queues(manager);
+	UNLOCK(&manager->lock);
+}
+
+/*
+ * Run the events of 'task', which the caller has dequeued from a ready
+ * queue, until it has none left or its quantum has expired.  The number
+ * of events run is added to '*dispatched'.
+ *
+ * Returns ISC_TRUE if the task is still ready and must be requeued.
+ *
+ * Caller must not hold any lock.
+ */
+static isc_boolean_t
+task_run(isc__task_t *task, unsigned int *dispatched) {
+	unsigned int dispatch_count = 0;
+	isc_boolean_t done = ISC_FALSE;
+	isc_boolean_t requeue = ISC_FALSE;
+	isc_boolean_t finished = ISC_FALSE;
+	isc_event_t *event;
+
+	INSIST(VALID_TASK(task));
+
+	LOCK_COUNTED(&task->lock, task->manager,
+		     isc_taskstatscounter_tasklockwait);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	isc_stdtime_get(&task->now);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EXECUTE,
+					      "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)((isc_task_t *)task, event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		/*
+		 * Events sent without the task lock are run after those
+		 * already on the list.
+		 */
+		if (EMPTY(task->events))
+			(void)inbox_drain(task);
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			isc_boolean_t was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events) && inbox_pending(task)) {
+			/*
+			 * A sender has yet to fill an inbox slot,
+			 * and there are events behind it.  Come
+			 * back for them rather than wait here.
+			 */
+			task->state = task_state_ready;
+			requeue = ISC_TRUE;
+			done = ISC_TRUE;
+		} else if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY,
+					      "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(isc_msgcat,
+						      ISC_MSGSET_TASK,
+						      ISC_MSG_DONE,
+						      "done"));
+				finished = ISC_TRUE;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = ISC_TRUE;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM,
+					      "quantum"));
+			task->state = task_state_ready;
+			requeue = ISC_TRUE;
+			done = ISC_TRUE;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	if (finished)
+		task_finished(task);
+
+	*dispatched += dispatch_count;
+
+	return (requeue);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Take a ready task from the queue of another worker and count it as
+ * running there.  Returns NULL if there is nothing to steal.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc__task_t *
+steal_task(isc__taskmgr_t *manager, isc__taskqueue_t *self,
+	   isc__taskqueue_t **runqueuep)
+{
+	isc__taskqueue_t *queue;
+	isc__task_t *task;
+	unsigned int i, first;
+
+	first = self - manager->queues;
+	for (i = 1; i < manager->nqueues; i++) {
+		queue = &manager->queues[(first + i) % manager->nqueues];
+		/* Unlocked peek; rechecked below. */
+		if (EMPTY(queue->ready_tasks))
+			continue;
+		LOCK(&queue->lock);
+		if (!BLOCKED(manager)) {
+			task = pop_readyq(manager, queue);
+			if (task != NULL) {
+				queue->tasks_running++;
+				UNLOCK(&queue->lock);
+				*runqueuep = queue;
+				return (task);
+			}
+		}
+		UNLOCK(&queue->lock);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Wait until there is a task this worker may run, and count it as
+ * running on the queue it was taken from, '*runqueuep'.  Returns NULL
+ * once the manager has finished.
+ *
+ * Caller must hold the lock of 'queue', the worker's own queue; it is
+ * held again on return.
+ */
+static isc__task_t *
+next_task(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	  isc__taskqueue_t **runqueuep)
+{
+	isc_boolean_t stole = ISC_FALSE, checked = ISC_FALSE;
+	isc__task_t *task;
+
+	/*
+	 * For reasons similar to those given in the comment in
+	 * isc_task_send() above, it is safe for us to dequeue
+	 * the task while only holding the queue lock, and then
+	 * change the task to running state while only holding the
+	 * task lock.
+	 *
+	 * If a pause or exclusive access has been requested, don't do
+	 * any work until it's been released.
+	 *
+	 * Whenever the queue lock has been dropped, start over so that
+	 * nothing made ready in the meantime is slept on.
+	 */
+	while (!manager->finished) {
+		if (!BLOCKED(manager)) {
+			task = pop_readyq(manager, queue);
+			if (task != NULL) {
+				queue->tasks_running++;
+				*runqueuep = queue;
+				return (task);
+			}
+			if (manager->nqueues > 1 && !stole) {
+				UNLOCK(&queue->lock);
+				task = steal_task(manager, queue, runqueuep);
+				LOCK(&queue->lock);
+				if (task != NULL)
+					return (task);
+				stole = ISC_TRUE;
+				continue;
+			}
+			/*
+			 * If we are in privileged execution mode and
+			 * there are no tasks remaining on the current
+			 * ready queues, then we may be stuck.
+			 * Automatically drop privileges if nothing is
+			 * running, and continue with the regular ready
+			 * queues.
+			 */
+			if (manager->mode == isc_taskmgrmode_privileged &&
+			    !checked) {
+				UNLOCK(&queue->lock);
+				check_privileged(manager);
+				LOCK(&queue->lock);
+				checked = ISC_TRUE;
+				continue;
+			}
+		}
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+					    ISC_MSG_WAIT, "wait"));
+		queue->idle_workers++;
+		WAIT(&queue->work_available, &queue->lock);
+		queue->idle_workers--;
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_AWAKE, "awake"));
+		stole = ISC_FALSE;
+		checked = ISC_FALSE;
+	}
+
+	return (NULL);
+}
+
+static void
+dispatch(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__taskqueue_t *runqueue, *home;
+	isc__task_t *task;
+	isc_boolean_t requeue;
+	unsigned int dispatched = 0;
 
 	REQUIRE(VALID_MANAGER(manager));
 
@@ -992,7 +1714,7 @@ dispatch(isc__taskmgr_t *manager) {
 	 * Again we're trying to hold the lock for as short a time as possible
 	 * and to do as little locking and unlocking as possible.
 	 *
-	 * In both while loops, the appropriate lock must be held before the
+	 * In the while loop, the queue lock must be held before the
 	 * while body starts.  Code which acquired the lock at the top of
 	 * the loop would be more readable, but would result in a lot of
 	 * extra locking.  Compare:
@@ -1038,183 +1760,42 @@ dispatch(isc__taskmgr_t *manager) {
 	 * unlocks.  The while expression is always protected by the lock.
 	 */
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_INIT(new_ready_tasks);
-	ISC_LIST_INIT(new_priority_tasks);
-#endif
-	LOCK(&manager->lock);
-
-	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
-		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
-		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
-		}
-#else /* USE_WORKER_THREADS */
-		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
-			break;
-#endif /* USE_WORKER_THREADS */
+	LOCK(&queue->lock);
+	while ((task = next_task(manager, queue, &runqueue)) != NULL) {
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
+		/*
+		 * Note we only unlock the queue lock if we actually
+		 * have a task to do.
+		 */
+		UNLOCK(&queue->lock);
 
-		task = pop_readyq(manager);
-		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			isc_boolean_t done = ISC_FALSE;
-			isc_boolean_t requeue = ISC_FALSE;
-			isc_boolean_t finished = ISC_FALSE;
-			isc_event_t *event;
-
-			INSIST(VALID_TASK(task));
-
-			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
-			 */
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			isc_stdtime_get(&task->now);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					isc_boolean_t was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = ISC_TRUE;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = ISC_TRUE;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = ISC_TRUE;
-					done = ISC_TRUE;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
-
-			if (finished)
-				task_finished(task);
-
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
+		/*
+		 * The task may be freed by task_run().
+		 */
+		home = &manager->queues[task->queue];
+		task->runqueue = runqueue - manager->queues;
+		requeue = task_run(task, &dispatched);
+
+		LOCK_COUNTED(&runqueue->lock, manager,
+			     isc_taskstatscounter_queuelockwait);
+		runqueue->tasks_running--;
+		if (BLOCKED(manager))
+			BROADCAST(&runqueue->drained);
+		if (runqueue != home) {
+			UNLOCK(&runqueue->lock);
+			if (requeue) {
+				/*
+				 * The task was stolen; give it back to its
+				 * own queue, whose workers may be asleep.
+				 */
+				LOCK(&home->lock);
+				push_readyq(manager, task);
+				SIGNAL(&home->work_available);
+				UNLOCK(&home->lock);
 			}
-#endif /* USE_WORKER_THREADS */
+			LOCK(&queue->lock);
+		} else {
 			if (requeue) {
 				/*
 				 * We know we're awake, so we don't have
@@ -1222,68 +1803,36 @@ dispatch(isc__taskmgr_t *manager) {
 				 * ready queue is empty before we requeue.
 				 *
 				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * empty is to run the task again at once,
+				 * avoiding the ENQUEUE of the task and the
+				 * subsequent immediate DEQUEUE (since it is
+				 * the only executable task).  We don't do
+				 * this because then we'd be skipping the
+				 * exit_requested check.  The cost of
+				 * ENQUEUE is low anyway.
 				 */
-#ifdef USE_WORKER_THREADS
 				push_readyq(manager, task);
-#else
-				ENQUEUE(new_ready_tasks, task, ready_link);
-				if ((task->flags & TASK_F_PRIVILEGED) != 0)
-					ENQUEUE(new_priority_tasks, task,
-						ready_priority_link);
-#endif
+			}
+			if (runqueue != queue) {
+				UNLOCK(&runqueue->lock);
+				LOCK(&queue->lock);
 			}
 		}
-
-#ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
-		}
-#endif
 	}
-
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
-			    ready_priority_link);
-	if (empty_readyq(manager))
-		manager->mode = isc_taskmgrmode_normal;
-#endif
-
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
-#ifdef USE_WORKER_THREADS
 static isc_threadresult_t
 #ifdef _WIN32
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1294,18 +1843,136 @@ run(void *uap) {
 
 	return ((isc_threadresult_t)0);
 }
+#else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue = &manager->queues[0];
+	isc__task_t *task;
+	isc_boolean_t requeue;
+	unsigned int total_dispatch_count = 0;
+	isc__tasklist_t new_ready_tasks;
+	isc__tasklist_t new_priority_tasks;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	ISC_LIST_INIT(new_ready_tasks);
+	ISC_LIST_INIT(new_priority_tasks);
+	LOCK(&queue->lock);
+
+	while (!manager->finished) {
+		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
+		    empty_readyq(manager, queue))
+			break;
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+
+		task = pop_readyq(manager, queue);
+		if (task != NULL) {
+			/*
+			 * Note we only unlock the queue lock if we actually
+			 * have a task to do.  We must reacquire the queue
+			 * lock before exiting the 'if (task != NULL)' block.
+			 */
+			queue->tasks_running++;
+			UNLOCK(&queue->lock);
+
+			requeue = task_run(task, &total_dispatch_count);
+
+			LOCK(&queue->lock);
+			queue->tasks_running--;
+			if (requeue) {
+				ENQUEUE(new_ready_tasks, task, ready_link);
+				if ((task->flags & TASK_F_PRIVILEGED) != 0)
+					ENQUEUE(new_priority_tasks, task,
+						ready_priority_link);
+			}
+		}
+	}
+
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
+			    ready_priority_link);
+	UNLOCK(&queue->lock);
+
+	check_privileged(manager);
+}
+#endif /* USE_WORKER_THREADS */
+
+static void
+queues_free(isc_mem_t *mctx, isc__taskqueue_t *queues, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+#ifdef USE_WORKER_THREADS
+		(void)isc_condition_destroy(&queues[i].drained);
+		(void)isc_condition_destroy(&queues[i].work_available);
 #endif /* USE_WORKER_THREADS */
+		DESTROYLOCK(&queues[i].lock);
+	}
+	isc_mem_put(mctx, queues, n * sizeof(isc__taskqueue_t));
+}
+
+static isc_result_t
+queues_create(isc__taskmgr_t *manager, isc_mem_t *mctx, unsigned int n) {
+	isc__taskqueue_t *queues, *queue;
+	isc_result_t result;
+	unsigned int i;
+
+	queues = isc_mem_get(mctx, n * sizeof(isc__taskqueue_t));
+	if (queues == NULL)
+		return (ISC_R_NOMEMORY);
+
+	for (i = 0; i < n; i++) {
+		queue = &queues[i];
+		queue->manager = manager;
+		INIT_LIST(queue->ready_tasks);
+		INIT_LIST(queue->ready_priority_tasks);
+		queue->tasks_running = 0;
+		result = isc_mutex_init(&queue->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+#ifdef USE_WORKER_THREADS
+		queue->idle_workers = 0;
+		if (isc_condition_init(&queue->work_available) !=
+		    ISC_R_SUCCESS) {
+			DESTROYLOCK(&queue->lock);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+		if (isc_condition_init(&queue->drained) != ISC_R_SUCCESS) {
+			(void)isc_condition_destroy(&queue->work_available);
+			DESTROYLOCK(&queue->lock);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+#endif /* USE_WORKER_THREADS */
+	}
+
+	manager->queues = queues;
+	manager->nqueues = n;
+	manager->maxqueues = n;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (result == ISC_R_UNEXPECTED)
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	queues_free(mctx, queues, i);
+	return (result);
+}
 
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
 
 #ifdef USE_WORKER_THREADS
-	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
-	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
+	queues_free(manager->mctx, manager->queues, manager->maxqueues);
+	if (manager->stats != NULL)
+		isc_stats_detach(&manager->stats);
 	DESTROYLOCK(&manager->lock);
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
@@ -1321,9 +1988,19 @@ manager_free(isc__taskmgr_t *manager) {
 ISC_TASKFUNC_SCOPE isc_result_t
 isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		    unsigned int default_quantum, isc_taskmgr_t **managerp)
+{
+	return (isc__taskmgr_create2(mctx, workers, default_quantum, 0,
+				     managerp));
+}
+
+ISC_TASKFUNC_SCOPE isc_result_t
+isc__taskmgr_create2(isc_mem_t *mctx, unsigned int workers,
+		     unsigned int default_quantum, unsigned int options,
+		     isc_taskmgr_t **managerp)
 {
 	isc_result_t result;
 	unsigned int i, started = 0;
+	unsigned int nqueues = 1;
 	isc__taskmgr_t *manager;
 
 	/*
@@ -1336,6 +2013,10 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifndef USE_WORKER_THREADS
 	UNUSED(i);
 	UNUSED(started);
+	UNUSED(options);
+#else
+	if ((options & ISC_TASKMGR_PERWORKER) != 0)
+		nqueues = workers;
 #endif
 
 #ifdef USE_SHARED_MANAGER
@@ -1356,53 +2037,33 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	manager->common.magic = ISCAPI_TASKMGR_MAGIC;
 	manager->mode = isc_taskmgrmode_normal;
 	manager->mctx = NULL;
+	manager->stats = NULL;
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_mgr;
 
+	result = queues_create(manager, mctx, nqueues);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+
 #ifdef USE_WORKER_THREADS
 	manager->workers = 0;
 	manager->threads = isc_mem_allocate(mctx,
 					    workers * sizeof(isc_thread_t));
 	if (manager->threads == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
-	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_threads;
-	}
-	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
-	}
-	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_exclusivegranted;
+		goto cleanup_queues;
 	}
 #endif /* USE_WORKER_THREADS */
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
+	manager->nextqueue = 0;
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
+	manager->finished = ISC_FALSE;
 	manager->excl = NULL;
 
 	isc_mem_attach(mctx, &manager->mctx);
@@ -1410,16 +2071,22 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Worker 'n' serves queue 'n % nqueues'.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run,
+				      &manager->queues[started % nqueues],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			manager->workers++;
 			started++;
 		}
 	}
+	/*
+	 * Don't hand out queues that no worker serves.
+	 */
+	if (started < manager->nqueues)
+		manager->nqueues = started;
 	UNLOCK(&manager->lock);
 
 	if (started == 0) {
@@ -1438,15 +2105,11 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	return (ISC_R_SUCCESS);
 
 #ifdef USE_WORKER_THREADS
- cleanup_exclusivegranted:
-	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
- cleanup_threads:
-	isc_mem_free(mctx, manager->threads);
+ cleanup_queues:
+	queues_free(mctx, manager->queues, manager->maxqueues);
+#endif
  cleanup_lock:
 	DESTROYLOCK(&manager->lock);
-#endif
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1455,6 +2118,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 ISC_TASKFUNC_SCOPE void
 isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	isc__taskmgr_t *manager;
+	isc__taskqueue_t *queue;
 	isc__task_t *task;
 	unsigned int i;
 
@@ -1508,12 +2172,16 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * Make sure we only get called once.
 	 */
 	INSIST(!manager->exiting);
+	lock_queues(manager);
 	manager->exiting = ISC_TRUE;
+	if (FINISHED(manager))
+		manager->finished = ISC_TRUE;
 
 	/*
 	 * If privileged mode was on, turn it off.
 	 */
 	manager->mode = isc_taskmgrmode_normal;
+	unlock_queues(manager);
 
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
@@ -1523,17 +2191,23 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
+		if (task_shutdown(task)) {
+			queue = &manager->queues[task->queue];
+			LOCK(&queue->lock);
 			push_readyq(manager, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
 #ifdef USE_WORKER_THREADS
 	/*
 	 * Wake up any sleeping workers.  This ensures we get work done if
 	 * there's work left to do, and if there are already no tasks left
-	 * it will cause the workers to see manager->exiting.
+	 * it will cause the workers to see manager->finished.
 	 */
-	BROADCAST(&manager->work_available);
+	lock_queues(manager);
+	broadcast_queues(manager);
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1568,7 +2242,13 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	manager->mode = mode;
+#ifdef USE_WORKER_THREADS
+	if (mode == isc_taskmgrmode_normal)
+		broadcast_queues(manager);
+#endif /* USE_WORKER_THREADS */
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 }
 
@@ -1582,6 +2262,17 @@ isc__taskmgr_mode(isc_taskmgr_t *manager0) {
 	return (mode);
 }
 
+ISC_TASKFUNC_SCOPE void
+isc__taskmgr_setstats(isc_taskmgr_t *manager0, isc_stats_t *stats) {
+	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(manager->stats == NULL);
+	REQUIRE(isc_stats_ncounters(stats) == isc_taskstatscounter_max);
+
+	isc_stats_attach(stats, &manager->stats);
+}
+
 #ifndef USE_WORKER_THREADS
 isc_boolean_t
 isc__taskmgr_ready(isc_taskmgr_t *manager0) {
@@ -1595,9 +2286,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_FALSE);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(manager, &manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1619,15 +2310,41 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 }
 
 #else
+/*
+ * Wait until no task is running, except for the caller's own task if
+ * 'self' is set; that one was taken from queue 'selfqueue'.
+ *
+ * Caller must have set pause_requested or exclusive_requested, so that
+ * workers take no new tasks, and must not hold any queue lock.
+ */
+static void
+wait_drained(isc__taskmgr_t *manager, isc_boolean_t self,
+	     unsigned int selfqueue)
+{
+	isc__taskqueue_t *queue;
+	unsigned int i, running;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		running = (self && i == selfqueue) ? 1 : 0;
+		LOCK(&queue->lock);
+		while (queue->tasks_running > running)
+			WAIT(&queue->drained, &queue->lock);
+		UNLOCK(&queue->lock);
+	}
+}
+
 ISC_TASKFUNC_SCOPE void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
-		WAIT(&manager->paused, &manager->lock);
-	}
+	lock_queues(manager);
 	manager->pause_requested = ISC_TRUE;
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
+
+	wait_drained(manager, ISC_FALSE, 0);
 }
 
 ISC_TASKFUNC_SCOPE void
@@ -1635,10 +2352,12 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
+		broadcast_queues(manager);
 	}
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 }
 #endif /* USE_WORKER_THREADS */
@@ -1679,15 +2398,20 @@ isc__task_beginexclusive(isc_task_t *task0) {
 	/* XXX: Require task == manager->excl? */
 
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	if (manager->exclusive_requested) {
+		unlock_queues(manager);
 		UNLOCK(&manager->lock);
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
-	while (manager->tasks_running > 1) {
-		WAIT(&manager->exclusive_granted, &manager->lock);
-	}
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
+
+	/*
+	 * Wait for every running task but this one to finish.
+	 */
+	wait_drained(manager, ISC_TRUE, task->runqueue);
 #else
 	UNUSED(task0);
 #endif
@@ -1702,9 +2426,11 @@ isc__task_endexclusive(isc_task_t *task0) {
 
 	REQUIRE(task->state == task_state_running);
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
+	broadcast_queues(manager);
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1715,6 +2441,7 @@ ISC_TASKFUNC_SCOPE void
 isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue = &manager->queues[task->queue];
 	isc_boolean_t oldpriv;
 
 	LOCK(&task->lock);
@@ -1728,14 +2455,14 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 ISC_TASKFUNC_SCOPE isc_boolean_t
@@ -1771,9 +2498,15 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int i, tasks_running = 0;
 	int xmlrc;
 
 	LOCK(&mgr->lock);
+	for (i = 0; i < mgr->nqueues; i++) {
+		LOCK(&mgr->queues[i].lock);
+		tasks_running += mgr->queues[i].tasks_running;
+		UNLOCK(&mgr->queues[i].lock);
+	}
 
 	/*
 	 * Write out the thread-model, and some details about each depending
@@ -1804,7 +2537,7 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#include <atf-c.h>
+
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/result.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#define NBLOCKS		1000
+#define NTHREADS	4
+
+static isc_mem_t *tmctx = NULL;
+static isc_mempool_t *tmpool = NULL;
+static void *blocks[NTHREADS][NBLOCKS];
+
+static size_t
+blocksize(unsigned int i) {
+	return ((i * 7) % 600 + 1);
+}
+
+/*
+ * Allocate and free blocks of many sizes, more of each than a
+ * thread's cache holds, and check the contents survive.
+ */
+static void
+churn(void **b) {
+	unsigned int i, pass;
+
+	for (pass = 0; pass < 3; pass++) {
+		for (i = 0; i < NBLOCKS; i++) {
+			b[i] = isc_mem_get(tmctx, blocksize(i));
+			ATF_REQUIRE(b[i] != NULL);
+			memset(b[i], i & 0xff, blocksize(i));
+		}
+		for (i = 0; i < NBLOCKS; i++) {
+			unsigned char *cp = b[i];
+
+			ATF_CHECK_EQ(cp[blocksize(i) - 1], i & 0xff);
+			isc_mem_put(tmctx, b[i], blocksize(i));
+		}
+	}
+}
+
+ATF_TC(get_put);
+ATF_TC_HEAD(get_put, tc) {
+	atf_tc_set_md_var(tc, "descr", "memory contexts with and without "
+			  "per-thread caches balance their books");
+}
+ATF_TC_BODY(get_put, tc) {
+	isc_result_t result;
+	unsigned int flags[] = { ISC_MEMFLAG_DEFAULT,
+				 ISC_MEMFLAG_DEFAULT | ISC_MEMFLAG_NOCACHE,
+				 0 };
+	unsigned int i;
+
+	UNUSED(tc);
+
+	for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+		result = isc_mem_create2(0, 0, &tmctx, flags[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		churn(blocks[0]);
+		if ((flags[i] & ISC_MEMFLAG_NOCACHE) != 0)
+			ATF_CHECK_EQ(isc_mem_inuse(tmctx), 0);
+#if defined(ISC_PLATFORM_USETHREADS) && ISC_MEM_THREADCACHE
+		else
+			ATF_CHECK(isc_mem_inuse(tmctx) != 0);
+#endif
+
+		/*
+		 * Destroying the context returns the cached blocks; it
+		 * would fail an assertion if any were unaccounted for.
+		 */
+		isc_mem_destroy(&tmctx);
+	}
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+mem_thread(isc_threadarg_t arg) {
+	void **b = arg;
+	unsigned int i;
+
+	/*
+	 * Free the blocks another thread allocated, then exercise
+	 * our own cache.
+	 */
+	for (i = 0; i < NBLOCKS; i++)
+		isc_mem_put(tmctx, b[i], blocksize(i));
+	churn(b);
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(threads);
+ATF_TC_HEAD(threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "per-thread caches are returned to "
+			  "the memory context when their threads exit");
+}
+ATF_TC_BODY(threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++)
+		for (j = 0; j < NBLOCKS; j++) {
+			blocks[i][j] = isc_mem_get(tmctx, blocksize(j));
+			ATF_REQUIRE(blocks[i][j] != NULL);
+		}
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(mem_thread, blocks[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	/*
+	 * Only this thread's cache may still hold blocks.
+	 */
+	ATF_CHECK(isc_mem_inuse(tmctx) <= 256 * 1024);
+
+	isc_mem_destroy(&tmctx);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+pool_thread(isc_threadarg_t arg) {
+	void **b = arg;
+	unsigned int i, pass;
+
+	for (pass = 0; pass < 3; pass++) {
+		for (i = 0; i < NBLOCKS; i++) {
+			b[i] = isc_mempool_get(tmpool);
+			ATF_REQUIRE(b[i] != NULL);
+		}
+		for (i = 0; i < NBLOCKS; i++)
+			isc_mempool_put(tmpool, b[i]);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(pool_threads);
+ATF_TC_HEAD(pool_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "locked memory pools with per-thread "
+			  "caches");
+}
+ATF_TC_BODY(pool_threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	isc_mutex_t lock;
+	unsigned int i;
+	void *item;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mempool_create(tmctx, 48, &tmpool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mempool_associatelock(tmpool, &lock);
+	isc_mempool_setfreemax(tmpool, 100);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(pool_thread, blocks[i],
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	ATF_CHECK_EQ(isc_mempool_getallocated(tmpool), 0);
+	ATF_CHECK(isc_mempool_getfreecount(tmpool) <= 100);
+
+	/*
+	 * With an allocation limit, puts bypass the caches.
+	 */
+	isc_mempool_setmaxalloc(tmpool, 10);
+	for (i = 0; i < 10; i++) {
+		blocks[0][i] = isc_mempool_get(tmpool);
+		ATF_REQUIRE(blocks[0][i] != NULL);
+	}
+	ATF_CHECK(isc_mempool_get(tmpool) == NULL);
+	for (i = 0; i < 10; i++)
+		isc_mempool_put(tmpool, blocks[0][i]);
+	ATF_CHECK_EQ(isc_mempool_getallocated(tmpool), 0);
+
+	/*
+	 * Leave an item in this thread's cache; destroying the pool
+	 * must take it back.
+	 */
+	isc_mempool_setmaxalloc(tmpool, UINT_MAX);
+	item = isc_mempool_get(tmpool);
+	ATF_REQUIRE(item != NULL);
+	isc_mempool_put(tmpool, item);
+	ATF_CHECK_EQ(isc_mempool_getallocated(tmpool), 1);
+
+	isc_mempool_destroy(&tmpool);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&tmctx);
+}
+#endif
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, get_put);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, threads);
+	ATF_TP_ADD_TC(tp, pool_threads);
+#endif
+	return (atf_no_error());
+}
@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include <isc/socket.h>
+#include <isc/stats.h>
 
 #include "../task_p.h"
 #include "isctest.h"
@@ -243,12 +244,368 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test UDP sockets sharing a port with SO_REUSEPORT */
+ATF_TC(udp_reuseport);
+ATF_TC_HEAD(udp_reuseport, tc) {
+	atf_tc_set_md_var(tc, "descr", "SO_REUSEPORT sendto/recv");
+}
+ATF_TC_BODY(udp_reuseport, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL, *s4 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf2[BUFSIZ], recvbuf3[BUFSIZ];
+	completion_t completion, completion2, completion3;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Create a sender on 127.0.0.1/5444 and two receivers sharing
+	 * 127.0.0.1/5445.
+	 */
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 5444);
+	isc_sockaddr_fromin(&addr2, &in, 5445);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_socket_detach(&s2);
+		isc_test_end();
+		atf_tc_skip("SO_REUSEPORT not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s3, &addr2, ISC_SOCKET_REUSEPORT);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A socket that does not ask for SO_REUSEPORT may not join.
+	 */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s4, &addr2, 0);
+	ATF_CHECK_EQ(result, ISC_R_ADDRINUSE);
+	isc_socket_detach(&s4);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(recvbuf2, 0, sizeof(recvbuf2));
+	r.base = (void *) recvbuf2;
+	r.length = BUFSIZ;
+	completion_init(&completion2);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	memset(recvbuf3, 0, sizeof(recvbuf3));
+	r.base = (void *) recvbuf3;
+	r.length = BUFSIZ;
+	completion_init(&completion3);
+	result = isc_socket_recv(s3, &r, 1, task, event_done, &completion3);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	strcpy(sendbuf, "Hello");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+
+	completion_init(&completion);
+	result = isc_socket_sendto(s1, &r, task, event_done, &completion,
+				   &addr2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+
+	/*
+	 * The kernel hands the datagram to exactly one of the receivers.
+	 */
+	for (i = 0; i < 5000 && !completion2.done && !completion3.done; i++) {
+#ifndef ISC_PLATFORM_USETHREADS
+		while (isc__taskmgr_ready(taskmgr))
+			isc__taskmgr_dispatch(taskmgr);
+#endif
+		isc_test_nap(1000);
+	}
+	ATF_CHECK(completion2.done != completion3.done);
+	if (completion2.done) {
+		ATF_CHECK_EQ(completion2.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf2, "Hello");
+	} else {
+		ATF_CHECK_EQ(completion3.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf3, "Hello");
+	}
+
+	isc_socket_cancel(s2, task, ISC_SOCKCANCEL_RECV);
+	isc_socket_cancel(s3, task, ISC_SOCKCANCEL_RECV);
+	waitfor(&completion2);
+	waitfor(&completion3);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+
+	isc_test_end();
+}
+
+/* Test batched UDP receive */
+#define NBATCH 8
+
+static void
+stats_getvalue(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched UDP recv");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_stats_t *stats = NULL;
+	isc_uint64_t values[isc_sockstatscounter_max];
+	char sendbuf[BUFSIZ], recvbuf[NBATCH][BUFSIZ];
+	completion_t completion[NBATCH];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc__socketmgr_setudpbatch(socketmgr, NBATCH);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_test_end();
+		atf_tc_skip("batched UDP I/O not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, isc_sockstatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_socketmgr_setstats(socketmgr, stats);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 5444);
+	isc_sockaddr_fromin(&addr2, &in, 5445);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queue the receives first so that they are waiting on the
+	 * socket when the datagrams arrive.
+	 */
+	for (i = 0; i < NBATCH; i++) {
+		memset(recvbuf[i], 0, sizeof(recvbuf[i]));
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < NBATCH; i++) {
+		completion_t sent;
+
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&sent);
+		result = isc_socket_sendto(s1, &r, task, event_done, &sent,
+					   &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&sent);
+		ATF_CHECK(sent.done);
+		ATF_CHECK_EQ(sent.result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Receives complete in queue order, whether or not they were
+	 * batched.
+	 */
+	for (i = 0; i < NBATCH; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf);
+	}
+
+	/*
+	 * At least the first readiness event found several receives
+	 * queued, so it must have been handled by a batched call.
+	 */
+	memset(values, 0, sizeof(values));
+	isc_stats_dump(stats, stats_getvalue, values, 0);
+	ATF_CHECK(values[isc_sockstatscounter_udp4recvbatch] >= 1);
+	ATF_CHECK(values[isc_sockstatscounter_udp4recvbatchpkts] >=
+		  values[isc_sockstatscounter_udp4recvbatch]);
+	ATF_CHECK(values[isc_sockstatscounter_udp4recvbatchpkts] <= NBATCH);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_stats_detach(&stats);
+
+	isc_test_end();
+}
+
+/* Test UDP sendto/recv with several watcher threads */
+#define NWATCHSOCK 8
+
+static void
+watchers_roundtrip(isc_socketmgr_t *mgr, in_port_t port) {
+	isc_result_t result;
+	isc_sockaddr_t addr[NWATCHSOCK];
+	struct in_addr in;
+	isc_socket_t *s[NWATCHSOCK];
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[NWATCHSOCK][BUFSIZ];
+	completion_t completion, rcompletion[NWATCHSOCK];
+	isc_region_t r;
+	int i;
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The sockets get consecutive descriptors and so are spread over
+	 * all of the watchers.
+	 */
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < NWATCHSOCK; i++) {
+		isc_sockaddr_fromin(&addr[i], &in, port + i);
+		s[i] = NULL;
+		result = isc_socket_create(mgr, PF_INET, isc_sockettype_udp,
+					   &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i],
+					 ISC_SOCKET_REUSEADDRESS);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		memset(recvbuf[i], 0, sizeof(recvbuf[i]));
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&rcompletion[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &rcompletion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Each socket sends to its neighbour.
+	 */
+	for (i = 0; i < NWATCHSOCK; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&completion);
+		result = isc_socket_sendto(s[i], &r, task, event_done,
+					   &completion,
+					   &addr[(i + 1) % NWATCHSOCK], NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < NWATCHSOCK; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d",
+			 (i + NWATCHSOCK - 1) % NWATCHSOCK);
+		waitfor(&rcompletion[i]);
+		ATF_CHECK(rcompletion[i].done);
+		ATF_CHECK_EQ(rcompletion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf);
+	}
+
+	/*
+	 * The watchers cannot be replaced while sockets are open.
+	 */
+	result = isc__socketmgr_setnthreads(mgr, 3);
+	ATF_CHECK(result == ISC_R_EXISTS || result == ISC_R_NOTIMPLEMENTED);
+
+	isc_task_detach(&task);
+	for (i = 0; i < NWATCHSOCK; i++)
+		isc_socket_detach(&s[i]);
+}
+
+ATF_TC(udp_watchers);
+ATF_TC_HEAD(udp_watchers, tc) {
+	atf_tc_set_md_var(tc, "descr", "sendto/recv with several watchers");
+}
+ATF_TC_BODY(udp_watchers, tc) {
+	isc_result_t result;
+	isc_socketmgr_t *mgr = NULL;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socketmgr_create2(mctx, &mgr, 0, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	watchers_roundtrip(mgr, 5450);
+
+	/*
+	 * Once the sockets are gone the number of watchers can change.
+	 */
+	result = isc__socketmgr_setnthreads(mgr, 2);
+	ATF_CHECK(result == ISC_R_SUCCESS || result == ISC_R_NOTIMPLEMENTED);
+
+	watchers_roundtrip(mgr, 5460);
+
+	isc_socketmgr_destroy(&mgr);
+
+	isc_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_reuseport);
+	ATF_TP_ADD_TC(tp, udp_batch);
+	ATF_TP_ADD_TC(tp, udp_watchers);
 
 	return (atf_no_error());
 }
@@ -24,7 +24,10 @@
 
 #include <unistd.h>
 
+#include <isc/stats.h>
+#include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include "../task_p.h"
@@ -402,6 +405,646 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/*
+ * Task manager with a ready queue per worker
+ */
+#define PW_WORKERS	4
+#define PW_TASKS	16
+#define PW_EVENTS	200
+
+typedef struct pw_event {
+	ISC_EVENT_COMMON(struct pw_event);
+	int seq;
+} pw_event_t;
+
+typedef struct {
+	int seen;
+	isc_boolean_t inorder;
+} pw_state_t;
+
+int running = 0;
+isc_boolean_t exclusive = ISC_FALSE;
+int violations = 0;
+
+isc_taskmgr_t *pwmgr = NULL;
+
+static void
+pw_begin(void) {
+	isc_result_t result;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_taskmgr_create2(mctx, PW_WORKERS, 0,
+				     ISC_TASKMGR_PERWORKER, &pwmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+pw_end(void) {
+	isc_taskmgr_destroy(&pwmgr);
+	isc_test_end();
+}
+
+static void
+wait_counter(int n) {
+	int i = 0;
+
+	while (counter < n && i++ < 5000) {
+#ifndef ISC_PLATFORM_USETHREADS
+		while (isc__taskmgr_ready(pwmgr))
+			isc__taskmgr_dispatch(pwmgr);
+#endif
+		isc_test_nap(1000);
+	}
+}
+
+static void
+pw_count(isc_task_t *task, isc_event_t *event) {
+	pw_state_t *state = event->ev_arg;
+	int seq = ((pw_event_t *)event)->seq;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	if (seq != state->seen)
+		state->inorder = ISC_FALSE;
+	state->seen++;
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+ATF_TC(perworker_events);
+ATF_TC_HEAD(perworker_events, tc) {
+	atf_tc_set_md_var(tc, "descr", "process events with a ready queue "
+			  "per worker");
+}
+ATF_TC_BODY(perworker_events, tc) {
+	isc_result_t result;
+	isc_task_t *tasks[PW_TASKS];
+	pw_state_t state[PW_TASKS];
+	isc_event_t *event;
+	int i, j;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+	for (i = 0; i < PW_TASKS; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(pwmgr, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		state[i].seen = 0;
+		state[i].inorder = ISC_TRUE;
+	}
+
+	/*
+	 * Events are sent to all tasks in turn, so every queue has work
+	 * and idle workers steal from the others.
+	 */
+	for (j = 0; j < PW_EVENTS; j++) {
+		for (i = 0; i < PW_TASKS; i++) {
+			event = isc_event_allocate(mctx, tasks[i],
+						   ISC_TASKEVENT_TEST,
+						   pw_count, &state[i],
+						   sizeof(pw_event_t));
+			ATF_REQUIRE(event != NULL);
+			((pw_event_t *)event)->seq = j;
+			isc_task_send(tasks[i], &event);
+		}
+	}
+
+	wait_counter(PW_TASKS * PW_EVENTS);
+	ATF_CHECK_EQ(counter, PW_TASKS * PW_EVENTS);
+
+	/*
+	 * A task never runs on two workers at once, so its events are
+	 * run in order wherever it runs.
+	 */
+	for (i = 0; i < PW_TASKS; i++) {
+		ATF_CHECK_EQ(state[i].seen, PW_EVENTS);
+		ATF_CHECK(state[i].inorder);
+		isc_task_destroy(&tasks[i]);
+	}
+
+	pw_end();
+}
+
+static void
+pw_work(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	if (exclusive)
+		violations++;
+	running++;
+	UNLOCK(&set_lock);
+	isc_test_nap(100);
+	LOCK(&set_lock);
+	running--;
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+static void
+pw_exclusive(isc_task_t *task, isc_event_t *event) {
+	isc_result_t result;
+	int *value = event->ev_arg;
+
+	isc_event_free(&event);
+	result = isc_task_beginexclusive(task);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	LOCK(&set_lock);
+	exclusive = ISC_TRUE;
+	*value = running;
+	UNLOCK(&set_lock);
+	isc_test_nap(10000);
+	LOCK(&set_lock);
+	exclusive = ISC_FALSE;
+	counter++;
+	UNLOCK(&set_lock);
+	isc_task_endexclusive(task);
+}
+
+ATF_TC(perworker_exclusive);
+ATF_TC_HEAD(perworker_exclusive, tc) {
+	atf_tc_set_md_var(tc, "descr", "exclusive mode with a ready queue "
+			  "per worker");
+}
+ATF_TC_BODY(perworker_exclusive, tc) {
+	isc_result_t result;
+	isc_task_t *tasks[PW_TASKS];
+	isc_event_t *event;
+	int others = -1;
+	int i, j, n = 0;
+
+	UNUSED(tc);
+
+	counter = 0;
+	running = 0;
+	violations = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+	for (i = 0; i < PW_TASKS; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(pwmgr, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (j = 0; j < 20; j++) {
+		for (i = 0; i < PW_TASKS; i++) {
+			if (j == 10 && i == 0)
+				event = isc_event_allocate(mctx, tasks[i],
+							   ISC_TASKEVENT_TEST,
+							   pw_exclusive,
+							   &others,
+							   sizeof(isc_event_t));
+			else
+				event = isc_event_allocate(mctx, tasks[i],
+							   ISC_TASKEVENT_TEST,
+							   pw_work, NULL,
+							   sizeof(isc_event_t));
+			ATF_REQUIRE(event != NULL);
+			isc_task_send(tasks[i], &event);
+			n++;
+		}
+	}
+
+	wait_counter(n);
+	ATF_CHECK_EQ(counter, n);
+
+	/*
+	 * Nothing else ran while the exclusive event did.
+	 */
+	ATF_CHECK_EQ(others, 0);
+	ATF_CHECK_EQ(violations, 0);
+
+	for (i = 0; i < PW_TASKS; i++)
+		isc_task_destroy(&tasks[i]);
+
+	pw_end();
+}
+
+ATF_TC(perworker_privileged);
+ATF_TC_HEAD(perworker_privileged, tc) {
+	atf_tc_set_md_var(tc, "descr", "privileged events with a ready "
+			  "queue per worker");
+}
+ATF_TC_BODY(perworker_privileged, tc) {
+	isc_result_t result;
+	isc_task_t *priv = NULL, *tasks[PW_TASKS];
+	isc_event_t *event;
+	int pvalue[3], value[PW_TASKS];
+	int i;
+
+	UNUSED(tc);
+
+	counter = 1;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+#ifdef ISC_PLATFORM_USETHREADS
+	isc__taskmgr_pause(pwmgr);
+#endif
+
+	/*
+	 * The normal tasks are spread over all of the queues.
+	 */
+	for (i = 0; i < PW_TASKS; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(pwmgr, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		value[i] = 0;
+		event = isc_event_allocate(mctx, tasks[i], ISC_TASKEVENT_TEST,
+					   set, &value[i],
+					   sizeof(isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(tasks[i], &event);
+	}
+
+	result = isc_task_create(pwmgr, 0, &priv);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_task_setprivilege(priv, ISC_TRUE);
+	for (i = 0; i < 3; i++) {
+		pvalue[i] = 0;
+		event = isc_event_allocate(mctx, priv, ISC_TASKEVENT_TEST,
+					   set, &pvalue[i],
+					   sizeof(isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(priv, &event);
+	}
+
+	isc_taskmgr_setmode(pwmgr, isc_taskmgrmode_privileged);
+	ATF_CHECK_EQ(isc_taskmgr_mode(pwmgr), isc_taskmgrmode_privileged);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	isc__taskmgr_resume(pwmgr);
+#endif
+
+	wait_counter(PW_TASKS + 4);
+	ATF_CHECK_EQ(counter, PW_TASKS + 4);
+
+	/*
+	 * The privileged events ran first.
+	 */
+	for (i = 0; i < 3; i++)
+		ATF_CHECK(pvalue[i] >= 1 && pvalue[i] <= 3);
+	for (i = 0; i < PW_TASKS; i++)
+		ATF_CHECK(value[i] > 3);
+
+	ATF_CHECK_EQ(isc_taskmgr_mode(pwmgr), isc_taskmgrmode_normal);
+
+	isc_task_destroy(&priv);
+	for (i = 0; i < PW_TASKS; i++)
+		isc_task_destroy(&tasks[i]);
+
+	pw_end();
+}
+
+/*
+ * Sending events
+ */
+#define SEND_SENDERS	4
+#define SEND_EVENTS	2000
+
+typedef struct {
+	isc_task_t *task;
+	pw_state_t state;
+} sender_t;
+
+static void
+get_stat(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+ATF_TC(send_batch);
+ATF_TC_HEAD(send_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "send a list of events at once");
+}
+ATF_TC_BODY(send_batch, tc) {
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_stats_t *stats = NULL;
+	isc_uint64_t values[isc_taskstatscounter_max];
+	isc_eventlist_t events;
+	isc_event_t *event;
+	pw_state_t state;
+	int i;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+	result = isc_stats_create(mctx, &stats, isc_taskstatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_taskmgr_setstats(pwmgr, stats);
+
+	result = isc_task_create(pwmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	state.seen = 0;
+	state.inorder = ISC_TRUE;
+	ISC_LIST_INIT(events);
+	for (i = 0; i < PW_EVENTS; i++) {
+		event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+					   pw_count, &state,
+					   sizeof(pw_event_t));
+		ATF_REQUIRE(event != NULL);
+		((pw_event_t *)event)->seq = i;
+		ISC_LIST_APPEND(events, event, ev_link);
+	}
+
+	isc_task_sendbatch(task, &events);
+	ATF_CHECK(ISC_LIST_EMPTY(events));
+
+	wait_counter(PW_EVENTS);
+	ATF_CHECK_EQ(counter, PW_EVENTS);
+	ATF_CHECK_EQ(state.seen, PW_EVENTS);
+	ATF_CHECK(state.inorder);
+
+	memset(values, 0, sizeof(values));
+	isc_stats_dump(stats, get_stat, values, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK_EQ(values[isc_taskstatscounter_sendbatch], 1);
+	ATF_CHECK_EQ(values[isc_taskstatscounter_sendbatchevents],
+		     PW_EVENTS);
+
+	isc_task_destroy(&task);
+	isc_stats_detach(&stats);
+
+	pw_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+send_events(void *arg) {
+	sender_t *sender = arg;
+	isc_event_t *event;
+	int i;
+
+	for (i = 0; i < SEND_EVENTS; i++) {
+		event = isc_event_allocate(mctx, sender->task,
+					   ISC_TASKEVENT_TEST, pw_count,
+					   &sender->state,
+					   sizeof(pw_event_t));
+		RUNTIME_CHECK(event != NULL);
+		((pw_event_t *)event)->seq = i;
+		isc_task_send(sender->task, &event);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+ATF_TC(send_concurrent);
+ATF_TC_HEAD(send_concurrent, tc) {
+	atf_tc_set_md_var(tc, "descr", "send events to a task from several "
+			  "threads at once");
+}
+ATF_TC_BODY(send_concurrent, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_thread_t threads[SEND_SENDERS];
+	sender_t senders[SEND_SENDERS];
+	int i;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+	result = isc_task_create(pwmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < SEND_SENDERS; i++) {
+		senders[i].task = task;
+		senders[i].state.seen = 0;
+		senders[i].state.inorder = ISC_TRUE;
+		result = isc_thread_create(send_events, &senders[i],
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < SEND_SENDERS; i++)
+		(void)isc_thread_join(threads[i], NULL);
+
+	wait_counter(SEND_SENDERS * SEND_EVENTS);
+	ATF_CHECK_EQ(counter, SEND_SENDERS * SEND_EVENTS);
+
+	/*
+	 * The events of each sender were run in the order it sent them.
+	 */
+	for (i = 0; i < SEND_SENDERS; i++) {
+		ATF_CHECK_EQ(senders[i].state.seen, SEND_EVENTS);
+		ATF_CHECK(senders[i].state.inorder);
+	}
+
+	isc_task_destroy(&task);
+
+	pw_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads required");
+#endif
+}
+
+ATF_TC(purge_sent);
+ATF_TC_HEAD(purge_sent, tc) {
+	atf_tc_set_md_var(tc, "descr", "purge events that have been sent "
+			  "but not run");
+}
+ATF_TC_BODY(purge_sent, tc) {
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_event_t *event;
+	pw_state_t state;
+	unsigned int purged;
+	int i;
+
+	UNUSED(tc);
+
+	counter = 0;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+#ifdef ISC_PLATFORM_USETHREADS
+	isc__taskmgr_pause(pwmgr);
+#endif
+
+	result = isc_task_create(pwmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	state.seen = 0;
+	state.inorder = ISC_TRUE;
+	for (i = 0; i < PW_EVENTS; i++) {
+		event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+					   pw_count, &state,
+					   sizeof(pw_event_t));
+		ATF_REQUIRE(event != NULL);
+		((pw_event_t *)event)->seq = i;
+		isc_task_send(task, &event);
+	}
+
+	/*
+	 * Every event sent is found, whether it is still in the task's
+	 * inbox or not.
+	 */
+	purged = isc_task_purge(task, NULL, ISC_TASKEVENT_TEST, NULL);
+	ATF_CHECK_EQ(purged, PW_EVENTS);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	isc__taskmgr_resume(pwmgr);
+#endif
+
+	isc_task_destroy(&task);
+	isc_test_nap(100000);
+	ATF_CHECK_EQ(counter, 0);
+	ATF_CHECK_EQ(state.seen, 0);
+
+	pw_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static unsigned int purged_total;
+static isc_boolean_t purge_stop;
+
+static void
+fill_count(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+fill_events(void *arg) {
+	isc_task_t *task = arg;
+	isc_event_t *event;
+	int i;
+
+	for (i = 0; i < SEND_EVENTS; i++) {
+		event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+					   fill_count, NULL,
+					   sizeof(isc_event_t));
+		RUNTIME_CHECK(event != NULL);
+		isc_task_send(task, &event);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+purge_events(void *arg) {
+	isc_task_t *task = arg;
+	unsigned int n;
+	isc_boolean_t stop = ISC_FALSE;
+	int i;
+
+	for (i = 0; !stop; i++) {
+		if ((i & 1) == 0)
+			n = isc_task_purge(task, NULL, ISC_TASKEVENT_TEST,
+					   NULL);
+		else
+			n = isc_task_purgerange(task, NULL,
+						ISC_TASKEVENT_TEST,
+						ISC_TASKEVENT_TEST, NULL);
+		LOCK(&set_lock);
+		purged_total += n;
+		stop = purge_stop;
+		UNLOCK(&set_lock);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+ATF_TC(purge_full);
+ATF_TC_HEAD(purge_full, tc) {
+	atf_tc_set_md_var(tc, "descr", "purge events while several threads "
+			  "keep the task's inbox full");
+}
+ATF_TC_BODY(purge_full, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_thread_t threads[SEND_SENDERS], purger;
+	int i;
+
+	UNUSED(tc);
+
+	counter = 0;
+	purged_total = 0;
+	purge_stop = ISC_FALSE;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	pw_begin();
+
+	result = isc_task_create(pwmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_thread_create(purge_events, task, &purger);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < SEND_SENDERS; i++) {
+		result = isc_thread_create(fill_events, task, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < SEND_SENDERS; i++)
+		(void)isc_thread_join(threads[i], NULL);
+
+	LOCK(&set_lock);
+	purge_stop = ISC_TRUE;
+	UNLOCK(&set_lock);
+	(void)isc_thread_join(purger, NULL);
+
+	/*
+	 * Every event sent was either purged or run, exactly once.
+	 */
+	wait_counter(SEND_SENDERS * SEND_EVENTS - purged_total);
+	ATF_CHECK_EQ(counter + purged_total, SEND_SENDERS * SEND_EVENTS);
+
+	isc_task_destroy(&task);
+
+	pw_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads required");
+#endif
+}
+
 /*
  * Main
  */
@@ -410,6 +1053,13 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, perworker_events);
+	ATF_TP_ADD_TC(tp, perworker_exclusive);
+	ATF_TP_ADD_TC(tp, perworker_privileged);
+	ATF_TP_ADD_TC(tp, send_batch);
+	ATF_TP_ADD_TC(tp, send_concurrent);
+	ATF_TP_ADD_TC(tp, purge_sent);
+	ATF_TP_ADD_TC(tp, purge_full);
 
 	return (atf_no_error());
 }
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/mutex.h>
+#include <isc/task.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NTIMERS		300
+
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Helper functions
+ */
+
+static isc_mutex_t lock;
+static int fired;
+static int early;
+static int ticks;
+static int lifes;
+static isc_time_t lastdue;
+
+static void
+count(isc_task_t *task, isc_event_t *event) {
+	isc_timerevent_t *tevent = (isc_timerevent_t *)event;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	TIME_NOW(&now);
+	LOCK(&lock);
+	if (isc_time_compare(&now, &tevent->due) < 0)
+		early++;
+	if (event->ev_type == ISC_TIMEREVENT_TICK) {
+		if (isc_time_compare(&tevent->due, &lastdue) <= 0)
+			early++;
+		lastdue = tevent->due;
+		ticks++;
+	} else if (event->ev_type == ISC_TIMEREVENT_LIFE)
+		lifes++;
+	fired++;
+	UNLOCK(&lock);
+	isc_event_free(&event);
+}
+
+static int
+getfired(void) {
+	int n;
+
+	LOCK(&lock);
+	n = fired;
+	UNLOCK(&lock);
+	return (n);
+}
+
+static void
+begin(unsigned int options, isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_result_t result;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timermgr_create2(mctx, options, managerp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_create(taskmgr, 0, taskp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	fired = early = ticks = lifes = 0;
+	isc_time_settoepoch(&lastdue);
+}
+
+static void
+end(isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_task_detach(taskp);
+	isc_timermgr_destroy(managerp);
+	DESTROYLOCK(&lock);
+	isc_test_end();
+}
+
+/*
+ * A ticker ticks in order, then stops when reset.
+ */
+static void
+ticker(unsigned int options) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *timer = NULL;
+	isc_interval_t interval;
+	isc_result_t result;
+	int i, n;
+
+	begin(options, &manager, &task);
+
+	isc_interval_set(&interval, 0, 20000000);
+	result = isc_timer_create(manager, isc_timertype_ticker, NULL,
+				  &interval, task, count, NULL, &timer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 5000 && getfired() < 5; i++)
+		isc_test_nap(1000);
+
+	result = isc_timer_reset(timer, isc_timertype_inactive, NULL, NULL,
+				 ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_test_nap(100000);
+	n = getfired();
+	isc_test_nap(100000);
+
+	LOCK(&lock);
+	ATF_CHECK(ticks >= 5);
+	ATF_CHECK_EQ(fired, n);
+	ATF_CHECK_EQ(early, 0);
+	UNLOCK(&lock);
+
+	isc_timer_detach(&timer);
+	end(&manager, &task);
+}
+
+/*
+ * Many once timers, some cancelled, expire exactly once each and
+ * never early.
+ */
+static void
+once(unsigned int options) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *timers[NTIMERS];
+	isc_interval_t interval;
+	isc_time_t expires, now;
+	isc_result_t result;
+	int i, expected = 0;
+
+	begin(options, &manager, &task);
+
+	TIME_NOW(&now);
+	for (i = 0; i < NTIMERS; i++) {
+		/*
+		 * Spread the timers over a few hundred milliseconds and
+		 * put some of them far enough out to land on the upper
+		 * wheels.
+		 */
+		if (i % 10 == 9)
+			isc_interval_set(&interval, 3600 * (i + 1), 0);
+		else
+			isc_interval_set(&interval, 0,
+					 ((i * 37) % 400 + 1) * 1000000);
+		result = isc_time_add(&now, &interval, &expires);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		timers[i] = NULL;
+		result = isc_timer_create(manager, isc_timertype_once,
+					  &expires, NULL, task, count, NULL,
+					  &timers[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		if (i % 10 != 9)
+			expected++;
+	}
+
+	/* Cancel a few of the near ones too. */
+	for (i = 0; i < NTIMERS; i += 50) {
+		result = isc_timer_reset(timers[i], isc_timertype_inactive,
+					 NULL, NULL, ISC_TRUE);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		expected--;
+	}
+
+	for (i = 0; i < 5000 && getfired() < expected; i++)
+		isc_test_nap(1000);
+	isc_test_nap(50000);
+
+	LOCK(&lock);
+	ATF_CHECK_EQ(fired, expected);
+	ATF_CHECK_EQ(lifes, expected);
+	ATF_CHECK_EQ(early, 0);
+	UNLOCK(&lock);
+
+	for (i = 0; i < NTIMERS; i++)
+		isc_timer_detach(&timers[i]);
+	end(&manager, &task);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(heap_ticker);
+ATF_TC_HEAD(heap_ticker, tc) {
+	atf_tc_set_md_var(tc, "descr", "ticker timers on the heap");
+}
+ATF_TC_BODY(heap_ticker, tc) {
+	UNUSED(tc);
+	ticker(0);
+}
+
+ATF_TC(heap_once);
+ATF_TC_HEAD(heap_once, tc) {
+	atf_tc_set_md_var(tc, "descr", "once timers on the heap");
+}
+ATF_TC_BODY(heap_once, tc) {
+	UNUSED(tc);
+	once(0);
+}
+
+ATF_TC(wheel_ticker);
+ATF_TC_HEAD(wheel_ticker, tc) {
+	atf_tc_set_md_var(tc, "descr", "ticker timers on timing wheels");
+}
+ATF_TC_BODY(wheel_ticker, tc) {
+	UNUSED(tc);
+	ticker(ISC_TIMERMGR_WHEEL);
+}
+
+ATF_TC(wheel_once);
+ATF_TC_HEAD(wheel_once, tc) {
+	atf_tc_set_md_var(tc, "descr", "once timers on timing wheels");
+}
+ATF_TC_BODY(wheel_once, tc) {
+	UNUSED(tc);
+	once(ISC_TIMERMGR_WHEEL);
+}
+#endif
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, heap_ticker);
+	ATF_TP_ADD_TC(tp, heap_once);
+	ATF_TP_ADD_TC(tp, wheel_ticker);
+	ATF_TP_ADD_TC(tp, wheel_once);
+#else
+	UNUSED(tp);
+#endif
+	return (atf_no_error());
+}
@@ -71,29 +71,76 @@
 #define TIMER_MAGIC			ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t)			ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
+/*
+ * Timing wheel parameters.  The wheel advances in ticks of 1/WHEEL_HZ
+ * seconds.  The root wheel has one slot per tick for the next
+ * WHEEL_ROOTSIZE ticks; each of the WHEEL_LEVELS wheels above it has
+ * WHEEL_LEVELSIZE slots covering WHEEL_LEVELSIZE times as many ticks as
+ * a slot of the wheel below.  Timers further out than the top wheel
+ * reaches wait in its last slot and are placed again when it cascades.
+ */
+#define WHEEL_HZ			100
+#define WHEEL_NSPERTICK			(1000000000 / WHEEL_HZ)
+#define WHEEL_ROOTBITS			8
+#define WHEEL_ROOTSIZE			(1 << WHEEL_ROOTBITS)
+#define WHEEL_LEVELBITS			6
+#define WHEEL_LEVELSIZE			(1 << WHEEL_LEVELBITS)
+#define WHEEL_LEVELS			4
+#define WHEEL_SLOTS			(WHEEL_ROOTSIZE + \
+					 WHEEL_LEVELS * WHEEL_LEVELSIZE)
+#define WHEEL_NEVER			(~(isc_uint64_t)0)
+
+#ifdef USE_TIMER_THREAD
+#define WHEEL_SHARDS			16
+#else
+#define WHEEL_SHARDS			1
+#endif
+
 typedef struct isc__timer isc__timer_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef struct timershard timershard_t;
+typedef ISC_LIST(isc__timer_t) timerlist_t;
 
 struct isc__timer {
 	/*! Not locked. */
 	isc_timer_t			common;
 	isc__timermgr_t *		manager;
+	timershard_t *			shard;
 	isc_mutex_t			lock;
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by manager lock, or shard lock if 'shard' is set. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
-	unsigned int			index;
+	unsigned int			index;	/* heap or slot + 1 */
 	isc_time_t			due;
+	isc_uint64_t			tick;
 	LINK(isc__timer_t)		link;
+	LINK(isc__timer_t)		wlink;
 };
 
+/*%
+ * One timing wheel and the timers created on it.
+ */
+struct timershard {
+	/* Not locked. */
+	isc_mutex_t			lock;
+	/* Locked by shard lock. */
+	LIST(isc__timer_t)		timers;
+	unsigned int			nscheduled;
+	isc_uint64_t			tick;	/* next to run */
+	isc_uint64_t			waketick;
+	timerlist_t			slots[WHEEL_SLOTS];
+};
+
+#define TIMERLOCK(t) \
+	((t)->shard != NULL ? &(t)->shard->lock : &(t)->manager->lock)
+
 #define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
 #define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
 
@@ -115,6 +162,10 @@ struct isc__timermgr {
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
 	isc_heap_t *			heap;
+	/* Wheel mode. */
+	timershard_t *			shards;
+	unsigned int			nshards;
+	isc_uint64_t			waketick;	/* manager lock */
 };
 
 /*%
@@ -147,6 +198,9 @@ ISC_TIMERFUNC_SCOPE void
 isc__timer_detach(isc_timer_t **timerp);
 ISC_TIMERFUNC_SCOPE isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+ISC_TIMERFUNC_SCOPE isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		      isc_timermgr_t **managerp);
 ISC_TIMERFUNC_SCOPE void
 isc__timermgr_poke(isc_timermgr_t *manager0);
 ISC_TIMERFUNC_SCOPE void
@@ -197,6 +251,89 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+static inline isc_uint64_t
+wheel_tick(const isc_time_t *t) {
+	return ((isc_uint64_t)isc_time_seconds(t) * WHEEL_HZ +
+		isc_time_nanoseconds(t) / WHEEL_NSPERTICK);
+}
+
+static inline void
+wheel_time(isc_uint64_t tick, isc_time_t *t) {
+	isc_time_set(t, (unsigned int)(tick / WHEEL_HZ),
+		     (unsigned int)(tick % WHEEL_HZ) * WHEEL_NSPERTICK);
+}
+
+static inline timershard_t *
+wheel_shard(isc__timermgr_t *manager) {
+	unsigned long self = isc_thread_self();
+	isc_uint32_t h;
+
+	/*
+	 * Timers go on the wheel of the thread that creates them, so
+	 * threads mostly take their own shard lock.
+	 */
+	h = (isc_uint32_t)(self ^ ((self >> 16) >> 16));
+	h ^= h >> 16;
+	h *= 0x45d9f3bU;
+	h ^= h >> 16;
+	return (&manager->shards[h % manager->nshards]);
+}
+
+static inline void
+wheel_insert(timershard_t *shard, isc__timer_t *timer) {
+	isc_uint64_t tick, delta;
+	unsigned int level, shift, slot;
+
+	/*
+	 * The caller must be holding the shard lock.
+	 */
+
+	tick = timer->tick;
+	if (tick < shard->tick)
+		tick = shard->tick;
+	delta = tick - shard->tick;
+
+	if (delta < WHEEL_ROOTSIZE) {
+		slot = (unsigned int)(tick & (WHEEL_ROOTSIZE - 1));
+	} else {
+		shift = WHEEL_ROOTBITS;
+		for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+			if (delta < ((isc_uint64_t)1 <<
+				     (shift + WHEEL_LEVELBITS)))
+				break;
+			shift += WHEEL_LEVELBITS;
+		}
+		if (delta >= ((isc_uint64_t)1 << (shift + WHEEL_LEVELBITS)))
+			tick = shard->tick +
+			       ((isc_uint64_t)1 <<
+				(shift + WHEEL_LEVELBITS)) - 1;
+		slot = WHEEL_ROOTSIZE + level * WHEEL_LEVELSIZE +
+		       (unsigned int)((tick >> shift) &
+				      (WHEEL_LEVELSIZE - 1));
+	}
+
+	APPEND(shard->slots[slot], timer, wlink);
+	timer->index = slot + 1;
+}
+
+static inline void
+wheel_poke(isc__timermgr_t *manager, isc_uint64_t tick) {
+	/*
+	 * Make sure the manager does not sleep past 'tick'.
+	 */
+	LOCK(&manager->lock);
+	if (tick < manager->waketick) {
+		manager->waketick = tick;
+#ifdef USE_TIMER_THREAD
+		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+				      ISC_MSG_SIGNALSCHED,
+				      "signal (schedule)"));
+		SIGNAL(&manager->wakeup);
+#endif /* USE_TIMER_THREAD */
+	}
+	UNLOCK(&manager->lock);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	isc_result_t result;
@@ -249,6 +386,43 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 			due = timer->expires;
 	}
 
+	if (timer->shard != NULL) {
+		timershard_t *shard = timer->shard;
+
+		/*
+		 * Put the timer on its wheel.  This replaces any earlier
+		 * slot, and takes constant time either way.
+		 */
+		if (timer->index > 0)
+			UNLINK(shard->slots[timer->index - 1], timer, wlink);
+		else {
+			if (shard->nscheduled == 0)
+				shard->tick = wheel_tick(now);
+			shard->nscheduled++;
+		}
+		timer->due = due;
+		timer->tick = wheel_tick(&due);
+		if (isc_time_nanoseconds(&due) % WHEEL_NSPERTICK != 0)
+			timer->tick++;
+		wheel_insert(shard, timer);
+
+		XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					   ISC_MSG_SCHEDULE, "schedule"),
+			    timer, due);
+
+		/*
+		 * Wake the manager if it would otherwise sleep past this
+		 * timer.  'waketick' is never later than when the manager
+		 * next looks at this shard, so most timers don't need to
+		 * take the manager lock.
+		 */
+		if (signal_ok && timer->tick < shard->waketick) {
+			shard->waketick = timer->tick;
+			wheel_poke(manager, timer->tick);
+		}
+		return (ISC_R_SUCCESS);
+	}
+
 	/*
 	 * Schedule the timer.
 	 */
@@ -343,6 +517,16 @@ deschedule(isc__timer_t *timer) {
 	 */
 
 	manager = timer->manager;
+	if (timer->shard != NULL) {
+		if (timer->index > 0) {
+			UNLINK(timer->shard->slots[timer->index - 1],
+			       timer, wlink);
+			timer->index = 0;
+			INSIST(timer->shard->nscheduled > 0);
+			timer->shard->nscheduled--;
+		}
+		return;
+	}
 	if (timer->index > 0) {
 #ifdef USE_TIMER_THREAD
 		if (timer->index == 1)
@@ -371,7 +555,7 @@ destroy(isc__timer_t *timer) {
 	 * The caller must ensure it is safe to destroy the timer.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(TIMERLOCK(timer));
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -379,9 +563,12 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
-	UNLINK(manager->timers, timer, link);
+	if (timer->shard != NULL)
+		UNLINK(timer->shard->timers, timer, link);
+	else
+		UNLINK(manager->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(TIMERLOCK(timer));
 
 	isc_task_detach(&timer->task);
 	DESTROYLOCK(&timer->lock);
@@ -442,6 +629,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (ISC_R_NOMEMORY);
 
 	timer->manager = manager;
+	timer->shard = NULL;
+	if (manager->shards != NULL)
+		timer->shard = wheel_shard(manager);
 	timer->references = 1;
 
 	if (type == isc_timertype_once && !isc_interval_iszero(interval)) {
@@ -478,11 +668,12 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (result);
 	}
 	ISC_LINK_INIT(timer, link);
+	ISC_LINK_INIT(timer, wlink);
 	timer->common.impmagic = TIMER_MAGIC;
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
 
-	LOCK(&manager->lock);
+	LOCK(TIMERLOCK(timer));
 
 	/*
 	 * Note we don't have to lock the timer like we normally would because
@@ -493,10 +684,14 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		result = schedule(timer, &now, ISC_TRUE);
 	else
 		result = ISC_R_SUCCESS;
-	if (result == ISC_R_SUCCESS)
-		APPEND(manager->timers, timer, link);
+	if (result == ISC_R_SUCCESS) {
+		if (timer->shard != NULL)
+			APPEND(timer->shard->timers, timer, link);
+		else
+			APPEND(manager->timers, timer, link);
+	}
 
-	UNLOCK(&manager->lock);
+	UNLOCK(TIMERLOCK(timer));
 
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
@@ -555,7 +750,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(TIMERLOCK(timer));
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -583,7 +778,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(TIMERLOCK(timer));
 
 	return (result);
 }
@@ -677,15 +872,122 @@ isc__timer_detach(isc_timer_t **timerp) {
 	*timerp = NULL;
 }
 
-static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	isc_boolean_t done = ISC_FALSE, post_event, need_schedule;
+static isc_boolean_t
+expire(isc__timermgr_t *manager, isc__timer_t *timer, isc_time_t *now) {
+	isc_boolean_t post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
-	isc__timer_t *timer;
-	isc_result_t result;
 	isc_boolean_t idle;
 
+	/*!
+	 * 'timer' is due.  Post its event, if it has one, and return
+	 * whether it must be scheduled again.  The caller must be holding
+	 * the lock that protects the timer's schedule.
+	 */
+
+	if (timer->type == isc_timertype_ticker) {
+		type = ISC_TIMEREVENT_TICK;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_TRUE;
+	} else if (timer->type == isc_timertype_limited) {
+		int cmp;
+		cmp = isc_time_compare(now, &timer->expires);
+		if (cmp >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_TRUE;
+		}
+	} else if (!isc_time_isepoch(&timer->expires) &&
+		   isc_time_compare(now,
+				    &timer->expires) >= 0) {
+		type = ISC_TIMEREVENT_LIFE;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_FALSE;
+	} else {
+		idle = ISC_FALSE;
+
+		LOCK(&timer->lock);
+		if (!isc_time_isepoch(&timer->idle) &&
+		    isc_time_compare(now,
+				     &timer->idle) >= 0) {
+			idle = ISC_TRUE;
+		}
+		UNLOCK(&timer->lock);
+		if (idle) {
+			type = ISC_TIMEREVENT_IDLE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			/*
+			 * Idle timer has been touched;
+			 * reschedule.
+			 */
+			XTRACEID(isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_TIMER,
+						ISC_MSG_IDLERESCHED,
+						"idle reschedule"),
+				 timer);
+			post_event = ISC_FALSE;
+			need_schedule = ISC_TRUE;
+		}
+	}
+
+	if (post_event) {
+		XTRACEID(isc_msgcat_get(isc_msgcat,
+					ISC_MSGSET_TIMER,
+					ISC_MSG_POSTING,
+					"posting"), timer);
+		/*
+		 * XXX We could preallocate this event.
+		 */
+		event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
+					   timer,
+					   type,
+					   timer->action,
+					   timer->arg,
+					   sizeof(*event));
+
+		if (event != NULL) {
+			event->due = timer->due;
+			isc_task_send(timer->task,
+				      ISC_EVENT_PTR(&event));
+		} else
+			UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+				 isc_msgcat_get(isc_msgcat,
+					 ISC_MSGSET_TIMER,
+					 ISC_MSG_EVENTNOTALLOC,
+					 "couldn't "
+					 "allocate event"));
+	}
+
+	return (need_schedule);
+}
+
+static void
+reschedule(isc__timer_t *timer, isc_time_t *now) {
+	isc_result_t result;
+
+	result = schedule(timer, now, ISC_FALSE);
+	if (result != ISC_R_SUCCESS)
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "%s: %u",
+			isc_msgcat_get(isc_msgcat,
+				ISC_MSGSET_TIMER,
+				ISC_MSG_SCHEDFAIL,
+				"couldn't schedule "
+				"timer"),
+				 result);
+}
+
+static void
+dispatch(isc__timermgr_t *manager, isc_time_t *now) {
+	isc_boolean_t done = ISC_FALSE, need_schedule;
+	isc__timer_t *timer;
+
 	/*!
 	 * The caller must be holding the manager lock.
 	 */
@@ -694,101 +996,14 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 		timer = isc_heap_element(manager->heap, 1);
 		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
 		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_TRUE;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_TRUE;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
-				type = ISC_TIMEREVENT_LIFE;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_FALSE;
-			} else {
-				idle = ISC_FALSE;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = ISC_TRUE;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = ISC_FALSE;
-					need_schedule = ISC_TRUE;
-				}
-			}
-
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
-				/*
-				 * XXX We could preallocate this event.
-				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
-			}
+			need_schedule = expire(manager, timer, now);
 
 			timer->index = 0;
 			isc_heap_delete(manager->heap, 1);
 			manager->nscheduled--;
 
-			if (need_schedule) {
-				result = schedule(timer, now, ISC_FALSE);
-				if (result != ISC_R_SUCCESS)
-					UNEXPECTED_ERROR(__FILE__, __LINE__,
-							 "%s: %u",
-						isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_SCHEDFAIL,
-							"couldn't schedule "
-							"timer"),
-							 result);
-			}
+			if (need_schedule)
+				reschedule(timer, now);
 		} else {
 			manager->due = timer->due;
 			done = ISC_TRUE;
@@ -796,6 +1011,109 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 	}
 }
 
+static unsigned int
+wheel_cascade(timershard_t *shard, unsigned int level) {
+	timerlist_t list;
+	isc__timer_t *timer;
+	unsigned int index, shift;
+
+	/*
+	 * Move the timers in the current slot of wheel 'level' down to
+	 * the wheels below, and return the slot number.
+	 */
+	shift = WHEEL_ROOTBITS + level * WHEEL_LEVELBITS;
+	index = (unsigned int)((shard->tick >> shift) &
+			       (WHEEL_LEVELSIZE - 1));
+	list = shard->slots[WHEEL_ROOTSIZE + level * WHEEL_LEVELSIZE + index];
+	INIT_LIST(shard->slots[WHEEL_ROOTSIZE + level * WHEEL_LEVELSIZE +
+			       index]);
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, wlink);
+		wheel_insert(shard, timer);
+	}
+	return (index);
+}
+
+static void
+wheel_run(isc__timermgr_t *manager, timershard_t *shard, isc_time_t *now) {
+	timerlist_t expired;
+	isc__timer_t *timer;
+	isc_uint64_t nowtick;
+	unsigned int index, level;
+
+	/*!
+	 * Expire everything on the shard's wheel that is due by 'now',
+	 * a tick at a time, and set the shard's 'waketick'.  The caller
+	 * must be holding the shard lock.
+	 */
+
+	nowtick = wheel_tick(now);
+	while (shard->nscheduled > 0 && shard->tick <= nowtick) {
+		index = (unsigned int)(shard->tick & (WHEEL_ROOTSIZE - 1));
+		if (index == 0) {
+			for (level = 0; level < WHEEL_LEVELS; level++)
+				if (wheel_cascade(shard, level) != 0)
+					break;
+		}
+
+		/*
+		 * Timers rescheduled for this tick or earlier go in the
+		 * next tick's slot, so advance before expiring them.
+		 */
+		expired = shard->slots[index];
+		INIT_LIST(shard->slots[index]);
+		shard->tick++;
+
+		while ((timer = HEAD(expired)) != NULL) {
+			INSIST(timer->type != isc_timertype_inactive);
+			UNLINK(expired, timer, wlink);
+			timer->index = 0;
+			shard->nscheduled--;
+			if (expire(manager, timer, now))
+				reschedule(timer, now);
+		}
+	}
+
+	if (shard->nscheduled == 0) {
+		shard->tick = nowtick + 1;
+		shard->waketick = WHEEL_NEVER;
+		return;
+	}
+
+	/*
+	 * Sleep until the next occupied root slot, or the next cascade,
+	 * whichever comes first.
+	 */
+	index = (unsigned int)(shard->tick & (WHEEL_ROOTSIZE - 1));
+	while (index < WHEEL_ROOTSIZE && EMPTY(shard->slots[index]))
+		index++;
+	shard->waketick = (shard->tick & ~(isc_uint64_t)(WHEEL_ROOTSIZE - 1))
+			  + index;
+}
+
+static isc_uint64_t
+wheel_dispatch(isc__timermgr_t *manager, isc_time_t *now) {
+	isc_uint64_t waketick = WHEEL_NEVER;
+	timershard_t *shard;
+	unsigned int i;
+
+	/*!
+	 * Run every shard and return the earliest tick at which one of
+	 * them has more work.  The caller must not be holding the manager
+	 * lock.
+	 */
+
+	for (i = 0; i < manager->nshards; i++) {
+		shard = &manager->shards[i];
+		LOCK(&shard->lock);
+		wheel_run(manager, shard, now);
+		if (shard->waketick < waketick)
+			waketick = shard->waketick;
+		UNLOCK(&shard->lock);
+	}
+	return (waketick);
+}
+
 #ifdef USE_TIMER_THREAD
 static isc_threadresult_t
 #ifdef _WIN32			/* XXXDCL */
@@ -814,6 +1132,33 @@ run(void *uap) {
 					  ISC_MSG_RUNNING,
 					  "running"), now);
 
+		if (manager->shards != NULL) {
+			isc_uint64_t waketick;
+
+			/*
+			 * The shards are run without the manager lock.
+			 * Timers scheduled meanwhile lower 'waketick'.
+			 */
+			manager->waketick = WHEEL_NEVER;
+			UNLOCK(&manager->lock);
+			waketick = wheel_dispatch(manager, &now);
+			LOCK(&manager->lock);
+			if (waketick < manager->waketick)
+				manager->waketick = waketick;
+			if (manager->done)
+				break;
+			if (manager->waketick != WHEEL_NEVER) {
+				wheel_time(manager->waketick, &manager->due);
+				result = WAITUNTIL(&manager->wakeup,
+						   &manager->lock,
+						   &manager->due);
+				INSIST(result == ISC_R_SUCCESS ||
+				       result == ISC_R_TIMEDOUT);
+			} else
+				WAIT(&manager->wakeup, &manager->lock);
+			continue;
+		}
+
 		dispatch(manager, &now);
 
 		if (manager->nscheduled > 0) {
@@ -867,8 +1212,59 @@ set_index(void *what, unsigned int index) {
 	timer->index = index;
 }
 
+static void
+destroy_shards(isc__timermgr_t *manager, isc_mem_t *mctx, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		REQUIRE(EMPTY(manager->shards[i].timers));
+		DESTROYLOCK(&manager->shards[i].lock);
+	}
+	isc_mem_put(mctx, manager->shards,
+		    manager->nshards * sizeof(timershard_t));
+	manager->shards = NULL;
+}
+
+static isc_result_t
+create_shards(isc__timermgr_t *manager, isc_mem_t *mctx) {
+	timershard_t *shard;
+	isc_result_t result;
+	isc_time_t now;
+	unsigned int i, j;
+
+	manager->nshards = WHEEL_SHARDS;
+	manager->shards = isc_mem_get(mctx, manager->nshards *
+					    sizeof(timershard_t));
+	if (manager->shards == NULL)
+		return (ISC_R_NOMEMORY);
+
+	TIME_NOW(&now);
+	for (i = 0; i < manager->nshards; i++) {
+		shard = &manager->shards[i];
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			destroy_shards(manager, mctx, i);
+			return (result);
+		}
+		INIT_LIST(shard->timers);
+		shard->nscheduled = 0;
+		shard->tick = wheel_tick(&now);
+		shard->waketick = WHEEL_NEVER;
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			INIT_LIST(shard->slots[j]);
+	}
+	return (ISC_R_SUCCESS);
+}
+
 ISC_TIMERFUNC_SCOPE isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
+	return (isc__timermgr_create2(mctx, 0, managerp));
+}
+
+ISC_TIMERFUNC_SCOPE isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		      isc_timermgr_t **managerp)
+{
 	isc__timermgr_t *manager;
 	isc_result_t result;
 
@@ -899,14 +1295,27 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->nscheduled = 0;
 	isc_time_settoepoch(&manager->due);
 	manager->heap = NULL;
+	manager->shards = NULL;
+	manager->nshards = 0;
+	manager->waketick = WHEEL_NEVER;
 	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
 	if (result != ISC_R_SUCCESS) {
 		INSIST(result == ISC_R_NOMEMORY);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (ISC_R_NOMEMORY);
 	}
+	if ((options & ISC_TIMERMGR_WHEEL) != 0) {
+		result = create_shards(manager, mctx);
+		if (result != ISC_R_SUCCESS) {
+			isc_heap_destroy(&manager->heap);
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (result);
+		}
+	}
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS) {
+		if (manager->shards != NULL)
+			destroy_shards(manager, mctx, manager->nshards);
 		isc_heap_destroy(&manager->heap);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (result);
@@ -916,6 +1325,8 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
 		isc_mem_detach(&manager->mctx);
 		DESTROYLOCK(&manager->lock);
+		if (manager->shards != NULL)
+			destroy_shards(manager, mctx, manager->nshards);
 		isc_heap_destroy(&manager->heap);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -929,6 +1340,8 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 		isc_mem_detach(&manager->mctx);
 		(void)isc_condition_destroy(&manager->wakeup);
 		DESTROYLOCK(&manager->lock);
+		if (manager->shards != NULL)
+			destroy_shards(manager, mctx, manager->nshards);
 		isc_heap_destroy(&manager->heap);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1019,6 +1432,8 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	(void)isc_condition_destroy(&manager->wakeup);
 #endif /* USE_TIMER_THREAD */
 	DESTROYLOCK(&manager->lock);
+	if (manager->shards != NULL)
+		destroy_shards(manager, manager->mctx, manager->nshards);
 	isc_heap_destroy(&manager->heap);
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
@@ -1042,7 +1457,15 @@ isc__timermgr_nextevent(isc_timermgr_t *manager0, isc_time_t *when) {
 	if (manager == NULL)
 		manager = timermgr;
 #endif
-	if (manager == NULL || manager->nscheduled == 0)
+	if (manager == NULL)
+		return (ISC_R_NOTFOUND);
+	if (manager->shards != NULL) {
+		if (manager->waketick == WHEEL_NEVER)
+			return (ISC_R_NOTFOUND);
+		wheel_time(manager->waketick, when);
+		return (ISC_R_SUCCESS);
+	}
+	if (manager->nscheduled == 0)
 		return (ISC_R_NOTFOUND);
 	*when = manager->due;
 	return (ISC_R_SUCCESS);
@@ -1060,6 +1483,10 @@ isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	if (manager == NULL)
 		return;
 	TIME_NOW(&now);
+	if (manager->shards != NULL) {
+		manager->waketick = wheel_dispatch(manager, &now);
+		return;
+	}
 	dispatch(manager, &now);
 }
 #endif /* USE_TIMER_THREAD */
@@ -58,6 +58,7 @@
 #include <unistd.h>		/* Required for mkstemp on NetBSD. */
 
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 
@@ -120,6 +121,31 @@ isc_file_getsizefd(int fd, off_t *size) {
 	return (result);
 }
 
+isc_result_t
+isc_file_mmap(int fd, size_t len, void **addrp) {
+	void *addr;
+
+	REQUIRE(len > 0);
+	REQUIRE(addrp != NULL && *addrp == NULL);
+
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+		return (isc__errno2result(errno));
+
+	*addrp = addr;
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_file_munmap(void *addr, size_t len) {
+	REQUIRE(addr != NULL);
+
+	if (munmap(addr, len) != 0)
+		return (isc__errno2result(errno));
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc_file_mode(const char *file, mode_t *modep) {
 	isc_result_t result;
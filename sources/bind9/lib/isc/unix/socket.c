@@ -114,6 +114,16 @@ typedef struct {
 #define USE_SELECT
 #endif	/* ISC_PLATFORM_HAVEKQUEUE */
 
+/*%
+ * Batched UDP I/O.  recvmmsg() and sendmmsg() are available on Linux
+ * (where glibc only declares them with _GNU_SOURCE) and on FreeBSD 11 and
+ * later; MSG_WAITFORONE is defined alongside them on both.
+ */
+#if defined(MSG_WAITFORONE) && defined(ISC_NET_BSD44MSGHDR) && \
+    (!defined(__linux__) || defined(_GNU_SOURCE))
+#define USE_MMSG
+#endif
+
 #ifndef USE_WATCHER_THREAD
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 struct isc_socketwait {
@@ -297,6 +307,9 @@ typedef isc_event_t intev_t;
 
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+#ifdef USE_MMSG
+typedef struct mmsgbatch mmsgbatch_t;
+#endif
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -353,18 +366,25 @@ struct isc__socket {
 	isc_sockfdwatch_t	fdwatchcb;
 	int			fdwatchflags;
 	isc_task_t		*fdwatchtask;
+
+#ifdef USE_MMSG
+	mmsgbatch_t		*batch;	/* allocated on first batched I/O */
+#endif
 };
 
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
-	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+/*%
+ * A watcher: one event loop, with its own kernel event queue and its own
+ * wakeup pipe.  Each descriptor is watched by exactly one of the
+ * manager's watchers, chosen by FDTHREAD().
+ */
+typedef struct isc__socketthread isc__socketthread_t;
+
+struct isc__socketthread {
+	isc__socketmgr_t	*manager;
+	int			threadid;
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -382,13 +402,32 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+#ifdef ISC_PLATFORM_USETHREADS
+	int			pipe_fds[2];
+#endif
+#ifdef USE_WATCHER_THREAD
+	isc_thread_t		thread;
+#endif
+};
+
+/*%
+ * Map a descriptor to the watcher responsible for it.
+ */
+#define FDTHREAD(m, fd)		(&(m)->threads[(fd) % (m)->nthreads])
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -408,12 +447,12 @@ struct isc__socketmgr {
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
 #endif /* USE_WATCHER_THREAD */
 	int			maxudp;
+	unsigned int		udpbatch;
 };
 
 #ifdef USE_SHARED_MANAGER
@@ -434,6 +473,22 @@ static isc__socketmgr_t *socketmgr = NULL;
 # define MAXSCATTERGATHER_RECV	(ISC_SOCKET_MAXSCATTERGATHER)
 #endif
 
+#ifdef USE_MMSG
+/*%
+ * Scratch space for recvmmsg()/sendmmsg().  Each slot carries the
+ * message header, iovec array and control buffer for one queued
+ * socket event.  The socket lock protects it.
+ */
+struct mmsgbatch {
+	struct mmsghdr		msgs[ISC_SOCKET_MAXBATCH];
+	struct iovec		iovs[ISC_SOCKET_MAXBATCH][MAXSCATTERGATHER_RECV];
+	isc_socketevent_t	*devs[ISC_SOCKET_MAXBATCH];
+	size_t			counts[ISC_SOCKET_MAXBATCH];
+	char			*cmsgbuf;
+	ISC_SOCKADDR_LEN_T	cmsgbuflen;	/* per slot */
+};
+#endif /* USE_MMSG */
+
 static isc_result_t socket_create(isc_socketmgr_t *manager0, int pf,
 				  isc_sockettype_t type,
 				  isc_socket_t **socketp,
@@ -456,7 +511,7 @@ static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketthread_t *thread);
 #endif
 
 /*%
@@ -480,7 +535,7 @@ ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks);
+		       unsigned int maxsocks, int nthreads);
 ISC_SOCKETFUNC_SCOPE void
 isc__socketmgr_destroy(isc_socketmgr_t **managerp);
 ISC_SOCKETFUNC_SCOPE isc_result_t
@@ -635,7 +690,11 @@ enum {
 	STATID_ACCEPTFAIL = 6,
 	STATID_ACCEPT = 7,
 	STATID_SENDFAIL = 8,
-	STATID_RECVFAIL = 9
+	STATID_RECVFAIL = 9,
+	STATID_RECVBATCH = 10,
+	STATID_RECVBATCHPKTS = 11,
+	STATID_SENDBATCH = 12,
+	STATID_SENDBATCHPKTS = 13
 };
 static const isc_statscounter_t udp4statsindex[] = {
 	isc_sockstatscounter_udp4open,
@@ -647,7 +706,11 @@ static const isc_statscounter_t udp4statsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_udp4sendfail,
-	isc_sockstatscounter_udp4recvfail
+	isc_sockstatscounter_udp4recvfail,
+	isc_sockstatscounter_udp4recvbatch,
+	isc_sockstatscounter_udp4recvbatchpkts,
+	isc_sockstatscounter_udp4sendbatch,
+	isc_sockstatscounter_udp4sendbatchpkts
 };
 static const isc_statscounter_t udp6statsindex[] = {
 	isc_sockstatscounter_udp6open,
@@ -659,7 +722,11 @@ static const isc_statscounter_t udp6statsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_udp6sendfail,
-	isc_sockstatscounter_udp6recvfail
+	isc_sockstatscounter_udp6recvfail,
+	isc_sockstatscounter_udp6recvbatch,
+	isc_sockstatscounter_udp6recvbatchpkts,
+	isc_sockstatscounter_udp6sendbatch,
+	isc_sockstatscounter_udp6sendbatchpkts
 };
 static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4open,
@@ -671,7 +738,11 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4acceptfail,
 	isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,
-	isc_sockstatscounter_tcp4recvfail
+	isc_sockstatscounter_tcp4recvfail,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6open,
@@ -683,7 +754,11 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6acceptfail,
 	isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,
-	isc_sockstatscounter_tcp6recvfail
+	isc_sockstatscounter_tcp6recvfail,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixopen,
@@ -695,7 +770,11 @@ static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixacceptfail,
 	isc_sockstatscounter_unixaccept,
 	isc_sockstatscounter_unixsendfail,
-	isc_sockstatscounter_unixrecvfail
+	isc_sockstatscounter_unixrecvfail,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
@@ -707,7 +786,11 @@ static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_fdwatchsendfail,
-	isc_sockstatscounter_fdwatchrecvfail
+	isc_sockstatscounter_fdwatchrecvfail,
+	-1,
+	-1,
+	-1,
+	-1
 };
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
@@ -814,8 +897,26 @@ inc_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 		isc_stats_increment(stats, counterid);
 }
 
+#ifdef USE_MMSG
+/*%
+ * Add to socket-related statistics counters.
+ */
+static inline void
+add_stats(isc_stats_t *stats, isc_statscounter_t counterid,
+	  isc_uint32_t val)
+{
+	REQUIRE(counterid != -1);
+
+	if (stats != NULL)
+		isc_stats_add(stats, counterid, val);
+}
+#endif /* USE_MMSG */
+
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
+#if defined(USE_DEVPOLL) || defined(USE_SELECT)
+	isc__socketmgr_t *manager = thread->manager;
+#endif
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -828,7 +929,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -841,7 +942,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		event.events = EPOLLOUT;
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
-	if (epoll_ctl(manager->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1 &&
+	if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1 &&
 	    errno != EEXIST) {
 		result = isc__errno2result(errno);
 	}
@@ -859,7 +960,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -883,7 +984,10 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
+#if defined(USE_DEVPOLL) || defined(USE_SELECT)
+	isc__socketmgr_t *manager = thread->manager;
+#endif
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -896,7 +1000,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -909,7 +1013,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		event.events = EPOLLOUT;
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
-	if (epoll_ctl(manager->epoll_fd, EPOLL_CTL_DEL, fd, &event) == -1 &&
+	if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, fd, &event) == -1 &&
 	    errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -946,7 +1050,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -971,6 +1075,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 
 static void
 wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+	isc__socketthread_t *thread = FDTHREAD(manager, fd);
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -986,8 +1091,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1004,8 +1109,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1017,7 +1122,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1033,12 +1138,12 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 
 #ifdef USE_WATCHER_THREAD
 /*
- * Poke the select loop when there is something for us to do.
+ * Poke a watcher's select loop when there is something for it to do.
  * The write is required (by POSIX) to complete.  That is, we
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke_thread(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1047,7 +1152,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1073,16 +1178,24 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the watcher responsible for 'fd'.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	select_poke_thread(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1647,30 +1760,22 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Complete a receive into 'dev' given the result 'cc' and 'recv_errno' of
+ * the recvmsg() call on 'msghdr', which was built by build_msghdr_recv()
+ * to read at most 'read_count' bytes.  This is shared by doio_recv() and
+ * the batched receive path, where 'msghdr' is one slot of a recvmmsg()
+ * vector.  Return values are as for doio_recv().
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
+doio_recvdone(isc__socket_t *sock, isc_socketevent_t *dev,
+	      struct msghdr *msghdr, int cc, int recv_errno,
+	      size_t read_count)
+{
 	size_t actual_count;
-	struct msghdr msghdr;
 	isc_buffer_t *buffer;
-	int recv_errno;
 	char strbuf[ISC_STRERRORSIZE];
 
-	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
 	if (cc < 0) {
 		if (SOFT_ERROR(recv_errno))
 			return (DOIO_SOFT);
@@ -1750,7 +1855,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -1789,7 +1894,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * out the interesting bits.
 	 */
 	if (sock->type == isc_sockettype_udp)
-		process_cmsg(sock, &msghdr, dev);
+		process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -1829,48 +1934,48 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
-/*
- * Returns:
- *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
- *			ISC_R_SUCCESS.
- *
- *	DOIO_HARD	A hard or unexpected I/O error was encountered.
- *			dev->result contains the appropriate error.
- *
- *	DOIO_SOFT	A soft I/O error was encountered.  No senddone
- *			event was sent.  The operation should be retried.
- *
- *	No other return values are possible.
- */
 static int
-doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	int cc;
-	struct iovec iov[MAXSCATTERGATHER_SEND];
-	size_t write_count;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
 	struct msghdr msghdr;
-	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
-	int attempts = 0;
-	int send_errno;
-	char strbuf[ISC_STRERRORSIZE];
+	int recv_errno;
 
-	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
+	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
 
- resend:
-	if (sock->type == isc_sockettype_udp &&
-	    sock->manager->maxudp != 0 &&
-	    write_count > (size_t)sock->manager->maxudp)
-		cc = write_count;
-	else
-		cc = sendmsg(sock->fd, &msghdr, 0);
-	send_errno = errno;
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	return (doio_recvdone(sock, dev, &msghdr, cc, recv_errno,
+			      read_count));
+}
+
+/*
+ * Complete a send of 'dev' given the result 'cc' and 'send_errno' of the
+ * sendmsg() call that was to write 'write_count' bytes.  This is shared by
+ * doio_send() and the batched send path.  Return values are as for
+ * doio_send().
+ */
+static int
+doio_senddone(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	      int send_errno, size_t write_count)
+{
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	char strbuf[ISC_STRERRORSIZE];
 
 	/*
 	 * Check for error or block condition.
 	 */
 	if (cc < 0) {
-		if (send_errno == EINTR && ++attempts < NRETRIES)
-			goto resend;
-
 		if (SOFT_ERROR(send_errno))
 			return (DOIO_SOFT);
 
@@ -1953,93 +2058,371 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 }
 
 /*
- * Kill.
+ * Returns:
+ *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
+ *			ISC_R_SUCCESS.
  *
- * Caller must ensure that the socket is not locked and no external
- * references exist.
+ *	DOIO_HARD	A hard or unexpected I/O error was encountered.
+ *			dev->result contains the appropriate error.
+ *
+ *	DOIO_SOFT	A soft I/O error was encountered.  No senddone
+ *			event was sent.  The operation should be retried.
+ *
+ *	No other return values are possible.
  */
-static void
-socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
-	isc_sockettype_t type = sock->type;
-	int lockid = FDLOCK_ID(fd);
+static int
+doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_SEND];
+	size_t write_count;
+	struct msghdr msghdr;
+	int attempts = 0;
+	int send_errno;
 
-	/*
-	 * No one has this socket open, so the watcher doesn't have to be
-	 * poked, and the socket doesn't have to be locked.
-	 */
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[fd] = NULL;
-	if (type == isc_sockettype_fdwatch)
-		manager->fdstate[fd] = CLOSED;
+	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
+
+ resend:
+	if (sock->type == isc_sockettype_udp &&
+	    sock->manager->maxudp != 0 &&
+	    write_count > (size_t)sock->manager->maxudp)
+		cc = write_count;
 	else
-		manager->fdstate[fd] = CLOSE_PENDING;
-	UNLOCK(&manager->fdlock[lockid]);
-	if (type == isc_sockettype_fdwatch) {
-		/*
-		 * The caller may close the socket once this function returns,
-		 * and `fd' may be reassigned for a new socket.  So we do
-		 * unwatch_fd() here, rather than defer it via select_poke().
-		 * Note: this may complicate data protection among threads and
-		 * may reduce performance due to additional locks.  One way to
-		 * solve this would be to dup() the watched descriptor, but we
-		 * take a simpler approach at this moment.
-		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
-	} else
-		select_poke(manager, fd, SELECT_POKE_CLOSE);
+		cc = sendmsg(sock->fd, &msghdr, 0);
+	send_errno = errno;
 
-	inc_stats(manager->stats, sock->statsindex[STATID_CLOSE]);
+	if (cc < 0 && send_errno == EINTR && ++attempts < NRETRIES)
+		goto resend;
 
-	/*
-	 * update manager->maxfd here (XXX: this should be implemented more
-	 * efficiently)
-	 */
-#ifdef USE_SELECT
-	LOCK(&manager->lock);
-	if (manager->maxfd == fd) {
-		int i;
+	return (doio_senddone(sock, dev, cc, send_errno, write_count));
+}
 
-		manager->maxfd = 0;
-		for (i = fd - 1; i >= 0; i--) {
-			lockid = FDLOCK_ID(i);
+#ifdef USE_MMSG
+/*
+ * Return the number of events, starting with 'dev', that the next batched
+ * system call on 'sock' should handle.  A result below 2 means that
+ * batching does not apply and the events are handled one at a time.
+ */
+static unsigned int
+batch_count(isc__socket_t *sock, isc_socketevent_t *dev) {
+	unsigned int n = 0;
 
-			LOCK(&manager->fdlock[lockid]);
-			if (manager->fdstate[i] == MANAGED) {
-				manager->maxfd = i;
-				UNLOCK(&manager->fdlock[lockid]);
-				break;
-			}
-			UNLOCK(&manager->fdlock[lockid]);
-		}
-#ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
-#endif
+	if (sock->type != isc_sockettype_udp || sock->manager->udpbatch < 2U)
+		return (0);
+
+	while (dev != NULL && n < sock->manager->udpbatch) {
+		n++;
+		dev = ISC_LIST_NEXT(dev, ev_link);
 	}
-	UNLOCK(&manager->lock);
-#endif	/* USE_SELECT */
+
+	return (n);
 }
 
-static void
-destroy(isc__socket_t **sockp) {
-	int fd;
-	isc__socket_t *sock = *sockp;
-	isc__socketmgr_t *manager = sock->manager;
+/*
+ * Return the batched I/O scratch space of 'sock', allocating it on first
+ * use.  NULL is returned if that fails; the caller then falls back to one
+ * system call per datagram.
+ *
+ * The socket must be locked.
+ */
+static mmsgbatch_t *
+get_batch(isc__socket_t *sock) {
+	isc_mem_t *mctx = sock->manager->mctx;
+	mmsgbatch_t *batch;
 
-	socket_log(sock, NULL, CREATION, isc_msgcat, ISC_MSGSET_SOCKET,
-		   ISC_MSG_DESTROYING, "destroying");
+	if (sock->batch != NULL)
+		return (sock->batch);
 
-	INSIST(ISC_LIST_EMPTY(sock->accept_list));
-	INSIST(ISC_LIST_EMPTY(sock->recv_list));
-	INSIST(ISC_LIST_EMPTY(sock->send_list));
-	INSIST(sock->connect_ev == NULL);
-	REQUIRE(sock->fd == -1 || sock->fd < (int)manager->maxsocks);
+	batch = isc_mem_get(mctx, sizeof(*batch));
+	if (batch == NULL)
+		return (NULL);
 
-	if (sock->fd >= 0) {
-		fd = sock->fd;
-		sock->fd = -1;
-		socketclose(manager, sock, fd);
+	batch->cmsgbuflen = ISC_MAX(sock->recvcmsgbuflen,
+				    sock->sendcmsgbuflen);
+	batch->cmsgbuf = NULL;
+	if (batch->cmsgbuflen != 0U) {
+		batch->cmsgbuf = isc_mem_get(mctx, batch->cmsgbuflen *
+						   ISC_SOCKET_MAXBATCH);
+		if (batch->cmsgbuf == NULL) {
+			isc_mem_put(mctx, batch, sizeof(*batch));
+			return (NULL);
+		}
+	}
+
+	sock->batch = batch;
+	return (batch);
+}
+
+static void
+free_batch(isc__socket_t *sock) {
+	isc_mem_t *mctx = sock->manager->mctx;
+	mmsgbatch_t *batch = sock->batch;
+
+	if (batch == NULL)
+		return;
+
+	if (batch->cmsgbuf != NULL)
+		isc_mem_put(mctx, batch->cmsgbuf,
+			    batch->cmsgbuflen * ISC_SOCKET_MAXBATCH);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+	sock->batch = NULL;
+}
+
+/*
+ * Receive into the first 'count' events on the socket's receive queue
+ * with a single recvmmsg() call, and post every event that completed.
+ *
+ * Returns DOIO_SOFT if the socket has been drained and the caller should
+ * wait for it to become readable again, DOIO_SUCCESS if more data may be
+ * waiting.
+ *
+ * The socket must be locked.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock, mmsgbatch_t *batch, unsigned int count) {
+	isc_socketevent_t *dev;
+	struct msghdr *msghdr;
+	unsigned int i, n;
+	int cc;
+	int recv_errno;
+
+	REQUIRE(count <= ISC_SOCKET_MAXBATCH);
+
+	dev = ISC_LIST_HEAD(sock->recv_list);
+	for (n = 0; n < count && dev != NULL; n++) {
+		msghdr = &batch->msgs[n].msg_hdr;
+		build_msghdr_recv(sock, dev, msghdr, batch->iovs[n],
+				  &batch->counts[n]);
+		if (msghdr->msg_controllen != 0) {
+			INSIST(msghdr->msg_controllen <= batch->cmsgbuflen);
+			msghdr->msg_control = batch->cmsgbuf +
+					      n * batch->cmsgbuflen;
+		}
+		batch->msgs[n].msg_len = 0;
+		batch->devs[n] = dev;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+	cc = recvmmsg(sock->fd, batch->msgs, n, 0, NULL);
+	recv_errno = errno;
+
+	if (cc <= 0) {
+		/*
+		 * Nothing was received.  Classify the error against the
+		 * first waiting event exactly as a single recvmsg() would.
+		 */
+		dev = batch->devs[0];
+		switch (doio_recvdone(sock, dev, &batch->msgs[0].msg_hdr,
+				      cc < 0 ? -1 : 0, recv_errno,
+				      batch->counts[0])) {
+		case DOIO_HARD:
+		case DOIO_SUCCESS:
+			send_recvdone_event(sock, &dev);
+			return (DOIO_SUCCESS);
+		default:
+			return (DOIO_SOFT);
+		}
+	}
+
+	inc_stats(sock->manager->stats, sock->statsindex[STATID_RECVBATCH]);
+	add_stats(sock->manager->stats, sock->statsindex[STATID_RECVBATCHPKTS],
+		  (isc_uint32_t)cc);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = batch->devs[i];
+		switch (doio_recvdone(sock, dev, &batch->msgs[i].msg_hdr,
+				      (int)batch->msgs[i].msg_len, 0,
+				      batch->counts[i])) {
+		case DOIO_SOFT:
+			/*
+			 * The datagram was dropped; the event stays queued
+			 * for the next one.
+			 */
+			break;
+		case DOIO_HARD:
+		case DOIO_SUCCESS:
+			send_recvdone_event(sock, &dev);
+			break;
+		default:
+			INSIST(0);
+		}
+	}
+
+	return (((unsigned int)cc < n) ? DOIO_SOFT : DOIO_SUCCESS);
+}
+
+/*
+ * Send the first 'count' events on the socket's send queue with a single
+ * sendmmsg() call, and post every event that completed.
+ *
+ * Returns DOIO_SOFT if the socket would block and the caller should wait
+ * for it to become writable again, DOIO_SUCCESS otherwise.
+ *
+ * The socket must be locked.
+ */
+static int
+doio_sendbatch(isc__socket_t *sock, mmsgbatch_t *batch, unsigned int count) {
+	isc_socketevent_t *dev;
+	struct msghdr *msghdr;
+	unsigned int i, n;
+	int cc;
+	int send_errno;
+	int io_state;
+
+	REQUIRE(count <= ISC_SOCKET_MAXBATCH);
+
+	dev = ISC_LIST_HEAD(sock->send_list);
+	for (n = 0; n < count && dev != NULL; n++) {
+		msghdr = &batch->msgs[n].msg_hdr;
+		build_msghdr_send(sock, dev, msghdr, batch->iovs[n],
+				  &batch->counts[n]);
+		/*
+		 * build_msghdr_send() builds any control data in the
+		 * socket's single send cmsg buffer; give each slot a copy.
+		 */
+		if (msghdr->msg_controllen != 0) {
+			char *cmsgbuf = batch->cmsgbuf + n * batch->cmsgbuflen;
+
+			INSIST(msghdr->msg_controllen <= batch->cmsgbuflen);
+			memmove(cmsgbuf, msghdr->msg_control,
+				msghdr->msg_controllen);
+			msghdr->msg_control = cmsgbuf;
+		}
+		batch->msgs[n].msg_len = 0;
+		batch->devs[n] = dev;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+	cc = sendmmsg(sock->fd, batch->msgs, n, 0);
+	send_errno = errno;
+
+	if (cc <= 0) {
+		/*
+		 * Nothing was sent.  Let a plain sendmsg() retry an
+		 * interrupted call; otherwise classify the error against
+		 * the first waiting event.
+		 */
+		dev = batch->devs[0];
+		if (cc < 0 && send_errno == EINTR)
+			io_state = doio_send(sock, dev);
+		else
+			io_state = doio_senddone(sock, dev, cc < 0 ? -1 : 0,
+						 send_errno, batch->counts[0]);
+		if (io_state == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_senddone_event(sock, &dev);
+		return (DOIO_SUCCESS);
+	}
+
+	inc_stats(sock->manager->stats, sock->statsindex[STATID_SENDBATCH]);
+	add_stats(sock->manager->stats, sock->statsindex[STATID_SENDBATCHPKTS],
+		  (isc_uint32_t)cc);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = batch->devs[i];
+		io_state = doio_senddone(sock, dev, (int)batch->msgs[i].msg_len,
+					 0, batch->counts[i]);
+		if (io_state == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_senddone_event(sock, &dev);
+	}
+
+	/*
+	 * If fewer than 'n' datagrams were sent, the next one either
+	 * would block or failed; the caller's next attempt will find out
+	 * which.
+	 */
+	return (DOIO_SUCCESS);
+}
+#endif /* USE_MMSG */
+
+/*
+ * Kill.
+ *
+ * Caller must ensure that the socket is not locked and no external
+ * references exist.
+ */
+static void
+socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
+	isc_sockettype_t type = sock->type;
+	int lockid = FDLOCK_ID(fd);
+
+	/*
+	 * No one has this socket open, so the watcher doesn't have to be
+	 * poked, and the socket doesn't have to be locked.
+	 */
+	LOCK(&manager->fdlock[lockid]);
+	manager->fds[fd] = NULL;
+	if (type == isc_sockettype_fdwatch)
+		manager->fdstate[fd] = CLOSED;
+	else
+		manager->fdstate[fd] = CLOSE_PENDING;
+	UNLOCK(&manager->fdlock[lockid]);
+	if (type == isc_sockettype_fdwatch) {
+		/*
+		 * The caller may close the socket once this function returns,
+		 * and `fd' may be reassigned for a new socket.  So we do
+		 * unwatch_fd() here, rather than defer it via select_poke().
+		 * Note: this may complicate data protection among threads and
+		 * may reduce performance due to additional locks.  One way to
+		 * solve this would be to dup() the watched descriptor, but we
+		 * take a simpler approach at this moment.
+		 */
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_READ);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_WRITE);
+	} else
+		select_poke(manager, fd, SELECT_POKE_CLOSE);
+
+	inc_stats(manager->stats, sock->statsindex[STATID_CLOSE]);
+
+	/*
+	 * update manager->maxfd here (XXX: this should be implemented more
+	 * efficiently)
+	 */
+#ifdef USE_SELECT
+	LOCK(&manager->lock);
+	if (manager->maxfd == fd) {
+		int i;
+
+		manager->maxfd = 0;
+		for (i = fd - 1; i >= 0; i--) {
+			lockid = FDLOCK_ID(i);
+
+			LOCK(&manager->fdlock[lockid]);
+			if (manager->fdstate[i] == MANAGED) {
+				manager->maxfd = i;
+				UNLOCK(&manager->fdlock[lockid]);
+				break;
+			}
+			UNLOCK(&manager->fdlock[lockid]);
+		}
+#ifdef ISC_PLATFORM_USETHREADS
+		if (manager->maxfd < manager->threads[0].pipe_fds[0])
+			manager->maxfd = manager->threads[0].pipe_fds[0];
+#endif
+	}
+	UNLOCK(&manager->lock);
+#endif	/* USE_SELECT */
+}
+
+static void
+destroy(isc__socket_t **sockp) {
+	int fd;
+	isc__socket_t *sock = *sockp;
+	isc__socketmgr_t *manager = sock->manager;
+
+	socket_log(sock, NULL, CREATION, isc_msgcat, ISC_MSGSET_SOCKET,
+		   ISC_MSG_DESTROYING, "destroying");
+
+	INSIST(ISC_LIST_EMPTY(sock->accept_list));
+	INSIST(ISC_LIST_EMPTY(sock->recv_list));
+	INSIST(ISC_LIST_EMPTY(sock->send_list));
+	INSIST(sock->connect_ev == NULL);
+	REQUIRE(sock->fd == -1 || sock->fd < (int)manager->maxsocks);
+
+	if (sock->fd >= 0) {
+		fd = sock->fd;
+		sock->fd = -1;
+		socketclose(manager, sock, fd);
 	}
 
 	LOCK(&manager->lock);
@@ -2084,6 +2467,9 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 
 	sock->recvcmsgbuf = NULL;
 	sock->sendcmsgbuf = NULL;
+#ifdef USE_MMSG
+	sock->batch = NULL;
+#endif
 
 	/*
 	 * Set up cmsg buffers.
@@ -2208,6 +2594,9 @@ free_socket(isc__socket_t **socketp) {
 	if (sock->sendcmsgbuf != NULL)
 		isc_mem_put(sock->manager->mctx, sock->sendcmsgbuf,
 			    sock->sendcmsgbuflen);
+#ifdef USE_MMSG
+	free_batch(sock);
+#endif
 
 	sock->common.magic = 0;
 	sock->common.impmagic = 0;
@@ -3356,6 +3745,10 @@ static void
 internal_recv(isc_task_t *me, isc_event_t *ev) {
 	isc_socketevent_t *dev;
 	isc__socket_t *sock;
+#ifdef USE_MMSG
+	mmsgbatch_t *batch;
+	unsigned int count;
+#endif
 
 	INSIST(ev->ev_type == ISC_SOCKEVENT_INTR);
 
@@ -3384,6 +3777,15 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
 	while (dev != NULL) {
+#ifdef USE_MMSG
+		count = batch_count(sock, dev);
+		if (count > 1U && (batch = get_batch(sock)) != NULL) {
+			if (doio_recvbatch(sock, batch, count) == DOIO_SOFT)
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->recv_list);
+			continue;
+		}
+#endif
 		switch (doio_recv(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3421,6 +3823,10 @@ static void
 internal_send(isc_task_t *me, isc_event_t *ev) {
 	isc_socketevent_t *dev;
 	isc__socket_t *sock;
+#ifdef USE_MMSG
+	mmsgbatch_t *batch;
+	unsigned int count;
+#endif
 
 	INSIST(ev->ev_type == ISC_SOCKEVENT_INTW);
 
@@ -3452,6 +3858,16 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
+#ifdef USE_MMSG
+		count = batch_count(sock, dev);
+		if (count > 1U && sock->manager->maxudp == 0 &&
+		    (batch = get_batch(sock)) != NULL) {
+			if (doio_sendbatch(sock, batch, count) == DOIO_SOFT)
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->send_list);
+			continue;
+		}
+#endif
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3559,9 +3975,10 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
+process_fd(isc__socketthread_t *thread, int fd, isc_boolean_t readable,
 	   isc_boolean_t writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	isc_boolean_t unlock_sock;
 	isc_boolean_t unwatch_read = ISC_FALSE, unwatch_write = ISC_FALSE;
@@ -3574,8 +3991,8 @@ process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -3620,15 +4037,16 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -3636,7 +4054,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -3651,34 +4069,36 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
 		readable = ISC_TF(events[i].filter == EVFILT_READ);
 		writable = ISC_TF(events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -3688,7 +4108,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -3704,28 +4124,29 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			 */
 			events[i].events |= (EPOLLIN | EPOLLOUT);
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -3735,38 +4156,38 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
 	int i;
 
-	REQUIRE(maxfd <= (int)manager->maxsocks);
+	REQUIRE(maxfd <= (int)thread->manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -3774,11 +4195,12 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
 		manager_log(manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
@@ -3822,7 +4244,8 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -3848,34 +4271,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -3885,7 +4308,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -3893,9 +4316,9 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
@@ -3950,22 +4373,23 @@ watcher(void *uap) {
 		} while (cc < 0);
 
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(thread, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(thread);
 #endif
 	}
 
-	manager_log(manager, TRACE, "%s",
+	manager_log(manager, TRACE, "%s %d",
 		    isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-				   ISC_MSG_EXITING, "watcher exiting"));
+				   ISC_MSG_EXITING, "watcher exiting"),
+		    thread->threadid);
 
 	return ((isc_threadresult_t)0);
 }
@@ -3989,6 +4413,22 @@ isc___socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
 
 	manager->maxudp = maxudp;
 }
+
+ISC_SOCKETFUNC_SCOPE isc_result_t
+isc___socketmgr_setudpbatch(isc_socketmgr_t *manager0, unsigned int batch) {
+	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(batch <= ISC_SOCKET_MAXBATCH);
+
+#ifdef USE_MMSG
+	manager->udpbatch = batch;
+#else
+	if (batch > 1U)
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	return (ISC_R_SUCCESS);
+}
 #endif	/* BIND9 */
 
 /*
@@ -3996,20 +4436,47 @@ isc___socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_SELECT
+	isc__socketmgr_t *manager = thread->manager;
+#endif
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
+    defined(USE_WATCHER_THREAD)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4017,28 +4484,30 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4046,44 +4515,34 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		return (ISC_R_NOMEMORY);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4091,26 +4550,94 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_SELECT)
+#ifdef USE_WATCHER_THREAD
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	manager->maxfd = thread->pipe_fds[0];
+#else /* USE_WATCHER_THREAD */
+	manager->maxfd = 0;
+#endif /* USE_WATCHER_THREAD */
+	UNUSED(mctx);
 	UNUSED(result);
+#endif	/* USE_KQUEUE */
+
+	return (ISC_R_SUCCESS);
+
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+ close_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+	return (result);
+#endif
+}
 
+static void
+cleanup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_WATCHER_THREAD
+	isc_result_t result;
+
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "epoll_ctl(DEL) %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	}
+#endif	/* USE_WATCHER_THREAD */
+
+#ifdef USE_KQUEUE
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+#else
+	UNUSED(mctx);
+#endif	/* USE_KQUEUE */
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+}
+
+static isc_result_t
+setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+	isc_result_t result;
+	int i;
+
+#ifdef USE_DEVPOLL
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
 #if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
 	/*
 	 * Note: this code should also cover the case of MAXSOCKETS <=
@@ -4154,44 +4681,58 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	}
 	memset(manager->read_fds, 0, manager->fd_bufsize);
 	memset(manager->write_fds, 0, manager->fd_bufsize);
+#endif	/* USE_DEVPOLL */
 
-#ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
-#else /* USE_WATCHER_THREAD */
-	manager->maxfd = 0;
-#endif /* USE_WATCHER_THREAD */
-#endif	/* USE_KQUEUE */
+	manager->threads = isc_mem_get(mctx, sizeof(isc__socketthread_t) *
+				       manager->nthreads);
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	memset(manager->threads, 0,
+	       sizeof(isc__socketthread_t) * manager->nthreads);
+
+	for (i = 0; i < manager->nthreads; i++) {
+		manager->threads[i].manager = manager;
+		manager->threads[i].threadid = i;
+		result = setup_thread(mctx, &manager->threads[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				cleanup_thread(mctx, &manager->threads[i]);
+			isc_mem_put(mctx, manager->threads,
+				    sizeof(isc__socketthread_t) *
+				    manager->nthreads);
+			manager->threads = NULL;
+			goto cleanup;
+		}
+	}
 
 	return (ISC_R_SUCCESS);
+
+ cleanup:
+#ifdef USE_DEVPOLL
+	isc_mem_put(mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
+	isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->read_fds_copy, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
+	isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
+#endif	/* USE_DEVPOLL */
+	return (result);
 }
 
 static void
 cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
-#ifdef USE_WATCHER_THREAD
-	isc_result_t result;
+	int i;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_ctl(DEL) %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-	}
-#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(mctx, &manager->threads[i]);
+	isc_mem_put(mctx, manager->threads,
+		    sizeof(isc__socketthread_t) * manager->nthreads);
+	manager->threads = NULL;
 
-#ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
-#elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
-#elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
+#ifdef USE_DEVPOLL
 	isc_mem_put(mctx, manager->fdpollinfo,
 		    sizeof(pollinfo_t) * manager->maxsocks);
 #elif defined(USE_SELECT)
@@ -4203,26 +4744,152 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
 	if (manager->write_fds_copy != NULL)
 		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
-#endif	/* USE_KQUEUE */
+#endif	/* USE_DEVPOLL */
+}
+
+#ifdef USE_WATCHER_THREAD
+/*
+ * Start the select/poll threads.
+ */
+static isc_result_t
+start_watchers(isc__socketmgr_t *manager) {
+	int i;
+
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_create(watcher, &manager->threads[i],
+				      &manager->threads[i].thread) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			while (--i >= 0) {
+				select_poke_thread(&manager->threads[i], 0,
+						   SELECT_POKE_SHUTDOWN);
+				(void)isc_thread_join(manager->threads[i].thread,
+						      NULL);
+			}
+			return (ISC_R_UNEXPECTED);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Poke each select/poll thread and wait for it to exit.
+ */
+static void
+stop_watchers(isc__socketmgr_t *manager) {
+	int i;
+
+	for (i = 0; i < manager->nthreads; i++)
+		select_poke_thread(&manager->threads[i], 0,
+				   SELECT_POKE_SHUTDOWN);
+
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+	}
+}
+#endif /* USE_WATCHER_THREAD */
+
+#ifdef BIND9
+ISC_SOCKETFUNC_SCOPE isc_result_t
+isc___socketmgr_setnthreads(isc_socketmgr_t *manager0, int nthreads) {
+	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+#if defined(USE_WATCHER_THREAD) && !defined(USE_SELECT)
+	isc__socketthread_t *threads, *oldthreads;
+	isc_result_t result;
+	isc_boolean_t empty;
+	int i, oldnthreads;
+#endif
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(nthreads > 0);
+
+#if !defined(USE_WATCHER_THREAD) || defined(USE_SELECT)
+	if (nthreads > 1)
+		return (ISC_R_NOTIMPLEMENTED);
+	return (ISC_R_SUCCESS);
+#else
+	if (nthreads == manager->nthreads)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * Descriptors are registered with the event queue of the watcher
+	 * that owns them, so the watchers can only be replaced while no
+	 * sockets exist.
+	 */
+	LOCK(&manager->lock);
+	empty = ISC_LIST_EMPTY(manager->socklist);
+	UNLOCK(&manager->lock);
+	if (!empty)
+		return (ISC_R_EXISTS);
+
+	/*
+	 * Set up the new event queues before touching the running
+	 * watchers so that a failure leaves the manager as it was.
+	 */
+	threads = isc_mem_get(manager->mctx,
+			      sizeof(isc__socketthread_t) * nthreads);
+	if (threads == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(threads, 0, sizeof(isc__socketthread_t) * nthreads);
+	for (i = 0; i < nthreads; i++) {
+		threads[i].manager = manager;
+		threads[i].threadid = i;
+		result = setup_thread(manager->mctx, &threads[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				cleanup_thread(manager->mctx, &threads[i]);
+			isc_mem_put(manager->mctx, threads,
+				    sizeof(isc__socketthread_t) * nthreads);
+			return (result);
+		}
+	}
+
+	stop_watchers(manager);
+
+	oldthreads = manager->threads;
+	oldnthreads = manager->nthreads;
+	manager->threads = threads;
+	manager->nthreads = nthreads;
+
+	for (i = 0; i < oldnthreads; i++)
+		cleanup_thread(manager->mctx, &oldthreads[i]);
+	isc_mem_put(manager->mctx, oldthreads,
+		    sizeof(isc__socketthread_t) * oldnthreads);
+
+	return (start_watchers(manager));
+#endif
 }
+#endif	/* BIND9 */
 
 ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
-#ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
-#endif
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nthreads >= 0);
 
 #ifdef USE_SHARED_MANAGER
 	if (socketmgr != NULL) {
@@ -4239,6 +4906,16 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
 
+	/*
+	 * Only the threaded event loops can be sharded; select() keeps
+	 * its descriptor sets in the manager.
+	 */
+#if !defined(USE_WATCHER_THREAD) || defined(USE_SELECT)
+	nthreads = 1;
+#endif
+	if (nthreads == 0)
+		nthreads = 1;
+
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
@@ -4246,8 +4923,11 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	/* zero-clear so that necessary cleanup on failure will be easy */
 	memset(manager, 0, sizeof(*manager));
 	manager->maxsocks = maxsocks;
+	manager->nthreads = nthreads;
+	manager->threads = NULL;
 	manager->reserved = 0;
 	manager->maxudp = 0;
+	manager->udpbatch = 0;
 	manager->fds = isc_mem_get(mctx,
 				   manager->maxsocks * sizeof(isc__socket_t *));
 	if (manager->fds == NULL) {
@@ -4296,26 +4976,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
@@ -4331,16 +4991,11 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	result = start_watchers(manager);
+	if (result != ISC_R_SUCCESS) {
 		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
 		goto cleanup;
 	}
 #endif /* USE_WATCHER_THREAD */
@@ -4355,12 +5010,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
-
-#ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif	/* USE_WATCHER_THREAD */
 
@@ -4459,22 +5108,11 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 	UNLOCK(&manager->lock);
 
-	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
-	 * This is currently a no-op in the non-threaded case.
-	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
-
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Here, poke our select/poll threads and wait for them to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	stop_watchers(manager);
 #endif /* USE_WATCHER_THREAD */
 
 	/*
@@ -4483,8 +5121,6 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	cleanup_watcher(manager->mctx, manager);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
@@ -5123,6 +5759,29 @@ isc__socket_bind(isc_socket_t *sock0, isc_sockaddr_t *sockaddr,
 	if (sock->pf == AF_UNIX)
 		goto bind_socket;
 #endif
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		options |= ISC_SOCKET_REUSEADDRESS;
+		if (isc_sockaddr_getport(sockaddr) != (in_port_t)0 &&
+		    setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
+			       (void *)&on, sizeof(on)) < 0) {
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "setsockopt(%d, SO_REUSEPORT) %s: %s",
+					 sock->fd,
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"),
+					 strbuf);
+			UNLOCK(&sock->lock);
+			return (ISC_R_UNEXPECTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 	if ((options & ISC_SOCKET_REUSEADDRESS) != 0 &&
 	    isc_sockaddr_getport(sockaddr) != (in_port_t)0 &&
 	    setsockopt(sock->fd, SOL_SOCKET, SO_REUSEADDR, (void *)&on,
@@ -5835,6 +6494,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+	isc__socketthread_t *thread;
+#endif
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -5856,6 +6518,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+	thread = &manager->threads[0];
+#endif
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -5864,8 +6529,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -5873,32 +6538,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -5906,9 +6571,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
@@ -5944,10 +6609,12 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 		return (ISC_R_NOTFOUND);
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(&manager->threads[0], manager->threads[0].events,
+			  swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(&manager->threads[0], swait->maxfd, swait->readset,
+		    swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
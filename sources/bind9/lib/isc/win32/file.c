@@ -672,3 +672,59 @@ isc_file_mode(const char *file, mode_t *modep) {
 		*modep = (stats.st_mode & 07777);
 	return (result);
 }
+
+isc_result_t
+isc_file_getsizefd(int fd, off_t *size) {
+	struct stat stats;
+
+	REQUIRE(size != NULL);
+
+	if (fstat(fd, &stats) != 0)
+		return (isc__errno2result(errno));
+
+	*size = stats.st_size;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * There is no mmap() here: read the file into allocated memory.
+ */
+isc_result_t
+isc_file_mmap(int fd, size_t len, void **addrp) {
+	char *addr;
+	size_t done = 0;
+	int n;
+
+	REQUIRE(len > 0);
+	REQUIRE(addrp != NULL && *addrp == NULL);
+
+	addr = malloc(len);
+	if (addr == NULL)
+		return (ISC_R_NOMEMORY);
+
+	if (_lseek(fd, 0, SEEK_SET) != 0) {
+		free(addr);
+		return (isc__errno2result(errno));
+	}
+	while (done < len) {
+		n = _read(fd, addr + done, (unsigned int)(len - done));
+		if (n <= 0) {
+			free(addr);
+			return (n == 0 ? ISC_R_UNEXPECTEDEND :
+				isc__errno2result(errno));
+		}
+		done += n;
+	}
+
+	*addrp = addr;
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_file_munmap(void *addr, size_t len) {
+	REQUIRE(addr != NULL);
+	UNUSED(len);
+
+	free(addr);
+	return (ISC_R_SUCCESS);
+}
@@ -2618,17 +2618,18 @@ SocketIoThread(LPVOID ThreadContext) {
  */
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc_socketmgr_create2(mctx, managerp, 0));
+	return (isc_socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	isc_socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nthreads >= 0);
 
 	if (maxsocks != 0)
 		return (ISC_R_NOTIMPLEMENTED);
@@ -3221,6 +3222,14 @@ isc__socket_bind(isc_socket_t *sock, isc_sockaddr_t *sockaddr,
 		UNLOCK(&sock->lock);
 		return (ISC_R_FAMILYMISMATCH);
 	}
+	/*
+	 * SO_REUSEADDR on Windows does not load balance between the
+	 * sockets sharing a port, so refuse ISC_SOCKET_REUSEPORT.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	/*
 	 * Only set SO_REUSEADDR when we want a specific port.
 	 */
@@ -3885,6 +3894,25 @@ isc___socketmgr_maxudp(isc_socketmgr_t *manager, int maxudp) {
 	UNUSED(maxudp);
 }
 
+isc_result_t
+isc___socketmgr_setnthreads(isc_socketmgr_t *manager, int nthreads) {
+
+	UNUSED(manager);
+
+	if (nthreads > 1)
+		return (ISC_R_NOTIMPLEMENTED);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc___socketmgr_setudpbatch(isc_socketmgr_t *manager, unsigned int batch) {
+
+	UNUSED(manager);
+	UNUSED(batch);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 #ifdef HAVE_LIBXML2
 
 static const char *